@@ -184,6 +184,17 @@ public class Collectd
   native public static int registerFlush (String name,
       CollectdFlushInterface object);
 
+  /**
+   * Registers a write callback which receives values in batches of up to
+   * <code>batchSize</code> values. Pending values are passed on when the
+   * daemon flushes.
+   *
+   * @return Zero when successful, non-zero otherwise.
+   * @see CollectdBatchWriteInterface
+   */
+  native public static int registerBatchWrite (String name, int batchSize,
+      CollectdBatchWriteInterface object);
+
   /**
    * Java representation of collectd/src/plugin.h:plugin_register_shutdown
    *
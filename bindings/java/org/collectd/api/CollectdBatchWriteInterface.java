@@ -0,0 +1,43 @@
+/**
+ * collectd - bindings/java/org/collectd/api/CollectdBatchWriteInterface.java
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+package org.collectd.api;
+
+/**
+ * Interface for objects implementing a batched write method.
+ *
+ * The first <code>num</code> elements of <code>ids</code>,
+ * <code>times</code> and <code>values</code> describe one value each. The
+ * arrays are reused for every call and must not be kept. Each id identifies
+ * a data source; the identifiers of ids seen for the first time are appended
+ * to <code>newIdentifiers</code>, in order, so that id <i>n</i> corresponds
+ * to the <i>n</i>-th identifier received overall. Identifiers not written for
+ * ten intervals are forgotten and get a new id when they show up again; ids
+ * are never reused.
+ *
+ * @see Collectd#registerBatchWrite
+ */
+public interface CollectdBatchWriteInterface
+{
+	public int writeBatch (int num, int[] ids, long[] times, double[] values,
+			String[] newIdentifiers);
+}
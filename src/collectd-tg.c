@@ -33,7 +33,9 @@
 #endif
 
 #include <errno.h>
+#include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -52,6 +54,9 @@
 #define DEF_NUM_PLUGINS 20
 #define DEF_NUM_VALUES 100000
 #define DEF_INTERVAL 10.0
+#define DEF_DURATION 10.0
+#define DEF_PROBE_INTERVAL 0.1
+#define PROBE_TIMEOUT 5.0
 
 static int conf_num_hosts = DEF_NUM_HOSTS;
 static int conf_num_plugins = DEF_NUM_PLUGINS;
@@ -59,6 +64,13 @@ static int conf_num_values = DEF_NUM_VALUES;
 static double conf_interval = DEF_INTERVAL;
 static const char *conf_destination = NET_DEFAULT_V6_ADDR;
 static const char *conf_service = NET_DEFAULT_PORT;
+/* Benchmark mode */
+static int conf_num_threads;
+static double conf_rate;
+static double conf_duration = DEF_DURATION;
+static const char *conf_unixsock;
+static double conf_probe_interval = DEF_PROBE_INTERVAL;
+static bool conf_json;
 
 static lcc_network_t *net;
 
@@ -88,10 +100,21 @@ __attribute__((noreturn)) static void exit_usage(int exit_status) /* {{{ */
       "                   (Default: %s)\n"
       "    -h             Print usage information (this output).\n"
       "\n"
+      "  Benchmark mode:\n"
+      "    -T <number>    Send as fast as possible from this many threads,\n"
+      "                   cycling through the value lists.\n"
+      "    -r <rate>      Limit the rate to this many value lists per second.\n"
+      "                   (Default: no limit)\n"
+      "    -s <seconds>   Duration of the benchmark. (Default: %.1f)\n"
+      "    -u <socket>    Measure the latency until values can be read back\n"
+      "                   from this unixsock socket.\n"
+      "    -P <seconds>   Interval of the latency probes. (Default: %.1f)\n"
+      "    -j             Print the results as JSON.\n"
+      "\n"
       "Copyright (C) 2010-2012  Florian Forster\n"
       "Licensed under the MIT license.\n",
       DEF_NUM_VALUES, DEF_NUM_HOSTS, DEF_NUM_PLUGINS, DEF_INTERVAL,
-      NET_DEFAULT_V6_ADDR, NET_DEFAULT_PORT);
+      NET_DEFAULT_V6_ADDR, NET_DEFAULT_PORT, DEF_DURATION, DEF_PROBE_INTERVAL);
   exit(exit_status);
 } /* }}} void exit_usage */
 
@@ -123,6 +146,19 @@ static double dtime(void) /* {{{ */
 } /* }}} double dtime */
 #endif
 
+static void sleep_for(double seconds) /* {{{ */
+{
+  if (seconds <= 0.0)
+    return;
+
+  struct timespec ts = {
+      .tv_sec = (time_t)seconds,
+  };
+  ts.tv_nsec = (long)((seconds - ((double)ts.tv_sec)) * 1e9);
+
+  nanosleep(&ts, /* remaining = */ NULL);
+} /* }}} void sleep_for */
+
 static int compare_time(const void *v0, const void *v1) /* {{{ */
 {
   const lcc_value_list_t *vl0 = v0;
@@ -232,6 +268,321 @@ static int send_value(lcc_value_list_t *vl) /* {{{ */
   return 0;
 } /* }}} int send_value */
 
+static lcc_network_t *network_create(void) /* {{{ */
+{
+  lcc_network_t *n = lcc_network_create();
+  if (n == NULL) {
+    fprintf(stderr, "lcc_network_create failed.\n");
+    return NULL;
+  }
+
+  lcc_server_t *srv = lcc_server_create(n, conf_destination, conf_service);
+  if (srv == NULL) {
+    fprintf(stderr, "lcc_server_create failed.\n");
+    lcc_network_destroy(n);
+    return NULL;
+  }
+
+  lcc_server_set_ttl(srv, 42);
+#if 0
+  lcc_server_set_security_level (srv, ENCRYPT,
+      "admin", "password1");
+#endif
+
+  return n;
+} /* }}} lcc_network_t *network_create */
+
+/*
+ * Benchmark mode: every sender thread owns every conf_num_threads'th value
+ * list and sends them round-robin, either as fast as possible or at its share
+ * of conf_rate. The optional probe thread measures the latency until a value
+ * sent over the network can be read back from the daemon's cache.
+ */
+typedef struct {
+  pthread_t thread;
+  int index;
+  lcc_network_t *net;
+  double start;
+
+  uint64_t sent;
+  double end;
+} sender_t;
+
+typedef struct {
+  pthread_t thread;
+  double start;
+
+  double *latencies;
+  size_t latencies_num;
+  uint64_t lost;
+  int status;
+} prober_t;
+
+static lcc_value_list_t **bench_values;
+
+static void *sender_thread(void *arg) /* {{{ */
+{
+  sender_t *s = arg;
+  double rate = conf_rate / (double)conf_num_threads;
+  double stop = s->start + conf_duration;
+  int i = s->index;
+
+  while (loop) {
+    double now = dtime();
+    if (now >= stop)
+      break;
+
+    if (rate > 0.0) {
+      double due = s->start + ((double)s->sent) / rate;
+      if (due > now) {
+        sleep_for(due - now);
+        continue;
+      }
+    }
+
+    lcc_value_list_t *vl = bench_values[i];
+    if (vl->values_types[0] == LCC_TYPE_GAUGE)
+      vl->values[0].gauge = (gauge_t)(s->sent % 100);
+    else
+      vl->values[0].derive += (derive_t)(s->sent % 100);
+    vl->time = now;
+
+    lcc_network_values_send(s->net, vl);
+    s->sent++;
+
+    i += conf_num_threads;
+    if (i >= conf_num_values)
+      i = s->index;
+  }
+
+  lcc_network_flush(s->net);
+  s->end = dtime();
+  return NULL;
+} /* }}} void *sender_thread */
+
+/* Returns true once "ident" has the value "want" in the daemon's cache. */
+static bool probe_seen(lcc_connection_t *con, lcc_identifier_t *ident,
+                       gauge_t want) /* {{{ */
+{
+  size_t values_num = 0;
+  gauge_t *values = NULL;
+
+  if (lcc_getval(con, ident, &values_num, &values,
+                 /* values_names = */ NULL) != 0)
+    return false;
+
+  bool seen = (values_num == 1) && (values[0] == want);
+  free(values);
+  return seen;
+} /* }}} bool probe_seen */
+
+static void *probe_thread(void *arg) /* {{{ */
+{
+  prober_t *p = arg;
+  lcc_connection_t *con = NULL;
+
+  if (lcc_connect(conf_unixsock, &con) != 0) {
+    fprintf(stderr, "Connecting to \"%s\" failed.\n", conf_unixsock);
+    p->status = -1;
+    return NULL;
+  }
+
+  lcc_network_t *n = network_create();
+  size_t latencies_size = (size_t)(conf_duration / conf_probe_interval) + 1;
+  p->latencies = calloc(latencies_size, sizeof(*p->latencies));
+  if ((n == NULL) || (p->latencies == NULL)) {
+    p->status = -1;
+    lcc_network_destroy(n);
+    LCC_DESTROY(con);
+    return NULL;
+  }
+
+  value_t value;
+  int value_type = LCC_TYPE_GAUGE;
+  lcc_value_list_t vl = LCC_VALUE_LIST_INIT;
+  vl.values = &value;
+  vl.values_types = &value_type;
+  vl.values_len = 1;
+  vl.interval = conf_interval;
+  snprintf(vl.identifier.host, sizeof(vl.identifier.host), "collectd-tg");
+  snprintf(vl.identifier.plugin, sizeof(vl.identifier.plugin), "probe");
+  snprintf(vl.identifier.type, sizeof(vl.identifier.type), "gauge");
+  /* Unique per run, so values left over by earlier runs don't match. */
+  snprintf(vl.identifier.type_instance, sizeof(vl.identifier.type_instance),
+           "%li", (long)getpid());
+
+  double stop = p->start + conf_duration;
+  for (uint64_t seq = 1; loop && (p->latencies_num < latencies_size); seq++) {
+    sleep_for(p->start + ((double)seq) * conf_probe_interval - dtime());
+    if (dtime() >= stop)
+      break;
+
+    /* GETVAL prints seven significant digits. */
+    value.gauge = (gauge_t)(seq % 1000000);
+    vl.time = dtime();
+    lcc_network_values_send(n, &vl);
+    lcc_network_flush(n);
+
+    bool seen = false;
+    while (loop && !seen && ((dtime() - vl.time) < PROBE_TIMEOUT)) {
+      seen = probe_seen(con, &vl.identifier, value.gauge);
+      if (!seen)
+        sleep_for(0.0002);
+    }
+
+    if (seen)
+      p->latencies[p->latencies_num++] = dtime() - vl.time;
+    else
+      p->lost++;
+  }
+
+  lcc_network_destroy(n);
+  LCC_DESTROY(con);
+  return NULL;
+} /* }}} void *probe_thread */
+
+static int compare_double(const void *a, const void *b) /* {{{ */
+{
+  double d0 = *(const double *)a;
+  double d1 = *(const double *)b;
+
+  if (d0 < d1)
+    return -1;
+  else if (d0 > d1)
+    return 1;
+  else
+    return 0;
+} /* }}} int compare_double */
+
+static void print_results(sender_t const *senders, prober_t *p) /* {{{ */
+{
+  uint64_t sent = 0;
+  double end = senders[0].start;
+  for (int i = 0; i < conf_num_threads; i++) {
+    sent += senders[i].sent;
+    if (senders[i].end > end)
+      end = senders[i].end;
+  }
+  double elapsed = end - senders[0].start;
+  double rate = (elapsed > 0.0) ? ((double)sent) / elapsed : 0.0;
+
+  double lat_min = NAN, lat_median = NAN, lat_p99 = NAN, lat_max = NAN;
+  double lat_avg = NAN;
+  size_t n = (p != NULL) ? p->latencies_num : 0;
+  if (n > 0) {
+    qsort(p->latencies, n, sizeof(*p->latencies), compare_double);
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++)
+      sum += p->latencies[i];
+
+    lat_min = p->latencies[0];
+    lat_avg = sum / (double)n;
+    lat_median = p->latencies[n / 2];
+    lat_p99 = p->latencies[(n * 99) / 100];
+    lat_max = p->latencies[n - 1];
+  }
+  uint64_t lost = (p != NULL) ? p->lost : 0;
+
+  if (conf_json) {
+    printf("{\"threads\":%i,\"target_rate\":%.1f,\"value_lists\":%i,"
+           "\"duration\":%.6f,\"sent\":%" PRIu64 ",\"rate\":%.1f",
+           conf_num_threads, conf_rate, conf_num_values, elapsed, sent, rate);
+    if (p != NULL) {
+      printf(",\"probes\":%zu,\"probes_lost\":%" PRIu64, n, lost);
+      if (n > 0)
+        printf(",\"latency_min\":%.6f,\"latency_avg\":%.6f,"
+               "\"latency_median\":%.6f,\"latency_p99\":%.6f,"
+               "\"latency_max\":%.6f",
+               lat_min, lat_avg, lat_median, lat_p99, lat_max);
+    }
+    printf("}\n");
+    return;
+  }
+
+  printf("Sent %" PRIu64 " value lists in %.3f seconds using %i threads: "
+         "%.1f value lists/s\n",
+         sent, elapsed, conf_num_threads, rate);
+  if (p != NULL) {
+    printf("Latency of %zu probes (%" PRIu64 " lost):", n, lost);
+    if (n > 0)
+      printf(" min %.6f s, avg %.6f s, median %.6f s, p99 %.6f s, "
+             "max %.6f s",
+             lat_min, lat_avg, lat_median, lat_p99, lat_max);
+    printf("\n");
+  }
+} /* }}} void print_results */
+
+static int run_benchmark(void) /* {{{ */
+{
+  bench_values = calloc((size_t)conf_num_values, sizeof(*bench_values));
+  sender_t *senders = calloc((size_t)conf_num_threads, sizeof(*senders));
+  if ((bench_values == NULL) || (senders == NULL)) {
+    fprintf(stderr, "calloc failed.\n");
+    return -1;
+  }
+
+  for (int i = 0; i < conf_num_values; i++) {
+    bench_values[i] = create_value_list();
+    if (bench_values[i] == NULL)
+      return -1;
+  }
+
+  double start = dtime();
+  int status = 0;
+  int threads_num = 0;
+  for (; threads_num < conf_num_threads; threads_num++) {
+    sender_t *s = senders + threads_num;
+    s->index = threads_num;
+    s->start = start;
+    s->net = network_create();
+    if (s->net == NULL) {
+      status = -1;
+      break;
+    }
+
+    status = pthread_create(&s->thread, NULL, sender_thread, s);
+    if (status != 0) {
+      fprintf(stderr, "pthread_create failed: %s\n", strerror(status));
+      lcc_network_destroy(s->net);
+      break;
+    }
+  }
+
+  prober_t prober = {.start = start};
+  bool probing = false;
+  if ((status == 0) && (conf_unixsock != NULL)) {
+    status = pthread_create(&prober.thread, NULL, probe_thread, &prober);
+    if (status != 0)
+      fprintf(stderr, "pthread_create failed: %s\n", strerror(status));
+    else
+      probing = true;
+  }
+
+  /* Stop the threads which have been started if something went wrong. */
+  if (status != 0)
+    loop = false;
+
+  for (int i = 0; i < threads_num; i++) {
+    pthread_join(senders[i].thread, NULL);
+    lcc_network_destroy(senders[i].net);
+  }
+  if (probing) {
+    pthread_join(prober.thread, NULL);
+    if (prober.status != 0)
+      status = -1;
+  }
+
+  if (status == 0)
+    print_results(senders, probing ? &prober : NULL);
+
+  for (int i = 0; i < conf_num_values; i++)
+    destroy_value_list(bench_values[i]);
+  free(bench_values);
+  free(prober.latencies);
+  free(senders);
+  return status;
+} /* }}} int run_benchmark */
+
 static int get_integer_opt(const char *str, int *ret_value) /* {{{ */
 {
   char *endptr;
@@ -284,7 +635,7 @@ static int read_options(int argc, char **argv) /* {{{ */
 {
   int opt;
 
-  while ((opt = getopt(argc, argv, "n:H:p:i:d:D:h")) != -1) {
+  while ((opt = getopt(argc, argv, "n:H:p:i:d:D:T:r:s:u:P:jh")) != -1) {
     switch (opt) {
     case 'n':
       get_integer_opt(optarg, &conf_num_values);
@@ -310,6 +661,30 @@ static int read_options(int argc, char **argv) /* {{{ */
       conf_service = optarg;
       break;
 
+    case 'T':
+      get_integer_opt(optarg, &conf_num_threads);
+      break;
+
+    case 'r':
+      get_double_opt(optarg, &conf_rate);
+      break;
+
+    case 's':
+      get_double_opt(optarg, &conf_duration);
+      break;
+
+    case 'u':
+      conf_unixsock = optarg;
+      break;
+
+    case 'P':
+      get_double_opt(optarg, &conf_probe_interval);
+      break;
+
+    case 'j':
+      conf_json = true;
+      break;
+
     case 'h':
       exit_usage(EXIT_SUCCESS);
 
@@ -318,6 +693,16 @@ static int read_options(int argc, char **argv) /* {{{ */
     } /* switch (opt) */
   }   /* while (getopt) */
 
+  if ((conf_num_threads < 0) || (conf_rate < 0.0) || (conf_duration <= 0.0) ||
+      (conf_probe_interval <= 0.0)) {
+    fprintf(stderr, "Negative or zero options are not allowed.\n");
+    exit(EXIT_FAILURE);
+  }
+  if ((conf_num_threads > 0) && (conf_num_values < conf_num_threads)) {
+    fprintf(stderr, "At least one value list per thread is needed.\n");
+    exit(EXIT_FAILURE);
+  }
+
   return 0;
 } /* }}} int read_options */
 
@@ -334,31 +719,18 @@ int main(int argc, char **argv) /* {{{ */
   sigterm_action.sa_handler = signal_handler;
   sigaction(SIGTERM, &sigterm_action, /* old = */ NULL);
 
+  if (conf_num_threads > 0)
+    exit((run_benchmark() == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+
   values_heap = c_heap_create(compare_time);
   if (values_heap == NULL) {
     fprintf(stderr, "c_heap_create failed.\n");
     exit(EXIT_FAILURE);
   }
 
-  net = lcc_network_create();
-  if (net == NULL) {
-    fprintf(stderr, "lcc_network_create failed.\n");
+  net = network_create();
+  if (net == NULL)
     exit(EXIT_FAILURE);
-  } else {
-    lcc_server_t *srv;
-
-    srv = lcc_server_create(net, conf_destination, conf_service);
-    if (srv == NULL) {
-      fprintf(stderr, "lcc_server_create failed.\n");
-      exit(EXIT_FAILURE);
-    }
-
-    lcc_server_set_ttl(srv, 42);
-#if 0
-    lcc_server_set_security_level (srv, ENCRYPT,
-        "admin", "password1");
-#endif
-  }
 
   fprintf(stdout, "Creating %i values ... ", conf_num_values);
   fflush(stdout);
@@ -389,13 +761,7 @@ int main(int argc, char **argv) /* {{{ */
       double now = dtime();
 
       while (now < vl->time) {
-        double diff = vl->time - now;
-        struct timespec ts = {
-            .tv_sec = (time_t)diff,
-        };
-        ts.tv_nsec = (long)((diff - ((double)ts.tv_sec)) * 1e9);
-
-        nanosleep(&ts, /* remaining = */ NULL);
+        sleep_for(vl->time - now);
         now = dtime();
 
         if (!loop)
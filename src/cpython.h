@@ -28,32 +28,55 @@
 
 #include <longintrepr.h>
 
-/* These two macros are basically Py_BEGIN_ALLOW_THREADS and
- * Py_BEGIN_ALLOW_THREADS
+/* Modules loaded with "ImportIsolated" run in a sub-interpreter with its
+ * own GIL. This needs the per-interpreter GIL of Python 3.12 and later. */
+#if PY_VERSION_HEX >= 0x030C0000
+#define CPY_HAVE_OWN_GIL
+#endif
+
+/* An interpreter, see python.c. */
+typedef struct cpy_interp_s cpy_interp_t;
+
+typedef struct {
+  PyGILState_STATE gil_state;
+#ifdef CPY_HAVE_OWN_GIL
+  int mode;
+  /* Thread state of another interpreter released by cpy_gil_acquire(). */
+  PyThreadState *saved;
+#endif
+} cpy_gil_t;
+
+void cpy_gil_acquire(cpy_gil_t *gil, cpy_interp_t *interp);
+void cpy_gil_release(cpy_gil_t *gil);
+
+/* These macros are basically Py_BEGIN_ALLOW_THREADS and
+ * Py_END_ALLOW_THREADS
  * from the other direction. If a Python thread calls a C function
  * Py_BEGIN_ALLOW_THREADS is used to allow other python threads to run because
  * we don't intend to call any Python functions.
  *
- * These two macros are used whenever a C thread intends to call some Python
+ * These macros are used whenever a C thread intends to call some Python
  * function, usually because some registered callback was triggered.
- * Just like Py_BEGIN_ALLOW_THREADS it opens a block so these macros have to be
- * used in pairs. They acquire the GIL, create a new Python thread state and
- * swap
- * the current thread state with the new one. This means this thread is now
- * allowed
- * to execute Python code. */
-
-#define CPY_LOCK_THREADS                                                       \
+ * Just like Py_BEGIN_ALLOW_THREADS they open a block so these macros have to be
+ * used in pairs. They acquire the GIL of the interpreter, create a new Python
+ * thread state if this thread doesn't have one yet and swap the current
+ * thread state with it. This means this thread is now allowed to execute
+ * Python code in that interpreter. CPY_LOCK_THREADS locks the main
+ * interpreter. */
+
+#define CPY_LOCK_INTERP(interp)                                                \
   {                                                                            \
-    PyGILState_STATE gil_state;                                                \
-    gil_state = PyGILState_Ensure();
+    cpy_gil_t gil_state;                                                       \
+    cpy_gil_acquire(&gil_state, (interp));
+
+#define CPY_LOCK_THREADS CPY_LOCK_INTERP(NULL)
 
 #define CPY_RETURN_FROM_THREADS                                                \
-  PyGILState_Release(gil_state);                                               \
+  cpy_gil_release(&gil_state);                                                 \
   return
 
 #define CPY_RELEASE_THREADS                                                    \
-  PyGILState_Release(gil_state);                                               \
+  cpy_gil_release(&gil_state);                                                 \
   }
 
 /* This macro is a shortcut for calls like
@@ -139,7 +162,38 @@ static inline PyObject *cpy_string_to_unicode_or_bytes(const char *buf) {
 #endif
 }
 
+/* Appends the C string "s" to "*a" like CPY_STRCAT. */
+static inline void cpy_strcat_string(PyObject **a, const char *s) {
+  PyObject *tmp = cpy_string_to_unicode_or_bytes(s); /* New reference. */
+  if (tmp == NULL) {
+    Py_CLEAR(*a);
+    return;
+  }
+  CPY_STRCAT(a, tmp);
+  Py_DECREF(tmp);
+}
+
 void cpy_log_exception(const char *context);
+PyObject *cpy_dispatch_values(PyObject *self, PyObject *arg);
+
+/* The types of the collectd module. Isolated interpreters have their own
+ * heap types created from the PyType_Specs below, so C code must look them
+ * up with cpy_types() instead of using the static types directly. */
+typedef struct {
+  PyTypeObject *config;
+  PyTypeObject *plugin_data;
+  PyTypeObject *values;
+  PyTypeObject *notification;
+  PyTypeObject *signed_type;
+  PyTypeObject *unsigned_type;
+} cpy_types_t;
+
+/* You must hold the GIL to call these functions! */
+const cpy_types_t *cpy_types(void);
+/* Instances of heap types own a reference to their type. tp_traverse and
+ * tp_dealloc of the collectd types call these to take care of it. */
+int cpy_traverse_type(PyObject *self, visitproc visit, void *arg);
+void cpy_free_object(PyObject *self);
 
 /* Python object declarations. */
 
@@ -153,6 +207,9 @@ typedef struct {
   // clang-format on
 } Config;
 extern PyTypeObject ConfigType;
+#ifdef CPY_HAVE_OWN_GIL
+extern PyType_Spec ConfigSpec;
+#endif
 
 typedef struct {
   // clang-format off
@@ -166,8 +223,11 @@ typedef struct {
   char type_instance[DATA_MAX_NAME_LEN];
 } PluginData;
 extern PyTypeObject PluginDataType;
+#ifdef CPY_HAVE_OWN_GIL
+extern PyType_Spec PluginDataSpec;
+#endif
 #define PluginData_New()                                                       \
-  PyObject_CallFunctionObjArgs((PyObject *)&PluginDataType, (void *)0)
+  PyObject_CallFunctionObjArgs((PyObject *)cpy_types()->plugin_data, (void *)0)
 
 typedef struct {
   PluginData data;
@@ -176,8 +236,11 @@ typedef struct {
   double interval;
 } Values;
 extern PyTypeObject ValuesType;
+#ifdef CPY_HAVE_OWN_GIL
+extern PyType_Spec ValuesSpec;
+#endif
 #define Values_New()                                                           \
-  PyObject_CallFunctionObjArgs((PyObject *)&ValuesType, (void *)0)
+  PyObject_CallFunctionObjArgs((PyObject *)cpy_types()->values, (void *)0)
 
 typedef struct {
   PluginData data;
@@ -186,11 +249,21 @@ typedef struct {
   char message[NOTIF_MAX_MSG_LEN];
 } Notification;
 extern PyTypeObject NotificationType;
+#ifdef CPY_HAVE_OWN_GIL
+extern PyType_Spec NotificationSpec;
+#endif
 #define Notification_New()                                                     \
-  PyObject_CallFunctionObjArgs((PyObject *)&NotificationType, (void *)0)
+  PyObject_CallFunctionObjArgs((PyObject *)cpy_types()->notification,          \
+                               (void *)0)
 
 typedef PyLongObject Signed;
 extern PyTypeObject SignedType;
+#ifdef CPY_HAVE_OWN_GIL
+extern PyType_Spec SignedSpec;
+#endif
 
 typedef PyLongObject Unsigned;
 extern PyTypeObject UnsignedType;
+#ifdef CPY_HAVE_OWN_GIL
+extern PyType_Spec UnsignedSpec;
+#endif
@@ -25,6 +25,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_engine/curl_engine.h"
 #include "utils/curl_stats/curl_stats.h"
 #include "utils/match/match.h"
 #include "utils_time.h"
@@ -77,6 +78,8 @@ struct web_page_s /* {{{ */
   char *buffer;
   size_t buffer_size;
   size_t buffer_fill;
+  /* Result of the last transfer, returned by the next read. */
+  int last_status;
 
   web_match_t *matches;
 }; /* }}} */
@@ -139,8 +142,10 @@ static void cc_web_page_free(void *arg) /* {{{ */
   if (wp == NULL)
     return;
 
-  if (wp->curl != NULL)
+  if (wp->curl != NULL) {
+    curl_engine_cancel(wp->curl);
     curl_easy_cleanup(wp->curl);
+  }
   wp->curl = NULL;
 
   sfree(wp->plugin_name);
@@ -340,6 +345,7 @@ static int cc_page_init_curl(web_page_t *wp) /* {{{ */
   }
 
   curl_easy_setopt(wp->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(wp->curl, CURLOPT_URL, wp->url);
   curl_easy_setopt(wp->curl, CURLOPT_WRITEFUNCTION, cc_curl_callback);
   curl_easy_setopt(wp->curl, CURLOPT_WRITEDATA, wp);
   curl_easy_setopt(wp->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
@@ -587,6 +593,12 @@ static int cc_init(void) /* {{{ */
   return 0;
 } /* }}} int cc_init */
 
+static int cc_shutdown(void) /* {{{ */
+{
+  curl_engine_shutdown();
+  return 0;
+} /* }}} int cc_shutdown */
+
 static void cc_submit(const web_page_t *wp, const web_match_t *wm, /* {{{ */
                       value_t value) {
   value_list_t vl = VALUE_LIST_INIT;
@@ -631,35 +643,26 @@ static void cc_submit_response_time(const web_page_t *wp, /* {{{ */
   plugin_dispatch_values(&vl);
 } /* }}} void cc_submit_response_time */
 
-static int cc_read_page(user_data_t *ud) /* {{{ */
-{
-
-  if ((ud == NULL) || (ud->data == NULL)) {
-    ERROR("curl plugin: cc_read_page: Invalid user data.");
-    return -1;
-  }
-
-  web_page_t *wp = (web_page_t *)ud->data;
-
-  int status;
-  cdtime_t start = 0;
-
-  if (wp->response_time)
-    start = cdtime();
+/* Called by the curl engine when the transfer started by cc_read_page has
+ * finished. */
+static void cc_page_done(CURL __attribute__((unused)) * curl, /* {{{ */
+                         CURLcode status, void *user_data) {
+  web_page_t *wp = user_data;
 
-  wp->buffer_fill = 0;
-
-  curl_easy_setopt(wp->curl, CURLOPT_URL, wp->url);
-
-  status = curl_easy_perform(wp->curl);
   if (status != CURLE_OK) {
     ERROR("curl plugin: curl_easy_perform failed with status %i: %s", status,
           wp->curl_errbuf);
-    return -1;
+    wp->buffer_fill = 0;
+    wp->last_status = -1;
+    return;
   }
+  wp->last_status = 0;
 
-  if (wp->response_time)
-    cc_submit_response_time(wp, CDTIME_T_TO_DOUBLE(cdtime() - start));
+  if (wp->response_time) {
+    double response_time = NAN;
+    curl_easy_getinfo(wp->curl, CURLINFO_TOTAL_TIME, &response_time);
+    cc_submit_response_time(wp, response_time);
+  }
   if (wp->stats != NULL)
     curl_stats_dispatch(wp->stats, wp->curl, NULL, "curl", wp->instance);
 
@@ -678,8 +681,8 @@ static int cc_read_page(user_data_t *ud) /* {{{ */
   for (web_match_t *wm = wp->matches; wm != NULL; wm = wm->next) {
     cu_match_value_t *mv;
 
-    status = match_apply(wm->match, wp->buffer);
-    if (status != 0) {
+    int match_status = match_apply(wm->match, wp->buffer);
+    if (match_status != 0) {
       WARNING("curl plugin: match_apply failed.");
       continue;
     }
@@ -694,10 +697,43 @@ static int cc_read_page(user_data_t *ud) /* {{{ */
     match_value_reset(mv);
   } /* for (wm = wp->matches; wm != NULL; wm = wm->next) */
 
-  return 0;
+  wp->buffer_fill = 0;
+} /* }}} void cc_page_done */
+
+/* Starts fetching the page. The transfer is performed by the curl engine,
+ * concurrently with all other pages, and the values are dispatched by
+ * cc_page_done(). Returns the result of the previous transfer, so that the
+ * daemon backs off from failing pages. */
+static int cc_read_page(user_data_t *ud) /* {{{ */
+{
+
+  if ((ud == NULL) || (ud->data == NULL)) {
+    ERROR("curl plugin: cc_read_page: Invalid user data.");
+    return -1;
+  }
+
+  web_page_t *wp = (web_page_t *)ud->data;
+
+  if (curl_engine_busy(wp->curl)) {
+    WARNING("curl plugin: The previous request for \"%s\" is still in "
+            "progress. Skipping this interval.",
+            wp->url);
+    return 0;
+  }
+  int last_status = wp->last_status;
+
+  int status = curl_engine_submit(wp->curl, cc_page_done, wp);
+  if (status != 0) {
+    ERROR("curl plugin: Submitting the request for \"%s\" failed: %s",
+          wp->url, STRERROR(status));
+    return -1;
+  }
+
+  return last_status;
 } /* }}} int cc_read_page */
 
 void module_register(void) {
   plugin_register_complex_config("curl", cc_config);
   plugin_register_init("curl", cc_init);
+  plugin_register_shutdown("curl", cc_shutdown);
 } /* void module_register */
@@ -24,8 +24,8 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/curl_engine/curl_engine.h"
 #include "utils/curl_stats/curl_stats.h"
 #include "utils_complain.h"
 
@@ -57,15 +57,31 @@ struct cj_key_s /* {{{ */
 };
 /* }}} */
 
-/* cj_tree_entry_t is a union of either a metric configuration ("key") or a tree
- * mapping array indexes / map keys to a descendant cj_tree_entry_t*. */
+/* cj_tree_entry_t is a union of either a metric configuration ("key") or a
+ * node of the trie built from the configured key paths, mapping array indexes
+ * / map keys to a descendant cj_tree_entry_t*. The children of a node are
+ * sorted by name, so they can be looked up with a binary search directly on
+ * the (not null-terminated) names passed by yajl. The wildcard "*" is stored
+ * separately in "any" and used if no other child matches. */
+typedef struct cj_tree_entry_s cj_tree_entry_t;
+
 typedef struct {
+  char *name;
+  size_t name_len;
+  cj_tree_entry_t *entry;
+} cj_tree_child_t;
+
+struct cj_tree_entry_s {
   enum { KEY, TREE } type;
   union {
-    c_avl_tree_t *tree;
+    struct {
+      cj_tree_child_t *children;
+      size_t children_num;
+      cj_tree_entry_t *any;
+    } tree;
     cj_key_t *key;
   };
-} cj_tree_entry_t;
+};
 
 /* cj_state_t is a stack providing the configuration relevant for the context
  * that is currently being parsed. If entry->type == KEY, the parser should
@@ -103,10 +119,15 @@ struct cj_s /* {{{ */
 
   CURL *curl;
   char curl_errbuf[CURL_ERROR_SIZE];
+  /* Result of the last transfer, returned by the next read. */
+  int last_status;
 
   yajl_handle yajl;
-  c_avl_tree_t *tree;
+  cj_tree_entry_t *tree;
   int depth;
+  /* Nesting level within a map or array that is skipped because no key is
+   * configured below it. Zero if nothing is being skipped. */
+  int skip;
   cj_state_t state[YAJL_MAX_DEPTH];
 };
 typedef struct cj_s cj_t; /* }}} */
@@ -118,6 +139,7 @@ typedef unsigned int yajl_len_t;
 #endif
 
 static int cj_read(user_data_t *ud);
+static int cj_parse_begin(cj_t *db);
 static void cj_submit_impl(cj_t *db, cj_key_t *key, value_t *value);
 
 /* cj_submit is a function pointer to cj_submit_impl, allowing the unit-test to
@@ -139,6 +161,10 @@ static size_t cj_curl_callback(void *buf, /* {{{ */
   if (db == NULL)
     return 0;
 
+  /* The parser is allocated when the first data arrives, see cj_parse_end. */
+  if ((db->yajl == NULL) && (cj_parse_begin(db) != 0))
+    return 0;
+
   status = yajl_parse(db->yajl, (unsigned char *)buf, len);
   if (status == yajl_status_ok)
     return len;
@@ -184,28 +210,73 @@ static int cj_get_type(cj_key_t *key) {
   return ds->ds[0].type;
 }
 
+static int cj_name_cmp(char const *a, size_t a_len, /* {{{ */
+                       char const *b, size_t b_len) {
+  int status = memcmp(a, b, COUCH_MIN(a_len, b_len));
+  if (status != 0)
+    return status;
+  if (a_len == b_len)
+    return 0;
+  return (a_len < b_len) ? -1 : 1;
+} /* }}} int cj_name_cmp */
+
+/* cj_tree_find returns the position of the child called "name" in "tree" or,
+ * if there is no such child, the position it would have to be inserted at.
+ * "*found" is set accordingly. */
+static size_t cj_tree_find(cj_tree_entry_t const *tree, /* {{{ */
+                           char const *name, size_t name_len, bool *found) {
+  size_t lo = 0;
+  size_t hi = tree->tree.children_num;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    cj_tree_child_t const *c = tree->tree.children + mid;
+
+    int cmp = cj_name_cmp(name, name_len, c->name, c->name_len);
+    if (cmp == 0) {
+      *found = true;
+      return mid;
+    }
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  *found = false;
+  return lo;
+} /* }}} size_t cj_tree_find */
+
+/* cj_tree_lookup returns the child of "tree" matching "name", falling back to
+ * the wildcard entry. Returns NULL if no key is configured for "name". */
+static cj_tree_entry_t *cj_tree_lookup(cj_tree_entry_t const *tree, /* {{{ */
+                                       char const *name, size_t name_len) {
+  bool found;
+  size_t i = cj_tree_find(tree, name, name_len, &found);
+  if (found)
+    return tree->tree.children[i].entry;
+  return tree->tree.any;
+} /* }}} cj_tree_entry_t *cj_tree_lookup */
+
 /* cj_load_key loads the configuration for "key" from the parent context and
- * sets either .key or .tree in the current context. */
-static int cj_load_key(cj_t *db, char const *key) {
+ * sets either .key or .tree in the current context. The name is only copied
+ * if an entry is configured; it is only needed to build the type instance. */
+static int cj_load_key(cj_t *db, char const *key, size_t key_len) {
   if (db == NULL || key == NULL || db->depth <= 0)
     return EINVAL;
 
-  sstrncpy(db->state[db->depth].name, key, sizeof(db->state[db->depth].name));
+  cj_state_t *state = db->state + db->depth;
+  cj_tree_entry_t const *parent = db->state[db->depth - 1].entry;
 
-  if (db->state[db->depth - 1].entry == NULL ||
-      db->state[db->depth - 1].entry->type != TREE) {
+  state->entry = NULL;
+  if (parent == NULL || parent->type != TREE)
     return 0;
-  }
 
-  c_avl_tree_t *tree = db->state[db->depth - 1].entry->tree;
-  cj_tree_entry_t *e = NULL;
-
-  if (c_avl_get(tree, key, (void *)&e) == 0) {
-    db->state[db->depth].entry = e;
-  } else if (c_avl_get(tree, CJ_ANY, (void *)&e) == 0) {
-    db->state[db->depth].entry = e;
-  } else {
-    db->state[db->depth].entry = NULL;
+  state->entry = cj_tree_lookup(parent, key, key_len);
+  if (state->entry != NULL) {
+    key_len = COUCH_MIN(key_len, sizeof(state->name) - 1);
+    memcpy(state->name, key, key_len);
+    state->name[key_len] = '\0';
   }
 
   return 0;
@@ -218,8 +289,19 @@ static void cj_advance_array(cj_t *db) {
   db->state[db->depth].index++;
 
   char name[DATA_MAX_NAME_LEN];
-  snprintf(name, sizeof(name), "%d", db->state[db->depth].index);
-  cj_load_key(db, name);
+  int len = snprintf(name, sizeof(name), "%d", db->state[db->depth].index);
+  cj_load_key(db, name, (size_t)len);
+}
+
+/* cj_skip_container returns true if the map or array starting in the current
+ * context contains no configured key, i.e. if the entire subtree can be
+ * skipped. */
+static bool cj_skip_container(cj_t *db) {
+  if (db->skip > 0)
+    return true;
+
+  cj_tree_entry_t const *e = db->state[db->depth].entry;
+  return (e == NULL) || (e->type != TREE);
 }
 
 /* yajl callbacks */
@@ -227,6 +309,11 @@ static void cj_advance_array(cj_t *db) {
 #define CJ_CB_CONTINUE 1
 
 static int cj_cb_null(void *ctx) {
+  cj_t *db = (cj_t *)ctx;
+
+  if (db->skip > 0)
+    return CJ_CB_CONTINUE;
+
   cj_advance_array(ctx);
   return CJ_CB_CONTINUE;
 }
@@ -234,6 +321,9 @@ static int cj_cb_null(void *ctx) {
 static int cj_cb_number(void *ctx, const char *number, yajl_len_t number_len) {
   cj_t *db = (cj_t *)ctx;
 
+  if (db->skip > 0)
+    return CJ_CB_CONTINUE;
+
   /* Create a null-terminated version of the string. */
   char buffer[number_len + 1];
   memcpy(buffer, number, number_len);
@@ -270,12 +360,12 @@ static int cj_cb_number(void *ctx, const char *number, yajl_len_t number_len) {
  * NULL. */
 static int cj_cb_map_key(void *ctx, unsigned char const *in_name,
                          yajl_len_t in_name_len) {
-  char name[in_name_len + 1];
+  cj_t *db = (cj_t *)ctx;
 
-  memmove(name, in_name, in_name_len);
-  name[sizeof(name) - 1] = '\0';
+  if (db->skip > 0)
+    return CJ_CB_CONTINUE;
 
-  if (cj_load_key(ctx, name) != 0)
+  if (cj_load_key(db, (char const *)in_name, (size_t)in_name_len) != 0)
     return CJ_CB_ABORT;
 
   return CJ_CB_CONTINUE;
@@ -287,6 +377,9 @@ static int cj_cb_string(void *ctx, const unsigned char *val, yajl_len_t len) {
 } /* int cj_cb_string */
 
 static int cj_cb_boolean(void *ctx, int boolVal) {
+  if (((cj_t *)ctx)->skip > 0)
+    return CJ_CB_CONTINUE;
+
   if (boolVal)
     return cj_cb_number(ctx, "1", 1);
   else
@@ -295,6 +388,16 @@ static int cj_cb_boolean(void *ctx, int boolVal) {
 
 static int cj_cb_end(void *ctx) {
   cj_t *db = (cj_t *)ctx;
+
+  if (db->skip > 0) {
+    /* Once the outermost skipped container ends, continue in the context it
+     * was found in. */
+    db->skip--;
+    if (db->skip == 0)
+      cj_advance_array(ctx);
+    return CJ_CB_CONTINUE;
+  }
+
   memset(&db->state[db->depth], 0, sizeof(db->state[db->depth]));
   db->depth--;
   cj_advance_array(ctx);
@@ -304,6 +407,11 @@ static int cj_cb_end(void *ctx) {
 static int cj_cb_start_map(void *ctx) {
   cj_t *db = (cj_t *)ctx;
 
+  if (cj_skip_container(db)) {
+    db->skip++;
+    return CJ_CB_CONTINUE;
+  }
+
   if ((db->depth + 1) >= YAJL_MAX_DEPTH) {
     ERROR("curl_json plugin: %s depth exceeds max, aborting.",
           db->url ? db->url : db->sock);
@@ -318,6 +426,11 @@ static int cj_cb_end_map(void *ctx) { return cj_cb_end(ctx); }
 static int cj_cb_start_array(void *ctx) {
   cj_t *db = (cj_t *)ctx;
 
+  if (cj_skip_container(db)) {
+    db->skip++;
+    return CJ_CB_CONTINUE;
+  }
+
   if ((db->depth + 1) >= YAJL_MAX_DEPTH) {
     ERROR("curl_json plugin: %s depth exceeds max, aborting.",
           db->url ? db->url : db->sock);
@@ -327,14 +440,15 @@ static int cj_cb_start_array(void *ctx) {
   db->state[db->depth].in_array = true;
   db->state[db->depth].index = 0;
 
-  cj_load_key(db, "0");
+  cj_load_key(db, "0", 1);
 
   return CJ_CB_CONTINUE;
 }
 
 static int cj_cb_end_array(void *ctx) {
   cj_t *db = (cj_t *)ctx;
-  db->state[db->depth].in_array = false;
+  if (db->skip == 0)
+    db->state[db->depth].in_array = false;
   return cj_cb_end(ctx);
 }
 
@@ -360,22 +474,23 @@ static void cj_key_free(cj_key_t *key) /* {{{ */
   sfree(key);
 } /* }}} void cj_key_free */
 
-static void cj_tree_free(c_avl_tree_t *tree) /* {{{ */
+static void cj_tree_free(cj_tree_entry_t *e) /* {{{ */
 {
-  char *name;
-  cj_tree_entry_t *e;
-
-  while (c_avl_pick(tree, (void *)&name, (void *)&e) == 0) {
-    sfree(name);
+  if (e == NULL)
+    return;
 
-    if (e->type == KEY)
-      cj_key_free(e->key);
-    else
-      cj_tree_free(e->tree);
-    sfree(e);
+  if (e->type == KEY) {
+    cj_key_free(e->key);
+  } else {
+    for (size_t i = 0; i < e->tree.children_num; i++) {
+      sfree(e->tree.children[i].name);
+      cj_tree_free(e->tree.children[i].entry);
+    }
+    sfree(e->tree.children);
+    cj_tree_free(e->tree.any);
   }
 
-  c_avl_destroy(tree);
+  sfree(e);
 } /* }}} void cj_tree_free */
 
 static void cj_free(void *arg) /* {{{ */
@@ -389,10 +504,16 @@ static void cj_free(void *arg) /* {{{ */
   if (db == NULL)
     return;
 
-  if (db->curl != NULL)
+  if (db->curl != NULL) {
+    curl_engine_cancel(db->curl);
     curl_easy_cleanup(db->curl);
+  }
   db->curl = NULL;
 
+  if (db->yajl != NULL)
+    yajl_free(db->yajl);
+  db->yajl = NULL;
+
   if (db->tree != NULL)
     cj_tree_free(db->tree);
   db->tree = NULL;
@@ -417,9 +538,56 @@ static void cj_free(void *arg) /* {{{ */
 
 /* Configuration handling functions {{{ */
 
-static c_avl_tree_t *cj_avl_create(void) {
-  return c_avl_create((int (*)(const void *, const void *))strcmp);
-}
+/* cj_tree_add inserts "e" as child "name" of "tree", keeping the children
+ * sorted. */
+static int cj_tree_add(cj_tree_entry_t *tree, char const *name, /* {{{ */
+                       cj_tree_entry_t *e) {
+  if (strcmp(CJ_ANY, name) == 0) {
+    if (tree->tree.any != NULL)
+      return EEXIST;
+    tree->tree.any = e;
+    return 0;
+  }
+
+  size_t name_len = strlen(name);
+  bool found;
+  size_t pos = cj_tree_find(tree, name, name_len, &found);
+  if (found)
+    return EEXIST;
+
+  cj_tree_child_t *tmp =
+      realloc(tree->tree.children,
+              (tree->tree.children_num + 1) * sizeof(*tree->tree.children));
+  if (tmp == NULL)
+    return ENOMEM;
+  tree->tree.children = tmp;
+
+  char *name_copy = strdup(name);
+  if (name_copy == NULL)
+    return ENOMEM;
+
+  memmove(tmp + pos + 1, tmp + pos,
+          (tree->tree.children_num - pos) * sizeof(*tmp));
+  tmp[pos] = (cj_tree_child_t){
+      .name = name_copy,
+      .name_len = name_len,
+      .entry = e,
+  };
+  tree->tree.children_num++;
+  return 0;
+} /* }}} int cj_tree_add */
+
+/* cj_tree_get returns the child "name" of "tree", not considering the
+ * wildcard as a match for other names. */
+static cj_tree_entry_t *cj_tree_get(cj_tree_entry_t *tree, /* {{{ */
+                                    char const *name) {
+  if (strcmp(CJ_ANY, name) == 0)
+    return tree->tree.any;
+
+  bool found;
+  size_t i = cj_tree_find(tree, name, strlen(name), &found);
+  return found ? tree->tree.children[i].entry : NULL;
+} /* }}} cj_tree_entry_t *cj_tree_get */
 
 static int cj_config_append_string(const char *name,
                                    struct curl_slist **dest, /* {{{ */
@@ -447,10 +615,14 @@ static int cj_config_append_string(const char *name,
  * { "httpd": { "requests": { "count": $key, "current": $key } } }
  */
 static int cj_append_key(cj_t *db, cj_key_t *key) { /* {{{ */
-  if (db->tree == NULL)
-    db->tree = cj_avl_create();
+  if (db->tree == NULL) {
+    db->tree = calloc(1, sizeof(*db->tree));
+    if (db->tree == NULL)
+      return ENOMEM;
+    db->tree->type = TREE;
+  }
 
-  c_avl_tree_t *tree = db->tree;
+  cj_tree_entry_t *tree = db->tree;
 
   char const *start = key->path;
   if (*start == '/')
@@ -467,21 +639,24 @@ static int cj_append_key(cj_t *db, cj_key_t *key) { /* {{{ */
     len = COUCH_MIN(len, sizeof(name) - 1);
     sstrncpy(name, start, len + 1);
 
-    cj_tree_entry_t *e;
-    if (c_avl_get(tree, name, (void *)&e) != 0) {
+    cj_tree_entry_t *e = cj_tree_get(tree, name);
+    if (e == NULL) {
       e = calloc(1, sizeof(*e));
       if (e == NULL)
         return ENOMEM;
       e->type = TREE;
-      e->tree = cj_avl_create();
 
-      c_avl_insert(tree, strdup(name), e);
+      int status = cj_tree_add(tree, name, e);
+      if (status != 0) {
+        sfree(e);
+        return status;
+      }
     }
 
     if (e->type != TREE)
       return EINVAL;
 
-    tree = e->tree;
+    tree = e;
     start = end + 1;
   }
 
@@ -496,7 +671,13 @@ static int cj_append_key(cj_t *db, cj_key_t *key) { /* {{{ */
   e->type = KEY;
   e->key = key;
 
-  c_avl_insert(tree, strdup(start), e);
+  int status = cj_tree_add(tree, start, e);
+  if (status != 0) {
+    if (status == EEXIST)
+      ERROR("curl_json plugin: duplicate key: %s", key->path);
+    sfree(e);
+    return status;
+  }
   return 0;
 } /* }}} int cj_append_key */
 
@@ -577,6 +758,7 @@ static int cj_init_curl(cj_t *db) /* {{{ */
   }
 
   curl_easy_setopt(db->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
   curl_easy_setopt(db->curl, CURLOPT_WRITEFUNCTION, cj_curl_callback);
   curl_easy_setopt(db->curl, CURLOPT_WRITEDATA, db);
   curl_easy_setopt(db->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
@@ -877,19 +1059,80 @@ static int cj_sock_perform(cj_t *db) /* {{{ */
   return 0;
 } /* }}} int cj_sock_perform */
 
-static int cj_curl_perform(cj_t *db) /* {{{ */
+/* cj_parse_begin allocates the JSON parser and resets the parser state. */
+static int cj_parse_begin(cj_t *db) /* {{{ */
 {
-  int status;
+  db->yajl = yajl_alloc(&ycallbacks,
+#if HAVE_YAJL_V2
+                        /* alloc funcs = */ NULL,
+#else
+                        /* alloc funcs = */ NULL, NULL,
+#endif
+                        /* context = */ (void *)db);
+  if (db->yajl == NULL) {
+    ERROR("curl_json plugin: yajl_alloc failed.");
+    return -1;
+  }
+
+  db->depth = 0;
+  db->skip = 0;
+  memset(&db->state, 0, sizeof(db->state));
+  db->state[0].entry = db->tree;
+
+  return 0;
+} /* }}} int cj_parse_begin */
+
+/* cj_parse_end finishes parsing the document if "complete" is true, i.e. if
+ * it has been received successfully, and frees the parser. */
+static int cj_parse_end(cj_t *db, bool complete) /* {{{ */
+{
+  int status = complete ? 0 : -1;
+
+  /* Nothing has been received; let yajl report the empty document. */
+  if (complete && (db->yajl == NULL) && (cj_parse_begin(db) != 0))
+    return -1;
+  if (db->yajl == NULL)
+    return status;
+
+  if (complete) {
+#if HAVE_YAJL_V2
+    status = yajl_complete_parse(db->yajl);
+#else
+    status = yajl_parse_complete(db->yajl);
+#endif
+    if (status != yajl_status_ok) {
+      unsigned char *errmsg;
+
+      errmsg = yajl_get_error(db->yajl, /* verbose = */ 0,
+                              /* jsonText = */ NULL, /* jsonTextLen = */ 0);
+      ERROR("curl_json plugin: yajl_parse_complete failed: %s",
+            (char *)errmsg);
+      yajl_free_error(db->yajl, errmsg);
+      status = -1;
+    }
+  }
+
+  yajl_free(db->yajl);
+  db->yajl = NULL;
+  db->state[0].entry = NULL;
+
+  return status;
+} /* }}} int cj_parse_end */
+
+/* Called by the curl engine when the transfer started by cj_read has
+ * finished. The document has been parsed while it was received. */
+static void cj_curl_done(CURL __attribute__((unused)) * curl, /* {{{ */
+                         CURLcode status, void *user_data) {
+  cj_t *db = user_data;
   long rc;
   char *url;
 
-  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
-
-  status = curl_easy_perform(db->curl);
   if (status != CURLE_OK) {
     ERROR("curl_json plugin: curl_easy_perform failed with status %i: %s (%s)",
           status, db->curl_errbuf, db->url);
-    return -1;
+    cj_parse_end(db, false);
+    db->last_status = -1;
+    return;
   }
   if (db->stats != NULL)
     curl_stats_dispatch(db->stats, db->curl, cj_host(db), "curl_json",
@@ -903,60 +1146,13 @@ static int cj_curl_perform(cj_t *db) /* {{{ */
     ERROR("curl_json plugin: curl_easy_perform failed with "
           "response code %ld (%s)",
           rc, url);
-    return -1;
-  }
-  return 0;
-} /* }}} int cj_curl_perform */
-
-static int cj_perform(cj_t *db) /* {{{ */
-{
-  int status;
-  yajl_handle yprev = db->yajl;
-
-  db->yajl = yajl_alloc(&ycallbacks,
-#if HAVE_YAJL_V2
-                        /* alloc funcs = */ NULL,
-#else
-                        /* alloc funcs = */ NULL, NULL,
-#endif
-                        /* context = */ (void *)db);
-  if (db->yajl == NULL) {
-    ERROR("curl_json plugin: yajl_alloc failed.");
-    db->yajl = yprev;
-    return -1;
-  }
-
-  if (db->url)
-    status = cj_curl_perform(db);
-  else
-    status = cj_sock_perform(db);
-  if (status < 0) {
-    yajl_free(db->yajl);
-    db->yajl = yprev;
-    return -1;
-  }
-
-#if HAVE_YAJL_V2
-  status = yajl_complete_parse(db->yajl);
-#else
-  status = yajl_parse_complete(db->yajl);
-#endif
-  if (status != yajl_status_ok) {
-    unsigned char *errmsg;
-
-    errmsg = yajl_get_error(db->yajl, /* verbose = */ 0,
-                            /* jsonText = */ NULL, /* jsonTextLen = */ 0);
-    ERROR("curl_json plugin: yajl_parse_complete failed: %s", (char *)errmsg);
-    yajl_free_error(db->yajl, errmsg);
-    yajl_free(db->yajl);
-    db->yajl = yprev;
-    return -1;
+    cj_parse_end(db, false);
+    db->last_status = -1;
+    return;
   }
 
-  yajl_free(db->yajl);
-  db->yajl = yprev;
-  return 0;
-} /* }}} int cj_perform */
+  db->last_status = cj_parse_end(db, true);
+} /* }}} void cj_curl_done */
 
 static int cj_read(user_data_t *ud) /* {{{ */
 {
@@ -969,21 +1165,30 @@ static int cj_read(user_data_t *ud) /* {{{ */
 
   db = (cj_t *)ud->data;
 
-  db->depth = 0;
-  memset(&db->state, 0, sizeof(db->state));
-
-  /* This is not a compound literal because EPEL6's GCC is not cool enough to
-   * handle anonymous unions within compound literals. */
-  cj_tree_entry_t root = {0};
-  root.type = TREE;
-  root.tree = db->tree;
-  db->state[0].entry = &root;
+  if (db->url == NULL) {
+    int status = cj_sock_perform(db);
+    return cj_parse_end(db, status == 0);
+  }
 
-  int status = cj_perform(db);
+  /* The transfer is performed by the curl engine, concurrently with all
+   * other URLs, and finished by cj_curl_done(). Return the result of the
+   * previous transfer, so that the daemon backs off from failing URLs. */
+  if (curl_engine_busy(db->curl)) {
+    WARNING("curl_json plugin: The previous request for \"%s\" is still in "
+            "progress. Skipping this interval.",
+            db->url);
+    return 0;
+  }
+  int last_status = db->last_status;
 
-  db->state[0].entry = NULL;
+  int status = curl_engine_submit(db->curl, cj_curl_done, db);
+  if (status != 0) {
+    ERROR("curl_json plugin: Submitting the request for \"%s\" failed: %s",
+          db->url, STRERROR(status));
+    return -1;
+  }
 
-  return status;
+  return last_status;
 } /* }}} int cj_read */
 
 static int cj_init(void) /* {{{ */
@@ -994,7 +1199,14 @@ static int cj_init(void) /* {{{ */
   return 0;
 } /* }}} int cj_init */
 
+static int cj_shutdown(void) /* {{{ */
+{
+  curl_engine_shutdown();
+  return 0;
+} /* }}} int cj_shutdown */
+
 void module_register(void) {
   plugin_register_complex_config("curl_json", cj_config);
   plugin_register_init("curl_json", cj_init);
+  plugin_register_shutdown("curl_json", cj_shutdown);
 } /* void module_register */
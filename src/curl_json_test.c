@@ -11,6 +11,9 @@
 #include "curl_json.c"
 
 #include "testing.h"
+#include "utils/avltree/avltree.h"
+
+#define SPARSE_ELEMENTS 1000
 
 static void test_submit(cj_t *db, cj_key_t *key, value_t *value) {
   /* hack: we repurpose db->curl to store received values. */
@@ -33,38 +36,36 @@ static derive_t test_metric(cj_t *db, char const *path) {
   return -1;
 }
 
-static cj_t *test_setup(char *json, char *key_path) {
+static cj_t *test_create(void) {
   cj_t *db = calloc(1, sizeof(*db));
-  db->yajl = yajl_alloc(&ycallbacks,
-#if HAVE_YAJL_V2
-                        /* alloc funcs = */ NULL,
-#else
-                        /* alloc funcs = */ NULL, NULL,
-#endif
-                        /* context = */ (void *)db);
 
   /* hack; see above. */
-  db->curl = (void *)cj_avl_create();
+  db->curl = (void *)c_avl_create((int (*)(const void *, const void *))strcmp);
+
+  return db;
+}
 
+static int test_add_key(cj_t *db, char *key_path) {
   cj_key_t *key = calloc(1, sizeof(*key));
   key->path = strdup(key_path);
   key->type = strdup("MAGIC");
 
-  assert(cj_append_key(db, key) == 0);
+  int status = cj_append_key(db, key);
+  if (status != 0)
+    cj_key_free(key);
+  return status;
+}
 
-  cj_tree_entry_t root = {0};
-  root.type = TREE;
-  root.tree = db->tree;
-  db->state[0].entry = &root;
+static void test_feed(cj_t *db, char *json, size_t json_len) {
+  cj_curl_callback(json, json_len, 1, db);
+  cj_parse_end(db, /* complete = */ true);
+}
 
-  cj_curl_callback(json, strlen(json), 1, db);
-#if HAVE_YAJL_V2
-  yajl_complete_parse(db->yajl);
-#else
-  yajl_parse_complete(db->yajl);
-#endif
+static cj_t *test_setup(char *json, char *key_path) {
+  cj_t *db = test_create();
 
-  db->state[0].entry = NULL;
+  assert(test_add_key(db, key_path) == 0);
+  test_feed(db, json, strlen(json));
 
   return db;
 }
@@ -81,9 +82,6 @@ static void test_teardown(cj_t *db) {
   }
   c_avl_destroy(values);
 
-  yajl_free(db->yajl);
-  db->yajl = NULL;
-
   cj_free(db);
 }
 
@@ -126,6 +124,13 @@ DEF_TEST(parse) {
       {"{\"a\":[[10,11,12,13,14]]}", "a/0/2", 12},
       {"{\"a\":[[10,11,12,13,14]]}", "a/0/3", 13},
       {"{\"a\":[[10,11,12,13,14]]}", "a/0/4", 14},
+      /* keys following skipped subtrees */
+      {"{\"s\":{\"t\":[1,{\"u\":[2]}],\"v\":3},\"foo\":42}", "foo", 42},
+      {"[[{\"a\":[1]},[2]],11]", "1", 11},
+      {"{\"x\":[{\"y\":{\"z\":1}},{\"y\":2}]}", "x/1/y", 2},
+      {"{\"foo\":{\"bar\":1},\"foo2\":2}", "foo2", 2},
+      /* wildcard after a skipped sibling */
+      {"{\"a\":[{\"n\":1},{\"m\":2},{\"n\":3}]}", "a/*/m", 2},
   };
 
   for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
@@ -139,10 +144,86 @@ DEF_TEST(parse) {
   return 0;
 }
 
+DEF_TEST(tree) {
+  char *paths[] = {"b/y", "a/x", "c", "b/*/z", "a/*", "aa", "b/x"};
+  cj_t *db = test_create();
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(paths); i++)
+    CHECK_ZERO(test_add_key(db, paths[i]));
+
+  /* Duplicates and keys below metrics are rejected. */
+  EXPECT_EQ_INT(EEXIST, test_add_key(db, "a/x"));
+  EXPECT_EQ_INT(EINVAL, test_add_key(db, "c/d"));
+
+  /* Children are sorted, regardless of the order of configuration. */
+  EXPECT_EQ_INT(4, (int)db->tree->tree.children_num);
+  EXPECT_EQ_STR("a", db->tree->tree.children[0].name);
+  EXPECT_EQ_STR("aa", db->tree->tree.children[1].name);
+  EXPECT_EQ_STR("b", db->tree->tree.children[2].name);
+  EXPECT_EQ_STR("c", db->tree->tree.children[3].name);
+
+  cj_tree_entry_t *a = cj_tree_lookup(db->tree, "a", 1);
+  CHECK_NOT_NULL(a);
+  EXPECT_EQ_INT(TREE, a->type);
+  EXPECT_EQ_PTR(a->tree.children[0].entry, cj_tree_lookup(a, "x", 1));
+  EXPECT_EQ_PTR(a->tree.any, cj_tree_lookup(a, "xyz", 3));
+  /* Names are compared including their length. */
+  EXPECT_EQ_PTR(NULL, cj_tree_lookup(db->tree, "aaa", 3));
+  EXPECT_EQ_PTR(cj_tree_lookup(db->tree, "a", 1),
+                cj_tree_lookup(db->tree, "ab", 1));
+
+  char json[] = "{\"a\":{\"x\":1,\"q\":2},\"aa\":3,"
+                "\"b\":{\"x\":4,\"y\":5,\"w\":{\"z\":6}},\"c\":7}";
+  test_feed(db, json, strlen(json));
+  EXPECT_EQ_INT(1, test_metric(db, "a/x"));
+  EXPECT_EQ_INT(2, test_metric(db, "a/*"));
+  EXPECT_EQ_INT(3, test_metric(db, "aa"));
+  EXPECT_EQ_INT(4, test_metric(db, "b/x"));
+  EXPECT_EQ_INT(5, test_metric(db, "b/y"));
+  EXPECT_EQ_INT(6, test_metric(db, "b/*/z"));
+  EXPECT_EQ_INT(7, test_metric(db, "c"));
+
+  test_teardown(db);
+  return 0;
+}
+
+/* Parses a large document in which only few keys are configured, such as the
+ * statistics of a busy server. The skipped subtrees don't confuse the
+ * parser. */
+DEF_TEST(sparse) {
+  size_t json_size = 256 * SPARSE_ELEMENTS;
+  char *json = malloc(json_size);
+  CHECK_NOT_NULL(json);
+
+  size_t len = snprintf(json, json_size, "{\"nodes\":[");
+  for (int i = 0; i < SPARSE_ELEMENTS; i++)
+    len += snprintf(json + len, json_size - len,
+                    "%s{\"name\":\"node%d\",\"tags\":[\"a\",\"b\",\"c\"],"
+                    "\"stats\":{\"requests\":%d,\"errors\":%d,"
+                    "\"latency\":{\"p50\":15,\"p99\":95}}}",
+                    (i == 0) ? "" : ",", i, i, i % 7);
+  len += snprintf(json + len, json_size - len,
+                  "],\"summary\":{\"requests\":%d,\"errors\":0}}",
+                  SPARSE_ELEMENTS);
+
+  cj_t *db = test_create();
+  CHECK_ZERO(test_add_key(db, "summary/requests"));
+  CHECK_ZERO(test_add_key(db, "nodes/42/stats/requests"));
+  test_feed(db, json, len);
+  EXPECT_EQ_INT(SPARSE_ELEMENTS, test_metric(db, "summary/requests"));
+  EXPECT_EQ_INT(42, test_metric(db, "nodes/42/stats/requests"));
+  test_teardown(db);
+
+  free(json);
+  return 0;
+}
+
 int main(void) {
   cj_submit = test_submit;
 
   RUN_TEST(parse);
+  RUN_TEST(tree);
+  RUN_TEST(sparse);
 
   END_TEST;
 }
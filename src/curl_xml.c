@@ -23,6 +23,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_engine/curl_engine.h"
 #include "utils/curl_stats/curl_stats.h"
 #include "utils_llist.h"
 
@@ -97,6 +98,8 @@ struct cx_s /* {{{ */
   char *buffer;
   size_t buffer_size;
   size_t buffer_fill;
+  /* Result of the last transfer, returned by the next read. */
+  int last_status;
 
   llist_t *xpath_list; /* list of xpath blocks */
 };
@@ -178,8 +181,10 @@ static void cx_free(void *arg) /* {{{ */
   if (db == NULL)
     return;
 
-  if (db->curl != NULL)
+  if (db->curl != NULL) {
+    curl_engine_cancel(db->curl);
     curl_easy_cleanup(db->curl);
+  }
   db->curl = NULL;
 
   if (db->xpath_list != NULL)
@@ -539,26 +544,20 @@ static int cx_parse_xml(cx_t *db, char *xml) /* {{{ */
   return status;
 } /* }}} cx_parse_xml */
 
-static int cx_read(user_data_t *ud) /* {{{ */
-{
-  if ((ud == NULL) || (ud->data == NULL)) {
-    ERROR("curl_xml plugin: cx_read: Invalid user data.");
-    return -1;
-  }
-
+/* Called by the curl engine when the transfer started by cx_read has
+ * finished. */
+static void cx_curl_done(CURL __attribute__((unused)) * curl, /* {{{ */
+                         CURLcode status, void *user_data) {
+  cx_t *db = user_data;
   long rc;
   char *url;
-  cx_t *db = (cx_t *)ud->data;
 
-  db->buffer_fill = 0;
-
-  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
-
-  int status = curl_easy_perform(db->curl);
   if (status != CURLE_OK) {
     ERROR("curl_xml plugin: curl_easy_perform failed with status %i: %s (%s)",
           status, db->curl_errbuf, db->url);
-    return -1;
+    db->buffer_fill = 0;
+    db->last_status = -1;
+    return;
   }
   if (db->stats != NULL)
     curl_stats_dispatch(db->stats, db->curl, cx_host(db), "curl_xml",
@@ -572,13 +571,44 @@ static int cx_read(user_data_t *ud) /* {{{ */
     ERROR(
         "curl_xml plugin: curl_easy_perform failed with response code %ld (%s)",
         rc, url);
-    return -1;
+    db->buffer_fill = 0;
+    db->last_status = -1;
+    return;
   }
 
-  status = cx_parse_xml(db, db->buffer);
+  db->last_status = cx_parse_xml(db, db->buffer);
   db->buffer_fill = 0;
+} /* }}} void cx_curl_done */
 
-  return status;
+/* Starts fetching the document. The transfer is performed by the curl engine,
+ * concurrently with all other URLs, and parsed by cx_curl_done(). Returns the
+ * result of the previous transfer, so that the daemon backs off from failing
+ * URLs. */
+static int cx_read(user_data_t *ud) /* {{{ */
+{
+  if ((ud == NULL) || (ud->data == NULL)) {
+    ERROR("curl_xml plugin: cx_read: Invalid user data.");
+    return -1;
+  }
+
+  cx_t *db = (cx_t *)ud->data;
+
+  if (curl_engine_busy(db->curl)) {
+    WARNING("curl_xml plugin: The previous request for \"%s\" is still in "
+            "progress. Skipping this interval.",
+            db->url);
+    return 0;
+  }
+  int last_status = db->last_status;
+
+  int status = curl_engine_submit(db->curl, cx_curl_done, db);
+  if (status != 0) {
+    ERROR("curl_xml plugin: Submitting the request for \"%s\" failed: %s",
+          db->url, STRERROR(status));
+    return -1;
+  }
+
+  return last_status;
 } /* }}} int cx_read */
 
 /* Configuration handling functions {{{ */
@@ -731,6 +761,7 @@ static int cx_init_curl(cx_t *db) /* {{{ */
   }
 
   curl_easy_setopt(db->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(db->curl, CURLOPT_URL, db->url);
   curl_easy_setopt(db->curl, CURLOPT_WRITEFUNCTION, cx_curl_callback);
   curl_easy_setopt(db->curl, CURLOPT_WRITEDATA, db);
   curl_easy_setopt(db->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
@@ -969,7 +1000,14 @@ static int cx_init(void) /* {{{ */
   return 0;
 } /* }}} int cx_init */
 
+static int cx_shutdown(void) /* {{{ */
+{
+  curl_engine_shutdown();
+  return 0;
+} /* }}} int cx_shutdown */
+
 void module_register(void) {
   plugin_register_complex_config("curl_xml", cx_config);
   plugin_register_init("curl_xml", cx_init);
+  plugin_register_shutdown("curl_xml", cx_shutdown);
 } /* void module_register */
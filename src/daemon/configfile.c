@@ -35,6 +35,8 @@
 #include "types_list.h"
 #include "utils/common/common.h"
 
+#include <pthread.h>
+
 #if HAVE_WORDEXP_H
 #include <wordexp.h>
 #endif /* HAVE_WORDEXP_H */
@@ -108,11 +110,13 @@ static cf_global_option_t cf_global_options[] = {
     {"Interval", NULL, 0, NULL},
     {"ReadThreads", NULL, 0, "5"},
     {"WriteThreads", NULL, 0, "5"},
+    {"InitThreads", NULL, 0, "5"},
     {"WriteQueueLimitHigh", NULL, 0, NULL},
     {"WriteQueueLimitLow", NULL, 0, NULL},
     {"Timeout", NULL, 0, "2"},
     {"AutoLoadPlugin", NULL, 0, "false"},
     {"CollectInternalStats", NULL, 0, "false"},
+    {"TypesDBCache", NULL, 0, "false"},
     {"PreCacheChain", NULL, 0, "PreCache"},
     {"PostCacheChain", NULL, 0, "PostCache"},
     {"MaxReadInterval", NULL, 0, "86400"}};
@@ -542,6 +546,121 @@ static int cf_ci_append_children(oconfig_item_t *dst, oconfig_item_t *src) {
 #define CF_MAX_DEPTH 8
 static oconfig_item_t *cf_read_generic(const char *path, const char *pattern,
                                        int depth);
+static oconfig_item_t *cf_read_file(const char *file, const char *pattern,
+                                    int depth);
+static oconfig_item_t *cf_read_dir(const char *dir, const char *pattern,
+                                   int depth);
+
+/* Included files and directories are parsed concurrently by up to
+ * CF_MAX_READ_THREADS threads (in addition to the thread calling cf_read). */
+#define CF_MAX_READ_THREADS 8
+static pthread_mutex_t cf_read_lock = PTHREAD_MUTEX_INITIALIZER;
+static int cf_read_threads_num;
+
+/* wordexp(3) is not thread-safe. */
+static pthread_mutex_t cf_wordexp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static cdtime_t cf_parse_duration;
+static cdtime_t cf_dispatch_duration;
+
+typedef struct {
+  const char *path;
+  bool is_dir;
+  oconfig_item_t *result;
+} cf_read_item_t;
+
+typedef struct {
+  cf_read_item_t *items;
+  size_t items_num;
+  const char *pattern;
+  int depth;
+
+  pthread_mutex_t lock;
+  size_t next;
+} cf_read_job_t;
+
+static void *cf_read_worker(void *arg) {
+  cf_read_job_t *job = arg;
+
+  while (42) {
+    pthread_mutex_lock(&job->lock);
+    size_t i = job->next++;
+    pthread_mutex_unlock(&job->lock);
+
+    if (i >= job->items_num)
+      return NULL;
+
+    cf_read_item_t *item = job->items + i;
+    if (item->is_dir)
+      item->result = cf_read_dir(item->path, job->pattern, job->depth);
+    else
+      item->result = cf_read_file(item->path, job->pattern, job->depth);
+  }
+} /* void *cf_read_worker */
+
+/* Reads all "items" and stores the parsed trees in their "result" member,
+ * which is NULL if reading the item failed. The calling thread takes part in
+ * the work, so this also works when no more threads may be started, e.g. for
+ * nested includes. */
+static void cf_read_items(cf_read_item_t *items, size_t items_num,
+                          const char *pattern, int depth) {
+  cf_read_job_t job = {
+      .items = items,
+      .items_num = items_num,
+      .pattern = pattern,
+      .depth = depth,
+  };
+  pthread_t threads[CF_MAX_READ_THREADS];
+  int threads_num = 0;
+
+  pthread_mutex_init(&job.lock, NULL);
+
+  pthread_mutex_lock(&cf_read_lock);
+  while (((size_t)threads_num + 1 < items_num) &&
+         (cf_read_threads_num < CF_MAX_READ_THREADS)) {
+    if (pthread_create(threads + threads_num, NULL, cf_read_worker, &job) !=
+        0)
+      break;
+    threads_num++;
+    cf_read_threads_num++;
+  }
+  pthread_mutex_unlock(&cf_read_lock);
+
+  cf_read_worker(&job);
+
+  for (int i = 0; i < threads_num; i++)
+    pthread_join(threads[i], NULL);
+
+  pthread_mutex_lock(&cf_read_lock);
+  cf_read_threads_num -= threads_num;
+  pthread_mutex_unlock(&cf_read_lock);
+
+  pthread_mutex_destroy(&job.lock);
+} /* void cf_read_items */
+
+/* Stats "path" and initializes "item" accordingly. Returns non-zero if "path"
+ * is neither a file nor a directory and should be skipped. */
+static int cf_read_item_init(cf_read_item_t *item, const char *path) {
+  struct stat statbuf;
+
+  if (stat(path, &statbuf) != 0) {
+    WARNING("configfile: stat (%s) failed: %s", path, STRERRNO);
+    return -1;
+  }
+
+  if (S_ISREG(statbuf.st_mode))
+    item->is_dir = false;
+  else if (S_ISDIR(statbuf.st_mode))
+    item->is_dir = true;
+  else {
+    WARNING("configfile: %s is neither a file nor a directory.", path);
+    return -1;
+  }
+
+  item->path = path;
+  item->result = NULL;
+  return 0;
+} /* int cf_read_item_init */
 
 static int cf_include_all(oconfig_item_t *root, int depth) {
   for (int i = 0; i < root->children_num; i++) {
@@ -710,26 +829,41 @@ static oconfig_item_t *cf_read_dir(const char *dir, const char *pattern,
   qsort((void *)filenames, filenames_num, sizeof(*filenames),
         cf_compare_string);
 
-  for (int i = 0; i < filenames_num; ++i) {
-    oconfig_item_t *temp;
-    char *name = filenames[i];
+  cf_read_item_t *items = calloc(filenames_num, sizeof(*items));
+  if (items == NULL) {
+    ERROR("configfile: calloc failed.");
+    closedir(dh);
+    for (int i = 0; i < filenames_num; ++i)
+      free(filenames[i]);
+    free(filenames);
+    free(root);
+    return NULL;
+  }
 
-    temp = cf_read_generic(name, pattern, depth);
-    if (temp == NULL) {
-      /* An error should already have been reported. */
-      sfree(name);
+  size_t items_num = 0;
+  for (int i = 0; i < filenames_num; ++i)
+    if (cf_read_item_init(items + items_num, filenames[i]) == 0)
+      items_num++;
+
+  cf_read_items(items, items_num, pattern, depth);
+
+  for (size_t i = 0; i < items_num; ++i) {
+    oconfig_item_t *temp = items[i].result;
+
+    /* An error should already have been reported. */
+    if (temp == NULL)
       continue;
-    }
 
     cf_ci_append_children(root, temp);
     sfree(temp->children);
     sfree(temp);
-
-    free(name);
   }
 
   closedir(dh);
+  for (int i = 0; i < filenames_num; ++i)
+    free(filenames[i]);
   free(filenames);
+  free(items);
   return root;
 } /* oconfig_item_t *cf_read_dir */
 
@@ -749,8 +883,9 @@ static oconfig_item_t *cf_read_generic(const char *path, const char *pattern,
                                        int depth) {
   oconfig_item_t *root = NULL;
   int status;
-  const char *path_ptr;
   wordexp_t we;
+  cf_read_item_t *items;
+  size_t items_num = 0;
 
   if (depth >= CF_MAX_DEPTH) {
     ERROR("configfile: Not including `%s' because the maximum "
@@ -759,15 +894,21 @@ static oconfig_item_t *cf_read_generic(const char *path, const char *pattern,
     return NULL;
   }
 
+  pthread_mutex_lock(&cf_wordexp_lock);
   status = wordexp(path, &we, WRDE_NOCMD);
+  pthread_mutex_unlock(&cf_wordexp_lock);
   if (status != 0) {
     ERROR("configfile: wordexp (%s) failed.", path);
     return NULL;
   }
 
   root = calloc(1, sizeof(*root));
-  if (root == NULL) {
+  items = calloc(we.we_wordc + 1, sizeof(*items));
+  if ((root == NULL) || (items == NULL)) {
     ERROR("configfile: calloc failed.");
+    sfree(root);
+    sfree(items);
+    wordfree(&we);
     return NULL;
   }
 
@@ -776,32 +917,23 @@ static oconfig_item_t *cf_read_generic(const char *path, const char *pattern,
   qsort((void *)we.we_wordv, we.we_wordc, sizeof(*we.we_wordv),
         cf_compare_string);
 
-  for (size_t i = 0; i < we.we_wordc; i++) {
-    oconfig_item_t *temp;
-    struct stat statbuf;
-
-    path_ptr = we.we_wordv[i];
+  for (size_t i = 0; i < we.we_wordc; i++)
+    if (cf_read_item_init(items + items_num, we.we_wordv[i]) == 0)
+      items_num++;
 
-    status = stat(path_ptr, &statbuf);
-    if (status != 0) {
-      WARNING("configfile: stat (%s) failed: %s", path_ptr, STRERRNO);
-      continue;
-    }
+  cf_read_items(items, items_num, pattern, depth);
 
-    if (S_ISREG(statbuf.st_mode))
-      temp = cf_read_file(path_ptr, pattern, depth);
-    else if (S_ISDIR(statbuf.st_mode))
-      temp = cf_read_dir(path_ptr, pattern, depth);
-    else {
-      WARNING("configfile: %s is neither a file nor a "
-              "directory.",
-              path);
-      continue;
-    }
+  for (size_t i = 0; i < items_num; i++) {
+    oconfig_item_t *temp = items[i].result;
 
     if (temp == NULL) {
       oconfig_free(root);
-      return NULL;
+      root = NULL;
+      continue;
+    } else if (root == NULL) {
+      /* Reading a previous item failed. */
+      oconfig_free(temp);
+      continue;
     }
 
     cf_ci_append_children(root, temp);
@@ -810,6 +942,7 @@ static oconfig_item_t *cf_read_generic(const char *path, const char *pattern,
   }
 
   wordfree(&we);
+  free(items);
 
   return root;
 } /* oconfig_item_t *cf_read_generic */
@@ -1019,7 +1152,9 @@ int cf_read(const char *filename) {
   oconfig_item_t *conf;
   int ret = 0;
 
+  cdtime_t start = cdtime();
   conf = cf_read_generic(filename, /* pattern = */ NULL, /* depth = */ 0);
+  cf_parse_duration = cdtime() - start;
   if (conf == NULL) {
     ERROR("Unable to read config file %s.", filename);
     return -1;
@@ -1029,6 +1164,7 @@ int cf_read(const char *filename) {
     return -1;
   }
 
+  start = cdtime();
   for (int i = 0; i < conf->children_num; i++) {
     if (conf->children[i].children == NULL) {
       if (dispatch_value(conf->children + i) != 0)
@@ -1047,10 +1183,16 @@ int cf_read(const char *filename) {
       ret = -1;
   }
 
+  cf_dispatch_duration = cdtime() - start;
   return ret;
 
 } /* int cf_read */
 
+void cf_get_read_durations(cdtime_t *parse, cdtime_t *dispatch) {
+  *parse = cf_parse_duration;
+  *dispatch = cf_dispatch_duration;
+} /* void cf_get_read_durations */
+
 /* Assures the config option is a string, duplicates it and returns the copy in
  * "ret_string". If necessary "*ret_string" is freed first. Returns zero upon
  * success. */
@@ -89,6 +89,11 @@ int cf_register_complex(const char *type, int (*callback)(oconfig_item_t *));
  */
 int cf_read(const char *filename);
 
+/* Returns the time the last call to `cf_read' spent parsing the config files
+ * and dispatching the parsed configuration, i.e. loading and configuring the
+ * plugins. */
+void cf_get_read_durations(cdtime_t *parse, cdtime_t *dispatch);
+
 int global_option_set(const char *option, const char *value, bool from_cli);
 const char *global_option_get(const char *option);
 long global_option_get_long(const char *option, long default_value);
@@ -35,7 +35,10 @@
 #include "plugin.h"
 #include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/hashmap/hashmap.h"
 #include "utils/heap/heap.h"
+#include "utils/latency/latency.h"
+#include "utils/phash/phash.h"
 #include "utils_cache.h"
 #include "utils_complain.h"
 #include "utils_llist.h"
@@ -59,10 +62,34 @@
 /*
  * Private structures
  */
+/* Statistics of a read or write callback. They are kept by name for the
+ * lifetime of the daemon, so that they survive callbacks being unregistered
+ * and registered again. */
+struct callback_stats_s {
+  /* "read-<callback name>" or "write-<callback name>". */
+  char *key;
+  /* The key, made usable as plugin instance. Unique among all statistics. */
+  char name[DATA_MAX_NAME_LEN];
+  enum plugin_stats_type_e type;
+
+  pthread_mutex_t lock;
+  /* Durations of the calls since startup, as returned by plugin_get_stats(). */
+  latency_counter_t *latency;
+  /* Durations of the calls since the internal statistics were last
+   * dispatched. */
+  latency_counter_t *interval_latency;
+  uint64_t calls;
+  uint64_t failures;
+  uint64_t values;
+  cdtime_t cpu_time;
+};
+typedef struct callback_stats_s callback_stats_t;
+
 struct callback_func_s {
   void *cf_callback;
   user_data_t cf_udata;
   plugin_ctx_t cf_ctx;
+  callback_stats_t *cf_stats; /* read and write callbacks only */
 };
 typedef struct callback_func_s callback_func_t;
 
@@ -113,6 +140,7 @@ typedef struct flush_callback_s flush_callback_t;
 static c_avl_tree_t *plugins_loaded;
 
 static llist_t *list_init;
+static llist_t *list_independent_init;
 static llist_t *list_write;
 static llist_t *list_flush;
 static llist_t *list_missing;
@@ -126,13 +154,25 @@ static cache_event_func_t list_cache_event[32];
 static fc_chain_t *pre_cache_chain;
 static fc_chain_t *post_cache_chain;
 
-static c_avl_tree_t *data_sets;
+/* The data sets are looked up for every dispatched value list. They are kept
+ * in an array and indexed by a perfect hash table. Data sets registered after
+ * the table has been built are kept in "data_sets_recent" until they
+ * outnumber the indexed ones, so that registering types one by one does not
+ * rebuild the table every time. */
+static data_set_t **data_sets;
+static size_t data_sets_num;
+static phash_t *data_sets_index;
+static size_t data_sets_indexed;
+static c_hashmap_t *data_sets_recent;
 
 static char *plugindir;
 
 #ifndef DEFAULT_MAX_READ_INTERVAL
 #define DEFAULT_MAX_READ_INTERVAL TIME_T_TO_CDTIME_T_STATIC(86400)
 #endif
+/* Maximum number of value lists a write thread dequeues and passes to the
+ * value cache at once. */
+#define WRITE_BATCH_SIZE 16
 static c_heap_t *read_heap;
 static llist_t *read_list;
 static int read_loop = 1;
@@ -160,11 +200,29 @@ static long write_limit_low;
 static pthread_mutex_t statistics_lock = PTHREAD_MUTEX_INITIALIZER;
 static derive_t stats_values_dropped;
 static bool record_statistics;
+/* Protected by statistics_lock. */
+static c_avl_tree_t *callback_stats;
+/* Points to the read thread's count of dispatched value lists. */
+static pthread_key_t dispatch_count_key;
+
+/* Independent init callbacks may register further callbacks concurrently. */
+static pthread_mutex_t register_lock = PTHREAD_MUTEX_INITIALIZER;
+static cdtime_t init_duration;
+
+struct init_job_s {
+  llentry_t **entries;
+  int *status;
+  size_t entries_num;
+
+  pthread_mutex_t lock;
+  size_t next;
+};
+typedef struct init_job_s init_job_t;
 
 /*
  * Static functions
  */
-static int plugin_dispatch_values_internal(value_list_t *vl);
+static void plugin_dispatch_values_batch(write_queue_t **q, size_t num);
 
 static const char *plugin_get_dir(void) {
   if (plugindir == NULL)
@@ -173,6 +231,314 @@ static const char *plugin_get_dir(void) {
     return plugindir;
 }
 
+/* Returns the CPU time used by the calling thread. */
+static cdtime_t thread_cpu_time(void) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+    return TIMESPEC_TO_CDTIME_T(&ts);
+#endif
+  return 0;
+} /* cdtime_t thread_cpu_time */
+
+static cdtime_t thread_cpu_time_of(pthread_t thread) {
+#if defined(_POSIX_THREAD_CPUTIME) && (_POSIX_THREAD_CPUTIME >= 0)
+  clockid_t clock_id;
+  struct timespec ts;
+  if ((pthread_getcpuclockid(thread, &clock_id) == 0) &&
+      (clock_gettime(clock_id, &ts) == 0))
+    return TIMESPEC_TO_CDTIME_T(&ts);
+#endif
+  return 0;
+} /* cdtime_t thread_cpu_time_of */
+
+/* Returns true if statistics other than "cs" are reported as "name".
+ * NOTE: You must hold statistics_lock when calling this function! */
+static bool callback_stats_name_used(callback_stats_t const *cs,
+                                     char const *name) {
+  c_avl_iterator_t *iter = c_avl_get_iterator(callback_stats);
+  char *key;
+  callback_stats_t *other;
+  bool used = false;
+
+  while ((iter != NULL) &&
+         (c_avl_iterator_next(iter, (void *)&key, (void *)&other) == 0)) {
+    if ((other != cs) && (strcmp(name, other->name) == 0)) {
+      used = true;
+      break;
+    }
+  }
+  c_avl_iterator_destroy(iter);
+
+  return used;
+} /* bool callback_stats_name_used */
+
+/* Sets the name under which "cs" is reported. Callback names may contain
+ * slashes, e.g. the URLs used by the curl plugins, which are replaced like
+ * other plugins do for their plugin instances. If the name had to be
+ * truncated or is used by other statistics already, a hash of the key is
+ * appended to tell them apart.
+ * NOTE: You must hold statistics_lock when calling this function! */
+static void callback_stats_set_name(callback_stats_t *cs) {
+  sstrncpy(cs->name, cs->key, sizeof(cs->name));
+  escape_slashes(cs->name, sizeof(cs->name));
+
+  if ((strlen(cs->key) < sizeof(cs->name)) &&
+      !callback_stats_name_used(cs, cs->name))
+    return;
+
+  char suffix[16];
+  ssnprintf(suffix, sizeof(suffix), "-%08" PRIx32,
+            (uint32_t)c_hashmap_hash_string(cs->key));
+
+  size_t len = strlen(cs->name);
+  if (len > sizeof(cs->name) - strlen(suffix) - 1)
+    len = sizeof(cs->name) - strlen(suffix) - 1;
+  sstrncpy(cs->name + len, suffix, sizeof(cs->name) - len);
+
+  if (callback_stats_name_used(cs, cs->name))
+    WARNING("plugin: The statistics of \"%s\" are reported as \"%s\", "
+            "which is also used by another callback.",
+            cs->key, cs->name);
+} /* void callback_stats_set_name */
+
+/* Returns the statistics of the "type" callback "name", creating them if
+ * necessary. */
+static callback_stats_t *callback_stats_get(enum plugin_stats_type_e type,
+                                            char const *name) {
+  char *key = ssnprintf_alloc(
+      "%s-%s", (type == PLUGIN_STATS_READ) ? "read" : "write", name);
+  if (key == NULL)
+    return NULL;
+
+  pthread_mutex_lock(&statistics_lock);
+
+  if (callback_stats == NULL) {
+    callback_stats =
+        c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (callback_stats == NULL) {
+      pthread_mutex_unlock(&statistics_lock);
+      sfree(key);
+      return NULL;
+    }
+  }
+
+  callback_stats_t *cs = NULL;
+  if (c_avl_get(callback_stats, key, (void *)&cs) == 0) {
+    pthread_mutex_unlock(&statistics_lock);
+    sfree(key);
+    return cs;
+  }
+
+  cs = calloc(1, sizeof(*cs));
+  if (cs == NULL) {
+    pthread_mutex_unlock(&statistics_lock);
+    sfree(key);
+    return NULL;
+  }
+  cs->key = key;
+  cs->type = type;
+  callback_stats_set_name(cs);
+  pthread_mutex_init(&cs->lock, /* attr = */ NULL);
+
+  if (c_avl_insert(callback_stats, cs->key, cs) != 0) {
+    pthread_mutex_destroy(&cs->lock);
+    sfree(cs->key);
+    sfree(cs);
+    cs = NULL;
+  }
+
+  pthread_mutex_unlock(&statistics_lock);
+  return cs;
+} /* callback_stats_t *callback_stats_get */
+
+static void callback_stats_add(callback_stats_t *cs, cdtime_t latency,
+                               cdtime_t cpu_time, int status,
+                               uint64_t values) {
+  if (cs == NULL)
+    return;
+
+  pthread_mutex_lock(&cs->lock);
+  if (cs->latency == NULL)
+    cs->latency = latency_counter_create();
+  if (cs->latency != NULL)
+    latency_counter_add(cs->latency, latency);
+  if (cs->interval_latency == NULL)
+    cs->interval_latency = latency_counter_create();
+  if (cs->interval_latency != NULL)
+    latency_counter_add(cs->interval_latency, latency);
+  cs->calls++;
+  if (status != 0)
+    cs->failures++;
+  cs->values += values;
+  cs->cpu_time += cpu_time;
+  pthread_mutex_unlock(&cs->lock);
+} /* void callback_stats_add */
+
+static void callback_stats_free(void) {
+  void *key;
+  void *value;
+
+  pthread_mutex_lock(&statistics_lock);
+  if (callback_stats == NULL) {
+    pthread_mutex_unlock(&statistics_lock);
+    return;
+  }
+
+  while (c_avl_pick(callback_stats, &key, &value) == 0) {
+    callback_stats_t *cs = value;
+    /* key is a pointer to cs->key */
+
+    latency_counter_destroy(cs->latency);
+    latency_counter_destroy(cs->interval_latency);
+    sfree(cs->key);
+    pthread_mutex_destroy(&cs->lock);
+    sfree(cs);
+  }
+
+  c_avl_destroy(callback_stats);
+  callback_stats = NULL;
+  pthread_mutex_unlock(&statistics_lock);
+} /* void callback_stats_free */
+
+static void threads_stats(plugin_stats_t *stats, char const *name,
+                          pthread_t const *threads, size_t threads_num) {
+  for (size_t i = 0; i < threads_num; i++) {
+    stats[i] = (plugin_stats_t){
+        .type = PLUGIN_STATS_THREAD,
+        .cpu_time = thread_cpu_time_of(threads[i]),
+    };
+    ssnprintf(stats[i].name, sizeof(stats[i].name), "thread-%s#%" PRIsz,
+              name, i);
+  }
+} /* void threads_stats */
+
+/* Like plugin_get_stats(), but if "interval" is true, the latency distribution
+ * covers the calls since the previous call with "interval" set. */
+static int callback_stats_collect(plugin_stats_t **ret, size_t *ret_num,
+                                  bool interval) {
+  if (!record_statistics)
+    return ENOTSUP;
+
+  pthread_mutex_lock(&statistics_lock);
+
+  size_t callbacks_num =
+      (callback_stats != NULL) ? (size_t)c_avl_size(callback_stats) : 0;
+  size_t num = callbacks_num + read_threads_num + write_threads_num;
+  plugin_stats_t *stats = calloc(num + 1, sizeof(*stats));
+  if (stats == NULL) {
+    pthread_mutex_unlock(&statistics_lock);
+    return ENOMEM;
+  }
+
+  size_t i = 0;
+  if (callback_stats != NULL) {
+    c_avl_iterator_t *iter = c_avl_get_iterator(callback_stats);
+    char *key;
+    callback_stats_t *cs;
+
+    while ((iter != NULL) &&
+           (c_avl_iterator_next(iter, (void *)&key, (void *)&cs) == 0) &&
+           (i < callbacks_num)) {
+      plugin_stats_t *st = stats + i;
+      i++;
+
+      sstrncpy(st->name, cs->name, sizeof(st->name));
+      st->type = cs->type;
+
+      pthread_mutex_lock(&cs->lock);
+      st->calls = cs->calls;
+      st->failures = cs->failures;
+      st->values = cs->values;
+      st->cpu_time = cs->cpu_time;
+      if (cs->latency != NULL)
+        st->total_time = latency_counter_get_sum(cs->latency);
+      latency_counter_t *lc = interval ? cs->interval_latency : cs->latency;
+      if (lc != NULL) {
+        st->latency_max = latency_counter_get_max(lc);
+        st->latency_median = latency_counter_get_percentile(lc, 50);
+        st->latency_p99 = latency_counter_get_percentile(lc, 99);
+        if (interval)
+          latency_counter_reset(lc);
+      }
+      pthread_mutex_unlock(&cs->lock);
+    }
+    c_avl_iterator_destroy(iter);
+  }
+
+  threads_stats(stats + i, "reader", read_threads, read_threads_num);
+  i += read_threads_num;
+  threads_stats(stats + i, "writer", write_threads, write_threads_num);
+  i += write_threads_num;
+  pthread_mutex_unlock(&statistics_lock);
+
+  *ret = stats;
+  *ret_num = i;
+  return 0;
+} /* int callback_stats_collect */
+
+EXPORT int plugin_get_stats(plugin_stats_t **ret, size_t *ret_num) {
+  return callback_stats_collect(ret, ret_num, false);
+} /* int plugin_get_stats */
+
+static void plugin_dispatch_stats(value_list_t *vl, plugin_stats_t const *st) {
+  sstrncpy(vl->plugin_instance, st->name, sizeof(vl->plugin_instance));
+  vl->values_len = 1;
+
+  vl->values = &(value_t){.derive = (derive_t)CDTIME_T_TO_MS(st->cpu_time)};
+  sstrncpy(vl->type, "total_time_in_ms", sizeof(vl->type));
+  sstrncpy(vl->type_instance, "cpu", sizeof(vl->type_instance));
+  plugin_dispatch_values(vl);
+
+  if (st->type == PLUGIN_STATS_THREAD)
+    return;
+
+  vl->values = &(value_t){.derive = (derive_t)CDTIME_T_TO_MS(st->total_time)};
+  sstrncpy(vl->type_instance, "wall", sizeof(vl->type_instance));
+  plugin_dispatch_values(vl);
+
+  struct {
+    char const *name;
+    uint64_t value;
+  } counters[] = {
+      {"calls", st->calls},
+      {"failures", st->failures},
+  };
+  sstrncpy(vl->type, "operations", sizeof(vl->type));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(counters); i++) {
+    vl->values = &(value_t){.derive = (derive_t)counters[i].value};
+    sstrncpy(vl->type_instance, counters[i].name, sizeof(vl->type_instance));
+    plugin_dispatch_values(vl);
+  }
+
+  if (st->type == PLUGIN_STATS_READ) {
+    vl->values = &(value_t){.derive = (derive_t)st->values};
+    sstrncpy(vl->type, "total_values", sizeof(vl->type));
+    sstrncpy(vl->type_instance, "dispatched", sizeof(vl->type_instance));
+    plugin_dispatch_values(vl);
+  }
+
+  /* The latency distribution covers the current interval only. Without calls
+   * in this interval, there is nothing to report. */
+  if (st->latency_max == 0)
+    return;
+
+  struct {
+    char const *name;
+    cdtime_t value;
+  } latencies[] = {
+      {"max", st->latency_max},
+      {"percentile-50", st->latency_median},
+      {"percentile-99", st->latency_p99},
+  };
+  sstrncpy(vl->type, "latency", sizeof(vl->type));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(latencies); i++) {
+    vl->values = &(value_t){.gauge = CDTIME_T_TO_DOUBLE(latencies[i].value)};
+    sstrncpy(vl->type_instance, latencies[i].name, sizeof(vl->type_instance));
+    plugin_dispatch_values(vl);
+  }
+} /* void plugin_dispatch_stats */
+
 static int plugin_update_internal_statistics(void) { /* {{{ */
   gauge_t copy_write_queue_length = (gauge_t)write_queue_length;
 
@@ -208,6 +574,38 @@ static int plugin_update_internal_statistics(void) { /* {{{ */
   vl.type_instance[0] = 0;
   plugin_dispatch_values(&vl);
 
+  /* Startup : duration of the startup phases */
+  cdtime_t parse_duration;
+  cdtime_t dispatch_duration;
+  cf_get_read_durations(&parse_duration, &dispatch_duration);
+
+  struct {
+    char const *name;
+    cdtime_t duration;
+  } phases[] = {
+      {"config_parse", parse_duration},
+      {"config_dispatch", dispatch_duration},
+      {"init", init_duration},
+  };
+
+  sstrncpy(vl.plugin_instance, "startup", sizeof(vl.plugin_instance));
+  sstrncpy(vl.type, "duration", sizeof(vl.type));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(phases); i++) {
+    vl.values = &(value_t){.gauge = CDTIME_T_TO_DOUBLE(phases[i].duration)};
+    vl.values_len = 1;
+    sstrncpy(vl.type_instance, phases[i].name, sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+  }
+
+  /* Callbacks and threads */
+  plugin_stats_t *stats = NULL;
+  size_t stats_num = 0;
+  if (callback_stats_collect(&stats, &stats_num, true) == 0) {
+    for (size_t i = 0; i < stats_num; i++)
+      plugin_dispatch_stats(&vl, stats + i);
+    sfree(stats);
+  }
+
   return 0;
 } /* }}} int plugin_update_internal_statistics */
 
@@ -272,8 +670,8 @@ static void destroy_read_heap(void) /* {{{ */
   read_heap = NULL;
 } /* }}} void destroy_read_heap */
 
-static int register_callback(llist_t **list, /* {{{ */
-                             const char *name, callback_func_t *cf) {
+static int register_callback_locked(llist_t **list, /* {{{ */
+                                    const char *name, callback_func_t *cf) {
 
   if (*list == NULL) {
     *list = llist_create();
@@ -318,6 +716,14 @@ static int register_callback(llist_t **list, /* {{{ */
   }
 
   return 0;
+} /* }}} int register_callback_locked */
+
+static int register_callback(llist_t **list, /* {{{ */
+                             const char *name, callback_func_t *cf) {
+  pthread_mutex_lock(&register_lock);
+  int status = register_callback_locked(list, name, cf);
+  pthread_mutex_unlock(&register_lock);
+  return status;
 } /* }}} int register_callback */
 
 static void log_list_callbacks(llist_t **list, /* {{{ */
@@ -381,6 +787,8 @@ static int create_register_callback(llist_t **list, /* {{{ */
   }
 
   cf->cf_ctx = plugin_get_ctx();
+  if (list == &list_write)
+    cf->cf_stats = callback_stats_get(PLUGIN_STATS_WRITE, name);
 
   return register_callback(list, name, cf);
 } /* }}} int create_register_callback */
@@ -392,11 +800,15 @@ static int plugin_unregister(llist_t *list, const char *name) /* {{{ */
   if (list == NULL)
     return -1;
 
+  pthread_mutex_lock(&register_lock);
   e = llist_search(list, name);
-  if (e == NULL)
+  if (e == NULL) {
+    pthread_mutex_unlock(&register_lock);
     return -1;
+  }
 
   llist_remove(list, e);
+  pthread_mutex_unlock(&register_lock);
 
   sfree(e->key);
   destroy_callback(e->value);
@@ -448,6 +860,10 @@ static int plugin_load_file(char const *file, bool global) {
 }
 
 static void *plugin_read_thread(void __attribute__((unused)) * args) {
+  /* Counts the value lists dispatched by the read callbacks. */
+  uint64_t dispatch_count = 0;
+  pthread_setspecific(dispatch_count_key, &dispatch_count);
+
   while (read_loop != 0) {
     read_func_t *rf;
     plugin_ctx_t old_ctx;
@@ -523,6 +939,8 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
     DEBUG("plugin_read_thread: Handling `%s'.", rf->rf_name);
 
     start = cdtime();
+    cdtime_t cpu_start = record_statistics ? thread_cpu_time() : 0;
+    uint64_t dispatch_start = dispatch_count;
 
     old_ctx = plugin_set_ctx(rf->rf_ctx);
 
@@ -563,6 +981,11 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
     /* calculate the time spent in the read function */
     elapsed = (now - start);
 
+    if (record_statistics)
+      callback_stats_add(rf->rf_super.cf_stats, elapsed,
+                         thread_cpu_time() - cpu_start, status,
+                         dispatch_count - dispatch_start);
+
     if (elapsed > rf->rf_effective_interval)
       WARNING(
           "plugin_read_thread: read-function of the `%s' plugin took %.3f "
@@ -658,7 +1081,10 @@ static void start_read_threads(size_t num) /* {{{ */
               (uint64_t)read_threads_num);
     set_thread_name(read_threads[read_threads_num], name);
 
+    /* Published to plugin_get_stats() under the lock. */
+    pthread_mutex_lock(&statistics_lock);
     read_threads_num++;
+    pthread_mutex_unlock(&statistics_lock);
   } /* for (i) */
 } /* }}} void start_read_threads */
 
@@ -674,14 +1100,19 @@ static void stop_read_threads(void) {
   pthread_cond_broadcast(&read_cond);
   pthread_mutex_unlock(&read_lock);
 
-  for (size_t i = 0; i < read_threads_num; i++) {
+  /* Hide the threads from plugin_get_stats() before they go away. */
+  pthread_mutex_lock(&statistics_lock);
+  size_t threads_num = read_threads_num;
+  read_threads_num = 0;
+  pthread_mutex_unlock(&statistics_lock);
+
+  for (size_t i = 0; i < threads_num; i++) {
     if (pthread_join(read_threads[i], NULL) != 0) {
       ERROR("plugin: stop_read_threads: pthread_join failed.");
     }
     read_threads[i] = (pthread_t)0;
   }
   sfree(read_threads);
-  read_threads_num = 0;
 } /* void stop_read_threads */
 
 static void plugin_value_list_free(value_list_t *vl) /* {{{ */
@@ -769,27 +1200,33 @@ static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
   pthread_cond_signal(&write_cond);
   pthread_mutex_unlock(&write_lock);
 
+  if (record_statistics) {
+    uint64_t *dispatch_count = pthread_getspecific(dispatch_count_key);
+    if (dispatch_count != NULL)
+      (*dispatch_count)++;
+  }
+
   return 0;
 } /* }}} int plugin_write_enqueue */
 
-static value_list_t *plugin_write_dequeue(void) /* {{{ */
+/* Removes up to `num' entries from the queue. If the queue is short, only
+ * half of it is taken, so that the other write threads get some work, too. */
+static size_t plugin_write_dequeue(write_queue_t **ret, size_t num) /* {{{ */
 {
-  write_queue_t *q;
-  value_list_t *vl;
-
   pthread_mutex_lock(&write_lock);
 
   while (write_loop && (write_queue_head == NULL))
     pthread_cond_wait(&write_cond, &write_lock);
 
-  if (write_queue_head == NULL) {
-    pthread_mutex_unlock(&write_lock);
-    return NULL;
-  }
+  if ((size_t)(write_queue_length + 1) / 2 < num)
+    num = (size_t)(write_queue_length + 1) / 2;
 
-  q = write_queue_head;
-  write_queue_head = q->next;
-  write_queue_length -= 1;
+  size_t i;
+  for (i = 0; (i < num) && (write_queue_head != NULL); i++) {
+    ret[i] = write_queue_head;
+    write_queue_head = ret[i]->next;
+    write_queue_length -= 1;
+  }
   if (write_queue_head == NULL) {
     write_queue_tail = NULL;
     assert(0 == write_queue_length);
@@ -797,23 +1234,23 @@ static value_list_t *plugin_write_dequeue(void) /* {{{ */
 
   pthread_mutex_unlock(&write_lock);
 
-  (void)plugin_set_ctx(q->ctx);
-
-  vl = q->vl;
-  sfree(q);
-  return vl;
-} /* }}} value_list_t *plugin_write_dequeue */
+  return i;
+} /* }}} size_t plugin_write_dequeue */
 
 static void *plugin_write_thread(void __attribute__((unused)) * args) /* {{{ */
 {
   while (write_loop) {
-    value_list_t *vl = plugin_write_dequeue();
-    if (vl == NULL)
+    write_queue_t *q[WRITE_BATCH_SIZE];
+    size_t num = plugin_write_dequeue(q, STATIC_ARRAY_SIZE(q));
+    if (num == 0)
       continue;
 
-    plugin_dispatch_values_internal(vl);
+    plugin_dispatch_values_batch(q, num);
 
-    plugin_value_list_free(vl);
+    for (size_t i = 0; i < num; i++) {
+      plugin_value_list_free(q[i]->vl);
+      sfree(q[i]);
+    }
   }
 
   pthread_exit(NULL);
@@ -848,7 +1285,10 @@ static void start_write_threads(size_t num) /* {{{ */
               (uint64_t)write_threads_num);
     set_thread_name(write_threads[write_threads_num], name);
 
+    /* Published to plugin_get_stats() under the lock. */
+    pthread_mutex_lock(&statistics_lock);
     write_threads_num++;
+    pthread_mutex_unlock(&statistics_lock);
   } /* for (i) */
 } /* }}} void start_write_threads */
 
@@ -868,14 +1308,19 @@ static void stop_write_threads(void) /* {{{ */
   pthread_cond_broadcast(&write_cond);
   pthread_mutex_unlock(&write_lock);
 
-  for (i = 0; i < write_threads_num; i++) {
+  /* Hide the threads from plugin_get_stats() before they go away. */
+  pthread_mutex_lock(&statistics_lock);
+  size_t threads_num = write_threads_num;
+  write_threads_num = 0;
+  pthread_mutex_unlock(&statistics_lock);
+
+  for (i = 0; i < threads_num; i++) {
     if (pthread_join(write_threads[i], NULL) != 0) {
       ERROR("plugin: stop_write_threads: pthread_join failed.");
     }
     write_threads[i] = (pthread_t)0;
   }
   sfree(write_threads);
-  write_threads_num = 0;
 
   pthread_mutex_lock(&write_lock);
   i = 0;
@@ -1070,6 +1515,12 @@ EXPORT int plugin_register_init(const char *name, int (*callback)(void)) {
   return create_register_callback(&list_init, name, (void *)callback, NULL);
 } /* plugin_register_init */
 
+EXPORT int plugin_register_independent_init(const char *name,
+                                            int (*callback)(void)) {
+  return create_register_callback(&list_independent_init, name,
+                                  (void *)callback, NULL);
+} /* plugin_register_independent_init */
+
 static int plugin_compare_read_func(const void *arg0, const void *arg1) {
   const read_func_t *rf0;
   const read_func_t *rf1;
@@ -1094,6 +1545,7 @@ static int plugin_insert_read(read_func_t *rf) {
 
   rf->rf_next_read = cdtime();
   rf->rf_effective_interval = rf->rf_interval;
+  rf->rf_super.cf_stats = callback_stats_get(PLUGIN_STATS_READ, rf->rf_name);
 
   pthread_mutex_lock(&read_lock);
 
@@ -1378,52 +1830,133 @@ EXPORT int plugin_register_shutdown(const char *name, int (*callback)(void)) {
   return create_register_callback(&list_shutdown, name, (void *)callback, NULL);
 } /* int plugin_register_shutdown */
 
-static void plugin_free_data_sets(void) {
-  void *key;
-  void *value;
+static data_set_t *data_set_get(const char *type) {
+  data_set_t *ds = NULL;
 
-  if (data_sets == NULL)
-    return;
+  if (data_sets_index != NULL)
+    ds = phash_get(data_sets_index, type);
+  if ((ds == NULL) && (data_sets_recent != NULL) &&
+      (c_hashmap_get(data_sets_recent, type, (void *)&ds) != 0))
+    ds = NULL;
 
-  while (c_avl_pick(data_sets, &key, &value) == 0) {
-    data_set_t *ds = value;
-    /* key is a pointer to ds->type */
+  return ds;
+} /* data_set_t *data_set_get */
 
-    sfree(ds->ds);
-    sfree(ds);
-  }
+/* Builds a new index of all data sets. On failure, the current index and
+ * "data_sets_recent" are kept. */
+static int data_sets_reindex(void) {
+  char const **keys = calloc(data_sets_num + 1, sizeof(*keys));
+  if (keys == NULL)
+    return -1;
 
-  c_avl_destroy(data_sets);
-  data_sets = NULL;
-} /* void plugin_free_data_sets */
+  for (size_t i = 0; i < data_sets_num; i++)
+    keys[i] = data_sets[i]->type;
 
-EXPORT int plugin_register_data_set(const data_set_t *ds) {
-  data_set_t *ds_copy;
-
-  if ((data_sets != NULL) && (c_avl_get(data_sets, ds->type, NULL) == 0)) {
-    NOTICE("Replacing DS `%s' with another version.", ds->type);
-    plugin_unregister_data_set(ds->type);
-  } else if (data_sets == NULL) {
-    data_sets = c_avl_create((int (*)(const void *, const void *))strcmp);
-    if (data_sets == NULL)
+  phash_t *index =
+      phash_create(keys, (void *const *)data_sets, data_sets_num);
+  sfree(keys);
+  if (index == NULL)
+    return -1;
+
+  phash_destroy(data_sets_index);
+  data_sets_index = index;
+  data_sets_indexed = data_sets_num;
+
+  c_hashmap_destroy(data_sets_recent);
+  data_sets_recent = NULL;
+  return 0;
+} /* int data_sets_reindex */
+
+/* Makes "ds" available to data_set_get() without rebuilding the index. */
+static int data_sets_add_recent(data_set_t *ds) {
+  if (data_sets_recent == NULL) {
+    data_sets_recent = c_hashmap_create_string();
+    if (data_sets_recent == NULL)
       return -1;
   }
 
-  ds_copy = malloc(sizeof(*ds_copy));
-  if (ds_copy == NULL)
-    return -1;
-  memcpy(ds_copy, ds, sizeof(data_set_t));
+  return c_hashmap_insert(data_sets_recent, ds->type, ds);
+} /* int data_sets_add_recent */
+
+static void plugin_free_data_sets(void) {
+  phash_destroy(data_sets_index);
+  data_sets_index = NULL;
+  data_sets_indexed = 0;
+  c_hashmap_destroy(data_sets_recent);
+  data_sets_recent = NULL;
+
+  for (size_t i = 0; i < data_sets_num; i++) {
+    sfree(data_sets[i]->ds);
+    sfree(data_sets[i]);
+  }
+
+  sfree(data_sets);
+  data_sets_num = 0;
+  uc_data_sets_changed();
+} /* void plugin_free_data_sets */
 
-  ds_copy->ds = malloc(sizeof(*ds_copy->ds) * ds->ds_num);
-  if (ds_copy->ds == NULL) {
-    sfree(ds_copy);
+EXPORT int plugin_register_data_sets(const data_set_t *ds, size_t ds_num) {
+  data_set_t **tmp =
+      realloc(data_sets, (data_sets_num + ds_num + 1) * sizeof(*data_sets));
+  if (tmp == NULL)
     return -1;
+  data_sets = tmp;
+
+  bool reindex = false;
+  int status = 0;
+  for (size_t i = 0; i < ds_num; i++) {
+    data_set_t *old = data_set_get(ds[i].type);
+    data_source_t *sources = NULL;
+
+    if (ds[i].ds_num > 0) {
+      sources = calloc(ds[i].ds_num, sizeof(*sources));
+      if (sources == NULL) {
+        status = -1;
+        break;
+      }
+      memcpy(sources, ds[i].ds, ds[i].ds_num * sizeof(*sources));
+    }
+
+    /* Replace the data sources in place, so that the index stays valid. */
+    if (old != NULL) {
+      NOTICE("Replacing DS `%s' with another version.", old->type);
+      sfree(old->ds);
+      old->ds = sources;
+      old->ds_num = ds[i].ds_num;
+      uc_data_sets_changed();
+      continue;
+    }
+
+    data_set_t *ds_copy = malloc(sizeof(*ds_copy));
+    if (ds_copy == NULL) {
+      sfree(sources);
+      status = -1;
+      break;
+    }
+    memcpy(ds_copy, ds + i, sizeof(*ds_copy));
+    ds_copy->ds = sources;
+
+    data_sets[data_sets_num] = ds_copy;
+    data_sets_num++;
+    if (data_sets_add_recent(ds_copy) != 0)
+      reindex = true;
   }
 
-  for (size_t i = 0; i < ds->ds_num; i++)
-    memcpy(ds_copy->ds + i, ds->ds + i, sizeof(data_source_t));
+  /* Rebuild the index once the recent data sets outnumber the indexed ones,
+   * i.e. every time the number of data sets has doubled. */
+  if (reindex || (data_sets_num - data_sets_indexed > data_sets_indexed)) {
+    if ((data_sets_reindex() != 0) && reindex) {
+      ERROR("plugin: Building the index of %" PRIsz " data sets failed.",
+            data_sets_num);
+      return -1;
+    }
+  }
 
-  return c_avl_insert(data_sets, (void *)ds_copy->type, (void *)ds_copy);
+  return status;
+} /* int plugin_register_data_sets */
+
+EXPORT int plugin_register_data_set(const data_set_t *ds) {
+  return plugin_register_data_sets(ds, 1);
 } /* int plugin_register_data_set */
 
 EXPORT int plugin_register_log(const char *name, plugin_log_cb callback,
@@ -1449,6 +1982,8 @@ EXPORT int plugin_unregister_complex_config(const char *name) {
 } /* int plugin_unregister_complex_config */
 
 EXPORT int plugin_unregister_init(const char *name) {
+  if (plugin_unregister(list_independent_init, name) == 0)
+    return 0;
   return plugin_unregister(list_init, name);
 }
 
@@ -1606,17 +2141,34 @@ EXPORT int plugin_unregister_shutdown(const char *name) {
 }
 
 EXPORT int plugin_unregister_data_set(const char *name) {
-  data_set_t *ds;
+  size_t i;
+  for (i = 0; i < data_sets_num; i++)
+    if (strcmp(data_sets[i]->type, name) == 0)
+      break;
 
-  if (data_sets == NULL)
+  if (i >= data_sets_num)
     return -1;
 
-  if (c_avl_remove(data_sets, name, NULL, (void *)&ds) != 0)
-    return -1;
+  data_set_t *ds = data_sets[i];
+  data_sets[i] = data_sets[data_sets_num - 1];
+  data_sets_num--;
+
+  /* The index refers to the type of "ds", so it has to be rebuilt before
+   * "ds" is freed. If that fails, move all data sets out of the index. */
+  if (data_sets_recent != NULL)
+    c_hashmap_remove(data_sets_recent, ds->type, NULL, NULL);
+  if (data_sets_reindex() != 0) {
+    phash_destroy(data_sets_index);
+    data_sets_index = NULL;
+    data_sets_indexed = 0;
+    for (i = 0; i < data_sets_num; i++)
+      if (data_set_get(data_sets[i]->type) == NULL)
+        data_sets_add_recent(data_sets[i]);
+  }
 
   sfree(ds->ds);
   sfree(ds);
-
+  uc_data_sets_changed();
   return 0;
 } /* int plugin_unregister_data_set */
 
@@ -1628,10 +2180,79 @@ EXPORT int plugin_unregister_notification(const char *name) {
   return plugin_unregister(list_notification, name);
 }
 
+static int plugin_call_init(llentry_t *le) /* {{{ */
+{
+  callback_func_t *cf = le->value;
+  plugin_init_cb callback = cf->cf_callback;
+
+  plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+  cdtime_t start = cdtime();
+  int status = (*callback)();
+  INFO("plugin: Initializing `%s' took %.3f seconds.", le->key,
+       CDTIME_T_TO_DOUBLE(cdtime() - start));
+  plugin_set_ctx(old_ctx);
+
+  if (status != 0) {
+    ERROR("Initialization of plugin `%s' "
+          "failed with status %i. "
+          "Plugin will be unloaded.",
+          le->key, status);
+    /* Plugins that register read callbacks from the init
+     * callback should take care of appropriate error
+     * handling themselves. */
+    /* FIXME: Unload _all_ functions */
+    plugin_unregister_read(le->key);
+  }
+
+  return status;
+} /* }}} int plugin_call_init */
+
+static void *plugin_init_thread(void *args) /* {{{ */
+{
+  init_job_t *job = args;
+
+  while (42) {
+    pthread_mutex_lock(&job->lock);
+    size_t i = job->next++;
+    pthread_mutex_unlock(&job->lock);
+
+    if (i >= job->entries_num)
+      return NULL;
+
+    job->status[i] = plugin_call_init(job->entries[i]);
+  }
+} /* }}} void *plugin_init_thread */
+
+/* Starts up to "num" threads calling the independent init callbacks. Returns
+ * the number of threads started. */
+static size_t start_init_threads(init_job_t *job, pthread_t *threads,
+                                 size_t num) /* {{{ */
+{
+  size_t threads_num = 0;
+
+  while ((threads_num < num) && (threads_num < job->entries_num)) {
+    int status = pthread_create(threads + threads_num, /* attr = */ NULL,
+                                plugin_init_thread, job);
+    if (status != 0) {
+      ERROR("plugin: start_init_threads: pthread_create failed with status %i "
+            "(%s).",
+            status, STRERROR(status));
+      break;
+    }
+
+    char name[THREAD_NAME_MAX];
+    ssnprintf(name, sizeof(name), "init#%" PRIu64, (uint64_t)threads_num);
+    set_thread_name(threads[threads_num], name);
+
+    threads_num++;
+  }
+
+  return threads_num;
+} /* }}} size_t start_init_threads */
+
 EXPORT int plugin_init_all(void) {
   char const *chain_name;
   llentry_t *le;
-  int status;
   int ret = 0;
 
   /* Init the value cache */
@@ -1667,48 +2288,84 @@ EXPORT int plugin_init_all(void) {
     write_limit_low = write_limit_high;
   }
 
-  write_threads_num = global_option_get_long("WriteThreads",
-                                             /* default = */ 5);
-  if (write_threads_num < 1) {
+  long write_threads_conf = global_option_get_long("WriteThreads",
+                                                   /* default = */ 5);
+  if (write_threads_conf < 1) {
     ERROR("WriteThreads must be positive.");
-    write_threads_num = 5;
+    write_threads_conf = 5;
   }
 
-  if ((list_init == NULL) && (read_heap == NULL))
+  if ((list_init == NULL) && (list_independent_init == NULL) &&
+      (read_heap == NULL))
     return ret;
 
+  cdtime_t init_start = cdtime();
+
+  /* Init callbacks registered with plugin_register_independent_init don't
+   * depend on other plugins and are called by "InitThreads" threads, while
+   * the remaining callbacks are called in order of registration. */
+  init_job_t job = {
+      .entries_num = (size_t)llist_size(list_independent_init),
+  };
+  job.entries = calloc(job.entries_num + 1, sizeof(*job.entries));
+  job.status = calloc(job.entries_num + 1, sizeof(*job.status));
+  if ((job.entries == NULL) || (job.status == NULL)) {
+    ERROR("plugin_init_all: calloc failed.");
+    sfree(job.entries);
+    sfree(job.status);
+    return -1;
+  }
+  pthread_mutex_init(&job.lock, NULL);
+
+  size_t i = 0;
+  for (le = llist_head(list_independent_init); le != NULL; le = le->next)
+    job.entries[i++] = le;
+
+  long init_threads_num = global_option_get_long("InitThreads",
+                                                 /* default = */ 5);
+  if (init_threads_num < 0) {
+    ERROR("InitThreads must be positive or zero.");
+    init_threads_num = 5;
+  }
+
+  size_t init_threads_started = 0;
+  pthread_t *init_threads = calloc(init_threads_num + 1, sizeof(*init_threads));
+  if (init_threads != NULL)
+    init_threads_started =
+        start_init_threads(&job, init_threads, (size_t)init_threads_num);
+
   /* Calling all init callbacks before checking if read callbacks
    * are available allows the init callbacks to register the read
    * callback. */
   le = llist_head(list_init);
   while (le != NULL) {
-    callback_func_t *cf;
-    plugin_init_cb callback;
-    plugin_ctx_t old_ctx;
-
-    cf = le->value;
-    old_ctx = plugin_set_ctx(cf->cf_ctx);
-    callback = cf->cf_callback;
-    status = (*callback)();
-    plugin_set_ctx(old_ctx);
-
-    if (status != 0) {
-      ERROR("Initialization of plugin `%s' "
-            "failed with status %i. "
-            "Plugin will be unloaded.",
-            le->key, status);
-      /* Plugins that register read callbacks from the init
-       * callback should take care of appropriate error
-       * handling themselves. */
-      /* FIXME: Unload _all_ functions */
-      plugin_unregister_read(le->key);
+    if (plugin_call_init(le) != 0)
       ret = -1;
-    }
 
     le = le->next;
   }
 
-  start_write_threads((size_t)write_threads_num);
+  /* Help out with the independent callbacks, or call all of them if no
+   * threads could be started. */
+  plugin_init_thread(&job);
+
+  for (i = 0; i < init_threads_started; i++)
+    pthread_join(init_threads[i], NULL);
+  sfree(init_threads);
+
+  for (i = 0; i < job.entries_num; i++)
+    if (job.status[i] != 0)
+      ret = -1;
+
+  pthread_mutex_destroy(&job.lock);
+  sfree(job.entries);
+  sfree(job.status);
+
+  init_duration = cdtime() - init_start;
+  INFO("plugin: Initialization took %.3f seconds.",
+       CDTIME_T_TO_DOUBLE(init_duration));
+
+  start_write_threads((size_t)write_threads_conf);
 
   max_read_interval =
       global_option_get_time("MaxReadInterval", DEFAULT_MAX_READ_INTERVAL);
@@ -1779,6 +2436,23 @@ EXPORT int plugin_read_all_once(void) {
   return return_status;
 } /* int plugin_read_all_once */
 
+static int plugin_call_write(callback_func_t *cf, /* {{{ */
+                             const data_set_t *ds, const value_list_t *vl) {
+  plugin_write_cb callback = cf->cf_callback;
+
+  if (!record_statistics)
+    return (*callback)(ds, vl, &cf->cf_udata);
+
+  cdtime_t start = cdtime();
+  cdtime_t cpu_start = thread_cpu_time();
+
+  int status = (*callback)(ds, vl, &cf->cf_udata);
+
+  callback_stats_add(cf->cf_stats, cdtime() - start,
+                     thread_cpu_time() - cpu_start, status, 0);
+  return status;
+} /* }}} int plugin_call_write */
+
 EXPORT int plugin_write(const char *plugin, /* {{{ */
                         const data_set_t *ds, const value_list_t *vl) {
   llentry_t *le;
@@ -1805,7 +2479,6 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
     le = llist_head(list_write);
     while (le != NULL) {
       callback_func_t *cf = le->value;
-      plugin_write_cb callback;
 
       /* Keep the read plugin's interval and flush information but update the
        * plugin name. */
@@ -1815,8 +2488,7 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
       plugin_set_ctx(ctx);
 
       DEBUG("plugin: plugin_write: Writing values via %s.", le->key);
-      callback = cf->cf_callback;
-      status = (*callback)(ds, vl, &cf->cf_udata);
+      status = plugin_call_write(cf, ds, vl);
       if (status != 0)
         failure++;
       else
@@ -1833,7 +2505,6 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
   } else /* plugin != NULL */
   {
     callback_func_t *cf;
-    plugin_write_cb callback;
 
     le = llist_head(list_write);
     while (le != NULL) {
@@ -1852,8 +2523,7 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
      * information of the calling read plugin */
 
     DEBUG("plugin: plugin_write: Writing values via %s.", le->key);
-    callback = cf->cf_callback;
-    status = (*callback)(ds, vl, &cf->cf_udata);
+    status = plugin_call_write(cf, ds, vl);
   }
 
   return status;
@@ -1895,6 +2565,7 @@ EXPORT int plugin_shutdown_all(void) {
   int ret = 0; // Assume success.
 
   destroy_all_callbacks(&list_init);
+  destroy_all_callbacks(&list_independent_init);
 
   stop_read_threads();
 
@@ -1954,6 +2625,7 @@ EXPORT int plugin_shutdown_all(void) {
 
   plugin_free_loaded();
   plugin_free_data_sets();
+  callback_stats_free();
   return ret;
 } /* void plugin_shutdown_all */
 
@@ -2017,7 +2689,7 @@ void plugin_dispatch_cache_event(enum cache_event_type_e event_type,
           DEBUG(
               "plugin_dispatch_cache_event: Callback \"%s\" subscribed to %s.",
               cef->name, name);
-          callbacks_mask |= (1 << (i));
+          callbacks_mask |= (1UL << i);
         } else {
           DEBUG("plugin_dispatch_cache_event: Callback \"%s\" ignores %s.",
                 cef->name, name);
@@ -2038,7 +2710,7 @@ void plugin_dispatch_cache_event(enum cache_event_type_e event_type,
       if (!callback)
         continue;
 
-      if (callbacks_mask && (1 << (i)) == 0)
+      if ((callbacks_mask & (1UL << i)) == 0)
         continue;
 
       cache_event_t event = (cache_event_t){.type = event_type,
@@ -2062,12 +2734,12 @@ void plugin_dispatch_cache_event(enum cache_event_type_e event_type,
   return;
 }
 
-static int plugin_dispatch_values_internal(value_list_t *vl) {
+/* Checks the value list and runs the pre-cache chain. Returns the value
+ * list's data set or NULL if the value list is not to be dispatched. */
+static data_set_t *plugin_dispatch_values_prepare(value_list_t *vl) {
   int status;
   static c_complain_t no_write_complaint = C_COMPLAIN_INIT_STATIC;
 
-  bool free_meta_data = false;
-
   assert(vl != NULL);
 
   /* These fields are initialized by plugin_value_list_clone() if needed: */
@@ -2079,37 +2751,31 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
     ERROR("plugin_dispatch_values: Invalid value list "
           "from plugin %s.",
           vl->plugin);
-    return -1;
+    return NULL;
   }
 
-  /* Free meta data only if the calling function didn't specify any. In
-   * this case matches and targets may add some and the calling function
-   * may not expect (and therefore free) that data. */
-  if (vl->meta == NULL)
-    free_meta_data = true;
-
   if (list_write == NULL)
     c_complain_once(LOG_WARNING, &no_write_complaint,
                     "plugin_dispatch_values: No write callback has been "
                     "registered. Please load at least one output plugin, "
                     "if you want the collected data to be stored.");
 
-  if (data_sets == NULL) {
+  if (data_sets_num == 0) {
     ERROR("plugin_dispatch_values: No data sets registered. "
           "Could the types database be read? Check "
           "your `TypesDB' setting!");
-    return -1;
+    return NULL;
   }
 
-  data_set_t *ds = NULL;
-  if (c_avl_get(data_sets, vl->type, (void *)&ds) != 0) {
+  data_set_t *ds = data_set_get(vl->type);
+  if (ds == NULL) {
     char ident[6 * DATA_MAX_NAME_LEN];
 
     FORMAT_VL(ident, sizeof(ident), vl);
     INFO("plugin_dispatch_values: Dataset not found: %s "
          "(from \"%s\"), check your types.db!",
          vl->type, ident);
-    return -1;
+    return NULL;
   }
 
   DEBUG("plugin_dispatch_values: time = %.3f; interval = %.3f; "
@@ -2137,7 +2803,7 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
           "(vl->values_len = %" PRIsz ")",
           vl->host, vl->plugin, vl->plugin_instance, vl->type,
           vl->type_instance, ds->type, ds->ds_num, vl->values_len);
-    return -1;
+    return NULL;
   }
 #endif
 
@@ -2155,11 +2821,16 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
               "status %i (%#x).",
               status, status);
     } else if (status == FC_TARGET_STOP)
-      return 0;
+      return NULL;
   }
 
-  /* Update the value cache */
-  uc_update(ds, vl);
+  return ds;
+} /* data_set_t *plugin_dispatch_values_prepare */
+
+/* Runs the post-cache chain, i.e. passes the value list to the writers. */
+static void plugin_dispatch_values_finish(data_set_t const *ds,
+                                          value_list_t *vl) {
+  int status;
 
   if (post_cache_chain != NULL) {
     status = fc_process_chain(ds, vl, post_cache_chain);
@@ -2171,14 +2842,40 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
     }
   } else
     fc_default_action(ds, vl);
+} /* void plugin_dispatch_values_finish */
+
+/* Dispatches value lists taken from the write queue. The value cache is
+ * updated for several value lists at once, which takes the cache lock only
+ * once. A batch is split where an identifier repeats, so that the post-cache
+ * chain of each value list sees the cache state of that value list. */
+static void plugin_dispatch_values_batch(write_queue_t **q, size_t num) {
+  data_set_t const *ds[WRITE_BATCH_SIZE];
+  value_list_t const *vl[WRITE_BATCH_SIZE];
+
+  assert(num <= WRITE_BATCH_SIZE);
 
-  if ((free_meta_data == true) && (vl->meta != NULL)) {
-    meta_data_destroy(vl->meta);
-    vl->meta = NULL;
+  for (size_t i = 0; i < num; i++) {
+    (void)plugin_set_ctx(q[i]->ctx);
+    ds[i] = plugin_dispatch_values_prepare(q[i]->vl);
+    vl[i] = q[i]->vl;
   }
 
-  return 0;
-} /* int plugin_dispatch_values_internal */
+  for (size_t done = 0; done < num;) {
+    size_t batch_num = 0;
+
+    /* Update the value cache */
+    uc_update_batch(ds + done, vl + done, num - done, &batch_num);
+
+    for (size_t i = done; i < done + batch_num; i++) {
+      if (ds[i] == NULL)
+        continue;
+
+      (void)plugin_set_ctx(q[i]->ctx);
+      plugin_dispatch_values_finish(ds[i], q[i]->vl);
+    }
+    done += batch_num;
+  }
+} /* void plugin_dispatch_values_batch */
 
 static double get_drop_probability(void) /* {{{ */
 {
@@ -2473,14 +3170,13 @@ EXPORT int parse_notif_severity(const char *severity) {
 } /* int parse_notif_severity */
 
 EXPORT const data_set_t *plugin_get_ds(const char *name) {
-  data_set_t *ds;
-
-  if (data_sets == NULL) {
+  if (data_sets_num == 0) {
     P_ERROR("plugin_get_ds: No data sets are defined yet.");
     return NULL;
   }
 
-  if (c_avl_get(data_sets, name, (void *)&ds) != 0) {
+  data_set_t *ds = data_set_get(name);
+  if (ds == NULL) {
     DEBUG("No such dataset registered: %s", name);
     return NULL;
   }
@@ -2661,6 +3357,7 @@ static plugin_ctx_t *plugin_ctx_create(void) {
 
 EXPORT void plugin_init_ctx(void) {
   pthread_key_create(&plugin_ctx_key, plugin_ctx_destructor);
+  pthread_key_create(&dispatch_count_key, /* destructor = */ NULL);
   plugin_ctx_key_initialized = true;
 } /* void plugin_init_ctx */
 
@@ -297,6 +297,11 @@ int plugin_register_config(const char *name,
 int plugin_register_complex_config(const char *type,
                                    int (*callback)(oconfig_item_t *));
 int plugin_register_init(const char *name, plugin_init_cb callback);
+/* Like "plugin_register_init", for init callbacks that neither depend on nor
+ * affect other plugins. Such callbacks may be called concurrently with each
+ * other and with the other init callbacks, see the "InitThreads" option. */
+int plugin_register_independent_init(const char *name,
+                                     plugin_init_cb callback);
 int plugin_register_read(const char *name, int (*callback)(void));
 /* "user_data" will be freed automatically, unless
  * "plugin_register_complex_read" returns an error (non-zero). */
@@ -314,6 +319,9 @@ int plugin_register_cache_event(const char *name,
                                 user_data_t const *ud);
 int plugin_register_shutdown(const char *name, plugin_shutdown_cb callback);
 int plugin_register_data_set(const data_set_t *ds);
+/* Registers "ds_num" data sets at once, which is cheaper than registering
+ * them one by one. */
+int plugin_register_data_sets(const data_set_t *ds, size_t ds_num);
 int plugin_register_log(const char *name, plugin_log_cb callback,
                         user_data_t const *user_data);
 int plugin_register_notification(const char *name,
@@ -469,6 +477,51 @@ plugin_ctx_t plugin_set_ctx(plugin_ctx_t ctx);
  */
 cdtime_t plugin_get_interval(void);
 
+/*
+ * Self-profiling.
+ */
+
+enum plugin_stats_type_e {
+  PLUGIN_STATS_READ,
+  PLUGIN_STATS_WRITE,
+  PLUGIN_STATS_THREAD
+};
+
+struct plugin_stats_s {
+  /* "read-<name>", "write-<name>" or "thread-<name>" */
+  char name[DATA_MAX_NAME_LEN];
+  enum plugin_stats_type_e type;
+
+  /* Not used for threads. */
+  uint64_t calls;
+  uint64_t failures;
+  uint64_t values; /* dispatched by read callbacks */
+  cdtime_t total_time;
+  cdtime_t latency_max;
+  cdtime_t latency_median;
+  cdtime_t latency_p99;
+
+  cdtime_t cpu_time;
+};
+typedef struct plugin_stats_s plugin_stats_t;
+
+/*
+ * NAME
+ *  plugin_get_stats
+ *
+ * DESCRIPTION
+ *  Returns the number of calls, failures and the latency distribution of
+ *  every read and write callback as well as the CPU time used by the
+ *  callbacks and by the read and write threads, all since startup. These
+ *  statistics are only recorded if the "CollectInternalStats" option is
+ *  enabled.
+ *
+ * RETURN VALUE
+ *  Zero upon success, in which case the caller has to free "*ret", or an
+ *  error number. ENOTSUP if statistics are not being recorded.
+ */
+int plugin_get_stats(plugin_stats_t **ret, size_t *ret_num);
+
 /*
  * Context-aware thread management.
  */
@@ -58,6 +58,11 @@ int plugin_register_init(const char *name, plugin_init_cb callback) {
   return ENOTSUP;
 }
 
+int plugin_register_independent_init(const char *name,
+                                     plugin_init_cb callback) {
+  return ENOTSUP;
+}
+
 int plugin_register_read(__attribute__((unused)) const char *name,
                          __attribute__((unused)) int (*callback)(void)) {
   return ENOTSUP;
@@ -94,6 +99,18 @@ int plugin_register_shutdown(const char *name, int (*callback)(void)) {
 
 int plugin_register_data_set(const data_set_t *ds) { return ENOTSUP; }
 
+int plugin_register_data_sets(const data_set_t *ds, size_t ds_num) {
+  return ENOTSUP;
+}
+
+int plugin_register_cache_event(__attribute__((unused)) const char *name,
+                                __attribute__((unused))
+                                plugin_cache_event_cb callback,
+                                __attribute__((unused))
+                                user_data_t const *user_data) {
+  return ENOTSUP;
+}
+
 int plugin_register_notification(__attribute__((unused)) const char *name,
                                  __attribute__((unused))
                                  plugin_notification_cb callback,
@@ -118,6 +135,7 @@ DECLARE_UNREGISTER(shutdown)
 DECLARE_UNREGISTER(data_set)
 DECLARE_UNREGISTER(log)
 DECLARE_UNREGISTER(notification)
+DECLARE_UNREGISTER(cache_event)
 
 int plugin_dispatch_values(value_list_t const *vl) { return ENOTSUP; }
 
@@ -232,11 +250,27 @@ plugin_ctx_t plugin_set_ctx(plugin_ctx_t ctx) {
 
 cdtime_t plugin_get_interval(void) { return mock_context.interval; }
 
-int plugin_thread_create(__attribute__((unused)) pthread_t *thread,
-                         __attribute__((unused)) void *(*start_routine)(void *),
-                         __attribute__((unused)) void *arg,
-                         __attribute__((unused)) char const *name) {
-  return ENOTSUP;
+int plugin_thread_create(pthread_t *thread, void *(*start_routine)(void *),
+                         void *arg, __attribute__((unused)) char const *name) {
+  return pthread_create(thread, NULL, start_routine, arg);
+}
+
+/* Returned by plugin_get_stats() unless NULL. */
+plugin_stats_t const *stats_mock;
+size_t stats_mock_num;
+
+int plugin_get_stats(plugin_stats_t **ret, size_t *ret_num) {
+  if (stats_mock == NULL)
+    return ENOTSUP;
+
+  plugin_stats_t *stats = calloc(stats_mock_num + 1, sizeof(*stats));
+  if (stats == NULL)
+    return ENOMEM;
+  memcpy(stats, stats_mock, stats_mock_num * sizeof(*stats));
+
+  *ret = stats;
+  *ret_num = stats_mock_num;
+  return 0;
 }
 
 /* TODO(octo): this function is actually from filter_chain.h, but in order not
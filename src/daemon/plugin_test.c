@@ -0,0 +1,253 @@
+/**
+ * collectd - src/daemon/plugin_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "configfile.h"
+#include "plugin.h"
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils_cache.h"
+
+static data_source_t dsrc = {"value", DS_TYPE_GAUGE, 0, NAN};
+static data_set_t ds = {"gauge", 1, &dsrc};
+
+/* Number of events of each type received by each cache event callback. */
+struct events_s {
+  bool subscribe;
+  int new_num;
+  int update_num;
+  int expired_num;
+};
+typedef struct events_s events_t;
+
+static int cache_event(cache_event_t *event, user_data_t *ud) {
+  events_t *ev = ud->data;
+
+  switch (event->type) {
+  case CE_VALUE_NEW:
+    ev->new_num++;
+    event->ret = ev->subscribe;
+    break;
+  case CE_VALUE_UPDATE:
+    ev->update_num++;
+    break;
+  case CE_VALUE_EXPIRED:
+    ev->expired_num++;
+    break;
+  }
+
+  return 0;
+}
+
+static int update(char const *type_instance, cdtime_t t) {
+  value_list_t vl = {
+      .values = &(value_t){.gauge = 42},
+      .values_len = 1,
+      .time = t,
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "gauge",
+  };
+  sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
+
+  return uc_update(&ds, &vl);
+}
+
+DEF_TEST(cache_event_mask) {
+  events_t events[3] = {
+      {.subscribe = false},
+      {.subscribe = true},
+      {.subscribe = false},
+  };
+  char name[DATA_MAX_NAME_LEN];
+
+  CHECK_ZERO(uc_init());
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(events); i++) {
+    ssnprintf(name, sizeof(name), "test%" PRIsz, i);
+    CHECK_ZERO(plugin_register_cache_event(name, cache_event,
+                                           &(user_data_t){
+                                               .data = events + i,
+                                           }));
+  }
+
+  cdtime_t t = TIME_T_TO_CDTIME_T(1000);
+  CHECK_ZERO(update("a", t));
+  CHECK_ZERO(update("a", t + TIME_T_TO_CDTIME_T(10)));
+  CHECK_ZERO(update("a", t + TIME_T_TO_CDTIME_T(20)));
+
+  /* Every callback sees the new value, but only the callback which
+   * subscribed to it receives the updates. */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(events); i++) {
+    EXPECT_EQ_INT(1, events[i].new_num);
+    EXPECT_EQ_INT(events[i].subscribe ? 2 : 0, events[i].update_num);
+  }
+
+  /* The same holds for directly dispatched events, e.g. when the value
+   * expires. */
+  plugin_dispatch_cache_event(CE_VALUE_EXPIRED, 1UL << 1,
+                              "example.com/test/gauge-a", NULL);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(events); i++)
+    EXPECT_EQ_INT(events[i].subscribe ? 1 : 0, events[i].expired_num);
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(events); i++) {
+    ssnprintf(name, sizeof(name), "test%" PRIsz, i);
+    CHECK_ZERO(plugin_unregister_cache_event(name));
+  }
+
+  return 0;
+}
+
+DEF_TEST(data_sets) {
+  data_source_t sources[2] = {
+      {"rx", DS_TYPE_DERIVE, 0, NAN},
+      {"tx", DS_TYPE_DERIVE, 0, NAN},
+  };
+  char type[DATA_MAX_NAME_LEN];
+
+  /* Registering types one by one only rebuilds the index occasionally, but
+   * every type can be found right away. */
+  int missing = 0;
+  for (int i = 0; i < 100; i++) {
+    data_set_t set = {.ds_num = 1, .ds = sources};
+    ssnprintf(set.type, sizeof(set.type), "type%d", i);
+    CHECK_ZERO(plugin_register_data_set(&set));
+
+    for (int j = 0; j <= i; j++) {
+      ssnprintf(type, sizeof(type), "type%d", j);
+      const data_set_t *ds = plugin_get_ds(type);
+      if ((ds == NULL) || (strcmp(type, ds->type) != 0))
+        missing++;
+    }
+  }
+  EXPECT_EQ_INT(0, missing);
+  EXPECT_EQ_PTR(NULL, (void *)plugin_get_ds("type100"));
+
+  /* Replacing a data set keeps the data set, but changes its sources. */
+  const data_set_t *ds = plugin_get_ds("type42");
+  data_set_t set = {.type = "type42", .ds_num = 2, .ds = sources};
+  CHECK_ZERO(plugin_register_data_set(&set));
+  EXPECT_EQ_PTR((void *)ds, (void *)plugin_get_ds("type42"));
+  EXPECT_EQ_INT(2, (int)ds->ds_num);
+  EXPECT_EQ_STR("tx", ds->ds[1].name);
+
+  /* A batch repeating a type registers its last version. */
+  data_set_t batch[3] = {
+      {.type = "batch", .ds_num = 1, .ds = sources},
+      {.type = "type7", .ds_num = 2, .ds = sources},
+      {.type = "batch", .ds_num = 2, .ds = sources},
+  };
+  CHECK_ZERO(plugin_register_data_sets(batch, STATIC_ARRAY_SIZE(batch)));
+  EXPECT_EQ_INT(2, (int)plugin_get_ds("batch")->ds_num);
+  EXPECT_EQ_INT(2, (int)plugin_get_ds("type7")->ds_num);
+
+  for (int i = 0; i < 100; i += 2) {
+    ssnprintf(type, sizeof(type), "type%d", i);
+    CHECK_ZERO(plugin_unregister_data_set(type));
+  }
+  int wrong = 0;
+  for (int i = 0; i < 100; i++) {
+    ssnprintf(type, sizeof(type), "type%d", i);
+    if ((plugin_get_ds(type) != NULL) != (i % 2))
+      wrong++;
+  }
+  EXPECT_EQ_INT(0, wrong);
+  OK(plugin_unregister_data_set("type0") != 0);
+
+  return 0;
+}
+
+static int write_cb(__attribute__((unused)) const data_set_t *ds,
+                    __attribute__((unused)) const value_list_t *vl,
+                    __attribute__((unused)) user_data_t *ud) {
+  return 0;
+}
+
+DEF_TEST(stats_names) {
+  char long_a[2 * DATA_MAX_NAME_LEN];
+  char long_b[2 * DATA_MAX_NAME_LEN];
+
+  memset(long_a, 'x', sizeof(long_a) - 1);
+  long_a[sizeof(long_a) - 1] = 0;
+  sstrncpy(long_b, long_a, sizeof(long_b));
+  long_a[sizeof(long_a) - 2] = 'a';
+  long_b[sizeof(long_b) - 2] = 'b';
+
+  char const *names[] = {
+      "curl-http://example.com/a", "curl-http:__example.com_a", long_a, long_b,
+  };
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(names); i++)
+    CHECK_ZERO(plugin_register_write(names[i], write_cb, NULL));
+
+  CHECK_ZERO(global_option_set("CollectInternalStats", "true", true));
+  CHECK_ZERO(global_option_set("ReadThreads", "1", true));
+  CHECK_ZERO(global_option_set("WriteThreads", "1", true));
+  CHECK_ZERO(plugin_init_all());
+
+  plugin_stats_t *stats = NULL;
+  size_t stats_num = 0;
+  CHECK_ZERO(plugin_get_stats(&stats, &stats_num));
+
+  /* Statistics are sorted by the full callback name and followed by the
+   * threads. Skip the daemon's own read callback. */
+  plugin_stats_t *write_stats = NULL;
+  for (size_t i = 0; i < stats_num; i++) {
+    if (stats[i].type == PLUGIN_STATS_WRITE) {
+      write_stats = stats + i;
+      break;
+    }
+  }
+  CHECK_NOT_NULL(write_stats);
+  OK(write_stats + STATIC_ARRAY_SIZE(names) <= stats + stats_num);
+
+  /* The first callback to be registered keeps its name, the other one with
+   * the same name gets a hash appended. */
+  EXPECT_EQ_STR("write-curl-http:__example.com_a", write_stats[0].name);
+  OK(strncmp("write-curl-http:__example.com_a-", write_stats[1].name,
+             strlen("write-curl-http:__example.com_a-")) == 0);
+  /* Long names are truncated, but remain unique. */
+  OK(strncmp("write-xxxxxxxxxx", write_stats[2].name,
+             strlen("write-xxxxxxxxxx")) == 0);
+  OK(strcmp(write_stats[2].name, write_stats[3].name) != 0);
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(names); i++) {
+    EXPECT_EQ_INT(PLUGIN_STATS_WRITE, write_stats[i].type);
+    OK(strchr(write_stats[i].name, '/') == NULL);
+  }
+
+  sfree(stats);
+  plugin_shutdown_all();
+  return 0;
+}
+
+int main(void) {
+  hostname_set("example.com");
+  interval_g = TIME_T_TO_CDTIME_T(10);
+  plugin_init_ctx();
+
+  RUN_TEST(cache_event_mask);
+  RUN_TEST(data_sets);
+  RUN_TEST(stats_names);
+
+  END_TEST;
+}
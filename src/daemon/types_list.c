@@ -32,6 +32,48 @@
 #include "plugin.h"
 #include "types_list.h"
 
+#include <sys/mman.h>
+
+/* Parsing types.db is comparatively expensive, so the parsed data sets are
+ * stored in a binary cache file in the BaseDir, one per types.db. The cache
+ * is used if size, modification time and hash of the types.db match the
+ * values recorded in its header, and is ignored (and rewritten) otherwise.
+ *
+ * Layout: a types_cache_header_t, followed by "sets_num" records, each made
+ * up of a types_cache_record_t and its "ds_num" data_source_t. The cache is
+ * written and read by the same binary, so native byte order and struct
+ * layout are fine; the version and sizeof(data_source_t) guard against
+ * caches written by a different build. */
+#define TYPES_CACHE_MAGIC "collectd types.db cache"
+#define TYPES_CACHE_VERSION 1
+
+typedef struct {
+  uint64_t size;
+  int64_t mtime;
+  uint64_t hash;
+} types_cache_source_t;
+
+typedef struct {
+  char magic[24];
+  uint32_t version;
+  uint32_t ds_size;
+  types_cache_source_t source;
+  uint64_t sets_num;
+  uint64_t sources_num;
+  uint64_t checksum; /* of everything following the header */
+} types_cache_header_t;
+
+typedef struct {
+  char type[DATA_MAX_NAME_LEN];
+  uint64_t ds_num;
+} types_cache_record_t;
+
+typedef struct {
+  data_set_t *sets;
+  size_t sets_num;
+  size_t sources_num;
+} types_list_t;
+
 static int parse_ds(data_source_t *dsrc, char *buf, size_t buf_len) {
   char *dummy;
   char *saveptr;
@@ -93,7 +135,7 @@ static int parse_ds(data_source_t *dsrc, char *buf, size_t buf_len) {
   return 0;
 } /* int parse_ds */
 
-static void parse_line(char *buf) {
+static void parse_line(char *buf, types_list_t *list) {
   char *fields[64];
   size_t fields_num;
   fields_num = strsplit(buf, fields, 64);
@@ -122,12 +164,28 @@ static void parse_line(char *buf) {
       return;
     }
 
-  plugin_register_data_set(&ds);
-
-  sfree(ds.ds);
+  data_set_t *tmp =
+      realloc(list->sets, (list->sets_num + 1) * sizeof(*list->sets));
+  if (tmp == NULL) {
+    ERROR("types_list: parse_line: realloc failed.");
+    sfree(ds.ds);
+    return;
+  }
+  list->sets = tmp;
+  list->sets[list->sets_num] = ds;
+  list->sets_num++;
+  list->sources_num += ds.ds_num;
 } /* void parse_line */
 
-static void parse_file(FILE *fh) {
+static void types_list_free(types_list_t *list) {
+  for (size_t i = 0; i < list->sets_num; i++)
+    sfree(list->sets[i].ds);
+  sfree(list->sets);
+  list->sets_num = 0;
+  list->sources_num = 0;
+} /* void types_list_free */
+
+static void parse_file(FILE *fh, types_list_t *list) {
   char buf[4096];
   size_t buf_len;
 
@@ -154,10 +212,237 @@ static void parse_file(FILE *fh) {
     if (buf_len == 0)
       continue;
 
-    parse_line(buf);
+    parse_line(buf, list);
   } /* while (fgets) */
 } /* void parse_file */
 
+/* FNV-1a, processing eight bytes at a time: the cache is hashed in its
+ * entirety on every load. */
+static uint64_t types_cache_hash(uint64_t h, void const *data, size_t size) {
+  unsigned char const *ptr = data;
+  size_t i = 0;
+
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, ptr + i, sizeof(word));
+    h ^= word;
+    h *= 1099511628211ULL;
+    h ^= h >> 32;
+  }
+  for (; i < size; i++) {
+    h ^= ptr[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+} /* uint64_t types_cache_hash */
+
+#define TYPES_CACHE_HASH_INIT 14695981039346656037ULL
+
+/* Fills "src" from the open types.db and rewinds it. */
+static int types_cache_source(FILE *fh, types_cache_source_t *src) {
+  struct stat st;
+  if (fstat(fileno(fh), &st) != 0)
+    return -1;
+
+  src->size = (uint64_t)st.st_size;
+  src->mtime = (int64_t)st.st_mtime;
+  src->hash = TYPES_CACHE_HASH_INIT;
+
+  char buf[4096];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), fh)) > 0)
+    src->hash = types_cache_hash(src->hash, buf, len);
+
+  int status = ferror(fh) ? -1 : 0;
+  rewind(fh);
+  return status;
+} /* int types_cache_source */
+
+/* Returns non-zero if caching is disabled ("TypesDBCache") or no BaseDir is
+ * configured. */
+static int types_cache_file(char const *file, char *buf, size_t buf_size) {
+  if (!IS_TRUE(global_option_get("TypesDBCache")))
+    return -1;
+
+  char const *base_dir = global_option_get("BaseDir");
+  if ((base_dir == NULL) || (base_dir[0] == 0))
+    return -1;
+
+  uint64_t hash = types_cache_hash(TYPES_CACHE_HASH_INIT, file, strlen(file));
+  int status = snprintf(buf, buf_size, "%s/typesdb-%016" PRIx64 ".cache",
+                        base_dir, hash);
+  if ((status < 0) || ((size_t)status >= buf_size))
+    return -1;
+
+  return 0;
+} /* int types_cache_file */
+
+static int types_cache_check(types_cache_header_t const *hdr,
+                             types_cache_source_t const *src, size_t size) {
+  if ((memcmp(hdr->magic, TYPES_CACHE_MAGIC, sizeof(TYPES_CACHE_MAGIC)) != 0) ||
+      (hdr->version != TYPES_CACHE_VERSION) ||
+      (hdr->ds_size != sizeof(data_source_t)))
+    return -1;
+
+  if ((hdr->source.size != src->size) || (hdr->source.mtime != src->mtime) ||
+      (hdr->source.hash != src->hash))
+    return -1;
+
+  /* Guard against overflows before calculating the expected size. */
+  if ((hdr->sets_num > size) || (hdr->sources_num > size))
+    return -1;
+
+  uint64_t want = sizeof(*hdr) +
+                  hdr->sets_num * sizeof(types_cache_record_t) +
+                  hdr->sources_num * sizeof(data_source_t);
+  if (want != size)
+    return -1;
+
+  uint64_t checksum = types_cache_hash(TYPES_CACHE_HASH_INIT, hdr + 1,
+                                       size - sizeof(*hdr));
+  if (checksum != hdr->checksum)
+    return -1;
+
+  return 0;
+} /* int types_cache_check */
+
+/* Registers the data sets following "hdr", which has been validated by
+ * types_cache_check(). */
+static int types_cache_register(types_cache_header_t const *hdr) {
+  data_set_t *sets = calloc(hdr->sets_num + 1, sizeof(*sets));
+  if (sets == NULL)
+    return -1;
+
+  char const *ptr = (char const *)(hdr + 1);
+  uint64_t sources_num = 0;
+  size_t i;
+  for (i = 0; i < hdr->sets_num; i++) {
+    types_cache_record_t rec;
+    memcpy(&rec, ptr, sizeof(rec));
+    ptr += sizeof(rec);
+
+    sources_num += rec.ds_num;
+    if ((sources_num > hdr->sources_num) ||
+        (rec.type[sizeof(rec.type) - 1] != 0))
+      break;
+
+    sstrncpy(sets[i].type, rec.type, sizeof(sets[i].type));
+    sets[i].ds_num = (size_t)rec.ds_num;
+    /* The data sources are copied by plugin_register_data_sets(). */
+    sets[i].ds = (data_source_t *)ptr;
+    ptr += rec.ds_num * sizeof(data_source_t);
+  }
+
+  int status = -1;
+  if ((i == hdr->sets_num) && (sources_num == hdr->sources_num))
+    status = plugin_register_data_sets(sets, hdr->sets_num);
+
+  sfree(sets);
+  return status;
+} /* int types_cache_register */
+
+static int types_cache_load(char const *file,
+                            types_cache_source_t const *src) {
+  char cache_file[PATH_MAX];
+  if (types_cache_file(file, cache_file, sizeof(cache_file)) != 0)
+    return -1;
+
+  int fd = open(cache_file, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  if ((fstat(fd, &st) != 0) ||
+      (st.st_size < (off_t)sizeof(types_cache_header_t))) {
+    close(fd);
+    return -1;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  int status = types_cache_check(map, src, size);
+  if (status == 0)
+    status = types_cache_register(map);
+  else
+    INFO("types_list: Ignoring outdated cache `%s' of `%s'.", cache_file,
+         file);
+
+  munmap(map, size);
+  return status;
+} /* int types_cache_load */
+
+static int types_cache_write(char const *file,
+                             types_cache_source_t const *src,
+                             types_list_t const *list) {
+  char cache_file[PATH_MAX];
+  if (types_cache_file(file, cache_file, sizeof(cache_file)) != 0)
+    return -1;
+
+  char tmp_file[PATH_MAX + 8];
+  snprintf(tmp_file, sizeof(tmp_file), "%s.XXXXXX", cache_file);
+
+  int fd = mkstemp(tmp_file);
+  if (fd < 0) {
+    DEBUG("types_list: mkstemp(%s) failed: %s", tmp_file, STRERRNO);
+    return -1;
+  }
+
+  FILE *fh = fdopen(fd, "w");
+  if (fh == NULL) {
+    close(fd);
+    unlink(tmp_file);
+    return -1;
+  }
+
+  types_cache_header_t hdr = {
+      .version = TYPES_CACHE_VERSION,
+      .ds_size = sizeof(data_source_t),
+      .source = *src,
+      .sets_num = list->sets_num,
+      .sources_num = list->sources_num,
+      .checksum = TYPES_CACHE_HASH_INIT,
+  };
+  memcpy(hdr.magic, TYPES_CACHE_MAGIC, sizeof(TYPES_CACHE_MAGIC));
+
+  /* The header is written last, once the checksum is known. */
+  int status = fseek(fh, sizeof(hdr), SEEK_SET);
+  for (size_t i = 0; (status == 0) && (i < list->sets_num); i++) {
+    data_set_t const *ds = list->sets + i;
+    types_cache_record_t rec = {.ds_num = ds->ds_num};
+    sstrncpy(rec.type, ds->type, sizeof(rec.type));
+
+    hdr.checksum = types_cache_hash(hdr.checksum, &rec, sizeof(rec));
+    hdr.checksum = types_cache_hash(hdr.checksum, ds->ds,
+                                    ds->ds_num * sizeof(*ds->ds));
+    if ((fwrite(&rec, sizeof(rec), 1, fh) != 1) ||
+        ((ds->ds_num > 0) &&
+         (fwrite(ds->ds, sizeof(*ds->ds), ds->ds_num, fh) != ds->ds_num)))
+      status = -1;
+  }
+
+  if ((status == 0) && ((fseek(fh, 0, SEEK_SET) != 0) ||
+                        (fwrite(&hdr, sizeof(hdr), 1, fh) != 1)))
+    status = -1;
+
+  if (fclose(fh) != 0)
+    status = -1;
+
+  if ((status == 0) && (rename(tmp_file, cache_file) != 0))
+    status = -1;
+
+  if (status != 0) {
+    DEBUG("types_list: Writing `%s' failed: %s", cache_file, STRERRNO);
+    unlink(tmp_file);
+  }
+
+  return status;
+} /* int types_cache_write */
+
 int read_types_list(const char *file) {
   FILE *fh;
 
@@ -172,11 +457,26 @@ int read_types_list(const char *file) {
     return -1;
   }
 
-  parse_file(fh);
+  types_cache_source_t src;
+  bool have_source = (types_cache_source(fh, &src) == 0);
+  if (have_source && (types_cache_load(file, &src) == 0)) {
+    fclose(fh);
+    DEBUG("Done loading `%s' from the cache", file);
+    return 0;
+  }
+
+  types_list_t list = {0};
+  parse_file(fh, &list);
 
   fclose(fh);
   fh = NULL;
 
+  plugin_register_data_sets(list.sets, list.sets_num);
+  if (have_source)
+    types_cache_write(file, &src, &list);
+
+  types_list_free(&list);
+
   DEBUG("Done parsing `%s'", file);
 
   return 0;
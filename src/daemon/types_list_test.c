@@ -0,0 +1,186 @@
+/**
+ * collectd - src/daemon/types_list_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* The mocked plugin_register_data_sets() fails; remember the data sets
+ * instead. */
+#define plugin_register_data_sets test_register_data_sets
+#include "types_list.c" /* sic */
+#undef plugin_register_data_sets
+
+#include "testing.h"
+
+#define MANY_TYPES 2000
+
+static char tmp_dir[] = "/tmp/types_list_test.XXXXXX";
+static char types_db[PATH_MAX];
+
+static size_t registered_num;
+static data_set_t registered_last;
+static data_source_t registered_last_ds[4];
+
+int test_register_data_sets(const data_set_t *ds, size_t ds_num) {
+  registered_num = ds_num;
+  if (ds_num == 0)
+    return 0;
+
+  registered_last = ds[ds_num - 1];
+  memset(registered_last_ds, 0, sizeof(registered_last_ds));
+  for (size_t i = 0; (i < registered_last.ds_num) && (i < 4); i++)
+    registered_last_ds[i] = registered_last.ds[i];
+  registered_last.ds = registered_last_ds;
+  return 0;
+}
+
+static int write_types_db(char const *content) {
+  FILE *fh = fopen(types_db, "w");
+  if (fh == NULL)
+    return -1;
+  fputs(content, fh);
+  return fclose(fh);
+}
+
+static int cache_file_exists(void) {
+  char cache_file[PATH_MAX];
+  struct stat st;
+
+  if (types_cache_file(types_db, cache_file, sizeof(cache_file)) != 0)
+    return 0;
+  return stat(cache_file, &st) == 0;
+}
+
+/* Returns zero if the cache is valid for the current types.db. */
+static int cache_load(void) {
+  FILE *fh = fopen(types_db, "r");
+  if (fh == NULL)
+    return -1;
+
+  types_cache_source_t src;
+  int status = types_cache_source(fh, &src);
+  fclose(fh);
+  if (status != 0)
+    return status;
+
+  return types_cache_load(types_db, &src);
+}
+
+DEF_TEST(cache) {
+  CHECK_ZERO(write_types_db("# comment\n"
+                            "gauge value:GAUGE:U:U\n"
+                            "if_octets rx:DERIVE:0:U, tx:DERIVE:0:100\n"));
+
+  /* Caching is disabled by default. */
+  char cache_file[PATH_MAX];
+  OK(types_cache_file(types_db, cache_file, sizeof(cache_file)) != 0);
+  CHECK_ZERO(read_types_list(types_db));
+  EXPECT_EQ_INT(2, (int)registered_num);
+
+  CHECK_ZERO(global_option_set("TypesDBCache", "true", false));
+  OK(!cache_file_exists());
+  registered_num = 0;
+  CHECK_ZERO(read_types_list(types_db));
+  EXPECT_EQ_INT(2, (int)registered_num);
+  OK(cache_file_exists());
+
+  /* The second time around, the cache is used. */
+  registered_num = 0;
+  memset(&registered_last, 0, sizeof(registered_last));
+  CHECK_ZERO(cache_load());
+  EXPECT_EQ_INT(2, (int)registered_num);
+  EXPECT_EQ_STR("if_octets", registered_last.type);
+  EXPECT_EQ_INT(2, (int)registered_last.ds_num);
+  EXPECT_EQ_STR("tx", registered_last.ds[1].name);
+  EXPECT_EQ_INT(DS_TYPE_DERIVE, registered_last.ds[1].type);
+  EXPECT_EQ_DOUBLE(0, registered_last.ds[1].min);
+  EXPECT_EQ_DOUBLE(100, registered_last.ds[1].max);
+
+  /* Changing types.db invalidates the cache, even if size and modification
+   * time stay the same. */
+  struct stat st;
+  CHECK_ZERO(stat(types_db, &st));
+  CHECK_ZERO(write_types_db("# comment\n"
+                            "gauge value:GAUGE:U:U\n"
+                            "if_packets rx:DERIVE:0:U, tx:DERIVE:0:100\n"));
+  struct timespec times[2] = {st.st_atim, st.st_mtim};
+  CHECK_ZERO(utimensat(AT_FDCWD, types_db, times, 0));
+  OK(cache_load() != 0);
+
+  CHECK_ZERO(read_types_list(types_db));
+  EXPECT_EQ_STR("if_packets", registered_last.type);
+  CHECK_ZERO(cache_load());
+  EXPECT_EQ_STR("if_packets", registered_last.type);
+
+  /* A corrupted cache is ignored. */
+  CHECK_ZERO(types_cache_file(types_db, cache_file, sizeof(cache_file)));
+  FILE *fh = fopen(cache_file, "r+");
+  CHECK_NOT_NULL(fh);
+  fseek(fh, sizeof(types_cache_header_t) + 2, SEEK_SET);
+  fputc('X', fh);
+  fclose(fh);
+  OK(cache_load() != 0);
+
+  registered_num = 0;
+  CHECK_ZERO(read_types_list(types_db));
+  EXPECT_EQ_INT(2, (int)registered_num);
+  EXPECT_EQ_STR("if_packets", registered_last.type);
+  CHECK_ZERO(cache_load());
+
+  CHECK_ZERO(unlink(cache_file));
+  return 0;
+}
+
+/* Many types survive the round trip through the cache. */
+DEF_TEST(many_types) {
+  FILE *fh = fopen(types_db, "w");
+  CHECK_NOT_NULL(fh);
+  for (int i = 0; i < MANY_TYPES; i++)
+    fprintf(fh, "type%d rx:DERIVE:0:U, tx:DERIVE:0:U, err:GAUGE:0:100\n", i);
+  CHECK_ZERO(fclose(fh));
+
+  char cache_file[PATH_MAX];
+  CHECK_ZERO(types_cache_file(types_db, cache_file, sizeof(cache_file)));
+
+  /* Parses types.db and writes the cache. */
+  registered_num = 0;
+  CHECK_ZERO(read_types_list(types_db));
+  EXPECT_EQ_INT(MANY_TYPES, (int)registered_num);
+
+  registered_num = 0;
+  CHECK_ZERO(read_types_list(types_db));
+  EXPECT_EQ_INT(MANY_TYPES, (int)registered_num);
+  EXPECT_EQ_STR("err", registered_last.ds[2].name);
+
+  CHECK_ZERO(unlink(cache_file));
+  return 0;
+}
+
+int main(void) {
+  CHECK_NOT_NULL(mkdtemp(tmp_dir));
+  snprintf(types_db, sizeof(types_db), "%s/types.db", tmp_dir);
+  CHECK_ZERO(global_option_set("BaseDir", tmp_dir, false));
+
+  RUN_TEST(cache);
+  RUN_TEST(many_types);
+
+  unlink(types_db);
+  rmdir(tmp_dir);
+  END_TEST;
+}
@@ -29,18 +29,43 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
 #include "utils/common/common.h"
 #include "utils/metadata/meta_data.h"
 #include "utils_cache.h"
 
 #include <assert.h>
 
+/* Entries are kept in a timer wheel, indexed by the time at which they time
+ * out, so that uc_check_timeout() only looks at entries which are about to
+ * expire rather than at the entire cache. Each slot covers
+ * 2^UC_WHEEL_TICK_BITS cdtime_t units, i.e. one second. Entries which expire
+ * more than UC_WHEEL_SIZE seconds in the future are skipped until the wheel
+ * comes around again. */
+#define UC_WHEEL_SIZE 1024
+#define UC_WHEEL_TICK_BITS 30
+#define UC_WHEEL_SLOT(t)                                                       \
+  ((size_t)(((t) >> UC_WHEEL_TICK_BITS) % UC_WHEEL_SIZE))
+
+/* uc_update_batch() formats the identifiers of up to this many value lists
+ * before taking `cache_lock' once for all of them. */
+#define UC_UPDATE_BATCH_SIZE 32
+
 typedef struct cache_entry_s {
   char name[6 * DATA_MAX_NAME_LEN];
+  /* Lengths of host, plugin, plugin instance, type and type instance in
+   * "name", so that the identifier doesn't have to be parsed. */
+  uint8_t name_parts[5];
   size_t values_num;
   gauge_t *values_gauge;
   value_t *values_raw;
+  /* Derived from the data set by cache_entry_set_ds(), so that updates can
+   * handle all data sources in a single loop. ds_generation is the value of
+   * cache_ds_generation at the time. */
+  data_set_t const *ds;
+  unsigned int ds_generation;
+  int ds_type;       /* type of all data sources, or -1 if they differ */
+  gauge_t *ds_range; /* values_num minimums followed by values_num maximums */
   /* Time contained in the package
    * (for calculating rates) */
   cdtime_t last_time;
@@ -68,18 +93,34 @@ typedef struct cache_entry_s {
 
   meta_data_t *meta;
   unsigned long callbacks_mask;
+
+  /* Timer wheel: last_update + interval * timeout_g */
+  cdtime_t expires;
+  struct cache_entry_s *wheel_next;
+  struct cache_entry_s **wheel_pprev;
+  /* Set while uc_check_timeout() dispatches the entry as missing. */
+  bool expiring;
 } cache_entry_t;
 
 struct uc_iter_s {
-  c_avl_iterator_t *iter;
+  c_btree_iterator_t *iter;
 
   char *name;
   cache_entry_t *entry;
 };
 
-static c_avl_tree_t *cache_tree;
+static c_btree_t *cache_tree;
 static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* Incremented by uc_data_sets_changed(). Data sets may be freed and their
+ * memory reused for another data set, so comparing pointers is not enough to
+ * tell whether an entry's data set information is current. */
+static unsigned int cache_ds_generation;
+
+static cache_entry_t *cache_wheel[UC_WHEEL_SIZE];
+/* The first tick which has not been checked completely. */
+static cdtime_t cache_wheel_tick;
+
 static int cache_compare(const cache_entry_t *a, const cache_entry_t *b) {
 #if COLLECT_DEBUG
   assert((a != NULL) && (b != NULL));
@@ -90,22 +131,19 @@ static int cache_compare(const cache_entry_t *a, const cache_entry_t *b) {
 static cache_entry_t *cache_alloc(size_t values_num) {
   cache_entry_t *ce;
 
-  ce = calloc(1, sizeof(*ce));
+  /* The values and the data sources' ranges are stored right after the
+   * entry, so that an update touches as few cache lines as possible. */
+  ce = calloc(1, sizeof(*ce) + values_num * (sizeof(*ce->values_raw) +
+                                             3 * sizeof(*ce->values_gauge)));
   if (ce == NULL) {
     ERROR("utils_cache: cache_alloc: calloc failed.");
     return NULL;
   }
   ce->values_num = values_num;
 
-  ce->values_gauge = calloc(values_num, sizeof(*ce->values_gauge));
-  ce->values_raw = calloc(values_num, sizeof(*ce->values_raw));
-  if ((ce->values_gauge == NULL) || (ce->values_raw == NULL)) {
-    sfree(ce->values_gauge);
-    sfree(ce->values_raw);
-    sfree(ce);
-    ERROR("utils_cache: cache_alloc: calloc failed.");
-    return NULL;
-  }
+  ce->values_raw = (value_t *)(ce + 1);
+  ce->values_gauge = (gauge_t *)(ce->values_raw + values_num);
+  ce->ds_range = ce->values_gauge + values_num;
 
   ce->history = NULL;
   ce->history_length = 0;
@@ -118,8 +156,6 @@ static void cache_free(cache_entry_t *ce) {
   if (ce == NULL)
     return;
 
-  sfree(ce->values_gauge);
-  sfree(ce->values_raw);
   sfree(ce->history);
   if (ce->meta != NULL) {
     meta_data_destroy(ce->meta);
@@ -128,14 +164,145 @@ static void cache_free(cache_entry_t *ce) {
   sfree(ce);
 } /* void cache_free */
 
-static void uc_check_range(const data_set_t *ds, cache_entry_t *ce) {
-  for (size_t i = 0; i < ds->ds_num; i++) {
-    if (isnan(ce->values_gauge[i]))
-      continue;
-    else if (ce->values_gauge[i] < ds->ds[i].min)
-      ce->values_gauge[i] = NAN;
-    else if (ce->values_gauge[i] > ds->ds[i].max)
-      ce->values_gauge[i] = NAN;
+/* `cache_lock' has to be held when calling the cache_wheel_* functions. */
+static void cache_wheel_unlink(cache_entry_t *ce) {
+  if (ce->wheel_pprev == NULL)
+    return;
+
+  *ce->wheel_pprev = ce->wheel_next;
+  if (ce->wheel_next != NULL)
+    ce->wheel_next->wheel_pprev = ce->wheel_pprev;
+  ce->wheel_next = NULL;
+  ce->wheel_pprev = NULL;
+} /* void cache_wheel_unlink */
+
+/* Moves the entry to the slot matching its new expiry time. */
+static void cache_wheel_update(cache_entry_t *ce) {
+  cdtime_t expires = ce->last_update + ce->interval * timeout_g;
+  size_t slot = UC_WHEEL_SLOT(expires);
+
+  bool linked = (ce->wheel_pprev != NULL);
+  bool moved = (UC_WHEEL_SLOT(ce->expires) != slot);
+  ce->expires = expires;
+  if (linked && !moved)
+    return;
+
+  cache_wheel_unlink(ce);
+  ce->wheel_next = cache_wheel[slot];
+  if (ce->wheel_next != NULL)
+    ce->wheel_next->wheel_pprev = &ce->wheel_next;
+  cache_wheel[slot] = ce;
+  ce->wheel_pprev = &cache_wheel[slot];
+} /* void cache_wheel_update */
+
+/* Restores the value list's identifier from the cache entry's name. */
+static void cache_entry_to_vl(cache_entry_t const *ce, value_list_t *vl) {
+  char *parts[] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                   vl->type_instance};
+  char const *ptr = ce->name;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++) {
+    size_t len = ce->name_parts[i];
+
+    memcpy(parts[i], ptr, len);
+    parts[i][len] = 0;
+    /* Empty instances are omitted, including the "-" separator. */
+    if ((len != 0) || ((i != 2) && (i != 4)))
+      ptr += len + 1;
+  }
+} /* void cache_entry_to_vl */
+
+static void cache_entry_set_ds(cache_entry_t *ce, data_set_t const *ds) {
+  ce->ds_type = ds->ds[0].type;
+  for (size_t i = 0; i < ce->values_num; i++) {
+    if (ds->ds[i].type != ce->ds_type)
+      ce->ds_type = -1;
+    ce->ds_range[i] = ds->ds[i].min;
+    ce->ds_range[ce->values_num + i] = ds->ds[i].max;
+  }
+
+  ce->ds = ds;
+  ce->ds_generation = cache_ds_generation;
+} /* void cache_entry_set_ds */
+
+/* The rate functions handle all data sources of one type in a loop without
+ * branches, which the compiler can vectorize. `interval' is the time between
+ * the previous and the current value in seconds. */
+static void rates_counter(gauge_t *rates, value_t *raw, value_t const *values,
+                          size_t num, gauge_t interval) {
+  for (size_t i = 0; i < num; i++) {
+    counter_t old_value = raw[i].counter;
+    counter_t new_value = values[i].counter;
+    /* Same as counter_diff(): counters up to 2^32 are assumed to be 32 bit
+     * counters, the others wrap around at 2^64. */
+    counter_t wrap32 = (old_value > new_value) & (old_value <= UINT32_MAX);
+
+    rates[i] = (gauge_t)(new_value - old_value + (wrap32 << 32)) / interval;
+  }
+  memcpy(raw, values, num * sizeof(*raw));
+} /* void rates_counter */
+
+static void rates_gauge(gauge_t *rates, value_t *raw, value_t const *values,
+                        size_t num) {
+  for (size_t i = 0; i < num; i++)
+    rates[i] = values[i].gauge;
+  memcpy(raw, values, num * sizeof(*raw));
+} /* void rates_gauge */
+
+static void rates_derive(gauge_t *rates, value_t *raw, value_t const *values,
+                         size_t num, gauge_t interval) {
+  for (size_t i = 0; i < num; i++)
+    rates[i] = (gauge_t)(values[i].derive - raw[i].derive) / interval;
+  memcpy(raw, values, num * sizeof(*raw));
+} /* void rates_derive */
+
+static void rates_absolute(gauge_t *rates, value_t *raw, value_t const *values,
+                           size_t num, gauge_t interval) {
+  for (size_t i = 0; i < num; i++)
+    rates[i] = (gauge_t)values[i].absolute / interval;
+  memcpy(raw, values, num * sizeof(*raw));
+} /* void rates_absolute */
+
+/* Handles data sets with data sources of different types. */
+static int rates_mixed(cache_entry_t *ce, value_t const *values,
+                       gauge_t interval) {
+  for (size_t i = 0; i < ce->values_num; i++) {
+    switch (ce->ds->ds[i].type) {
+    case DS_TYPE_COUNTER:
+      rates_counter(ce->values_gauge + i, ce->values_raw + i, values + i, 1,
+                    interval);
+      break;
+    case DS_TYPE_GAUGE:
+      rates_gauge(ce->values_gauge + i, ce->values_raw + i, values + i, 1);
+      break;
+    case DS_TYPE_DERIVE:
+      rates_derive(ce->values_gauge + i, ce->values_raw + i, values + i, 1,
+                   interval);
+      break;
+    case DS_TYPE_ABSOLUTE:
+      rates_absolute(ce->values_gauge + i, ce->values_raw + i, values + i, 1,
+                     interval);
+      break;
+    default:
+      /* This shouldn't happen. */
+      ERROR("uc_update: Don't know how to handle data source type %i.",
+            ce->ds->ds[i].type);
+      return -1;
+    } /* switch (ce->ds->ds[i].type) */
+  }
+
+  return 0;
+} /* int rates_mixed */
+
+/* Prunes invalid gauge data. NAN limits and values compare false, so neither
+ * needs to be special-cased. */
+static void uc_check_range(cache_entry_t *ce) {
+  gauge_t const *min = ce->ds_range;
+  gauge_t const *max = ce->ds_range + ce->values_num;
+
+  for (size_t i = 0; i < ce->values_num; i++) {
+    gauge_t v = ce->values_gauge[i];
+    ce->values_gauge[i] = ((v < min[i]) | (v > max[i])) ? NAN : v;
   }
 } /* void uc_check_range */
 
@@ -157,6 +324,11 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
   }
 
   sstrncpy(ce->name, key, sizeof(ce->name));
+  ce->name_parts[0] = (uint8_t)strlen(vl->host);
+  ce->name_parts[1] = (uint8_t)strlen(vl->plugin);
+  ce->name_parts[2] = (uint8_t)strlen(vl->plugin_instance);
+  ce->name_parts[3] = (uint8_t)strlen(vl->type);
+  ce->name_parts[4] = (uint8_t)strlen(vl->type_instance);
 
   for (size_t i = 0; i < ds->ds_num; i++) {
     switch (ds->ds[i].type) {
@@ -193,8 +365,8 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
     } /* switch (ds->ds[i].type) */
   }   /* for (i) */
 
-  /* Prune invalid gauge data */
-  uc_check_range(ds, ce);
+  cache_entry_set_ds(ce, ds);
+  uc_check_range(ce);
 
   ce->last_time = vl->time;
   ce->last_update = cdtime();
@@ -205,11 +377,13 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
     ce->meta = meta_data_clone(vl->meta);
   }
 
-  if (c_avl_insert(cache_tree, key_copy, ce) != 0) {
+  if (c_btree_insert(cache_tree, key_copy, ce) != 0) {
     sfree(key_copy);
-    ERROR("uc_insert: c_avl_insert failed.");
+    cache_free(ce);
+    ERROR("uc_insert: c_btree_insert failed.");
     return -1;
   }
+  cache_wheel_update(ce);
 
   DEBUG("uc_insert: Added %s to the cache.", key);
   return 0;
@@ -218,53 +392,74 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
 int uc_init(void) {
   if (cache_tree == NULL)
     cache_tree =
-        c_avl_create((int (*)(const void *, const void *))cache_compare);
+        c_btree_create((int (*)(const void *, const void *))cache_compare);
 
   return 0;
 } /* int uc_init */
 
 int uc_check_timeout(void) {
   struct {
-    char *key;
+    cache_entry_t *ce;
     cdtime_t time;
     cdtime_t interval;
     unsigned long callbacks_mask;
   } *expired = NULL;
   size_t expired_num = 0;
+  size_t expired_size = 0;
 
   pthread_mutex_lock(&cache_lock);
   cdtime_t now = cdtime();
 
-  /* Build a list of entries to be flushed */
-  c_avl_iterator_t *iter = c_avl_get_iterator(cache_tree);
-  char *key = NULL;
-  cache_entry_t *ce = NULL;
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&ce) == 0) {
-    /* If the entry is fresh enough, continue. */
-    if ((now - ce->last_update) < (ce->interval * timeout_g))
-      continue;
+  /* Check all slots the wheel has passed since the last call, including the
+   * current one, but every slot at most once. Entries which are not due yet
+   * are left where they are. */
+  cdtime_t now_tick = now >> UC_WHEEL_TICK_BITS;
+  cdtime_t tick = cache_wheel_tick;
+  if ((tick > now_tick) || ((now_tick - tick) >= UC_WHEEL_SIZE))
+    tick = (now_tick >= UC_WHEEL_SIZE) ? now_tick - (UC_WHEEL_SIZE - 1) : 0;
+
+  bool oom = false;
+  for (; tick <= now_tick; tick++) {
+    cache_entry_t *ce = cache_wheel[tick % UC_WHEEL_SIZE];
+    while (ce != NULL) {
+      cache_entry_t *next = ce->wheel_next;
+
+      if (ce->expires > now) {
+        ce = next;
+        continue;
+      }
 
-    void *tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
-    if (tmp == NULL) {
-      ERROR("uc_check_timeout: realloc failed.");
-      continue;
-    }
-    expired = tmp;
+      if (expired_num >= expired_size) {
+        size_t new_size = (expired_size == 0) ? 16 : 2 * expired_size;
+        void *tmp = realloc(expired, new_size * sizeof(*expired));
+        if (tmp == NULL) {
+          ERROR("uc_check_timeout: realloc failed.");
+          oom = true;
+          break;
+        }
+        expired = tmp;
+        expired_size = new_size;
+      }
 
-    expired[expired_num].key = strdup(key);
-    expired[expired_num].time = ce->last_time;
-    expired[expired_num].interval = ce->interval;
-    expired[expired_num].callbacks_mask = ce->callbacks_mask;
+      /* The entry stays in the tree, and is kept from being freed, until it
+       * has been dispatched as missing. */
+      cache_wheel_unlink(ce);
+      ce->expiring = true;
 
-    if (expired[expired_num].key == NULL) {
-      ERROR("uc_check_timeout: strdup failed.");
-      continue;
-    }
+      expired[expired_num].ce = ce;
+      expired[expired_num].time = ce->last_time;
+      expired[expired_num].interval = ce->interval;
+      expired[expired_num].callbacks_mask = ce->callbacks_mask;
+      expired_num++;
 
-    expired_num++;
-  } /* while (c_avl_iterator_next) */
+      ce = next;
+    }
+    if (oom)
+      break;
+  }
+  /* After a failure, continue with the same slot next time. */
+  cache_wheel_tick = oom ? tick : now_tick;
 
-  c_avl_iterator_destroy(iter);
   pthread_mutex_unlock(&cache_lock);
 
   if (expired_num == 0) {
@@ -276,44 +471,46 @@ int uc_check_timeout(void) {
    * value from the cache, so that callbacks can still access the data stored,
    * including plugin specific meta data, rates, history, …. This must be done
    * without holding the lock, otherwise we will run into a deadlock if a
-   * plugin calls the cache interface. */
+   * plugin calls the cache interface. The name of an entry never changes, so
+   * it may be read without holding the lock. */
   for (size_t i = 0; i < expired_num; i++) {
     value_list_t vl = {
         .time = expired[i].time,
         .interval = expired[i].interval,
     };
 
-    if (parse_identifier_vl(expired[i].key, &vl) != 0) {
-      ERROR("uc_check_timeout: parse_identifier_vl (\"%s\") failed.",
-            expired[i].key);
-      continue;
-    }
+    cache_entry_to_vl(expired[i].ce, &vl);
 
     plugin_dispatch_missing(&vl);
 
     if (expired[i].callbacks_mask)
       plugin_dispatch_cache_event(CE_VALUE_EXPIRED, expired[i].callbacks_mask,
-                                  expired[i].key, &vl);
+                                  expired[i].ce->name, &vl);
   } /* for (i = 0; i < expired_num; i++) */
 
-  /* Now actually remove all the values from the cache. We don't re-evaluate
-   * the timestamp again, so in theory it is possible we remove a value after
-   * it is updated here. */
+  /* Now actually remove all the values from the cache. Values which have been
+   * updated in the meantime are put back into the timer wheel instead. */
   pthread_mutex_lock(&cache_lock);
+  now = cdtime();
   for (size_t i = 0; i < expired_num; i++) {
+    cache_entry_t *ce = expired[i].ce;
     char *key = NULL;
     cache_entry_t *value = NULL;
 
-    if (c_avl_remove(cache_tree, expired[i].key, (void *)&key,
-                     (void *)&value) != 0) {
-      ERROR("uc_check_timeout: c_avl_remove (\"%s\") failed.", expired[i].key);
-      sfree(expired[i].key);
+    ce->expiring = false;
+    if (ce->last_update + ce->interval * timeout_g > now) {
+      cache_wheel_update(ce);
+      continue;
+    }
+
+    if (c_btree_remove(cache_tree, ce->name, (void *)&key, (void *)&value) !=
+        0) {
+      ERROR("uc_check_timeout: c_btree_remove (\"%s\") failed.", ce->name);
       continue;
     }
+    assert(value == ce);
     sfree(key);
     cache_free(value);
-
-    sfree(expired[i].key);
   } /* for (i = 0; i < expired_num; i++) */
   pthread_mutex_unlock(&cache_lock);
 
@@ -321,80 +518,71 @@ int uc_check_timeout(void) {
   return 0;
 } /* int uc_check_timeout */
 
-int uc_update(const data_set_t *ds, const value_list_t *vl) {
+/* State of a single update, so that logging and dispatching cache events can
+ * happen after `cache_lock' has been released. */
+typedef struct {
   char name[6 * DATA_MAX_NAME_LEN];
+  bool pending; /* the cache has yet to be updated */
+  int status;
+  bool created; /* a new cache entry was created */
+  bool too_old; /* the value is not newer than the cached one */
+  cdtime_t last_time;
+  unsigned long callbacks_mask;
+} uc_update_t;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("uc_update: FORMAT_VL failed.");
-    return -1;
-  }
-
-  pthread_mutex_lock(&cache_lock);
+/* `cache_lock' has to be held when calling cache_update(). */
+static void cache_update(uc_update_t *u, const data_set_t *ds,
+                         const value_list_t *vl) {
+  u->created = false;
+  u->too_old = false;
+  u->callbacks_mask = 0;
+  u->status = -1;
 
   cache_entry_t *ce = NULL;
-  int status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) /* entry does not yet exist */
-  {
-    status = uc_insert(ds, vl, name);
-    pthread_mutex_unlock(&cache_lock);
-
-    if (status == 0)
-      plugin_dispatch_cache_event(CE_VALUE_NEW, 0 /* mask */, name, vl);
-
-    return status;
+  if (c_btree_get(cache_tree, u->name, (void *)&ce) != 0) {
+    /* entry does not yet exist */
+    u->status = uc_insert(ds, vl, u->name);
+    u->created = (u->status == 0);
+    return;
   }
 
   assert(ce != NULL);
   assert(ce->values_num == ds->ds_num);
 
   if (ce->last_time >= vl->time) {
-    pthread_mutex_unlock(&cache_lock);
-    NOTICE("uc_update: Value too old: name = %s; value time = %.3f; "
-           "last cache update = %.3f;",
-           name, CDTIME_T_TO_DOUBLE(vl->time),
-           CDTIME_T_TO_DOUBLE(ce->last_time));
-    return -1;
+    u->too_old = true;
+    u->last_time = ce->last_time;
+    return;
   }
 
-  for (size_t i = 0; i < ds->ds_num; i++) {
-    switch (ds->ds[i].type) {
-    case DS_TYPE_COUNTER: {
-      counter_t diff =
-          counter_diff(ce->values_raw[i].counter, vl->values[i].counter);
-      ce->values_gauge[i] =
-          ((double)diff) / (CDTIME_T_TO_DOUBLE(vl->time - ce->last_time));
-      ce->values_raw[i].counter = vl->values[i].counter;
-    } break;
-
-    case DS_TYPE_GAUGE:
-      ce->values_raw[i].gauge = vl->values[i].gauge;
-      ce->values_gauge[i] = vl->values[i].gauge;
-      break;
-
-    case DS_TYPE_DERIVE: {
-      derive_t diff = vl->values[i].derive - ce->values_raw[i].derive;
-
-      ce->values_gauge[i] =
-          ((double)diff) / (CDTIME_T_TO_DOUBLE(vl->time - ce->last_time));
-      ce->values_raw[i].derive = vl->values[i].derive;
-    } break;
-
-    case DS_TYPE_ABSOLUTE:
-      ce->values_gauge[i] = ((double)vl->values[i].absolute) /
-                            (CDTIME_T_TO_DOUBLE(vl->time - ce->last_time));
-      ce->values_raw[i].absolute = vl->values[i].absolute;
-      break;
+  if ((ce->ds != ds) || (ce->ds_generation != cache_ds_generation))
+    cache_entry_set_ds(ce, ds);
 
-    default:
-      /* This shouldn't happen. */
-      pthread_mutex_unlock(&cache_lock);
-      ERROR("uc_update: Don't know how to handle data source type %i.",
-            ds->ds[i].type);
-      return -1;
-    } /* switch (ds->ds[i].type) */
+  gauge_t interval = CDTIME_T_TO_DOUBLE(vl->time - ce->last_time);
+  switch (ce->ds_type) {
+  case DS_TYPE_COUNTER:
+    rates_counter(ce->values_gauge, ce->values_raw, vl->values, ce->values_num,
+                  interval);
+    break;
+  case DS_TYPE_GAUGE:
+    rates_gauge(ce->values_gauge, ce->values_raw, vl->values, ce->values_num);
+    break;
+  case DS_TYPE_DERIVE:
+    rates_derive(ce->values_gauge, ce->values_raw, vl->values, ce->values_num,
+                 interval);
+    break;
+  case DS_TYPE_ABSOLUTE:
+    rates_absolute(ce->values_gauge, ce->values_raw, vl->values,
+                   ce->values_num, interval);
+    break;
+  default:
+    if (rates_mixed(ce, vl->values, interval) != 0)
+      return;
+  }
 
-    DEBUG("uc_update: %s: ds[%" PRIsz "] = %lf", name, i, ce->values_gauge[i]);
-  } /* for (i) */
+  for (size_t i = 0; i < ce->values_num; i++)
+    DEBUG("uc_update: %s: ds[%" PRIsz "] = %lf", u->name, i,
+          ce->values_gauge[i]);
 
   /* Update the history if it exists. */
   if (ce->history != NULL) {
@@ -408,28 +596,113 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
     ce->history_index = (ce->history_index + 1) % ce->history_length;
   }
 
-  /* Prune invalid gauge data */
-  uc_check_range(ds, ce);
+  uc_check_range(ce);
 
   ce->last_time = vl->time;
   ce->last_update = cdtime();
   ce->interval = vl->interval;
+  if (!ce->expiring)
+    cache_wheel_update(ce);
 
   /* Check if cache entry has registered callbacks */
-  unsigned long callbacks_mask = ce->callbacks_mask;
+  u->callbacks_mask = ce->callbacks_mask;
+  u->status = 0;
+} /* void cache_update */
 
-  pthread_mutex_unlock(&cache_lock);
+/* Does the work that is not done while holding `cache_lock'. */
+static void cache_update_finish(uc_update_t const *u, const value_list_t *vl) {
+  if (u->too_old)
+    NOTICE("uc_update: Value too old: name = %s; value time = %.3f; "
+           "last cache update = %.3f;",
+           u->name, CDTIME_T_TO_DOUBLE(vl->time),
+           CDTIME_T_TO_DOUBLE(u->last_time));
+  else if (u->created)
+    plugin_dispatch_cache_event(CE_VALUE_NEW, 0 /* mask */, u->name, vl);
+  else if (u->callbacks_mask)
+    plugin_dispatch_cache_event(CE_VALUE_UPDATE, u->callbacks_mask, u->name,
+                                vl);
+} /* void cache_update_finish */
 
-  if (callbacks_mask)
-    plugin_dispatch_cache_event(CE_VALUE_UPDATE, callbacks_mask, name, vl);
+int uc_update(const data_set_t *ds, const value_list_t *vl) {
+  uc_update_t u;
 
-  return 0;
+  if (FORMAT_VL(u.name, sizeof(u.name), vl) != 0) {
+    ERROR("uc_update: FORMAT_VL failed.");
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache_lock);
+  cache_update(&u, ds, vl);
+  pthread_mutex_unlock(&cache_lock);
+
+  cache_update_finish(&u, vl);
+  return u.status;
 } /* int uc_update */
 
+int uc_update_batch(const data_set_t *const *ds, const value_list_t *const *vl,
+                    size_t num, size_t *ret_num) {
+  uc_update_t u[UC_UPDATE_BATCH_SIZE];
+  int failed = 0;
+
+  if (num > UC_UPDATE_BATCH_SIZE)
+    num = UC_UPDATE_BATCH_SIZE;
+
+  size_t batch_num;
+  for (batch_num = 0; batch_num < num; batch_num++) {
+    uc_update_t *this = u + batch_num;
+
+    this->pending = false;
+    this->status = 0;
+    this->created = false;
+    this->too_old = false;
+    this->callbacks_mask = 0;
+
+    if (ds[batch_num] == NULL)
+      continue;
+
+    if (FORMAT_VL(this->name, sizeof(this->name), vl[batch_num]) != 0) {
+      ERROR("uc_update_batch: FORMAT_VL failed.");
+      this->status = -1;
+      continue;
+    }
+
+    /* The caller has to handle the earlier value list before the cache is
+     * updated with a newer value for the same identifier. */
+    bool repeated = false;
+    for (size_t i = 0; (i < batch_num) && !repeated; i++)
+      repeated = u[i].pending && (strcmp(u[i].name, this->name) == 0);
+    if (repeated)
+      break;
+
+    this->pending = true;
+  }
+
+  pthread_mutex_lock(&cache_lock);
+  for (size_t i = 0; i < batch_num; i++)
+    if (u[i].pending)
+      cache_update(u + i, ds[i], vl[i]);
+  pthread_mutex_unlock(&cache_lock);
+
+  for (size_t i = 0; i < batch_num; i++) {
+    cache_update_finish(u + i, vl[i]);
+    if (u[i].status != 0)
+      failed++;
+  }
+
+  *ret_num = batch_num;
+  return failed;
+} /* int uc_update_batch */
+
+void uc_data_sets_changed(void) {
+  pthread_mutex_lock(&cache_lock);
+  cache_ds_generation++;
+  pthread_mutex_unlock(&cache_lock);
+} /* void uc_data_sets_changed */
+
 int uc_set_callbacks_mask(const char *name, unsigned long mask) {
   pthread_mutex_lock(&cache_lock);
   cache_entry_t *ce = NULL;
-  int status = c_avl_get(cache_tree, name, (void *)&ce);
+  int status = c_btree_get(cache_tree, name, (void *)&ce);
   if (status != 0) { /* Ouch, just created entry disappeared ?! */
     ERROR("uc_set_callbacks_mask: Couldn't find %s entry!", name);
     pthread_mutex_unlock(&cache_lock);
@@ -450,7 +723,7 @@ int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
 
   pthread_mutex_lock(&cache_lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
+  if (c_btree_get(cache_tree, name, (void *)&ce) == 0) {
     assert(ce != NULL);
 
     /* remove missing values from getval */
@@ -521,7 +794,7 @@ int uc_get_value_by_name(const char *name, value_t **ret_values,
 
   pthread_mutex_lock(&cache_lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
+  if (c_btree_get(cache_tree, name, (void *)&ce) == 0) {
     assert(ce != NULL);
 
     /* remove missing values from getval */
@@ -584,14 +857,14 @@ size_t uc_get_size(void) {
   size_t size_arrays = 0;
 
   pthread_mutex_lock(&cache_lock);
-  size_arrays = (size_t)c_avl_size(cache_tree);
+  size_arrays = (size_t)c_btree_size(cache_tree);
   pthread_mutex_unlock(&cache_lock);
 
   return size_arrays;
 }
 
 int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
-  c_avl_iterator_t *iter;
+  c_btree_iterator_t *iter;
   char *key;
   cache_entry_t *value;
 
@@ -607,7 +880,7 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
 
   pthread_mutex_lock(&cache_lock);
 
-  size_arrays = (size_t)c_avl_size(cache_tree);
+  size_arrays = (size_t)c_btree_size(cache_tree);
   if (size_arrays < 1) {
     /* Handle the "no values" case here, to avoid the error message when
      * calloc() returns NULL. */
@@ -625,14 +898,14 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
     return ENOMEM;
   }
 
-  iter = c_avl_get_iterator(cache_tree);
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&value) == 0) {
+  iter = c_btree_get_iterator(cache_tree);
+  while (c_btree_iterator_next(iter, (void *)&key, (void *)&value) == 0) {
     /* remove missing values when list values */
     if (value->state == STATE_MISSING)
       continue;
 
-    /* c_avl_size does not return a number smaller than the number of elements
-     * returned by c_avl_iterator_next. */
+    /* c_btree_size does not return a number smaller than the number of
+     * elements returned by c_btree_iterator_next. */
     assert(number < size_arrays);
 
     if (ret_times != NULL)
@@ -645,9 +918,9 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
     }
 
     number++;
-  } /* while (c_avl_iterator_next) */
+  } /* while (c_btree_iterator_next) */
 
-  c_avl_iterator_destroy(iter);
+  c_btree_iterator_destroy(iter);
   pthread_mutex_unlock(&cache_lock);
 
   if (status != 0) {
@@ -682,7 +955,7 @@ int uc_get_state(const data_set_t *ds, const value_list_t *vl) {
 
   pthread_mutex_lock(&cache_lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
+  if (c_btree_get(cache_tree, name, (void *)&ce) == 0) {
     assert(ce != NULL);
     ret = ce->state;
   }
@@ -704,7 +977,7 @@ int uc_set_state(const data_set_t *ds, const value_list_t *vl, int state) {
 
   pthread_mutex_lock(&cache_lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
+  if (c_btree_get(cache_tree, name, (void *)&ce) == 0) {
     assert(ce != NULL);
     ret = ce->state;
     ce->state = state;
@@ -722,7 +995,7 @@ int uc_get_history_by_name(const char *name, gauge_t *ret_history,
 
   pthread_mutex_lock(&cache_lock);
 
-  status = c_avl_get(cache_tree, name, (void *)&ce);
+  status = c_btree_get(cache_tree, name, (void *)&ce);
   if (status != 0) {
     pthread_mutex_unlock(&cache_lock);
     return -ENOENT;
@@ -799,7 +1072,7 @@ int uc_get_hits(const data_set_t *ds, const value_list_t *vl) {
 
   pthread_mutex_lock(&cache_lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
+  if (c_btree_get(cache_tree, name, (void *)&ce) == 0) {
     assert(ce != NULL);
     ret = ce->hits;
   }
@@ -821,7 +1094,7 @@ int uc_set_hits(const data_set_t *ds, const value_list_t *vl, int hits) {
 
   pthread_mutex_lock(&cache_lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
+  if (c_btree_get(cache_tree, name, (void *)&ce) == 0) {
     assert(ce != NULL);
     ret = ce->hits;
     ce->hits = hits;
@@ -844,7 +1117,7 @@ int uc_inc_hits(const data_set_t *ds, const value_list_t *vl, int step) {
 
   pthread_mutex_lock(&cache_lock);
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
+  if (c_btree_get(cache_tree, name, (void *)&ce) == 0) {
     assert(ce != NULL);
     ret = ce->hits;
     ce->hits = ret + step;
@@ -865,7 +1138,7 @@ uc_iter_t *uc_get_iterator(void) {
 
   pthread_mutex_lock(&cache_lock);
 
-  iter->iter = c_avl_get_iterator(cache_tree);
+  iter->iter = c_btree_get_iterator(cache_tree);
   if (iter->iter == NULL) {
     free(iter);
     return NULL;
@@ -880,8 +1153,8 @@ int uc_iterator_next(uc_iter_t *iter, char **ret_name) {
   if (iter == NULL)
     return -1;
 
-  while ((status = c_avl_iterator_next(iter->iter, (void *)&iter->name,
-                                       (void *)&iter->entry)) == 0) {
+  while ((status = c_btree_iterator_next(iter->iter, (void *)&iter->name,
+                                         (void *)&iter->entry)) == 0) {
     if (iter->entry->state == STATE_MISSING)
       continue;
 
@@ -899,11 +1172,20 @@ int uc_iterator_next(uc_iter_t *iter, char **ret_name) {
   return 0;
 } /* int uc_iterator_next */
 
+int uc_iterator_seek(uc_iter_t *iter, const char *name) {
+  if ((iter == NULL) || (name == NULL))
+    return -1;
+
+  iter->name = NULL;
+  iter->entry = NULL;
+  return c_btree_iterator_seek(iter->iter, name);
+} /* int uc_iterator_seek */
+
 void uc_iterator_destroy(uc_iter_t *iter) {
   if (iter == NULL)
     return;
 
-  c_avl_iterator_destroy(iter->iter);
+  c_btree_iterator_destroy(iter->iter);
   pthread_mutex_unlock(&cache_lock);
 
   free(iter);
@@ -969,7 +1251,7 @@ static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
 
   pthread_mutex_lock(&cache_lock);
 
-  status = c_avl_get(cache_tree, name, (void *)&ce);
+  status = c_btree_get(cache_tree, name, (void *)&ce);
   if (status != 0) {
     pthread_mutex_unlock(&cache_lock);
     return NULL;
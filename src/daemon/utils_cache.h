@@ -40,6 +40,17 @@
 int uc_init(void);
 int uc_check_timeout(void);
 int uc_update(const data_set_t *ds, const value_list_t *vl);
+/* Same as calling uc_update() for each value list, but takes the cache lock
+ * only once. ds[i] is the data set of vl[i]; value lists with a NULL data set
+ * are skipped. Stops before the first value list whose identifier occurred
+ * earlier in the batch, so that the caller can finish handling the earlier
+ * value list, e.g. run the post-cache chain, first. The number of value lists
+ * handled, at least one if "num" is not zero, is stored in "ret_num". Returns
+ * the number of handled value lists which could not be stored. */
+int uc_update_batch(const data_set_t *const *ds, const value_list_t *const *vl,
+                    size_t num, size_t *ret_num);
+/* Has to be called when a data set is replaced or removed. */
+void uc_data_sets_changed(void);
 int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
                         size_t *ret_values_num);
 gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl);
@@ -103,6 +114,21 @@ uc_iter_t *uc_get_iterator(void);
 int uc_iterator_next(uc_iter_t *iter, char **ret_name);
 void uc_iterator_destroy(uc_iter_t *iter);
 
+/*
+ * NAME
+ *   uc_iterator_seek
+ *
+ * DESCRIPTION
+ *   Position the iterator so that the next call to `uc_iterator_next' returns
+ *   the first entry whose name is greater than or equal to `name'. Since
+ *   entries are sorted by name, this can be used to only visit the entries
+ *   starting with a given prefix.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the iterator or the name is NULL.
+ */
+int uc_iterator_seek(uc_iter_t *iter, const char *name);
+
 /* Return the timestamp of the value at the current position. */
 int uc_iterator_get_time(uc_iter_t *iter, cdtime_t *ret_time);
 /* Return the (raw) value at the current position. */
@@ -68,3 +68,29 @@ int uc_meta_data_add_unsigned_int(const value_list_t *vl, const char *key,
                                   uint64_t value) {
   return 0;
 }
+
+uc_iter_t *uc_get_iterator(void) {
+  errno = ENOTSUP;
+  return NULL;
+}
+
+int uc_iterator_next(uc_iter_t *iter, char **ret_name) { return -1; }
+
+void uc_iterator_destroy(uc_iter_t *iter) {}
+
+int uc_iterator_seek(uc_iter_t *iter, const char *name) { return -1; }
+
+int uc_iterator_get_time(uc_iter_t *iter, cdtime_t *ret_time) { return -1; }
+
+int uc_iterator_get_values(uc_iter_t *iter, value_t **ret_values,
+                           size_t *ret_num) {
+  return -1;
+}
+
+int uc_iterator_get_interval(uc_iter_t *iter, cdtime_t *ret_interval) {
+  return -1;
+}
+
+int uc_iterator_get_meta(uc_iter_t *iter, meta_data_t **ret_meta) {
+  return -1;
+}
@@ -0,0 +1,421 @@
+/**
+ * collectd - src/daemon/utils_cache_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "utils_cache.c" /* sic */
+
+#define MANY_ENTRIES 5000
+
+/* provided by the mocked utils_time.c */
+extern cdtime_t cdtime_mock;
+
+int timeout_g = 2;
+
+static value_list_t missing_vl;
+static int missing_num;
+
+int plugin_dispatch_missing(const value_list_t *vl) {
+  missing_vl = *vl;
+  missing_num++;
+  return 0;
+}
+
+void plugin_dispatch_cache_event(
+    enum cache_event_type_e __attribute__((unused)) event_type,
+    unsigned long __attribute__((unused)) callbacks_mask,
+    const char __attribute__((unused)) * name,
+    const value_list_t __attribute__((unused)) * vl) {}
+
+static data_source_t dsrc = {"value", DS_TYPE_GAUGE, 0, NAN};
+static data_set_t ds = {"gauge", 1, &dsrc};
+
+static int update(char const *plugin_instance, char const *type_instance,
+                  int interval) {
+  value_list_t vl = {
+      .values = &(value_t){.gauge = 42},
+      .values_len = 1,
+      .time = cdtime_mock,
+      .interval = TIME_T_TO_CDTIME_T(interval),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "gauge",
+  };
+  sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
+  sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
+
+  return uc_update(&ds, &vl);
+}
+
+/* Advances the clock by "seconds" and returns the number of expired values. */
+static int check_timeout(int seconds) {
+  cdtime_mock += TIME_T_TO_CDTIME_T(seconds);
+  missing_num = 0;
+  uc_check_timeout();
+  return missing_num;
+}
+
+static int cache_size(void) {
+  pthread_mutex_lock(&cache_lock);
+  int size = c_btree_size(cache_tree);
+  pthread_mutex_unlock(&cache_lock);
+  return size;
+}
+
+DEF_TEST(timeout) {
+  CHECK_ZERO(update("", "", 10));
+  CHECK_ZERO(update("a-b", "c-d", 10));
+  CHECK_ZERO(update("", "long", 3600));
+  EXPECT_EQ_INT(3, cache_size());
+
+  /* Values expire after Timeout (2) intervals. */
+  EXPECT_EQ_INT(0, check_timeout(15));
+  CHECK_ZERO(update("", "", 10));
+  EXPECT_EQ_INT(1, check_timeout(5));
+  EXPECT_EQ_INT(2, cache_size());
+
+  /* The identifier is restored from the cache entry. */
+  EXPECT_EQ_STR("example.com", missing_vl.host);
+  EXPECT_EQ_STR("test", missing_vl.plugin);
+  EXPECT_EQ_STR("a-b", missing_vl.plugin_instance);
+  EXPECT_EQ_STR("gauge", missing_vl.type);
+  EXPECT_EQ_STR("c-d", missing_vl.type_instance);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(10), missing_vl.interval);
+
+  EXPECT_EQ_INT(0, check_timeout(14));
+  EXPECT_EQ_INT(1, check_timeout(1));
+  EXPECT_EQ_STR("", missing_vl.plugin_instance);
+  EXPECT_EQ_STR("", missing_vl.type_instance);
+
+  /* Not checking for longer than a revolution of the timer wheel doesn't
+   * skip any entries; entries due in a later revolution are kept. */
+  EXPECT_EQ_INT(0, check_timeout(2 * UC_WHEEL_SIZE));
+  EXPECT_EQ_INT(0, check_timeout(7200 - 35 - 2 * UC_WHEEL_SIZE - 1));
+  EXPECT_EQ_INT(1, check_timeout(1));
+  EXPECT_EQ_STR("long", missing_vl.type_instance);
+  EXPECT_EQ_INT(0, cache_size());
+
+  return 0;
+}
+
+DEF_TEST(seek) {
+  char const *type_instances[] = {"a", "b1", "b2", "c"};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(type_instances); i++)
+    CHECK_ZERO(update("", type_instances[i], 10));
+
+  uc_iter_t *iter = uc_get_iterator();
+  CHECK_NOT_NULL(iter);
+
+  char const *prefix = "example.com/test/gauge-b";
+  char *name;
+  int num = 0;
+  CHECK_ZERO(uc_iterator_seek(iter, prefix));
+  while ((uc_iterator_next(iter, &name) == 0) &&
+         (strncmp(prefix, name, strlen(prefix)) == 0))
+    num++;
+  EXPECT_EQ_INT(2, num);
+
+  CHECK_ZERO(uc_iterator_seek(iter, "example.com/test/gauge-c"));
+  CHECK_ZERO(uc_iterator_next(iter, &name));
+  EXPECT_EQ_STR("example.com/test/gauge-c", name);
+  EXPECT_EQ_INT(-1, uc_iterator_next(iter, &name));
+  uc_iterator_destroy(iter);
+
+  EXPECT_EQ_INT(4, check_timeout(30));
+  return 0;
+}
+
+static data_source_t mixed_dsrc[] = {
+    {"counter", DS_TYPE_COUNTER, 0, NAN},
+    {"gauge", DS_TYPE_GAUGE, NAN, 100},
+    {"derive", DS_TYPE_DERIVE, 0, NAN},
+    {"absolute", DS_TYPE_ABSOLUTE, 0, NAN},
+};
+static data_set_t mixed_ds = {"mixed", 4, mixed_dsrc};
+
+static data_source_t counter_dsrc[] = {
+    {"c32", DS_TYPE_COUNTER, 0, NAN},
+    {"c64", DS_TYPE_COUNTER, 0, NAN},
+    {"cmax", DS_TYPE_COUNTER, 0, 1},
+};
+static data_set_t counter_ds = {"counters", 3, counter_dsrc};
+
+static void rates_vl(value_list_t *vl, data_set_t const *ds,
+                     char const *type_instance, value_t *values, int step) {
+  *vl = (value_list_t){
+      .values = values,
+      .values_len = ds->ds_num,
+      .time = cdtime_mock + TIME_T_TO_CDTIME_T(10 * step),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "rates",
+  };
+  sstrncpy(vl->type, ds->type, sizeof(vl->type));
+  sstrncpy(vl->type_instance, type_instance, sizeof(vl->type_instance));
+}
+
+/* Updates the cache twice, using the value lists in "values". */
+static int rates_update(data_set_t const *ds, value_t values[2][4],
+                        bool batch) {
+  for (int step = 0; step < 2; step++) {
+    value_list_t vl;
+    rates_vl(&vl, ds, batch ? "batch" : "single", values[step], step);
+
+    size_t num = 0;
+    if (!batch)
+      CHECK_ZERO(uc_update(ds, &vl));
+    else
+      CHECK_ZERO(uc_update_batch(&(const data_set_t *){ds},
+                                 &(const value_list_t *){&vl}, 1, &num));
+  }
+  return 0;
+}
+
+DEF_TEST(rates) {
+  value_t mixed[2][4] = {
+      {{.counter = 100}, {.gauge = 42}, {.derive = 1000}, {.absolute = 0}},
+      {{.counter = 200}, {.gauge = 142}, {.derive = 900}, {.absolute = 50}},
+  };
+  value_t counters[2][4] = {
+      {{.counter = UINT32_MAX - 9},
+       {.counter = UINT64_MAX - 9},
+       {.counter = 0}},
+      {{.counter = 10}, {.counter = 10}, {.counter = 20}},
+  };
+
+  for (int batch = 0; batch < 2; batch++) {
+    CHECK_ZERO(rates_update(&mixed_ds, mixed, batch));
+    CHECK_ZERO(rates_update(&counter_ds, counters, batch));
+
+    char const *names[] = {"example.com/rates/mixed-single",
+                           "example.com/rates/mixed-batch",
+                           "example.com/rates/counters-single",
+                           "example.com/rates/counters-batch"};
+    gauge_t *rates;
+    size_t rates_num;
+    CHECK_ZERO(uc_get_rate_by_name(names[batch], &rates, &rates_num));
+    EXPECT_EQ_INT(4, rates_num);
+    EXPECT_EQ_DOUBLE(10, rates[0]);
+    EXPECT_EQ_DOUBLE(NAN, rates[1]); /* greater than the maximum */
+    EXPECT_EQ_DOUBLE(NAN, rates[2]); /* less than the minimum */
+    EXPECT_EQ_DOUBLE(5, rates[3]);
+    sfree(rates);
+
+    /* Counters wrap around at 2^32 if the previous value fits into 32 bits
+     * and at 2^64 otherwise. */
+    CHECK_ZERO(uc_get_rate_by_name(names[2 + batch], &rates, &rates_num));
+    EXPECT_EQ_INT(3, rates_num);
+    EXPECT_EQ_DOUBLE(2, rates[0]);
+    EXPECT_EQ_DOUBLE(2, rates[1]);
+    EXPECT_EQ_DOUBLE(NAN, rates[2]);
+    sfree(rates);
+  }
+
+  /* Values which are not newer than the cached ones are rejected. */
+  value_list_t vl;
+  rates_vl(&vl, &mixed_ds, "single", mixed[1], 1);
+  OK(uc_update(&mixed_ds, &vl) != 0);
+  size_t num = 0;
+  EXPECT_EQ_INT(1, uc_update_batch(&(const data_set_t *){&mixed_ds},
+                                   &(const value_list_t *){&vl}, 1, &num));
+  EXPECT_EQ_INT(1, num);
+  /* Value lists without a data set are skipped. */
+  EXPECT_EQ_INT(0, uc_update_batch(&(const data_set_t *){NULL},
+                                   &(const value_list_t *){&vl}, 1, &num));
+  EXPECT_EQ_INT(1, num);
+
+  EXPECT_EQ_INT(4, check_timeout(30));
+  return 0;
+}
+
+DEF_TEST(batch_repeated) {
+  static data_source_t derive_dsrc = {"value", DS_TYPE_DERIVE, 0, NAN};
+  data_set_t derive_ds = {"derive", 1, &derive_dsrc};
+  value_t values[4] = {{.derive = 0}, {.derive = 0}, {.derive = 100},
+                       {.derive = 300}};
+  value_list_t vl[4];
+  value_list_t const *vl_ptr[4];
+  data_set_t const *ds_ptr[4];
+
+  /* "a" is created, "b" is created and updated twice within one batch. */
+  rates_vl(vl + 0, &derive_ds, "a", values + 0, 0);
+  rates_vl(vl + 1, &derive_ds, "b", values + 1, 0);
+  rates_vl(vl + 2, &derive_ds, "b", values + 2, 1);
+  rates_vl(vl + 3, &derive_ds, "b", values + 3, 2);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(vl); i++) {
+    vl_ptr[i] = vl + i;
+    ds_ptr[i] = &derive_ds;
+  }
+
+  /* Each call stops before the repeated identifier, so that the rate of
+   * every value list can be read before the next one is stored. */
+  gauge_t want[] = {NAN, 10, 20};
+  size_t done = 0;
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(want); i++) {
+    size_t num = 0;
+    EXPECT_EQ_INT(0, uc_update_batch(ds_ptr + done, vl_ptr + done,
+                                     STATIC_ARRAY_SIZE(vl) - done, &num));
+    EXPECT_EQ_INT(i == 0 ? 2 : 1, num);
+
+    gauge_t *rates;
+    size_t rates_num;
+    CHECK_ZERO(uc_get_rate_by_name("example.com/rates/derive-b", &rates,
+                                   &rates_num));
+    EXPECT_EQ_DOUBLE(want[i], rates[0]);
+    sfree(rates);
+    done += num;
+  }
+  EXPECT_EQ_INT(STATIC_ARRAY_SIZE(vl), done);
+
+  EXPECT_EQ_INT(2, check_timeout(30));
+  return 0;
+}
+
+DEF_TEST(data_set_changed) {
+  data_source_t dsrc = {"value", DS_TYPE_GAUGE, 0, 100};
+  data_set_t gauge_ds = {"gauge", 1, &dsrc};
+  value_t value = {.gauge = 500};
+  value_list_t vl;
+
+  rates_vl(&vl, &gauge_ds, "changed", &value, 0);
+  CHECK_ZERO(uc_update(&gauge_ds, &vl));
+  gauge_t *rates;
+  size_t rates_num;
+  CHECK_ZERO(uc_get_rate_by_name("example.com/rates/gauge-changed", &rates,
+                                 &rates_num));
+  EXPECT_EQ_DOUBLE(NAN, rates[0]);
+  sfree(rates);
+
+  /* A replaced data set may be allocated at the address of the old one. */
+  dsrc.max = 1000;
+  uc_data_sets_changed();
+
+  rates_vl(&vl, &gauge_ds, "changed", &value, 1);
+  CHECK_ZERO(uc_update(&gauge_ds, &vl));
+  CHECK_ZERO(uc_get_rate_by_name("example.com/rates/gauge-changed", &rates,
+                                 &rates_num));
+  EXPECT_EQ_DOUBLE(500, rates[0]);
+  sfree(rates);
+
+  EXPECT_EQ_INT(1, check_timeout(30));
+  return 0;
+}
+
+/* Entries which are not due are not expired, no matter how many there
+ * are. */
+DEF_TEST(many_entries) {
+  char name[DATA_MAX_NAME_LEN];
+  int failed = 0;
+
+  for (int i = 0; i < MANY_ENTRIES; i++) {
+    snprintf(name, sizeof(name), "%d", i);
+    if (update("", name, 10) != 0)
+      failed++;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(MANY_ENTRIES, cache_size());
+
+  for (int i = 0; i < 10; i++)
+    EXPECT_EQ_INT(0, check_timeout(1));
+  EXPECT_EQ_INT(MANY_ENTRIES, check_timeout(10));
+  EXPECT_EQ_INT(0, cache_size());
+  return 0;
+}
+
+#define MANY_UPDATES 1000
+#define MANY_DS_NUM 8
+
+/* Updates "MANY_UPDATES" entries in two rounds, batching more value lists
+ * than fit into one call of uc_update_batch(). */
+DEF_TEST(update_batch_many) {
+  data_source_t dsrc[MANY_DS_NUM];
+  for (int i = 0; i < MANY_DS_NUM; i++)
+    dsrc[i] = (data_source_t){"value", DS_TYPE_DERIVE, 0, NAN};
+  data_set_t many_ds = {"many", MANY_DS_NUM, dsrc};
+
+  value_list_t vl[UC_UPDATE_BATCH_SIZE];
+  value_list_t const *vl_ptr[UC_UPDATE_BATCH_SIZE];
+  data_set_t const *ds_ptr[UC_UPDATE_BATCH_SIZE];
+  value_t values[UC_UPDATE_BATCH_SIZE][MANY_DS_NUM];
+  int failed = 0;
+
+  for (int step = 0; step < 2; step++) {
+    for (int i = 0; i < MANY_UPDATES; i += UC_UPDATE_BATCH_SIZE) {
+      int num = MANY_UPDATES - i;
+      if (num > UC_UPDATE_BATCH_SIZE)
+        num = UC_UPDATE_BATCH_SIZE;
+
+      for (int j = 0; j < num; j++) {
+        char type_instance[DATA_MAX_NAME_LEN];
+        snprintf(type_instance, sizeof(type_instance), "%d", i + j);
+        rates_vl(vl + j, &many_ds, type_instance, values[j], step);
+        for (int k = 0; k < MANY_DS_NUM; k++)
+          values[j][k].derive = 1000 * step + k;
+        vl_ptr[j] = vl + j;
+        ds_ptr[j] = &many_ds;
+      }
+
+      for (int j = 0; j < num;) {
+        size_t done = 0;
+        failed += uc_update_batch(ds_ptr + j, vl_ptr + j, num - j, &done);
+        j += done;
+      }
+    }
+  }
+  EXPECT_EQ_INT(0, failed);
+
+  /* Each counter grew by 1000 in ten seconds. */
+  int wrong = 0;
+  for (int i = 0; i < MANY_UPDATES; i++) {
+    char name[6 * DATA_MAX_NAME_LEN];
+    snprintf(name, sizeof(name), "example.com/rates/many-%d", i);
+
+    gauge_t *rates = NULL;
+    size_t rates_num = 0;
+    if ((uc_get_rate_by_name(name, &rates, &rates_num) != 0) ||
+        (rates_num != MANY_DS_NUM)) {
+      wrong++;
+      sfree(rates);
+      continue;
+    }
+    for (size_t k = 0; k < rates_num; k++)
+      wrong += (rates[k] != 100.0);
+    sfree(rates);
+  }
+  EXPECT_EQ_INT(0, wrong);
+
+  EXPECT_EQ_INT(MANY_UPDATES, check_timeout(30));
+  return 0;
+}
+
+int main(void) {
+  uc_init();
+
+  RUN_TEST(timeout);
+  RUN_TEST(seek);
+  RUN_TEST(rates);
+  RUN_TEST(batch_repeated);
+  RUN_TEST(data_set_changed);
+  RUN_TEST(many_entries);
+  RUN_TEST(update_batch_many);
+
+  END_TEST;
+}
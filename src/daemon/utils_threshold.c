@@ -26,8 +26,8 @@
 
 #include "collectd.h"
 
-#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/hashmap/hashmap.h"
 #include "utils_threshold.h"
 
 #include <pthread.h>
@@ -35,7 +35,7 @@
 /*
  * Exported symbols
  * {{{ */
-c_avl_tree_t *threshold_tree = NULL;
+c_hashmap_t *threshold_tree = NULL;
 pthread_mutex_t threshold_lock = PTHREAD_MUTEX_INITIALIZER;
 /* }}} */
 
@@ -57,7 +57,7 @@ threshold_t *threshold_get(const char *hostname, const char *plugin,
               (type == NULL) ? "" : type, type_instance);
   name[sizeof(name) - 1] = '\0';
 
-  if (c_avl_get(threshold_tree, name, (void *)&th) == 0)
+  if (c_hashmap_get(threshold_tree, name, (void *)&th) == 0)
     return th;
   else
     return NULL;
@@ -49,7 +49,7 @@ typedef struct threshold_s {
   struct threshold_s *next;
 } threshold_t;
 
-extern c_avl_tree_t *threshold_tree;
+extern c_hashmap_t *threshold_tree;
 extern pthread_mutex_t threshold_lock;
 
 threshold_t *threshold_get(const char *hostname, const char *plugin,
@@ -24,16 +24,22 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/ignorelist/ignorelist.h"
 #include "utils/mount/mount.h"
 
+#if KERNEL_LINUX
+#include <poll.h>
+#endif
+
 #if HAVE_STATVFS
 #if HAVE_SYS_STATVFS_H
 #include <sys/statvfs.h>
 #endif
 #define STATANYFS statvfs
 #define STATANYFS_STR "statvfs"
+typedef struct statvfs df_statbuf_t;
 #define BLOCKSIZE(s) ((s).f_frsize ? (s).f_frsize : (s).f_bsize)
 #elif HAVE_STATFS
 #if HAVE_SYS_STATFS_H
@@ -41,6 +47,7 @@
 #endif
 #define STATANYFS statfs
 #define STATANYFS_STR "statfs"
+typedef struct statfs df_statbuf_t;
 #define BLOCKSIZE(s) (s).f_bsize
 #else
 #error "No applicable input method."
@@ -49,7 +56,8 @@
 static const char *config_keys[] = {
     "Device",         "MountPoint",       "FSType",
     "IgnoreSelected", "ReportByDevice",   "ReportInodes",
-    "ValuesAbsolute", "ValuesPercentage", "LogOnce"};
+    "ValuesAbsolute", "ValuesPercentage", "LogOnce",
+    "StatTimeout"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static ignorelist_t *il_device;
@@ -62,6 +70,48 @@ static bool report_inodes;
 static bool values_absolute = true;
 static bool values_percentage;
 static bool log_once;
+static cdtime_t stat_timeout;
+
+/* File systems for which STATANYFS() may block for a long time, e.g. because
+ * the server went away. With "StatTimeout" these are queried from a separate
+ * thread each, so a single hung mount cannot stall the entire read. */
+static const char *network_fstypes[] = {
+    "nfs",  "nfs4",      "cifs",   "smb3",           "smbfs",
+    "ncpfs", "afs",      "ceph",   "glusterfs",      "fuse.glusterfs",
+    "9p",   "lustre",    "gpfs",   "fuse.sshfs",     "fuse.s3fs"};
+
+/* State of an asynchronous STATANYFS() call. The structure is shared between
+ * the read callback and the stat thread and is freed by whoever drops the last
+ * reference, since the read callback may give up on a hung call. */
+typedef struct {
+  char *dir;
+  df_statbuf_t statbuf;
+  int status;
+  int errnum;
+  bool done;
+  int refs;
+} df_stat_job_t;
+
+static pthread_mutex_t stat_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stat_cond = PTHREAD_COND_INITIALIZER;
+
+/* Mount which passed the ignorelists and the duplicate check. Decisions are
+ * only re-evaluated when the mount table changes. */
+typedef struct {
+  cu_mount_t *mnt;
+  char disk_name[256];
+  bool network;
+  df_stat_job_t *job;
+} df_mount_t;
+
+static cu_mount_t *mnt_list;
+static df_mount_t *mounts;
+static size_t mounts_num;
+static bool mounts_valid;
+
+#if KERNEL_LINUX
+static int mountinfo_fd = -1;
+#endif
 
 static int df_init(void) {
   if (il_device == NULL)
@@ -135,6 +185,14 @@ static int df_config(const char *key, const char *value) {
       log_once = false;
 
     return 0;
+  } else if (strcasecmp(key, "StatTimeout") == 0) {
+    double timeout = atof(value);
+    if (timeout < 0.0) {
+      ERROR("df plugin: StatTimeout must not be negative.");
+      return 1;
+    }
+    stat_timeout = DOUBLE_TO_CDTIME_T(timeout);
+    return 0;
   }
 
   return -1;
@@ -158,31 +216,161 @@ __attribute__((nonnull(2))) static void df_submit_one(char *plugin_instance,
   plugin_dispatch_values(&vl);
 } /* void df_submit_one */
 
-static int df_read(void) {
-#if HAVE_STATVFS
-  struct statvfs statbuf;
-#elif HAVE_STATFS
-  struct statfs statbuf;
-#endif
-  int retval = 0;
-  /* struct STATANYFS statbuf; */
-  cu_mount_t *mnt_list;
+static void df_stat_job_release(df_stat_job_t *job) {
+  /* must be called with stat_lock held */
+  job->refs--;
+  if (job->refs > 0)
+    return;
+
+  sfree(job->dir);
+  sfree(job);
+} /* void df_stat_job_release */
+
+static void *df_stat_thread(void *arg) {
+  df_stat_job_t *job = arg;
+  df_statbuf_t statbuf;
+
+  int status = STATANYFS(job->dir, &statbuf);
+  int errnum = errno;
+
+  pthread_mutex_lock(&stat_lock);
+  job->statbuf = statbuf;
+  job->status = status;
+  job->errnum = errnum;
+  job->done = true;
+  pthread_cond_broadcast(&stat_cond);
+  df_stat_job_release(job);
+  pthread_mutex_unlock(&stat_lock);
+
+  return NULL;
+} /* void *df_stat_thread */
+
+/* Starts an asynchronous STATANYFS() for "m". Returns zero if a call is in
+ * progress afterwards. */
+static int df_stat_job_start(df_mount_t *m) {
+  pthread_mutex_lock(&stat_lock);
+  if (m->job != NULL) {
+    if (!m->job->done) {
+      /* The call started during a previous interval is still hanging. Don't
+       * pile up threads on the same mount. */
+      pthread_mutex_unlock(&stat_lock);
+      WARNING("df plugin: " STATANYFS_STR "(%s) is still in progress, "
+              "skipping this mount.",
+              m->mnt->dir);
+      return -1;
+    }
+    df_stat_job_release(m->job);
+    m->job = NULL;
+  }
+  pthread_mutex_unlock(&stat_lock);
+
+  df_stat_job_t *job = calloc(1, sizeof(*job));
+  if (job == NULL)
+    return -1;
+  job->dir = strdup(m->mnt->dir);
+  if (job->dir == NULL) {
+    sfree(job);
+    return -1;
+  }
+  /* One reference for the mount, one for the thread. */
+  job->refs = 2;
+
+  pthread_t thread;
+  int status = plugin_thread_create(&thread, df_stat_thread, job, "df stat");
+  if (status != 0) {
+    ERROR("df plugin: plugin_thread_create failed: %s", STRERROR(status));
+    sfree(job->dir);
+    sfree(job);
+    return -1;
+  }
+  pthread_detach(thread);
 
+  m->job = job;
+  return 0;
+} /* int df_stat_job_start */
+
+static void df_mounts_free(void) {
+  pthread_mutex_lock(&stat_lock);
+  for (size_t i = 0; i < mounts_num; i++)
+    if (mounts[i].job != NULL)
+      df_stat_job_release(mounts[i].job);
+  pthread_mutex_unlock(&stat_lock);
+
+  sfree(mounts);
+  mounts_num = 0;
+  cu_mount_freelist(mnt_list);
   mnt_list = NULL;
-  if (cu_mount_getlist(&mnt_list) == NULL) {
+  mounts_valid = false;
+} /* void df_mounts_free */
+
+/* Returns true if the mount table may have changed since the last call. On
+ * systems without change notification this always returns true. */
+static bool df_mounts_changed(void) {
+#if KERNEL_LINUX
+  if (mountinfo_fd < 0) {
+    mountinfo_fd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+    if (mountinfo_fd < 0) {
+      WARNING("df plugin: Unable to open /proc/self/mountinfo: %s. "
+              "The mount table will be re-read every interval.",
+              STRERRNO);
+      return true;
+    }
+    /* The kernel only signals changes after the file has been opened. */
+    return true;
+  }
+
+  struct pollfd pfd = {.fd = mountinfo_fd, .events = POLLPRI};
+  int status = poll(&pfd, 1, /* timeout = */ 0);
+  if (status < 0) {
+    WARNING("df plugin: poll(/proc/self/mountinfo) failed: %s", STRERRNO);
+    return true;
+  }
+
+  return !mounts_valid || (pfd.revents & (POLLERR | POLLPRI)) != 0;
+#else
+  return true;
+#endif
+} /* bool df_mounts_changed */
+
+static bool df_is_network_fs(char const *type) {
+  if (type == NULL)
+    return false;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(network_fstypes); i++)
+    if (strcmp(type, network_fstypes[i]) == 0)
+      return true;
+
+  return false;
+} /* bool df_is_network_fs */
+
+/* Re-reads the mount table and applies the ignorelists and duplicate check
+ * once, so the read callback only has to walk the selected mounts. */
+static int df_mounts_refresh(void) {
+  cu_mount_t *new_list = NULL;
+  if (cu_mount_getlist(&new_list) == NULL) {
     ERROR("df plugin: cu_mount_getlist failed.");
     return -1;
   }
 
-  for (cu_mount_t *mnt_ptr = mnt_list; mnt_ptr != NULL;
-       mnt_ptr = mnt_ptr->next) {
-    unsigned long long blocksize;
-    char disk_name[256];
-    cu_mount_t *dup_ptr;
-    uint64_t blk_free;
-    uint64_t blk_reserved;
-    uint64_t blk_used;
+  size_t num = 0;
+  for (cu_mount_t *mnt_ptr = new_list; mnt_ptr != NULL;
+       mnt_ptr = mnt_ptr->next)
+    num++;
+
+  df_mount_t *new_mounts = calloc(num > 0 ? num : 1, sizeof(*new_mounts));
+  c_avl_tree_t *seen = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if ((new_mounts == NULL) || (seen == NULL)) {
+    ERROR("df plugin: Out of memory.");
+    sfree(new_mounts);
+    if (seen != NULL)
+      c_avl_destroy(seen);
+    cu_mount_freelist(new_list);
+    return -1;
+  }
 
+  size_t new_num = 0;
+  for (cu_mount_t *mnt_ptr = new_list; mnt_ptr != NULL;
+       mnt_ptr = mnt_ptr->next) {
     char const *dev =
         (mnt_ptr->spec_device != NULL) ? mnt_ptr->spec_device : mnt_ptr->device;
 
@@ -193,69 +381,99 @@ static int df_read(void) {
     if (ignorelist_match(il_fstype, mnt_ptr->type))
       continue;
 
-    /* search for duplicates *in front of* the current mnt_ptr. */
-    for (dup_ptr = mnt_list; dup_ptr != NULL; dup_ptr = dup_ptr->next) {
-      /* No duplicate found: mnt_ptr is the first of its kind. */
-      if (dup_ptr == mnt_ptr) {
-        dup_ptr = NULL;
-        break;
-      }
-
-      /* Duplicate found: leave non-NULL dup_ptr. */
-      if (by_device && (mnt_ptr->spec_device != NULL) &&
-          (dup_ptr->spec_device != NULL) &&
-          (strcmp(mnt_ptr->spec_device, dup_ptr->spec_device) == 0))
-        break;
-      else if (!by_device && (strcmp(mnt_ptr->dir, dup_ptr->dir) == 0))
-        break;
-    }
-
-    /* ignore duplicates */
-    if (dup_ptr != NULL)
-      continue;
-
-    if (STATANYFS(mnt_ptr->dir, &statbuf) < 0) {
-      if (log_once == false || ignorelist_match(il_errors, mnt_ptr->dir) == 0) {
-        if (log_once == true) {
-          ignorelist_add(il_errors, mnt_ptr->dir);
-        }
-        ERROR(STATANYFS_STR "(%s) failed: %s", mnt_ptr->dir, STRERRNO);
-      }
-      continue;
-    } else {
-      if (log_once == true) {
-        ignorelist_remove(il_errors, mnt_ptr->dir);
-      }
+    /* ignore duplicates: only the first mount of its kind is reported. */
+    char *key = by_device ? mnt_ptr->spec_device : mnt_ptr->dir;
+    if (key != NULL) {
+      if (c_avl_get(seen, key, NULL) == 0)
+        continue;
+      c_avl_insert(seen, key, NULL);
     }
 
-    if (!statbuf.f_blocks)
-      continue;
+    df_mount_t *m = new_mounts + new_num;
+    m->mnt = mnt_ptr;
+    m->network = df_is_network_fs(mnt_ptr->type);
 
     if (by_device) {
       /* eg, /dev/hda1  -- strip off the "/dev/" */
       if (strncmp(dev, "/dev/", strlen("/dev/")) == 0)
-        sstrncpy(disk_name, dev + strlen("/dev/"), sizeof(disk_name));
+        sstrncpy(m->disk_name, dev + strlen("/dev/"), sizeof(m->disk_name));
       else
-        sstrncpy(disk_name, dev, sizeof(disk_name));
+        sstrncpy(m->disk_name, dev, sizeof(m->disk_name));
 
-      if (strlen(disk_name) < 1) {
+      if (strlen(m->disk_name) < 1) {
         DEBUG("df: no device name for mountpoint %s, skipping", mnt_ptr->dir);
         continue;
       }
     } else {
       if (strcmp(mnt_ptr->dir, "/") == 0)
-        sstrncpy(disk_name, "root", sizeof(disk_name));
+        sstrncpy(m->disk_name, "root", sizeof(m->disk_name));
       else {
-        sstrncpy(disk_name, mnt_ptr->dir + 1, sizeof(disk_name));
-        size_t len = strlen(disk_name);
+        sstrncpy(m->disk_name, mnt_ptr->dir + 1, sizeof(m->disk_name));
+        size_t len = strlen(m->disk_name);
 
         for (size_t i = 0; i < len; i++)
-          if (disk_name[i] == '/')
-            disk_name[i] = '-';
+          if (m->disk_name[i] == '/')
+            m->disk_name[i] = '-';
       }
     }
 
-    blocksize = BLOCKSIZE(statbuf);
+    new_num++;
+  }
+  c_avl_destroy(seen);
+
+  /* Hand over calls still in progress to the new list, so a hung mount
+   * doesn't get a second thread after an unrelated mount table change. */
+  pthread_mutex_lock(&stat_lock);
+  for (size_t i = 0; i < mounts_num; i++) {
+    if (mounts[i].job == NULL)
+      continue;
+    for (size_t j = 0; j < new_num; j++) {
+      if (new_mounts[j].network &&
+          strcmp(mounts[i].mnt->dir, new_mounts[j].mnt->dir) == 0) {
+        new_mounts[j].job = mounts[i].job;
+        mounts[i].job = NULL;
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&stat_lock);
+
+  df_mounts_free();
+  mnt_list = new_list;
+  mounts = new_mounts;
+  mounts_num = new_num;
+  mounts_valid = true;
+
+  DEBUG("df plugin: %" PRIsz " of the mounted file systems are selected.",
+        mounts_num);
+  return 0;
+} /* int df_mounts_refresh */
+
+static void df_stat_failed(char const *dir, int errnum) {
+  if (log_once == false || ignorelist_match(il_errors, dir) == 0) {
+    if (log_once == true) {
+      ignorelist_add(il_errors, dir);
+    }
+    ERROR(STATANYFS_STR "(%s) failed: %s", dir, STRERROR(errnum));
+  }
+} /* void df_stat_failed */
+
+static int df_submit_mount(df_mount_t *m, df_statbuf_t *statbuf_ptr) {
+  df_statbuf_t statbuf = *statbuf_ptr;
+  unsigned long long blocksize;
+  uint64_t blk_free;
+  uint64_t blk_reserved;
+  uint64_t blk_used;
+  char *disk_name = m->disk_name;
+
+  if (log_once == true) {
+    ignorelist_remove(il_errors, m->mnt->dir);
+  }
+
+  if (!statbuf.f_blocks)
+    return 0;
+
+  blocksize = BLOCKSIZE(statbuf);
 
 /*
  * Sanity-check for the values in the struct
@@ -264,98 +482,185 @@ static int df_read(void) {
  * report negative free space for user. Notice. blk_reserved
  * will start to diminish after this. */
 #if HAVE_STATVFS
-    /* Cast and temporary variable are needed to avoid
-     * compiler warnings.
-     * ((struct statvfs).f_bavail is unsigned (POSIX)) */
-    int64_t signed_bavail = (int64_t)statbuf.f_bavail;
-    if (signed_bavail < 0)
-      statbuf.f_bavail = 0;
+  /* Cast and temporary variable are needed to avoid
+   * compiler warnings.
+   * ((struct statvfs).f_bavail is unsigned (POSIX)) */
+  int64_t signed_bavail = (int64_t)statbuf.f_bavail;
+  if (signed_bavail < 0)
+    statbuf.f_bavail = 0;
 #elif HAVE_STATFS
-    if (statbuf.f_bavail < 0)
-      statbuf.f_bavail = 0;
+  if (statbuf.f_bavail < 0)
+    statbuf.f_bavail = 0;
 #endif
-    /* Make sure that f_blocks >= f_bfree >= f_bavail */
-    if (statbuf.f_bfree < statbuf.f_bavail)
-      statbuf.f_bfree = statbuf.f_bavail;
-    if (statbuf.f_blocks < statbuf.f_bfree)
-      statbuf.f_blocks = statbuf.f_bfree;
-
-    blk_free = (uint64_t)statbuf.f_bavail;
-    blk_reserved = (uint64_t)(statbuf.f_bfree - statbuf.f_bavail);
-    blk_used = (uint64_t)(statbuf.f_blocks - statbuf.f_bfree);
+  /* Make sure that f_blocks >= f_bfree >= f_bavail */
+  if (statbuf.f_bfree < statbuf.f_bavail)
+    statbuf.f_bfree = statbuf.f_bavail;
+  if (statbuf.f_blocks < statbuf.f_bfree)
+    statbuf.f_blocks = statbuf.f_bfree;
+
+  blk_free = (uint64_t)statbuf.f_bavail;
+  blk_reserved = (uint64_t)(statbuf.f_bfree - statbuf.f_bavail);
+  blk_used = (uint64_t)(statbuf.f_blocks - statbuf.f_bfree);
+
+  if (values_absolute) {
+    df_submit_one(disk_name, "df_complex", "free",
+                  (gauge_t)(blk_free * blocksize));
+    df_submit_one(disk_name, "df_complex", "reserved",
+                  (gauge_t)(blk_reserved * blocksize));
+    df_submit_one(disk_name, "df_complex", "used",
+                  (gauge_t)(blk_used * blocksize));
+  }
 
-    if (values_absolute) {
-      df_submit_one(disk_name, "df_complex", "free",
-                    (gauge_t)(blk_free * blocksize));
-      df_submit_one(disk_name, "df_complex", "reserved",
-                    (gauge_t)(blk_reserved * blocksize));
-      df_submit_one(disk_name, "df_complex", "used",
-                    (gauge_t)(blk_used * blocksize));
+  if (values_percentage) {
+    if (statbuf.f_blocks > 0) {
+      df_submit_one(disk_name, "percent_bytes", "free",
+                    (gauge_t)((float_t)(blk_free) / statbuf.f_blocks * 100));
+      df_submit_one(
+          disk_name, "percent_bytes", "reserved",
+          (gauge_t)((float_t)(blk_reserved) / statbuf.f_blocks * 100));
+      df_submit_one(disk_name, "percent_bytes", "used",
+                    (gauge_t)((float_t)(blk_used) / statbuf.f_blocks * 100));
+    } else {
+      return -1;
     }
+  }
+
+  /* inode handling */
+  if (report_inodes && statbuf.f_files != 0 && statbuf.f_ffree != 0) {
+    uint64_t inode_free;
+    uint64_t inode_reserved;
+    uint64_t inode_used;
+
+    /* Sanity-check for the values in the struct */
+    if (statbuf.f_ffree < statbuf.f_favail)
+      statbuf.f_ffree = statbuf.f_favail;
+    if (statbuf.f_files < statbuf.f_ffree)
+      statbuf.f_files = statbuf.f_ffree;
+
+    inode_free = (uint64_t)statbuf.f_favail;
+    inode_reserved = (uint64_t)(statbuf.f_ffree - statbuf.f_favail);
+    inode_used = (uint64_t)(statbuf.f_files - statbuf.f_ffree);
 
     if (values_percentage) {
-      if (statbuf.f_blocks > 0) {
-        df_submit_one(disk_name, "percent_bytes", "free",
-                      (gauge_t)((float_t)(blk_free) / statbuf.f_blocks * 100));
+      if (statbuf.f_files > 0) {
+        df_submit_one(disk_name, "percent_inodes", "free",
+                      (gauge_t)((float_t)(inode_free) / statbuf.f_files * 100));
         df_submit_one(
-            disk_name, "percent_bytes", "reserved",
-            (gauge_t)((float_t)(blk_reserved) / statbuf.f_blocks * 100));
-        df_submit_one(disk_name, "percent_bytes", "used",
-                      (gauge_t)((float_t)(blk_used) / statbuf.f_blocks * 100));
+            disk_name, "percent_inodes", "reserved",
+            (gauge_t)((float_t)(inode_reserved) / statbuf.f_files * 100));
+        df_submit_one(disk_name, "percent_inodes", "used",
+                      (gauge_t)((float_t)(inode_used) / statbuf.f_files * 100));
       } else {
-        retval = -1;
-        break;
+        return -1;
       }
     }
+    if (values_absolute) {
+      df_submit_one(disk_name, "df_inodes", "free", (gauge_t)inode_free);
+      df_submit_one(disk_name, "df_inodes", "reserved",
+                    (gauge_t)inode_reserved);
+      df_submit_one(disk_name, "df_inodes", "used", (gauge_t)inode_used);
+    }
+  }
 
-    /* inode handling */
-    if (report_inodes && statbuf.f_files != 0 && statbuf.f_ffree != 0) {
-      uint64_t inode_free;
-      uint64_t inode_reserved;
-      uint64_t inode_used;
-
-      /* Sanity-check for the values in the struct */
-      if (statbuf.f_ffree < statbuf.f_favail)
-        statbuf.f_ffree = statbuf.f_favail;
-      if (statbuf.f_files < statbuf.f_ffree)
-        statbuf.f_files = statbuf.f_ffree;
-
-      inode_free = (uint64_t)statbuf.f_favail;
-      inode_reserved = (uint64_t)(statbuf.f_ffree - statbuf.f_favail);
-      inode_used = (uint64_t)(statbuf.f_files - statbuf.f_ffree);
-
-      if (values_percentage) {
-        if (statbuf.f_files > 0) {
-          df_submit_one(
-              disk_name, "percent_inodes", "free",
-              (gauge_t)((float_t)(inode_free) / statbuf.f_files * 100));
-          df_submit_one(
-              disk_name, "percent_inodes", "reserved",
-              (gauge_t)((float_t)(inode_reserved) / statbuf.f_files * 100));
-          df_submit_one(
-              disk_name, "percent_inodes", "used",
-              (gauge_t)((float_t)(inode_used) / statbuf.f_files * 100));
-        } else {
-          retval = -1;
-          break;
-        }
-      }
-      if (values_absolute) {
-        df_submit_one(disk_name, "df_inodes", "free", (gauge_t)inode_free);
-        df_submit_one(disk_name, "df_inodes", "reserved",
-                      (gauge_t)inode_reserved);
-        df_submit_one(disk_name, "df_inodes", "used", (gauge_t)inode_used);
-      }
+  return 0;
+} /* int df_submit_mount */
+
+static int df_read(void) {
+  int retval = 0;
+  bool async = (stat_timeout > 0);
+  size_t pending = 0;
+
+  if (df_mounts_changed() && (df_mounts_refresh() != 0)) {
+    /* Keep using the last known mount table, if any. */
+    if (!mounts_valid)
+      return -1;
+  }
+
+  /* Start the potentially blocking calls first, so they run concurrently
+   * with the local file systems. */
+  if (async) {
+    for (size_t i = 0; i < mounts_num; i++) {
+      if (!mounts[i].network)
+        continue;
+      if (df_stat_job_start(mounts + i) == 0)
+        pending++;
     }
   }
 
-  cu_mount_freelist(mnt_list);
+  for (size_t i = 0; i < mounts_num; i++) {
+    df_mount_t *m = mounts + i;
+    df_statbuf_t statbuf;
+
+    if (async && m->network)
+      continue;
+
+    if (STATANYFS(m->mnt->dir, &statbuf) < 0) {
+      df_stat_failed(m->mnt->dir, errno);
+      continue;
+    }
+
+    if (df_submit_mount(m, &statbuf) != 0)
+      retval = -1;
+  }
+
+  if (pending == 0)
+    return retval;
+
+  cdtime_t deadline = cdtime() + stat_timeout;
+  struct timespec ts_deadline = CDTIME_T_TO_TIMESPEC(deadline);
+
+  pthread_mutex_lock(&stat_lock);
+  for (size_t i = 0; i < mounts_num; i++) {
+    df_mount_t *m = mounts + i;
+    df_stat_job_t *job = m->job;
+
+    if (!m->network || (job == NULL))
+      continue;
+
+    while (!job->done) {
+      if (pthread_cond_timedwait(&stat_cond, &stat_lock, &ts_deadline) ==
+          ETIMEDOUT)
+        break;
+    }
+
+    if (!job->done) {
+      WARNING("df plugin: " STATANYFS_STR "(%s) did not return within %.3f "
+              "seconds.",
+              m->mnt->dir, CDTIME_T_TO_DOUBLE(stat_timeout));
+      continue;
+    }
+
+    m->job = NULL;
+    df_statbuf_t statbuf = job->statbuf;
+    int status = job->status;
+    int errnum = job->errnum;
+    df_stat_job_release(job);
+
+    if (status < 0)
+      df_stat_failed(m->mnt->dir, errnum);
+    else if (df_submit_mount(m, &statbuf) != 0)
+      retval = -1;
+  }
+  pthread_mutex_unlock(&stat_lock);
 
   return retval;
 } /* int df_read */
 
+static int df_shutdown(void) {
+  df_mounts_free();
+#if KERNEL_LINUX
+  if (mountinfo_fd >= 0) {
+    close(mountinfo_fd);
+    mountinfo_fd = -1;
+  }
+#endif
+
+  return 0;
+} /* int df_shutdown */
+
 void module_register(void) {
   plugin_register_config("df", df_config, config_keys, config_keys_num);
   plugin_register_init("df", df_init);
   plugin_register_read("df", df_read);
+  plugin_register_shutdown("df", df_shutdown);
 } /* void module_register */
@@ -696,7 +696,7 @@ static int dpdk_events_init(void) {
 }
 
 void module_register(void) {
-  plugin_register_init(DPDK_EVENTS_PLUGIN, dpdk_events_init);
+  plugin_register_independent_init(DPDK_EVENTS_PLUGIN, dpdk_events_init);
   plugin_register_complex_config(DPDK_EVENTS_PLUGIN, dpdk_events_config);
   plugin_register_complex_read(NULL, DPDK_EVENTS_PLUGIN, dpdk_events_read, 0,
                                NULL);
@@ -31,12 +31,15 @@
 
 #include "collectd.h"
 
+#include "network.h"
 #include "plugin.h"
 #include "utils/common/common.h"
 
 #include "utils/cmds/putnotif.h"
 #include "utils/cmds/putval.h"
+#include "utils_complain.h"
 
+#include <arpa/inet.h>
 #include <grp.h>
 #include <poll.h>
 #include <pwd.h>
@@ -51,9 +54,16 @@ extern char **environ;
 
 #define PL_NORMAL 0x01
 #define PL_NOTIF_ACTION 0x02
+#define PL_BINARY 0x04
+#define PL_PERSISTENT 0x08
 
 #define PL_RUNNING 0x10
 
+/* Upper limit for the size of one frame of the binary protocol. */
+#define EXEC_MAX_FRAME_SIZE (1024 * 1024)
+/* Notifications queued for a persistent notification program. */
+#define EXEC_NOTIF_QUEUE_MAX 1024
+
 /*
  * Private data types
  */
@@ -67,6 +77,28 @@ extern char **environ;
  */
 struct program_list_s;
 typedef struct program_list_s program_list_t;
+struct program_list_and_notification_s;
+typedef struct program_list_and_notification_s program_list_and_notification_t;
+
+/*
+ * Programs with the `PL_PERSISTENT' flag keep running and receive all
+ * notifications on STDIN. They are fed by a single worker thread, which owns
+ * `pid' and `notif_fh'; the queue is protected by `queue_lock'.
+ */
+typedef struct {
+  pthread_t worker;
+  bool worker_running;
+  bool shutdown;
+  FILE *notif_fh;
+
+  pthread_mutex_t queue_lock;
+  pthread_cond_t queue_cond;
+  program_list_and_notification_t *queue_head;
+  program_list_and_notification_t *queue_tail;
+  size_t queue_len;
+  c_complain_t queue_complaint;
+} persistent_notif_t;
+
 struct program_list_s {
   char *user;
   char *group;
@@ -75,13 +107,24 @@ struct program_list_s {
   int pid;
   int status;
   int flags;
+  persistent_notif_t *persistent;
   program_list_t *next;
 };
 
-typedef struct program_list_and_notification_s {
+struct program_list_and_notification_s {
   program_list_t *pl;
   notification_t n;
-} program_list_and_notification_t;
+  program_list_and_notification_t *next;
+};
+
+/* Read buffer for the binary protocol */
+typedef struct {
+  char *data;
+  size_t size;
+  size_t len;
+  value_t *values;
+  size_t values_size;
+} frame_buffer_t;
 
 /*
  * constants
@@ -143,12 +186,29 @@ static int exec_config_exec(oconfig_item_t *ci) /* {{{ */
 
   if (strcasecmp("NotificationExec", ci->key) == 0)
     pl->flags |= PL_NOTIF_ACTION;
+  else if (strcasecmp("PersistentNotificationExec", ci->key) == 0)
+    pl->flags |= PL_NOTIF_ACTION | PL_PERSISTENT;
+  else if (strcasecmp("BinaryExec", ci->key) == 0)
+    pl->flags |= PL_NORMAL | PL_BINARY;
   else
     pl->flags |= PL_NORMAL;
 
+  if (pl->flags & PL_PERSISTENT) {
+    pl->persistent = calloc(1, sizeof(*pl->persistent));
+    if (pl->persistent == NULL) {
+      ERROR("exec plugin: calloc failed.");
+      sfree(pl);
+      return -1;
+    }
+    pthread_mutex_init(&pl->persistent->queue_lock, /* attr = */ NULL);
+    pthread_cond_init(&pl->persistent->queue_cond, /* attr = */ NULL);
+    C_COMPLAIN_INIT(&pl->persistent->queue_complaint);
+  }
+
   pl->user = strdup(ci->values[0].value.string);
   if (pl->user == NULL) {
     ERROR("exec plugin: strdup failed.");
+    sfree(pl->persistent);
     sfree(pl);
     return -1;
   }
@@ -163,6 +223,7 @@ static int exec_config_exec(oconfig_item_t *ci) /* {{{ */
   if (pl->exec == NULL) {
     ERROR("exec plugin: strdup failed.");
     sfree(pl->user);
+    sfree(pl->persistent);
     sfree(pl);
     return -1;
   }
@@ -172,6 +233,7 @@ static int exec_config_exec(oconfig_item_t *ci) /* {{{ */
     ERROR("exec plugin: calloc failed.");
     sfree(pl->exec);
     sfree(pl->user);
+    sfree(pl->persistent);
     sfree(pl);
     return -1;
   }
@@ -189,6 +251,7 @@ static int exec_config_exec(oconfig_item_t *ci) /* {{{ */
     sfree(pl->argv);
     sfree(pl->exec);
     sfree(pl->user);
+    sfree(pl->persistent);
     sfree(pl);
     return -1;
   }
@@ -222,6 +285,7 @@ static int exec_config_exec(oconfig_item_t *ci) /* {{{ */
     sfree(pl->argv);
     sfree(pl->exec);
     sfree(pl->user);
+    sfree(pl->persistent);
     sfree(pl);
     return -1;
   }
@@ -241,7 +305,9 @@ static int exec_config(oconfig_item_t *ci) /* {{{ */
   for (int i = 0; i < ci->children_num; i++) {
     oconfig_item_t *child = ci->children + i;
     if ((strcasecmp("Exec", child->key) == 0) ||
-        (strcasecmp("NotificationExec", child->key) == 0))
+        (strcasecmp("BinaryExec", child->key) == 0) ||
+        (strcasecmp("NotificationExec", child->key) == 0) ||
+        (strcasecmp("PersistentNotificationExec", child->key) == 0))
       exec_config_exec(child);
     else {
       WARNING("exec plugin: Unknown config option `%s'.", child->key);
@@ -567,6 +633,269 @@ static int parse_line(char *buffer) /* {{{ */
   }
 } /* int parse_line }}} */
 
+/*
+ * Binary protocol
+ *
+ * Programs configured with `BinaryExec' write frames to STDOUT, each
+ * consisting of the frame length as a 32 bit unsigned integer in network byte
+ * order and a packet in the format used by the network plugin, i.e. a list of
+ * host, time, interval, plugin, type, values, etc. parts. Signed and encrypted
+ * parts are not supported. Every frame starts with an empty value list.
+ */
+static int parse_part_header(char const *buffer, size_t buffer_len,
+                             uint16_t *ret_type, size_t *ret_len) /* {{{ */
+{
+  uint16_t tmp16;
+
+  if (buffer_len < 2 * sizeof(uint16_t))
+    return -1;
+
+  memcpy(&tmp16, buffer, sizeof(tmp16));
+  *ret_type = ntohs(tmp16);
+  memcpy(&tmp16, buffer + sizeof(tmp16), sizeof(tmp16));
+  *ret_len = (size_t)ntohs(tmp16);
+
+  if ((*ret_len < 2 * sizeof(uint16_t)) || (*ret_len > buffer_len))
+    return -1;
+
+  return 0;
+} /* }}} int parse_part_header */
+
+static int parse_part_number(char const *payload, size_t payload_len,
+                             uint64_t *ret_value) /* {{{ */
+{
+  uint64_t tmp64;
+
+  if (payload_len != sizeof(tmp64))
+    return -1;
+
+  memcpy(&tmp64, payload, sizeof(tmp64));
+  *ret_value = ntohll(tmp64);
+  return 0;
+} /* }}} int parse_part_number */
+
+static int parse_part_string(char const *payload, size_t payload_len,
+                             char *output, size_t output_len) /* {{{ */
+{
+  if ((payload_len == 0) || (payload_len > output_len) ||
+      (payload[payload_len - 1] != 0))
+    return -1;
+
+  memcpy(output, payload, payload_len);
+  return 0;
+} /* }}} int parse_part_string */
+
+static int parse_part_values(frame_buffer_t *fb, char const *payload,
+                             size_t payload_len, value_list_t *vl) /* {{{ */
+{
+  uint16_t tmp16;
+
+  if (payload_len < sizeof(tmp16))
+    return -1;
+
+  memcpy(&tmp16, payload, sizeof(tmp16));
+  size_t num = (size_t)ntohs(tmp16);
+  if (payload_len != sizeof(tmp16) + num * (sizeof(uint8_t) + sizeof(value_t)))
+    return -1;
+
+  if (num > fb->values_size) {
+    value_t *tmp = realloc(fb->values, num * sizeof(*tmp));
+    if (tmp == NULL) {
+      ERROR("exec plugin: realloc failed.");
+      return -1;
+    }
+    fb->values = tmp;
+    fb->values_size = num;
+  }
+
+  uint8_t const *types = (uint8_t const *)(payload + sizeof(tmp16));
+  char const *values = payload + sizeof(tmp16) + num;
+  for (size_t i = 0; i < num; i++) {
+    value_t v;
+    memcpy(&v, values + i * sizeof(v), sizeof(v));
+
+    switch (types[i]) {
+    case DS_TYPE_COUNTER:
+      fb->values[i].counter = (counter_t)ntohll(v.counter);
+      break;
+    case DS_TYPE_GAUGE:
+      fb->values[i].gauge = (gauge_t)ntohd(v.gauge);
+      break;
+    case DS_TYPE_DERIVE:
+      fb->values[i].derive = (derive_t)ntohll(v.derive);
+      break;
+    case DS_TYPE_ABSOLUTE:
+      fb->values[i].absolute = (absolute_t)ntohll(v.absolute);
+      break;
+    default:
+      return -1;
+    }
+  }
+
+  vl->values = fb->values;
+  vl->values_len = num;
+  return 0;
+} /* }}} int parse_part_values */
+
+/* Parses one frame and dispatches the contained values and notifications.
+ * Returns the number of value lists dispatched, or less than zero if the
+ * frame is malformed. */
+static int parse_frame(frame_buffer_t *fb, char const *buffer,
+                       size_t buffer_len,
+                       int (*dispatch)(value_list_t const *)) /* {{{ */
+{
+  value_list_t vl = VALUE_LIST_INIT;
+  notification_t n = {0};
+  int dispatched = 0;
+
+  while (buffer_len > 0) {
+    uint16_t type;
+    size_t len;
+
+    if (parse_part_header(buffer, buffer_len, &type, &len) != 0)
+      return -1;
+
+    char const *payload = buffer + 2 * sizeof(uint16_t);
+    size_t payload_len = len - 2 * sizeof(uint16_t);
+    uint64_t tmp = 0;
+    int status = 0;
+
+    switch (type) {
+    case TYPE_VALUES:
+      status = parse_part_values(fb, payload, payload_len, &vl);
+      if (status == 0) {
+        (*dispatch)(&vl);
+        dispatched++;
+      }
+      vl.values = NULL;
+      vl.values_len = 0;
+      break;
+    case TYPE_TIME:
+      status = parse_part_number(payload, payload_len, &tmp);
+      n.time = vl.time = TIME_T_TO_CDTIME_T(tmp);
+      break;
+    case TYPE_TIME_HR:
+      status = parse_part_number(payload, payload_len, &tmp);
+      n.time = vl.time = (cdtime_t)tmp;
+      break;
+    case TYPE_INTERVAL:
+      status = parse_part_number(payload, payload_len, &tmp);
+      vl.interval = TIME_T_TO_CDTIME_T(tmp);
+      break;
+    case TYPE_INTERVAL_HR:
+      status = parse_part_number(payload, payload_len, &tmp);
+      vl.interval = (cdtime_t)tmp;
+      break;
+    case TYPE_HOST:
+      status = parse_part_string(payload, payload_len, vl.host, sizeof(vl.host));
+      break;
+    case TYPE_PLUGIN:
+      status = parse_part_string(payload, payload_len, vl.plugin,
+                                 sizeof(vl.plugin));
+      break;
+    case TYPE_PLUGIN_INSTANCE:
+      status = parse_part_string(payload, payload_len, vl.plugin_instance,
+                                 sizeof(vl.plugin_instance));
+      break;
+    case TYPE_TYPE:
+      status = parse_part_string(payload, payload_len, vl.type, sizeof(vl.type));
+      break;
+    case TYPE_TYPE_INSTANCE:
+      status = parse_part_string(payload, payload_len, vl.type_instance,
+                                 sizeof(vl.type_instance));
+      break;
+    case TYPE_SEVERITY:
+      status = parse_part_number(payload, payload_len, &tmp);
+      n.severity = (int)tmp;
+      break;
+    case TYPE_MESSAGE:
+      status =
+          parse_part_string(payload, payload_len, n.message, sizeof(n.message));
+      if (status != 0)
+        break;
+      if ((n.severity != NOTIF_FAILURE) && (n.severity != NOTIF_WARNING) &&
+          (n.severity != NOTIF_OKAY)) {
+        WARNING("exec plugin: Ignoring notification with unknown severity %i.",
+                n.severity);
+        break;
+      }
+      sstrncpy(n.host, vl.host, sizeof(n.host));
+      sstrncpy(n.plugin, vl.plugin, sizeof(n.plugin));
+      sstrncpy(n.plugin_instance, vl.plugin_instance,
+               sizeof(n.plugin_instance));
+      sstrncpy(n.type, vl.type, sizeof(n.type));
+      sstrncpy(n.type_instance, vl.type_instance, sizeof(n.type_instance));
+      if (n.time == 0)
+        n.time = cdtime();
+      plugin_dispatch_notification(&n);
+      break;
+    default:
+      DEBUG("exec plugin: parse_frame: Unknown part type: 0x%04hx", type);
+    }
+
+    if (status != 0) {
+      ERROR("exec plugin: Malformed part of type 0x%04hx.", type);
+      return -1;
+    }
+
+    buffer += len;
+    buffer_len -= len;
+  }
+
+  return dispatched;
+} /* }}} int parse_frame */
+
+/* Reads from `fd' and parses all complete frames. Returns zero on EOF, less
+ * than zero on error and greater than zero otherwise. */
+static int read_frames(frame_buffer_t *fb, int fd) /* {{{ */
+{
+  if (fb->size - fb->len < 65536) {
+    size_t size = fb->len + 65536;
+    char *tmp = realloc(fb->data, size);
+    if (tmp == NULL) {
+      ERROR("exec plugin: realloc failed.");
+      return -1;
+    }
+    fb->data = tmp;
+    fb->size = size;
+  }
+
+  ssize_t len = read(fd, fb->data + fb->len, fb->size - fb->len);
+  if (len < 0)
+    return ((errno == EAGAIN) || (errno == EINTR)) ? 1 : -1;
+  else if (len == 0)
+    return 0; /* We've reached EOF */
+  fb->len += (size_t)len;
+
+  size_t pos = 0;
+  while (fb->len - pos >= sizeof(uint32_t)) {
+    uint32_t tmp32;
+    memcpy(&tmp32, fb->data + pos, sizeof(tmp32));
+    size_t frame_len = (size_t)ntohl(tmp32);
+
+    if (frame_len > EXEC_MAX_FRAME_SIZE) {
+      ERROR("exec plugin: Frame of %" PRIsz " bytes exceeds the limit of %d "
+            "bytes.",
+            frame_len, EXEC_MAX_FRAME_SIZE);
+      return -1;
+    }
+    if (fb->len - pos - sizeof(tmp32) < frame_len)
+      break; /* not completely read */
+
+    if (parse_frame(fb, fb->data + pos + sizeof(tmp32), frame_len,
+                    plugin_dispatch_values) < 0)
+      return -1;
+    pos += sizeof(tmp32) + frame_len;
+  }
+
+  if (pos > 0) {
+    memmove(fb->data, fb->data + pos, fb->len - pos);
+    fb->len -= pos;
+  }
+
+  return 1;
+} /* }}} int read_frames */
+
 static void *exec_read_one(void *arg) /* {{{ */
 {
   program_list_t *pl = (program_list_t *)arg;
@@ -577,6 +906,7 @@ static void *exec_read_one(void *arg) /* {{{ */
   char buffer_err[1024];
   char *pbuffer = buffer;
   char *pbuffer_err = buffer_err;
+  frame_buffer_t fb = {0};
 
   status = fork_child(pl, NULL, &fd, &fd_err);
   if (status < 0) {
@@ -605,7 +935,16 @@ static void *exec_read_one(void *arg) /* {{{ */
       break;
     }
 
-    if (fds[0].revents & (POLLIN | POLLHUP)) {
+    if ((fds[0].revents & (POLLIN | POLLHUP)) && (pl->flags & PL_BINARY)) {
+      status = read_frames(&fb, fd);
+      if (status < 0) {
+        ERROR("exec plugin: Failed to read frames from `%s', terminating it.",
+              pl->exec);
+        kill(pl->pid, SIGTERM);
+        break;
+      } else if (status == 0)
+        break; /* We've reached EOF */
+    } else if (fds[0].revents & (POLLIN | POLLHUP)) {
       char *pnl;
 
       len = read(fd, pbuffer, sizeof(buffer) - 1 - (pbuffer - buffer));
@@ -712,36 +1051,22 @@ static void *exec_read_one(void *arg) /* {{{ */
   close(fd);
   if (fd_err >= 0)
     close(fd_err);
+  sfree(fb.data);
+  sfree(fb.values);
 
   pthread_exit((void *)0);
   return NULL;
 } /* void *exec_read_one }}} */
 
-static void *exec_notification_one(void *arg) /* {{{ */
+/* Writes the notification in the format described in collectd-exec(5). If
+ * `persistent' is true, the message is folded onto a single line and
+ * terminated by an empty line, so that the program can tell consecutive
+ * notifications apart. */
+static int exec_write_notification(FILE *fh, const notification_t *n,
+                                   bool persistent) /* {{{ */
 {
-  program_list_t *pl = ((program_list_and_notification_t *)arg)->pl;
-  notification_t *n = &((program_list_and_notification_t *)arg)->n;
-  int fd;
-  FILE *fh;
-  int pid;
-  int status;
   const char *severity;
 
-  pid = fork_child(pl, &fd, NULL, NULL);
-  if (pid < 0) {
-    sfree(arg);
-    pthread_exit((void *)1);
-  }
-
-  fh = fdopen(fd, "w");
-  if (fh == NULL) {
-    ERROR("exec plugin: fdopen (%i) failed: %s", fd, STRERRNO);
-    kill(pid, SIGTERM);
-    close(fd);
-    sfree(arg);
-    pthread_exit((void *)1);
-  }
-
   severity = "FAILURE";
   if (n->severity == NOTIF_WARNING)
     severity = "WARNING";
@@ -781,9 +1106,47 @@ static void *exec_notification_one(void *arg) /* {{{ */
               meta->nm_value.nm_boolean ? "true" : "false");
   }
 
-  fprintf(fh, "\n%s\n", n->message);
+  if (!persistent) {
+    fprintf(fh, "\n%s\n", n->message);
+  } else {
+    char message[NOTIF_MAX_MSG_LEN];
+    sstrncpy(message, n->message, sizeof(message));
+    for (char *ptr = message; *ptr != 0; ptr++)
+      if ((*ptr == '\n') || (*ptr == '\r'))
+        *ptr = ' ';
+    fprintf(fh, "\n%s\n\n", message);
+  }
+
+  if (ferror(fh))
+    return -1;
+  return fflush(fh);
+} /* }}} int exec_write_notification */
 
-  fflush(fh);
+static void *exec_notification_one(void *arg) /* {{{ */
+{
+  program_list_t *pl = ((program_list_and_notification_t *)arg)->pl;
+  notification_t *n = &((program_list_and_notification_t *)arg)->n;
+  int fd;
+  FILE *fh;
+  int pid;
+  int status;
+
+  pid = fork_child(pl, &fd, NULL, NULL);
+  if (pid < 0) {
+    sfree(arg);
+    pthread_exit((void *)1);
+  }
+
+  fh = fdopen(fd, "w");
+  if (fh == NULL) {
+    ERROR("exec plugin: fdopen (%i) failed: %s", fd, STRERRNO);
+    kill(pid, SIGTERM);
+    close(fd);
+    sfree(arg);
+    pthread_exit((void *)1);
+  }
+
+  exec_write_notification(fh, n, /* persistent = */ false);
   fclose(fh);
 
   waitpid(pid, &status, 0);
@@ -798,6 +1161,98 @@ static void *exec_notification_one(void *arg) /* {{{ */
   return NULL;
 } /* void *exec_notification_one }}} */
 
+/* Starts the persistent notification program, if it is not running. */
+static int persistent_start(program_list_t *pl) /* {{{ */
+{
+  persistent_notif_t *p = pl->persistent;
+  int fd;
+
+  if (p->notif_fh != NULL)
+    return 0;
+
+  int pid = fork_child(pl, &fd, NULL, NULL);
+  if (pid < 0)
+    return -1;
+
+  p->notif_fh = fdopen(fd, "w");
+  if (p->notif_fh == NULL) {
+    ERROR("exec plugin: fdopen (%i) failed: %s", fd, STRERRNO);
+    kill(pid, SIGTERM);
+    close(fd);
+    waitpid(pid, NULL, 0);
+    return -1;
+  }
+
+  pl->pid = pid;
+  return 0;
+} /* }}} int persistent_start */
+
+static void persistent_stop(program_list_t *pl) /* {{{ */
+{
+  persistent_notif_t *p = pl->persistent;
+  int status = 0;
+
+  if (p->notif_fh != NULL) {
+    fclose(p->notif_fh);
+    p->notif_fh = NULL;
+  }
+
+  if (pl->pid <= 0)
+    return;
+
+  /* Closing STDIN is the signal for the program to exit. Reap it if it did,
+   * otherwise terminate it. */
+  if (waitpid(pl->pid, &status, WNOHANG) == 0) {
+    kill(pl->pid, SIGTERM);
+    waitpid(pl->pid, &status, 0);
+  }
+  DEBUG("exec plugin: Child %i exited with status %i.", pl->pid, status);
+  pl->pid = 0;
+} /* }}} void persistent_stop */
+
+static void *exec_persistent_worker(void *arg) /* {{{ */
+{
+  program_list_t *pl = arg;
+  persistent_notif_t *p = pl->persistent;
+
+  pthread_mutex_lock(&p->queue_lock);
+  while (!p->shutdown) {
+    if (p->queue_head == NULL) {
+      pthread_cond_wait(&p->queue_cond, &p->queue_lock);
+      continue;
+    }
+
+    program_list_and_notification_t *pln = p->queue_head;
+    p->queue_head = pln->next;
+    if (p->queue_head == NULL)
+      p->queue_tail = NULL;
+    p->queue_len--;
+    pthread_mutex_unlock(&p->queue_lock);
+
+    /* If the program exited since the last notification, writing fails with
+     * EPIPE. Restart it and retry once. */
+    for (int i = 0; i < 2; i++) {
+      if (persistent_start(pl) != 0)
+        break;
+      if (exec_write_notification(p->notif_fh, &pln->n,
+                                  /* persistent = */ true) == 0)
+        break;
+      WARNING("exec plugin: Writing to `%s' failed, restarting it.", pl->exec);
+      persistent_stop(pl);
+    }
+
+    if (pln->n.meta != NULL)
+      plugin_notification_meta_free(pln->n.meta);
+    sfree(pln);
+
+    pthread_mutex_lock(&p->queue_lock);
+  }
+  pthread_mutex_unlock(&p->queue_lock);
+
+  persistent_stop(pl);
+  return NULL;
+} /* }}} void *exec_persistent_worker */
+
 static int exec_init(void) /* {{{ */
 {
   struct sigaction sa = {.sa_handler = sigchld_handler};
@@ -821,6 +1276,20 @@ static int exec_init(void) /* {{{ */
   }
 #endif
 
+  for (program_list_t *pl = pl_head; pl != NULL; pl = pl->next) {
+    if ((pl->flags & PL_PERSISTENT) == 0)
+      continue;
+
+    int status = plugin_thread_create(&pl->persistent->worker,
+                                      exec_persistent_worker, (void *)pl,
+                                      "exec notify");
+    if (status != 0) {
+      ERROR("exec plugin: plugin_thread_create failed.");
+      continue;
+    }
+    pl->persistent->worker_running = true;
+  }
+
   return 0;
 } /* int exec_init }}} */
 
@@ -865,8 +1334,8 @@ static int exec_notification(const notification_t *n, /* {{{ */
     if ((pl->flags & PL_NOTIF_ACTION) == 0)
       continue;
 
-    /* Skip if a child is already running. */
-    if (pl->pid != 0)
+    /* Persistent programs are fed by their worker thread. */
+    if ((pl->flags & PL_PERSISTENT) == 0 && pl->pid != 0)
       continue;
 
     pln = malloc(sizeof(*pln));
@@ -882,6 +1351,36 @@ static int exec_notification(const notification_t *n, /* {{{ */
      * will run into an endless loop. */
     pln->n.meta = NULL;
     plugin_notification_meta_copy(&pln->n, n);
+    pln->next = NULL;
+
+    if (pl->flags & PL_PERSISTENT) {
+      persistent_notif_t *p = pl->persistent;
+
+      pthread_mutex_lock(&p->queue_lock);
+      if (!p->worker_running || (p->queue_len >= EXEC_NOTIF_QUEUE_MAX)) {
+        pthread_mutex_unlock(&p->queue_lock);
+        c_complain(LOG_WARNING, &p->queue_complaint,
+                   "exec plugin: Queue of `%s' is full, dropping "
+                   "notifications.",
+                   pl->exec);
+        if (pln->n.meta != NULL)
+          plugin_notification_meta_free(pln->n.meta);
+        sfree(pln);
+        continue;
+      }
+      if (p->queue_tail == NULL)
+        p->queue_head = pln;
+      else
+        p->queue_tail->next = pln;
+      p->queue_tail = pln;
+      p->queue_len++;
+      pthread_cond_signal(&p->queue_cond);
+      pthread_mutex_unlock(&p->queue_lock);
+
+      c_release(LOG_INFO, &p->queue_complaint,
+                "exec plugin: Queue of `%s' has room again.", pl->exec);
+      continue;
+    }
 
     int status = plugin_thread_create(&t, exec_notification_one, (void *)pln,
                                       "exec notify");
@@ -904,7 +1403,30 @@ static int exec_shutdown(void) /* {{{ */
   while (pl != NULL) {
     next = pl->next;
 
-    if (pl->pid > 0) {
+    if (pl->persistent != NULL) {
+      persistent_notif_t *p = pl->persistent;
+
+      pthread_mutex_lock(&p->queue_lock);
+      p->shutdown = true;
+      pthread_cond_broadcast(&p->queue_cond);
+      pthread_mutex_unlock(&p->queue_lock);
+
+      /* The worker closes the pipe and reaps the program. */
+      if (p->worker_running)
+        pthread_join(p->worker, NULL);
+
+      while (p->queue_head != NULL) {
+        program_list_and_notification_t *pln = p->queue_head;
+        p->queue_head = pln->next;
+        if (pln->n.meta != NULL)
+          plugin_notification_meta_free(pln->n.meta);
+        sfree(pln);
+      }
+
+      pthread_mutex_destroy(&p->queue_lock);
+      pthread_cond_destroy(&p->queue_cond);
+      sfree(pl->persistent);
+    } else if (pl->pid > 0) {
       kill(pl->pid, SIGTERM);
       INFO("exec plugin: Sent SIGTERM to %hu", (unsigned short int)pl->pid);
     }
@@ -0,0 +1,213 @@
+/**
+ * collectd - src/exec_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "exec.c" /* sic */
+#include "testing.h"
+
+#define FRAME_VALUES 1000
+
+/* Encoder for the network plugin's part format. */
+static size_t put_header(char *buffer, uint16_t type, size_t len) {
+  uint16_t tmp16 = htons(type);
+  memcpy(buffer, &tmp16, sizeof(tmp16));
+  tmp16 = htons((uint16_t)len);
+  memcpy(buffer + sizeof(tmp16), &tmp16, sizeof(tmp16));
+  return 2 * sizeof(tmp16);
+}
+
+static size_t put_string(char *buffer, uint16_t type, char const *str) {
+  size_t len = 4 + strlen(str) + 1;
+  put_header(buffer, type, len);
+  memcpy(buffer + 4, str, strlen(str) + 1);
+  return len;
+}
+
+static size_t put_number(char *buffer, uint16_t type, uint64_t num) {
+  size_t len = 4 + sizeof(num);
+  put_header(buffer, type, len);
+  num = htonll(num);
+  memcpy(buffer + 4, &num, sizeof(num));
+  return len;
+}
+
+static size_t put_gauge(char *buffer, gauge_t g) {
+  size_t len = 4 + 2 + 1 + sizeof(g);
+  put_header(buffer, TYPE_VALUES, len);
+  uint16_t num = htons(1);
+  memcpy(buffer + 4, &num, sizeof(num));
+  buffer[6] = DS_TYPE_GAUGE;
+  g = htond(g);
+  memcpy(buffer + 7, &g, sizeof(g));
+  return len;
+}
+
+static value_list_t last_vl;
+static int dispatched;
+
+static int capture(value_list_t const *vl) {
+  last_vl = *vl;
+  dispatched++;
+  return 0;
+}
+
+static int discard(value_list_t const __attribute__((unused)) * vl) {
+  dispatched++;
+  return 0;
+}
+
+DEF_TEST(parse_frame) {
+  char buffer[1024];
+  size_t len = 0;
+  frame_buffer_t fb = {0};
+
+  len += put_string(buffer + len, TYPE_HOST, "example.org");
+  len += put_number(buffer + len, TYPE_TIME_HR, TIME_T_TO_CDTIME_T(1234));
+  len += put_number(buffer + len, TYPE_INTERVAL_HR, TIME_T_TO_CDTIME_T(10));
+  len += put_string(buffer + len, TYPE_PLUGIN, "exec");
+  len += put_string(buffer + len, TYPE_TYPE, "gauge");
+  len += put_string(buffer + len, TYPE_TYPE_INSTANCE, "a");
+  len += put_gauge(buffer + len, 42.0);
+  len += put_string(buffer + len, TYPE_TYPE_INSTANCE, "b");
+  len += put_gauge(buffer + len, 23.0);
+
+  dispatched = 0;
+  EXPECT_EQ_INT(2, parse_frame(&fb, buffer, len, capture));
+  EXPECT_EQ_INT(2, dispatched);
+  EXPECT_EQ_STR("example.org", last_vl.host);
+  EXPECT_EQ_STR("exec", last_vl.plugin);
+  EXPECT_EQ_STR("gauge", last_vl.type);
+  EXPECT_EQ_STR("b", last_vl.type_instance);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(1234), last_vl.time);
+  EXPECT_EQ_UINT64(TIME_T_TO_CDTIME_T(10), last_vl.interval);
+  EXPECT_EQ_INT(1, (int)last_vl.values_len);
+  EXPECT_EQ_DOUBLE(23.0, last_vl.values[0].gauge);
+
+  /* Truncated part */
+  EXPECT_EQ_INT(-1, parse_frame(&fb, buffer, len - 1, capture));
+
+  /* Unterminated string */
+  len = put_string(buffer, TYPE_HOST, "example.org");
+  buffer[len - 1] = 'x';
+  EXPECT_EQ_INT(-1, parse_frame(&fb, buffer, len, capture));
+
+  sfree(fb.data);
+  sfree(fb.values);
+  return 0;
+}
+
+DEF_TEST(read_frames) {
+  char frame[256];
+  int fds[2];
+  frame_buffer_t fb = {0};
+
+  size_t len = 4;
+  len += put_string(frame + len, TYPE_HOST, "example.org");
+  len += put_string(frame + len, TYPE_PLUGIN, "exec");
+  len += put_string(frame + len, TYPE_TYPE, "MAGIC");
+  len += put_gauge(frame + len, 1.0);
+  uint32_t tmp32 = htonl((uint32_t)(len - 4));
+  memcpy(frame, &tmp32, sizeof(tmp32));
+
+  CHECK_ZERO(pipe(fds));
+
+  /* A partial frame is kept until the rest arrives. */
+  EXPECT_EQ_INT(10, (int)write(fds[1], frame, 10));
+  EXPECT_EQ_INT(1, read_frames(&fb, fds[0]));
+  EXPECT_EQ_INT(10, (int)fb.len);
+
+  EXPECT_EQ_INT((int)len - 10, (int)write(fds[1], frame + 10, len - 10));
+  EXPECT_EQ_INT(1, read_frames(&fb, fds[0]));
+  EXPECT_EQ_INT(0, (int)fb.len);
+
+  /* Oversized frames are a protocol error. */
+  tmp32 = htonl(EXEC_MAX_FRAME_SIZE + 1);
+  EXPECT_EQ_INT(4, (int)write(fds[1], &tmp32, sizeof(tmp32)));
+  EXPECT_EQ_INT(-1, read_frames(&fb, fds[0]));
+
+  close(fds[1]);
+  fb.len = 0;
+  EXPECT_EQ_INT(0, read_frames(&fb, fds[0]));
+  close(fds[0]);
+
+  sfree(fb.data);
+  sfree(fb.values);
+  return 0;
+}
+
+DEF_TEST(write_notification) {
+  notification_t n = {
+      .severity = NOTIF_WARNING,
+      .time = TIME_T_TO_CDTIME_T(1),
+      .message = "line one\nline two",
+      .host = "example.org",
+  };
+  char buffer[1024] = {0};
+
+  FILE *fh = fmemopen(buffer, sizeof(buffer), "w");
+  CHECK_NOT_NULL(fh);
+  CHECK_ZERO(exec_write_notification(fh, &n, /* persistent = */ true));
+  fclose(fh);
+
+  EXPECT_EQ_STR("Severity: WARNING\n"
+                "Time: 1.000\n"
+                "Host: example.org\n"
+                "\n"
+                "line one line two\n"
+                "\n",
+                buffer);
+  return 0;
+}
+
+/* A frame with many value parts, as a program would typically write them,
+ * is dispatched completely. */
+DEF_TEST(large_frame) {
+  char buffer[64 * 1024];
+  frame_buffer_t fb = {0};
+
+  size_t len = 0;
+  len += put_string(buffer + len, TYPE_HOST, "example.org");
+  len += put_number(buffer + len, TYPE_INTERVAL_HR, TIME_T_TO_CDTIME_T(10));
+  len += put_string(buffer + len, TYPE_PLUGIN, "exec");
+  len += put_string(buffer + len, TYPE_PLUGIN_INSTANCE, "x");
+  len += put_string(buffer + len, TYPE_TYPE, "MAGIC");
+  for (int i = 0; i < FRAME_VALUES; i++) {
+    len += put_string(buffer + len, TYPE_TYPE_INSTANCE, "a");
+    len += put_gauge(buffer + len, 1.0);
+  }
+
+  dispatched = 0;
+  EXPECT_EQ_INT(FRAME_VALUES, parse_frame(&fb, buffer, len, discard));
+  EXPECT_EQ_INT(FRAME_VALUES, dispatched);
+
+  sfree(fb.data);
+  sfree(fb.values);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(parse_frame);
+  RUN_TEST(read_frames);
+  RUN_TEST(write_notification);
+  RUN_TEST(large_frame);
+
+  END_TEST;
+}
@@ -26,12 +26,15 @@
  *   Florian octo Forster <octo at collectd.org>
  **/
 
+#include <google/protobuf/arena.h>
 #include <google/protobuf/util/time_util.h>
 #include <grpc++/grpc++.h>
 
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <queue>
+#include <thread>
 #include <vector>
 
 #include "collectd.grpc.pb.h"
@@ -72,6 +75,9 @@ struct Listener {
 static std::vector<Listener> listeners;
 static grpc::string default_addr("0.0.0.0:50051");
 
+/* Number of threads, each with its own completion queue, handling RPCs. */
+static int worker_threads = 2;
+
 /*
  * helper functions
  */
@@ -93,6 +99,44 @@ static bool ident_matches(const value_list_t *vl, const value_list_t *matcher) {
   return true;
 } /* ident_matches */
 
+/* Returns the part of "pattern" in front of the first wildcard and sets
+ * "literal" to whether that's the entire pattern. */
+static grpc::string pattern_prefix(const char *pattern, bool *literal) {
+  size_t len = strcspn(pattern, "*?[\\");
+  *literal = (pattern[len] == 0);
+  return grpc::string(pattern, len);
+} /* pattern_prefix */
+
+/* Returns a prefix of the names of all cache entries matching "matcher".
+ * Names have the form "host/plugin[-plugin_instance]/type[-type_instance]",
+ * so the prefix extends for as long as the fields are literal strings. */
+static grpc::string ident_prefix(const value_list_t *matcher) {
+  bool literal;
+
+  grpc::string prefix = pattern_prefix(matcher->host, &literal);
+  if (!literal)
+    return prefix;
+
+  prefix += "/" + pattern_prefix(matcher->plugin, &literal);
+  if (!literal)
+    return prefix;
+
+  grpc::string s = pattern_prefix(matcher->plugin_instance, &literal);
+  if (!s.empty())
+    prefix += "-" + s;
+  if (!literal)
+    return prefix;
+
+  prefix += "/" + pattern_prefix(matcher->type, &literal);
+  if (!literal)
+    return prefix;
+
+  s = pattern_prefix(matcher->type_instance, &literal);
+  if (!s.empty())
+    prefix += "-" + s;
+  return prefix;
+} /* ident_prefix */
+
 static grpc::string read_file(const char *filename) {
   std::ifstream f;
   grpc::string s, content;
@@ -243,9 +287,9 @@ static grpc::Status unmarshal_meta_data(const grpcMetadata &rpc_metadata,
     return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
                         grpc::string("failed to create metadata list"));
   }
-  for (auto kv : rpc_metadata) {
+  for (auto const &kv : rpc_metadata) {
     auto k = kv.first.c_str();
-    auto v = kv.second;
+    auto const &v = kv.second;
 
     // The meta_data collection individually allocates copies of the keys and
     // string values for each entry, so it's safe for us to pass a reference
@@ -287,10 +331,10 @@ static grpc::Status marshal_value_list(const value_list_t *vl,
                         grpc::string("failed to retrieve data-set for values"));
   }
 
-  auto t = TimeUtil::NanosecondsToTimestamp(CDTIME_T_TO_NS(vl->time));
-  auto d = TimeUtil::NanosecondsToDuration(CDTIME_T_TO_NS(vl->interval));
-  msg->set_allocated_time(new google::protobuf::Timestamp(t));
-  msg->set_allocated_interval(new google::protobuf::Duration(d));
+  *msg->mutable_time() =
+      TimeUtil::NanosecondsToTimestamp(CDTIME_T_TO_NS(vl->time));
+  *msg->mutable_interval() =
+      TimeUtil::NanosecondsToDuration(CDTIME_T_TO_NS(vl->interval));
 
   msg->clear_meta_data();
   if (vl->meta != nullptr) {
@@ -339,27 +383,24 @@ static grpc::Status unmarshal_value_list(const collectd::types::ValueList &msg,
   if (!status.ok())
     return status;
 
-  status = unmarshal_meta_data(msg.meta_data(), &vl->meta);
-  if (!status.ok())
-    return status;
+  vl->meta = NULL;
+  if (msg.meta_data_size() > 0) {
+    status = unmarshal_meta_data(msg.meta_data(), &vl->meta);
+    if (!status.ok())
+      return status;
+  }
 
-  value_t *values = NULL;
-  size_t values_len = 0;
+  size_t values_len = (size_t)msg.values_size();
+  value_t *values = (value_t *)calloc(values_len, sizeof(*values));
+  if ((values == NULL) && (values_len > 0)) {
+    meta_data_destroy(vl->meta);
+    return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                        grpc::string("failed to allocate values array"));
+  }
 
   status = grpc::Status::OK;
-  for (auto v : msg.values()) {
-    value_t *val =
-        (value_t *)realloc(values, (values_len + 1) * sizeof(*values));
-    if (!val) {
-      status = grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
-                            grpc::string("failed to allocate values array"));
-      break;
-    }
-
-    values = val;
-    val = values + values_len;
-    values_len++;
-
+  value_t *val = values;
+  for (auto const &v : msg.values()) {
     switch (v.value_case()) {
     case collectd::types::Value::ValueCase::kCounter:
       val->counter = counter_t(v.counter());
@@ -381,6 +422,7 @@ static grpc::Status unmarshal_value_list(const collectd::types::ValueList &msg,
 
     if (!status.ok())
       break;
+    val++;
   }
   if (status.ok()) {
     vl->values = values;
@@ -393,146 +435,309 @@ static grpc::Status unmarshal_value_list(const collectd::types::ValueList &msg,
   return status;
 } /* unmarshal_value_list() */
 
-/*
- * Collectd service
- */
-class CollectdImpl : public collectd::Collectd::Service {
-public:
-  grpc::Status
-  QueryValues(grpc::ServerContext *ctx, QueryValuesRequest const *req,
-              grpc::ServerWriter<QueryValuesResponse> *writer) override {
-    value_list_t match;
-    auto status = unmarshal_ident(req->identifier(), &match, false);
-    if (!status.ok()) {
+static grpc::Status dispatch_value_list(const collectd::types::ValueList &msg) {
+  value_list_t vl = {0};
+  auto status = unmarshal_value_list(msg, &vl);
+  if (!status.ok())
+    return status;
+
+  int err = plugin_dispatch_values(&vl);
+  sfree(vl.values);
+  meta_data_destroy(vl.meta);
+
+  if (err)
+    return grpc::Status(grpc::StatusCode::INTERNAL,
+                        grpc::string("failed to enqueue values for writing"));
+  return grpc::Status::OK;
+} /* dispatch_value_list() */
+
+static grpc::Status dispatch_request(PutValuesRequest const &req) {
+  if (req.has_value_list()) {
+    auto status = dispatch_value_list(req.value_list());
+    if (!status.ok())
       return status;
-    }
+  }
+
+  for (auto const &msg : req.value_lists()) {
+    auto status = dispatch_value_list(msg);
+    if (!status.ok())
+      return status;
+  }
+
+  return grpc::Status::OK;
+} /* dispatch_request() */
+
+/* Copies all cache entries matching "match" to "value_lists". Instead of
+ * scanning the entire cache, only the entries starting with the literal
+ * prefix of the identifier are looked at. */
+static grpc::Status query_values(value_list_t const *match,
+                                 std::queue<value_list_t> *value_lists) {
+  uc_iter_t *iter;
+  if ((iter = uc_get_iterator()) == NULL) {
+    return grpc::Status(
+        grpc::StatusCode::INTERNAL,
+        grpc::string("failed to query values: cannot create iterator"));
+  }
 
-    std::queue<value_list_t> value_lists;
-    status = this->queryValuesRead(&match, &value_lists);
-    if (status.ok()) {
-      status = this->queryValuesWrite(ctx, writer, &value_lists);
+  grpc::string prefix = ident_prefix(match);
+  uc_iterator_seek(iter, prefix.c_str());
+
+  grpc::Status status = grpc::Status::OK;
+  char *name = NULL;
+  while (uc_iterator_next(iter, &name) == 0) {
+    if (strncmp(name, prefix.c_str(), prefix.length()) != 0)
+      break;
+
+    value_list_t vl;
+    if (parse_identifier_vl(name, &vl) != 0) {
+      status = grpc::Status(grpc::StatusCode::INTERNAL,
+                            grpc::string("failed to parse identifier"));
+      break;
     }
 
-    while (!value_lists.empty()) {
-      auto vl = value_lists.front();
-      value_lists.pop();
+    if (!ident_matches(&vl, match))
+      continue;
+    if (uc_iterator_get_time(iter, &vl.time) < 0) {
+      status =
+          grpc::Status(grpc::StatusCode::INTERNAL,
+                       grpc::string("failed to retrieve value timestamp"));
+      break;
+    }
+    if (uc_iterator_get_interval(iter, &vl.interval) < 0) {
+      status =
+          grpc::Status(grpc::StatusCode::INTERNAL,
+                       grpc::string("failed to retrieve value interval"));
+      break;
+    }
+    if (uc_iterator_get_values(iter, &vl.values, &vl.values_len) < 0) {
+      status = grpc::Status(grpc::StatusCode::INTERNAL,
+                            grpc::string("failed to retrieve values"));
+      break;
+    }
+    if (uc_iterator_get_meta(iter, &vl.meta) < 0) {
+      status =
+          grpc::Status(grpc::StatusCode::INTERNAL,
+                       grpc::string("failed to retrieve value metadata"));
       sfree(vl.values);
-      meta_data_destroy(vl.meta);
+      break;
     }
 
-    return status;
-  }
+    value_lists->push(vl);
+  } // while (uc_iterator_next(iter, &name) == 0)
 
-  grpc::Status PutValues(grpc::ServerContext *ctx,
-                         grpc::ServerReader<PutValuesRequest> *reader,
-                         PutValuesResponse *res) override {
-    PutValuesRequest req;
+  uc_iterator_destroy(iter);
+  return status;
+} /* query_values() */
+
+/*
+ * Collectd service
+ *
+ * RPCs are handled asynchronously: each one in progress is represented by a
+ * Call object which is used as the tag of its completion queue operations.
+ * There is at most one operation pending per call at any time, so a call
+ * can delete itself once its last operation has completed.
+ */
+static std::atomic<bool> shutting_down(false);
 
-    while (reader->Read(&req)) {
-      value_list_t vl = {0};
-      auto status = unmarshal_value_list(req.value_list(), &vl);
-      if (!status.ok())
-        return status;
+class Call {
+public:
+  virtual ~Call() {}
 
-      if (plugin_dispatch_values(&vl))
-        return grpc::Status(
-            grpc::StatusCode::INTERNAL,
-            grpc::string("failed to enqueue values for writing"));
-    }
+  /* Proceed is called when the pending operation completed. */
+  virtual void Proceed(bool ok) = 0;
+};
 
-    res->Clear();
-    return grpc::Status::OK;
+class PutValuesCall final : public Call {
+public:
+  PutValuesCall(Collectd::AsyncService *service,
+                grpc::ServerCompletionQueue *cq)
+      : service_(service), cq_(cq), reader_(&ctx_),
+        req_(google::protobuf::Arena::CreateMessage<PutValuesRequest>(
+            &arena_)),
+        state_(CONNECT) {
+    service_->RequestPutValues(&ctx_, &reader_, cq_, cq_, this);
   }
 
-private:
-  grpc::Status queryValuesRead(value_list_t const *match,
-                               std::queue<value_list_t> *value_lists) {
-    uc_iter_t *iter;
-    if ((iter = uc_get_iterator()) == NULL) {
-      return grpc::Status(
-          grpc::StatusCode::INTERNAL,
-          grpc::string("failed to query values: cannot create iterator"));
+  void Proceed(bool ok) override {
+    if (shutting_down) {
+      delete this;
+      return;
     }
 
-    grpc::Status status = grpc::Status::OK;
-    char *name = NULL;
-    while (uc_iterator_next(iter, &name) == 0) {
-      value_list_t vl;
-      if (parse_identifier_vl(name, &vl) != 0) {
-        status = grpc::Status(grpc::StatusCode::INTERNAL,
-                              grpc::string("failed to parse identifier"));
-        break;
+    switch (state_) {
+    case CONNECT:
+      if (!ok) {
+        delete this;
+        return;
       }
+      /* Wait for the next client. */
+      new PutValuesCall(service_, cq_);
 
-      if (!ident_matches(&vl, match))
-        continue;
-      if (uc_iterator_get_time(iter, &vl.time) < 0) {
-        status =
-            grpc::Status(grpc::StatusCode::INTERNAL,
-                         grpc::string("failed to retrieve value timestamp"));
-        break;
-      }
-      if (uc_iterator_get_interval(iter, &vl.interval) < 0) {
-        status =
-            grpc::Status(grpc::StatusCode::INTERNAL,
-                         grpc::string("failed to retrieve value interval"));
+      state_ = READ;
+      reader_.Read(req_, this);
+      break;
+
+    case READ: {
+      if (!ok) {
+        /* The client is done sending. */
+        state_ = FINISH;
+        reader_.Finish(res_, grpc::Status::OK, this);
         break;
       }
-      if (uc_iterator_get_values(iter, &vl.values, &vl.values_len) < 0) {
-        status = grpc::Status(grpc::StatusCode::INTERNAL,
-                              grpc::string("failed to retrieve values"));
+
+      auto status = dispatch_request(*req_);
+      if (!status.ok()) {
+        state_ = FINISH;
+        reader_.FinishWithError(status, this);
         break;
       }
-      if (uc_iterator_get_meta(iter, &vl.meta) < 0) {
-        status =
-            grpc::Status(grpc::StatusCode::INTERNAL,
-                         grpc::string("failed to retrieve value metadata"));
-      }
 
-      value_lists->push(vl);
-    } // while (uc_iterator_next(iter, &name) == 0)
+      /* The request's memory is reused by the next message. */
+      req_->Clear();
+      reader_.Read(req_, this);
+      break;
+    }
+
+    case FINISH:
+      delete this;
+      break;
+    }
+  } /* Proceed() */
 
-    uc_iterator_destroy(iter);
-    return status;
+private:
+  Collectd::AsyncService *service_;
+  grpc::ServerCompletionQueue *cq_;
+
+  grpc::ServerContext ctx_;
+  grpc::ServerAsyncReader<PutValuesResponse, PutValuesRequest> reader_;
+
+  google::protobuf::Arena arena_;
+  PutValuesRequest *req_;
+  PutValuesResponse res_;
+
+  enum { CONNECT, READ, FINISH } state_;
+}; /* class PutValuesCall */
+
+class QueryValuesCall final : public Call {
+public:
+  QueryValuesCall(Collectd::AsyncService *service,
+                  grpc::ServerCompletionQueue *cq)
+      : service_(service), cq_(cq), writer_(&ctx_),
+        res_(google::protobuf::Arena::CreateMessage<QueryValuesResponse>(
+            &arena_)),
+        state_(CONNECT) {
+    service_->RequestQueryValues(&ctx_, &req_, &writer_, cq_, cq_, this);
+  }
+
+  ~QueryValuesCall() {
+    while (!value_lists_.empty()) {
+      auto vl = value_lists_.front();
+      value_lists_.pop();
+      sfree(vl.values);
+      meta_data_destroy(vl.meta);
+    }
   }
 
-  grpc::Status queryValuesWrite(grpc::ServerContext *ctx,
-                                grpc::ServerWriter<QueryValuesResponse> *writer,
-                                std::queue<value_list_t> *value_lists) {
-    while (!value_lists->empty()) {
-      auto vl = value_lists->front();
-      QueryValuesResponse res;
-      res.Clear();
+  void Proceed(bool ok) override {
+    if (shutting_down) {
+      delete this;
+      return;
+    }
+
+    switch (state_) {
+    case CONNECT: {
+      if (!ok) {
+        delete this;
+        return;
+      }
+      /* Wait for the next client. */
+      new QueryValuesCall(service_, cq_);
 
-      auto status = marshal_value_list(&vl, res.mutable_value_list());
+      value_list_t match;
+      auto status = unmarshal_ident(req_.identifier(), &match, false);
+      if (status.ok())
+        status = query_values(&match, &value_lists_);
       if (!status.ok()) {
-        return status;
+        state_ = FINISH;
+        writer_.Finish(status, this);
+        break;
       }
 
-      if (!writer->Write(res)) {
-        return grpc::Status::CANCELLED;
+      state_ = WRITE;
+      WriteNext();
+      break;
+    }
+
+    case WRITE:
+      if (!ok) {
+        state_ = FINISH;
+        writer_.Finish(grpc::Status::CANCELLED, this);
+        break;
       }
+      WriteNext();
+      break;
 
-      value_lists->pop();
-      sfree(vl.values);
+    case FINISH:
+      delete this;
+      break;
     }
+  } /* Proceed() */
 
-    return grpc::Status::OK;
-  }
-};
+private:
+  void WriteNext() {
+    if (value_lists_.empty()) {
+      state_ = FINISH;
+      writer_.Finish(grpc::Status::OK, this);
+      return;
+    }
+
+    auto vl = value_lists_.front();
+    value_lists_.pop();
+
+    res_->Clear();
+    auto status = marshal_value_list(&vl, res_->mutable_value_list());
+    sfree(vl.values);
+    meta_data_destroy(vl.meta);
+
+    if (!status.ok()) {
+      state_ = FINISH;
+      writer_.Finish(status, this);
+      return;
+    }
+    writer_.Write(*res_, this);
+  } /* WriteNext() */
+
+  Collectd::AsyncService *service_;
+  grpc::ServerCompletionQueue *cq_;
+
+  grpc::ServerContext ctx_;
+  grpc::ServerAsyncWriter<QueryValuesResponse> writer_;
+
+  google::protobuf::Arena arena_;
+  QueryValuesRequest req_;
+  QueryValuesResponse *res_;
+
+  std::queue<value_list_t> value_lists_;
+
+  enum { CONNECT, WRITE, FINISH } state_;
+}; /* class QueryValuesCall */
 
 /*
  * gRPC server implementation
  */
 class CollectdServer final {
 public:
-  void Start() {
+  bool Start() {
     auto auth = grpc::InsecureServerCredentials();
 
     grpc::ServerBuilder builder;
 
+    ports_.clear();
+    ports_.reserve(listeners.empty() ? 1 : listeners.size());
+
     if (listeners.empty()) {
-      builder.AddListeningPort(default_addr, auth);
+      ports_.push_back(0);
+      builder.AddListeningPort(default_addr, auth, &ports_.back());
       INFO("grpc: Listening on %s", default_addr.c_str());
     } else {
       for (auto l : listeners) {
@@ -545,20 +750,64 @@ public:
           a = grpc::SslServerCredentials(*l.ssl);
         }
 
-        builder.AddListeningPort(addr, a);
+        ports_.push_back(0);
+        builder.AddListeningPort(addr, a, &ports_.back());
         INFO("grpc: Listening on %s%s", addr.c_str(), use_ssl.c_str());
       }
     }
 
-    builder.RegisterService(&collectd_service_);
+    builder.RegisterService(&service_);
+    for (int i = 0; i < worker_threads; i++)
+      cqs_.push_back(builder.AddCompletionQueue());
 
     server_ = builder.BuildAndStart();
+    if (server_ == nullptr) {
+      ERROR("grpc: Failed to start server");
+      return false;
+    }
+
+    shutting_down = false;
+    for (auto &cq : cqs_) {
+      new PutValuesCall(&service_, cq.get());
+      new QueryValuesCall(&service_, cq.get());
+      threads_.push_back(std::thread(HandleCalls, cq.get()));
+    }
+
+    return true;
   } /* Start() */
 
-  void Shutdown() { server_->Shutdown(); } /* Shutdown() */
+  void Shutdown() {
+    shutting_down = true;
+    if (server_ != nullptr)
+      server_->Shutdown();
+
+    /* Drain the queues, deleting all calls. */
+    for (auto &cq : cqs_)
+      cq->Shutdown();
+    for (auto &t : threads_)
+      t.join();
+
+    threads_.clear();
+    cqs_.clear();
+  } /* Shutdown() */
+
+  /* Returns the port bound by the n-th listener. */
+  int Port(size_t n) const { return (n < ports_.size()) ? ports_[n] : 0; }
 
 private:
-  CollectdImpl collectd_service_;
+  static void HandleCalls(grpc::ServerCompletionQueue *cq) {
+    void *tag;
+    bool ok;
+
+    while (cq->Next(&tag, &ok))
+      static_cast<Call *>(tag)->Proceed(ok);
+  } /* HandleCalls() */
+
+  Collectd::AsyncService service_;
+
+  std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> cqs_;
+  std::vector<std::thread> threads_;
+  std::vector<int> ports_;
 
   std::unique_ptr<grpc::Server> server_;
 }; /* class CollectdServer */
@@ -767,6 +1016,13 @@ static int c_grpc_config(oconfig_item_t *ci) {
     } else if (!strcasecmp("Server", child->key)) {
       if (c_grpc_config_server(child))
         return -1;
+    } else if (!strcasecmp("WorkerThreads", child->key)) {
+      if (cf_util_get_int(child, &worker_threads))
+        return -1;
+      if (worker_threads < 1) {
+        ERROR("grpc: `%s` must be at least 1.", child->key);
+        return -1;
+      }
     }
 
     else {
@@ -784,7 +1040,11 @@ static int c_grpc_init(void) {
     return -1;
   }
 
-  server->Start();
+  if (!server->Start()) {
+    delete server;
+    server = nullptr;
+    return -1;
+  }
   return 0;
 } /* c_grpc_init() */
 
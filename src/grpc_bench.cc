@@ -0,0 +1,137 @@
+/**
+ * collectd - src/grpc_bench.cc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Loopback benchmark for PutValues: starts the server of the grpc plugin on
+ * 127.0.0.1 and compares sending one value list per message with sending
+ * batches of value lists. This is not part of "make check", because timings
+ * depend on the machine; run "./bench_grpc [values]" by hand. */
+
+/* The mocked plugin_dispatch_values() always fails; count the dispatched
+ * value lists instead. */
+#define plugin_dispatch_values bench_dispatch_values
+#include "grpc.cc" /* sic */
+#undef plugin_dispatch_values
+
+#define BENCHMARK_VALUES 20000
+
+static std::atomic<int> dispatched(0);
+
+int bench_dispatch_values(value_list_t const *vl) {
+  dispatched++;
+  return 0;
+}
+
+static void fill_value_list(collectd::types::ValueList *msg, int n) {
+  auto id = msg->mutable_identifier();
+  id->set_host("example.com");
+  id->set_plugin("bench");
+  id->set_type("gauge");
+  id->set_type_instance(std::to_string(n));
+
+  *msg->mutable_time() = TimeUtil::SecondsToTimestamp(1);
+  *msg->mutable_interval() = TimeUtil::SecondsToDuration(10);
+  msg->add_values()->set_gauge(n);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Sends "num" value lists on a single stream and returns the number of value
+ * lists per second, or a negative value on error. With a "batch_size" of
+ * zero, each value list is sent in a message of its own. */
+static double put_values(Collectd::Stub *stub, int num, int batch_size) {
+  grpc::ClientContext ctx;
+  PutValuesResponse res;
+
+  dispatched = 0;
+  double t0 = now();
+  auto stream = stub->PutValues(&ctx, &res);
+
+  PutValuesRequest req;
+  for (int i = 0; i < num;) {
+    req.Clear();
+    if (batch_size == 0) {
+      fill_value_list(req.mutable_value_list(), i++);
+    } else {
+      for (int j = 0; (j < batch_size) && (i < num); j++)
+        fill_value_list(req.add_value_lists(), i++);
+    }
+
+    if (!stream->Write(req))
+      break;
+  }
+
+  stream->WritesDone();
+  grpc::Status status = stream->Finish();
+  double elapsed = now() - t0;
+
+  if (!status.ok()) {
+    fprintf(stderr, "PutValues failed: %s\n", status.error_message().c_str());
+    return -1;
+  }
+  if (dispatched != num) {
+    fprintf(stderr, "PutValues dispatched %d of %d value lists\n",
+            dispatched.load(), num);
+    return -1;
+  }
+  return num / elapsed;
+}
+
+int main(int argc, char **argv) {
+  int batch_sizes[] = {0, 10, 100, 1000};
+  int num = BENCHMARK_VALUES;
+  int status = 0;
+
+  if (argc > 1 && (num = atoi(argv[1])) <= 0) {
+    fprintf(stderr, "Usage: %s [values]\n", argv[0]);
+    return 1;
+  }
+
+  CollectdServer server;
+  listeners.push_back({"127.0.0.1", "0", nullptr});
+  if (!server.Start()) {
+    fprintf(stderr, "Starting the server failed\n");
+    return 1;
+  }
+
+  grpc::string addr = "127.0.0.1:" + std::to_string(server.Port(0));
+  auto stub = Collectd::NewStub(
+      grpc::CreateChannel(addr, grpc::InsecureChannelCredentials()));
+
+  printf("%d value lists over %s:\n", num, addr.c_str());
+  for (int batch_size : batch_sizes) {
+    double rate = put_values(stub.get(), num, batch_size);
+    if (rate < 0) {
+      status = 1;
+      break;
+    }
+    printf("  %4d per message: %9.0f values/s\n",
+           (batch_size == 0) ? 1 : batch_size, rate);
+  }
+
+  stub.reset();
+  server.Shutdown();
+  return status;
+}
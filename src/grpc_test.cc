@@ -0,0 +1,201 @@
+/**
+ * collectd - src/grpc_test.cc
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* The mocked plugin_dispatch_values() always fails; count the dispatched
+ * value lists instead. */
+#define plugin_dispatch_values test_dispatch_values
+#include "grpc.cc" /* sic */
+#undef plugin_dispatch_values
+
+#include <mutex>
+
+extern "C" {
+#include "testing.h"
+}
+
+static std::atomic<int> dispatched(0);
+static std::mutex last_lock;
+static grpc::string last_type_instance;
+
+int test_dispatch_values(value_list_t const *vl) {
+  std::lock_guard<std::mutex> lock(last_lock);
+  last_type_instance = vl->type_instance;
+  dispatched++;
+  return 0;
+}
+
+DEF_TEST(ident_prefix) {
+  struct {
+    value_list_t matcher;
+    char const *want;
+  } cases[] = {
+      {{.host = "*",
+        .plugin = "*",
+        .plugin_instance = "*",
+        .type = "*",
+        .type_instance = "*"},
+       ""},
+      {{.host = "ex?mple.com",
+        .plugin = "cpu",
+        .plugin_instance = "0",
+        .type = "cpu",
+        .type_instance = "idle"},
+       "ex"},
+      {{.host = "example.com",
+        .plugin = "*",
+        .plugin_instance = "*",
+        .type = "*",
+        .type_instance = "*"},
+       "example.com/"},
+      {{.host = "example.com",
+        .plugin = "cpu",
+        .plugin_instance = "*",
+        .type = "cpu",
+        .type_instance = "idle"},
+       "example.com/cpu"},
+      {{.host = "example.com",
+        .plugin = "cpu",
+        .plugin_instance = "1*",
+        .type = "cpu",
+        .type_instance = "idle"},
+       "example.com/cpu-1"},
+      {{.host = "example.com",
+        .plugin = "cpu",
+        .plugin_instance = "0",
+        .type = "cpu",
+        .type_instance = "[ui]*"},
+       "example.com/cpu-0/cpu"},
+      {{.host = "example.com",
+        .plugin = "load",
+        .plugin_instance = "",
+        .type = "load",
+        .type_instance = ""},
+       "example.com/load/load"},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    grpc::string prefix = ident_prefix(&cases[i].matcher);
+    EXPECT_EQ_STR(cases[i].want, prefix.c_str());
+  }
+
+  return 0;
+}
+
+static void fill_value_list(collectd::types::ValueList *msg, int n) {
+  auto id = msg->mutable_identifier();
+  id->set_host("example.com");
+  id->set_plugin("test");
+  id->set_type("gauge");
+  id->set_type_instance(std::to_string(n));
+
+  *msg->mutable_time() = TimeUtil::SecondsToTimestamp(1);
+  *msg->mutable_interval() = TimeUtil::SecondsToDuration(10);
+  msg->add_values()->set_gauge(n);
+}
+
+/* Sends "num" value lists on a single stream. With a "batch_size" of zero,
+ * each value list is sent in a message of its own. */
+static grpc::Status put_values(Collectd::Stub *stub, int num,
+                               int batch_size) {
+  grpc::ClientContext ctx;
+  PutValuesResponse res;
+  auto stream = stub->PutValues(&ctx, &res);
+
+  PutValuesRequest req;
+  for (int i = 0; i < num;) {
+    req.Clear();
+    if (batch_size == 0) {
+      fill_value_list(req.mutable_value_list(), i++);
+    } else {
+      for (int j = 0; (j < batch_size) && (i < num); j++)
+        fill_value_list(req.add_value_lists(), i++);
+    }
+
+    if (!stream->Write(req))
+      break;
+  }
+
+  stream->WritesDone();
+  return stream->Finish();
+}
+
+static CollectdServer test_server;
+static std::unique_ptr<Collectd::Stub> stub;
+
+DEF_TEST(put_values) {
+  dispatched = 0;
+  CHECK_ZERO(put_values(stub.get(), 1, 0).error_code());
+  EXPECT_EQ_INT(1, dispatched);
+  EXPECT_EQ_STR("0", last_type_instance.c_str());
+
+  dispatched = 0;
+  CHECK_ZERO(put_values(stub.get(), 10, 3).error_code());
+  EXPECT_EQ_INT(10, dispatched);
+  EXPECT_EQ_STR("9", last_type_instance.c_str());
+
+  /* Both fields may be set in the same message. */
+  grpc::ClientContext ctx;
+  PutValuesResponse res;
+  PutValuesRequest req;
+  fill_value_list(req.mutable_value_list(), 1);
+  fill_value_list(req.add_value_lists(), 2);
+  fill_value_list(req.add_value_lists(), 3);
+
+  dispatched = 0;
+  auto stream = stub->PutValues(&ctx, &res);
+  OK(stream->Write(req));
+  stream->WritesDone();
+  CHECK_ZERO(stream->Finish().error_code());
+  EXPECT_EQ_INT(3, dispatched);
+  EXPECT_EQ_STR("3", last_type_instance.c_str());
+
+  /* Invalid value lists end the stream with an error. */
+  grpc::ClientContext err_ctx;
+  req.Clear();
+  fill_value_list(req.add_value_lists(), 1);
+  req.mutable_value_lists(0)->mutable_identifier()->clear_host();
+
+  stream = stub->PutValues(&err_ctx, &res);
+  stream->Write(req);
+  stream->WritesDone();
+  EXPECT_EQ_INT(grpc::StatusCode::INVALID_ARGUMENT,
+                stream->Finish().error_code());
+
+  return 0;
+}
+
+int main(void) {
+  listeners.push_back({"127.0.0.1", "0", nullptr});
+  OK(test_server.Start());
+
+  grpc::string addr = "127.0.0.1:" + std::to_string(test_server.Port(0));
+  stub = Collectd::NewStub(
+      grpc::CreateChannel(addr, grpc::InsecureChannelCredentials()));
+
+  RUN_TEST(ident_prefix);
+  RUN_TEST(put_values);
+
+  stub.reset();
+  test_server.Shutdown();
+
+  END_TEST;
+}
@@ -25,6 +25,7 @@
 
 #include "filter_chain.h"
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 
 #include <jni.h>
@@ -63,6 +64,7 @@ typedef struct java_plugin_class_s java_plugin_class_t;
 #define CB_TYPE_NOTIFICATION 8
 #define CB_TYPE_MATCH 9
 #define CB_TYPE_TARGET 10
+#define CB_TYPE_BATCH_WRITE 11
 struct cjni_callback_info_s /* {{{ */
 {
   char *name;
@@ -74,6 +76,51 @@ struct cjni_callback_info_s /* {{{ */
 typedef struct cjni_callback_info_s cjni_callback_info_t;
 /* }}} */
 
+/* Values collected for a CB_TYPE_BATCH_WRITE callback. Every data source is
+ * assigned a numeric id the first time it is seen; the identifier strings are
+ * only passed to Java once, along with the first batch using them. Value
+ * lists which have not been written for CJNI_BATCH_EXPIRE_INTERVALS of their
+ * intervals are forgotten and get a new id when they show up again. */
+struct cjni_batch_s /* {{{ */
+{
+  cjni_callback_info_t *cbi;
+  pthread_mutex_t lock;
+
+  size_t size;
+  size_t num;
+  cdtime_t first;
+
+  jint *ids;
+  jlong *times;
+  jdouble *values;
+
+  /* Global references to Java arrays of `size' elements, reused for every
+   * call of `writeBatch'. */
+  jintArray o_ids;
+  jlongArray o_times;
+  jdoubleArray o_values;
+
+  /* Maps the value list identifier to a `cjni_batch_entry_t'. */
+  c_avl_tree_t *index;
+  jint num_ids;
+  cdtime_t next_expire;
+
+  /* "<identifier>/<data source>" of ids not yet passed to Java. */
+  char **pending;
+  size_t pending_num;
+};
+typedef struct cjni_batch_s cjni_batch_t;
+
+struct cjni_batch_entry_s /* {{{ */
+{
+  /* Id of the value list's first data source. */
+  jint id;
+  cdtime_t last_write;
+  cdtime_t interval;
+};
+typedef struct cjni_batch_entry_s cjni_batch_entry_t;
+/* }}} */
+
 /*
  * Global variables
  */
@@ -95,6 +142,48 @@ static pthread_mutex_t java_callbacks_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static oconfig_item_t *config_block;
 
+/* Classes (global references) and methods needed to convert value lists.
+ * Looking them up for every value list is expensive, so this is done once by
+ * cjni_cache_init() when the JVM is created. */
+static struct {
+  jclass c_valuelist;
+  jmethodID m_valuelist_constructor;
+  jmethodID m_valuelist_set_host;
+  jmethodID m_valuelist_set_plugin;
+  jmethodID m_valuelist_set_plugin_instance;
+  jmethodID m_valuelist_set_type;
+  jmethodID m_valuelist_set_type_instance;
+  jmethodID m_valuelist_set_time;
+  jmethodID m_valuelist_set_interval;
+  jmethodID m_valuelist_set_data_set;
+  jmethodID m_valuelist_add_value;
+
+  jclass c_dataset;
+  jmethodID m_dataset_constructor;
+  jmethodID m_dataset_add_data_source;
+
+  jclass c_datasource;
+  jmethodID m_datasource_constructor;
+  jmethodID m_datasource_set_name;
+  jmethodID m_datasource_set_type;
+  jmethodID m_datasource_set_min;
+  jmethodID m_datasource_set_max;
+
+  jclass c_long;
+  jmethodID m_long_constructor;
+  jclass c_double;
+  jmethodID m_double_constructor;
+  jclass c_string;
+} cjni_cache;
+
+/* Number of local references reserved when converting a value list. The
+ * references are released all at once by popping the local frame. */
+#define CJNI_LOCAL_FRAME_SIZE 32
+
+/* Number of intervals after which an identifier not written to a batch write
+ * callback is removed from the batch's index. */
+#define CJNI_BATCH_EXPIRE_INTERVALS 10
+
 /*
  * Prototypes
  *
@@ -113,6 +202,11 @@ static int cjni_write(const data_set_t *ds, const value_list_t *vl,
                       user_data_t *ud);
 static int cjni_flush(cdtime_t timeout, const char *identifier,
                       user_data_t *ud);
+static int cjni_batch_write(const data_set_t *ds, const value_list_t *vl,
+                            user_data_t *ud);
+static int cjni_batch_flush(cdtime_t timeout, const char *identifier,
+                            user_data_t *ud);
+static void cjni_batch_destroy(void *arg);
 static void cjni_log(int severity, const char *message, user_data_t *ud);
 static int cjni_notification(const notification_t *n, user_data_t *ud);
 
@@ -209,72 +303,18 @@ static int ctoj_long(JNIEnv *jvm_env, /* {{{ */
   return 0;
 } /* }}} int ctoj_long */
 
-static int ctoj_double(JNIEnv *jvm_env, /* {{{ */
-                       jdouble value, jclass class_ptr, jobject object_ptr,
-                       const char *method_name) {
-  jmethodID m_set;
-
-  /* Search for the `void setFoo (double d)' method. */
-  m_set = (*jvm_env)->GetMethodID(jvm_env, class_ptr, method_name, "(D)V");
-  if (m_set == NULL) {
-    ERROR("java plugin: ctoj_double: Cannot find method `void %s (double)'.",
-          method_name);
-    return -1;
-  }
-
-  (*jvm_env)->CallVoidMethod(jvm_env, object_ptr, m_set, value);
-
-  return 0;
-} /* }}} int ctoj_double */
-
 /* Convert a jlong to a java.lang.Number */
 static jobject ctoj_jlong_to_number(JNIEnv *jvm_env, jlong value) /* {{{ */
 {
-  jclass c_long;
-  jmethodID m_long_constructor;
-
-  /* Look up the java.lang.Long class */
-  c_long = (*jvm_env)->FindClass(jvm_env, "java/lang/Long");
-  if (c_long == NULL) {
-    ERROR("java plugin: ctoj_jlong_to_number: Looking up the "
-          "java.lang.Long class failed.");
-    return NULL;
-  }
-
-  m_long_constructor =
-      (*jvm_env)->GetMethodID(jvm_env, c_long, "<init>", "(J)V");
-  if (m_long_constructor == NULL) {
-    ERROR("java plugin: ctoj_jlong_to_number: Looking up the "
-          "`Long (long)' constructor failed.");
-    return NULL;
-  }
-
-  return (*jvm_env)->NewObject(jvm_env, c_long, m_long_constructor, value);
+  return (*jvm_env)->NewObject(jvm_env, cjni_cache.c_long,
+                               cjni_cache.m_long_constructor, value);
 } /* }}} jobject ctoj_jlong_to_number */
 
 /* Convert a jdouble to a java.lang.Number */
 static jobject ctoj_jdouble_to_number(JNIEnv *jvm_env, jdouble value) /* {{{ */
 {
-  jclass c_double;
-  jmethodID m_double_constructor;
-
-  /* Look up the java.lang.Long class */
-  c_double = (*jvm_env)->FindClass(jvm_env, "java/lang/Double");
-  if (c_double == NULL) {
-    ERROR("java plugin: ctoj_jdouble_to_number: Looking up the "
-          "java.lang.Double class failed.");
-    return NULL;
-  }
-
-  m_double_constructor =
-      (*jvm_env)->GetMethodID(jvm_env, c_double, "<init>", "(D)V");
-  if (m_double_constructor == NULL) {
-    ERROR("java plugin: ctoj_jdouble_to_number: Looking up the "
-          "`Double (double)' constructor failed.");
-    return NULL;
-  }
-
-  return (*jvm_env)->NewObject(jvm_env, c_double, m_double_constructor, value);
+  return (*jvm_env)->NewObject(jvm_env, cjni_cache.c_double,
+                               cjni_cache.m_double_constructor, value);
 } /* }}} jobject ctoj_jdouble_to_number */
 
 /* Convert a value_t to a java.lang.Number */
@@ -295,75 +335,38 @@ static jobject ctoj_value_to_number(JNIEnv *jvm_env, /* {{{ */
 /* Convert a data_source_t to a org/collectd/api/DataSource */
 static jobject ctoj_data_source(JNIEnv *jvm_env, /* {{{ */
                                 const data_source_t *dsrc) {
-  jclass c_datasource;
-  jmethodID m_datasource_constructor;
   jobject o_datasource;
-  int status;
-
-  /* Look up the DataSource class */
-  c_datasource = (*jvm_env)->FindClass(jvm_env, "org/collectd/api/DataSource");
-  if (c_datasource == NULL) {
-    ERROR("java plugin: ctoj_data_source: "
-          "FindClass (org/collectd/api/DataSource) failed.");
-    return NULL;
-  }
-
-  /* Lookup the `ValueList ()' constructor. */
-  m_datasource_constructor =
-      (*jvm_env)->GetMethodID(jvm_env, c_datasource, "<init>", "()V");
-  if (m_datasource_constructor == NULL) {
-    ERROR("java plugin: ctoj_data_source: Cannot find the "
-          "`DataSource ()' constructor.");
-    return NULL;
-  }
+  jstring o_name;
 
   /* Create a new instance. */
-  o_datasource =
-      (*jvm_env)->NewObject(jvm_env, c_datasource, m_datasource_constructor);
+  o_datasource = (*jvm_env)->NewObject(jvm_env, cjni_cache.c_datasource,
+                                       cjni_cache.m_datasource_constructor);
   if (o_datasource == NULL) {
     ERROR("java plugin: ctoj_data_source: "
           "Creating a new DataSource instance failed.");
     return NULL;
   }
 
-  /* Set name via `void setName (String name)' */
-  status =
-      ctoj_string(jvm_env, dsrc->name, c_datasource, o_datasource, "setName");
-  if (status != 0) {
-    ERROR("java plugin: ctoj_data_source: "
-          "ctoj_string (setName) failed.");
+  o_name = (*jvm_env)->NewStringUTF(jvm_env, dsrc->name);
+  if (o_name == NULL) {
+    ERROR("java plugin: ctoj_data_source: NewStringUTF failed.");
     (*jvm_env)->DeleteLocalRef(jvm_env, o_datasource);
     return NULL;
   }
 
-  /* Set type via `void setType (int type)' */
-  status = ctoj_int(jvm_env, dsrc->type, c_datasource, o_datasource, "setType");
-  if (status != 0) {
-    ERROR("java plugin: ctoj_data_source: "
-          "ctoj_int (setType) failed.");
-    (*jvm_env)->DeleteLocalRef(jvm_env, o_datasource);
-    return NULL;
-  }
+  (*jvm_env)->CallVoidMethod(jvm_env, o_datasource,
+                             cjni_cache.m_datasource_set_name, o_name);
+  (*jvm_env)->DeleteLocalRef(jvm_env, o_name);
 
-  /* Set min via `void setMin (double min)' */
-  status =
-      ctoj_double(jvm_env, dsrc->min, c_datasource, o_datasource, "setMin");
-  if (status != 0) {
-    ERROR("java plugin: ctoj_data_source: "
-          "ctoj_double (setMin) failed.");
-    (*jvm_env)->DeleteLocalRef(jvm_env, o_datasource);
-    return NULL;
-  }
-
-  /* Set max via `void setMax (double max)' */
-  status =
-      ctoj_double(jvm_env, dsrc->max, c_datasource, o_datasource, "setMax");
-  if (status != 0) {
-    ERROR("java plugin: ctoj_data_source: "
-          "ctoj_double (setMax) failed.");
-    (*jvm_env)->DeleteLocalRef(jvm_env, o_datasource);
-    return NULL;
-  }
+  (*jvm_env)->CallVoidMethod(jvm_env, o_datasource,
+                             cjni_cache.m_datasource_set_type,
+                             (jint)dsrc->type);
+  (*jvm_env)->CallVoidMethod(jvm_env, o_datasource,
+                             cjni_cache.m_datasource_set_min,
+                             (jdouble)dsrc->min);
+  (*jvm_env)->CallVoidMethod(jvm_env, o_datasource,
+                             cjni_cache.m_datasource_set_max,
+                             (jdouble)dsrc->max);
 
   return o_datasource;
 } /* }}} jobject ctoj_data_source */
@@ -558,45 +561,17 @@ static jobject ctoj_oconfig_item(JNIEnv *jvm_env, /* {{{ */
 /* Convert a data_set_t to a org/collectd/api/DataSet */
 static jobject ctoj_data_set(JNIEnv *jvm_env, const data_set_t *ds) /* {{{ */
 {
-  jclass c_dataset;
-  jmethodID m_constructor;
-  jmethodID m_add;
   jobject o_type;
   jobject o_dataset;
 
-  /* Look up the org/collectd/api/DataSet class */
-  c_dataset = (*jvm_env)->FindClass(jvm_env, "org/collectd/api/DataSet");
-  if (c_dataset == NULL) {
-    ERROR("java plugin: ctoj_data_set: Looking up the "
-          "org/collectd/api/DataSet class failed.");
-    return NULL;
-  }
-
-  /* Search for the `DataSet (String type)' constructor. */
-  m_constructor = (*jvm_env)->GetMethodID(jvm_env, c_dataset, "<init>",
-                                          "(Ljava/lang/String;)V");
-  if (m_constructor == NULL) {
-    ERROR("java plugin: ctoj_data_set: Looking up the "
-          "`DataSet (String)' constructor failed.");
-    return NULL;
-  }
-
-  /* Search for the `void addDataSource (DataSource)' method. */
-  m_add = (*jvm_env)->GetMethodID(jvm_env, c_dataset, "addDataSource",
-                                  "(Lorg/collectd/api/DataSource;)V");
-  if (m_add == NULL) {
-    ERROR("java plugin: ctoj_data_set: Looking up the "
-          "`addDataSource (DataSource)' method failed.");
-    return NULL;
-  }
-
   o_type = (*jvm_env)->NewStringUTF(jvm_env, ds->type);
   if (o_type == NULL) {
     ERROR("java plugin: ctoj_data_set: Creating a String object failed.");
     return NULL;
   }
 
-  o_dataset = (*jvm_env)->NewObject(jvm_env, c_dataset, m_constructor, o_type);
+  o_dataset = (*jvm_env)->NewObject(jvm_env, cjni_cache.c_dataset,
+                                    cjni_cache.m_dataset_constructor, o_type);
   if (o_dataset == NULL) {
     ERROR("java plugin: ctoj_data_set: Creating a DataSet object failed.");
     (*jvm_env)->DeleteLocalRef(jvm_env, o_type);
@@ -617,7 +592,9 @@ static jobject ctoj_data_set(JNIEnv *jvm_env, const data_set_t *ds) /* {{{ */
       return NULL;
     }
 
-    (*jvm_env)->CallVoidMethod(jvm_env, o_dataset, m_add, o_datasource);
+    (*jvm_env)->CallVoidMethod(jvm_env, o_dataset,
+                               cjni_cache.m_dataset_add_data_source,
+                               o_datasource);
 
     (*jvm_env)->DeleteLocalRef(jvm_env, o_datasource);
   } /* for (i = 0; i < ds->ds_num; i++) */
@@ -625,157 +602,75 @@ static jobject ctoj_data_set(JNIEnv *jvm_env, const data_set_t *ds) /* {{{ */
   return o_dataset;
 } /* }}} jobject ctoj_data_set */
 
-static int ctoj_value_list_add_value(JNIEnv *jvm_env, /* {{{ */
-                                     value_t value, int ds_type,
-                                     jclass class_ptr, jobject object_ptr) {
-  jmethodID m_addvalue;
-  jobject o_number;
-
-  m_addvalue = (*jvm_env)->GetMethodID(jvm_env, class_ptr, "addValue",
-                                       "(Ljava/lang/Number;)V");
-  if (m_addvalue == NULL) {
-    ERROR("java plugin: ctoj_value_list_add_value: "
-          "Cannot find method `void addValue (Number)'.");
-    return -1;
-  }
-
-  o_number = ctoj_value_to_number(jvm_env, value, ds_type);
-  if (o_number == NULL) {
-    ERROR("java plugin: ctoj_value_list_add_value: "
-          "ctoj_value_to_number failed.");
-    return -1;
-  }
-
-  (*jvm_env)->CallVoidMethod(jvm_env, object_ptr, m_addvalue, o_number);
-
-  (*jvm_env)->DeleteLocalRef(jvm_env, o_number);
-
-  return 0;
-} /* }}} int ctoj_value_list_add_value */
-
-static int ctoj_value_list_add_data_set(JNIEnv *jvm_env, /* {{{ */
-                                        jclass c_valuelist, jobject o_valuelist,
-                                        const data_set_t *ds) {
-  jmethodID m_setdataset;
-  jobject o_dataset;
-
-  /* Look for the `void setDataSource (List<DataSource> ds)' method. */
-  m_setdataset = (*jvm_env)->GetMethodID(jvm_env, c_valuelist, "setDataSet",
-                                         "(Lorg/collectd/api/DataSet;)V");
-  if (m_setdataset == NULL) {
-    ERROR("java plugin: ctoj_value_list_add_data_set: "
-          "Cannot find the `void setDataSet (DataSet)' method.");
-    return -1;
-  }
-
-  /* Create a DataSet object. */
-  o_dataset = ctoj_data_set(jvm_env, ds);
-  if (o_dataset == NULL) {
-    ERROR("java plugin: ctoj_value_list_add_data_set: "
-          "ctoj_data_set (%s) failed.",
-          ds->type);
-    return -1;
-  }
-
-  /* Actually call the method. */
-  (*jvm_env)->CallVoidMethod(jvm_env, o_valuelist, m_setdataset, o_dataset);
-
-  /* Decrease reference counter on the List<DataSource> object. */
-  (*jvm_env)->DeleteLocalRef(jvm_env, o_dataset);
-
-  return 0;
-} /* }}} int ctoj_value_list_add_data_set */
-
-/* Convert a value_list_t (and data_set_t) to a org/collectd/api/ValueList */
+/* Convert a value_list_t (and data_set_t) to a org/collectd/api/ValueList.
+ * Local references are only released on error, so callers should call this
+ * inside a local frame (see CJNI_LOCAL_FRAME_SIZE). */
 static jobject ctoj_value_list(JNIEnv *jvm_env, /* {{{ */
                                const data_set_t *ds, const value_list_t *vl) {
-  jclass c_valuelist;
-  jmethodID m_valuelist_constructor;
   jobject o_valuelist;
-  int status;
-
-  /* First, create a new ValueList instance..
-   * Look up the class.. */
-  c_valuelist = (*jvm_env)->FindClass(jvm_env, "org/collectd/api/ValueList");
-  if (c_valuelist == NULL) {
-    ERROR("java plugin: ctoj_value_list: "
-          "FindClass (org/collectd/api/ValueList) failed.");
-    return NULL;
-  }
-
-  /* Lookup the `ValueList ()' constructor. */
-  m_valuelist_constructor =
-      (*jvm_env)->GetMethodID(jvm_env, c_valuelist, "<init>", "()V");
-  if (m_valuelist_constructor == NULL) {
-    ERROR("java plugin: ctoj_value_list: Cannot find the "
-          "`ValueList ()' constructor.");
-    return NULL;
-  }
+  jobject o_dataset;
 
   /* Create a new instance. */
-  o_valuelist =
-      (*jvm_env)->NewObject(jvm_env, c_valuelist, m_valuelist_constructor);
+  o_valuelist = (*jvm_env)->NewObject(jvm_env, cjni_cache.c_valuelist,
+                                      cjni_cache.m_valuelist_constructor);
   if (o_valuelist == NULL) {
     ERROR("java plugin: ctoj_value_list: Creating a new ValueList instance "
           "failed.");
     return NULL;
   }
 
-  status = ctoj_value_list_add_data_set(jvm_env, c_valuelist, o_valuelist, ds);
-  if (status != 0) {
-    ERROR("java plugin: ctoj_value_list: "
-          "ctoj_value_list_add_data_set failed.");
+  o_dataset = ctoj_data_set(jvm_env, ds);
+  if (o_dataset == NULL) {
+    ERROR("java plugin: ctoj_value_list: ctoj_data_set (%s) failed.",
+          ds->type);
     (*jvm_env)->DeleteLocalRef(jvm_env, o_valuelist);
     return NULL;
   }
+  (*jvm_env)->CallVoidMethod(jvm_env, o_valuelist,
+                             cjni_cache.m_valuelist_set_data_set, o_dataset);
 
 /* Set the strings.. */
-#define SET_STRING(str, method_name)                                           \
+#define SET_STRING(str, method)                                                \
   do {                                                                         \
-    status = ctoj_string(jvm_env, str, c_valuelist, o_valuelist, method_name); \
-    if (status != 0) {                                                         \
-      ERROR("java plugin: ctoj_value_list: ctoj_string (%s) failed.",          \
-            method_name);                                                      \
+    jstring o_string = (*jvm_env)->NewStringUTF(jvm_env, str);                 \
+    if (o_string == NULL) {                                                    \
+      ERROR("java plugin: ctoj_value_list: NewStringUTF failed.");             \
       (*jvm_env)->DeleteLocalRef(jvm_env, o_valuelist);                        \
       return NULL;                                                             \
     }                                                                          \
+    (*jvm_env)->CallVoidMethod(jvm_env, o_valuelist, cjni_cache.method,        \
+                               o_string);                                      \
   } while (0)
 
-  SET_STRING(vl->host, "setHost");
-  SET_STRING(vl->plugin, "setPlugin");
-  SET_STRING(vl->plugin_instance, "setPluginInstance");
-  SET_STRING(vl->type, "setType");
-  SET_STRING(vl->type_instance, "setTypeInstance");
+  SET_STRING(vl->host, m_valuelist_set_host);
+  SET_STRING(vl->plugin, m_valuelist_set_plugin);
+  SET_STRING(vl->plugin_instance, m_valuelist_set_plugin_instance);
+  SET_STRING(vl->type, m_valuelist_set_type);
+  SET_STRING(vl->type_instance, m_valuelist_set_type_instance);
 
 #undef SET_STRING
 
   /* Set the `time' member. Java stores time in milliseconds. */
-  status = ctoj_long(jvm_env, (jlong)CDTIME_T_TO_MS(vl->time), c_valuelist,
-                     o_valuelist, "setTime");
-  if (status != 0) {
-    ERROR("java plugin: ctoj_value_list: ctoj_long (setTime) failed.");
-    (*jvm_env)->DeleteLocalRef(jvm_env, o_valuelist);
-    return NULL;
-  }
+  (*jvm_env)->CallVoidMethod(jvm_env, o_valuelist,
+                             cjni_cache.m_valuelist_set_time,
+                             (jlong)CDTIME_T_TO_MS(vl->time));
 
   /* Set the `interval' member.. */
-  status = ctoj_long(jvm_env, (jlong)CDTIME_T_TO_MS(vl->interval), c_valuelist,
-                     o_valuelist, "setInterval");
-  if (status != 0) {
-    ERROR("java plugin: ctoj_value_list: ctoj_long (setInterval) failed.");
-    (*jvm_env)->DeleteLocalRef(jvm_env, o_valuelist);
-    return NULL;
-  }
+  (*jvm_env)->CallVoidMethod(jvm_env, o_valuelist,
+                             cjni_cache.m_valuelist_set_interval,
+                             (jlong)CDTIME_T_TO_MS(vl->interval));
 
   for (size_t i = 0; i < vl->values_len; i++) {
-    status = ctoj_value_list_add_value(jvm_env, vl->values[i], ds->ds[i].type,
-                                       c_valuelist, o_valuelist);
-    if (status != 0) {
-      ERROR("java plugin: ctoj_value_list: "
-            "ctoj_value_list_add_value failed.");
+    jobject o_number =
+        ctoj_value_to_number(jvm_env, vl->values[i], ds->ds[i].type);
+    if (o_number == NULL) {
+      ERROR("java plugin: ctoj_value_list: ctoj_value_to_number failed.");
       (*jvm_env)->DeleteLocalRef(jvm_env, o_valuelist);
       return NULL;
     }
+
+    (*jvm_env)->CallVoidMethod(jvm_env, o_valuelist,
+                               cjni_cache.m_valuelist_add_value, o_number);
   }
 
   return o_valuelist;
@@ -1359,6 +1254,83 @@ static jint JNICALL cjni_api_register_flush(JNIEnv *jvm_env, /* {{{ */
   return 0;
 } /* }}} jint cjni_api_register_flush */
 
+static jint JNICALL cjni_api_register_batch_write(JNIEnv *jvm_env, /* {{{ */
+                                                  jobject this, jobject o_name,
+                                                  jint batch_size,
+                                                  jobject o_write) {
+  cjni_callback_info_t *cbi;
+  cjni_batch_t *b;
+
+  if (batch_size <= 0) {
+    ERROR("java plugin: registerBatchWrite: Invalid batch size: %i",
+          (int)batch_size);
+    return -1;
+  }
+
+  cbi = cjni_callback_info_create(jvm_env, o_name, o_write,
+                                  CB_TYPE_BATCH_WRITE);
+  if (cbi == NULL)
+    return -1;
+
+  b = calloc(1, sizeof(*b));
+  if (b == NULL) {
+    ERROR("java plugin: registerBatchWrite: calloc failed.");
+    cjni_callback_info_destroy(cbi);
+    return -1;
+  }
+  b->cbi = cbi;
+  pthread_mutex_init(&b->lock, NULL);
+  b->size = (size_t)batch_size;
+
+  b->ids = calloc(b->size, sizeof(*b->ids));
+  b->times = calloc(b->size, sizeof(*b->times));
+  b->values = calloc(b->size, sizeof(*b->values));
+  b->index = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if ((b->ids != NULL) && (b->times != NULL) && (b->values != NULL)) {
+    jobject o_tmp;
+
+    o_tmp = (*jvm_env)->NewIntArray(jvm_env, batch_size);
+    if (o_tmp != NULL) {
+      b->o_ids = (*jvm_env)->NewGlobalRef(jvm_env, o_tmp);
+      (*jvm_env)->DeleteLocalRef(jvm_env, o_tmp);
+    }
+    o_tmp = (*jvm_env)->NewLongArray(jvm_env, batch_size);
+    if (o_tmp != NULL) {
+      b->o_times = (*jvm_env)->NewGlobalRef(jvm_env, o_tmp);
+      (*jvm_env)->DeleteLocalRef(jvm_env, o_tmp);
+    }
+    o_tmp = (*jvm_env)->NewDoubleArray(jvm_env, batch_size);
+    if (o_tmp != NULL) {
+      b->o_values = (*jvm_env)->NewGlobalRef(jvm_env, o_tmp);
+      (*jvm_env)->DeleteLocalRef(jvm_env, o_tmp);
+    }
+  }
+
+  if ((b->index == NULL) || (b->o_ids == NULL) || (b->o_times == NULL) ||
+      (b->o_values == NULL)) {
+    ERROR("java plugin: registerBatchWrite: Allocating the batch failed.");
+    cjni_batch_destroy(b);
+    return -1;
+  }
+
+  DEBUG("java plugin: Registering new batch write callback: %s", cbi->name);
+
+  /* Both callbacks share `b'; only the write callback frees it. */
+  plugin_register_flush(cbi->name, cjni_batch_flush,
+                        &(user_data_t){
+                            .data = b,
+                        });
+  plugin_register_write(cbi->name, cjni_batch_write,
+                        &(user_data_t){
+                            .data = b,
+                            .free_func = cjni_batch_destroy,
+                        });
+
+  (*jvm_env)->DeleteLocalRef(jvm_env, o_write);
+
+  return 0;
+} /* }}} jint cjni_api_register_batch_write */
+
 static jint JNICALL cjni_api_register_shutdown(JNIEnv *jvm_env, /* {{{ */
                                                jobject this, jobject o_name,
                                                jobject o_shutdown) {
@@ -1537,6 +1509,11 @@ static JNINativeMethod jni_api_functions[] = /* {{{ */
          "(Ljava/lang/String;Lorg/collectd/api/CollectdFlushInterface;)I",
          cjni_api_register_flush},
 
+        {"registerBatchWrite",
+         "(Ljava/lang/String;ILorg/collectd/api/"
+         "CollectdBatchWriteInterface;)I",
+         cjni_api_register_batch_write},
+
         {"registerShutdown",
          "(Ljava/lang/String;Lorg/collectd/api/CollectdShutdownInterface;)I",
          cjni_api_register_shutdown},
@@ -1635,6 +1612,11 @@ cjni_callback_info_create(JNIEnv *jvm_env, /* {{{ */
                        "Lorg/collectd/api/CollectdTargetInterface;";
     break;
 
+  case CB_TYPE_BATCH_WRITE:
+    method_name = "writeBatch";
+    method_signature = "(I[I[J[D[Ljava/lang/String;)I";
+    break;
+
   default:
     ERROR("java plugin: cjni_callback_info_create: Unknown type: %#x", type);
     return NULL;
@@ -1791,6 +1773,81 @@ static void cjni_jvm_env_destroy(void *args) /* {{{ */
   free(cjni_env);
 } /* }}} void cjni_jvm_env_destroy */
 
+/* Look up the classes and methods in `cjni_cache'. */
+static int cjni_cache_init(JNIEnv *jvm_env) /* {{{ */
+{
+#define CACHE_CLASS(member, name)                                              \
+  do {                                                                         \
+    jclass c_tmp = (*jvm_env)->FindClass(jvm_env, name);                       \
+    if (c_tmp == NULL) {                                                       \
+      ERROR("java plugin: cjni_cache_init: FindClass (%s) failed.", name);     \
+      return -1;                                                               \
+    }                                                                          \
+    cjni_cache.member = (*jvm_env)->NewGlobalRef(jvm_env, c_tmp);              \
+    (*jvm_env)->DeleteLocalRef(jvm_env, c_tmp);                                \
+    if (cjni_cache.member == NULL) {                                           \
+      ERROR("java plugin: cjni_cache_init: NewGlobalRef (%s) failed.", name);  \
+      return -1;                                                               \
+    }                                                                          \
+  } while (0)
+
+#define CACHE_METHOD(member, class, name, signature)                           \
+  do {                                                                         \
+    cjni_cache.member =                                                        \
+        (*jvm_env)->GetMethodID(jvm_env, cjni_cache.class, name, signature);   \
+    if (cjni_cache.member == NULL) {                                           \
+      ERROR("java plugin: cjni_cache_init: Cannot find the method "            \
+            "`%s' with signature `%s'.",                                       \
+            name, signature);                                                  \
+      return -1;                                                               \
+    }                                                                          \
+  } while (0)
+
+  CACHE_CLASS(c_valuelist, "org/collectd/api/ValueList");
+  CACHE_METHOD(m_valuelist_constructor, c_valuelist, "<init>", "()V");
+  CACHE_METHOD(m_valuelist_set_host, c_valuelist, "setHost",
+               "(Ljava/lang/String;)V");
+  CACHE_METHOD(m_valuelist_set_plugin, c_valuelist, "setPlugin",
+               "(Ljava/lang/String;)V");
+  CACHE_METHOD(m_valuelist_set_plugin_instance, c_valuelist,
+               "setPluginInstance", "(Ljava/lang/String;)V");
+  CACHE_METHOD(m_valuelist_set_type, c_valuelist, "setType",
+               "(Ljava/lang/String;)V");
+  CACHE_METHOD(m_valuelist_set_type_instance, c_valuelist, "setTypeInstance",
+               "(Ljava/lang/String;)V");
+  CACHE_METHOD(m_valuelist_set_time, c_valuelist, "setTime", "(J)V");
+  CACHE_METHOD(m_valuelist_set_interval, c_valuelist, "setInterval", "(J)V");
+  CACHE_METHOD(m_valuelist_set_data_set, c_valuelist, "setDataSet",
+               "(Lorg/collectd/api/DataSet;)V");
+  CACHE_METHOD(m_valuelist_add_value, c_valuelist, "addValue",
+               "(Ljava/lang/Number;)V");
+
+  CACHE_CLASS(c_dataset, "org/collectd/api/DataSet");
+  CACHE_METHOD(m_dataset_constructor, c_dataset, "<init>",
+               "(Ljava/lang/String;)V");
+  CACHE_METHOD(m_dataset_add_data_source, c_dataset, "addDataSource",
+               "(Lorg/collectd/api/DataSource;)V");
+
+  CACHE_CLASS(c_datasource, "org/collectd/api/DataSource");
+  CACHE_METHOD(m_datasource_constructor, c_datasource, "<init>", "()V");
+  CACHE_METHOD(m_datasource_set_name, c_datasource, "setName",
+               "(Ljava/lang/String;)V");
+  CACHE_METHOD(m_datasource_set_type, c_datasource, "setType", "(I)V");
+  CACHE_METHOD(m_datasource_set_min, c_datasource, "setMin", "(D)V");
+  CACHE_METHOD(m_datasource_set_max, c_datasource, "setMax", "(D)V");
+
+  CACHE_CLASS(c_long, "java/lang/Long");
+  CACHE_METHOD(m_long_constructor, c_long, "<init>", "(J)V");
+  CACHE_CLASS(c_double, "java/lang/Double");
+  CACHE_METHOD(m_double_constructor, c_double, "<init>", "(D)V");
+  CACHE_CLASS(c_string, "java/lang/String");
+
+#undef CACHE_METHOD
+#undef CACHE_CLASS
+
+  return 0;
+} /* }}} int cjni_cache_init */
+
 /* Register ``native'' functions with the JVM. Native functions are C-functions
  * that can be called by Java code. */
 static int cjni_init_native(JNIEnv *jvm_env) /* {{{ */
@@ -1813,7 +1870,7 @@ static int cjni_init_native(JNIEnv *jvm_env) /* {{{ */
     return -1;
   }
 
-  return 0;
+  return cjni_cache_init(jvm_env);
 } /* }}} int cjni_init_native */
 
 /* Create the JVM. This is called when the first thread tries to access the JVM
@@ -2337,9 +2394,16 @@ static int cjni_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
 
   cbi = (cjni_callback_info_t *)ud->data;
 
+  if ((*jvm_env)->PushLocalFrame(jvm_env, CJNI_LOCAL_FRAME_SIZE) != 0) {
+    ERROR("java plugin: cjni_write: PushLocalFrame failed.");
+    cjni_thread_detach();
+    return -1;
+  }
+
   vl_java = ctoj_value_list(jvm_env, ds, vl);
   if (vl_java == NULL) {
     ERROR("java plugin: cjni_write: ctoj_value_list failed.");
+    (*jvm_env)->PopLocalFrame(jvm_env, NULL);
     cjni_thread_detach();
     return -1;
   }
@@ -2347,7 +2411,8 @@ static int cjni_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
   ret_status =
       (*jvm_env)->CallIntMethod(jvm_env, cbi->object, cbi->method, vl_java);
 
-  (*jvm_env)->DeleteLocalRef(jvm_env, vl_java);
+  /* Releases `vl_java' and everything created while converting it. */
+  (*jvm_env)->PopLocalFrame(jvm_env, NULL);
 
   cjni_thread_detach();
   return ret_status;
@@ -2408,6 +2473,317 @@ static int cjni_flush(cdtime_t timeout, const char *identifier, /* {{{ */
   return ret_status;
 } /* }}} int cjni_flush */
 
+/* Pass the collected values to the CB_TYPE_BATCH_WRITE callback. The batch
+ * is empty afterwards: if the values can't be passed to Java, they are
+ * dropped. Identifiers not yet passed to Java are kept for the next try.
+ * NOTE: You must hold b->lock when calling this function! */
+static int cjni_batch_send(cjni_batch_t *b) /* {{{ */
+{
+  JNIEnv *jvm_env;
+  jobjectArray o_identifiers;
+  int ret_status;
+
+  if (b->num == 0)
+    return 0;
+
+  jsize num = (jsize)b->num;
+  b->num = 0;
+
+  jvm_env = cjni_thread_attach();
+  if (jvm_env == NULL)
+    return -1;
+
+  if ((*jvm_env)->PushLocalFrame(jvm_env, CJNI_LOCAL_FRAME_SIZE) != 0) {
+    ERROR("java plugin: cjni_batch_send: PushLocalFrame failed.");
+    cjni_thread_detach();
+    return -1;
+  }
+
+  o_identifiers = (*jvm_env)->NewObjectArray(
+      jvm_env, (jsize)b->pending_num, cjni_cache.c_string, NULL);
+  if (o_identifiers == NULL) {
+    ERROR("java plugin: cjni_batch_send: NewObjectArray failed.");
+    (*jvm_env)->PopLocalFrame(jvm_env, NULL);
+    cjni_thread_detach();
+    return -1;
+  }
+
+  for (size_t i = 0; i < b->pending_num; i++) {
+    jstring o_string = (*jvm_env)->NewStringUTF(jvm_env, b->pending[i]);
+    if (o_string == NULL) {
+      ERROR("java plugin: cjni_batch_send: NewStringUTF failed.");
+      (*jvm_env)->PopLocalFrame(jvm_env, NULL);
+      cjni_thread_detach();
+      return -1;
+    }
+    (*jvm_env)->SetObjectArrayElement(jvm_env, o_identifiers, (jsize)i,
+                                      o_string);
+    (*jvm_env)->DeleteLocalRef(jvm_env, o_string);
+  }
+
+  (*jvm_env)->SetIntArrayRegion(jvm_env, b->o_ids, 0, num, b->ids);
+  (*jvm_env)->SetLongArrayRegion(jvm_env, b->o_times, 0, num, b->times);
+  (*jvm_env)->SetDoubleArrayRegion(jvm_env, b->o_values, 0, num, b->values);
+
+  ret_status = (*jvm_env)->CallIntMethod(
+      jvm_env, b->cbi->object, b->cbi->method, (jint)num, b->o_ids,
+      b->o_times, b->o_values, o_identifiers);
+
+  (*jvm_env)->PopLocalFrame(jvm_env, NULL);
+  cjni_thread_detach();
+
+  /* The identifiers have been passed to Java, even if the callback failed. */
+  for (size_t i = 0; i < b->pending_num; i++)
+    sfree(b->pending[i]);
+  b->pending_num = 0;
+
+  return ret_status;
+} /* }}} int cjni_batch_send */
+
+/* Look up the id of the first data source of `vl', assigning new ids if the
+ * value list has not been seen before.
+ * NOTE: You must hold b->lock when calling this function! */
+static int cjni_batch_lookup(cjni_batch_t *b, const data_set_t *ds, /* {{{ */
+                             const value_list_t *vl, cdtime_t now,
+                             jint *ret_id) {
+  char identifier[6 * DATA_MAX_NAME_LEN];
+  cjni_batch_entry_t *entry;
+  char **tmp;
+  char *key;
+
+  if (FORMAT_VL(identifier, sizeof(identifier), vl) != 0)
+    return -1;
+
+  if (c_avl_get(b->index, identifier, (void *)&entry) == 0) {
+    entry->last_write = now;
+    entry->interval = vl->interval;
+    *ret_id = entry->id;
+    return 0;
+  }
+
+  tmp = realloc(b->pending, (b->pending_num + ds->ds_num) * sizeof(*tmp));
+  if (tmp == NULL)
+    return -1;
+  b->pending = tmp;
+
+  entry = calloc(1, sizeof(*entry));
+  if (entry == NULL)
+    return -1;
+  entry->id = b->num_ids;
+  entry->last_write = now;
+  entry->interval = vl->interval;
+
+  key = strdup(identifier);
+  if (key == NULL) {
+    sfree(entry);
+    return -1;
+  }
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    char buffer[sizeof(identifier) + DATA_MAX_NAME_LEN];
+
+    ssnprintf(buffer, sizeof(buffer), "%s/%s", identifier, ds->ds[i].name);
+    b->pending[b->pending_num + i] = strdup(buffer);
+    if (b->pending[b->pending_num + i] == NULL) {
+      while (i > 0)
+        sfree(b->pending[b->pending_num + --i]);
+      sfree(key);
+      sfree(entry);
+      return -1;
+    }
+  }
+
+  if (c_avl_insert(b->index, key, entry) != 0) {
+    for (size_t i = 0; i < ds->ds_num; i++)
+      sfree(b->pending[b->pending_num + i]);
+    sfree(key);
+    sfree(entry);
+    return -1;
+  }
+
+  *ret_id = b->num_ids;
+  b->pending_num += ds->ds_num;
+  b->num_ids += (jint)ds->ds_num;
+  return 0;
+} /* }}} int cjni_batch_lookup */
+
+/* Remove the identifiers which have not been written for
+ * CJNI_BATCH_EXPIRE_INTERVALS intervals from the index. Their ids are not
+ * reused.
+ * NOTE: You must hold b->lock when calling this function! */
+static void cjni_batch_expire(cjni_batch_t *b, cdtime_t now) /* {{{ */
+{
+  c_avl_iterator_t *iter;
+  char **expired = NULL;
+  size_t expired_num = 0;
+  char *key;
+  cjni_batch_entry_t *entry;
+
+  iter = c_avl_get_iterator(b->index);
+  if (iter == NULL)
+    return;
+
+  while (c_avl_iterator_next(iter, (void *)&key, (void *)&entry) == 0) {
+    char **tmp;
+
+    if (entry->last_write + CJNI_BATCH_EXPIRE_INTERVALS * entry->interval >
+        now)
+      continue;
+
+    tmp = realloc(expired, (expired_num + 1) * sizeof(*tmp));
+    if (tmp == NULL)
+      break;
+    expired = tmp;
+    expired[expired_num] = key;
+    expired_num++;
+  }
+  c_avl_iterator_destroy(iter);
+
+  for (size_t i = 0; i < expired_num; i++) {
+    if (c_avl_remove(b->index, expired[i], (void *)&key, (void *)&entry) != 0)
+      continue;
+    DEBUG("java plugin: cjni_batch_expire: Removing \"%s\" from the index.",
+          key);
+    sfree(key);
+    sfree(entry);
+  }
+  sfree(expired);
+} /* }}} void cjni_batch_expire */
+
+/* Add the values of `vl' to the batch. The JVM is only entered when the batch
+ * is full. */
+static int cjni_batch_write(const data_set_t *ds, /* {{{ */
+                            const value_list_t *vl, user_data_t *ud) {
+  cjni_batch_t *b;
+  cdtime_t now;
+  jint id;
+  int status = 0;
+
+  if ((ud == NULL) || (ud->data == NULL)) {
+    ERROR("java plugin: cjni_batch_write: Invalid user data.");
+    return -1;
+  }
+  b = ud->data;
+  now = cdtime();
+
+  pthread_mutex_lock(&b->lock);
+  if (b->next_expire <= now) {
+    cjni_batch_expire(b, now);
+    b->next_expire = now + vl->interval;
+  }
+
+  if (cjni_batch_lookup(b, ds, vl, now, &id) != 0) {
+    pthread_mutex_unlock(&b->lock);
+    ERROR("java plugin: cjni_batch_write: Unable to add \"%s\" to the batch.",
+          vl->type);
+    return -1;
+  }
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    if ((b->num == b->size) && (cjni_batch_send(b) != 0))
+      status = -1;
+    if (b->num == 0)
+      b->first = now;
+
+    b->ids[b->num] = id + (jint)i;
+    b->times[b->num] = (jlong)CDTIME_T_TO_MS(vl->time);
+    switch (ds->ds[i].type) {
+    case DS_TYPE_COUNTER:
+      b->values[b->num] = (jdouble)vl->values[i].counter;
+      break;
+    case DS_TYPE_GAUGE:
+      b->values[b->num] = (jdouble)vl->values[i].gauge;
+      break;
+    case DS_TYPE_DERIVE:
+      b->values[b->num] = (jdouble)vl->values[i].derive;
+      break;
+    case DS_TYPE_ABSOLUTE:
+      b->values[b->num] = (jdouble)vl->values[i].absolute;
+      break;
+    default:
+      b->values[b->num] = NAN;
+    }
+    b->num++;
+  }
+
+  if ((b->num == b->size) && (cjni_batch_send(b) != 0))
+    status = -1;
+  pthread_mutex_unlock(&b->lock);
+
+  return status;
+} /* }}} int cjni_batch_write */
+
+static int cjni_batch_flush(cdtime_t timeout, /* {{{ */
+                            const char __attribute__((unused)) * identifier,
+                            user_data_t *ud) {
+  cjni_batch_t *b;
+  int status = 0;
+
+  if ((ud == NULL) || (ud->data == NULL)) {
+    ERROR("java plugin: cjni_batch_flush: Invalid user data.");
+    return -1;
+  }
+  b = ud->data;
+
+  pthread_mutex_lock(&b->lock);
+  /* timeout == 0  => flush unconditionally */
+  if ((timeout == 0) || (b->first + timeout <= cdtime()))
+    status = cjni_batch_send(b);
+  pthread_mutex_unlock(&b->lock);
+
+  return status;
+} /* }}} int cjni_batch_flush */
+
+/* Free a `cjni_batch_t', passing remaining values to Java first if the JVM is
+ * still running. */
+static void cjni_batch_destroy(void *arg) /* {{{ */
+{
+  cjni_batch_t *b = arg;
+  void *key;
+  void *value;
+
+  if (b == NULL)
+    return;
+
+  if (jvm != NULL) {
+    JNIEnv *jvm_env;
+
+    pthread_mutex_lock(&b->lock);
+    cjni_batch_send(b);
+    pthread_mutex_unlock(&b->lock);
+
+    jvm_env = cjni_thread_attach();
+    if (jvm_env != NULL) {
+      if (b->o_ids != NULL)
+        (*jvm_env)->DeleteGlobalRef(jvm_env, b->o_ids);
+      if (b->o_times != NULL)
+        (*jvm_env)->DeleteGlobalRef(jvm_env, b->o_times);
+      if (b->o_values != NULL)
+        (*jvm_env)->DeleteGlobalRef(jvm_env, b->o_values);
+      cjni_thread_detach();
+    }
+  }
+
+  if (b->index != NULL) {
+    while (c_avl_pick(b->index, &key, &value) == 0) {
+      sfree(key);
+      sfree(value);
+    }
+    c_avl_destroy(b->index);
+  }
+
+  for (size_t i = 0; i < b->pending_num; i++)
+    sfree(b->pending[i]);
+  sfree(b->pending);
+  sfree(b->ids);
+  sfree(b->times);
+  sfree(b->values);
+
+  cjni_callback_info_destroy(b->cbi);
+  pthread_mutex_destroy(&b->lock);
+  sfree(b);
+} /* }}} void cjni_batch_destroy */
+
 /* Call the CB_TYPE_LOG callback pointed to by the `user_data_t' pointer. */
 static void cjni_log(int severity, const char *message, /* {{{ */
                      user_data_t *ud) {
@@ -2655,9 +3031,16 @@ static int cjni_match_target_invoke(const data_set_t *ds, /* {{{ */
 
   cbi = (cjni_callback_info_t *)*user_data;
 
+  if ((*jvm_env)->PushLocalFrame(jvm_env, CJNI_LOCAL_FRAME_SIZE) != 0) {
+    ERROR("java plugin: cjni_match_target_invoke: PushLocalFrame failed.");
+    cjni_thread_detach();
+    return -1;
+  }
+
   o_vl = ctoj_value_list(jvm_env, ds, vl);
   if (o_vl == NULL) {
     ERROR("java plugin: cjni_match_target_invoke: ctoj_value_list failed.");
+    (*jvm_env)->PopLocalFrame(jvm_env, NULL);
     cjni_thread_detach();
     return -1;
   }
@@ -2665,6 +3048,7 @@ static int cjni_match_target_invoke(const data_set_t *ds, /* {{{ */
   o_ds = ctoj_data_set(jvm_env, ds);
   if (o_ds == NULL) {
     ERROR("java plugin: cjni_match_target_invoke: ctoj_value_list failed.");
+    (*jvm_env)->PopLocalFrame(jvm_env, NULL);
     cjni_thread_detach();
     return -1;
   }
@@ -2696,6 +3080,8 @@ static int cjni_match_target_invoke(const data_set_t *ds, /* {{{ */
     }
   } /* if (cbi->type == CB_TYPE_TARGET) */
 
+  (*jvm_env)->PopLocalFrame(jvm_env, NULL);
+
   cjni_thread_detach();
   return ret_status;
 } /* }}} int cjni_match_target_invoke */
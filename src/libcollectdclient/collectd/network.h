@@ -53,13 +53,21 @@ typedef enum lcc_security_level_e lcc_security_level_t;
  * Create / destroy object
  */
 lcc_network_t *lcc_network_create(void);
+/* Sends the values buffered by the calling thread, then frees the object.
+ * With thread buffers, other threads have to call lcc_network_flush() before
+ * the object is destroyed; values they still buffer are dropped. */
 void lcc_network_destroy(lcc_network_t *net);
+/* Gives every thread its own network buffers, so that several threads may
+ * send values using the same object without locking. Buffered values are sent
+ * when a thread exits. Must be called before servers are added. */
+int lcc_network_enable_thread_buffers(lcc_network_t *net);
 
 /*
  * Add servers
  */
 lcc_server_t *lcc_server_create(lcc_network_t *net, const char *node,
                                 const char *service);
+/* Same as lcc_network_destroy(), for a single server. */
 int lcc_server_destroy(lcc_network_t *net, lcc_server_t *srv);
 
 /* Configure servers */
@@ -72,6 +80,14 @@ int lcc_server_set_security_level(lcc_server_t *srv, lcc_security_level_t level,
  * Send data
  */
 int lcc_network_values_send(lcc_network_t *net, const lcc_value_list_t *vl);
+/* Adds "vl_num" value lists to the network buffers. Full packets are sent
+ * together, using a single system call where possible; the remainder stays
+ * buffered like with lcc_network_values_send(). */
+int lcc_network_values_send_batch(lcc_network_t *net,
+                                  const lcc_value_list_t *vl, size_t vl_num);
+/* Sends the values buffered by lcc_network_values_send() right away. With
+ * thread buffers, only the calling thread's buffers are sent. */
+int lcc_network_flush(lcc_network_t *net);
 #if 0
 int lcc_network_notification_send (lcc_network_t *net,
     const lcc_notification_t *notif);
@@ -26,10 +26,15 @@
  *   Max Henkel <henkel at gmx.at>
  **/
 
+/* _GNU_SOURCE is needed in Linux to use sendmmsg */
+#define _GNU_SOURCE
+
 #include "collectd.h"
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -54,11 +59,34 @@
 #include "collectd/network.h"
 #include "collectd/network_buffer.h"
 
+/* Number of packets sent with a single sendmmsg(2) call by
+ * lcc_network_values_send_batch(). */
+#define SEND_BATCH_SIZE 32
+
 /*
  * Private data types
  */
 struct lcc_network_s {
   lcc_server_t *servers;
+  bool thread_buffers;
+};
+
+/* The network buffer of a server and the packets which have been finalized
+ * but not yet sent. With thread buffers enabled, every thread has one of
+ * these per server. */
+struct server_buffer_s;
+typedef struct server_buffer_s server_buffer_t;
+struct server_buffer_s {
+  lcc_server_t *srv;
+
+  lcc_network_buffer_t *buffer;
+  size_t buffer_values; /* number of value lists in "buffer" */
+
+  char *packets; /* SEND_BATCH_SIZE packets of the default buffer size */
+  size_t packets_size[SEND_BATCH_SIZE];
+  size_t packets_num;
+
+  server_buffer_t *next;
 };
 
 struct lcc_server_s {
@@ -70,11 +98,18 @@ struct lcc_server_s {
   char *username;
   char *password;
 
+  /* "lock" protects the socket while it is being opened, and the list of
+   * thread buffers. */
+  pthread_mutex_t lock;
   int fd;
   struct sockaddr *sa;
   socklen_t sa_len;
 
-  lcc_network_buffer_t *buffer;
+  server_buffer_t *buffer;
+
+  bool thread_buffers;
+  pthread_key_t buffer_key;
+  server_buffer_t *buffers; /* all thread buffers */
 
   lcc_server_t *next;
 };
@@ -99,25 +134,46 @@ static int server_close_socket(lcc_server_t *srv) /* {{{ */
   return 0;
 } /* }}} int server_close_socket */
 
-static void int_server_destroy(lcc_server_t *srv) /* {{{ */
+static server_buffer_t *server_buffer_create(lcc_server_t *srv) /* {{{ */
 {
-  lcc_server_t *next;
+  server_buffer_t *sb = calloc(1, sizeof(*sb));
+  if (sb == NULL)
+    return NULL;
 
-  if (srv == NULL)
-    return;
+  sb->srv = srv;
+  sb->buffer = lcc_network_buffer_create(/* size = */ 0);
+  sb->packets = calloc(SEND_BATCH_SIZE, LCC_NETWORK_BUFFER_SIZE_DEFAULT);
+  if ((sb->buffer == NULL) || (sb->packets == NULL)) {
+    lcc_network_buffer_destroy(sb->buffer);
+    free(sb->packets);
+    free(sb);
+    return NULL;
+  }
 
-  server_close_socket(srv);
+  if (srv->security_level != NONE) {
+    int status = lcc_network_buffer_set_security_level(
+        sb->buffer, srv->security_level, srv->username, srv->password);
+    if (status != 0) {
+      lcc_network_buffer_destroy(sb->buffer);
+      free(sb->packets);
+      free(sb);
+      errno = status;
+      return NULL;
+    }
+  }
 
-  next = srv->next;
+  return sb;
+} /* }}} server_buffer_t *server_buffer_create */
 
-  free(srv->node);
-  free(srv->service);
-  free(srv->username);
-  free(srv->password);
-  free(srv);
+static void server_buffer_destroy(server_buffer_t *sb) /* {{{ */
+{
+  if (sb == NULL)
+    return;
 
-  int_server_destroy(next);
-} /* }}} void int_server_destroy */
+  lcc_network_buffer_destroy(sb->buffer);
+  free(sb->packets);
+  free(sb);
+} /* }}} void server_buffer_destroy */
 
 static int server_open_socket(lcc_server_t *srv) /* {{{ */
 {
@@ -146,7 +202,11 @@ static int server_open_socket(lcc_server_t *srv) /* {{{ */
     if (srv->fd < 0)
       continue;
 
-    if (ai_ptr->ai_family == AF_INET) {
+    /* A TTL of zero means the system default. */
+    status = 0;
+    if (srv->ttl == 0) {
+      /* nop */
+    } else if (ai_ptr->ai_family == AF_INET) {
       struct sockaddr_in *addr = (struct sockaddr_in *)ai_ptr->ai_addr;
       int optname;
 
@@ -197,63 +257,232 @@ static int server_open_socket(lcc_server_t *srv) /* {{{ */
   return 0;
 } /* }}} int server_open_socket */
 
-static int server_send_buffer(lcc_server_t *srv) /* {{{ */
+/* Opens the socket if necessary. Once this succeeded, "fd" and "sa" don't
+ * change anymore and may be used without holding the lock. */
+static int server_get_socket(lcc_server_t *srv) /* {{{ */
 {
-  char buffer[LCC_NETWORK_BUFFER_SIZE_DEFAULT] = {0};
-  size_t buffer_size;
-  int status;
+  int status = 0;
 
-  if (srv->fd < 0) {
+  pthread_mutex_lock(&srv->lock);
+  if (srv->fd < 0)
     status = server_open_socket(srv);
-    if (status != 0)
-      return status;
-  }
+  pthread_mutex_unlock(&srv->lock);
 
-  buffer_size = sizeof(buffer);
+  return status;
+} /* }}} int server_get_socket */
 
-  status = lcc_network_buffer_finalize(srv->buffer);
-  if (status != 0) {
-    lcc_network_buffer_initialize(srv->buffer);
-    return status;
+/* Moves the content of the network buffer to the list of packets to send. */
+static int server_queue_buffer(server_buffer_t *sb) /* {{{ */
+{
+  assert(sb->packets_num < SEND_BATCH_SIZE);
+
+  int status = lcc_network_buffer_finalize(sb->buffer);
+  if (status == 0) {
+    size_t size = LCC_NETWORK_BUFFER_SIZE_DEFAULT;
+    status = lcc_network_buffer_get(
+        sb->buffer,
+        sb->packets + sb->packets_num * LCC_NETWORK_BUFFER_SIZE_DEFAULT,
+        &size);
+    if (size > LCC_NETWORK_BUFFER_SIZE_DEFAULT)
+      size = LCC_NETWORK_BUFFER_SIZE_DEFAULT;
+    if (status == 0)
+      sb->packets_size[sb->packets_num++] = size;
   }
 
-  status = lcc_network_buffer_get(srv->buffer, buffer, &buffer_size);
-  lcc_network_buffer_initialize(srv->buffer);
+  lcc_network_buffer_initialize(sb->buffer);
+  sb->buffer_values = 0;
+  return status;
+} /* }}} int server_queue_buffer */
 
+static int server_send_packets(server_buffer_t *sb) /* {{{ */
+{
+  lcc_server_t *srv = sb->srv;
+  size_t packets_num = sb->packets_num;
+  int status;
+
+  sb->packets_num = 0;
+  if (packets_num == 0)
+    return 0;
+
+  status = server_get_socket(srv);
   if (status != 0)
     return status;
 
-  if (buffer_size > sizeof(buffer))
-    buffer_size = sizeof(buffer);
+  assert(srv->fd >= 0);
+  assert(srv->sa != NULL);
+
+#if HAVE_SENDMMSG
+  struct iovec iov[SEND_BATCH_SIZE];
+  struct mmsghdr msgs[SEND_BATCH_SIZE];
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < packets_num; i++) {
+    iov[i].iov_base = sb->packets + i * LCC_NETWORK_BUFFER_SIZE_DEFAULT;
+    iov[i].iov_len = sb->packets_size[i];
+    msgs[i].msg_hdr.msg_name = srv->sa;
+    msgs[i].msg_hdr.msg_namelen = srv->sa_len;
+    msgs[i].msg_hdr.msg_iov = iov + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
 
-  while (42) {
-    assert(srv->fd >= 0);
-    assert(srv->sa != NULL);
-    status = (int)sendto(srv->fd, buffer, buffer_size, /* flags = */ 0, srv->sa,
-                         srv->sa_len);
+  size_t sent = 0;
+  while (sent < packets_num) {
+    status = sendmmsg(srv->fd, msgs + sent, (unsigned int)(packets_num - sent),
+                      /* flags = */ 0);
     if ((status < 0) && ((errno == EINTR) || (errno == EAGAIN)))
       continue;
+    if (status < 0)
+      return status;
 
-    break;
+    sent += (size_t)status;
+  }
+#else
+  for (size_t i = 0; i < packets_num; i++) {
+    while (42) {
+      status = (int)sendto(
+          srv->fd, sb->packets + i * LCC_NETWORK_BUFFER_SIZE_DEFAULT,
+          sb->packets_size[i], /* flags = */ 0, srv->sa, srv->sa_len);
+      if ((status < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+        continue;
+
+      break;
+    }
+
+    if (status < 0)
+      return status;
   }
+#endif
 
-  if (status < 0)
-    return status;
   return 0;
+} /* }}} int server_send_packets */
+
+static int server_send_buffer(server_buffer_t *sb) /* {{{ */
+{
+  int status = server_queue_buffer(sb);
+  int send_status = server_send_packets(sb);
+
+  return (status != 0) ? status : send_status;
 } /* }}} int server_send_buffer */
 
-static int server_value_add(lcc_server_t *srv, /* {{{ */
-                            const lcc_value_list_t *vl) {
+/* Sends the values and packets buffered in "sb". */
+static int server_buffer_flush(server_buffer_t *sb) /* {{{ */
+{
+  if (sb->buffer_values > 0)
+    return server_send_buffer(sb);
+  return server_send_packets(sb);
+} /* }}} int server_buffer_flush */
+
+/* Adds "vl" to the network buffer. When the buffer is full, it is sent right
+ * away, or, if "batch" is true, queued until SEND_BATCH_SIZE packets have
+ * accumulated. */
+static int server_value_add(server_buffer_t *sb, /* {{{ */
+                            const lcc_value_list_t *vl, bool batch) {
   int status;
 
-  status = lcc_network_buffer_add_value(srv->buffer, vl);
-  if (status == 0)
+  status = lcc_network_buffer_add_value(sb->buffer, vl);
+  if (status == 0) {
+    sb->buffer_values++;
     return 0;
+  }
+
+  int queue_status = server_queue_buffer(sb);
+  int send_status = 0;
+  if (!batch || (sb->packets_num == SEND_BATCH_SIZE))
+    send_status = server_send_packets(sb);
+
+  status = lcc_network_buffer_add_value(sb->buffer, vl);
+  if (status != 0)
+    return status;
 
-  server_send_buffer(srv);
-  return lcc_network_buffer_add_value(srv->buffer, vl);
+  sb->buffer_values++;
+  return (queue_status != 0) ? queue_status : send_status;
 } /* }}} int server_value_add */
 
+/* Flushes and frees a thread buffer when its thread exits. */
+static void server_buffer_release(void *arg) /* {{{ */
+{
+  server_buffer_t *sb = arg;
+  lcc_server_t *srv = sb->srv;
+
+  server_buffer_flush(sb);
+
+  pthread_mutex_lock(&srv->lock);
+  for (server_buffer_t **ptr = &srv->buffers; *ptr != NULL;
+       ptr = &(*ptr)->next) {
+    if (*ptr == sb) {
+      *ptr = sb->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&srv->lock);
+
+  server_buffer_destroy(sb);
+} /* }}} void server_buffer_release */
+
+/* Returns the calling thread's buffer for "srv". If "create" is false and the
+ * thread has not used the server yet, NULL is returned. */
+static server_buffer_t *server_get_buffer(lcc_server_t *srv, /* {{{ */
+                                          bool create) {
+  if (!srv->thread_buffers)
+    return srv->buffer;
+
+  server_buffer_t *sb = pthread_getspecific(srv->buffer_key);
+  if ((sb != NULL) || !create)
+    return sb;
+
+  sb = server_buffer_create(srv);
+  if (sb == NULL)
+    return NULL;
+
+  if (pthread_setspecific(srv->buffer_key, sb) != 0) {
+    server_buffer_destroy(sb);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&srv->lock);
+  sb->next = srv->buffers;
+  srv->buffers = sb;
+  pthread_mutex_unlock(&srv->lock);
+
+  return sb;
+} /* }}} server_buffer_t *server_get_buffer */
+
+static void int_server_destroy(lcc_server_t *srv) /* {{{ */
+{
+  lcc_server_t *next;
+
+  if (srv == NULL)
+    return;
+
+  /* Only the calling thread's buffer can be sent: other threads may still be
+   * using theirs. Their values are dropped unless they flushed them. */
+  server_buffer_t *sb = server_get_buffer(srv, /* create = */ false);
+  if (sb != NULL)
+    server_buffer_flush(sb);
+
+  server_close_socket(srv);
+
+  next = srv->next;
+
+  if (srv->thread_buffers) {
+    pthread_key_delete(srv->buffer_key);
+    while (srv->buffers != NULL) {
+      sb = srv->buffers;
+      srv->buffers = sb->next;
+      server_buffer_destroy(sb);
+    }
+  }
+  server_buffer_destroy(srv->buffer);
+  pthread_mutex_destroy(&srv->lock);
+
+  free(srv->node);
+  free(srv->service);
+  free(srv->username);
+  free(srv->password);
+  free(srv);
+
+  int_server_destroy(next);
+} /* }}} void int_server_destroy */
+
 /*
  * Public functions
  */
@@ -270,6 +499,17 @@ lcc_network_t *lcc_network_create(void) /* {{{ */
   return net;
 } /* }}} lcc_network_t *lcc_network_create */
 
+int lcc_network_enable_thread_buffers(lcc_network_t *net) /* {{{ */
+{
+  if (net == NULL)
+    return EINVAL;
+  if (net->servers != NULL)
+    return EBUSY;
+
+  net->thread_buffers = true;
+  return 0;
+} /* }}} int lcc_network_enable_thread_buffers */
+
 void lcc_network_destroy(lcc_network_t *net) /* {{{ */
 {
   if (net == NULL)
@@ -310,13 +550,24 @@ lcc_server_t *lcc_server_create(lcc_network_t *net, /* {{{ */
     return NULL;
   }
 
-  srv->buffer = lcc_network_buffer_create(/* size = */ 0);
-  if (srv->buffer == NULL) {
-    free(srv->service);
-    free(srv->node);
-    free(srv);
-    return NULL;
+  if (net->thread_buffers) {
+    if (pthread_key_create(&srv->buffer_key, server_buffer_release) != 0) {
+      free(srv->service);
+      free(srv->node);
+      free(srv);
+      return NULL;
+    }
+    srv->thread_buffers = true;
+  } else {
+    srv->buffer = server_buffer_create(srv);
+    if (srv->buffer == NULL) {
+      free(srv->service);
+      free(srv->node);
+      free(srv);
+      return NULL;
+    }
   }
+  pthread_mutex_init(&srv->lock, /* attr = */ NULL);
 
   if (net->servers == NULL) {
     net->servers = srv;
@@ -436,8 +687,35 @@ int lcc_server_set_interface(lcc_server_t *srv, char const *iface) /* {{{ */
 int lcc_server_set_security_level(lcc_server_t *srv, /* {{{ */
                                   lcc_security_level_t level,
                                   const char *username, const char *password) {
-  return lcc_network_buffer_set_security_level(srv->buffer, level, username,
-                                               password);
+  if (srv == NULL)
+    return EINVAL;
+
+  /* Thread buffers pick up the settings when they are created. */
+  if (!srv->thread_buffers) {
+    int status = lcc_network_buffer_set_security_level(
+        srv->buffer->buffer, level, username, password);
+    if (status != 0)
+      return status;
+  }
+
+  char *username_copy = NULL;
+  char *password_copy = NULL;
+  if (level != NONE) {
+    username_copy = strdup(username);
+    password_copy = strdup(password);
+    if ((username_copy == NULL) || (password_copy == NULL)) {
+      free(username_copy);
+      free(password_copy);
+      return ENOMEM;
+    }
+  }
+
+  free(srv->username);
+  free(srv->password);
+  srv->username = username_copy;
+  srv->password = password_copy;
+  srv->security_level = level;
+  return 0;
 } /* }}} int lcc_server_set_security_level */
 
 int lcc_network_values_send(lcc_network_t *net, /* {{{ */
@@ -445,8 +723,66 @@ int lcc_network_values_send(lcc_network_t *net, /* {{{ */
   if ((net == NULL) || (vl == NULL))
     return EINVAL;
 
-  for (lcc_server_t *srv = net->servers; srv != NULL; srv = srv->next)
-    server_value_add(srv, vl);
+  int status = 0;
+  for (lcc_server_t *srv = net->servers; srv != NULL; srv = srv->next) {
+    server_buffer_t *sb = server_get_buffer(srv, /* create = */ true);
+    if (sb == NULL) {
+      status = ENOMEM;
+      continue;
+    }
 
-  return 0;
+    int tmp = server_value_add(sb, vl, /* batch = */ false);
+    if (tmp != 0)
+      status = tmp;
+  }
+
+  return status;
 } /* }}} int lcc_network_values_send */
+
+int lcc_network_values_send_batch(lcc_network_t *net, /* {{{ */
+                                  const lcc_value_list_t *vl, size_t vl_num) {
+  int status = 0;
+
+  if ((net == NULL) || ((vl == NULL) && (vl_num > 0)))
+    return EINVAL;
+
+  for (lcc_server_t *srv = net->servers; srv != NULL; srv = srv->next) {
+    server_buffer_t *sb = server_get_buffer(srv, /* create = */ true);
+    if (sb == NULL) {
+      status = ENOMEM;
+      continue;
+    }
+
+    for (size_t i = 0; i < vl_num; i++) {
+      int tmp = server_value_add(sb, vl + i, /* batch = */ true);
+      if (tmp != 0)
+        status = tmp;
+    }
+
+    int tmp = server_send_packets(sb);
+    if (tmp != 0)
+      status = tmp;
+  }
+
+  return status;
+} /* }}} int lcc_network_values_send_batch */
+
+int lcc_network_flush(lcc_network_t *net) /* {{{ */
+{
+  int status = 0;
+
+  if (net == NULL)
+    return EINVAL;
+
+  for (lcc_server_t *srv = net->servers; srv != NULL; srv = srv->next) {
+    server_buffer_t *sb = server_get_buffer(srv, /* create = */ false);
+    if (sb == NULL)
+      continue;
+
+    int tmp = server_buffer_flush(sb);
+    if (tmp != 0)
+      status = tmp;
+  }
+
+  return status;
+} /* }}} int lcc_network_flush */
@@ -0,0 +1,246 @@
+/**
+ * collectd - src/libcollectdclient/network_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+
+#include "collectd/network.h"
+#include "collectd/network_buffer.h"
+#include "collectd/network_parse.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+
+#define VALUES_NUM 1000
+#define THREADS_NUM 4
+
+static int recv_fd = -1;
+static char recv_port[16];
+
+static lcc_value_list_t values[VALUES_NUM];
+static value_t values_data[VALUES_NUM];
+static int values_types[VALUES_NUM];
+
+static int received;
+static char received_last[LCC_NAME_LEN];
+
+static int count_value_list(lcc_value_list_t const *vl) {
+  received++;
+  snprintf(received_last, sizeof(received_last), "%s",
+           vl->identifier.type_instance);
+  return 0;
+}
+
+static int open_receiver(void) {
+  recv_fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (recv_fd < 0)
+    return -1;
+
+  int rcvbuf = 4 * 1024 * 1024;
+  setsockopt(recv_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t sa_len = sizeof(sa);
+  if ((bind(recv_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (getsockname(recv_fd, (struct sockaddr *)&sa, &sa_len) != 0))
+    return -1;
+
+  snprintf(recv_port, sizeof(recv_port), "%u", ntohs(sa.sin_port));
+  return 0;
+}
+
+/* Receives packets until none arrived for 100 ms and returns the number of
+ * packets. The value lists are added to "received". */
+static int receive_all(void) {
+  lcc_network_parse_options_t opts = {.writer = count_value_list};
+  char buffer[LCC_NETWORK_BUFFER_SIZE_DEFAULT];
+  struct pollfd pfd = {.fd = recv_fd, .events = POLLIN};
+  int packets = 0;
+
+  while (poll(&pfd, 1, /* timeout = */ 100) > 0) {
+    ssize_t len = recv(recv_fd, buffer, sizeof(buffer), 0);
+    if (len <= 0)
+      break;
+
+    packets++;
+    lcc_network_parse(buffer, (size_t)len, opts);
+  }
+
+  return packets;
+}
+
+static lcc_network_t *network_create(bool thread_buffers) {
+  lcc_network_t *net = lcc_network_create();
+  if (net == NULL)
+    return NULL;
+
+  if (thread_buffers && (lcc_network_enable_thread_buffers(net) != 0)) {
+    lcc_network_destroy(net);
+    return NULL;
+  }
+
+  if (lcc_server_create(net, "127.0.0.1", recv_port) == NULL) {
+    lcc_network_destroy(net);
+    return NULL;
+  }
+
+  return net;
+}
+
+static void fill_values(void) {
+  for (int i = 0; i < VALUES_NUM; i++) {
+    lcc_value_list_t *vl = values + i;
+
+    values_data[i].gauge = (gauge_t)i;
+    values_types[i] = LCC_TYPE_GAUGE;
+    *vl = (lcc_value_list_t)LCC_VALUE_LIST_INIT;
+    vl->values = values_data + i;
+    vl->values_types = values_types + i;
+    vl->values_len = 1;
+    vl->time = 1.0;
+    vl->interval = 10.0;
+    snprintf(vl->identifier.host, sizeof(vl->identifier.host), "example.com");
+    snprintf(vl->identifier.plugin, sizeof(vl->identifier.plugin), "test");
+    snprintf(vl->identifier.type, sizeof(vl->identifier.type), "gauge");
+    snprintf(vl->identifier.type_instance,
+             sizeof(vl->identifier.type_instance), "%d", i);
+  }
+}
+
+DEF_TEST(send_batch) {
+  lcc_network_t *net;
+  CHECK_NOT_NULL(net = network_create(false));
+
+  received = 0;
+  CHECK_ZERO(lcc_network_values_send_batch(net, values, VALUES_NUM));
+  OK(receive_all() > 1);
+  OK(received < VALUES_NUM);
+
+  /* The partially filled packet is sent on flush. */
+  CHECK_ZERO(lcc_network_flush(net));
+  EXPECT_EQ_INT(1, receive_all());
+  EXPECT_EQ_INT(VALUES_NUM, received);
+  EXPECT_EQ_STR("999", received_last);
+
+  /* Mixing both APIs keeps the order. */
+  received = 0;
+  CHECK_ZERO(lcc_network_values_send(net, values));
+  CHECK_ZERO(lcc_network_values_send_batch(net, values + 1, 2));
+  CHECK_ZERO(lcc_network_flush(net));
+  EXPECT_EQ_INT(1, receive_all());
+  EXPECT_EQ_INT(3, received);
+  EXPECT_EQ_STR("2", received_last);
+
+  CHECK_ZERO(lcc_network_values_send_batch(net, NULL, 0));
+  OK(lcc_network_values_send_batch(net, NULL, 1) == EINVAL);
+
+  /* Buffered values are sent when the object is destroyed. */
+  received = 0;
+  CHECK_ZERO(lcc_network_values_send(net, values));
+  lcc_network_destroy(net);
+  EXPECT_EQ_INT(1, receive_all());
+  EXPECT_EQ_INT(1, received);
+  return 0;
+}
+
+DEF_TEST(send_error) {
+  lcc_network_t *net;
+  CHECK_NOT_NULL(net = lcc_network_create());
+  CHECK_NOT_NULL(lcc_server_create(net, "127.0.0.1", "no-such-service"));
+
+  /* The address can't be resolved, so sending the first full packet
+   * fails. */
+  int status = 0;
+  for (int i = 0; (i < VALUES_NUM) && (status == 0); i++)
+    status = lcc_network_values_send(net, values + i);
+  OK(status != 0);
+  OK(lcc_network_values_send_batch(net, values, VALUES_NUM) != 0);
+
+  lcc_network_destroy(net);
+  return 0;
+}
+
+static void *send_thread(void *arg) {
+  lcc_network_t *net = arg;
+  static int next;
+  static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+
+  pthread_mutex_lock(&next_lock);
+  int begin = next;
+  next += VALUES_NUM / THREADS_NUM;
+  pthread_mutex_unlock(&next_lock);
+
+  /* Values left in the buffer are sent when the thread exits. */
+  for (int i = begin; i < begin + VALUES_NUM / THREADS_NUM; i++)
+    lcc_network_values_send(net, values + i);
+
+  return NULL;
+}
+
+DEF_TEST(thread_buffers) {
+  lcc_network_t *net;
+  CHECK_NOT_NULL(net = network_create(false));
+  EXPECT_EQ_INT(EBUSY, lcc_network_enable_thread_buffers(net));
+  lcc_network_destroy(net);
+
+  CHECK_NOT_NULL(net = network_create(true));
+
+  pthread_t threads[THREADS_NUM];
+  for (int i = 0; i < THREADS_NUM; i++)
+    CHECK_ZERO(pthread_create(threads + i, NULL, send_thread, net));
+  for (int i = 0; i < THREADS_NUM; i++)
+    CHECK_ZERO(pthread_join(threads[i], NULL));
+
+  received = 0;
+  receive_all();
+  EXPECT_EQ_INT(VALUES_NUM, received);
+
+  /* Nothing is buffered for this thread. */
+  CHECK_ZERO(lcc_network_flush(net));
+  EXPECT_EQ_INT(0, receive_all());
+
+  /* This thread's buffer is sent when the object is destroyed. */
+  received = 0;
+  CHECK_ZERO(lcc_network_values_send(net, values));
+  lcc_network_destroy(net);
+  EXPECT_EQ_INT(1, receive_all());
+  EXPECT_EQ_INT(1, received);
+  return 0;
+}
+
+int main(void) {
+  CHECK_ZERO(open_receiver());
+  fill_values();
+
+  RUN_TEST(send_batch);
+  RUN_TEST(send_error);
+  RUN_TEST(thread_buffers);
+
+  close(recv_fd);
+  END_TEST;
+}
@@ -13,4 +13,16 @@ struct argument_list_s {
 };
 typedef struct argument_list_s argument_list_t;
 
+/* State of a single parser run, shared by the parser and the scanner. */
+struct parser_state_s {
+  oconfig_item_t *ci_root;
+  const char *file;
+
+  /* multiline string buffer */
+  char *ml_buffer;
+  size_t ml_pos;
+  size_t ml_len;
+};
+typedef struct parser_state_s parser_state_t;
+
 #endif /* AUX_TYPES_H */
@@ -31,66 +31,70 @@
 #include <string.h>
 
 #include "oconfig.h"
+#include "aux_types.h"
 
-extern FILE *yyin;
-extern int yyparse(void);
+/* The scanner and parser are reentrant: all state of a run is kept in the
+ * scanner handle and in a parser_state_t, so that different threads may
+ * parse files at the same time. */
+extern int yylex_init_extra(parser_state_t *state, void **scanner);
+extern void yyset_in(FILE *fh, void *scanner);
+extern int yylex_destroy(void *scanner);
+extern int yyparse(void *scanner, parser_state_t *state);
 
-oconfig_item_t *ci_root;
-const char *c_file;
-
-static void yyset_in(FILE *fd) { yyin = fd; } /* void yyset_in */
-
-static oconfig_item_t *oconfig_parse_fh(FILE *fh) {
+static oconfig_item_t *oconfig_parse_fh(FILE *fh, const char *file) {
   int status;
-  oconfig_item_t *ret;
+  void *scanner;
 
-  char file[10];
+  parser_state_t state = {
+      .file = file,
+  };
 
-  yyset_in(fh);
+  char name[10];
 
-  if (NULL == c_file) {
-    status = snprintf(file, sizeof(file), "<fd#%d>", fileno(fh));
+  if (NULL == state.file) {
+    status = snprintf(name, sizeof(name), "<fd#%d>", fileno(fh));
 
-    if ((status < 0) || (((size_t)status) >= sizeof(file))) {
-      c_file = "<unknown>";
+    if ((status < 0) || (((size_t)status) >= sizeof(name))) {
+      state.file = "<unknown>";
     } else {
-      file[sizeof(file) - 1] = '\0';
-      c_file = file;
+      name[sizeof(name) - 1] = '\0';
+      state.file = name;
     }
   }
 
-  status = yyparse();
-  if (status != 0) {
-    fprintf(stderr, "yyparse returned error #%i\n", status);
+  if (yylex_init_extra(&state, &scanner) != 0) {
+    fprintf(stderr, "yylex_init_extra failed: %s\n", strerror(errno));
     return NULL;
   }
+  yyset_in(fh, scanner);
 
-  c_file = NULL;
+  status = yyparse(scanner, &state);
 
-  ret = ci_root;
-  ci_root = NULL;
-  yyset_in((FILE *)0);
+  yylex_destroy(scanner);
+  free(state.ml_buffer);
 
-  return ret;
+  if (status != 0) {
+    fprintf(stderr, "yyparse returned error #%i\n", status);
+    oconfig_free(state.ci_root);
+    return NULL;
+  }
+
+  return state.ci_root;
 } /* oconfig_item_t *oconfig_parse_fh */
 
 oconfig_item_t *oconfig_parse_file(const char *file) {
   FILE *fh;
   oconfig_item_t *ret;
 
-  c_file = file;
-
   fh = fopen(file, "r");
   if (fh == NULL) {
     fprintf(stderr, "fopen (%s) failed: %s\n", file, strerror(errno));
     return NULL;
   }
 
-  ret = oconfig_parse_fh(fh);
+  ret = oconfig_parse_fh(fh, file);
   fclose(fh);
 
-  c_file = NULL;
-
   return ret;
 } /* oconfig_item_t *oconfig_parse_file */
 
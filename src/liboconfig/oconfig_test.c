@@ -0,0 +1,209 @@
+/**
+ * collectd - src/liboconfig/oconfig_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "liboconfig/oconfig.h"
+#include "testing.h"
+
+#include <pthread.h>
+
+#define BLOCKS_NUM 200
+#define THREADS_NUM 4
+#define ROUNDS_NUM 20
+
+static char tmp_dir[] = "/tmp/oconfig_test.XXXXXX";
+
+/* Two configurations with a different structure, and one with a syntax
+ * error. */
+static char file_a[PATH_MAX];
+static char file_b[PATH_MAX];
+static char file_err[PATH_MAX];
+
+static int write_configs(void) {
+  FILE *fh;
+
+  snprintf(file_a, sizeof(file_a), "%s/a.conf", tmp_dir);
+  fh = fopen(file_a, "w");
+  if (fh == NULL)
+    return -1;
+  for (int i = 0; i < BLOCKS_NUM; i++)
+    fprintf(fh,
+            "# block %d\n"
+            "<Plugin \"a%d\">\n"
+            "  Name \"first \\\n"
+            "        second\" %d true\n"
+            "</Plugin>\n",
+            i, i, i);
+  fclose(fh);
+
+  snprintf(file_b, sizeof(file_b), "%s/b.conf", tmp_dir);
+  fh = fopen(file_b, "w");
+  if (fh == NULL)
+    return -1;
+  for (int i = 0; i < BLOCKS_NUM; i++)
+    fprintf(fh, "Option%d %d\n", i, -i);
+  fclose(fh);
+
+  snprintf(file_err, sizeof(file_err), "%s/err.conf", tmp_dir);
+  fh = fopen(file_err, "w");
+  if (fh == NULL)
+    return -1;
+  fprintf(fh, "<Plugin \"err\">\n  Name \"value\"\n");
+  fclose(fh);
+
+  return 0;
+}
+
+/* Returns the number of differences between "ci" and the contents of
+ * "file_a". */
+static int check_a(oconfig_item_t *ci) {
+  int errors = 0;
+
+  if ((ci == NULL) || (ci->children_num != BLOCKS_NUM))
+    return 1;
+
+  for (int i = 0; i < BLOCKS_NUM; i++) {
+    oconfig_item_t *block = ci->children + i;
+    char name[32];
+
+    snprintf(name, sizeof(name), "a%d", i);
+    if ((strcmp("Plugin", block->key) != 0) || (block->values_num != 1) ||
+        (block->values[0].type != OCONFIG_TYPE_STRING) ||
+        (strcmp(name, block->values[0].value.string) != 0) ||
+        (block->children_num != 1)) {
+      errors++;
+      continue;
+    }
+
+    oconfig_item_t *child = block->children;
+    if ((strcmp("Name", child->key) != 0) || (child->values_num != 3) ||
+        (child->values[0].type != OCONFIG_TYPE_STRING) ||
+        (strcmp("first second", child->values[0].value.string) != 0) ||
+        (child->values[1].type != OCONFIG_TYPE_NUMBER) ||
+        (child->values[1].value.number != (double)i) ||
+        (child->values[2].type != OCONFIG_TYPE_BOOLEAN) ||
+        !child->values[2].value.boolean)
+      errors++;
+  }
+
+  return errors;
+}
+
+/* Returns the number of differences between "ci" and the contents of
+ * "file_b". */
+static int check_b(oconfig_item_t *ci) {
+  int errors = 0;
+
+  if ((ci == NULL) || (ci->children_num != BLOCKS_NUM))
+    return 1;
+
+  for (int i = 0; i < BLOCKS_NUM; i++) {
+    oconfig_item_t *option = ci->children + i;
+    char key[32];
+
+    snprintf(key, sizeof(key), "Option%d", i);
+    if ((strcmp(key, option->key) != 0) || (option->values_num != 1) ||
+        (option->values[0].type != OCONFIG_TYPE_NUMBER) ||
+        (option->values[0].value.number != (double)-i) ||
+        (option->children_num != 0))
+      errors++;
+  }
+
+  return errors;
+}
+
+/* Parses all three files, in a different order in each thread. Returns the
+ * number of errors, cast to a pointer. */
+static void *parse_thread(void *arg) {
+  intptr_t offset = (intptr_t)arg;
+  intptr_t errors = 0;
+
+  for (intptr_t i = 0; i < 3 * ROUNDS_NUM; i++) {
+    oconfig_item_t *ci;
+
+    switch ((i + offset) % 3) {
+    case 0:
+      ci = oconfig_parse_file(file_a);
+      errors += check_a(ci);
+      break;
+    case 1:
+      ci = oconfig_parse_file(file_b);
+      errors += check_b(ci);
+      break;
+    default:
+      ci = oconfig_parse_file(file_err);
+      errors += (ci != NULL);
+      break;
+    }
+
+    if (ci != NULL)
+      oconfig_free(ci);
+  }
+
+  return (void *)errors;
+}
+
+DEF_TEST(parse) {
+  oconfig_item_t *ci;
+
+  CHECK_NOT_NULL(ci = oconfig_parse_file(file_a));
+  EXPECT_EQ_INT(0, check_a(ci));
+  oconfig_free(ci);
+
+  CHECK_NOT_NULL(ci = oconfig_parse_file(file_b));
+  EXPECT_EQ_INT(0, check_b(ci));
+  oconfig_free(ci);
+
+  EXPECT_EQ_PTR(NULL, oconfig_parse_file(file_err));
+  return 0;
+}
+
+DEF_TEST(parse_concurrently) {
+  pthread_t threads[THREADS_NUM];
+
+  for (intptr_t i = 0; i < THREADS_NUM; i++)
+    CHECK_ZERO(pthread_create(threads + i, NULL, parse_thread, (void *)i));
+
+  for (size_t i = 0; i < THREADS_NUM; i++) {
+    void *errors = NULL;
+
+    CHECK_ZERO(pthread_join(threads[i], &errors));
+    EXPECT_EQ_INT(0, (int)(intptr_t)errors);
+  }
+
+  return 0;
+}
+
+int main(void) {
+  CHECK_NOT_NULL(mkdtemp(tmp_dir));
+  CHECK_ZERO(write_configs());
+
+  RUN_TEST(parse);
+  RUN_TEST(parse_concurrently);
+
+  unlink(file_a);
+  unlink(file_b);
+  unlink(file_err);
+  rmdir(tmp_dir);
+  END_TEST;
+}
@@ -31,17 +31,18 @@
 #include "aux_types.h"
 
 static char *unquote (const char *orig);
-static void yyerror(const char *s);
+static void yyerror(void *scanner, parser_state_t *state, const char *s);
 
-/* Lexer variables */
-extern int yylineno;
-extern char *yytext;
-extern int yylex (void);
-
-extern oconfig_item_t *ci_root;
-extern char           *c_file;
+/* Lexer functions, see scanner.l */
+extern int yyget_lineno (void *scanner);
+extern char *yyget_text (void *scanner);
 %}
 
+%define api.pure
+%parse-param {void *scanner}
+%parse-param {parser_state_t *state}
+%lex-param {void *scanner}
+
 %start entire_file
 
 %union {
@@ -54,6 +55,10 @@ extern char           *c_file;
 	statement_list_t sl;
 }
 
+%{
+extern int yylex (YYSTYPE *lvalp, void *scanner);
+%}
+
 %token <number> NUMBER
 %token <boolean> BTRUE BFALSE
 %token <string> QUOTED_STRING UNQUOTED_STRING
@@ -97,7 +102,7 @@ argument_list:
 	 oconfig_value_t *tmp = realloc($$.argument,
 	                                ($$.argument_num+1) * sizeof(*$$.argument));
 	 if (tmp == NULL) {
-	   yyerror("realloc failed");
+	   yyerror(scanner, state, "realloc failed");
 	   YYERROR;
 	 }
 	 $$.argument = tmp;
@@ -108,7 +113,7 @@ argument_list:
 	{
 	 $$.argument = calloc(1, sizeof(*$$.argument));
 	 if ($$.argument == NULL) {
-	   yyerror("calloc failed");
+	   yyerror(scanner, state, "calloc failed");
 	   YYERROR;
 	 }
 	 $$.argument[0] = $1;
@@ -159,7 +164,7 @@ block:
 	 if (strcmp($1.key, $3) != 0)
 	 {
 		printf("block_begin = %s; block_end = %s;\n", $1.key, $3);
-		yyerror("block not closed");
+		yyerror(scanner, state, "block not closed");
 		YYERROR;
 	 }
 	 free ($3); $3 = NULL;
@@ -172,7 +177,7 @@ block:
 	 if (strcmp($1.key, $2) != 0)
 	 {
 		printf("block_begin = %s; block_end = %s;\n", $1.key, $2);
-		yyerror("block not closed");
+		yyerror(scanner, state, "block not closed");
 		YYERROR;
 	 }
 	 free ($2); $2 = NULL;
@@ -185,7 +190,7 @@ block:
 statement:
 	option		{$$ = $1;}
 	| block		{$$ = $1;}
-	| EOL		{$$.values_num = 0;}
+	| EOL		{memset(&$$, 0, sizeof($$));}
 	;
 
 statement_list:
@@ -197,7 +202,7 @@ statement_list:
 		 oconfig_item_t *tmp = realloc($$.statement,
 		                               ($$.statement_num+1) * sizeof(*tmp));
 		 if (tmp == NULL) {
-		   yyerror("realloc failed");
+		   yyerror(scanner, state, "realloc failed");
 		   YYERROR;
 		 }
 		 $$.statement = tmp;
@@ -211,7 +216,7 @@ statement_list:
 	 {
 		 $$.statement = calloc(1, sizeof(*$$.statement));
 		 if ($$.statement == NULL) {
-		   yyerror("calloc failed");
+		   yyerror(scanner, state, "calloc failed");
 		   YYERROR;
 		 }
 		 $$.statement[0] = $1;
@@ -228,38 +233,36 @@ statement_list:
 entire_file:
 	statement_list
 	{
-	 ci_root = calloc(1, sizeof(*ci_root));
-	 if (ci_root == NULL) {
-	   yyerror("calloc failed");
+	 state->ci_root = calloc(1, sizeof(*state->ci_root));
+	 if (state->ci_root == NULL) {
+	   yyerror(scanner, state, "calloc failed");
 	   YYERROR;
 	 }
-	 ci_root->children = $1.statement;
-	 ci_root->children_num = $1.statement_num;
+	 state->ci_root->children = $1.statement;
+	 state->ci_root->children_num = $1.statement_num;
 	}
 	| /* epsilon */
 	{
-	 ci_root = calloc(1, sizeof(*ci_root));
-	 if (ci_root == NULL) {
-	   yyerror("calloc failed");
+	 state->ci_root = calloc(1, sizeof(*state->ci_root));
+	 if (state->ci_root == NULL) {
+	   yyerror(scanner, state, "calloc failed");
 	   YYERROR;
 	 }
 	}
 	;
 
 %%
-static void yyerror(const char *s)
+static void yyerror(void *scanner, parser_state_t *state, const char *s)
 {
-	const char *text;
+	const char *text = yyget_text (scanner);
 
-	if (yytext == NULL)
+	if (text == NULL)
 		text = "<empty>";
-	else if (*yytext == '\n')
+	else if (*text == '\n')
 		text = "<newline>";
-	else
-		text = yytext;
 
 	fprintf(stderr, "Parse error in file `%s', line %i near `%s': %s\n",
-		c_file, yylineno, text, s);
+		state->file, yyget_lineno (scanner), text, s);
 } /* int yyerror */
 
 static char *unquote (const char *orig)
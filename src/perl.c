@@ -151,6 +151,46 @@ typedef struct {
   pthread_mutexattr_t mutexattr;
 } c_ithread_list_t;
 
+/* a log message which could not be passed to Perl right away */
+typedef struct {
+  char *subname;
+  int level;
+  char *msg;
+} c_ithread_log_t;
+
+#define C_ITHREAD_LOG_QUEUE_SIZE 128
+
+/* interpreters cloned in advance and borrowed by callbacks for the duration
+ * of a single call (see the "InterpreterPool" option) */
+typedef struct {
+  c_ithread_t **threads;
+  bool *busy;
+  int size;
+  int idle_num;
+  bool ready;
+
+  /* the pool interpreter the next read callback is pinned to */
+  int next_pin;
+
+  /* log messages which arrived while all interpreters were busy; they are
+   * passed on by the next thread releasing an interpreter */
+  c_ithread_log_t log_queue[C_ITHREAD_LOG_QUEUE_SIZE];
+  int log_head;
+  int log_num;
+  int log_dropped;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} c_ithread_pool_t;
+
+/* user data of read callbacks */
+typedef struct {
+  char *subname;
+  /* index of the pool interpreter used by this callback, -1 if not yet
+   * assigned */
+  int pin;
+} perl_read_t;
+
 /* name / user_data for Perl matches / targets */
 typedef struct {
   char *name;
@@ -183,6 +223,13 @@ static c_ithread_list_t *perl_threads;
 /* the key used to store each pthread's ithread */
 static pthread_key_t perl_thr_key;
 
+/* number of interpreters in perl_pool, zero if disabled */
+static int perl_pool_size;
+static c_ithread_pool_t perl_pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
 static int perl_argc;
 static char **perl_argv;
 
@@ -1274,6 +1321,216 @@ static c_ithread_t *c_ithread_create(PerlInterpreter *base) {
   return t;
 } /* static c_ithread_t *c_ithread_create (PerlInterpreter *) */
 
+/* Returns an interpreter for a thread which does not have one yet. Without an
+ * interpreter pool, a new interpreter is cloned and bound to the calling
+ * thread for its lifetime. With a pool, an idle interpreter is borrowed
+ * instead and returned in *pooled; it has to be handed back using
+ * c_ithread_release(). If "pin" is not negative, the pool interpreter with
+ * that index is borrowed. If no suitable interpreter is idle, waits for one
+ * to become available or, if "wait" is false, returns NULL. Returns NULL as
+ * well if the pool is shut down. */
+static PerlInterpreter *c_ithread_acquire(c_ithread_t **pooled, int pin,
+                                          bool wait) {
+  c_ithread_t *t = NULL;
+
+  *pooled = NULL;
+
+  pthread_mutex_lock(&perl_pool.mutex);
+  if (perl_pool.ready) {
+    while (perl_pool.ready &&
+           ((pin < 0) ? (0 == perl_pool.idle_num) : perl_pool.busy[pin])) {
+      if (!wait) {
+        pthread_mutex_unlock(&perl_pool.mutex);
+        return NULL;
+      }
+      pthread_cond_wait(&perl_pool.cond, &perl_pool.mutex);
+    }
+
+    if (!perl_pool.ready) {
+      pthread_mutex_unlock(&perl_pool.mutex);
+      return NULL;
+    }
+
+    if (pin < 0) {
+      for (pin = perl_pool.size - 1; pin > 0; --pin)
+        if (!perl_pool.busy[pin])
+          break;
+    }
+    t = perl_pool.threads[pin];
+    perl_pool.busy[pin] = true;
+    --perl_pool.idle_num;
+    pthread_mutex_unlock(&perl_pool.mutex);
+
+    t->pthread = pthread_self();
+    pthread_setspecific(perl_thr_key, (const void *)t);
+    PERL_SET_CONTEXT(t->interp);
+
+    *pooled = t;
+    return t->interp;
+  }
+  pthread_mutex_unlock(&perl_pool.mutex);
+
+  pthread_mutex_lock(&perl_threads->mutex);
+  t = c_ithread_create(perl_threads->head->interp);
+  pthread_mutex_unlock(&perl_threads->mutex);
+
+  return t->interp;
+} /* static PerlInterpreter *c_ithread_acquire (c_ithread_t **, int, bool) */
+
+/* Returns the pool interpreter read callback "r" is pinned to, assigning
+ * one if necessary, or -1 if there is no pool. Read callbacks are spread
+ * across the pool round-robin, so that each of them always runs in the same
+ * interpreter. */
+static int c_ithread_pin(perl_read_t *r) {
+  int pin = -1;
+
+  pthread_mutex_lock(&perl_pool.mutex);
+  if (perl_pool.ready) {
+    if (0 > r->pin) {
+      r->pin = perl_pool.next_pin;
+      perl_pool.next_pin = (perl_pool.next_pin + 1) % perl_pool.size;
+    }
+    pin = r->pin;
+  }
+  pthread_mutex_unlock(&perl_pool.mutex);
+
+  return pin;
+} /* static int c_ithread_pin (perl_read_t *) */
+
+static void perl_read_free(void *arg) {
+  perl_read_t *r = arg;
+
+  if (NULL == r)
+    return;
+
+  sfree(r->subname);
+  sfree(r);
+} /* static void perl_read_free (void *) */
+
+/* Queues a log message which cannot be passed to Perl right now because all
+ * interpreters are busy. Returns non-zero if there is no pool. */
+static int c_ithread_log_queue(int level, const char *msg,
+                               const char *subname) {
+  pthread_mutex_lock(&perl_pool.mutex);
+  if (!perl_pool.ready) {
+    pthread_mutex_unlock(&perl_pool.mutex);
+    return -1;
+  }
+
+  if (C_ITHREAD_LOG_QUEUE_SIZE == perl_pool.log_num) {
+    ++perl_pool.log_dropped;
+    pthread_mutex_unlock(&perl_pool.mutex);
+    return 0;
+  }
+
+  c_ithread_log_t *l =
+      perl_pool.log_queue +
+      (perl_pool.log_head + perl_pool.log_num) % C_ITHREAD_LOG_QUEUE_SIZE;
+  l->subname = strdup(subname);
+  l->level = level;
+  l->msg = strdup(msg);
+  if ((NULL == l->subname) || (NULL == l->msg)) {
+    sfree(l->subname);
+    sfree(l->msg);
+    ++perl_pool.log_dropped;
+  } else {
+    ++perl_pool.log_num;
+  }
+  pthread_mutex_unlock(&perl_pool.mutex);
+  return 0;
+} /* static int c_ithread_log_queue (int, const char *, const char *) */
+
+/* Passes queued log messages to Perl using the calling thread's
+ * interpreter. */
+static void c_ithread_log_flush(pTHX) {
+  while (42) {
+    c_ithread_log_t l;
+    int dropped;
+
+    pthread_mutex_lock(&perl_pool.mutex);
+    if (0 == perl_pool.log_num) {
+      pthread_mutex_unlock(&perl_pool.mutex);
+      return;
+    }
+    l = perl_pool.log_queue[perl_pool.log_head];
+    perl_pool.log_head = (perl_pool.log_head + 1) % C_ITHREAD_LOG_QUEUE_SIZE;
+    --perl_pool.log_num;
+    dropped = perl_pool.log_dropped;
+    perl_pool.log_dropped = 0;
+    pthread_mutex_unlock(&perl_pool.mutex);
+
+    if (0 < dropped) {
+      char buf[128];
+      snprintf(buf, sizeof(buf),
+               "perl: %i log messages were dropped because all Perl "
+               "interpreters were busy.",
+               dropped);
+      pplugin_call(aTHX_ PLUGIN_LOG, l.subname, LOG_WARNING, buf);
+    }
+    pplugin_call(aTHX_ PLUGIN_LOG, l.subname, l.level, l.msg);
+
+    sfree(l.subname);
+    sfree(l.msg);
+  }
+} /* static void c_ithread_log_flush (pTHX) */
+
+/* Hands an interpreter borrowed by c_ithread_acquire() back to the pool. */
+static void c_ithread_release(c_ithread_t *t) {
+  if (NULL == t)
+    return;
+
+  c_ithread_log_flush(t->interp);
+
+  PERL_SET_CONTEXT(NULL);
+  pthread_setspecific(perl_thr_key, NULL);
+
+  pthread_mutex_lock(&perl_pool.mutex);
+  /* after shutdown, the interpreter is destroyed by perl_shutdown() */
+  if (perl_pool.ready) {
+    for (int i = 0; i < perl_pool.size; ++i) {
+      if (perl_pool.threads[i] != t)
+        continue;
+      perl_pool.busy[i] = false;
+      ++perl_pool.idle_num;
+      break;
+    }
+    /* threads may be waiting for a specific interpreter */
+    pthread_cond_broadcast(&perl_pool.cond);
+  }
+  pthread_mutex_unlock(&perl_pool.mutex);
+} /* static void c_ithread_release (c_ithread_t *) */
+
+/* must be called with perl_threads->mutex locked by the base thread */
+static int c_ithread_pool_create(int size) {
+  c_ithread_t *base = perl_threads->head;
+
+  perl_pool.threads = calloc(size, sizeof(*perl_pool.threads));
+  perl_pool.busy = calloc(size, sizeof(*perl_pool.busy));
+  if ((NULL == perl_pool.threads) || (NULL == perl_pool.busy)) {
+    sfree(perl_pool.threads);
+    sfree(perl_pool.busy);
+    log_err("c_ithread_pool_create: calloc failed.");
+    return -1;
+  }
+
+  for (int i = 0; i < size; ++i)
+    perl_pool.threads[i] = c_ithread_create(base->interp);
+
+  /* c_ithread_create() binds the new interpreters to the calling thread. */
+  pthread_setspecific(perl_thr_key, (const void *)base);
+  PERL_SET_CONTEXT(base->interp);
+
+  pthread_mutex_lock(&perl_pool.mutex);
+  perl_pool.size = size;
+  perl_pool.idle_num = size;
+  perl_pool.next_pin = 0;
+  perl_pool.ready = true;
+  pthread_mutex_unlock(&perl_pool.mutex);
+
+  log_info("Created a pool of %i Perl interpreters.", size);
+  return 0;
+} /* static int c_ithread_pool_create (int) */
+
 /*
  * Filter chains implementation.
  */
@@ -1492,6 +1749,9 @@ static int fc_exec(int type, const data_set_t *ds, const value_list_t *vl,
                    notification_meta_t **meta, void **user_data) {
   pfc_user_data_t *data = *(pfc_user_data_t **)user_data;
 
+  c_ithread_t *pooled = NULL;
+  int ret;
+
   dTHX;
 
   if (NULL == perl_threads)
@@ -1499,20 +1759,18 @@ static int fc_exec(int type, const data_set_t *ds, const value_list_t *vl,
 
   assert(NULL != data);
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
-
-    aTHX = t->interp;
-  }
+  if (NULL == aTHX)
+    aTHX = c_ithread_acquire(&pooled, -1, true);
+  if (NULL == aTHX)
+    return 0;
 
   log_debug("fc_exec: c_ithread: interp = %p (active threads: %i)", aTHX,
             perl_threads->number_of_threads);
 
-  return fc_call(aTHX_ type, FC_CB_EXEC, data, ds, vl, meta);
+  ret = fc_call(aTHX_ type, FC_CB_EXEC, data, ds, vl, meta);
+
+  c_ithread_release(pooled);
+  return ret;
 } /* static int fc_exec (int, const data_set_t *, const value_list_t *,
                 notification_meta_t **, void **) */
 
@@ -1587,8 +1845,23 @@ static void _plugin_register_generic_userdata(pTHX, int type,
             desc, pluginname, SvPV_nolen(ST(1)));
 
   memset(&userdata, 0, sizeof(userdata));
-  userdata.data = strdup(SvPV_nolen(ST(1)));
-  userdata.free_func = free;
+  if (PLUGIN_READ == type) {
+    perl_read_t *r = calloc(1, sizeof(*r));
+    if (NULL != r) {
+      r->subname = strdup(SvPV_nolen(ST(1)));
+      r->pin = -1;
+    }
+    if ((NULL == r) || (NULL == r->subname)) {
+      log_err("Collectd::plugin_register_%s: calloc failed.", desc);
+      perl_read_free(r);
+      XSRETURN_EMPTY;
+    }
+    userdata.data = r;
+    userdata.free_func = perl_read_free;
+  } else {
+    userdata.data = strdup(SvPV_nolen(ST(1)));
+    userdata.free_func = free;
+  }
 
   if (PLUGIN_READ == type) {
     ret = plugin_register_complex_read(
@@ -1790,26 +2063,34 @@ static XS(Collectd_plugin_dispatch_values) {
 
   dXSARGS;
 
-  if (1 != items) {
-    log_err("Usage: Collectd::plugin_dispatch_values(values)");
+  if (1 > items) {
+    log_err("Usage: Collectd::plugin_dispatch_values(values, ...)");
     XSRETURN_EMPTY;
   }
 
-  log_debug("Collectd::plugin_dispatch_values: values=\"%s\"",
-            SvPV_nolen(ST(/* stack index = */ 0)));
+  /* Any number of value lists may be passed, saving a call into the XS
+   * layer for each of them. */
+  for (int i = 0; i < items; ++i) {
+    log_debug("Collectd::plugin_dispatch_values: values=\"%s\"",
+              SvPV_nolen(ST(/* stack index = */ i)));
 
-  values = ST(/* stack index = */ 0);
+    values = ST(/* stack index = */ i);
 
-  if (NULL == values)
-    XSRETURN_EMPTY;
+    if (NULL == values) {
+      ret = -1;
+      continue;
+    }
 
-  /* Make sure the argument is a hash reference. */
-  if (!(SvROK(values) && (SVt_PVHV == SvTYPE(SvRV(values))))) {
-    log_err("Collectd::plugin_dispatch_values: Invalid values.");
-    XSRETURN_EMPTY;
-  }
+    /* Make sure the argument is a hash reference. */
+    if (!(SvROK(values) && (SVt_PVHV == SvTYPE(SvRV(values))))) {
+      log_err("Collectd::plugin_dispatch_values: Invalid values.");
+      ret = -1;
+      continue;
+    }
 
-  ret = pplugin_dispatch_values(aTHX_(HV *) SvRV(values));
+    if (0 != pplugin_dispatch_values(aTHX_(HV *) SvRV(values)))
+      ret = -1;
+  }
 
   if (0 == ret)
     XSRETURN_YES;
@@ -2086,26 +2367,32 @@ static int perl_init(void) {
 
   status = pplugin_call(aTHX_ PLUGIN_INIT);
 
+  /* Clone the pool only now so that the interpreters see the state set up by
+   * the init callbacks, just like interpreters cloned on demand. */
+  if ((0 == status) && (0 < perl_pool_size))
+    status = c_ithread_pool_create(perl_pool_size);
+
   pthread_mutex_unlock(&perl_threads->mutex);
 
   return status;
 } /* static int perl_init (void) */
 
 static int perl_read(user_data_t *user_data) {
+  perl_read_t *r = user_data->data;
+  c_ithread_t *pooled = NULL;
+  int ret;
+
   dTHX;
 
   if (NULL == perl_threads)
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
-
-    aTHX = t->interp;
-  }
+  /* With a pool, every read callback is pinned to one interpreter, so that
+   * state kept by the callback between runs is preserved. */
+  if (NULL == aTHX)
+    aTHX = c_ithread_acquire(&pooled, c_ithread_pin(r), true);
+  if (NULL == aTHX)
+    return 0;
 
   /* Assert that we're not running as the base thread. Otherwise, we might
    * run into concurrency issues with c_ithread_create(). See
@@ -2115,26 +2402,25 @@ static int perl_read(user_data_t *user_data) {
   log_debug("perl_read: c_ithread: interp = %p (active threads: %i)", aTHX,
             perl_threads->number_of_threads);
 
-  return pplugin_call(aTHX_ PLUGIN_READ, user_data->data);
+  ret = pplugin_call(aTHX_ PLUGIN_READ, r->subname);
+
+  c_ithread_release(pooled);
+  return ret;
 } /* static int perl_read (user_data_t *user_data) */
 
 static int perl_write(const data_set_t *ds, const value_list_t *vl,
                       user_data_t *user_data) {
+  c_ithread_t *pooled = NULL;
   int status;
   dTHX;
 
   if (NULL == perl_threads)
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
-
-    aTHX = t->interp;
-  }
+  if (NULL == aTHX)
+    aTHX = c_ithread_acquire(&pooled, -1, true);
+  if (NULL == aTHX)
+    return 0;
 
   /* Lock the base thread if this is not called from one of the read threads
    * to avoid race conditions with c_ithread_create(). See
@@ -2149,24 +2435,29 @@ static int perl_write(const data_set_t *ds, const value_list_t *vl,
   if (aTHX == perl_threads->head->interp)
     pthread_mutex_unlock(&perl_threads->mutex);
 
+  c_ithread_release(pooled);
   return status;
 } /* static int perl_write (const data_set_t *, const value_list_t *) */
 
 static void perl_log(int level, const char *msg, user_data_t *user_data) {
+  c_ithread_t *pooled = NULL;
+
   dTHX;
 
   if (NULL == perl_threads)
     return;
 
+  /* Never wait for an interpreter here: the thread holding it may itself be
+   * waiting for something the logging thread holds. If all interpreters are
+   * busy, the message is queued and passed on when one is released. */
   if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
-
-    aTHX = t->interp;
+    aTHX = c_ithread_acquire(&pooled, -1, false);
+    if ((NULL == aTHX) &&
+        (0 == c_ithread_log_queue(level, msg, user_data->data)))
+      return;
   }
+  if (NULL == aTHX)
+    return;
 
   /* Lock the base thread if this is not called from one of the read threads
    * to avoid race conditions with c_ithread_create(). See
@@ -2181,49 +2472,53 @@ static void perl_log(int level, const char *msg, user_data_t *user_data) {
   if (aTHX == perl_threads->head->interp)
     pthread_mutex_unlock(&perl_threads->mutex);
 
+  c_ithread_release(pooled);
   return;
 } /* static void perl_log (int, const char *) */
 
 static int perl_notify(const notification_t *notif, user_data_t *user_data) {
+  c_ithread_t *pooled = NULL;
+  int ret;
+
   dTHX;
 
   if (NULL == perl_threads)
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
+  if (NULL == aTHX)
+    aTHX = c_ithread_acquire(&pooled, -1, true);
+  if (NULL == aTHX)
+    return 0;
+  ret = pplugin_call(aTHX_ PLUGIN_NOTIF, user_data->data, notif);
 
-    aTHX = t->interp;
-  }
-  return pplugin_call(aTHX_ PLUGIN_NOTIF, user_data->data, notif);
+  c_ithread_release(pooled);
+  return ret;
 } /* static int perl_notify (const notification_t *) */
 
 static int perl_flush(cdtime_t timeout, const char *identifier,
                       user_data_t *user_data) {
+  c_ithread_t *pooled = NULL;
+  int ret;
+
   dTHX;
 
   if (NULL == perl_threads)
     return 0;
 
-  if (NULL == aTHX) {
-    c_ithread_t *t = NULL;
-
-    pthread_mutex_lock(&perl_threads->mutex);
-    t = c_ithread_create(perl_threads->head->interp);
-    pthread_mutex_unlock(&perl_threads->mutex);
-
-    aTHX = t->interp;
-  }
+  if (NULL == aTHX)
+    aTHX = c_ithread_acquire(&pooled, -1, true);
+  if (NULL == aTHX)
+    return 0;
 
   /* For collectd-5.6 only, #1731 */
   if (user_data == NULL || user_data->data == NULL)
-    return pplugin_call(aTHX_ PLUGIN_FLUSH_ALL, timeout, identifier);
+    ret = pplugin_call(aTHX_ PLUGIN_FLUSH_ALL, timeout, identifier);
+  else
+    ret = pplugin_call(aTHX_ PLUGIN_FLUSH, user_data->data, timeout,
+                       identifier);
 
-  return pplugin_call(aTHX_ PLUGIN_FLUSH, user_data->data, timeout, identifier);
+  c_ithread_release(pooled);
+  return ret;
 } /* static int perl_flush (const int) */
 
 static int perl_shutdown(void) {
@@ -2254,6 +2549,23 @@ static int perl_shutdown(void) {
 
   ret = pplugin_call(aTHX_ PLUGIN_SHUTDOWN);
 
+  /* Wake up threads waiting for an interpreter; the pooled interpreters are
+   * destroyed along with all others below. */
+  pthread_mutex_lock(&perl_pool.mutex);
+  perl_pool.ready = false;
+  perl_pool.size = 0;
+  perl_pool.idle_num = 0;
+  sfree(perl_pool.threads);
+  sfree(perl_pool.busy);
+  for (; 0 < perl_pool.log_num; --perl_pool.log_num) {
+    c_ithread_log_t *l = perl_pool.log_queue + perl_pool.log_head;
+    sfree(l->subname);
+    sfree(l->msg);
+    perl_pool.log_head = (perl_pool.log_head + 1) % C_ITHREAD_LOG_QUEUE_SIZE;
+  }
+  pthread_cond_broadcast(&perl_pool.cond);
+  pthread_mutex_unlock(&perl_pool.mutex);
+
   pthread_mutex_lock(&perl_threads->mutex);
   t = perl_threads->tail;
 
@@ -2689,6 +3001,13 @@ static int perl_config(oconfig_item_t *ci) {
       current_status = perl_config_plugin(aTHX_ c);
     else if (0 == strcasecmp(c->key, "RegisterLegacyFlush"))
       cf_util_get_boolean(c, &register_legacy_flush);
+    else if (0 == strcasecmp(c->key, "InterpreterPool")) {
+      current_status = cf_util_get_int(c, &perl_pool_size);
+      if ((0 == current_status) && (0 > perl_pool_size)) {
+        log_err("InterpreterPool must not be negative.");
+        current_status = 1;
+      }
+    }
     else {
       log_warn("Ignoring unknown config key \"%s\".", c->key);
       current_status = 0;
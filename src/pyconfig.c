@@ -129,25 +129,14 @@ static int Config_init(PyObject *s, PyObject *args, PyObject *kwds) {
 static PyObject *Config_repr(PyObject *s) {
   Config *self = (Config *)s;
   PyObject *ret = NULL;
-  static PyObject *node_prefix, *root_prefix, *ending;
-
-  /* This is ok because we have the GIL, so this is thread-save by default. */
-  if (node_prefix == NULL)
-    node_prefix = cpy_string_to_unicode_or_bytes("<collectd.Config node ");
-  if (root_prefix == NULL)
-    root_prefix = cpy_string_to_unicode_or_bytes("<collectd.Config root node ");
-  if (ending == NULL)
-    ending = cpy_string_to_unicode_or_bytes(">");
-  if (node_prefix == NULL || root_prefix == NULL || ending == NULL)
-    return NULL;
 
   ret = PyObject_Str(self->key);
   CPY_SUBSTITUTE(PyObject_Repr, ret, ret);
   if (self->parent == NULL || self->parent == Py_None)
-    CPY_STRCAT(&ret, root_prefix);
+    cpy_strcat_string(&ret, "<collectd.Config root node ");
   else
-    CPY_STRCAT(&ret, node_prefix);
-  CPY_STRCAT(&ret, ending);
+    cpy_strcat_string(&ret, "<collectd.Config node ");
+  cpy_strcat_string(&ret, ">");
 
   return ret;
 }
@@ -158,7 +147,7 @@ static int Config_traverse(PyObject *self, visitproc visit, void *arg) {
   Py_VISIT(c->key);
   Py_VISIT(c->values);
   Py_VISIT(c->children);
-  return 0;
+  return cpy_traverse_type(self, visit, arg);
 }
 
 static int Config_clear(PyObject *self) {
@@ -172,7 +161,7 @@ static int Config_clear(PyObject *self) {
 
 static void Config_dealloc(PyObject *self) {
   Config_clear(self);
-  self->ob_type->tp_free(self);
+  cpy_free_object(self);
 }
 
 static PyMemberDef Config_members[] = {
@@ -221,3 +210,21 @@ PyTypeObject ConfigType = {
     0,               /* tp_alloc */
     Config_new       /* tp_new */
 };
+
+#ifdef CPY_HAVE_OWN_GIL
+static PyType_Slot Config_slots[] = {
+    {Py_tp_dealloc, Config_dealloc},
+    {Py_tp_repr, Config_repr},
+    {Py_tp_doc, config_doc},
+    {Py_tp_traverse, Config_traverse},
+    {Py_tp_clear, Config_clear},
+    {Py_tp_members, Config_members},
+    {Py_tp_init, Config_init},
+    {Py_tp_new, Config_new},
+    {0, NULL}};
+
+PyType_Spec ConfigSpec = {"collectd.Config", sizeof(Config), 0,
+                          Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE |
+                              Py_TPFLAGS_HAVE_GC,
+                          Config_slots};
+#endif
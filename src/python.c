@@ -31,6 +31,7 @@
 
 #include "collectd.h"
 
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 
 #include "cpython.h"
@@ -39,6 +40,7 @@ typedef struct cpy_callback_s {
   char *name;
   PyObject *callback;
   PyObject *data;
+  cpy_interp_t *interp;
   struct cpy_callback_s *next;
 } cpy_callback_t;
 
@@ -62,6 +64,15 @@ static char flush_doc[] = "flush([plugin][, timeout][, identifier]) -> None\n"
                           "\n"
                           "Flushes the cache of another plugin.";
 
+static char dispatch_values_doc[] =
+    "dispatch_values(values) -> None\n"
+    "\n"
+    "Dispatches a sequence of Values objects in one call.\n"
+    "\n"
+    "'values' is a list or tuple of Values objects. Each object is dispatched\n"
+    "    as if its dispatch method had been called without arguments. If one\n"
+    "    of them is invalid, an exception is raised and none is dispatched.";
+
 static char unregister_doc[] =
     "Unregisters a callback. This function needs exactly one parameter either\n"
     "the function to unregister or the callback identifier to unregister.";
@@ -172,6 +183,31 @@ static char reg_write_doc[] =
     "data: The optional data parameter passed to the register function.\n"
     "    If the parameter was omitted it will be omitted here, too.";
 
+static char reg_write_batch_doc[] =
+    "register_write_batch(callback[, size][, data][, name]) -> identifier\n"
+    "\n"
+    "Register a callback function to receive dispatched values in batches.\n"
+    "'callback' is a callable object that will be called every time 'size'\n"
+    "    data sources have been collected or the callback is flushed.\n"
+    "'size' is the number of data sources per batch. Defaults to 1024.\n"
+    "'data' is an optional object that will be passed back to the callback\n"
+    "    function every time it is called.\n"
+    "'name' is an optional identifier for this callback. The default name\n"
+    "    is 'python.<module>'.\n"
+    "'identifier' is the full identifier assigned to this callback.\n"
+    "\n"
+    "The callback function will be called with four or five parameters:\n"
+    "ids: A memoryview of unsigned ints, one per data source, which are\n"
+    "    indexes into 'identifiers'.\n"
+    "times: A memoryview of doubles with the time of each data source.\n"
+    "values: A memoryview of doubles with the value of each data source.\n"
+    "identifiers: A list of (host, plugin, plugin_instance, type,\n"
+    "    type_instance, data_source, data_source_type) tuples. The indexes\n"
+    "    in 'ids' are only valid for the list passed in the same call: when\n"
+    "    unused identifiers expire, a new, renumbered list is passed.\n"
+    "data: The optional data parameter passed to the register function.\n"
+    "    If the parameter was omitted it will be omitted here, too.";
+
 static char reg_notification_doc[] =
     "register_notification(callback[, data][, name]) -> identifier\n"
     "\n"
@@ -250,29 +286,435 @@ static bool do_interactive;
 
 static PyThreadState *state;
 
-static PyObject *sys_path, *cpy_format_exception, *CollectdError;
+static PyObject *sys_path;
+
+/* An interpreter running Python modules. Modules loaded with "Import" share
+ * the main interpreter. Every module loaded with "ImportIsolated" gets a
+ * sub-interpreter with its own GIL, so that its callbacks don't have to wait
+ * for the ones of other modules. */
+struct cpy_interp_s {
+  PyObject *collectd_error;
+  PyObject *format_exception; /* traceback.format_exception, see LogTraces */
+  cpy_types_t types;
+#ifdef CPY_HAVE_OWN_GIL
+  char *name;
+  PyInterpreterState *interp;
+  /* The PyThreadState of this interpreter for each collectd thread. */
+  pthread_key_t tstate_key;
+  /* All thread states in "tstate_key", so they can be deleted before the
+   * interpreter is ended. */
+  pthread_mutex_t lock;
+  PyThreadState **tstates;
+  size_t tstates_num;
+  cpy_interp_t *next;
+#endif
+};
+
+static cpy_interp_t cpy_main_interp = {
+    .types =
+        {
+            .config = &ConfigType,
+            .plugin_data = &PluginDataType,
+            .values = &ValuesType,
+            .notification = &NotificationType,
+            .signed_type = &SignedType,
+            .unsigned_type = &UnsignedType,
+        },
+};
+
+#ifdef CPY_HAVE_OWN_GIL
+/* The isolated interpreters. The list is only modified while reading the
+ * config and when Python is finalized, so it is read without locking. */
+static cpy_interp_t *cpy_isolated;
+#endif
 
 static cpy_callback_t *cpy_config_callbacks;
 static cpy_callback_t *cpy_init_callbacks;
 static cpy_callback_t *cpy_shutdown_callbacks;
 
-/* Make sure to hold the GIL while modifying these. */
+/* Isolated interpreters don't share the GIL, so hold this lock while
+ * modifying the callback lists or the following variables. */
+static pthread_mutex_t cpy_lock = PTHREAD_MUTEX_INITIALIZER;
 static int cpy_shutdown_triggered;
 static int cpy_num_callbacks;
 
+/* Returns the interpreter of the calling thread.
+ * You must hold the GIL to call this function! */
+static cpy_interp_t *cpy_interp_current(void) {
+#ifdef CPY_HAVE_OWN_GIL
+  PyInterpreterState *interp = PyInterpreterState_Get();
+
+  for (cpy_interp_t *i = cpy_isolated; i != NULL; i = i->next)
+    if (i->interp == interp)
+      return i;
+#endif
+  return &cpy_main_interp;
+}
+
+const cpy_types_t *cpy_types(void) { return &cpy_interp_current()->types; }
+
+int cpy_traverse_type(PyObject *self, visitproc visit, void *arg) {
+#ifdef CPY_HAVE_OWN_GIL
+  if (cpy_interp_current() != &cpy_main_interp)
+    Py_VISIT(Py_TYPE(self));
+#endif
+  return 0;
+}
+
+void cpy_free_object(PyObject *self) {
+  PyTypeObject *type = Py_TYPE(self);
+
+  type->tp_free(self);
+#ifdef CPY_HAVE_OWN_GIL
+  if (cpy_interp_current() != &cpy_main_interp)
+    Py_DECREF(type);
+#endif
+}
+
+#ifdef CPY_HAVE_OWN_GIL
+#if PY_VERSION_HEX >= 0x030D0000
+#define CPY_CURRENT_THREAD_STATE() PyThreadState_GetUnchecked()
+#else
+#define CPY_CURRENT_THREAD_STATE() _PyThreadState_UncheckedGet()
+#endif
+
+#define CPY_GIL_HELD 0
+#define CPY_GIL_GILSTATE 1
+#define CPY_GIL_TSTATE 2
+
+/* Returns the thread state of "i" for the calling thread, creating it if
+ * necessary. */
+static PyThreadState *cpy_interp_tstate(cpy_interp_t *i) {
+  PyThreadState *tstate = pthread_getspecific(i->tstate_key);
+  if (tstate != NULL)
+    return tstate;
+
+  /* PyThreadState_New() makes the new thread state the one returned by
+   * PyGILState_Ensure() if this thread doesn't have one yet. Make sure that
+   * one belongs to the main interpreter. It is kept until Python is
+   * finalized. */
+  if (i != &cpy_main_interp && PyGILState_GetThisThreadState() == NULL) {
+    PyGILState_Ensure();
+    PyEval_SaveThread();
+  }
+
+  tstate = PyThreadState_New(i->interp);
+  if (tstate == NULL)
+    Py_FatalError("python plugin: Unable to create a thread state");
+  pthread_setspecific(i->tstate_key, tstate);
+  if (i == &cpy_main_interp)
+    return tstate; /* Deleted by Py_Finalize(). */
+
+  pthread_mutex_lock(&i->lock);
+  PyThreadState **tmp =
+      realloc(i->tstates, (i->tstates_num + 1) * sizeof(*i->tstates));
+  if (tmp == NULL)
+    Py_FatalError("python plugin: Unable to create a thread state");
+  i->tstates = tmp;
+  i->tstates[i->tstates_num] = tstate;
+  i->tstates_num++;
+  pthread_mutex_unlock(&i->lock);
+  return tstate;
+}
+
+void cpy_gil_acquire(cpy_gil_t *gil, cpy_interp_t *interp) {
+  PyThreadState *current = CPY_CURRENT_THREAD_STATE();
+
+  if (interp == NULL)
+    interp = &cpy_main_interp;
+  gil->saved = NULL;
+
+  if (current != NULL) {
+    if (PyThreadState_GetInterpreter(current) == interp->interp) {
+      /* Python code of this interpreter called into collectd, which called
+       * us back, e.g. a log callback. */
+      gil->mode = CPY_GIL_HELD;
+      return;
+    }
+    gil->saved = PyEval_SaveThread();
+  }
+
+  if (interp == &cpy_main_interp) {
+    /* PyGILState_Ensure() uses the thread state of another interpreter
+     * in threads started by isolated modules. */
+    PyThreadState *tstate = PyGILState_GetThisThreadState();
+    if (tstate == NULL ||
+        PyThreadState_GetInterpreter(tstate) == interp->interp) {
+      gil->gil_state = PyGILState_Ensure();
+      gil->mode = CPY_GIL_GILSTATE;
+      return;
+    }
+  }
+
+  PyEval_RestoreThread(cpy_interp_tstate(interp));
+  gil->mode = CPY_GIL_TSTATE;
+}
+
+void cpy_gil_release(cpy_gil_t *gil) {
+  if (gil->mode == CPY_GIL_GILSTATE)
+    PyGILState_Release(gil->gil_state);
+  else if (gil->mode == CPY_GIL_TSTATE)
+    PyEval_SaveThread();
+
+  if (gil->saved != NULL)
+    PyEval_RestoreThread(gil->saved);
+}
+
+static void cpy_interp_clear_types(cpy_interp_t *i);
+
+/* Creates the types of an isolated interpreter from the specs in pyvalues.c
+ * and pyconfig.c. Static types can only be used by the main interpreter. */
+static int cpy_interp_init_types(cpy_interp_t *i) {
+  cpy_types_t *t = &i->types;
+  PyObject *bases;
+
+  t->config = (void *)PyType_FromSpec(&ConfigSpec);
+  t->plugin_data = (void *)PyType_FromSpec(&PluginDataSpec);
+  if (t->config == NULL || t->plugin_data == NULL)
+    goto error;
+  t->values =
+      (void *)PyType_FromSpecWithBases(&ValuesSpec, (void *)t->plugin_data);
+  t->notification = (void *)PyType_FromSpecWithBases(&NotificationSpec,
+                                                     (void *)t->plugin_data);
+  bases = PyTuple_Pack(1, (void *)&PyLong_Type); /* New reference. */
+  if (bases == NULL)
+    goto error;
+  t->signed_type = (void *)PyType_FromSpecWithBases(&SignedSpec, bases);
+  t->unsigned_type = (void *)PyType_FromSpecWithBases(&UnsignedSpec, bases);
+  Py_DECREF(bases);
+  if (t->values == NULL || t->notification == NULL ||
+      t->signed_type == NULL || t->unsigned_type == NULL)
+    goto error;
+  return 0;
+
+error:
+  cpy_interp_clear_types(i);
+  return -1;
+}
+
+static void cpy_interp_clear_types(cpy_interp_t *i) {
+  Py_CLEAR(i->types.config);
+  Py_CLEAR(i->types.values);
+  Py_CLEAR(i->types.notification);
+  Py_CLEAR(i->types.plugin_data);
+  Py_CLEAR(i->types.signed_type);
+  Py_CLEAR(i->types.unsigned_type);
+}
+
+/* Imports "module_name" into a new interpreter with its own GIL. The new
+ * interpreter starts with the module path of the main interpreter.
+ * You must hold the GIL of the main interpreter to call this function! */
+static int cpy_import_isolated(const char *module_name) {
+  PyInterpreterConfig config = {
+      .use_main_obmalloc = 0,
+      .allow_fork = 0,
+      .allow_exec = 0,
+      .allow_threads = 1,
+      .allow_daemon_threads = 0,
+      .check_multi_interp_extensions = 1,
+      .gil = PyInterpreterConfig_OWN_GIL,
+  };
+  PyThreadState *main_tstate = PyThreadState_Get();
+  PyThreadState *tstate = NULL;
+  PyObject *module;
+  PyObject *list;
+  PyStatus status;
+  Py_ssize_t path_num;
+  char **path;
+  cpy_interp_t *i;
+  int ret = 0;
+
+  path_num = PyList_Size(sys_path);
+  path = calloc(path_num > 0 ? path_num : 1, sizeof(*path));
+  i = calloc(1, sizeof(*i));
+  if (path == NULL || i == NULL) {
+    ERROR("python plugin: calloc failed.");
+    free(path);
+    free(i);
+    return -1;
+  }
+  /* Objects can't be shared between interpreters, so pass the path as C
+   * strings. */
+  for (Py_ssize_t j = 0; j < path_num; j++) {
+    PyObject *dir = PyList_GetItem(sys_path, j); /* Borrowed reference. */
+    const char *str;
+
+    Py_INCREF(dir);
+    str = cpy_unicode_or_bytes_to_string(&dir);
+    if (str != NULL)
+      path[j] = strdup(str);
+    else
+      PyErr_Clear();
+    Py_DECREF(dir);
+  }
+
+  i->name = strdup(module_name);
+  if (i->name == NULL || pthread_key_create(&i->tstate_key, NULL) != 0) {
+    ERROR("python plugin: Unable to set up an interpreter for module \"%s\".",
+          module_name);
+    ret = -1;
+    goto out;
+  }
+  pthread_mutex_init(&i->lock, NULL);
+
+  status = Py_NewInterpreterFromConfig(&tstate, &config);
+  if (PyStatus_Exception(status)) {
+    ERROR("python plugin: Unable to create an interpreter for module \"%s\": "
+          "%s",
+          module_name,
+          (status.err_msg != NULL) ? status.err_msg : "unknown error");
+    pthread_key_delete(i->tstate_key);
+    pthread_mutex_destroy(&i->lock);
+    ret = -1;
+    goto out;
+  }
+
+  /* The new interpreter is current now and the GIL of the main interpreter
+   * has been released. Link it before importing anything, so that the
+   * collectd module finds it. */
+  i->interp = PyThreadState_GetInterpreter(tstate);
+  pthread_setspecific(i->tstate_key, tstate);
+  i->tstates = malloc(sizeof(*i->tstates));
+  if (i->tstates == NULL)
+    Py_FatalError("python plugin: Unable to create a thread state");
+  i->tstates[0] = tstate;
+  i->tstates_num = 1;
+  i->next = cpy_isolated;
+  cpy_isolated = i;
+
+  list = PySys_GetObject("path"); /* Borrowed reference. */
+  if (list != NULL &&
+      PyList_SetSlice(list, 0, PyList_GET_SIZE(list), NULL) == 0) {
+    for (Py_ssize_t j = 0; j < path_num; j++) {
+      PyObject *dir;
+
+      if (path[j] == NULL)
+        continue;
+      dir = cpy_string_to_unicode_or_bytes(path[j]); /* New reference. */
+      if (dir == NULL || PyList_Append(list, dir) != 0)
+        cpy_log_exception("python initialization");
+      Py_XDECREF(dir);
+    }
+  }
+
+  if (cpy_main_interp.format_exception != NULL) {
+    PyObject *tb = PyImport_ImportModule("traceback"); /* New reference. */
+    if (tb != NULL) {
+      i->format_exception =
+          PyObject_GetAttrString(tb, "format_exception"); /* New reference. */
+      Py_DECREF(tb);
+    }
+    if (i->format_exception == NULL)
+      cpy_log_exception("python initialization");
+  }
+
+  module = PyImport_ImportModule(module_name); /* New reference. */
+  if (module == NULL) {
+    ERROR("python plugin: Error importing module \"%s\".", module_name);
+    cpy_log_exception("importing module");
+    ret = -1;
+  }
+  Py_XDECREF(module);
+
+  /* The interpreter is kept even if the import failed: the module may have
+   * registered callbacks before failing. */
+  PyEval_SaveThread();
+  PyEval_RestoreThread(main_tstate);
+  i = NULL;
+
+out:
+  for (Py_ssize_t j = 0; j < path_num; j++)
+    free(path[j]);
+  free(path);
+  if (i != NULL) {
+    free(i->name);
+    free(i);
+  }
+  return ret;
+}
+
+/* Deletes the thread states of all threads and ends the interpreter.
+ * You must not hold any GIL when calling this function! */
+static void cpy_interp_end(cpy_interp_t *i) {
+  PyThreadState *tstate = cpy_interp_tstate(i);
+
+  PyEval_RestoreThread(tstate);
+
+  /* Py_EndInterpreter() requires the thread state it is called with to be
+   * the last one. */
+  pthread_mutex_lock(&i->lock);
+  for (size_t j = 0; j < i->tstates_num; j++) {
+    if (i->tstates[j] == tstate)
+      continue;
+    PyThreadState_Clear(i->tstates[j]);
+    PyThreadState_Delete(i->tstates[j]);
+  }
+  free(i->tstates);
+  i->tstates = NULL;
+  i->tstates_num = 0;
+  pthread_mutex_unlock(&i->lock);
+
+  Py_CLEAR(i->format_exception);
+  /* The types and collectd_error are released by cpy_module_free(). */
+  Py_EndInterpreter(tstate);
+
+  pthread_key_delete(i->tstate_key);
+  pthread_mutex_destroy(&i->lock);
+}
+#else
+void cpy_gil_acquire(cpy_gil_t *gil,
+                     cpy_interp_t __attribute__((unused)) * interp) {
+  gil->gil_state = PyGILState_Ensure();
+}
+
+void cpy_gil_release(cpy_gil_t *gil) { PyGILState_Release(gil->gil_state); }
+#endif
+
+/* Ends the isolated interpreters and finalizes Python. This is done once all
+ * callbacks have been destroyed after the shutdown.
+ * You must not hold any GIL when calling this function! */
+static void cpy_finalize(void) {
+#ifdef CPY_HAVE_OWN_GIL
+  for (cpy_interp_t *i = cpy_isolated; i != NULL; i = i->next)
+    cpy_interp_end(i);
+#endif
+
+  PyGILState_Ensure();
+  Py_Finalize();
+
+#ifdef CPY_HAVE_OWN_GIL
+  while (cpy_isolated != NULL) {
+    cpy_interp_t *i = cpy_isolated;
+    cpy_isolated = i->next;
+    free(i->name);
+    free(i);
+  }
+#endif
+}
+
+static void cpy_callback_added(void) {
+  pthread_mutex_lock(&cpy_lock);
+  ++cpy_num_callbacks;
+  pthread_mutex_unlock(&cpy_lock);
+}
+
 static void cpy_destroy_user_data(void *data) {
   cpy_callback_t *c = data;
+  bool finalize;
+
   free(c->name);
-  CPY_LOCK_THREADS
+  CPY_LOCK_INTERP(c->interp)
   Py_DECREF(c->callback);
   Py_XDECREF(c->data);
+  CPY_RELEASE_THREADS
   free(c);
+
+  pthread_mutex_lock(&cpy_lock);
   --cpy_num_callbacks;
-  if (!cpy_num_callbacks && cpy_shutdown_triggered) {
-    Py_Finalize();
-    return;
-  }
-  CPY_RELEASE_THREADS
+  finalize = !cpy_num_callbacks && cpy_shutdown_triggered;
+  pthread_mutex_unlock(&cpy_lock);
+  if (finalize)
+    cpy_finalize();
 }
 
 /* You must hold the GIL to call this function!
@@ -306,6 +748,7 @@ static void cpy_build_name(char *buf, size_t size, PyObject *callback,
 }
 
 void cpy_log_exception(const char *context) {
+  cpy_interp_t *interp = cpy_interp_current();
   int l = 0, collectd_error;
   const char *typename = NULL, *message = NULL;
   PyObject *type, *value, *traceback, *tn, *m, *list;
@@ -314,7 +757,7 @@ void cpy_log_exception(const char *context) {
   PyErr_NormalizeException(&type, &value, &traceback);
   if (type == NULL)
     return;
-  collectd_error = PyErr_GivenExceptionMatches(value, CollectdError);
+  collectd_error = PyErr_GivenExceptionMatches(value, interp->collectd_error);
   tn = PyObject_GetAttrString(type, "__name__"); /* New reference. */
   m = PyObject_Str(value);                       /* New reference. */
   if (tn != NULL)
@@ -335,14 +778,14 @@ void cpy_log_exception(const char *context) {
   Py_END_ALLOW_THREADS;
   Py_XDECREF(tn);
   Py_XDECREF(m);
-  if (!cpy_format_exception || !traceback || collectd_error) {
+  if (!interp->format_exception || !traceback || collectd_error) {
     PyErr_Clear();
     Py_DECREF(type);
     Py_XDECREF(value);
     Py_XDECREF(traceback);
     return;
   }
-  list = PyObject_CallFunction(cpy_format_exception, "NNN", type, value,
+  list = PyObject_CallFunction(interp->format_exception, "NNN", type, value,
                                traceback); /* New reference. Steals references
                                               from "type", "value" and
                                               "traceback". */
@@ -384,7 +827,7 @@ static int cpy_read_callback(user_data_t *data) {
   cpy_callback_t *c = data->data;
   PyObject *ret;
 
-  CPY_LOCK_THREADS
+  CPY_LOCK_INTERP(c->interp)
   ret = PyObject_CallFunctionObjArgs(c->callback, c->data,
                                      (void *)0); /* New reference. */
   if (ret == NULL) {
@@ -403,9 +846,11 @@ static int cpy_write_callback(const data_set_t *ds,
                               user_data_t *data) {
   cpy_callback_t *c = data->data;
   PyObject *ret, *list, *temp, *dict = NULL;
+  const cpy_types_t *types;
   Values *v;
 
-  CPY_LOCK_THREADS
+  CPY_LOCK_INTERP(c->interp)
+  types = cpy_types();
   list = PyList_New(value_list->values_len); /* New reference. */
   if (list == NULL) {
     cpy_log_exception("write callback");
@@ -462,7 +907,7 @@ static int cpy_write_callback(const data_set_t *ds,
         if (meta_data_get_signed_int(meta, table[i], &si))
           continue;
         PyObject *sival = PyLong_FromLongLong(si); /* New reference */
-        temp = PyObject_CallFunctionObjArgs((void *)&SignedType, sival,
+        temp = PyObject_CallFunctionObjArgs((void *)types->signed_type, sival,
                                             (void *)0); /* New reference. */
         PyDict_SetItemString(dict, table[i], temp);
         Py_XDECREF(temp);
@@ -471,7 +916,7 @@ static int cpy_write_callback(const data_set_t *ds,
         if (meta_data_get_unsigned_int(meta, table[i], &ui))
           continue;
         PyObject *uval = PyLong_FromUnsignedLongLong(ui); /* New reference */
-        temp = PyObject_CallFunctionObjArgs((void *)&UnsignedType, uval,
+        temp = PyObject_CallFunctionObjArgs((void *)types->unsigned_type, uval,
                                             (void *)0); /* New reference. */
         PyDict_SetItemString(dict, table[i], temp);
         Py_XDECREF(temp);
@@ -524,9 +969,11 @@ static int cpy_notification_callback(const notification_t *notification,
                                      user_data_t *data) {
   cpy_callback_t *c = data->data;
   PyObject *ret, *notify;
+  const cpy_types_t *types;
   Notification *n;
 
-  CPY_LOCK_THREADS
+  CPY_LOCK_INTERP(c->interp)
+  types = cpy_types();
   PyObject *dict = PyDict_New(); /* New reference. */
   for (notification_meta_t *meta = notification->meta; meta != NULL;
        meta = meta->next) {
@@ -538,7 +985,7 @@ static int cpy_notification_callback(const notification_t *notification,
       Py_XDECREF(temp);
     } else if (meta->type == NM_TYPE_SIGNED_INT) {
       PyObject *sival = PyLong_FromLongLong(meta->nm_value.nm_signed_int);
-      temp = PyObject_CallFunctionObjArgs((void *)&SignedType, sival,
+      temp = PyObject_CallFunctionObjArgs((void *)types->signed_type, sival,
                                           (void *)0); /* New reference. */
       PyDict_SetItemString(dict, meta->name, temp);
       Py_XDECREF(temp);
@@ -546,7 +993,7 @@ static int cpy_notification_callback(const notification_t *notification,
     } else if (meta->type == NM_TYPE_UNSIGNED_INT) {
       PyObject *uval =
           PyLong_FromUnsignedLongLong(meta->nm_value.nm_unsigned_int);
-      temp = PyObject_CallFunctionObjArgs((void *)&UnsignedType, uval,
+      temp = PyObject_CallFunctionObjArgs((void *)types->unsigned_type, uval,
                                           (void *)0); /* New reference. */
       PyDict_SetItemString(dict, meta->name, temp);
       Py_XDECREF(temp);
@@ -591,7 +1038,7 @@ static void cpy_log_callback(int severity, const char *message,
   cpy_callback_t *c = data->data;
   PyObject *ret, *text;
 
-  CPY_LOCK_THREADS
+  CPY_LOCK_INTERP(c->interp)
   text = cpy_string_to_unicode_or_bytes(message); /* New reference. */
   if (c->data == NULL)
     ret = PyObject_CallFunction(
@@ -621,7 +1068,7 @@ static void cpy_flush_callback(int timeout, const char *id, user_data_t *data) {
   cpy_callback_t *c = data->data;
   PyObject *ret, *text;
 
-  CPY_LOCK_THREADS
+  CPY_LOCK_INTERP(c->interp)
   if (id) {
     text = cpy_string_to_unicode_or_bytes(id);
   } else {
@@ -643,6 +1090,461 @@ static void cpy_flush_callback(int timeout, const char *id, user_data_t *data) {
   CPY_RELEASE_THREADS
 }
 
+/* Batched write callbacks. Rows, one per data source, are accumulated in
+ * bytearrays without taking the GIL and handed to Python as typed memoryviews
+ * once "size" rows have been collected or the callback is flushed.
+ *
+ * Lock order: the GIL is always taken before "lock". Writers release "lock"
+ * before taking the GIL to send a full batch. */
+
+#define CPY_BATCH_DEFAULT_SIZE 1024
+/* Identifiers which have not been written for this many of their intervals
+ * are removed from the index and from the list passed to Python. */
+#define CPY_BATCH_EXPIRE_INTERVALS 10
+
+typedef struct {
+  char host[DATA_MAX_NAME_LEN];
+  char plugin[DATA_MAX_NAME_LEN];
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  char type[DATA_MAX_NAME_LEN];
+  char type_instance[DATA_MAX_NAME_LEN];
+  const data_set_t *ds;
+} cpy_batch_ident_t;
+
+/* Value of an identifier in "index". */
+typedef struct {
+  /* Index of the first data source in "identifiers". */
+  unsigned int id;
+  size_t ds_num;
+  cdtime_t last_write;
+  cdtime_t interval;
+} cpy_batch_entry_t;
+
+typedef struct {
+  char *name;
+  PyObject *callback;
+  PyObject *data;
+  cpy_interp_t *interp;
+
+  pthread_mutex_t lock;
+  size_t size;
+  size_t num;
+  cdtime_t first;
+  /* bytearrays with room for "size" rows. */
+  PyObject *ids;    /* unsigned int, index into "identifiers" */
+  PyObject *times;  /* double */
+  PyObject *values; /* double */
+
+  /* Maps the identifier of a value list to a cpy_batch_entry_t. */
+  c_avl_tree_t *index;
+  unsigned int num_ids;
+  cdtime_t next_expire;
+  /* Identifiers not yet added to "identifiers", which needs the GIL. */
+  cpy_batch_ident_t *pending;
+  size_t pending_num;
+  PyObject *identifiers; /* list */
+} cpy_batch_t;
+
+/* You must hold the GIL to call this function! */
+static int cpy_batch_alloc(cpy_batch_t *b) {
+  Py_CLEAR(b->ids);
+  Py_CLEAR(b->times);
+  Py_CLEAR(b->values);
+
+  b->ids = PyByteArray_FromStringAndSize(NULL, b->size * sizeof(unsigned int));
+  b->times = PyByteArray_FromStringAndSize(NULL, b->size * sizeof(double));
+  b->values = PyByteArray_FromStringAndSize(NULL, b->size * sizeof(double));
+  if (b->ids == NULL || b->times == NULL || b->values == NULL) {
+    Py_CLEAR(b->ids);
+    Py_CLEAR(b->times);
+    Py_CLEAR(b->values);
+    return -1;
+  }
+  return 0;
+}
+
+/* Shrinks "column" to "len" bytes and returns a memoryview of it with the
+ * given format. Returns a new reference. */
+static PyObject *cpy_batch_column(PyObject *column, size_t len,
+                                  const char *format) {
+  PyObject *view, *ret;
+
+  if (PyByteArray_Resize(column, (Py_ssize_t)len) != 0)
+    return NULL;
+  view = PyMemoryView_FromObject(column); /* New reference. */
+  if (view == NULL)
+    return NULL;
+  ret = PyObject_CallMethod(view, "cast", "s", format); /* New reference. */
+  Py_DECREF(view);
+  return ret;
+}
+
+/* You must hold the GIL to call this function! */
+static int cpy_batch_add_identifiers(cpy_batch_t *b) {
+  for (size_t i = 0; i < b->pending_num; i++) {
+    cpy_batch_ident_t *id = b->pending + i;
+
+    for (size_t j = 0; j < id->ds->ds_num; j++) {
+      PyObject *tuple = Py_BuildValue(
+          "(NNNNNNs)", cpy_string_to_unicode_or_bytes(id->host),
+          cpy_string_to_unicode_or_bytes(id->plugin),
+          cpy_string_to_unicode_or_bytes(id->plugin_instance),
+          cpy_string_to_unicode_or_bytes(id->type),
+          cpy_string_to_unicode_or_bytes(id->type_instance),
+          cpy_string_to_unicode_or_bytes(id->ds->ds[j].name),
+          DS_TYPE_TO_STRING(id->ds->ds[j].type)); /* New reference. */
+      if (tuple == NULL)
+        return -1;
+      int status = PyList_Append(b->identifiers, tuple);
+      Py_DECREF(tuple);
+      if (status != 0)
+        return -1;
+    }
+  }
+  b->pending_num = 0;
+  return 0;
+}
+
+/* Removes the identifiers which have not been written for
+ * CPY_BATCH_EXPIRE_INTERVALS intervals. Since the ids of the remaining
+ * identifiers change, a new list replaces "identifiers"; callbacks still
+ * working on the old list are not affected. Must only be called when the
+ * batch is empty and all pending identifiers have been added.
+ * You must hold the GIL and b->lock to call this function! */
+static void cpy_batch_expire(cpy_batch_t *b, cdtime_t now) {
+  c_avl_iterator_t *iter;
+  char *key;
+  cpy_batch_entry_t *entry;
+  char **expired = NULL;
+  size_t expired_num = 0;
+
+  iter = c_avl_get_iterator(b->index);
+  if (iter == NULL)
+    return;
+  while (c_avl_iterator_next(iter, (void *)&key, (void *)&entry) == 0) {
+    if (entry->last_write + CPY_BATCH_EXPIRE_INTERVALS * entry->interval > now)
+      continue;
+
+    char **tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
+    if (tmp == NULL)
+      break;
+    expired = tmp;
+    expired[expired_num] = key;
+    expired_num++;
+  }
+  c_avl_iterator_destroy(iter);
+
+  if (expired_num == 0) {
+    free(expired);
+    return;
+  }
+
+  for (size_t i = 0; i < expired_num; i++) {
+    if (c_avl_remove(b->index, expired[i], (void *)&key, (void *)&entry) != 0)
+      continue;
+    free(key);
+    free(entry);
+  }
+  free(expired);
+
+  /* Copy the remaining identifiers to a new list and renumber them. */
+  PyObject *identifiers = PyList_New(0); /* New reference. */
+  if (identifiers == NULL) {
+    cpy_log_exception("batch write callback");
+    return;
+  }
+
+  iter = c_avl_get_iterator(b->index);
+  if (iter == NULL) {
+    Py_DECREF(identifiers);
+    return;
+  }
+  while (c_avl_iterator_next(iter, (void *)&key, (void *)&entry) == 0) {
+    for (size_t i = 0; i < entry->ds_num; i++) {
+      /* Borrowed reference. */
+      PyObject *tuple =
+          PyList_GET_ITEM(b->identifiers, (Py_ssize_t)(entry->id + i));
+      if (PyList_Append(identifiers, tuple) != 0) {
+        /* Keep the old list and ids. */
+        cpy_log_exception("batch write callback");
+        c_avl_iterator_destroy(iter);
+        Py_DECREF(identifiers);
+        return;
+      }
+    }
+  }
+  c_avl_iterator_destroy(iter);
+
+  /* The new list is complete, renumber the identifiers in the same order. */
+  unsigned int id = 0;
+  iter = c_avl_get_iterator(b->index);
+  if (iter == NULL) {
+    Py_DECREF(identifiers);
+    return;
+  }
+  while (c_avl_iterator_next(iter, (void *)&key, (void *)&entry) == 0) {
+    entry->id = id;
+    id += (unsigned int)entry->ds_num;
+  }
+  c_avl_iterator_destroy(iter);
+
+  Py_DECREF(b->identifiers);
+  b->identifiers = identifiers;
+  b->num_ids = (unsigned int)PyList_GET_SIZE(identifiers);
+}
+
+/* Passes the collected rows to Python.
+ * NOTE: You must hold the GIL, but not b->lock, when calling this function! */
+static int cpy_batch_send(cpy_batch_t *b) {
+  PyObject *ids = NULL, *times = NULL, *values = NULL, *identifiers = NULL,
+           *ret = NULL;
+  PyObject *ids_column, *times_column, *values_column;
+  size_t num;
+  int status = -1;
+
+  pthread_mutex_lock(&b->lock);
+  /* Allocating the columns failed last time, try again. */
+  if (b->ids == NULL && cpy_batch_alloc(b) != 0) {
+    pthread_mutex_unlock(&b->lock);
+    cpy_log_exception("batch write callback");
+    return -1;
+  }
+  if (b->num == 0) {
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+  }
+
+  /* Take the rows, so that writers can go on while Python works on them.
+   * The callback may keep references to the columns, so they are replaced
+   * rather than reused. */
+  ids_column = b->ids;
+  times_column = b->times;
+  values_column = b->values;
+  num = b->num;
+  b->ids = b->times = b->values = NULL;
+  b->num = 0;
+  if (cpy_batch_alloc(b) != 0)
+    cpy_log_exception("batch write callback");
+
+  int add_status = cpy_batch_add_identifiers(b);
+  identifiers = b->identifiers;
+  Py_INCREF(identifiers);
+
+  cdtime_t now = cdtime();
+  if ((add_status == 0) && (b->next_expire <= now)) {
+    cpy_batch_expire(b, now);
+    b->next_expire = now + plugin_get_interval();
+  }
+  pthread_mutex_unlock(&b->lock);
+
+  if (add_status != 0)
+    goto out;
+
+  ids = cpy_batch_column(ids_column, num * sizeof(unsigned int), "I");
+  times = cpy_batch_column(times_column, num * sizeof(double), "d");
+  values = cpy_batch_column(values_column, num * sizeof(double), "d");
+  if (ids == NULL || times == NULL || values == NULL)
+    goto out;
+
+  ret = PyObject_CallFunctionObjArgs(b->callback, ids, times, values,
+                                     identifiers, b->data,
+                                     (void *)0); /* New reference. */
+  if (ret != NULL)
+    status = 0;
+
+out:
+  if (status != 0)
+    cpy_log_exception("batch write callback");
+  Py_XDECREF(ret);
+  Py_XDECREF(ids);
+  Py_XDECREF(times);
+  Py_XDECREF(values);
+  Py_XDECREF(ids_column);
+  Py_XDECREF(times_column);
+  Py_XDECREF(values_column);
+  Py_XDECREF(identifiers);
+  return status;
+}
+
+/* Takes the GIL and sends the batch.
+ * NOTE: You must not hold b->lock when calling this function! */
+static int cpy_batch_send_threads(cpy_batch_t *b) {
+  int status;
+
+  CPY_LOCK_INTERP(b->interp)
+  status = cpy_batch_send(b);
+  CPY_RELEASE_THREADS
+  return status;
+}
+
+/* Returns the index of the first data source of "vl" in "identifiers".
+ * NOTE: You must hold b->lock when calling this function! */
+static int cpy_batch_lookup(cpy_batch_t *b, const data_set_t *ds,
+                            const value_list_t *vl, unsigned int *ret) {
+  char name[6 * DATA_MAX_NAME_LEN];
+  cpy_batch_entry_t *entry;
+
+  if (FORMAT_VL(name, sizeof(name), vl) != 0)
+    return -1;
+  if (c_avl_get(b->index, name, (void *)&entry) == 0) {
+    entry->last_write = cdtime();
+    entry->interval = vl->interval;
+    *ret = entry->id;
+    return 0;
+  }
+
+  cpy_batch_ident_t *tmp =
+      realloc(b->pending, (b->pending_num + 1) * sizeof(*b->pending));
+  if (tmp == NULL)
+    return -1;
+  b->pending = tmp;
+
+  entry = calloc(1, sizeof(*entry));
+  char *key = strdup(name);
+  if (entry == NULL || key == NULL ||
+      c_avl_insert(b->index, key, entry) != 0) {
+    free(entry);
+    free(key);
+    return -1;
+  }
+  entry->id = b->num_ids;
+  entry->ds_num = ds->ds_num;
+  entry->last_write = cdtime();
+  entry->interval = vl->interval;
+
+  cpy_batch_ident_t *id = b->pending + b->pending_num;
+  sstrncpy(id->host, vl->host, sizeof(id->host));
+  sstrncpy(id->plugin, vl->plugin, sizeof(id->plugin));
+  sstrncpy(id->plugin_instance, vl->plugin_instance,
+           sizeof(id->plugin_instance));
+  sstrncpy(id->type, vl->type, sizeof(id->type));
+  sstrncpy(id->type_instance, vl->type_instance, sizeof(id->type_instance));
+  id->ds = ds;
+  b->pending_num++;
+
+  *ret = b->num_ids;
+  b->num_ids += (unsigned int)ds->ds_num;
+  return 0;
+}
+
+static int cpy_batch_write_callback(const data_set_t *ds,
+                                    const value_list_t *vl, user_data_t *data) {
+  cpy_batch_t *b = data->data;
+  unsigned int id;
+  int status = 0;
+
+  pthread_mutex_lock(&b->lock);
+  if (b->ids == NULL) {
+    /* Sending retries the allocation of the columns. */
+    pthread_mutex_unlock(&b->lock);
+    cpy_batch_send_threads(b);
+    pthread_mutex_lock(&b->lock);
+  }
+  if (b->ids == NULL || cpy_batch_lookup(b, ds, vl, &id) != 0) {
+    pthread_mutex_unlock(&b->lock);
+    ERROR("python: %s: Unable to add \"%s\" to the batch.", b->name,
+          vl->type);
+    return -1;
+  }
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    while (b->num == b->size) {
+      pthread_mutex_unlock(&b->lock);
+      if (cpy_batch_send_threads(b) != 0)
+        status = -1;
+      pthread_mutex_lock(&b->lock);
+      /* Sending may have renumbered the identifiers. */
+      if (b->ids != NULL && cpy_batch_lookup(b, ds, vl, &id) != 0) {
+        status = -1;
+        break;
+      }
+    }
+    if (b->ids == NULL || status != 0)
+      break;
+    if (b->num == 0)
+      b->first = cdtime();
+
+    unsigned int *ids = (unsigned int *)PyByteArray_AS_STRING(b->ids);
+    double *times = (double *)PyByteArray_AS_STRING(b->times);
+    double *values = (double *)PyByteArray_AS_STRING(b->values);
+
+    ids[b->num] = id + (unsigned int)i;
+    times[b->num] = CDTIME_T_TO_DOUBLE(vl->time);
+    switch (ds->ds[i].type) {
+    case DS_TYPE_COUNTER:
+      values[b->num] = (double)vl->values[i].counter;
+      break;
+    case DS_TYPE_GAUGE:
+      values[b->num] = vl->values[i].gauge;
+      break;
+    case DS_TYPE_DERIVE:
+      values[b->num] = (double)vl->values[i].derive;
+      break;
+    case DS_TYPE_ABSOLUTE:
+      values[b->num] = (double)vl->values[i].absolute;
+      break;
+    default:
+      values[b->num] = NAN;
+    }
+    b->num++;
+  }
+
+  bool full = (b->num == b->size);
+  pthread_mutex_unlock(&b->lock);
+
+  if (full && cpy_batch_send_threads(b) != 0)
+    status = -1;
+  return status;
+}
+
+static int cpy_batch_flush_callback(cdtime_t timeout,
+                                    const char __attribute__((unused)) *
+                                        identifier,
+                                    user_data_t *data) {
+  cpy_batch_t *b = data->data;
+
+  pthread_mutex_lock(&b->lock);
+  /* timeout == 0  => flush unconditionally */
+  bool send = (b->num > 0) && (timeout == 0 || b->first + timeout <= cdtime());
+  pthread_mutex_unlock(&b->lock);
+
+  if (!send)
+    return 0;
+  return cpy_batch_send_threads(b);
+}
+
+static void cpy_batch_destroy(void *data) {
+  cpy_batch_t *b = data;
+  void *key, *value;
+  bool finalize;
+
+  while (c_avl_pick(b->index, &key, &value) == 0) {
+    free(key);
+    free(value);
+  }
+  c_avl_destroy(b->index);
+  free(b->pending);
+  pthread_mutex_destroy(&b->lock);
+  free(b->name);
+
+  CPY_LOCK_INTERP(b->interp)
+  Py_DECREF(b->callback);
+  Py_XDECREF(b->data);
+  Py_XDECREF(b->ids);
+  Py_XDECREF(b->times);
+  Py_XDECREF(b->values);
+  Py_XDECREF(b->identifiers);
+  CPY_RELEASE_THREADS
+  free(b);
+
+  pthread_mutex_lock(&cpy_lock);
+  --cpy_num_callbacks;
+  finalize = !cpy_num_callbacks && cpy_shutdown_triggered;
+  pthread_mutex_unlock(&cpy_lock);
+  if (finalize)
+    cpy_finalize();
+}
+
 static PyObject *cpy_register_generic(cpy_callback_t **list_head,
                                       PyObject *args, PyObject *kwds) {
   char buf[512];
@@ -671,9 +1573,12 @@ static PyObject *cpy_register_generic(cpy_callback_t **list_head,
   c->name = strdup(buf);
   c->callback = callback;
   c->data = data;
+  c->interp = cpy_interp_current();
+  pthread_mutex_lock(&cpy_lock);
   c->next = *list_head;
   ++cpy_num_callbacks;
   *list_head = c;
+  pthread_mutex_unlock(&cpy_lock);
   Py_XDECREF(mod);
   PyMem_Free(name);
   return cpy_string_to_unicode_or_bytes(buf);
@@ -771,6 +1676,7 @@ static PyObject *cpy_register_generic_userdata(void *reg, void *handler,
   c->name = strdup(buf);
   c->callback = callback;
   c->data = data;
+  c->interp = cpy_interp_current();
   c->next = NULL;
 
   register_function(buf, handler,
@@ -779,7 +1685,7 @@ static PyObject *cpy_register_generic_userdata(void *reg, void *handler,
                         .free_func = cpy_destroy_user_data,
                     });
 
-  ++cpy_num_callbacks;
+  cpy_callback_added();
   return cpy_string_to_unicode_or_bytes(buf);
 }
 
@@ -813,6 +1719,7 @@ static PyObject *cpy_register_read(PyObject *self, PyObject *args,
   c->name = strdup(buf);
   c->callback = callback;
   c->data = data;
+  c->interp = cpy_interp_current();
   c->next = NULL;
 
   plugin_register_complex_read(
@@ -822,7 +1729,7 @@ static PyObject *cpy_register_read(PyObject *self, PyObject *args,
           .data = c,
           .free_func = cpy_destroy_user_data,
       });
-  ++cpy_num_callbacks;
+  cpy_callback_added();
   return cpy_string_to_unicode_or_bytes(buf);
 }
 
@@ -838,6 +1745,69 @@ static PyObject *cpy_register_write(PyObject *self, PyObject *args,
                                        (void *)cpy_write_callback, args, kwds);
 }
 
+static PyObject *cpy_register_write_batch(PyObject *self, PyObject *args,
+                                          PyObject *kwds) {
+  char buf[512];
+  cpy_batch_t *b;
+  int size = CPY_BATCH_DEFAULT_SIZE;
+  char *name = NULL;
+  PyObject *callback = NULL, *data = NULL;
+  static char *kwlist[] = {"callback", "size", "data", "name", NULL};
+
+  if (PyArg_ParseTupleAndKeywords(args, kwds, "O|iOet", kwlist, &callback,
+                                  &size, &data, NULL, &name) == 0)
+    return NULL;
+  if (PyCallable_Check(callback) == 0) {
+    PyMem_Free(name);
+    PyErr_SetString(PyExc_TypeError, "callback needs a be a callable object.");
+    return NULL;
+  }
+  if (size < 1) {
+    PyMem_Free(name);
+    PyErr_SetString(PyExc_ValueError, "size must be positive.");
+    return NULL;
+  }
+  cpy_build_name(buf, sizeof(buf), callback, name);
+  PyMem_Free(name);
+
+  b = calloc(1, sizeof(*b));
+  if (b == NULL)
+    return PyErr_NoMemory();
+
+  b->size = (size_t)size;
+  b->index = c_avl_create((int (*)(const void *, const void *))strcmp);
+  b->identifiers = PyList_New(0); /* New reference. */
+  if (b->index == NULL || b->identifiers == NULL || cpy_batch_alloc(b) != 0) {
+    if (b->index != NULL)
+      c_avl_destroy(b->index);
+    Py_XDECREF(b->identifiers);
+    free(b);
+    if (PyErr_Occurred() == NULL)
+      PyErr_NoMemory();
+    return NULL;
+  }
+  pthread_mutex_init(&b->lock, NULL);
+
+  Py_INCREF(callback);
+  Py_XINCREF(data);
+  b->name = strdup(buf);
+  b->callback = callback;
+  b->data = data;
+  b->interp = cpy_interp_current();
+
+  plugin_register_flush(buf, cpy_batch_flush_callback,
+                        &(user_data_t){
+                            .data = b,
+                        });
+  plugin_register_write(buf, cpy_batch_write_callback,
+                        &(user_data_t){
+                            .data = b,
+                            .free_func = cpy_batch_destroy,
+                        });
+  cpy_callback_added();
+  return cpy_string_to_unicode_or_bytes(buf);
+}
+
 static PyObject *cpy_register_notification(PyObject *self, PyObject *args,
                                            PyObject *kwds) {
   return cpy_register_generic_userdata((void *)plugin_register_notification,
@@ -933,33 +1903,39 @@ static PyObject *cpy_unregister_generic(cpy_callback_t **list_head,
     cpy_build_name(buf, sizeof(buf), arg, NULL);
     name = buf;
   }
+  pthread_mutex_lock(&cpy_lock);
   for (tmp = *list_head; tmp; prev = tmp, tmp = tmp->next)
     if (strcmp(name, tmp->name) == 0)
       break;
 
   Py_DECREF(arg);
   if (tmp == NULL) {
+    pthread_mutex_unlock(&cpy_lock);
     PyErr_Format(PyExc_RuntimeError, "Unable to unregister %s callback '%s'.",
                  desc, name);
     return NULL;
   }
-  /* Yes, this is actually safe. To call this function the caller has to
-   * hold the GIL. Well, safe as long as there is only one GIL anyway ... */
   if (prev == NULL)
     *list_head = tmp->next;
   else
     prev->next = tmp->next;
+  pthread_mutex_unlock(&cpy_lock);
   cpy_destroy_user_data(tmp);
   Py_RETURN_NONE;
 }
 
 static void cpy_unregister_list(cpy_callback_t **list_head) {
   cpy_callback_t *cur, *next;
-  for (cur = *list_head; cur; cur = next) {
+
+  pthread_mutex_lock(&cpy_lock);
+  cur = *list_head;
+  *list_head = NULL;
+  pthread_mutex_unlock(&cpy_lock);
+
+  for (; cur; cur = next) {
     next = cur->next;
     cpy_destroy_user_data(cur);
   }
-  *list_head = NULL;
 }
 
 typedef int cpy_unregister_function_t(const char *name);
@@ -1035,6 +2011,7 @@ static PyMethodDef cpy_methods[] = {
     {"error", cpy_error, METH_VARARGS, log_doc},
     {"get_dataset", (PyCFunction)cpy_get_dataset, METH_VARARGS, get_ds_doc},
     {"flush", (PyCFunction)cpy_flush, METH_VARARGS | METH_KEYWORDS, flush_doc},
+    {"dispatch_values", cpy_dispatch_values, METH_O, dispatch_values_doc},
     {"register_log", (PyCFunction)cpy_register_log,
      METH_VARARGS | METH_KEYWORDS, reg_log_doc},
     {"register_init", (PyCFunction)cpy_register_init,
@@ -1045,6 +2022,8 @@ static PyMethodDef cpy_methods[] = {
      METH_VARARGS | METH_KEYWORDS, reg_read_doc},
     {"register_write", (PyCFunction)cpy_register_write,
      METH_VARARGS | METH_KEYWORDS, reg_write_doc},
+    {"register_write_batch", (PyCFunction)cpy_register_write_batch,
+     METH_VARARGS | METH_KEYWORDS, reg_write_batch_doc},
     {"register_notification", (PyCFunction)cpy_register_notification,
      METH_VARARGS | METH_KEYWORDS, reg_notification_doc},
     {"register_flush", (PyCFunction)cpy_register_flush,
@@ -1064,6 +2043,7 @@ static PyMethodDef cpy_methods[] = {
 
 static int cpy_shutdown(void) {
   PyObject *ret;
+  bool finalize;
 
   if (!state) {
     printf(
@@ -1078,31 +2058,28 @@ static int cpy_shutdown(void) {
         "================================================================\n");
   }
 
-  CPY_LOCK_THREADS
-
   for (cpy_callback_t *c = cpy_shutdown_callbacks; c; c = c->next) {
+    CPY_LOCK_INTERP(c->interp)
     ret = PyObject_CallFunctionObjArgs(c->callback, c->data,
                                        (void *)0); /* New reference. */
     if (ret == NULL)
       cpy_log_exception("shutdown callback");
     else
       Py_DECREF(ret);
+    PyErr_Print();
+    CPY_RELEASE_THREADS
   }
-  PyErr_Print();
 
-  Py_BEGIN_ALLOW_THREADS;
   cpy_unregister_list(&cpy_config_callbacks);
   cpy_unregister_list(&cpy_init_callbacks);
   cpy_unregister_list(&cpy_shutdown_callbacks);
-  cpy_shutdown_triggered = 1;
-  Py_END_ALLOW_THREADS;
-
-  if (!cpy_num_callbacks) {
-    Py_Finalize();
-    return 0;
-  }
 
-  CPY_RELEASE_THREADS
+  pthread_mutex_lock(&cpy_lock);
+  cpy_shutdown_triggered = 1;
+  finalize = !cpy_num_callbacks;
+  pthread_mutex_unlock(&cpy_lock);
+  if (finalize)
+    cpy_finalize();
   return 0;
 }
 
@@ -1181,16 +2158,16 @@ static int cpy_init(void) {
     PyEval_InitThreads();
     state = PyEval_SaveThread();
   }
-  CPY_LOCK_THREADS
   for (cpy_callback_t *c = cpy_init_callbacks; c; c = c->next) {
+    CPY_LOCK_INTERP(c->interp)
     ret = PyObject_CallFunctionObjArgs(c->callback, c->data,
                                        (void *)0); /* New reference. */
     if (ret == NULL)
       cpy_log_exception("init callback");
     else
       Py_DECREF(ret);
+    CPY_RELEASE_THREADS
   }
-  CPY_RELEASE_THREADS
 
   return 0;
 }
@@ -1216,8 +2193,8 @@ static PyObject *cpy_oconfig_to_pyconfig(oconfig_item_t *ci, PyObject *parent) {
   }
 
   tmp = cpy_string_to_unicode_or_bytes(ci->key);
-  item = PyObject_CallFunction((void *)&ConfigType, "NONO", tmp, parent, values,
-                               Py_None);
+  item = PyObject_CallFunction((void *)cpy_types()->config, "NONO", tmp, parent,
+                               values, Py_None);
   if (item == NULL)
     return NULL;
   children = PyTuple_New(ci->children_num); /* New reference. */
@@ -1231,20 +2208,124 @@ static PyObject *cpy_oconfig_to_pyconfig(oconfig_item_t *ci, PyObject *parent) {
   return item;
 }
 
+/* Adds the types, the exception and the constants to the collectd module.
+ * This runs once in every interpreter. */
+static int cpy_module_exec(PyObject *module) {
+  cpy_interp_t *interp = cpy_interp_current();
+  const cpy_types_t *types = &interp->types;
+  PyObject *errordict;
+
+#ifdef CPY_HAVE_OWN_GIL
+  if (interp != &cpy_main_interp && cpy_interp_init_types(interp) != 0)
+    return -1;
+#endif
+
+  if (interp->collectd_error == NULL) {
+    errordict = PyDict_New();
+    PyDict_SetItemString(
+        errordict, "__doc__",
+        cpy_string_to_unicode_or_bytes(CollectdError_doc)); /* New reference. */
+    interp->collectd_error =
+        PyErr_NewException("collectd.CollectdError", NULL, errordict);
+  }
+
+  Py_INCREF(types->config);
+  PyModule_AddObject(module, "Config",
+                     (void *)types->config); /* Steals a reference. */
+  Py_INCREF(types->values);
+  PyModule_AddObject(module, "Values",
+                     (void *)types->values); /* Steals a reference. */
+  Py_INCREF(types->notification);
+  PyModule_AddObject(module, "Notification",
+                     (void *)types->notification); /* Steals a reference. */
+  Py_INCREF(types->signed_type);
+  PyModule_AddObject(module, "Signed",
+                     (void *)types->signed_type); /* Steals a reference. */
+  Py_INCREF(types->unsigned_type);
+  PyModule_AddObject(module, "Unsigned",
+                     (void *)types->unsigned_type); /* Steals a reference. */
+  Py_XINCREF(interp->collectd_error);
+  PyModule_AddObject(module, "CollectdError",
+                     interp->collectd_error); /* Steals a reference. */
+  PyModule_AddIntConstant(module, "LOG_DEBUG", LOG_DEBUG);
+  PyModule_AddIntConstant(module, "LOG_INFO", LOG_INFO);
+  PyModule_AddIntConstant(module, "LOG_NOTICE", LOG_NOTICE);
+  PyModule_AddIntConstant(module, "LOG_WARNING", LOG_WARNING);
+  PyModule_AddIntConstant(module, "LOG_ERROR", LOG_ERR);
+  PyModule_AddIntConstant(module, "NOTIF_FAILURE", NOTIF_FAILURE);
+  PyModule_AddIntConstant(module, "NOTIF_WARNING", NOTIF_WARNING);
+  PyModule_AddIntConstant(module, "NOTIF_OKAY", NOTIF_OKAY);
+  PyModule_AddStringConstant(module, "DS_TYPE_COUNTER",
+                             DS_TYPE_TO_STRING(DS_TYPE_COUNTER));
+  PyModule_AddStringConstant(module, "DS_TYPE_GAUGE",
+                             DS_TYPE_TO_STRING(DS_TYPE_GAUGE));
+  PyModule_AddStringConstant(module, "DS_TYPE_DERIVE",
+                             DS_TYPE_TO_STRING(DS_TYPE_DERIVE));
+  PyModule_AddStringConstant(module, "DS_TYPE_ABSOLUTE",
+                             DS_TYPE_TO_STRING(DS_TYPE_ABSOLUTE));
+  return 0;
+}
+
 #ifdef IS_PY3K
+#if PY_VERSION_HEX >= 0x03050000
+#ifdef CPY_HAVE_OWN_GIL
+/* Releases what cpy_module_exec() created for an isolated interpreter. */
+static void cpy_module_free(void __attribute__((unused)) * module) {
+  cpy_interp_t *interp = cpy_interp_current();
+
+  if (interp == &cpy_main_interp)
+    return;
+  Py_CLEAR(interp->collectd_error);
+  cpy_interp_clear_types(interp);
+}
+#endif
+
+/* Multi-phase initialization, so that every interpreter gets its own module
+ * object. */
+static PyModuleDef_Slot cpy_module_slots[] = {
+    {Py_mod_exec, cpy_module_exec},
+#ifdef CPY_HAVE_OWN_GIL
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+    {0, NULL}};
+
+static struct PyModuleDef collectdmodule = {
+    PyModuleDef_HEAD_INIT,
+    "collectd",                         /* name of module */
+    "The python interface to collectd", /* module documentation, may be NULL */
+    0,
+    cpy_methods,
+    cpy_module_slots,
+    NULL,
+    NULL,
+#ifdef CPY_HAVE_OWN_GIL
+    cpy_module_free,
+#else
+    NULL,
+#endif
+};
+
+PyMODINIT_FUNC PyInit_collectd(void) {
+  return PyModuleDef_Init(&collectdmodule);
+}
+#else
 static struct PyModuleDef collectdmodule = {
     PyModuleDef_HEAD_INIT, "collectd",  /* name of module */
     "The python interface to collectd", /* module documentation, may be NULL */
     -1, cpy_methods};
 
 PyMODINIT_FUNC PyInit_collectd(void) {
-  return PyModule_Create(&collectdmodule);
+  PyObject *module = PyModule_Create(&collectdmodule);
+  if (module != NULL && cpy_module_exec(module) != 0)
+    Py_CLEAR(module);
+  return module;
 }
 #endif
+#endif
 
 static int cpy_init_python(void) {
   PyOS_sighandler_t cur_sig;
-  PyObject *sys, *errordict;
+  PyObject *sys;
   PyObject *module;
 
 #ifdef IS_PY3K
@@ -1261,6 +2342,14 @@ static int cpy_init_python(void) {
   Py_Initialize();
   python_sigint_handler = PyOS_setsig(SIGINT, cur_sig);
 
+#ifdef CPY_HAVE_OWN_GIL
+  cpy_main_interp.interp = PyInterpreterState_Get();
+  if (pthread_key_create(&cpy_main_interp.tstate_key, NULL) != 0) {
+    ERROR("python plugin: pthread_key_create failed.");
+    return 1;
+  }
+#endif
+
   if (PyType_Ready(&ConfigType) == -1) {
     cpy_log_exception("python initialization: ConfigType");
     return 1;
@@ -1289,11 +2378,6 @@ static int cpy_init_python(void) {
     cpy_log_exception("python initialization: UnsignedType");
     return 1;
   }
-  errordict = PyDict_New();
-  PyDict_SetItemString(
-      errordict, "__doc__",
-      cpy_string_to_unicode_or_bytes(CollectdError_doc)); /* New reference. */
-  CollectdError = PyErr_NewException("collectd.CollectdError", NULL, errordict);
   sys = PyImport_ImportModule("sys"); /* New reference. */
   if (sys == NULL) {
     cpy_log_exception("python initialization");
@@ -1309,39 +2393,16 @@ static int cpy_init_python(void) {
   PyList_SetSlice(sys_path, 0, 1, NULL);
 
 #ifdef IS_PY3K
-  module = PyImport_ImportModule("collectd");
+  module = PyImport_ImportModule("collectd"); /* New reference. */
+  if (module == NULL) {
+    cpy_log_exception("python initialization");
+    return 1;
+  }
+  Py_DECREF(module);
 #else
   module = Py_InitModule("collectd", cpy_methods); /* Borrowed reference. */
+  cpy_module_exec(module);
 #endif
-  PyModule_AddObject(module, "Config",
-                     (void *)&ConfigType); /* Steals a reference. */
-  PyModule_AddObject(module, "Values",
-                     (void *)&ValuesType); /* Steals a reference. */
-  PyModule_AddObject(module, "Notification",
-                     (void *)&NotificationType); /* Steals a reference. */
-  PyModule_AddObject(module, "Signed",
-                     (void *)&SignedType); /* Steals a reference. */
-  PyModule_AddObject(module, "Unsigned",
-                     (void *)&UnsignedType); /* Steals a reference. */
-  Py_XINCREF(CollectdError);
-  PyModule_AddObject(module, "CollectdError",
-                     CollectdError); /* Steals a reference. */
-  PyModule_AddIntConstant(module, "LOG_DEBUG", LOG_DEBUG);
-  PyModule_AddIntConstant(module, "LOG_INFO", LOG_INFO);
-  PyModule_AddIntConstant(module, "LOG_NOTICE", LOG_NOTICE);
-  PyModule_AddIntConstant(module, "LOG_WARNING", LOG_WARNING);
-  PyModule_AddIntConstant(module, "LOG_ERROR", LOG_ERR);
-  PyModule_AddIntConstant(module, "NOTIF_FAILURE", NOTIF_FAILURE);
-  PyModule_AddIntConstant(module, "NOTIF_WARNING", NOTIF_WARNING);
-  PyModule_AddIntConstant(module, "NOTIF_OKAY", NOTIF_OKAY);
-  PyModule_AddStringConstant(module, "DS_TYPE_COUNTER",
-                             DS_TYPE_TO_STRING(DS_TYPE_COUNTER));
-  PyModule_AddStringConstant(module, "DS_TYPE_GAUGE",
-                             DS_TYPE_TO_STRING(DS_TYPE_GAUGE));
-  PyModule_AddStringConstant(module, "DS_TYPE_DERIVE",
-                             DS_TYPE_TO_STRING(DS_TYPE_DERIVE));
-  PyModule_AddStringConstant(module, "DS_TYPE_ABSOLUTE",
-                             DS_TYPE_TO_STRING(DS_TYPE_ABSOLUTE));
   return 0;
 }
 
@@ -1394,11 +2455,11 @@ static int cpy_config(oconfig_item_t *ci) {
         continue;
       }
       if (!log_traces) {
-        Py_XDECREF(cpy_format_exception);
-        cpy_format_exception = NULL;
+        Py_XDECREF(cpy_main_interp.format_exception);
+        cpy_main_interp.format_exception = NULL;
         continue;
       }
-      if (cpy_format_exception)
+      if (cpy_main_interp.format_exception)
         continue;
       tb = PyImport_ImportModule("traceback"); /* New reference. */
       if (tb == NULL) {
@@ -1406,10 +2467,10 @@ static int cpy_config(oconfig_item_t *ci) {
         status = 1;
         continue;
       }
-      cpy_format_exception =
+      cpy_main_interp.format_exception =
           PyObject_GetAttrString(tb, "format_exception"); /* New reference. */
       Py_DECREF(tb);
-      if (cpy_format_exception == NULL) {
+      if (cpy_main_interp.format_exception == NULL) {
         cpy_log_exception("python initialization");
         status = 1;
       }
@@ -1456,6 +2517,23 @@ static int cpy_config(oconfig_item_t *ci) {
       }
       free(module_name);
       Py_XDECREF(module);
+    } else if (strcasecmp(item->key, "ImportIsolated") == 0) {
+      char *module_name = NULL;
+
+      if (cf_util_get_string(item, &module_name) != 0) {
+        status = 1;
+        continue;
+      }
+#ifdef CPY_HAVE_OWN_GIL
+      if (cpy_import_isolated(module_name) != 0)
+        status = 1;
+#else
+      ERROR("python plugin: \"ImportIsolated\" requires Python 3.12 or later, "
+            "not loading module \"%s\".",
+            module_name);
+      status = 1;
+#endif
+      free(module_name);
     } else if (strcasecmp(item->key, "Module") == 0) {
       char *name = NULL;
       cpy_callback_t *c;
@@ -1478,6 +2556,7 @@ static int cpy_config(oconfig_item_t *ci) {
         continue;
       }
       free(name);
+      CPY_LOCK_INTERP(c->interp)
       if (c->data == NULL)
         ret = PyObject_CallFunction(
             c->callback, "N",
@@ -1491,6 +2570,7 @@ static int cpy_config(oconfig_item_t *ci) {
         status = 1;
       } else
         Py_DECREF(ret);
+      CPY_RELEASE_THREADS
     } else {
       ERROR("python plugin: Unknown config key \"%s\".", item->key);
       status = 1;
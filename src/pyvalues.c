@@ -52,64 +52,45 @@ typedef struct {
 
 static PyObject *cpy_common_repr(PyObject *s) {
   PyObject *ret, *tmp;
-  static PyObject *l_type, *l_type_instance, *l_plugin, *l_plugin_instance;
-  static PyObject *l_host, *l_time;
   PluginData *self = (PluginData *)s;
 
-  if (l_type == NULL)
-    l_type = cpy_string_to_unicode_or_bytes("(type=");
-  if (l_type_instance == NULL)
-    l_type_instance = cpy_string_to_unicode_or_bytes(",type_instance=");
-  if (l_plugin == NULL)
-    l_plugin = cpy_string_to_unicode_or_bytes(",plugin=");
-  if (l_plugin_instance == NULL)
-    l_plugin_instance = cpy_string_to_unicode_or_bytes(",plugin_instance=");
-  if (l_host == NULL)
-    l_host = cpy_string_to_unicode_or_bytes(",host=");
-  if (l_time == NULL)
-    l_time = cpy_string_to_unicode_or_bytes(",time=");
-
-  if (!l_type || !l_type_instance || !l_plugin || !l_plugin_instance ||
-      !l_host || !l_time)
-    return NULL;
-
   ret = cpy_string_to_unicode_or_bytes(s->ob_type->tp_name);
 
-  CPY_STRCAT(&ret, l_type);
+  cpy_strcat_string(&ret, "(type=");
   tmp = cpy_string_to_unicode_or_bytes(self->type);
   CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
   CPY_STRCAT_AND_DEL(&ret, tmp);
 
   if (self->type_instance[0] != 0) {
-    CPY_STRCAT(&ret, l_type_instance);
+    cpy_strcat_string(&ret, ",type_instance=");
     tmp = cpy_string_to_unicode_or_bytes(self->type_instance);
     CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
 
   if (self->plugin[0] != 0) {
-    CPY_STRCAT(&ret, l_plugin);
+    cpy_strcat_string(&ret, ",plugin=");
     tmp = cpy_string_to_unicode_or_bytes(self->plugin);
     CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
 
   if (self->plugin_instance[0] != 0) {
-    CPY_STRCAT(&ret, l_plugin_instance);
+    cpy_strcat_string(&ret, ",plugin_instance=");
     tmp = cpy_string_to_unicode_or_bytes(self->plugin_instance);
     CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
 
   if (self->host[0] != 0) {
-    CPY_STRCAT(&ret, l_host);
+    cpy_strcat_string(&ret, ",host=");
     tmp = cpy_string_to_unicode_or_bytes(self->host);
     CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
 
   if (self->time != 0) {
-    CPY_STRCAT(&ret, l_time);
+    cpy_strcat_string(&ret, ",time=");
     tmp = PyFloat_FromDouble(self->time);
     CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
     CPY_STRCAT_AND_DEL(&ret, tmp);
@@ -202,16 +183,9 @@ static int PluginData_init(PyObject *s, PyObject *args, PyObject *kwds) {
 
 static PyObject *PluginData_repr(PyObject *s) {
   PyObject *ret;
-  static PyObject *l_closing;
-
-  if (l_closing == NULL)
-    l_closing = cpy_string_to_unicode_or_bytes(")");
-
-  if (l_closing == NULL)
-    return NULL;
 
   ret = cpy_common_repr(s);
-  CPY_STRCAT(&ret, l_closing);
+  cpy_strcat_string(&ret, ")");
   return ret;
 }
 
@@ -325,6 +299,21 @@ PyTypeObject PluginDataType = {
     PluginData_new                                    /* tp_new */
 };
 
+#ifdef CPY_HAVE_OWN_GIL
+static PyType_Slot PluginData_slots[] = {
+    {Py_tp_repr, PluginData_repr},
+    {Py_tp_doc, PluginData_doc},
+    {Py_tp_members, PluginData_members},
+    {Py_tp_getset, PluginData_getseters},
+    {Py_tp_init, PluginData_init},
+    {Py_tp_new, PluginData_new},
+    {0, NULL}};
+
+PyType_Spec PluginDataSpec = {
+    "collectd.PluginData", sizeof(PluginData), 0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, PluginData_slots};
+#endif
+
 static char interval_doc[] =
     "The interval is the timespan in seconds between two submits for\n"
     "the same data source. This value has to be a positive integer, so you "
@@ -505,12 +494,12 @@ static int cpy_build_meta_generic(PyObject *meta,
       meta_func->add_boolean(m, keystring, 0);
     } else if (PyFloat_Check(value)) {
       meta_func->add_double(m, keystring, PyFloat_AsDouble(value));
-    } else if (PyObject_TypeCheck(value, &SignedType)) {
+    } else if (PyObject_TypeCheck(value, cpy_types()->signed_type)) {
       long long int lli;
       lli = PyLong_AsLongLong(value);
       if (!PyErr_Occurred() && (lli == (int64_t)lli))
         meta_func->add_signed_int(m, keystring, lli);
-    } else if (PyObject_TypeCheck(value, &UnsignedType)) {
+    } else if (PyObject_TypeCheck(value, cpy_types()->unsigned_type)) {
       long long unsigned llu;
       llu = PyLong_AsUnsignedLongLong(value);
       if (!PyErr_Occurred() && (llu == (uint64_t)llu))
@@ -586,6 +575,67 @@ static void cpy_build_notification_meta(notification_t *n, PyObject *meta) {
   cpy_build_meta_generic(meta, &cpy_plugin_notification_meta, (void *)n);
 }
 
+/* Converts the sequence "values" to the value_t array expected by the data
+ * set "ds". The caller is responsible for checking the number of values and
+ * for freeing the returned array. Returns NULL with an exception set on
+ * error. */
+static value_t *cpy_build_values(const data_set_t *ds, PyObject *values) {
+  size_t size = ds->ds_num;
+  value_t *value = calloc(size, sizeof(*value));
+  if (value == NULL) {
+    PyErr_NoMemory();
+    return NULL;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    PyObject *item, *num;
+    item = PySequence_Fast_GET_ITEM(values, i); /* Borrowed reference. */
+    switch (ds->ds[i].type) {
+    case DS_TYPE_COUNTER:
+      num = PyNumber_Long(item); /* New reference. */
+      if (num != NULL) {
+        value[i].counter = PyLong_AsUnsignedLongLong(num);
+        Py_XDECREF(num);
+      }
+      break;
+    case DS_TYPE_GAUGE:
+      num = PyNumber_Float(item); /* New reference. */
+      if (num != NULL) {
+        value[i].gauge = PyFloat_AsDouble(num);
+        Py_XDECREF(num);
+      }
+      break;
+    case DS_TYPE_DERIVE:
+      /* This might overflow without raising an exception.
+       * Not much we can do about it */
+      num = PyNumber_Long(item); /* New reference. */
+      if (num != NULL) {
+        value[i].derive = PyLong_AsLongLong(num);
+        Py_XDECREF(num);
+      }
+      break;
+    case DS_TYPE_ABSOLUTE:
+      /* This might overflow without raising an exception.
+       * Not much we can do about it */
+      num = PyNumber_Long(item); /* New reference. */
+      if (num != NULL) {
+        value[i].absolute = PyLong_AsUnsignedLongLong(num);
+        Py_XDECREF(num);
+      }
+      break;
+    default:
+      free(value);
+      PyErr_Format(PyExc_RuntimeError, "unknown data type %d for %s",
+                   ds->ds[i].type, ds->type);
+      return NULL;
+    }
+    if (PyErr_Occurred() != NULL) {
+      free(value);
+      return NULL;
+    }
+  }
+  return value;
+}
+
 static PyObject *Values_dispatch(Values *self, PyObject *args, PyObject *kwds) {
   int ret;
   const data_set_t *ds;
@@ -645,54 +695,9 @@ static PyObject *Values_dispatch(Values *self, PyObject *args, PyObject *kwds) {
                  value_list.type, ds->ds_num, size);
     return NULL;
   }
-  value = calloc(size, sizeof(*value));
-  for (size_t i = 0; i < size; ++i) {
-    PyObject *item, *num;
-    item = PySequence_Fast_GET_ITEM(values, (int)i); /* Borrowed reference. */
-    switch (ds->ds[i].type) {
-    case DS_TYPE_COUNTER:
-      num = PyNumber_Long(item); /* New reference. */
-      if (num != NULL) {
-        value[i].counter = PyLong_AsUnsignedLongLong(num);
-        Py_XDECREF(num);
-      }
-      break;
-    case DS_TYPE_GAUGE:
-      num = PyNumber_Float(item); /* New reference. */
-      if (num != NULL) {
-        value[i].gauge = PyFloat_AsDouble(num);
-        Py_XDECREF(num);
-      }
-      break;
-    case DS_TYPE_DERIVE:
-      /* This might overflow without raising an exception.
-       * Not much we can do about it */
-      num = PyNumber_Long(item); /* New reference. */
-      if (num != NULL) {
-        value[i].derive = PyLong_AsLongLong(num);
-        Py_XDECREF(num);
-      }
-      break;
-    case DS_TYPE_ABSOLUTE:
-      /* This might overflow without raising an exception.
-       * Not much we can do about it */
-      num = PyNumber_Long(item); /* New reference. */
-      if (num != NULL) {
-        value[i].absolute = PyLong_AsUnsignedLongLong(num);
-        Py_XDECREF(num);
-      }
-      break;
-    default:
-      free(value);
-      PyErr_Format(PyExc_RuntimeError, "unknown data type %d for %s",
-                   ds->ds[i].type, value_list.type);
-      return NULL;
-    }
-    if (PyErr_Occurred() != NULL) {
-      free(value);
-      return NULL;
-    }
-  }
+  value = cpy_build_values(ds, values);
+  if (value == NULL)
+    return NULL;
   value_list.values = value;
   value_list.meta = cpy_build_meta(meta);
   value_list.values_len = size;
@@ -770,54 +775,9 @@ static PyObject *Values_write(Values *self, PyObject *args, PyObject *kwds) {
                  value_list.type, ds->ds_num, size);
     return NULL;
   }
-  value = calloc(size, sizeof(*value));
-  for (size_t i = 0; i < size; ++i) {
-    PyObject *item, *num;
-    item = PySequence_Fast_GET_ITEM(values, i); /* Borrowed reference. */
-    switch (ds->ds[i].type) {
-    case DS_TYPE_COUNTER:
-      num = PyNumber_Long(item); /* New reference. */
-      if (num != NULL) {
-        value[i].counter = PyLong_AsUnsignedLongLong(num);
-        Py_XDECREF(num);
-      }
-      break;
-    case DS_TYPE_GAUGE:
-      num = PyNumber_Float(item); /* New reference. */
-      if (num != NULL) {
-        value[i].gauge = PyFloat_AsDouble(num);
-        Py_XDECREF(num);
-      }
-      break;
-    case DS_TYPE_DERIVE:
-      /* This might overflow without raising an exception.
-       * Not much we can do about it */
-      num = PyNumber_Long(item); /* New reference. */
-      if (num != NULL) {
-        value[i].derive = PyLong_AsLongLong(num);
-        Py_XDECREF(num);
-      }
-      break;
-    case DS_TYPE_ABSOLUTE:
-      /* This might overflow without raising an exception.
-       * Not much we can do about it */
-      num = PyNumber_Long(item); /* New reference. */
-      if (num != NULL) {
-        value[i].absolute = PyLong_AsUnsignedLongLong(num);
-        Py_XDECREF(num);
-      }
-      break;
-    default:
-      free(value);
-      PyErr_Format(PyExc_RuntimeError, "unknown data type %d for %s",
-                   ds->ds[i].type, value_list.type);
-      return NULL;
-    }
-    if (PyErr_Occurred() != NULL) {
-      free(value);
-      return NULL;
-    }
-  }
+  value = cpy_build_values(ds, values);
+  if (value == NULL)
+    return NULL;
   value_list.values = value;
   value_list.values_len = size;
   value_list.time = DOUBLE_TO_CDTIME_T(time);
@@ -840,44 +800,144 @@ static PyObject *Values_write(Values *self, PyObject *args, PyObject *kwds) {
   Py_RETURN_NONE;
 }
 
+/* Fills "vl" from the members of a Values object, like Values.dispatch()
+ * without arguments does. On success, the caller has to free vl->values and
+ * vl->meta. */
+static int Values_to_value_list(Values *self, value_list_t *vl) {
+  const data_set_t *ds;
+  PyObject *values = self->values, *meta = self->meta;
+
+  sstrncpy(vl->host, self->data.host, sizeof(vl->host));
+  sstrncpy(vl->plugin, self->data.plugin, sizeof(vl->plugin));
+  sstrncpy(vl->plugin_instance, self->data.plugin_instance,
+           sizeof(vl->plugin_instance));
+  sstrncpy(vl->type, self->data.type, sizeof(vl->type));
+  sstrncpy(vl->type_instance, self->data.type_instance,
+           sizeof(vl->type_instance));
+  if (vl->type[0] == 0) {
+    PyErr_SetString(PyExc_RuntimeError, "type not set");
+    return -1;
+  }
+  ds = plugin_get_ds(vl->type);
+  if (ds == NULL) {
+    PyErr_Format(PyExc_TypeError, "Dataset %s not found", vl->type);
+    return -1;
+  }
+  if (values == NULL ||
+      (PyTuple_Check(values) == 0 && PyList_Check(values) == 0)) {
+    PyErr_Format(PyExc_TypeError, "values must be list or tuple");
+    return -1;
+  }
+  if (meta != NULL && meta != Py_None && !PyDict_Check(meta)) {
+    PyErr_Format(PyExc_TypeError, "meta must be a dict");
+    return -1;
+  }
+  if ((size_t)PySequence_Length(values) != ds->ds_num) {
+    PyErr_Format(PyExc_RuntimeError,
+                 "type %s needs %" PRIsz " values, got %" PRIsz, vl->type,
+                 ds->ds_num, (size_t)PySequence_Length(values));
+    return -1;
+  }
+  vl->values = cpy_build_values(ds, values);
+  if (vl->values == NULL)
+    return -1;
+  vl->values_len = ds->ds_num;
+  vl->meta = cpy_build_meta(meta);
+  vl->time = DOUBLE_TO_CDTIME_T(self->data.time);
+  vl->interval = DOUBLE_TO_CDTIME_T(self->interval);
+  if (vl->host[0] == 0)
+    sstrncpy(vl->host, hostname_g, sizeof(vl->host));
+  if (vl->plugin[0] == 0)
+    sstrncpy(vl->plugin, "python", sizeof(vl->plugin));
+  return 0;
+}
+
+/* Implements collectd.dispatch_values(). All Values objects are converted
+ * first, so nothing is dispatched if one of them is invalid, and the GIL is
+ * released only once for the whole batch instead of once per object. */
+PyObject *cpy_dispatch_values(PyObject *self, PyObject *arg) {
+  PyObject *seq;
+  value_list_t *vls;
+  Py_ssize_t num, converted = 0;
+  int failed = 0;
+
+  seq = PySequence_Fast(arg, "argument must be a sequence of Values objects");
+  if (seq == NULL)
+    return NULL;
+  num = PySequence_Fast_GET_SIZE(seq);
+  if (num == 0) {
+    Py_DECREF(seq);
+    Py_RETURN_NONE;
+  }
+
+  vls = calloc((size_t)num, sizeof(*vls));
+  if (vls == NULL) {
+    Py_DECREF(seq);
+    return PyErr_NoMemory();
+  }
+
+  for (; converted < num; converted++) {
+    PyObject *item = PySequence_Fast_GET_ITEM(seq, converted); /* Borrowed. */
+    if (!PyObject_TypeCheck(item, cpy_types()->values)) {
+      PyErr_Format(PyExc_TypeError, "item %zd is not a Values object",
+                   converted);
+      break;
+    }
+    vls[converted] = (value_list_t)VALUE_LIST_INIT;
+    if (Values_to_value_list((Values *)item, vls + converted) != 0)
+      break;
+  }
+
+  if (converted == num) {
+    Py_BEGIN_ALLOW_THREADS;
+    for (Py_ssize_t i = 0; i < num; i++)
+      if (plugin_dispatch_values(vls + i) != 0)
+        failed++;
+    Py_END_ALLOW_THREADS;
+  }
+
+  for (Py_ssize_t i = 0; i < converted; i++) {
+    meta_data_destroy(vls[i].meta);
+    free(vls[i].values);
+  }
+  free(vls);
+  Py_DECREF(seq);
+
+  if (converted != num)
+    return NULL;
+  if (failed != 0) {
+    PyErr_Format(PyExc_RuntimeError,
+                 "error dispatching %d of %zd value lists, read the logs",
+                 failed, num);
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
 static PyObject *Values_repr(PyObject *s) {
   PyObject *ret, *tmp;
-  static PyObject *l_interval, *l_values, *l_meta, *l_closing;
   Values *self = (Values *)s;
 
-  if (l_interval == NULL)
-    l_interval = cpy_string_to_unicode_or_bytes(",interval=");
-  if (l_values == NULL)
-    l_values = cpy_string_to_unicode_or_bytes(",values=");
-  if (l_meta == NULL)
-    l_meta = cpy_string_to_unicode_or_bytes(",meta=");
-  if (l_closing == NULL)
-    l_closing = cpy_string_to_unicode_or_bytes(")");
-
-  if (l_interval == NULL || l_values == NULL || l_meta == NULL ||
-      l_closing == NULL)
-    return NULL;
-
   ret = cpy_common_repr(s);
   if (self->interval != 0) {
-    CPY_STRCAT(&ret, l_interval);
+    cpy_strcat_string(&ret, ",interval=");
     tmp = PyFloat_FromDouble(self->interval);
     CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
   if (self->values &&
       (!PyList_Check(self->values) || PySequence_Length(self->values) > 0)) {
-    CPY_STRCAT(&ret, l_values);
+    cpy_strcat_string(&ret, ",values=");
     tmp = PyObject_Repr(self->values);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
   if (self->meta &&
       (!PyDict_Check(self->meta) || PyDict_Size(self->meta) > 0)) {
-    CPY_STRCAT(&ret, l_meta);
+    cpy_strcat_string(&ret, ",meta=");
     tmp = PyObject_Repr(self->meta);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
-  CPY_STRCAT(&ret, l_closing);
+  cpy_strcat_string(&ret, ")");
   return ret;
 }
 
@@ -885,7 +945,7 @@ static int Values_traverse(PyObject *self, visitproc visit, void *arg) {
   Values *v = (Values *)self;
   Py_VISIT(v->values);
   Py_VISIT(v->meta);
-  return 0;
+  return cpy_traverse_type(self, visit, arg);
 }
 
 static int Values_clear(PyObject *self) {
@@ -897,7 +957,7 @@ static int Values_clear(PyObject *self) {
 
 static void Values_dealloc(PyObject *self) {
   Values_clear(self);
-  self->ob_type->tp_free(self);
+  cpy_free_object(self);
 }
 
 static PyMemberDef Values_members[] = {
@@ -953,6 +1013,25 @@ PyTypeObject ValuesType = {
     Values_new       /* tp_new */
 };
 
+#ifdef CPY_HAVE_OWN_GIL
+static PyType_Slot Values_slots[] = {
+    {Py_tp_dealloc, Values_dealloc},
+    {Py_tp_repr, Values_repr},
+    {Py_tp_doc, Values_doc},
+    {Py_tp_traverse, Values_traverse},
+    {Py_tp_clear, Values_clear},
+    {Py_tp_methods, Values_methods},
+    {Py_tp_members, Values_members},
+    {Py_tp_init, Values_init},
+    {Py_tp_new, Values_new},
+    {0, NULL}};
+
+PyType_Spec ValuesSpec = {"collectd.Values", sizeof(Values), 0,
+                          Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE |
+                              Py_TPFLAGS_HAVE_GC,
+                          Values_slots};
+#endif
+
 static char notification_meta_doc[] =
     "These are the meta data for the Notification object.\n"
     "It has to be a dictionary of numbers, strings or bools. All keys must be\n"
@@ -1144,49 +1223,35 @@ static int Notification_setstring(PyObject *self, PyObject *value, void *data) {
 
 static PyObject *Notification_repr(PyObject *s) {
   PyObject *ret, *tmp;
-  static PyObject *l_severity, *l_message, *l_meta, *l_closing;
   Notification *self = (Notification *)s;
 
-  if (l_severity == NULL)
-    l_severity = cpy_string_to_unicode_or_bytes(",severity=");
-  if (l_message == NULL)
-    l_message = cpy_string_to_unicode_or_bytes(",message=");
-  if (l_meta == NULL)
-    l_meta = cpy_string_to_unicode_or_bytes(",meta=");
-  if (l_closing == NULL)
-    l_closing = cpy_string_to_unicode_or_bytes(")");
-
-  if (l_severity == NULL || l_message == NULL || l_meta == NULL ||
-      l_closing == NULL)
-    return NULL;
-
   ret = cpy_common_repr(s);
   if (self->severity != 0) {
-    CPY_STRCAT(&ret, l_severity);
+    cpy_strcat_string(&ret, ",severity=");
     tmp = PyInt_FromLong(self->severity);
     CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
   if (self->message[0] != 0) {
-    CPY_STRCAT(&ret, l_message);
+    cpy_strcat_string(&ret, ",message=");
     tmp = cpy_string_to_unicode_or_bytes(self->message);
     CPY_SUBSTITUTE(PyObject_Repr, tmp, tmp);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
   if (self->meta &&
       (!PyDict_Check(self->meta) || PyDict_Size(self->meta) > 0)) {
-    CPY_STRCAT(&ret, l_meta);
+    cpy_strcat_string(&ret, ",meta=");
     tmp = PyObject_Repr(self->meta);
     CPY_STRCAT_AND_DEL(&ret, tmp);
   }
-  CPY_STRCAT(&ret, l_closing);
+  cpy_strcat_string(&ret, ")");
   return ret;
 }
 
 static int Notification_traverse(PyObject *self, visitproc visit, void *arg) {
   Notification *n = (Notification *)self;
   Py_VISIT(n->meta);
-  return 0;
+  return cpy_traverse_type(self, visit, arg);
 }
 
 static int Notification_clear(PyObject *self) {
@@ -1197,7 +1262,7 @@ static int Notification_clear(PyObject *self) {
 
 static void Notification_dealloc(PyObject *self) {
   Notification_clear(self);
-  self->ob_type->tp_free(self);
+  cpy_free_object(self);
 }
 
 static PyMethodDef Notification_methods[] = {
@@ -1256,6 +1321,27 @@ PyTypeObject NotificationType = {
     Notification_new        /* tp_new */
 };
 
+#ifdef CPY_HAVE_OWN_GIL
+static PyType_Slot Notification_slots[] = {
+    {Py_tp_dealloc, Notification_dealloc},
+    {Py_tp_repr, Notification_repr},
+    {Py_tp_doc, Notification_doc},
+    {Py_tp_traverse, Notification_traverse},
+    {Py_tp_clear, Notification_clear},
+    {Py_tp_methods, Notification_methods},
+    {Py_tp_members, Notification_members},
+    {Py_tp_getset, Notification_getseters},
+    {Py_tp_init, Notification_init},
+    {Py_tp_new, Notification_new},
+    {0, NULL}};
+
+PyType_Spec NotificationSpec = {"collectd.Notification", sizeof(Notification),
+                                0,
+                                Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE |
+                                    Py_TPFLAGS_HAVE_GC,
+                                Notification_slots};
+#endif
+
 static char Signed_doc[] =
     "This is a long by another name. Use it in meta data dicts\n"
     "to choose the way it is stored in the meta data.";
@@ -1283,6 +1369,14 @@ PyTypeObject SignedType = {
     Signed_doc                                /* tp_doc */
 };
 
+#ifdef CPY_HAVE_OWN_GIL
+static PyType_Slot Signed_slots[] = {{Py_tp_doc, Signed_doc}, {0, NULL}};
+
+PyType_Spec SignedSpec = {"collectd.Signed", sizeof(Signed), 0,
+                          Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+                          Signed_slots};
+#endif
+
 static char Unsigned_doc[] =
     "This is a long by another name. Use it in meta data dicts\n"
     "to choose the way it is stored in the meta data.";
@@ -1309,3 +1403,11 @@ PyTypeObject UnsignedType = {
     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /* tp_flags */
     Unsigned_doc                              /* tp_doc */
 };
+
+#ifdef CPY_HAVE_OWN_GIL
+static PyType_Slot Unsigned_slots[] = {{Py_tp_doc, Unsigned_doc}, {0, NULL}};
+
+PyType_Spec UnsignedSpec = {"collectd.Unsigned", sizeof(Unsigned), 0,
+                            Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+                            Unsigned_slots};
+#endif
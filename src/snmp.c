@@ -100,6 +100,10 @@ struct host_definition_s {
   data_definition_t **data_list;
   int data_list_len;
   int bulk_size;
+
+  /* asynchronous mode */
+  bool async;
+  bool async_failed;
 };
 typedef struct host_definition_s host_definition_t;
 
@@ -128,15 +132,79 @@ typedef enum {
   OID_TYPE_FILTER,
 } csnmp_oid_type_t;
 
+/* State of a table walk. Holds the last OID returned by the device for each
+ * column, which columns are still "todo" and the cells collected so far. */
+struct csnmp_table_walk_s {
+  host_definition_t *host;
+  data_definition_t *data;
+  const data_set_t *ds;
+  int bulk_size;
+
+  /* Holds the last OID returned by the device. We use this in the GETNEXT
+   * request to proceed. */
+  oid_t *oid_list;
+  /* Set to false when an OID has left its subtree so we don't re-request it
+   * again. */
+  csnmp_oid_type_t *oid_list_todo;
+  size_t oid_list_len;
+  /* Maps the variables of the last request to oid_list indices. */
+  size_t *var_idx;
+  size_t oid_list_todo_num;
+
+  /* `value_list_head' and `value_cells_tail' implement a linked list for each
+   * value. `instance_cells_head' and `instance_cells_tail' implement a linked
+   * list of instance names. This is used to jump gaps in the table. */
+  csnmp_cell_char_t *type_instance_cells_head;
+  csnmp_cell_char_t *type_instance_cells_tail;
+  csnmp_cell_char_t *plugin_instance_cells_head;
+  csnmp_cell_char_t *plugin_instance_cells_tail;
+  csnmp_cell_char_t *hostname_cells_head;
+  csnmp_cell_char_t *hostname_cells_tail;
+  csnmp_cell_char_t *filter_cells_head;
+  csnmp_cell_char_t *filter_cells_tail;
+  csnmp_cell_value_t **value_cells_head;
+  csnmp_cell_value_t **value_cells_tail;
+};
+typedef struct csnmp_table_walk_s csnmp_table_walk_t;
+
+typedef enum {
+  CSNMP_JOB_PENDING = 0,
+  CSNMP_JOB_RUNNING,
+  CSNMP_JOB_SUCCESS,
+  CSNMP_JOB_FAILURE,
+} csnmp_job_state_t;
+
+/* One (host, data) pair read by the asynchronous read callback. */
+struct csnmp_async_job_s {
+  host_definition_t *host;
+  data_definition_t *data;
+  const data_set_t *ds;
+  csnmp_table_walk_t walk;
+  csnmp_job_state_t state;
+};
+typedef struct csnmp_async_job_s csnmp_async_job_t;
+
+/* All asynchronous hosts sharing the same interval. */
+struct csnmp_async_group_s {
+  cdtime_t interval;
+  host_definition_t **hosts;
+  size_t hosts_num;
+  struct csnmp_async_group_s *next;
+};
+typedef struct csnmp_async_group_s csnmp_async_group_t;
+
 /*
  * Private variables
  */
 static data_definition_t *data_head;
+static csnmp_async_group_t *async_groups;
+static size_t async_max_in_flight = 256;
 
 /*
  * Prototypes
  */
 static int csnmp_read_host(user_data_t *ud);
+static int csnmp_async_add_host(host_definition_t *hd, cdtime_t interval);
 
 /*
  * Private functions
@@ -798,6 +866,8 @@ static int csnmp_config_add_host(oconfig_item_t *ci) {
       status = cf_util_get_string(option, &hd->context);
     else if (strcasecmp("BulkSize", option->key) == 0)
       status = cf_util_get_int(option, &hd->bulk_size);
+    else if (strcasecmp("Async", option->key) == 0)
+      status = cf_util_get_boolean(option, &hd->async);
     else {
       WARNING(
           "snmp plugin: csnmp_config_add_host: Option `%s' not allowed here.",
@@ -880,6 +950,16 @@ static int csnmp_config_add_host(oconfig_item_t *ci) {
         "= %i }",
         hd->name, hd->address, hd->community, hd->version);
 
+  if (hd->async) {
+    if (csnmp_async_add_host(hd, interval) != 0) {
+      ERROR("snmp plugin: Adding host `%s' to asynchronous mode failed.",
+            hd->name);
+      csnmp_host_definition_destroy(hd);
+      return -1;
+    }
+    return 0;
+  }
+
   ssnprintf(cb_name, sizeof(cb_name), "snmp-%s", hd->name);
 
   status = plugin_register_complex_read(
@@ -905,7 +985,14 @@ static int csnmp_config(oconfig_item_t *ci) {
       csnmp_config_add_data(child);
     else if (strcasecmp("Host", child->key) == 0)
       csnmp_config_add_host(child);
-    else {
+    else if (strcasecmp("AsyncMaxInFlight", child->key) == 0) {
+      int tmp = 0;
+      if ((cf_util_get_int(child, &tmp) != 0) || (tmp < 1))
+        WARNING("snmp plugin: `AsyncMaxInFlight' must be a positive "
+                "integer.");
+      else
+        async_max_in_flight = (size_t)tmp;
+    } else {
       WARNING("snmp plugin: Ignoring unknown config option `%s'.", child->key);
     }
   } /* for (ci->children) */
@@ -1552,514 +1639,542 @@ static int csnmp_dispatch_table(host_definition_t *host,
   return 0;
 } /* int csnmp_dispatch_table */
 
-static int csnmp_read_table(host_definition_t *host, data_definition_t *data) {
-  struct snmp_pdu *req;
-  struct snmp_pdu *res = NULL;
-  struct variable_list *vb;
-
-  const data_set_t *ds;
-
-  size_t oid_list_len = data->values_len;
-
-  if (data->type_instance.oid.oid_len > 0)
-    oid_list_len++;
-
-  if (data->plugin_instance.oid.oid_len > 0)
-    oid_list_len++;
-
-  if (data->host.oid.oid_len > 0)
-    oid_list_len++;
-
-  if (data->filter_oid.oid_len > 0)
-    oid_list_len++;
-
-  /* Holds the last OID returned by the device. We use this in the GETNEXT
-   * request to proceed. */
-  oid_t oid_list[oid_list_len];
-  /* Set to false when an OID has left its subtree so we don't re-request it
-   * again. */
-  csnmp_oid_type_t oid_list_todo[oid_list_len];
-
-  int status;
+/* csnmp_table_walk_init initializes the state required to walk the table
+ * described by "data". The walk is driven by csnmp_table_walk_request and
+ * csnmp_table_walk_response, so the same code can be used with synchronous
+ * and asynchronous sessions. */
+static int csnmp_table_walk_init(csnmp_table_walk_t *w, host_definition_t *host,
+                                 data_definition_t *data) {
   size_t i;
 
-  /* `value_list_head' and `value_cells_tail' implement a linked list for each
-   * value. `instance_cells_head' and `instance_cells_tail' implement a linked
-   * list of instance names. This is used to jump gaps in the table. */
-  csnmp_cell_char_t *type_instance_cells_head = NULL;
-  csnmp_cell_char_t *type_instance_cells_tail = NULL;
-  csnmp_cell_char_t *plugin_instance_cells_head = NULL;
-  csnmp_cell_char_t *plugin_instance_cells_tail = NULL;
-  csnmp_cell_char_t *hostname_cells_head = NULL;
-  csnmp_cell_char_t *hostname_cells_tail = NULL;
-  csnmp_cell_char_t *filter_cells_head = NULL;
-  csnmp_cell_char_t *filter_cells_tail = NULL;
-  csnmp_cell_value_t **value_cells_head;
-  csnmp_cell_value_t **value_cells_tail;
-
-  DEBUG("snmp plugin: csnmp_read_table (host = %s, data = %s)", host->name,
-        data->name);
-
-  if (host->sess_handle == NULL) {
-    DEBUG("snmp plugin: csnmp_read_table: host->sess_handle == NULL");
-    return -1;
-  }
+  memset(w, 0, sizeof(*w));
+  w->host = host;
+  w->data = data;
+  w->bulk_size = host->bulk_size;
 
-  ds = plugin_get_ds(data->type);
-  if (!ds) {
+  w->ds = plugin_get_ds(data->type);
+  if (!w->ds) {
     ERROR("snmp plugin: DataSet `%s' not defined.", data->type);
     return -1;
   }
 
-  if (ds->ds_num != data->values_len) {
+  if (w->ds->ds_num != data->values_len) {
     ERROR("snmp plugin: DataSet `%s' requires %" PRIsz
           " values, but config talks "
           "about %" PRIsz,
-          data->type, ds->ds_num, data->values_len);
+          data->type, w->ds->ds_num, data->values_len);
     return -1;
   }
   assert(data->values_len > 0);
 
+  w->oid_list_len = data->values_len;
+
+  if (data->type_instance.oid.oid_len > 0)
+    w->oid_list_len++;
+
+  if (data->plugin_instance.oid.oid_len > 0)
+    w->oid_list_len++;
+
+  if (data->host.oid.oid_len > 0)
+    w->oid_list_len++;
+
+  if (data->filter_oid.oid_len > 0)
+    w->oid_list_len++;
+
+  w->oid_list = calloc(w->oid_list_len, sizeof(*w->oid_list));
+  w->oid_list_todo = calloc(w->oid_list_len, sizeof(*w->oid_list_todo));
+  w->var_idx = calloc(w->oid_list_len, sizeof(*w->var_idx));
+  /* We're going to construct n linked lists, one for each "value".
+   * value_cells_head will contain pointers to the heads of these linked lists,
+   * value_cells_tail will contain pointers to the tail of the lists. */
+  w->value_cells_head = calloc(data->values_len, sizeof(*w->value_cells_head));
+  w->value_cells_tail = calloc(data->values_len, sizeof(*w->value_cells_tail));
+  if ((w->oid_list == NULL) || (w->oid_list_todo == NULL) ||
+      (w->var_idx == NULL) || (w->value_cells_head == NULL) ||
+      (w->value_cells_tail == NULL)) {
+    ERROR("snmp plugin: csnmp_table_walk_init: calloc failed.");
+    sfree(w->oid_list);
+    sfree(w->oid_list_todo);
+    sfree(w->var_idx);
+    sfree(w->value_cells_head);
+    sfree(w->value_cells_tail);
+    return -1;
+  }
+
   for (i = 0; i < data->values_len; i++)
-    oid_list_todo[i] = OID_TYPE_VARIABLE;
+    w->oid_list_todo[i] = OID_TYPE_VARIABLE;
 
   /* We need a copy of all the OIDs, because GETNEXT will destroy them. */
-  memcpy(oid_list, data->values, data->values_len * sizeof(oid_t));
+  memcpy(w->oid_list, data->values, data->values_len * sizeof(oid_t));
 
   if (data->type_instance.oid.oid_len > 0) {
-    memcpy(oid_list + i, &data->type_instance.oid, sizeof(oid_t));
-    oid_list_todo[i] = OID_TYPE_TYPEINSTANCE;
+    memcpy(w->oid_list + i, &data->type_instance.oid, sizeof(oid_t));
+    w->oid_list_todo[i] = OID_TYPE_TYPEINSTANCE;
     i++;
   }
 
   if (data->plugin_instance.oid.oid_len > 0) {
-    memcpy(oid_list + i, &data->plugin_instance.oid, sizeof(oid_t));
-    oid_list_todo[i] = OID_TYPE_PLUGININSTANCE;
+    memcpy(w->oid_list + i, &data->plugin_instance.oid, sizeof(oid_t));
+    w->oid_list_todo[i] = OID_TYPE_PLUGININSTANCE;
     i++;
   }
 
   if (data->host.oid.oid_len > 0) {
-    memcpy(oid_list + i, &data->host.oid, sizeof(oid_t));
-    oid_list_todo[i] = OID_TYPE_HOST;
+    memcpy(w->oid_list + i, &data->host.oid, sizeof(oid_t));
+    w->oid_list_todo[i] = OID_TYPE_HOST;
     i++;
   }
 
   if (data->filter_oid.oid_len > 0) {
-    memcpy(oid_list + i, &data->filter_oid, sizeof(oid_t));
-    oid_list_todo[i] = OID_TYPE_FILTER;
+    memcpy(w->oid_list + i, &data->filter_oid, sizeof(oid_t));
+    w->oid_list_todo[i] = OID_TYPE_FILTER;
     i++;
   }
 
-  /* We're going to construct n linked lists, one for each "value".
-   * value_cells_head will contain pointers to the heads of these linked lists,
-   * value_cells_tail will contain pointers to the tail of the lists. */
-  value_cells_head = calloc(data->values_len, sizeof(*value_cells_head));
-  value_cells_tail = calloc(data->values_len, sizeof(*value_cells_tail));
-  if ((value_cells_head == NULL) || (value_cells_tail == NULL)) {
-    ERROR("snmp plugin: csnmp_read_table: calloc failed.");
-    sfree(value_cells_head);
-    sfree(value_cells_tail);
-    return -1;
-  }
-
-  status = 0;
-  while (status == 0) {
-    /* If SNMP v2 and later and bulk transfers enabled, use GETBULK PDU */
-    if (host->version > 1 && host->bulk_size > 0) {
-      req = snmp_pdu_create(SNMP_MSG_GETBULK);
-      req->non_repeaters = 0;
-      req->max_repetitions = host->bulk_size;
-    } else {
-      req = snmp_pdu_create(SNMP_MSG_GETNEXT);
-    }
-    if (req == NULL) {
-      ERROR("snmp plugin: snmp_pdu_create failed.");
-      status = -1;
-      break;
-    }
-
-    size_t oid_list_todo_num = 0;
-    size_t var_idx[oid_list_len];
-    memset(var_idx, 0, sizeof(var_idx));
+  return 0;
+} /* int csnmp_table_walk_init */
 
-    for (i = 0; i < oid_list_len; i++) {
-      /* Do not rerequest already finished OIDs */
-      if (!oid_list_todo[i])
-        continue;
-      snmp_add_null_var(req, oid_list[i].oid, oid_list[i].oid_len);
-      var_idx[oid_list_todo_num] = i;
-      oid_list_todo_num++;
-    }
+/* csnmp_table_walk_request creates the next GETNEXT / GETBULK PDU of the walk.
+ * When all columns have left their subtree, "ret_req" is set to NULL. */
+static int csnmp_table_walk_request(csnmp_table_walk_t *w,
+                                    struct snmp_pdu **ret_req) {
+  struct snmp_pdu *req;
 
-    if (oid_list_todo_num == 0) {
-      /* The request is still empty - so we are finished */
-      DEBUG("snmp plugin: all variables have left their subtree");
-      snmp_free_pdu(req);
-      status = 0;
-      break;
-    }
+  *ret_req = NULL;
 
-    if (req->command == SNMP_MSG_GETBULK) {
-      /* In bulk mode the host will send 'max_repetitions' values per
-         requested variable, so we need to split it per number of variable
-         to stay 'in budget' */
-      req->max_repetitions = floor(host->bulk_size / oid_list_todo_num);
+  /* If SNMP v2 and later and bulk transfers enabled, use GETBULK PDU */
+  if (w->host->version > 1 && w->bulk_size > 0) {
+    req = snmp_pdu_create(SNMP_MSG_GETBULK);
+    if (req != NULL) {
+      req->non_repeaters = 0;
+      req->max_repetitions = w->bulk_size;
     }
+  } else {
+    req = snmp_pdu_create(SNMP_MSG_GETNEXT);
+  }
+  if (req == NULL) {
+    ERROR("snmp plugin: snmp_pdu_create failed.");
+    return -1;
+  }
 
-    res = NULL;
-    status = snmp_sess_synch_response(host->sess_handle, req, &res);
+  w->oid_list_todo_num = 0;
+  memset(w->var_idx, 0, w->oid_list_len * sizeof(*w->var_idx));
 
-    /* snmp_sess_synch_response always frees our req PDU */
-    req = NULL;
+  for (size_t i = 0; i < w->oid_list_len; i++) {
+    /* Do not rerequest already finished OIDs */
+    if (!w->oid_list_todo[i])
+      continue;
+    snmp_add_null_var(req, w->oid_list[i].oid, w->oid_list[i].oid_len);
+    w->var_idx[w->oid_list_todo_num] = i;
+    w->oid_list_todo_num++;
+  }
 
-    if ((status != STAT_SUCCESS) || (res == NULL)) {
-      char *errstr = NULL;
+  if (w->oid_list_todo_num == 0) {
+    /* The request is still empty - so we are finished */
+    DEBUG("snmp plugin: all variables have left their subtree");
+    snmp_free_pdu(req);
+    return 0;
+  }
 
-      snmp_sess_error(host->sess_handle, NULL, NULL, &errstr);
+  if (req->command == SNMP_MSG_GETBULK) {
+    /* In bulk mode the host will send 'max_repetitions' values per
+       requested variable, so we need to split it per number of variable
+       to stay 'in budget'. Ask for at least one row, though, otherwise wide
+       tables would never make progress. */
+    req->max_repetitions = w->bulk_size / w->oid_list_todo_num;
+    if (req->max_repetitions < 1)
+      req->max_repetitions = 1;
+  }
 
-      c_complain(LOG_ERR, &host->complaint,
-                 "snmp plugin: host %s: snmp_sess_synch_response failed: %s",
-                 host->name, (errstr == NULL) ? "Unknown problem" : errstr);
+  *ret_req = req;
+  return 0;
+} /* int csnmp_table_walk_request */
+
+/* csnmp_table_walk_response processes the response to the last request
+ * created by csnmp_table_walk_request. "res" is not freed. */
+static int csnmp_table_walk_response(csnmp_table_walk_t *w,
+                                     struct snmp_pdu *res) {
+  host_definition_t *host = w->host;
+  data_definition_t *data = w->data;
+  const data_set_t *ds = w->ds;
+  csnmp_oid_type_t *oid_list_todo = w->oid_list_todo;
+  oid_t *oid_list = w->oid_list;
+  size_t oid_list_len = w->oid_list_len;
+  struct variable_list *vb;
+  size_t i;
 
-      if (res != NULL)
-        snmp_free_pdu(res);
-      res = NULL;
+  if ((res->errstat == SNMP_ERR_TOOBIG) && (host->version > 1) &&
+      (w->bulk_size > 1)) {
+    /* The agent could not fit the requested rows into one message. Retry
+     * with half the repetitions. */
+    w->bulk_size /= 2;
+    NOTICE("snmp plugin: host %s; data %s: response too big, reducing bulk "
+           "size to %d.",
+           host->name, data->name, w->bulk_size);
+    return 0;
+  }
 
-      sfree(errstr);
-      csnmp_host_close_session(host);
+  vb = res->variables;
+  if (vb == NULL)
+    return -1;
 
-      status = -1;
-      break;
+  if (res->errstat != SNMP_ERR_NOERROR) {
+    if (res->errindex != 0) {
+      /* Find the OID which caused error */
+      for (i = 1, vb = res->variables; vb != NULL && i != res->errindex;
+           vb = vb->next_variable, i++)
+        /* do nothing */;
     }
 
-    status = 0;
-    assert(res != NULL);
-    c_release(LOG_INFO, &host->complaint,
-              "snmp plugin: host %s: snmp_sess_synch_response successful.",
-              host->name);
-
-    vb = res->variables;
-    if (vb == NULL) {
-      status = -1;
-      break;
+    if ((res->errindex == 0) || (vb == NULL)) {
+      ERROR("snmp plugin: host %s; data %s: response error: %s (%li) ",
+            host->name, data->name, snmp_errstring(res->errstat),
+            res->errstat);
+      return -1;
     }
 
-    if (res->errstat != SNMP_ERR_NOERROR) {
-      if (res->errindex != 0) {
-        /* Find the OID which caused error */
-        for (i = 1, vb = res->variables; vb != NULL && i != res->errindex;
-             vb = vb->next_variable, i++)
-          /* do nothing */;
-      }
-
-      if ((res->errindex == 0) || (vb == NULL)) {
-        ERROR("snmp plugin: host %s; data %s: response error: %s (%li) ",
-              host->name, data->name, snmp_errstring(res->errstat),
-              res->errstat);
-        status = -1;
-        break;
-      }
+    char oid_buffer[1024] = {0};
+    snprint_objid(oid_buffer, sizeof(oid_buffer) - 1, vb->name,
+                  vb->name_length);
+    NOTICE("snmp plugin: host %s; data %s: OID `%s` failed: %s", host->name,
+           data->name, oid_buffer, snmp_errstring(res->errstat));
 
-      char oid_buffer[1024] = {0};
-      snprint_objid(oid_buffer, sizeof(oid_buffer) - 1, vb->name,
-                    vb->name_length);
-      NOTICE("snmp plugin: host %s; data %s: OID `%s` failed: %s", host->name,
-             data->name, oid_buffer, snmp_errstring(res->errstat));
+    /* Get value index from todo list and skip OID found */
+    assert(res->errindex <= w->oid_list_todo_num);
+    i = w->var_idx[res->errindex - 1];
+    assert(i < oid_list_len);
+    oid_list_todo[i] = 0;
 
-      /* Get value index from todo list and skip OID found */
-      assert(res->errindex <= oid_list_todo_num);
-      i = var_idx[res->errindex - 1];
-      assert(i < oid_list_len);
-      oid_list_todo[i] = 0;
+    return 0;
+  }
 
-      snmp_free_pdu(res);
-      res = NULL;
-      continue;
+  size_t j;
+  for (vb = res->variables, j = 0; (vb != NULL); vb = vb->next_variable, j++) {
+    i = j;
+    /* If bulk request is active convert value index of the extra value */
+    if (host->version > 1 && w->bulk_size > 0) {
+      i %= w->oid_list_todo_num;
+    }
+    /* Calculate value index from todo list */
+    while ((i < oid_list_len) && !oid_list_todo[i]) {
+      i++;
+      j++;
+    }
+    if (i >= oid_list_len) {
+      break;
     }
 
-    size_t j;
-    for (vb = res->variables, j = 0; (vb != NULL);
-         vb = vb->next_variable, j++) {
-      i = j;
-      /* If bulk request is active convert value index of the extra value */
-      if (host->version > 1 && host->bulk_size > 0) {
-        i %= oid_list_todo_num;
-      }
-      /* Calculate value index from todo list */
-      while ((i < oid_list_len) && !oid_list_todo[i]) {
-        i++;
-        j++;
-      }
-      if (i >= oid_list_len) {
-        break;
+    /* An instance is configured and the res variable we process is the
+     * instance value */
+    if (oid_list_todo[i] == OID_TYPE_TYPEINSTANCE) {
+      if ((vb->type == SNMP_ENDOFMIBVIEW) ||
+          (snmp_oid_ncompare(
+               data->type_instance.oid.oid, data->type_instance.oid.oid_len,
+               vb->name, vb->name_length, data->type_instance.oid.oid_len) !=
+           0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; TypeInstance left its "
+              "subtree.",
+              host->name, data->name);
+        oid_list_todo[i] = 0;
+        continue;
       }
 
-      /* An instance is configured and the res variable we process is the
-       * instance value */
-      if (oid_list_todo[i] == OID_TYPE_TYPEINSTANCE) {
-        if ((vb->type == SNMP_ENDOFMIBVIEW) ||
-            (snmp_oid_ncompare(data->type_instance.oid.oid,
-                               data->type_instance.oid.oid_len, vb->name,
-                               vb->name_length,
-                               data->type_instance.oid.oid_len) != 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; TypeInstance left its "
-                "subtree.",
-                host->name, data->name);
-          oid_list_todo[i] = 0;
-          continue;
-        }
-
-        /* Allocate a new `csnmp_cell_char_t', insert the instance name and
-         * add it to the list */
-        csnmp_cell_char_t *cell =
-            csnmp_get_char_cell(vb, &data->type_instance.oid, host, data);
-        if (cell == NULL) {
-          ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
-                host->name);
-          status = -1;
-          break;
-        }
-
-        if (csnmp_ignore_instance(cell, data)) {
-          sfree(cell);
-        } else {
-          csnmp_cell_replace_reserved_chars(cell);
-
-          DEBUG("snmp plugin: il->type_instance = `%s';", cell->value);
-          csnmp_cells_append(&type_instance_cells_head,
-                             &type_instance_cells_tail, cell);
-        }
-      } else if (oid_list_todo[i] == OID_TYPE_PLUGININSTANCE) {
-        if ((vb->type == SNMP_ENDOFMIBVIEW) ||
-            (snmp_oid_ncompare(data->plugin_instance.oid.oid,
-                               data->plugin_instance.oid.oid_len, vb->name,
-                               vb->name_length,
-                               data->plugin_instance.oid.oid_len) != 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; TypeInstance left its "
-                "subtree.",
-                host->name, data->name);
-          oid_list_todo[i] = 0;
-          continue;
-        }
-
-        /* Allocate a new `csnmp_cell_char_t', insert the instance name and
-         * add it to the list */
-        csnmp_cell_char_t *cell =
-            csnmp_get_char_cell(vb, &data->plugin_instance.oid, host, data);
-        if (cell == NULL) {
-          ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
-                host->name);
-          status = -1;
-          break;
-        }
+      /* Allocate a new `csnmp_cell_char_t', insert the instance name and
+       * add it to the list */
+      csnmp_cell_char_t *cell =
+          csnmp_get_char_cell(vb, &data->type_instance.oid, host, data);
+      if (cell == NULL) {
+        ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
+              host->name);
+        return -1;
+      }
 
+      if (csnmp_ignore_instance(cell, data)) {
+        sfree(cell);
+      } else {
         csnmp_cell_replace_reserved_chars(cell);
 
-        DEBUG("snmp plugin: il->plugin_instance = `%s';", cell->value);
-        csnmp_cells_append(&plugin_instance_cells_head,
-                           &plugin_instance_cells_tail, cell);
-      } else if (oid_list_todo[i] == OID_TYPE_HOST) {
-        if ((vb->type == SNMP_ENDOFMIBVIEW) ||
-            (snmp_oid_ncompare(data->host.oid.oid, data->host.oid.oid_len,
-                               vb->name, vb->name_length,
-                               data->host.oid.oid_len) != 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; Host left its subtree.",
-                host->name, data->name);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+        DEBUG("snmp plugin: il->type_instance = `%s';", cell->value);
+        csnmp_cells_append(&w->type_instance_cells_head,
+                           &w->type_instance_cells_tail, cell);
+      }
+    } else if (oid_list_todo[i] == OID_TYPE_PLUGININSTANCE) {
+      if ((vb->type == SNMP_ENDOFMIBVIEW) ||
+          (snmp_oid_ncompare(data->plugin_instance.oid.oid,
+                             data->plugin_instance.oid.oid_len, vb->name,
+                             vb->name_length,
+                             data->plugin_instance.oid.oid_len) != 0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; TypeInstance left its "
+              "subtree.",
+              host->name, data->name);
+        oid_list_todo[i] = 0;
+        continue;
+      }
 
-        /* Allocate a new `csnmp_cell_char_t', insert the instance name and
-         * add it to the list */
-        csnmp_cell_char_t *cell =
-            csnmp_get_char_cell(vb, &data->host.oid, host, data);
-        if (cell == NULL) {
-          ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
-                host->name);
-          status = -1;
-          break;
-        }
+      /* Allocate a new `csnmp_cell_char_t', insert the instance name and
+       * add it to the list */
+      csnmp_cell_char_t *cell =
+          csnmp_get_char_cell(vb, &data->plugin_instance.oid, host, data);
+      if (cell == NULL) {
+        ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
+              host->name);
+        return -1;
+      }
 
-        csnmp_cell_replace_reserved_chars(cell);
+      csnmp_cell_replace_reserved_chars(cell);
+
+      DEBUG("snmp plugin: il->plugin_instance = `%s';", cell->value);
+      csnmp_cells_append(&w->plugin_instance_cells_head,
+                         &w->plugin_instance_cells_tail, cell);
+    } else if (oid_list_todo[i] == OID_TYPE_HOST) {
+      if ((vb->type == SNMP_ENDOFMIBVIEW) ||
+          (snmp_oid_ncompare(data->host.oid.oid, data->host.oid.oid_len,
+                             vb->name, vb->name_length,
+                             data->host.oid.oid_len) != 0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; Host left its subtree.",
+              host->name, data->name);
+        oid_list_todo[i] = 0;
+        continue;
+      }
 
-        DEBUG("snmp plugin: il->hostname = `%s';", cell->value);
-        csnmp_cells_append(&hostname_cells_head, &hostname_cells_tail, cell);
-      } else if (oid_list_todo[i] == OID_TYPE_FILTER) {
-        if ((vb->type == SNMP_ENDOFMIBVIEW) ||
-            (snmp_oid_ncompare(data->filter_oid.oid, data->filter_oid.oid_len,
-                               vb->name, vb->name_length,
-                               data->filter_oid.oid_len) != 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; Host left its subtree.",
-                host->name, data->name);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+      /* Allocate a new `csnmp_cell_char_t', insert the instance name and
+       * add it to the list */
+      csnmp_cell_char_t *cell =
+          csnmp_get_char_cell(vb, &data->host.oid, host, data);
+      if (cell == NULL) {
+        ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
+              host->name);
+        return -1;
+      }
 
-        /* Allocate a new `csnmp_cell_char_t', insert the instance name and
-         * add it to the list */
-        csnmp_cell_char_t *cell =
-            csnmp_get_char_cell(vb, &data->filter_oid, host, data);
-        if (cell == NULL) {
-          ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
-                host->name);
-          status = -1;
-          break;
-        }
+      csnmp_cell_replace_reserved_chars(cell);
+
+      DEBUG("snmp plugin: il->hostname = `%s';", cell->value);
+      csnmp_cells_append(&w->hostname_cells_head, &w->hostname_cells_tail,
+                         cell);
+    } else if (oid_list_todo[i] == OID_TYPE_FILTER) {
+      if ((vb->type == SNMP_ENDOFMIBVIEW) ||
+          (snmp_oid_ncompare(data->filter_oid.oid, data->filter_oid.oid_len,
+                             vb->name, vb->name_length,
+                             data->filter_oid.oid_len) != 0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; Host left its subtree.",
+              host->name, data->name);
+        oid_list_todo[i] = 0;
+        continue;
+      }
 
-        csnmp_cell_replace_reserved_chars(cell);
+      /* Allocate a new `csnmp_cell_char_t', insert the instance name and
+       * add it to the list */
+      csnmp_cell_char_t *cell =
+          csnmp_get_char_cell(vb, &data->filter_oid, host, data);
+      if (cell == NULL) {
+        ERROR("snmp plugin: host %s: csnmp_get_char_cell() failed.",
+              host->name);
+        return -1;
+      }
 
-        DEBUG("snmp plugin: il->filter = `%s';", cell->value);
-        csnmp_cells_append(&filter_cells_head, &filter_cells_tail, cell);
-      } else /* The variable we are processing is a normal value */
-      {
-        assert(oid_list_todo[i] == OID_TYPE_VARIABLE);
-
-        csnmp_cell_value_t *vt;
-        oid_t vb_name;
-        oid_t suffix;
-        int ret;
-
-        csnmp_oid_init(&vb_name, vb->name, vb->name_length);
-
-        /* Calculate the current suffix. This is later used to check that the
-         * suffix is increasing. This also checks if we left the subtree */
-        ret = csnmp_oid_suffix(&suffix, &vb_name, data->values + i);
-        if (ret != 0) {
-          DEBUG("snmp plugin: host = %s; data = %s; i = %" PRIsz "; "
-                "Value probably left its subtree.",
-                host->name, data->name, i);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+      csnmp_cell_replace_reserved_chars(cell);
 
-        /* Make sure the OIDs returned by the agent are increasing. Otherwise
-         * our table matching algorithm will get confused. */
-        if ((value_cells_tail[i] != NULL) &&
-            (csnmp_oid_compare(&suffix, &value_cells_tail[i]->suffix) <= 0)) {
-          DEBUG("snmp plugin: host = %s; data = %s; i = %" PRIsz "; "
-                "Suffix is not increasing.",
-                host->name, data->name, i);
-          oid_list_todo[i] = 0;
-          continue;
-        }
+      DEBUG("snmp plugin: il->filter = `%s';", cell->value);
+      csnmp_cells_append(&w->filter_cells_head, &w->filter_cells_tail, cell);
+    } else /* The variable we are processing is a normal value */
+    {
+      assert(oid_list_todo[i] == OID_TYPE_VARIABLE);
+
+      csnmp_cell_value_t *vt;
+      oid_t vb_name;
+      oid_t suffix;
+      int ret;
+
+      csnmp_oid_init(&vb_name, vb->name, vb->name_length);
+
+      /* Calculate the current suffix. This is later used to check that the
+       * suffix is increasing. This also checks if we left the subtree */
+      ret = csnmp_oid_suffix(&suffix, &vb_name, data->values + i);
+      if (ret != 0) {
+        DEBUG("snmp plugin: host = %s; data = %s; i = %" PRIsz "; "
+              "Value probably left its subtree.",
+              host->name, data->name, i);
+        oid_list_todo[i] = 0;
+        continue;
+      }
 
-        vt = calloc(1, sizeof(*vt));
-        if (vt == NULL) {
-          ERROR("snmp plugin: calloc failed.");
-          status = -1;
-          break;
-        }
+      /* Make sure the OIDs returned by the agent are increasing. Otherwise
+       * our table matching algorithm will get confused. */
+      if ((w->value_cells_tail[i] != NULL) &&
+          (csnmp_oid_compare(&suffix, &w->value_cells_tail[i]->suffix) <= 0)) {
+        DEBUG("snmp plugin: host = %s; data = %s; i = %" PRIsz "; "
+              "Suffix is not increasing.",
+              host->name, data->name, i);
+        oid_list_todo[i] = 0;
+        continue;
+      }
 
-        vt->value =
-            csnmp_value_list_to_value(vb, ds->ds[i].type, data->scale,
-                                      data->shift, host->name, data->name);
-        memcpy(&vt->suffix, &suffix, sizeof(vt->suffix));
-        vt->next = NULL;
-
-        if (value_cells_tail[i] == NULL)
-          value_cells_head[i] = vt;
-        else
-          value_cells_tail[i]->next = vt;
-        value_cells_tail[i] = vt;
+      vt = calloc(1, sizeof(*vt));
+      if (vt == NULL) {
+        ERROR("snmp plugin: calloc failed.");
+        return -1;
       }
 
-      /* Copy OID to oid_list[i] */
-      memcpy(oid_list[i].oid, vb->name, sizeof(oid) * vb->name_length);
-      oid_list[i].oid_len = vb->name_length;
+      vt->value = csnmp_value_list_to_value(vb, ds->ds[i].type, data->scale,
+                                            data->shift, host->name,
+                                            data->name);
+      memcpy(&vt->suffix, &suffix, sizeof(vt->suffix));
+      vt->next = NULL;
 
-    } /* for (vb = res->variables ...) */
+      if (w->value_cells_tail[i] == NULL)
+        w->value_cells_head[i] = vt;
+      else
+        w->value_cells_tail[i]->next = vt;
+      w->value_cells_tail[i] = vt;
+    }
 
-    if (res != NULL)
-      snmp_free_pdu(res);
-    res = NULL;
-  } /* while (status == 0) */
+    /* Copy OID to oid_list[i] */
+    memcpy(oid_list[i].oid, vb->name, sizeof(oid) * vb->name_length);
+    oid_list[i].oid_len = vb->name_length;
 
-  if (res != NULL)
-    snmp_free_pdu(res);
-  res = NULL;
+  } /* for (vb = res->variables ...) */
 
-  if (status == 0)
-    csnmp_dispatch_table(host, data, type_instance_cells_head,
-                         plugin_instance_cells_head, hostname_cells_head,
-                         filter_cells_head, value_cells_head);
+  return 0;
+} /* int csnmp_table_walk_response */
+
+/* csnmp_table_walk_finish dispatches the collected table, if requested, and
+ * frees all memory held by the walk. */
+static void csnmp_table_walk_finish(csnmp_table_walk_t *w, bool dispatch) {
+  if (dispatch)
+    csnmp_dispatch_table(w->host, w->data, w->type_instance_cells_head,
+                         w->plugin_instance_cells_head,
+                         w->hostname_cells_head, w->filter_cells_head,
+                         w->value_cells_head);
 
   /* Free all allocated variables here */
-  while (type_instance_cells_head != NULL) {
-    csnmp_cell_char_t *next = type_instance_cells_head->next;
-    sfree(type_instance_cells_head);
-    type_instance_cells_head = next;
+  while (w->type_instance_cells_head != NULL) {
+    csnmp_cell_char_t *next = w->type_instance_cells_head->next;
+    sfree(w->type_instance_cells_head);
+    w->type_instance_cells_head = next;
   }
 
-  while (plugin_instance_cells_head != NULL) {
-    csnmp_cell_char_t *next = plugin_instance_cells_head->next;
-    sfree(plugin_instance_cells_head);
-    plugin_instance_cells_head = next;
+  while (w->plugin_instance_cells_head != NULL) {
+    csnmp_cell_char_t *next = w->plugin_instance_cells_head->next;
+    sfree(w->plugin_instance_cells_head);
+    w->plugin_instance_cells_head = next;
   }
 
-  while (hostname_cells_head != NULL) {
-    csnmp_cell_char_t *next = hostname_cells_head->next;
-    sfree(hostname_cells_head);
-    hostname_cells_head = next;
+  while (w->hostname_cells_head != NULL) {
+    csnmp_cell_char_t *next = w->hostname_cells_head->next;
+    sfree(w->hostname_cells_head);
+    w->hostname_cells_head = next;
   }
 
-  while (filter_cells_head != NULL) {
-    csnmp_cell_char_t *next = filter_cells_head->next;
-    sfree(filter_cells_head);
-    filter_cells_head = next;
+  while (w->filter_cells_head != NULL) {
+    csnmp_cell_char_t *next = w->filter_cells_head->next;
+    sfree(w->filter_cells_head);
+    w->filter_cells_head = next;
   }
 
-  for (i = 0; i < data->values_len; i++) {
-    while (value_cells_head[i] != NULL) {
-      csnmp_cell_value_t *next = value_cells_head[i]->next;
-      sfree(value_cells_head[i]);
-      value_cells_head[i] = next;
+  for (size_t i = 0; (w->value_cells_head != NULL) && (i < w->data->values_len);
+       i++) {
+    while (w->value_cells_head[i] != NULL) {
+      csnmp_cell_value_t *next = w->value_cells_head[i]->next;
+      sfree(w->value_cells_head[i]);
+      w->value_cells_head[i] = next;
     }
   }
 
-  sfree(value_cells_head);
-  sfree(value_cells_tail);
-
-  return 0;
-} /* int csnmp_read_table */
-
-static int csnmp_read_value(host_definition_t *host, data_definition_t *data) {
-  struct snmp_pdu *req;
-  struct snmp_pdu *res = NULL;
-  struct variable_list *vb;
-
-  const data_set_t *ds;
-  value_list_t vl = VALUE_LIST_INIT;
+  sfree(w->value_cells_head);
+  sfree(w->value_cells_tail);
+  sfree(w->oid_list);
+  sfree(w->oid_list_todo);
+  sfree(w->var_idx);
+} /* void csnmp_table_walk_finish */
 
+static int csnmp_read_table(host_definition_t *host, data_definition_t *data) {
+  csnmp_table_walk_t walk;
   int status;
-  size_t i;
 
-  DEBUG("snmp plugin: csnmp_read_value (host = %s, data = %s)", host->name,
+  DEBUG("snmp plugin: csnmp_read_table (host = %s, data = %s)", host->name,
         data->name);
 
   if (host->sess_handle == NULL) {
-    DEBUG("snmp plugin: csnmp_read_value: host->sess_handle == NULL");
+    DEBUG("snmp plugin: csnmp_read_table: host->sess_handle == NULL");
     return -1;
   }
 
-  ds = plugin_get_ds(data->type);
-  if (!ds) {
-    ERROR("snmp plugin: DataSet `%s' not defined.", data->type);
+  if (csnmp_table_walk_init(&walk, host, data) != 0)
     return -1;
-  }
 
-  if (ds->ds_num != data->values_len) {
-    ERROR("snmp plugin: DataSet `%s' requires %" PRIsz
-          " values, but config talks "
-          "about %" PRIsz,
-          data->type, ds->ds_num, data->values_len);
-    return -1;
+  status = 0;
+  while (status == 0) {
+    struct snmp_pdu *req = NULL;
+    struct snmp_pdu *res = NULL;
+
+    status = csnmp_table_walk_request(&walk, &req);
+    if ((status != 0) || (req == NULL))
+      break;
+
+    status = snmp_sess_synch_response(host->sess_handle, req, &res);
+
+    /* snmp_sess_synch_response always frees our req PDU */
+    req = NULL;
+
+    if ((status != STAT_SUCCESS) || (res == NULL)) {
+      char *errstr = NULL;
+
+      snmp_sess_error(host->sess_handle, NULL, NULL, &errstr);
+
+      c_complain(LOG_ERR, &host->complaint,
+                 "snmp plugin: host %s: snmp_sess_synch_response failed: %s",
+                 host->name, (errstr == NULL) ? "Unknown problem" : errstr);
+
+      if (res != NULL)
+        snmp_free_pdu(res);
+      res = NULL;
+
+      sfree(errstr);
+      csnmp_host_close_session(host);
+
+      status = -1;
+      break;
+    }
+
+    c_release(LOG_INFO, &host->complaint,
+              "snmp plugin: host %s: snmp_sess_synch_response successful.",
+              host->name);
+
+    status = csnmp_table_walk_response(&walk, res);
+    snmp_free_pdu(res);
+  } /* while (status == 0) */
+
+  csnmp_table_walk_finish(&walk, /* dispatch = */ status == 0);
+
+  return 0;
+} /* int csnmp_read_table */
+
+static struct snmp_pdu *csnmp_value_request(data_definition_t *data) {
+  struct snmp_pdu *req = snmp_pdu_create(SNMP_MSG_GET);
+  if (req == NULL) {
+    ERROR("snmp plugin: snmp_pdu_create failed.");
+    return NULL;
   }
 
+  for (size_t i = 0; i < data->values_len; i++)
+    snmp_add_null_var(req, data->values[i].oid, data->values[i].oid_len);
+
+  return req;
+} /* struct snmp_pdu *csnmp_value_request */
+
+/* csnmp_value_response dispatches the values of a GET response. "res" is not
+ * freed. */
+static int csnmp_value_response(host_definition_t *host,
+                                data_definition_t *data, const data_set_t *ds,
+                                struct snmp_pdu *res) {
+  value_list_t vl = VALUE_LIST_INIT;
+
   vl.values_len = ds->ds_num;
   vl.values = malloc(sizeof(*vl.values) * vl.values_len);
   if (vl.values == NULL)
     return -1;
-  for (i = 0; i < vl.values_len; i++) {
+  for (size_t i = 0; i < vl.values_len; i++) {
     if (ds->ds[i].type == DS_TYPE_COUNTER)
       vl.values[i].counter = 0;
     else
@@ -2076,15 +2191,68 @@ static int csnmp_read_value(host_definition_t *host, data_definition_t *data) {
     sstrncpy(vl.plugin_instance, data->plugin_instance.value,
              sizeof(vl.plugin_instance));
 
-  req = snmp_pdu_create(SNMP_MSG_GET);
-  if (req == NULL) {
-    ERROR("snmp plugin: snmp_pdu_create failed.");
-    sfree(vl.values);
+  for (struct variable_list *vb = res->variables; vb != NULL;
+       vb = vb->next_variable) {
+#if COLLECT_DEBUG
+    char buffer[1024];
+    snprint_variable(buffer, sizeof(buffer), vb->name, vb->name_length, vb);
+    DEBUG("snmp plugin: Got this variable: %s", buffer);
+#endif /* COLLECT_DEBUG */
+
+    for (size_t i = 0; i < data->values_len; i++)
+      if (snmp_oid_compare(data->values[i].oid, data->values[i].oid_len,
+                           vb->name, vb->name_length) == 0)
+        vl.values[i] =
+            csnmp_value_list_to_value(vb, ds->ds[i].type, data->scale,
+                                      data->shift, host->name, data->name);
+  } /* for (res->variables) */
+
+  DEBUG("snmp plugin: -> plugin_dispatch_values (&vl);");
+  plugin_dispatch_values(&vl);
+  sfree(vl.values);
+
+  return 0;
+} /* int csnmp_value_response */
+
+static const data_set_t *csnmp_value_get_ds(data_definition_t *data) {
+  const data_set_t *ds = plugin_get_ds(data->type);
+  if (!ds) {
+    ERROR("snmp plugin: DataSet `%s' not defined.", data->type);
+    return NULL;
+  }
+
+  if (ds->ds_num != data->values_len) {
+    ERROR("snmp plugin: DataSet `%s' requires %" PRIsz
+          " values, but config talks "
+          "about %" PRIsz,
+          data->type, ds->ds_num, data->values_len);
+    return NULL;
+  }
+
+  return ds;
+} /* const data_set_t *csnmp_value_get_ds */
+
+static int csnmp_read_value(host_definition_t *host, data_definition_t *data) {
+  struct snmp_pdu *req;
+  struct snmp_pdu *res = NULL;
+  const data_set_t *ds;
+  int status;
+
+  DEBUG("snmp plugin: csnmp_read_value (host = %s, data = %s)", host->name,
+        data->name);
+
+  if (host->sess_handle == NULL) {
+    DEBUG("snmp plugin: csnmp_read_value: host->sess_handle == NULL");
     return -1;
   }
 
-  for (i = 0; i < data->values_len; i++)
-    snmp_add_null_var(req, data->values[i].oid, data->values[i].oid_len);
+  ds = csnmp_value_get_ds(data);
+  if (ds == NULL)
+    return -1;
+
+  req = csnmp_value_request(data);
+  if (req == NULL)
+    return -1;
 
   status = snmp_sess_synch_response(host->sess_handle, req, &res);
 
@@ -2099,34 +2267,15 @@ static int csnmp_read_value(host_definition_t *host, data_definition_t *data) {
       snmp_free_pdu(res);
 
     sfree(errstr);
-    sfree(vl.values);
     csnmp_host_close_session(host);
 
     return -1;
   }
 
-  for (vb = res->variables; vb != NULL; vb = vb->next_variable) {
-#if COLLECT_DEBUG
-    char buffer[1024];
-    snprint_variable(buffer, sizeof(buffer), vb->name, vb->name_length, vb);
-    DEBUG("snmp plugin: Got this variable: %s", buffer);
-#endif /* COLLECT_DEBUG */
-
-    for (i = 0; i < data->values_len; i++)
-      if (snmp_oid_compare(data->values[i].oid, data->values[i].oid_len,
-                           vb->name, vb->name_length) == 0)
-        vl.values[i] =
-            csnmp_value_list_to_value(vb, ds->ds[i].type, data->scale,
-                                      data->shift, host->name, data->name);
-  } /* for (res->variables) */
-
+  status = csnmp_value_response(host, data, ds, res);
   snmp_free_pdu(res);
 
-  DEBUG("snmp plugin: -> plugin_dispatch_values (&vl);");
-  plugin_dispatch_values(&vl);
-  sfree(vl.values);
-
-  return 0;
+  return status;
 } /* int csnmp_read_value */
 
 static int csnmp_read_host(user_data_t *ud) {
@@ -2162,6 +2311,372 @@ static int csnmp_read_host(user_data_t *ud) {
   return 0;
 } /* int csnmp_read_host */
 
+/*
+ * Asynchronous mode {{{
+ *
+ * Hosts with "Async true" are not read by a read callback of their own.
+ * Instead, all asynchronous hosts with the same interval are read by one
+ * callback which sends the requests of all (host, data) pairs with
+ * snmp_sess_async_send and processes the responses in a single select loop.
+ * Each table walk has at most one outstanding request; the number of walks
+ * in flight at the same time is limited by "AsyncMaxInFlight".
+ */
+static int csnmp_async_send(csnmp_async_job_t *job, struct snmp_pdu *req);
+
+static void csnmp_async_job_done(csnmp_async_job_t *job, bool success) {
+  if (job->data->is_table)
+    csnmp_table_walk_finish(&job->walk, success);
+
+  job->state = success ? CSNMP_JOB_SUCCESS : CSNMP_JOB_FAILURE;
+} /* void csnmp_async_job_done */
+
+/* Sends the next request of a table walk or finishes the job. */
+static void csnmp_async_job_continue(csnmp_async_job_t *job) {
+  struct snmp_pdu *req = NULL;
+
+  if (csnmp_table_walk_request(&job->walk, &req) != 0) {
+    csnmp_async_job_done(job, /* success = */ false);
+    return;
+  }
+
+  if (req == NULL) {
+    csnmp_async_job_done(job, /* success = */ true);
+    return;
+  }
+
+  if (csnmp_async_send(job, req) != 0)
+    csnmp_async_job_done(job, /* success = */ false);
+} /* void csnmp_async_job_continue */
+
+static int csnmp_async_callback(int operation,
+                                __attribute__((unused)) netsnmp_session *sess,
+                                __attribute__((unused)) int reqid,
+                                netsnmp_pdu *res, void *magic) {
+  csnmp_async_job_t *job = magic;
+  host_definition_t *host = job->host;
+
+  /* The job may have been given up on, see csnmp_read_async. */
+  if (job->state != CSNMP_JOB_RUNNING)
+    return 1;
+
+  if (operation != NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+    c_complain(LOG_ERR, &host->complaint,
+               "snmp plugin: host %s: request for data %s failed (operation "
+               "%d).",
+               host->name, job->data->name, operation);
+    host->async_failed = true;
+    csnmp_async_job_done(job, /* success = */ false);
+    return 1;
+  }
+
+  c_release(LOG_INFO, &host->complaint,
+            "snmp plugin: host %s: asynchronous request successful.",
+            host->name);
+
+  /* The response PDU is owned and freed by the library. */
+  if (job->data->is_table) {
+    if (csnmp_table_walk_response(&job->walk, res) != 0)
+      csnmp_async_job_done(job, /* success = */ false);
+    else
+      csnmp_async_job_continue(job);
+  } else {
+    int status = csnmp_value_response(host, job->data, job->ds, res);
+    csnmp_async_job_done(job, /* success = */ status == 0);
+  }
+
+  return 1;
+} /* int csnmp_async_callback */
+
+static int csnmp_async_send(csnmp_async_job_t *job, struct snmp_pdu *req) {
+  host_definition_t *host = job->host;
+
+  if (snmp_sess_async_send(host->sess_handle, req, csnmp_async_callback,
+                           job) == 0) {
+    char *errstr = NULL;
+
+    snmp_sess_error(host->sess_handle, NULL, NULL, &errstr);
+    c_complain(LOG_ERR, &host->complaint,
+               "snmp plugin: host %s: snmp_sess_async_send failed: %s",
+               host->name, (errstr == NULL) ? "Unknown problem" : errstr);
+    sfree(errstr);
+
+    /* The PDU is only freed by the library on success. */
+    snmp_free_pdu(req);
+    host->async_failed = true;
+    return -1;
+  }
+
+  job->state = CSNMP_JOB_RUNNING;
+  return 0;
+} /* int csnmp_async_send */
+
+static void csnmp_async_job_start(csnmp_async_job_t *job) {
+  host_definition_t *host = job->host;
+  data_definition_t *data = job->data;
+
+  if ((host->sess_handle == NULL) || host->async_failed) {
+    job->state = CSNMP_JOB_FAILURE;
+    return;
+  }
+
+  if (data->is_table) {
+    if (csnmp_table_walk_init(&job->walk, host, data) != 0) {
+      job->state = CSNMP_JOB_FAILURE;
+      return;
+    }
+    csnmp_async_job_continue(job);
+    return;
+  }
+
+  job->ds = csnmp_value_get_ds(data);
+  if (job->ds == NULL) {
+    job->state = CSNMP_JOB_FAILURE;
+    return;
+  }
+
+  struct snmp_pdu *req = csnmp_value_request(data);
+  if ((req == NULL) || (csnmp_async_send(job, req) != 0))
+    job->state = CSNMP_JOB_FAILURE;
+} /* void csnmp_async_job_start */
+
+/* Creates one job per (host, data) pair of the group. The jobs of different
+ * hosts are interleaved, so that the in-flight limit is spread across hosts
+ * rather than draining one host after the other. */
+static csnmp_async_job_t *csnmp_async_jobs_create(csnmp_async_group_t *group,
+                                                  size_t *ret_num) {
+  size_t jobs_num = 0;
+  for (size_t i = 0; i < group->hosts_num; i++)
+    jobs_num += (size_t)group->hosts[i]->data_list_len;
+
+  *ret_num = jobs_num;
+  if (jobs_num == 0)
+    return NULL;
+
+  csnmp_async_job_t *jobs = calloc(jobs_num, sizeof(*jobs));
+  if (jobs == NULL)
+    return NULL;
+
+  size_t n = 0;
+  for (int k = 0; n < jobs_num; k++) {
+    for (size_t i = 0; i < group->hosts_num; i++) {
+      host_definition_t *host = group->hosts[i];
+      if (k >= host->data_list_len)
+        continue;
+      jobs[n].host = host;
+      jobs[n].data = host->data_list[k];
+      n++;
+    }
+  }
+
+  return jobs;
+} /* csnmp_async_job_t *csnmp_async_jobs_create */
+
+/* Starts pending jobs, beginning at "*next_job", until "async_max_in_flight"
+ * jobs are running or all jobs have been started. Returns the number of
+ * running jobs. */
+static size_t csnmp_async_jobs_start(csnmp_async_job_t *jobs, size_t jobs_num,
+                                     size_t *next_job) {
+  size_t running = 0;
+  for (size_t i = 0; i < *next_job; i++)
+    if (jobs[i].state == CSNMP_JOB_RUNNING)
+      running++;
+
+  while ((*next_job < jobs_num) && (running < async_max_in_flight)) {
+    csnmp_async_job_t *job = jobs + *next_job;
+
+    csnmp_async_job_start(job);
+    if (job->state == CSNMP_JOB_RUNNING)
+      running++;
+    (*next_job)++;
+  }
+
+  return running;
+} /* size_t csnmp_async_jobs_start */
+
+/* Gives up on jobs that are still running, marking their hosts as failed.
+ * Returns the number of successful jobs. */
+static size_t csnmp_async_jobs_finish(csnmp_async_job_t *jobs,
+                                      size_t jobs_num) {
+  size_t success = 0;
+
+  for (size_t i = 0; i < jobs_num; i++) {
+    csnmp_async_job_t *job = jobs + i;
+
+    if (job->state == CSNMP_JOB_RUNNING) {
+      /* Closing the session discards the outstanding request. */
+      csnmp_async_job_done(job, /* success = */ false);
+      job->host->async_failed = true;
+    } else if (job->state == CSNMP_JOB_SUCCESS) {
+      success++;
+    }
+  }
+
+  return success;
+} /* size_t csnmp_async_jobs_finish */
+
+/* Waits for responses on any of the group's sessions, at most one second, and
+ * handles them. Returns non-zero if waiting failed. */
+static int csnmp_async_wait(csnmp_async_group_t *group) {
+  int numfds = 0;
+  int block = 0;
+  /* Wake up at least once a second to check the deadline. */
+  struct timeval timeout = {.tv_sec = 1, .tv_usec = 0};
+  /* A plain fd_set can not hold descriptors beyond FD_SETSIZE, which are
+   * common when many sessions are open. */
+  netsnmp_large_fd_set fdset;
+
+  netsnmp_large_fd_set_init(&fdset, FD_SETSIZE);
+  NETSNMP_LARGE_FD_ZERO(&fdset);
+
+  for (size_t i = 0; i < group->hosts_num; i++) {
+    host_definition_t *host = group->hosts[i];
+    if (host->sess_handle != NULL)
+      snmp_sess_select_info2(host->sess_handle, &numfds, &fdset, &timeout,
+                             &block);
+  }
+
+  int status =
+      netsnmp_large_fd_set_select(numfds, &fdset, NULL, NULL, &timeout);
+  if ((status < 0) && (errno != EINTR)) {
+    ERROR("snmp plugin: select failed: %s", STRERRNO);
+    netsnmp_large_fd_set_cleanup(&fdset);
+    return -1;
+  }
+
+  for (size_t i = 0; i < group->hosts_num; i++) {
+    host_definition_t *host = group->hosts[i];
+
+    if ((status > 0) && (host->sess_handle != NULL))
+      snmp_sess_read2(host->sess_handle, &fdset);
+
+    /* Retransmit or time out requests of all sessions, not only when select
+     * timed out: with a steady stream of responses from some hosts, the
+     * requests to other hosts would never be retried otherwise. */
+    if (host->sess_handle != NULL)
+      snmp_sess_timeout(host->sess_handle);
+  }
+
+  netsnmp_large_fd_set_cleanup(&fdset);
+  return 0;
+} /* int csnmp_async_wait */
+
+static int csnmp_read_async(user_data_t *ud) {
+  csnmp_async_group_t *group = ud->data;
+
+  for (size_t i = 0; i < group->hosts_num; i++) {
+    host_definition_t *host = group->hosts[i];
+
+    host->async_failed = false;
+    if (host->sess_handle == NULL)
+      csnmp_host_open_session(host);
+  }
+
+  size_t jobs_num = 0;
+  csnmp_async_job_t *jobs = csnmp_async_jobs_create(group, &jobs_num);
+  if (jobs_num == 0)
+    return 0;
+  if (jobs == NULL) {
+    ERROR("snmp plugin: csnmp_read_async: calloc failed.");
+    return -1;
+  }
+
+  size_t next_job = 0;
+  cdtime_t deadline = cdtime() + plugin_get_interval();
+
+  while (1) {
+    size_t running = csnmp_async_jobs_start(jobs, jobs_num, &next_job);
+    if (running == 0)
+      break;
+
+    if (cdtime() > deadline) {
+      WARNING("snmp plugin: %" PRIsz " asynchronous requests did not finish "
+              "within the interval.",
+              running);
+      break;
+    }
+
+    if (csnmp_async_wait(group) != 0)
+      break;
+  } /* while (1) */
+
+  size_t success = csnmp_async_jobs_finish(jobs, jobs_num);
+
+  /* Sessions are only closed after all jobs are done, because closing a
+   * session discards requests that may still be outstanding. */
+  for (size_t i = 0; i < group->hosts_num; i++)
+    if (group->hosts[i]->async_failed)
+      csnmp_host_close_session(group->hosts[i]);
+
+  sfree(jobs);
+
+  if (success == 0)
+    return -1;
+
+  return 0;
+} /* int csnmp_read_async */
+
+static void csnmp_async_group_destroy(void *arg) {
+  csnmp_async_group_t *group = arg;
+
+  if (group == NULL)
+    return;
+
+  for (size_t i = 0; i < group->hosts_num; i++)
+    csnmp_host_definition_destroy(group->hosts[i]);
+  sfree(group->hosts);
+  sfree(group);
+} /* void csnmp_async_group_destroy */
+
+/* csnmp_async_add_host adds "hd" to the asynchronous group reading at
+ * "interval". The group's read callback is registered with the first host. */
+static int csnmp_async_add_host(host_definition_t *hd, cdtime_t interval) {
+  csnmp_async_group_t *group = NULL;
+
+  for (csnmp_async_group_t *g = async_groups; g != NULL; g = g->next) {
+    if (g->interval == interval) {
+      group = g;
+      break;
+    }
+  }
+
+  if (group == NULL) {
+    group = calloc(1, sizeof(*group));
+    if (group == NULL)
+      return -1;
+    group->interval = interval;
+
+    char cb_name[DATA_MAX_NAME_LEN];
+    ssnprintf(cb_name, sizeof(cb_name), "snmp-async-%.3f",
+              CDTIME_T_TO_DOUBLE(interval));
+
+    int status = plugin_register_complex_read(
+        /* group = */ NULL, cb_name, csnmp_read_async, interval,
+        &(user_data_t){
+            .data = group,
+            .free_func = csnmp_async_group_destroy,
+        });
+    if (status != 0) {
+      ERROR("snmp plugin: Registering complex read function failed.");
+      sfree(group);
+      return -1;
+    }
+
+    group->next = async_groups;
+    async_groups = group;
+  }
+
+  host_definition_t **tmp =
+      realloc(group->hosts, sizeof(*group->hosts) * (group->hosts_num + 1));
+  if (tmp == NULL)
+    return -1;
+  group->hosts = tmp;
+  group->hosts[group->hosts_num] = hd;
+  group->hosts_num++;
+
+  return 0;
+} /* int csnmp_async_add_host */
+/* }}} End of asynchronous mode */
+
 static int csnmp_init(void) {
   call_snmp_init_once();
 
@@ -2176,6 +2691,9 @@ static int csnmp_shutdown(void) {
    * `host_definition_t' will be freed. */
   DEBUG("snmp plugin: Destroying all data definitions.");
 
+  /* The groups themselves are freed with the read callbacks. */
+  async_groups = NULL;
+
   data_this = data_head;
   data_head = NULL;
   while (data_this != NULL) {
@@ -121,6 +121,26 @@ struct data_definition_s {
 };
 typedef struct data_definition_s data_definition_t;
 
+/* Latest values of a cache entry shown in a table, updated by cache events */
+struct table_values_s {
+  const data_set_t *ds;
+  value_t *values;
+  size_t values_num;
+};
+typedef struct table_values_s table_values_t;
+
+/* A single table cell. Cells are kept sorted by OID so that the column
+ * handlers can look up the next cell of a walk without visiting the others. */
+struct table_cell_s {
+  oid *oid;
+  size_t oid_len;
+  table_definition_t *td;
+  data_definition_t *dd;  /* NULL for the table's index OID */
+  size_t oid_index;       /* Position of the column in dd->oids */
+  table_values_t *values; /* NULL for index keys and the table's index OID */
+};
+typedef struct table_cell_s table_cell_t;
+
 struct snmp_agent_ctx_s {
   pthread_t thread;
   pthread_mutex_t lock;
@@ -130,6 +150,8 @@ struct snmp_agent_ctx_s {
   llist_t *tables;
   llist_t *scalars;
   c_avl_tree_t *registered_oids; /* AVL tree containing all registered OIDs */
+  c_avl_tree_t *cells;           /* Table cells, sorted by OID */
+  c_avl_tree_t *values;          /* Cache entry name -> table_values_t */
 };
 typedef struct snmp_agent_ctx_s snmp_agent_ctx_t;
 
@@ -149,7 +171,6 @@ static int snmp_agent_register_oid(oid_t *oid, Netsnmp_Node_Handler *handler);
 static int snmp_agent_set_vardata(void *dst_buf, size_t *dst_buf_len,
                                   u_char asn_type, double scale, double shift,
                                   const void *value, size_t len, int type);
-static int snmp_agent_unregister_oid_index(oid_t *oid, int index);
 static int snmp_agent_update_instance_oids(c_avl_tree_t *tree, oid_t *index_oid,
                                            int value);
 static int num_compare(const int *a, const int *b);
@@ -635,49 +656,101 @@ static int snmp_agent_append_oid(oid_t *out, const oid_t *in) {
   return 0;
 }
 
-static int snmp_agent_register_oid_string(const oid_t *oid,
-                                          const oid_t *index_oid,
-                                          Netsnmp_Node_Handler *handler) {
-  oid_t new_oid;
+/* Builds the OID of the cell of the row "index_oid" in "column". Rows of
+ * tables with an index OID are numbered, the others are indexed by the OID
+ * built from their index keys. */
+static int snmp_agent_cell_oid(oid_t *out, const oid_t *column,
+                               const table_definition_t *td,
+                               const oid_t *index_oid) {
+  int *index;
 
-  memcpy(&new_oid, oid, sizeof(*oid));
-  /* Concatenating two string oids */
-  int ret = snmp_agent_append_oid(&new_oid, index_oid);
-  if (ret != 0)
-    return ret;
+  memcpy(out, column, sizeof(*out));
+  if (td->index_oid.oid_len == 0)
+    return snmp_agent_append_oid(out, index_oid);
+
+  if (c_avl_get(td->instance_index, index_oid, (void **)&index) != 0)
+    return -ENOENT;
+
+  if (out->oid_len >= MAX_OID_LEN) {
+    ERROR(PLUGIN_NAME ": Cannot create OID. Output length is too long!");
+    return -EINVAL;
+  }
+  out->oid[out->oid_len++] = *index;
 
-  return snmp_agent_register_oid(&new_oid, handler);
+  return 0;
 }
 
-static int snmp_agent_unregister_oid(oid_t *oid) {
-  int ret = c_avl_remove(g_agent->registered_oids, (void *)oid, NULL, NULL);
+static int snmp_agent_register_cell(const oid_t *column,
+                                    table_definition_t *td,
+                                    data_definition_t *dd, size_t oid_index,
+                                    const oid_t *index_oid,
+                                    table_values_t *values) {
+  oid_t cell_oid;
 
+  int ret = snmp_agent_cell_oid(&cell_oid, column, td, index_oid);
   if (ret != 0)
-    ERROR(PLUGIN_NAME ": Could not delete registration info");
+    return ret;
 
-  return unregister_mib(oid->oid, oid->oid_len);
+  table_cell_t key = {.oid = cell_oid.oid, .oid_len = cell_oid.oid_len};
+  if (c_avl_get(g_agent->cells, &key, NULL) == 0)
+    return OID_EXISTS;
+
+  /* The OID is stored right after the cell */
+  table_cell_t *cell =
+      calloc(1, sizeof(*cell) + cell_oid.oid_len * sizeof(*cell_oid.oid));
+  if (cell == NULL) {
+    ERROR(PLUGIN_NAME ": Could not allocate memory to register new OID");
+    return -ENOMEM;
+  }
+
+  cell->oid = (oid *)(cell + 1);
+  memcpy(cell->oid, cell_oid.oid, cell_oid.oid_len * sizeof(*cell_oid.oid));
+  cell->oid_len = cell_oid.oid_len;
+  cell->td = td;
+  cell->dd = dd;
+  cell->oid_index = oid_index;
+  cell->values = values;
+
+  ret = c_avl_insert(g_agent->cells, cell, cell);
+  if (ret != 0) {
+    ERROR(PLUGIN_NAME ": Could not allocate memory to register new OID");
+    sfree(cell);
+    return -ENOMEM;
+  }
+
+  return 0;
 }
 
-static int snmp_agent_unregister_oid_string(oid_t *oid,
-                                            const oid_t *index_oid) {
-  oid_t new_oid;
-  char oid_str[DATA_MAX_NAME_LEN];
+/* Removes the cell of the row "index_oid" in "column". Unless "values" is
+ * NULL, the cell is only removed if it shows these values. */
+static int snmp_agent_unregister_cell(const oid_t *column,
+                                      const table_definition_t *td,
+                                      const oid_t *index_oid,
+                                      const table_values_t *values) {
+  oid_t cell_oid;
+  table_cell_t *cell;
 
-  memcpy(&new_oid, oid, sizeof(*oid));
-  /* Concatenating two string oids */
-  int ret = snmp_agent_append_oid(&new_oid, index_oid);
+  int ret = snmp_agent_cell_oid(&cell_oid, column, td, index_oid);
   if (ret != 0)
     return ret;
 
-  snmp_agent_oid_to_string(oid_str, sizeof(oid_str), &new_oid);
-  DEBUG(PLUGIN_NAME ": Unregistered handler for OID (%s)", oid_str);
+  table_cell_t key = {.oid = cell_oid.oid, .oid_len = cell_oid.oid_len};
+  if (c_avl_get(g_agent->cells, &key, (void **)&cell) != 0)
+    return -ENOENT;
 
-  return snmp_agent_unregister_oid(&new_oid);
+  if ((values != NULL) && (cell->values != values))
+    return -ENOENT;
+
+  c_avl_remove(g_agent->cells, &key, NULL, NULL);
+  sfree(cell);
+
+  return 0;
 }
 
 static void snmp_agent_table_data_remove(data_definition_t *dd,
                                          table_definition_t *td,
-                                         oid_t *index_oid) {
+                                         oid_t *index_oid,
+                                         const table_values_t *values) {
   int *index = NULL;
   oid_t *ind_oid = NULL;
 
@@ -690,25 +763,19 @@ static void snmp_agent_table_data_remove(data_definition_t *dd,
       return;
   }
 
-  pthread_mutex_lock(&g_agent->agentx_lock);
-
   int reg_oids = -1; /* Number of registered oids for given instance */
 
   for (size_t i = 0; i < dd->oids_len; i++) {
-    if (td->index_oid.oid_len)
-      snmp_agent_unregister_oid_index(&dd->oids[i], *index);
-    else
-      snmp_agent_unregister_oid_string(&dd->oids[i], index_oid);
+    if (snmp_agent_unregister_cell(&dd->oids[i], td, index_oid, values) != 0)
+      continue;
 
     reg_oids =
         snmp_agent_update_instance_oids(td->instance_oids, index_oid, -1);
   }
 
   /* Checking if any metrics are left registered */
-  if (reg_oids != 0) {
-    pthread_mutex_unlock(&g_agent->agentx_lock);
+  if (reg_oids != 0)
     return;
-  }
 
   /* All metrics have been unregistered. Unregistering index key OIDs */
   int keys_processed = 0;
@@ -719,15 +786,11 @@ static void snmp_agent_table_data_remove(data_definition_t *dd,
       continue;
 
     for (size_t i = 0; i < idd->oids_len; i++)
-      if (td->index_oid.oid_len)
-        snmp_agent_unregister_oid_index(&idd->oids[i], *index);
-      else
-        snmp_agent_unregister_oid_string(&idd->oids[i], index_oid);
+      snmp_agent_unregister_cell(&idd->oids[i], td, index_oid, NULL);
 
     if (++keys_processed >= td->index_keys_len)
       break;
   }
-  pthread_mutex_unlock(&g_agent->agentx_lock);
 
   /* All OIDs have been unregistered so we dont need this instance registered
    * as well */
@@ -753,21 +816,22 @@ static void snmp_agent_table_data_remove(data_definition_t *dd,
   sfree(val);
 
   if (index != NULL) {
-    pthread_mutex_lock(&g_agent->agentx_lock);
-    snmp_agent_unregister_oid_index(&td->index_oid, *index);
-    pthread_mutex_unlock(&g_agent->agentx_lock);
+    snmp_agent_unregister_cell(&td->index_oid, td, index_oid, NULL);
 
     c_avl_remove(td->index_instance, index, NULL, (void **)&ind_oid);
     c_avl_remove(td->instance_index, index_oid, NULL, (void **)&index);
     sfree(index);
     sfree(ind_oid);
   } else {
-    c_avl_remove(td->instance_index, index_oid, NULL, NULL);
+    oid_t *key = NULL;
+
+    c_avl_remove(td->instance_index, index_oid, (void **)&key, NULL);
+    sfree(key);
   }
 }
 
 static int snmp_agent_clear_missing(const value_list_t *vl,
-                                    __attribute__((unused)) user_data_t *ud) {
+                                    const table_values_t *values) {
   if (vl == NULL)
     return -EINVAL;
 
@@ -780,18 +844,12 @@ static int snmp_agent_clear_missing(const value_list_t *vl,
       if (!dd->is_index_key) {
         if (CHECK_DD_TYPE(dd, vl->plugin, vl->plugin_instance, vl->type,
                           vl->type_instance)) {
-          oid_t *index_oid = calloc(1, sizeof(*index_oid));
-
-          if (index_oid == NULL) {
-            ERROR(PLUGIN_NAME ": Could not allocate memory for index_oid");
-            return -ENOMEM;
-          }
+          oid_t index_oid;
 
-          int ret = snmp_agent_generate_index(td, vl, index_oid);
+          int ret = snmp_agent_generate_index(td, vl, &index_oid);
 
           if (ret == 0)
-            snmp_agent_table_data_remove(dd, td, index_oid);
-          sfree(index_oid);
+            snmp_agent_table_data_remove(dd, td, &index_oid, values);
 
           return ret;
         }
@@ -807,11 +865,9 @@ static void snmp_agent_free_data(data_definition_t **dd) {
   if (dd == NULL || *dd == NULL)
     return;
 
-  /* unregister scalar type OID */
-  if ((*dd)->table == NULL) {
-    for (size_t i = 0; i < (*dd)->oids_len; i++)
-      unregister_mib((*dd)->oids[i].oid, (*dd)->oids[i].oid_len);
-  }
+  /* unregister scalar type OID or table column */
+  for (size_t i = 0; i < (*dd)->oids_len; i++)
+    unregister_mib((*dd)->oids[i].oid, (*dd)->oids[i].oid_len);
 
   sfree((*dd)->name);
   sfree((*dd)->plugin);
@@ -832,28 +888,6 @@ static void snmp_agent_free_table_columns(table_definition_t *td) {
   for (llentry_t *de = llist_head(td->columns); de != NULL; de = de->next) {
     data_definition_t *dd = de->value;
 
-    if (td->index_oid.oid_len) {
-      int *index;
-      oid_t *index_oid;
-
-      c_avl_iterator_t *iter = c_avl_get_iterator(td->index_instance);
-      while (c_avl_iterator_next(iter, (void *)&index, (void *)&index_oid) ==
-             0) {
-        for (size_t i = 0; i < dd->oids_len; i++)
-          snmp_agent_unregister_oid_index(&dd->oids[i], *index);
-      }
-      c_avl_iterator_destroy(iter);
-    } else {
-      oid_t *index_oid;
-
-      c_avl_iterator_t *iter = c_avl_get_iterator(dd->table->instance_index);
-      while (c_avl_iterator_next(iter, (void *)&index_oid, NULL) == 0) {
-        for (size_t i = 0; i < dd->oids_len; i++)
-          snmp_agent_unregister_oid_string(&dd->oids[i], index_oid);
-      }
-      c_avl_iterator_destroy(iter);
-    }
-
     snmp_agent_free_data(&dd);
   }
 
@@ -869,22 +903,14 @@ static void snmp_agent_free_table(table_definition_t **td) {
   if ((*td)->size_oid.oid_len)
     unregister_mib((*td)->size_oid.oid, (*td)->size_oid.oid_len);
 
-  oid_t *index_oid;
-
-  /* Unregister Index OIDs */
-  if ((*td)->index_oid.oid_len) {
-    int *index;
-
-    c_avl_iterator_t *iter = c_avl_get_iterator((*td)->index_instance);
-    while (c_avl_iterator_next(iter, (void **)&index, (void **)&index_oid) == 0)
-      snmp_agent_unregister_oid_index(&(*td)->index_oid, *index);
-
-    c_avl_iterator_destroy(iter);
-  }
+  if ((*td)->index_oid.oid_len)
+    unregister_mib((*td)->index_oid.oid, (*td)->index_oid.oid_len);
 
-  /* Unregister all table columns and their registered OIDs */
+  /* Unregister all table columns */
   snmp_agent_free_table_columns(*td);
 
+  oid_t *index_oid;
+
   void *key = NULL;
   void *value = NULL;
   int *num = NULL;
@@ -1043,50 +1069,65 @@ static int snmp_agent_format_name(char *name, int name_len,
   return 0;
 }
 
-static int snmp_agent_form_reply(struct netsnmp_request_info_s *requests,
-                                 data_definition_t *dd, oid_t *index_oid,
-                                 int oid_index) {
-  int ret;
+static int snmp_agent_form_value_reply(netsnmp_variable_list *vb,
+                                       const data_definition_t *dd,
+                                       int oid_index, const data_set_t *ds,
+                                       const value_t *values) {
+  char data[DATA_MAX_NAME_LEN];
+  size_t data_len = sizeof(data);
+  int ret = snmp_agent_set_vardata(
+      data, &data_len, dd->oids[oid_index].type, dd->scale, dd->shift,
+      &values[oid_index], sizeof(values[oid_index]), ds->ds[oid_index].type);
 
-  if (dd->is_index_key) {
-    const table_definition_t *td = dd->table;
-    int ret = snmp_agent_parse_oid_index_keys(td, index_oid);
+  if (ret != 0)
+    return ret;
 
-    if (ret != 0)
-      return ret;
+  vb->type = dd->oids[oid_index].type;
+  snmp_set_var_typed_value(vb, vb->type, (const u_char *)data, data_len);
 
-    netsnmp_variable_list *key = td->index_list_cont;
-    /* Searching index key */
-    for (int pos = 0; pos < dd->index_key_pos; pos++)
-      key = key->next_variable;
+  return SNMP_ERR_NOERROR;
+}
+
+static int snmp_agent_form_index_key_reply(netsnmp_variable_list *vb,
+                                           const data_definition_t *dd,
+                                           oid_t *index_oid) {
+  const table_definition_t *td = dd->table;
+  int ret = snmp_agent_parse_oid_index_keys(td, index_oid);
+
+  if (ret != 0)
+    return ret;
+
+  netsnmp_variable_list *key = td->index_list_cont;
+  /* Searching index key */
+  for (int pos = 0; pos < dd->index_key_pos; pos++)
+    key = key->next_variable;
 
-    requests->requestvb->type = td->index_keys[dd->index_key_pos].type;
+  vb->type = td->index_keys[dd->index_key_pos].type;
 
-    if (requests->requestvb->type == ASN_INTEGER)
+  if (vb->type == ASN_INTEGER)
 #ifdef HAVE_NETSNMP_OLD_API
-      snmp_set_var_typed_value(requests->requestvb, requests->requestvb->type,
-                               (const u_char *)key->val.integer,
-                               sizeof(*key->val.integer));
+    snmp_set_var_typed_value(vb, vb->type, (const u_char *)key->val.integer,
+                             sizeof(*key->val.integer));
 #else
-      snmp_set_var_typed_value(requests->requestvb, requests->requestvb->type,
-                               key->val.integer, sizeof(*key->val.integer));
+    snmp_set_var_typed_value(vb, vb->type, key->val.integer,
+                             sizeof(*key->val.integer));
 #endif
-    else /* OCTET_STR */
+  else /* OCTET_STR */
 #ifdef HAVE_NETSNMP_OLD_API
-      snmp_set_var_typed_value(requests->requestvb, requests->requestvb->type,
-                               (const u_char *)key->val.string,
-                               strlen((const char *)key->val.string));
+    snmp_set_var_typed_value(vb, vb->type, (const u_char *)key->val.string,
+                             strlen((const char *)key->val.string));
 #else
-      snmp_set_var_typed_value(requests->requestvb, requests->requestvb->type,
-                               key->val.string,
-                               strlen((const char *)key->val.string));
+    snmp_set_var_typed_value(vb, vb->type, key->val.string,
+                             strlen((const char *)key->val.string));
 #endif
 
-    pthread_mutex_unlock(&g_agent->lock);
-
-    return SNMP_ERR_NOERROR;
-  }
+  return SNMP_ERR_NOERROR;
+}
 
+static int snmp_agent_form_reply(struct netsnmp_request_info_s *requests,
+                                 data_definition_t *dd, oid_t *index_oid,
+                                 int oid_index) {
+  int ret;
   char name[DATA_MAX_NAME_LEN];
 
   ret = snmp_agent_format_name(name, sizeof(name), dd, index_oid);
@@ -1113,11 +1154,8 @@ static int snmp_agent_form_reply(struct netsnmp_request_info_s *requests,
   assert(ds->ds_num == values_num);
   assert(oid_index < (int)values_num);
 
-  char data[DATA_MAX_NAME_LEN];
-  size_t data_len = sizeof(data);
-  ret = snmp_agent_set_vardata(
-      data, &data_len, dd->oids[oid_index].type, dd->scale, dd->shift,
-      &values[oid_index], sizeof(values[oid_index]), ds->ds[oid_index].type);
+  ret = snmp_agent_form_value_reply(requests->requestvb, dd, oid_index, ds,
+                                    values);
 
   sfree(values);
 
@@ -1126,140 +1164,126 @@ static int snmp_agent_form_reply(struct netsnmp_request_info_s *requests,
     return SNMP_NOSUCHINSTANCE;
   }
 
-  requests->requestvb->type = dd->oids[oid_index].type;
-  snmp_set_var_typed_value(requests->requestvb, requests->requestvb->type,
-                           (const u_char *)data, data_len);
-
   return SNMP_ERR_NOERROR;
 }
 
-static int
-snmp_agent_table_oid_handler(struct netsnmp_mib_handler_s *handler,
-                             struct netsnmp_handler_registration_s *reginfo,
-                             struct netsnmp_agent_request_info_s *reqinfo,
-                             struct netsnmp_request_info_s *requests) {
+/* Replies with the contents of a table cell. Values are taken from the cell
+ * rather than the cache, so a walk needs no lookup per varbind. */
+static int snmp_agent_form_cell_reply(netsnmp_variable_list *vb,
+                                      const table_cell_t *cell) {
+  const table_definition_t *td = cell->td;
+  const data_definition_t *dd = cell->dd;
 
-  if (reqinfo->mode != MODE_GET) {
-    DEBUG(PLUGIN_NAME ": Not supported request mode (%d)", reqinfo->mode);
+  if (dd == NULL) {
+    /* The table's index OID */
+    int index = cell->oid[cell->oid_len - 1];
+
+    vb->type = ASN_INTEGER;
+    snmp_set_var_typed_value(vb, vb->type, (const u_char *)&index,
+                             sizeof(index));
     return SNMP_ERR_NOERROR;
   }
 
-  pthread_mutex_lock(&g_agent->lock);
-
-  oid_t oid; /* Requested OID */
-  memcpy(oid.oid, requests->requestvb->name,
-         sizeof(oid.oid[0]) * requests->requestvb->name_length);
-  oid.oid_len = requests->requestvb->name_length;
-
-#if COLLECT_DEBUG
-  char oid_str[DATA_MAX_NAME_LEN];
-  snmp_agent_oid_to_string(oid_str, sizeof(oid_str), &oid);
-  DEBUG(PLUGIN_NAME ": Get request received for table OID '%s'", oid_str);
-#endif
-  oid_t index_oid; /* Index part of requested OID */
-
-  for (llentry_t *te = llist_head(g_agent->tables); te != NULL; te = te->next) {
-    table_definition_t *td = te->value;
-
-    for (llentry_t *de = llist_head(td->columns); de != NULL; de = de->next) {
-      data_definition_t *dd = de->value;
-
-      for (size_t i = 0; i < dd->oids_len; i++) {
-        int ret = snmp_oid_ncompare(oid.oid, oid.oid_len, dd->oids[i].oid,
-                                    dd->oids[i].oid_len,
-                                    SNMP_MIN(oid.oid_len, dd->oids[i].oid_len));
-        if (ret != 0)
-          continue;
-
-        /* Calculating OID length for index part */
-        index_oid.oid_len = oid.oid_len - dd->oids[i].oid_len;
-        /* Fetching index part of the OID */
-        memcpy(index_oid.oid, &oid.oid[dd->oids[i].oid_len],
-               index_oid.oid_len * sizeof(*oid.oid));
-
-        char index_str[DATA_MAX_NAME_LEN];
-        snmp_agent_oid_to_string(index_str, sizeof(index_str), &index_oid);
-
-        if (!td->index_oid.oid_len) {
-          ret = c_avl_get(td->instance_index, &index_oid, NULL);
-        } else {
-          oid_t *temp_oid;
-
-          assert(index_oid.oid_len == 1);
-          ret = c_avl_get(td->index_instance, (int *)&index_oid.oid[0],
-                          (void **)&temp_oid);
-          memcpy(&index_oid, temp_oid, sizeof(index_oid));
-        }
-
-        if (ret != 0) {
-          INFO(PLUGIN_NAME ": Non-existing index (%s) requested", index_str);
-          pthread_mutex_unlock(&g_agent->lock);
-          return SNMP_NOSUCHINSTANCE;
-        }
+  if (dd->is_index_key) {
+    size_t column_len = dd->oids[cell->oid_index].oid_len;
+    oid_t index_oid;
 
-        ret = snmp_agent_form_reply(requests, dd, &index_oid, i);
-        pthread_mutex_unlock(&g_agent->lock);
+    if (td->index_oid.oid_len) {
+      int index = cell->oid[cell->oid_len - 1];
+      oid_t *stored_oid;
 
-        return ret;
-      }
+      if (c_avl_get(td->index_instance, &index, (void **)&stored_oid) != 0)
+        return SNMP_NOSUCHINSTANCE;
+      memcpy(&index_oid, stored_oid, sizeof(index_oid));
+    } else {
+      index_oid.oid_len = cell->oid_len - column_len;
+      memcpy(index_oid.oid, &cell->oid[column_len],
+             index_oid.oid_len * sizeof(*index_oid.oid));
     }
+
+    return snmp_agent_form_index_key_reply(vb, dd, &index_oid);
   }
 
-  pthread_mutex_unlock(&g_agent->lock);
+  const table_values_t *values = cell->values;
+  if ((values == NULL) || (cell->oid_index >= values->values_num))
+    return SNMP_NOSUCHINSTANCE;
 
-  return SNMP_NOSUCHINSTANCE;
+  return snmp_agent_form_value_reply(vb, dd, cell->oid_index, values->ds,
+                                     values->values);
 }
 
-static int snmp_agent_table_index_oid_handler(
-    struct netsnmp_mib_handler_s *handler,
-    struct netsnmp_handler_registration_s *reginfo,
-    struct netsnmp_agent_request_info_s *reqinfo,
-    struct netsnmp_request_info_s *requests) {
+/* Handles requests for all cells of one table column, or the table's index
+ * OID. GETBULK requests are turned into GETNEXT requests by net-snmp. */
+static int
+snmp_agent_table_oid_handler(struct netsnmp_mib_handler_s *handler,
+                             struct netsnmp_handler_registration_s *reginfo,
+                             struct netsnmp_agent_request_info_s *reqinfo,
+                             struct netsnmp_request_info_s *requests) {
 
-  if (reqinfo->mode != MODE_GET) {
+  if ((reqinfo->mode != MODE_GET) && (reqinfo->mode != MODE_GETNEXT)) {
     DEBUG(PLUGIN_NAME ": Not supported request mode (%d)", reqinfo->mode);
     return SNMP_ERR_NOERROR;
   }
 
   pthread_mutex_lock(&g_agent->lock);
 
-  oid_t oid;
-  memcpy(oid.oid, requests->requestvb->name,
-         sizeof(oid.oid[0]) * requests->requestvb->name_length);
-  oid.oid_len = requests->requestvb->name_length;
-
-  for (llentry_t *te = llist_head(g_agent->tables); te != NULL; te = te->next) {
-    table_definition_t *td = te->value;
+  for (netsnmp_request_info *req = requests; req != NULL; req = req->next) {
+    netsnmp_variable_list *vb = req->requestvb;
+    table_cell_t key = {.oid = vb->name, .oid_len = vb->name_length};
+    table_cell_t *cell;
 
-    if (td->index_oid.oid_len &&
-        (snmp_oid_ncompare(
-             oid.oid, oid.oid_len, td->index_oid.oid, td->index_oid.oid_len,
-             SNMP_MIN(oid.oid_len, td->index_oid.oid_len)) == 0)) {
+#if COLLECT_DEBUG
+    oid_t oid;
+    char oid_str[DATA_MAX_NAME_LEN];
+    memcpy(oid.oid, vb->name, sizeof(oid.oid[0]) * vb->name_length);
+    oid.oid_len = vb->name_length;
+    snmp_agent_oid_to_string(oid_str, sizeof(oid_str), &oid);
+    DEBUG(PLUGIN_NAME ": Request (%d) received for table OID '%s'",
+          reqinfo->mode, oid_str);
+#endif
 
-      DEBUG(PLUGIN_NAME ": Handle '%s' table index OID", td->name);
+    if (reqinfo->mode == MODE_GET) {
+      if ((c_avl_get(g_agent->cells, &key, (void **)&cell) != 0) ||
+          (snmp_agent_form_cell_reply(vb, cell) != SNMP_ERR_NOERROR))
+        netsnmp_set_request_error(reqinfo, req, SNMP_NOSUCHINSTANCE);
+      continue;
+    }
 
-      int index = oid.oid[oid.oid_len - 1];
+    /* Walks may start anywhere before the column */
+    if (snmp_oid_compare(vb->name, vb->name_length, reginfo->rootoid,
+                         reginfo->rootoid_len) < 0)
+      key = (table_cell_t){.oid = reginfo->rootoid,
+                           .oid_len = reginfo->rootoid_len};
 
-      int ret = c_avl_get(td->index_instance, &index, NULL);
-      if (ret != 0) {
-        /* nonexisting index requested */
-        pthread_mutex_unlock(&g_agent->lock);
-        return SNMP_NOSUCHINSTANCE;
-      }
+    c_avl_iterator_t *iter = c_avl_get_iterator(g_agent->cells);
+    if (iter == NULL)
+      continue;
 
-      requests->requestvb->type = ASN_INTEGER;
-      snmp_set_var_typed_value(requests->requestvb, requests->requestvb->type,
-                               (const u_char *)&index, sizeof(index));
+    /* Cells without a value are skipped. If there is no next cell in this
+     * column, the varbind is left alone and the agent continues with the next
+     * registration. */
+    void *cell_key;
+    c_avl_iterator_seek(iter, &key);
+    while (c_avl_iterator_next(iter, &cell_key, (void **)&cell) == 0) {
+      if (snmp_oid_ncompare(cell->oid, cell->oid_len, reginfo->rootoid,
+                            reginfo->rootoid_len, reginfo->rootoid_len) != 0)
+        break;
 
-      pthread_mutex_unlock(&g_agent->lock);
+      if (snmp_oid_compare(cell->oid, cell->oid_len, vb->name,
+                           vb->name_length) <= 0)
+        continue;
 
-      return SNMP_ERR_NOERROR;
+      if (snmp_agent_form_cell_reply(vb, cell) == SNMP_ERR_NOERROR) {
+        snmp_set_var_objid(vb, cell->oid, cell->oid_len);
+        break;
+      }
     }
+    c_avl_iterator_destroy(iter);
   }
 
   pthread_mutex_unlock(&g_agent->lock);
 
-  return SNMP_NOSUCHINSTANCE;
+  return SNMP_ERR_NOERROR;
 }
 
 static int snmp_agent_table_size_oid_handler(
@@ -1360,17 +1384,62 @@ snmp_agent_scalar_oid_handler(struct netsnmp_mib_handler_s *handler,
   return SNMP_NOSUCHINSTANCE;
 }
 
+/* Registers the table handler for all cells below the column "oid" */
+static int snmp_agent_register_column(oid_t *oid) {
+  char *oid_name = snmp_agent_get_oid_name(oid->oid, oid->oid_len);
+  char oid_str[DATA_MAX_NAME_LEN];
+
+  snmp_agent_oid_to_string(oid_str, sizeof(oid_str), oid);
+
+  if (oid_name == NULL) {
+    WARNING(PLUGIN_NAME
+            ": Skipped registration: OID (%s) is not found in main tree",
+            oid_str);
+    return 0;
+  }
+
+  netsnmp_handler_registration *reg = netsnmp_create_handler_registration(
+      oid_name, snmp_agent_table_oid_handler, oid->oid, oid->oid_len,
+      HANDLER_CAN_RONLY);
+  if (reg == NULL) {
+    ERROR(PLUGIN_NAME ": Failed to create handler registration for OID (%s)",
+          oid_str);
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_agent->agentx_lock);
+
+  if (netsnmp_register_handler(reg) != MIB_REGISTERED_OK) {
+    ERROR(PLUGIN_NAME ": Failed to register handler for OID (%s)", oid_str);
+    pthread_mutex_unlock(&g_agent->agentx_lock);
+    return -1;
+  }
+
+  pthread_mutex_unlock(&g_agent->agentx_lock);
+
+  DEBUG(PLUGIN_NAME ": Registered handler for column OID (%s)", oid_str);
+
+  return 0;
+}
+
 static int snmp_agent_register_table_oids(void) {
 
   for (llentry_t *te = llist_head(g_agent->tables); te != NULL; te = te->next) {
     table_definition_t *td = te->value;
+    int ret;
 
     if (td->size_oid.oid_len != 0) {
       td->size_oid.type =
           snmp_agent_get_asn_type(td->size_oid.oid, td->size_oid.oid_len);
       td->size_oid.oid_len++;
-      int ret = snmp_agent_register_oid(&td->size_oid,
-                                        snmp_agent_table_size_oid_handler);
+      ret = snmp_agent_register_oid(&td->size_oid,
+                                    snmp_agent_table_size_oid_handler);
+      if (ret != 0)
+        return ret;
+    }
+
+    if (td->index_oid.oid_len != 0) {
+      ret = snmp_agent_register_column(&td->index_oid);
       if (ret != 0)
         return ret;
     }
@@ -1381,6 +1450,10 @@ static int snmp_agent_register_table_oids(void) {
       for (size_t i = 0; i < dd->oids_len; i++) {
         dd->oids[i].type =
             snmp_agent_get_asn_type(dd->oids[i].oid, dd->oids[i].oid_len);
+
+        ret = snmp_agent_register_column(&dd->oids[i]);
+        if (ret != 0)
+          return ret;
       }
     }
   }
@@ -1688,6 +1761,10 @@ static int oid_compare(const oid_t *a, const oid_t *b) {
   return snmp_oid_compare(a->oid, a->oid_len, b->oid, b->oid_len);
 }
 
+static int cell_compare(const table_cell_t *a, const table_cell_t *b) {
+  return snmp_oid_compare(a->oid, a->oid_len, b->oid, b->oid_len);
+}
+
 static int snmp_agent_config_table(oconfig_item_t *ci) {
   table_definition_t *td;
   int ret = 0;
@@ -1857,21 +1934,6 @@ static int snmp_agent_set_vardata(void *data, size_t *data_len, u_char asn_type,
   return 0;
 }
 
-static int snmp_agent_register_oid_index(oid_t *oid, int index,
-                                         Netsnmp_Node_Handler *handler) {
-  oid_t new_oid;
-  memcpy(&new_oid, oid, sizeof(*oid));
-  new_oid.oid[new_oid.oid_len++] = index;
-  return snmp_agent_register_oid(&new_oid, handler);
-}
-
-static int snmp_agent_unregister_oid_index(oid_t *oid, int index) {
-  oid_t new_oid;
-  memcpy(&new_oid, oid, sizeof(*oid));
-  new_oid.oid[new_oid.oid_len++] = index;
-  return snmp_agent_unregister_oid(&new_oid);
-}
-
 static int snmp_agent_update_instance_oids(c_avl_tree_t *tree, oid_t *index_oid,
                                            int value) {
   int *oids_num; /* number of oids registered for instance */
@@ -1887,6 +1949,7 @@ static int snmp_agent_update_instance_oids(c_avl_tree_t *tree, oid_t *index_oid,
 
 static int snmp_agent_update_index(data_definition_t *dd,
                                    table_definition_t *td, oid_t *index_oid,
+                                   table_values_t *values,
                                    bool *free_index_oid) {
   int ret;
   int *index = NULL;
@@ -1917,8 +1980,8 @@ static int snmp_agent_update_index(data_definition_t *dd,
         goto remove_avl_index_oid;
       }
 
-      ret = snmp_agent_register_oid_index(&td->index_oid, *index,
-                                          snmp_agent_table_index_oid_handler);
+      ret = snmp_agent_register_cell(&td->index_oid, td, NULL, 0, index_oid,
+                                     NULL);
       if (ret != 0)
         goto remove_avl_index;
     } else {
@@ -1953,13 +2016,8 @@ static int snmp_agent_update_index(data_definition_t *dd,
         continue;
 
       for (size_t i = 0; i < idd->oids_len; i++) {
-        if (td->index_oid.oid_len)
-          ret = snmp_agent_register_oid_index(&idd->oids[i], *index,
-                                              snmp_agent_table_oid_handler);
-        else
-          ret = snmp_agent_register_oid_string(&idd->oids[i], index_oid,
-                                               snmp_agent_table_oid_handler);
-
+        ret = snmp_agent_register_cell(&idd->oids[i], td, idd, i, index_oid,
+                                       NULL);
         if (ret != 0) {
           ERROR(PLUGIN_NAME ": Could not register OID");
           goto free_index;
@@ -1974,13 +2032,7 @@ static int snmp_agent_update_index(data_definition_t *dd,
   ret = 0;
 
   for (size_t i = 0; i < dd->oids_len; i++) {
-    if (td->index_oid.oid_len)
-      ret = snmp_agent_register_oid_index(&dd->oids[i], *index,
-                                          snmp_agent_table_oid_handler);
-    else
-      ret = snmp_agent_register_oid_string(&dd->oids[i], index_oid,
-                                           snmp_agent_table_oid_handler);
-
+    ret = snmp_agent_register_cell(&dd->oids[i], td, dd, i, index_oid, values);
     if (ret < 0)
       goto free_index;
     else if (ret == OID_EXISTS)
@@ -2014,7 +2066,7 @@ free_value:
   sfree(value);
 unregister_index:
   if (td->index_oid.oid_len)
-    snmp_agent_unregister_oid_index(index_oid, *index);
+    snmp_agent_unregister_cell(&td->index_oid, td, index_oid, NULL);
 remove_avl_index:
   if (td->index_oid.oid_len)
     c_avl_remove(td->index_instance, index, NULL, NULL);
@@ -2029,7 +2081,15 @@ error:
   return ret;
 }
 
-static int snmp_agent_write(value_list_t const *vl) {
+static void snmp_agent_free_values(table_values_t *values) {
+  if (values == NULL)
+    return;
+
+  sfree(values->values);
+  sfree(values);
+}
+
+static int snmp_agent_write(value_list_t const *vl, const char *name) {
   if (vl == NULL)
     return -EINVAL;
 
@@ -2042,18 +2102,51 @@ static int snmp_agent_write(value_list_t const *vl) {
       if (!dd->is_index_key) {
         if (CHECK_DD_TYPE(dd, vl->plugin, vl->plugin_instance, vl->type,
                           vl->type_instance)) {
+          const data_set_t *ds = plugin_get_ds(vl->type);
+          if (ds == NULL) {
+            ERROR(PLUGIN_NAME ": Data set not found for '%s' type", vl->type);
+            return -ENOENT;
+          }
+
           oid_t *index_oid = calloc(1, sizeof(*index_oid));
+          table_values_t *values = calloc(1, sizeof(*values));
+          char *key = strdup(name);
           bool free_index_oid = true;
 
-          if (index_oid == NULL) {
+          if ((index_oid == NULL) || (values == NULL) || (key == NULL)) {
             ERROR(PLUGIN_NAME ": Could not allocate memory for index_oid");
+            sfree(index_oid);
+            sfree(values);
+            sfree(key);
             return -ENOMEM;
           }
 
+          values->ds = ds;
+          values->values = calloc(vl->values_len, sizeof(*values->values));
+          values->values_num = vl->values_len;
+
+          if ((values->values == NULL) ||
+              (c_avl_insert(g_agent->values, key, values) != 0)) {
+            ERROR(PLUGIN_NAME ": Could not store values of '%s'", name);
+            sfree(index_oid);
+            snmp_agent_free_values(values);
+            sfree(key);
+            return -ENOMEM;
+          }
+          memcpy(values->values, vl->values,
+                 vl->values_len * sizeof(*values->values));
+
           int ret = snmp_agent_generate_index(td, vl, index_oid);
 
           if (ret == 0)
-            ret = snmp_agent_update_index(dd, td, index_oid, &free_index_oid);
+            ret = snmp_agent_update_index(dd, td, index_oid, values,
+                                          &free_index_oid);
+
+          if (ret != 0) {
+            c_avl_remove(g_agent->values, key, NULL, NULL);
+            snmp_agent_free_values(values);
+            sfree(key);
+          }
 
           /* Index exists or update failed */
           if (free_index_oid)
@@ -2068,12 +2161,40 @@ static int snmp_agent_write(value_list_t const *vl) {
   return 0;
 }
 
-static int snmp_agent_collect(const data_set_t *ds, const value_list_t *vl,
-                              user_data_t __attribute__((unused)) * user_data) {
+/* Rows are added when a value list is first seen by the cache, their values
+ * are updated with every update of the cache entry and they are removed when
+ * the entry expires. */
+static int snmp_agent_cache_event(cache_event_t *event,
+                                  __attribute__((unused)) user_data_t *ud) {
+  const value_list_t *vl = event->value_list;
+  table_values_t *values = NULL;
+  char *key = NULL;
 
   pthread_mutex_lock(&g_agent->lock);
 
-  snmp_agent_write(vl);
+  switch (event->type) {
+  case CE_VALUE_NEW:
+    snmp_agent_write(vl, event->value_list_name);
+    /* Subscribe to updates of the value lists shown in a table */
+    if (c_avl_get(g_agent->values, event->value_list_name, NULL) == 0)
+      event->ret = 1;
+    break;
+  case CE_VALUE_UPDATE:
+    if ((c_avl_get(g_agent->values, event->value_list_name,
+                   (void **)&values) == 0) &&
+        (values->values_num == vl->values_len))
+      memcpy(values->values, vl->values,
+             vl->values_len * sizeof(*values->values));
+    break;
+  case CE_VALUE_EXPIRED:
+    if (c_avl_remove(g_agent->values, event->value_list_name, (void **)&key,
+                     (void **)&values) == 0) {
+      snmp_agent_clear_missing(vl, values);
+      snmp_agent_free_values(values);
+      sfree(key);
+    }
+    break;
+  }
 
   pthread_mutex_unlock(&g_agent->lock);
 
@@ -2092,12 +2213,18 @@ static int snmp_agent_preinit(void) {
   g_agent->scalars = llist_create();
   g_agent->registered_oids =
       c_avl_create((int (*)(const void *, const void *))oid_compare);
+  g_agent->cells =
+      c_avl_create((int (*)(const void *, const void *))cell_compare);
+  g_agent->values = c_avl_create((int (*)(const void *, const void *))strcmp);
 
-  if (g_agent->tables == NULL || g_agent->scalars == NULL) {
+  if (g_agent->tables == NULL || g_agent->scalars == NULL ||
+      g_agent->cells == NULL || g_agent->values == NULL) {
     ERROR(PLUGIN_NAME ": llist_create() failed");
     llist_destroy(g_agent->scalars);
     llist_destroy(g_agent->tables);
     c_avl_destroy(g_agent->registered_oids);
+    c_avl_destroy(g_agent->cells);
+    c_avl_destroy(g_agent->values);
     return -ENOMEM;
   }
 
@@ -2110,6 +2237,8 @@ static int snmp_agent_preinit(void) {
     llist_destroy(g_agent->scalars);
     llist_destroy(g_agent->tables);
     c_avl_destroy(g_agent->registered_oids);
+    c_avl_destroy(g_agent->cells);
+    c_avl_destroy(g_agent->values);
     return -1;
   }
 
@@ -2124,6 +2253,8 @@ static int snmp_agent_preinit(void) {
     llist_destroy(g_agent->scalars);
     llist_destroy(g_agent->tables);
     c_avl_destroy(g_agent->registered_oids);
+    c_avl_destroy(g_agent->cells);
+    c_avl_destroy(g_agent->values);
     return -1;
   }
 
@@ -2172,10 +2303,8 @@ static int snmp_agent_init(void) {
     return ret;
   }
 
-  if (llist_head(g_agent->tables) != NULL) {
-    plugin_register_write(PLUGIN_NAME, snmp_agent_collect, NULL);
-    plugin_register_missing(PLUGIN_NAME, snmp_agent_clear_missing, NULL);
-  }
+  if (llist_head(g_agent->tables) != NULL)
+    plugin_register_cache_event(PLUGIN_NAME, snmp_agent_cache_event, NULL);
 
   return 0;
 }
@@ -2259,6 +2388,25 @@ static int snmp_agent_free_config(void) {
   if (g_agent == NULL)
     return -EINVAL;
 
+  void *key;
+  void *value;
+
+  if (g_agent->cells != NULL) {
+    while (c_avl_pick(g_agent->cells, &key, &value) == 0)
+      sfree(key);
+    c_avl_destroy(g_agent->cells);
+    g_agent->cells = NULL;
+  }
+
+  if (g_agent->values != NULL) {
+    while (c_avl_pick(g_agent->values, &key, &value) == 0) {
+      sfree(key);
+      snmp_agent_free_values(value);
+    }
+    c_avl_destroy(g_agent->values);
+    g_agent->values = NULL;
+  }
+
   for (llentry_t *te = llist_head(g_agent->tables); te != NULL; te = te->next)
     snmp_agent_free_table((table_definition_t **)&te->value);
   llist_destroy(g_agent->tables);
@@ -2280,6 +2428,8 @@ static int snmp_agent_shutdown(void) {
     return -EINVAL;
   }
 
+  plugin_unregister_cache_event(PLUGIN_NAME);
+
   if (pthread_cancel(g_agent->thread) != 0)
     ERROR(PLUGIN_NAME ": snmp_agent_shutdown: failed to cancel the thread");
 
@@ -784,6 +784,133 @@ DEF_TEST(build_name) {
   return 0;
 }
 
+/* Sends a request for "name" to the handler registered for "column" and
+ * returns the resulting varbind. */
+static netsnmp_variable_list *table_request(int mode, oid_t *column,
+                                            oid_t *name) {
+  netsnmp_handler_registration reginfo = {.rootoid = column->oid,
+                                          .rootoid_len = column->oid_len};
+  netsnmp_agent_request_info reqinfo = {.mode = mode};
+  netsnmp_variable_list *vb = NULL;
+
+  snmp_varlist_add_variable(&vb, name->oid, name->oid_len, ASN_NULL, NULL, 0);
+  netsnmp_request_info req = {.requestvb = vb};
+
+  snmp_agent_table_oid_handler(NULL, &reginfo, &reqinfo, &req);
+  return vb;
+}
+
+DEF_TEST(table_cells) {
+  snmp_agent_ctx_t agent = {0};
+  data_source_t dsrc = {"value", DS_TYPE_GAUGE, 0, NAN};
+  data_set_t ds = {"gauge", 1, &dsrc};
+  oid_t index_oids[3];
+  int indexes[3];
+  value_t values[3];
+  table_values_t table_values[3];
+
+  g_agent = &agent;
+  pthread_mutex_init(&agent.lock, NULL);
+  agent.cells = c_avl_create((int (*)(const void *, const void *))cell_compare);
+
+  table_definition_t td = {
+      .index_oid = {.oid = {1, 3, 6, 1, 4, 1, 99999, 1, 1}, .oid_len = 9}};
+  td.instance_index =
+      c_avl_create((int (*)(const void *, const void *))oid_compare);
+  td.index_instance =
+      c_avl_create((int (*)(const void *, const void *))num_compare);
+
+  oid_t column = {.oid = {1, 3, 6, 1, 4, 1, 99999, 1, 2},
+                  .oid_len = 9,
+                  .type = ASN_GAUGE};
+  data_definition_t dd = {
+      .table = &td, .oids = &column, .oids_len = 1, .scale = 1.0};
+
+  /* Rows are added in reverse order */
+  for (int i = 2; i >= 0; i--) {
+    index_oids[i] = (oid_t){.oid = {100 + i}, .oid_len = 1};
+    indexes[i] = i + 1;
+    values[i].gauge = 10 * (i + 1);
+    table_values[i] = (table_values_t){
+        .ds = &ds, .values = &values[i], .values_num = 1};
+
+    CHECK_ZERO(c_avl_insert(td.instance_index, &index_oids[i], &indexes[i]));
+    CHECK_ZERO(c_avl_insert(td.index_instance, &indexes[i], &index_oids[i]));
+    CHECK_ZERO(snmp_agent_register_cell(&td.index_oid, &td, NULL, 0,
+                                        &index_oids[i], NULL));
+    CHECK_ZERO(snmp_agent_register_cell(&column, &td, &dd, 0, &index_oids[i],
+                                        &table_values[i]));
+  }
+  EXPECT_EQ_INT(OID_EXISTS,
+                snmp_agent_register_cell(&column, &td, &dd, 0, &index_oids[0],
+                                         &table_values[0]));
+  EXPECT_EQ_INT(6, c_avl_size(agent.cells));
+
+  /* GET */
+  oid_t name = column;
+  name.oid[name.oid_len++] = 2;
+  netsnmp_variable_list *vb = table_request(MODE_GET, &column, &name);
+  EXPECT_EQ_INT(ASN_GAUGE, vb->type);
+  EXPECT_EQ_INT(20, *vb->val.integer);
+  snmp_free_varbind(vb);
+
+  /* Values are read from the cell */
+  values[1].gauge = 25;
+  vb = table_request(MODE_GET, &column, &name);
+  EXPECT_EQ_INT(25, *vb->val.integer);
+  snmp_free_varbind(vb);
+
+  name.oid[name.oid_len - 1] = 4;
+  vb = table_request(MODE_GET, &column, &name);
+  EXPECT_EQ_INT(SNMP_NOSUCHINSTANCE, vb->type);
+  snmp_free_varbind(vb);
+
+  /* GETNEXT walks the column in order, starting before it */
+  oid_t start = {.oid = {1, 3, 6, 1, 4, 1, 99999}, .oid_len = 7};
+  vb = table_request(MODE_GETNEXT, &column, &start);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ_INT(column.oid_len + 1, vb->name_length);
+    EXPECT_EQ_INT(i + 1, vb->name[vb->name_length - 1]);
+    EXPECT_EQ_INT(ASN_GAUGE, vb->type);
+
+    memcpy(name.oid, vb->name, vb->name_length * sizeof(*name.oid));
+    name.oid_len = vb->name_length;
+    snmp_free_varbind(vb);
+    vb = table_request(MODE_GETNEXT, &column, &name);
+  }
+  /* The end of the column is left to the next registration */
+  EXPECT_EQ_INT(ASN_NULL, vb->type);
+  snmp_free_varbind(vb);
+
+  /* The table's index OID */
+  vb = table_request(MODE_GETNEXT, &td.index_oid, &td.index_oid);
+  EXPECT_EQ_INT(ASN_INTEGER, vb->type);
+  EXPECT_EQ_INT(1, *vb->val.integer);
+  snmp_free_varbind(vb);
+
+  /* Cells are only removed along with the values they show */
+  EXPECT_EQ_INT(-ENOENT, snmp_agent_unregister_cell(&column, &td,
+                                                    &index_oids[0],
+                                                    &table_values[1]));
+  CHECK_ZERO(snmp_agent_unregister_cell(&column, &td, &index_oids[0],
+                                        &table_values[0]));
+  vb = table_request(MODE_GETNEXT, &column, &column);
+  EXPECT_EQ_INT(2, vb->name[vb->name_length - 1]);
+  snmp_free_varbind(vb);
+
+  void *cell;
+  void *value;
+  while (c_avl_pick(agent.cells, &cell, &value) == 0)
+    sfree(cell);
+  c_avl_destroy(agent.cells);
+  c_avl_destroy(td.instance_index);
+  c_avl_destroy(td.index_instance);
+  pthread_mutex_destroy(&agent.lock);
+  g_agent = NULL;
+
+  return 0;
+}
+
 int main(void) {
   /* snmp_agent_oid_to_string */
   RUN_TEST(oid_to_string);
@@ -827,5 +954,8 @@ int main(void) {
   /* snmp_agent_build_name */
   RUN_TEST(build_name);
 
+  /* snmp_agent_table_oid_handler */
+  RUN_TEST(table_cells);
+
   END_TEST;
 }
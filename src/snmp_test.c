@@ -0,0 +1,292 @@
+/**
+ * collectd - src/snmp_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "snmp.c" /* sic */
+#include "testing.h"
+
+/* ifInOctets */
+static oid const column_oid[] = {1, 3, 6, 1, 2, 1, 2, 2, 1, 10};
+#define COLUMN_OID_LEN STATIC_ARRAY_SIZE(column_oid)
+
+/* The walk under test talks to this table instead of a real agent: it
+ * answers GETNEXT / GETBULK requests for a single column with "rows" rows,
+ * followed by an OID outside of the column's subtree. */
+static netsnmp_pdu *agent_respond(netsnmp_pdu *req, size_t rows) {
+  netsnmp_pdu *res = snmp_pdu_create(SNMP_MSG_RESPONSE);
+  if (res == NULL)
+    return NULL;
+
+  long repetitions = 1;
+  if (req->command == SNMP_MSG_GETBULK)
+    repetitions = req->max_repetitions;
+
+  netsnmp_variable_list *vb = req->variables;
+  oid name[MAX_OID_LEN];
+  size_t name_len = vb->name_length;
+  memcpy(name, vb->name, sizeof(oid) * name_len);
+
+  for (long r = 0; r < repetitions; r++) {
+    oid next_row = 1;
+    if (name_len > COLUMN_OID_LEN)
+      next_row = name[COLUMN_OID_LEN] + 1;
+
+    memcpy(name, column_oid, sizeof(column_oid));
+    name_len = COLUMN_OID_LEN + 1;
+    if (next_row <= rows) {
+      name[COLUMN_OID_LEN] = next_row;
+    } else {
+      /* ifOutOctets.1, i.e. the next column */
+      name[COLUMN_OID_LEN - 1]++;
+      name[COLUMN_OID_LEN] = 1;
+    }
+
+    long value = 1000 * (long)next_row;
+    snmp_pdu_add_variable(res, name, name_len, ASN_INTEGER, &value,
+                          sizeof(value));
+    if (next_row > rows)
+      break;
+  }
+
+  return res;
+}
+
+static size_t count_cells(csnmp_cell_value_t *cell) {
+  size_t n = 0;
+  for (; cell != NULL; cell = cell->next)
+    n++;
+  return n;
+}
+
+static void setup(host_definition_t *host, data_definition_t *data,
+                  int bulk_size) {
+  static oid_t values;
+
+  memset(host, 0, sizeof(*host));
+  host->name = "test";
+  host->version = 2;
+  host->bulk_size = bulk_size;
+  C_COMPLAIN_INIT(&host->complaint);
+
+  csnmp_oid_init(&values, column_oid, COLUMN_OID_LEN);
+  memset(data, 0, sizeof(*data));
+  data->name = "if_octets";
+  data->type = "MAGIC";
+  data->plugin_name = "snmp";
+  data->is_table = true;
+  data->values = &values;
+  data->values_len = 1;
+  data->scale = 1.0;
+}
+
+/* walks a table with "rows" rows and returns the number of round trips */
+static int walk_table(csnmp_table_walk_t *w, size_t rows) {
+  int round_trips = 0;
+
+  while (1) {
+    netsnmp_pdu *req = NULL;
+    CHECK_ZERO(csnmp_table_walk_request(w, &req));
+    if (req == NULL)
+      break;
+
+    netsnmp_pdu *res = agent_respond(req, rows);
+    CHECK_NOT_NULL(res);
+    snmp_free_pdu(req);
+
+    CHECK_ZERO(csnmp_table_walk_response(w, res));
+    snmp_free_pdu(res);
+
+    round_trips++;
+    OK(round_trips <= (int)rows + 1);
+  }
+
+  return round_trips;
+}
+
+DEF_TEST(table_walk_getnext) {
+  host_definition_t host;
+  data_definition_t data;
+  csnmp_table_walk_t walk;
+
+  setup(&host, &data, /* bulk_size = */ 0);
+  CHECK_ZERO(csnmp_table_walk_init(&walk, &host, &data));
+
+  /* one request per row plus the one leaving the subtree */
+  EXPECT_EQ_INT(6, walk_table(&walk, 5));
+  EXPECT_EQ_INT(5, (int)count_cells(walk.value_cells_head[0]));
+
+  csnmp_table_walk_finish(&walk, /* dispatch = */ false);
+  return 0;
+}
+
+DEF_TEST(table_walk_getbulk) {
+  host_definition_t host;
+  data_definition_t data;
+  csnmp_table_walk_t walk;
+
+  setup(&host, &data, /* bulk_size = */ 4);
+  CHECK_ZERO(csnmp_table_walk_init(&walk, &host, &data));
+
+  /* 10 rows in chunks of four: 4 + 4 + 2 (and the end of the column) */
+  EXPECT_EQ_INT(3, walk_table(&walk, 10));
+  EXPECT_EQ_INT(10, (int)count_cells(walk.value_cells_head[0]));
+
+  csnmp_table_walk_finish(&walk, /* dispatch = */ false);
+  return 0;
+}
+
+DEF_TEST(table_walk_max_repetitions) {
+  host_definition_t host;
+  data_definition_t data;
+  csnmp_table_walk_t walk;
+  netsnmp_pdu *req = NULL;
+
+  /* fewer repetitions than columns must still request one row */
+  setup(&host, &data, /* bulk_size = */ 1);
+  data.type_instance.oid = data.values[0];
+  CHECK_ZERO(csnmp_table_walk_init(&walk, &host, &data));
+
+  CHECK_ZERO(csnmp_table_walk_request(&walk, &req));
+  CHECK_NOT_NULL(req);
+  EXPECT_EQ_INT(SNMP_MSG_GETBULK, req->command);
+  EXPECT_EQ_INT(2, (int)walk.oid_list_todo_num);
+  EXPECT_EQ_INT(1, (int)req->max_repetitions);
+
+  snmp_free_pdu(req);
+  csnmp_table_walk_finish(&walk, /* dispatch = */ false);
+  return 0;
+}
+
+DEF_TEST(table_walk_too_big) {
+  host_definition_t host;
+  data_definition_t data;
+  csnmp_table_walk_t walk;
+
+  setup(&host, &data, /* bulk_size = */ 32);
+  CHECK_ZERO(csnmp_table_walk_init(&walk, &host, &data));
+
+  netsnmp_pdu *res = snmp_pdu_create(SNMP_MSG_RESPONSE);
+  CHECK_NOT_NULL(res);
+  res->errstat = SNMP_ERR_TOOBIG;
+
+  CHECK_ZERO(csnmp_table_walk_response(&walk, res));
+  EXPECT_EQ_INT(16, walk.bulk_size);
+  EXPECT_EQ_PTR(NULL, walk.value_cells_head[0]);
+
+  snmp_free_pdu(res);
+  csnmp_table_walk_finish(&walk, /* dispatch = */ false);
+  return 0;
+}
+
+DEF_TEST(async_jobs_interleave) {
+  host_definition_t hosts[3];
+  data_definition_t data[3];
+  data_definition_t *data_list[3] = {data + 0, data + 1, data + 2};
+  host_definition_t *hosts_list[3] = {hosts + 0, hosts + 1, hosts + 2};
+  int data_list_len[3] = {3, 1, 2};
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(hosts); i++) {
+    setup(hosts + i, data + i, /* bulk_size = */ 0);
+    hosts[i].data_list = data_list;
+    hosts[i].data_list_len = data_list_len[i];
+  }
+
+  csnmp_async_group_t group = {
+      .hosts = hosts_list,
+      .hosts_num = STATIC_ARRAY_SIZE(hosts_list),
+  };
+
+  size_t jobs_num = 0;
+  csnmp_async_job_t *jobs = csnmp_async_jobs_create(&group, &jobs_num);
+  CHECK_NOT_NULL(jobs);
+  EXPECT_EQ_INT(6, (int)jobs_num);
+
+  /* round robin over the hosts, skipping hosts without further data */
+  host_definition_t *want_host[] = {hosts + 0, hosts + 1, hosts + 2,
+                                    hosts + 0, hosts + 2, hosts + 0};
+  data_definition_t *want_data[] = {data + 0, data + 0, data + 0,
+                                    data + 1, data + 1, data + 2};
+  for (size_t i = 0; i < jobs_num; i++) {
+    EXPECT_EQ_PTR(want_host[i], jobs[i].host);
+    EXPECT_EQ_PTR(want_data[i], jobs[i].data);
+    EXPECT_EQ_INT(CSNMP_JOB_PENDING, jobs[i].state);
+  }
+
+  sfree(jobs);
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(hosts); i++)
+    hosts[i].data_list_len = 0;
+  EXPECT_EQ_PTR(NULL, csnmp_async_jobs_create(&group, &jobs_num));
+  EXPECT_EQ_INT(0, (int)jobs_num);
+  return 0;
+}
+
+DEF_TEST(async_jobs_in_flight) {
+  host_definition_t host;
+  data_definition_t data;
+  csnmp_async_job_t jobs[5] = {{0}};
+  size_t next_job = 0;
+
+  /* Without a session, jobs fail when they are started. */
+  setup(&host, &data, /* bulk_size = */ 0);
+  data.is_table = false;
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(jobs); i++) {
+    jobs[i].host = &host;
+    jobs[i].data = &data;
+  }
+
+  async_max_in_flight = 2;
+
+  /* Two jobs are in flight already: nothing is started. */
+  jobs[0].state = CSNMP_JOB_RUNNING;
+  jobs[1].state = CSNMP_JOB_RUNNING;
+  next_job = 2;
+  EXPECT_EQ_INT(2, (int)csnmp_async_jobs_start(jobs, 5, &next_job));
+  EXPECT_EQ_INT(2, (int)next_job);
+  EXPECT_EQ_INT(CSNMP_JOB_PENDING, jobs[2].state);
+
+  /* One finished: the remaining jobs are started, and fail, until the limit
+   * is reached again or no jobs are left. */
+  jobs[0].state = CSNMP_JOB_SUCCESS;
+  EXPECT_EQ_INT(1, (int)csnmp_async_jobs_start(jobs, 5, &next_job));
+  EXPECT_EQ_INT(5, (int)next_job);
+  for (size_t i = 2; i < STATIC_ARRAY_SIZE(jobs); i++)
+    EXPECT_EQ_INT(CSNMP_JOB_FAILURE, jobs[i].state);
+
+  /* The job still running is given up on and its host marked as failed. */
+  EXPECT_EQ_INT(1, (int)csnmp_async_jobs_finish(jobs, 5));
+  EXPECT_EQ_INT(CSNMP_JOB_FAILURE, jobs[1].state);
+  OK(host.async_failed);
+
+  async_max_in_flight = 256;
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(table_walk_getnext);
+  RUN_TEST(table_walk_getbulk);
+  RUN_TEST(table_walk_max_repetitions);
+  RUN_TEST(table_walk_too_big);
+  RUN_TEST(async_jobs_interleave);
+  RUN_TEST(async_jobs_in_flight);
+
+  END_TEST;
+}
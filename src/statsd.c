@@ -27,8 +27,8 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/hashmap/hashmap.h"
 #include "utils/latency/latency.h"
 
 #include <netdb.h>
@@ -56,12 +56,12 @@ struct statsd_metric_s {
   double value;
   derive_t counter;
   latency_counter_t *latency;
-  c_avl_tree_t *set;
+  c_hashmap_t *set;
   unsigned long updates_num;
 };
 typedef struct statsd_metric_s statsd_metric_t;
 
-static c_avl_tree_t *metrics_tree;
+static c_hashmap_t *metrics_tree;
 static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static pthread_t network_thread;
@@ -113,7 +113,7 @@ static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
   key[1] = ':';
   sstrncpy(&key[2], name, sizeof(key) - 2);
 
-  status = c_avl_get(metrics_tree, key, (void *)&metric);
+  status = c_hashmap_get(metrics_tree, key, (void *)&metric);
   if (status == 0)
     return metric;
 
@@ -134,9 +134,9 @@ static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
   metric->latency = NULL;
   metric->set = NULL;
 
-  status = c_avl_insert(metrics_tree, key_copy, metric);
+  status = c_hashmap_insert(metrics_tree, key_copy, metric);
   if (status != 0) {
-    ERROR("statsd plugin: c_avl_insert failed.");
+    ERROR("statsd plugin: c_hashmap_insert failed.");
     sfree(key_copy);
     sfree(metric);
     return NULL;
@@ -199,12 +199,12 @@ static void statsd_metric_free(statsd_metric_t *metric) /* {{{ */
     void *key;
     void *value;
 
-    while (c_avl_pick(metric->set, &key, &value) == 0) {
+    while (c_hashmap_pick(metric->set, &key, &value) == 0) {
       sfree(key);
       assert(value == NULL);
     }
 
-    c_avl_destroy(metric->set);
+    c_hashmap_destroy(metric->set);
     metric->set = NULL;
   }
 
@@ -334,11 +334,11 @@ static int statsd_handle_set(char const *name, /* {{{ */
 
   /* Make sure metric->set exists. */
   if (metric->set == NULL)
-    metric->set = c_avl_create((int (*)(const void *, const void *))strcmp);
+    metric->set = c_hashmap_create_string();
 
   if (metric->set == NULL) {
     pthread_mutex_unlock(&metrics_lock);
-    ERROR("statsd plugin: c_avl_create failed.");
+    ERROR("statsd plugin: c_hashmap_create failed.");
     return -1;
   }
 
@@ -349,10 +349,10 @@ static int statsd_handle_set(char const *name, /* {{{ */
     return -1;
   }
 
-  status = c_avl_insert(metric->set, set_key, /* value = */ NULL);
+  status = c_hashmap_insert(metric->set, set_key, /* value = */ NULL);
   if (status < 0) {
     pthread_mutex_unlock(&metrics_lock);
-    ERROR("statsd plugin: c_avl_insert (\"%s\") failed with status %i.",
+    ERROR("statsd plugin: c_hashmap_insert (\"%s\") failed with status %i.",
           set_key, status);
     sfree(set_key);
     return -1;
@@ -660,7 +660,7 @@ static int statsd_init(void) /* {{{ */
 {
   pthread_mutex_lock(&metrics_lock);
   if (metrics_tree == NULL)
-    metrics_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+    metrics_tree = c_hashmap_create_string();
 
   if (!network_thread_running) {
     int status;
@@ -693,7 +693,7 @@ static int statsd_metric_clear_set_unsafe(statsd_metric_t *metric) /* {{{ */
   if (metric->set == NULL)
     return 0;
 
-  while (c_avl_pick(metric->set, &key, &value) == 0) {
+  while (c_hashmap_pick(metric->set, &key, &value) == 0) {
     sfree(key);
     sfree(value);
   }
@@ -789,7 +789,7 @@ static int statsd_metric_submit_unsafe(char const *name,
     if (metric->set == NULL)
       vl.values[0].gauge = 0.0;
     else
-      vl.values[0].gauge = (gauge_t)c_avl_size(metric->set);
+      vl.values[0].gauge = (gauge_t)c_hashmap_size(metric->set);
   } else { /* STATSD_COUNTER */
     gauge_t delta = nearbyint(metric->value);
 
@@ -819,7 +819,7 @@ static int statsd_metric_submit_unsafe(char const *name,
 
 static int statsd_read(void) /* {{{ */
 {
-  c_avl_iterator_t *iter;
+  c_hashmap_iterator_t *iter;
   char *name;
   statsd_metric_t *metric;
 
@@ -833,8 +833,8 @@ static int statsd_read(void) /* {{{ */
     return 0;
   }
 
-  iter = c_avl_get_iterator(metrics_tree);
-  while (c_avl_iterator_next(iter, (void *)&name, (void *)&metric) == 0) {
+  iter = c_hashmap_get_iterator(metrics_tree);
+  while (c_hashmap_iterator_next(iter, (void *)&name, (void *)&metric) == 0) {
     if ((metric->updates_num == 0) &&
         ((conf_delete_counters && (metric->type == STATSD_COUNTER)) ||
          (conf_delete_timers && (metric->type == STATSD_TIMER)) ||
@@ -854,15 +854,15 @@ static int statsd_read(void) /* {{{ */
     if (metric->type == STATSD_SET)
       statsd_metric_clear_set_unsafe(metric);
   }
-  c_avl_iterator_destroy(iter);
+  c_hashmap_iterator_destroy(iter);
 
   for (size_t i = 0; i < to_be_deleted_num; i++) {
     int status;
 
-    status = c_avl_remove(metrics_tree, to_be_deleted[i], (void *)&name,
-                          (void *)&metric);
+    status = c_hashmap_remove(metrics_tree, to_be_deleted[i], (void *)&name,
+                              (void *)&metric);
     if (status != 0) {
-      ERROR("stats plugin: c_avl_remove (\"%s\") failed with status %i.",
+      ERROR("stats plugin: c_hashmap_remove (\"%s\") failed with status %i.",
             to_be_deleted[i], status);
       continue;
     }
@@ -892,11 +892,11 @@ static int statsd_shutdown(void) /* {{{ */
 
   pthread_mutex_lock(&metrics_lock);
 
-  while (c_avl_pick(metrics_tree, &key, &value) == 0) {
+  while (c_hashmap_pick(metrics_tree, &key, &value) == 0) {
     sfree(key);
     statsd_metric_free(value);
   }
-  c_avl_destroy(metrics_tree);
+  c_hashmap_destroy(metrics_tree);
   metrics_tree = NULL;
 
   sfree(conf_node);
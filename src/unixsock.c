@@ -30,6 +30,7 @@
 #include "utils/common/common.h"
 
 #include "utils/cmds/flush.h"
+#include "utils/cmds/getstats.h"
 #include "utils/cmds/getthreshold.h"
 #include "utils/cmds/getval.h"
 #include "utils/cmds/listval.h"
@@ -245,6 +246,8 @@ static void *us_handle_client(void *arg) {
       cmd_handle_getval(fhout, buffer);
     } else if (strcasecmp(fields[0], "getthreshold") == 0) {
       handle_getthreshold(fhout, buffer);
+    } else if (strcasecmp(fields[0], "getstats") == 0) {
+      handle_getstats(fhout, buffer);
     } else if (strcasecmp(fields[0], "putval") == 0) {
       cmd_handle_putval(fhout, buffer);
     } else if (strcasecmp(fields[0], "listval") == 0) {
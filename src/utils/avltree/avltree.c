@@ -641,6 +641,27 @@ int c_avl_iterator_prev(c_avl_iterator_t *iter, void **key, void **value) {
 
 void c_avl_iterator_destroy(c_avl_iterator_t *iter) { free(iter); }
 
+int c_avl_iterator_seek(c_avl_iterator_t *iter, const void *key) {
+  if ((iter == NULL) || (key == NULL))
+    return -1;
+
+  /* Find the largest node less than `key'. If there is none, NULL resets the
+   * iterator to the smallest node, which is the one we're looking for. */
+  c_avl_node_t *prev = NULL;
+  c_avl_node_t *n = iter->tree->root;
+  while (n != NULL) {
+    if (iter->tree->compare(n->key, key) < 0) {
+      prev = n;
+      n = n->right;
+    } else {
+      n = n->left;
+    }
+  }
+
+  iter->node = prev;
+  return 0;
+} /* int c_avl_iterator_seek */
+
 int c_avl_size(c_avl_tree_t *t) {
   if (t == NULL)
     return 0;
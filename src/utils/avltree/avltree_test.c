@@ -133,6 +133,38 @@ DEF_TEST(success) {
     EXPECT_EQ_INT(i, STATIC_ARRAY_SIZE(cases));
   }
 
+  /* seek */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    c_avl_iterator_t *iter = c_avl_get_iterator(t);
+    char *key;
+    char *value;
+
+    /* An exact match is returned first, ... */
+    CHECK_ZERO(c_avl_iterator_seek(iter, sorted_cases[i].key));
+    CHECK_ZERO(c_avl_iterator_next(iter, (void **)&key, (void **)&value));
+    EXPECT_EQ_STR(sorted_cases[i].key, key);
+
+    /* ... otherwise the next larger key. */
+    char prefix[5];
+    snprintf(prefix, sizeof(prefix), "%s", sorted_cases[i].key);
+    CHECK_ZERO(c_avl_iterator_seek(iter, prefix));
+    CHECK_ZERO(c_avl_iterator_next(iter, (void **)&key, (void **)&value));
+    EXPECT_EQ_STR(sorted_cases[i].key, key);
+
+    c_avl_iterator_destroy(iter);
+  }
+
+  /* seek past the last key */
+  {
+    c_avl_iterator_t *iter = c_avl_get_iterator(t);
+    char *key;
+    char *value;
+    CHECK_ZERO(c_avl_iterator_seek(iter, "zzz"));
+    EXPECT_EQ_INT(-1,
+                  c_avl_iterator_next(iter, (void **)&key, (void **)&value));
+    c_avl_iterator_destroy(iter);
+  }
+
   /* remove half */
   for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases) / 2; i++) {
     char *key = NULL;
@@ -0,0 +1,586 @@
+/**
+ * collectd - src/utils/btree/btree.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/btree/btree.h"
+
+/* Every node but the root has between BTREE_MIN_KEYS and BTREE_MAX_KEYS keys.
+ * Keys are stored only once, in inner nodes as well as in leaves. */
+#define BTREE_DEGREE 8
+#define BTREE_MAX_KEYS (2 * BTREE_DEGREE - 1)
+#define BTREE_MIN_KEYS (BTREE_DEGREE - 1)
+/* With at least BTREE_DEGREE children per inner node, this is plenty for
+ * INT_MAX elements. */
+#define BTREE_MAX_DEPTH 16
+
+#define MOVE(dst, src, num) memmove((dst), (src), (num) * sizeof(*(dst)))
+
+/*
+ * private data types
+ */
+typedef struct c_btree_node_s c_btree_node_t;
+struct c_btree_node_s {
+  int num;
+  bool leaf;
+  void *keys[BTREE_MAX_KEYS];
+  void *values[BTREE_MAX_KEYS];
+  /* Only allocated for inner nodes. */
+  c_btree_node_t *children[];
+};
+
+struct c_btree_s {
+  c_btree_node_t *root;
+  int (*compare)(const void *, const void *);
+  int size;
+};
+
+/* The path from the root to the iterator's element. "index" is the index of
+ * the key in the last node and the index of the child on the path in all
+ * other nodes. */
+typedef struct {
+  c_btree_node_t *node;
+  int index;
+} c_btree_pos_t;
+
+struct c_btree_iterator_s {
+  c_btree_t *tree;
+  c_btree_pos_t path[BTREE_MAX_DEPTH];
+  int depth; /* zero if positioned before the first / after the last key */
+};
+
+enum { REMOVE_KEY, REMOVE_MIN, REMOVE_MAX };
+
+/*
+ * private functions
+ */
+static c_btree_node_t *node_create(bool leaf) {
+  size_t size = sizeof(c_btree_node_t);
+  if (!leaf)
+    size += (BTREE_MAX_KEYS + 1) * sizeof(c_btree_node_t *);
+
+  c_btree_node_t *n = calloc(1, size);
+  if (n == NULL)
+    return NULL;
+
+  n->leaf = leaf;
+  return n;
+} /* c_btree_node_t *node_create */
+
+static void node_free(c_btree_node_t *n) {
+  if (n == NULL)
+    return;
+
+  if (!n->leaf)
+    for (int i = 0; i <= n->num; i++)
+      node_free(n->children[i]);
+  free(n);
+} /* void node_free */
+
+/* Returns the index of the first key which is greater than or equal to `key'
+ * and sets `found' if it is equal. */
+static int node_find(c_btree_t const *t, c_btree_node_t const *n,
+                     const void *key, bool *found) {
+  int lo = 0;
+  int hi = n->num;
+
+  *found = false;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    int cmp = t->compare(n->keys[mid], key);
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else if (cmp > 0) {
+      hi = mid;
+    } else {
+      *found = true;
+      return mid;
+    }
+  }
+
+  return lo;
+} /* int node_find */
+
+/* Splits the full child `i' of `x' in two, moving its median key up into
+ * `x'. */
+static int split_child(c_btree_node_t *x, int i) {
+  c_btree_node_t *y = x->children[i];
+  c_btree_node_t *z = node_create(y->leaf);
+  if (z == NULL)
+    return -1;
+
+  z->num = BTREE_MIN_KEYS;
+  MOVE(z->keys, y->keys + BTREE_DEGREE, BTREE_MIN_KEYS);
+  MOVE(z->values, y->values + BTREE_DEGREE, BTREE_MIN_KEYS);
+  if (!y->leaf)
+    MOVE(z->children, y->children + BTREE_DEGREE, BTREE_DEGREE);
+  y->num = BTREE_MIN_KEYS;
+
+  MOVE(x->children + i + 2, x->children + i + 1, x->num - i);
+  x->children[i + 1] = z;
+  MOVE(x->keys + i + 1, x->keys + i, x->num - i);
+  MOVE(x->values + i + 1, x->values + i, x->num - i);
+  x->keys[i] = y->keys[BTREE_MIN_KEYS];
+  x->values[i] = y->values[BTREE_MIN_KEYS];
+  x->num++;
+
+  return 0;
+} /* int split_child */
+
+/* Moves the last key of child `i - 1' through the parent into child `i'. */
+static void rotate_right(c_btree_node_t *x, int i) {
+  c_btree_node_t *c = x->children[i];
+  c_btree_node_t *left = x->children[i - 1];
+
+  MOVE(c->keys + 1, c->keys, c->num);
+  MOVE(c->values + 1, c->values, c->num);
+  c->keys[0] = x->keys[i - 1];
+  c->values[0] = x->values[i - 1];
+  if (!c->leaf) {
+    MOVE(c->children + 1, c->children, c->num + 1);
+    c->children[0] = left->children[left->num];
+  }
+  c->num++;
+
+  x->keys[i - 1] = left->keys[left->num - 1];
+  x->values[i - 1] = left->values[left->num - 1];
+  left->num--;
+} /* void rotate_right */
+
+/* Moves the first key of child `i + 1' through the parent into child `i'. */
+static void rotate_left(c_btree_node_t *x, int i) {
+  c_btree_node_t *c = x->children[i];
+  c_btree_node_t *right = x->children[i + 1];
+
+  c->keys[c->num] = x->keys[i];
+  c->values[c->num] = x->values[i];
+  if (!c->leaf)
+    c->children[c->num + 1] = right->children[0];
+  c->num++;
+
+  x->keys[i] = right->keys[0];
+  x->values[i] = right->values[0];
+  MOVE(right->keys, right->keys + 1, right->num - 1);
+  MOVE(right->values, right->values + 1, right->num - 1);
+  if (!right->leaf)
+    MOVE(right->children, right->children + 1, right->num);
+  right->num--;
+} /* void rotate_left */
+
+/* Merges key `i' and child `i + 1' into child `i'. */
+static void merge_children(c_btree_node_t *x, int i) {
+  c_btree_node_t *c = x->children[i];
+  c_btree_node_t *right = x->children[i + 1];
+
+  c->keys[c->num] = x->keys[i];
+  c->values[c->num] = x->values[i];
+  MOVE(c->keys + c->num + 1, right->keys, right->num);
+  MOVE(c->values + c->num + 1, right->values, right->num);
+  if (!c->leaf)
+    MOVE(c->children + c->num + 1, right->children, right->num + 1);
+  c->num += right->num + 1;
+
+  MOVE(x->keys + i, x->keys + i + 1, x->num - i - 1);
+  MOVE(x->values + i, x->values + i + 1, x->num - i - 1);
+  MOVE(x->children + i + 1, x->children + i + 2, x->num - i - 1);
+  x->num--;
+
+  free(right);
+} /* void merge_children */
+
+/* Makes sure that child `i' has more than the minimum number of keys, so that
+ * a key can be removed from it. Returns the index of the child to descend
+ * into, which changes if the child is merged with its left sibling. */
+static int fill_child(c_btree_node_t *x, int i) {
+  if (x->children[i]->num > BTREE_MIN_KEYS)
+    return i;
+
+  if ((i > 0) && (x->children[i - 1]->num > BTREE_MIN_KEYS)) {
+    rotate_right(x, i);
+    return i;
+  }
+  if ((i < x->num) && (x->children[i + 1]->num > BTREE_MIN_KEYS)) {
+    rotate_left(x, i);
+    return i;
+  }
+
+  if (i < x->num) {
+    merge_children(x, i);
+    return i;
+  }
+  merge_children(x, i - 1);
+  return i - 1;
+} /* int fill_child */
+
+/* Removes `key' or, depending on `which', the smallest or largest key from the
+ * subtree `n'. Unless `n' is the root, it has more than the minimum number of
+ * keys. */
+static int subtree_remove(c_btree_t *t, c_btree_node_t *n, const void *key,
+                          int which, void **rkey, void **rvalue) {
+  while (42) {
+    bool found = false;
+    int i;
+
+    if (which == REMOVE_KEY) {
+      i = node_find(t, n, key, &found);
+    } else if (which == REMOVE_MIN) {
+      i = 0;
+      found = n->leaf;
+    } else {
+      i = n->leaf ? n->num - 1 : n->num;
+      found = n->leaf;
+    }
+
+    if (n->leaf) {
+      if (!found)
+        return -1;
+
+      *rkey = n->keys[i];
+      *rvalue = n->values[i];
+      MOVE(n->keys + i, n->keys + i + 1, n->num - i - 1);
+      MOVE(n->values + i, n->values + i + 1, n->num - i - 1);
+      n->num--;
+      return 0;
+    }
+
+    if (!found) {
+      i = fill_child(n, i);
+      n = n->children[i];
+      continue;
+    }
+
+    /* Replace the key with its predecessor or successor, if that can be
+     * removed from the child right away. Otherwise, merge both children and
+     * remove the key from the result. */
+    *rkey = n->keys[i];
+    *rvalue = n->values[i];
+    if (n->children[i]->num > BTREE_MIN_KEYS)
+      return subtree_remove(t, n->children[i], NULL, REMOVE_MAX, n->keys + i,
+                            n->values + i);
+    if (n->children[i + 1]->num > BTREE_MIN_KEYS)
+      return subtree_remove(t, n->children[i + 1], NULL, REMOVE_MIN,
+                            n->keys + i, n->values + i);
+
+    merge_children(n, i);
+    n = n->children[i];
+  }
+
+  return -1;
+} /* int subtree_remove */
+
+static int tree_remove(c_btree_t *t, const void *key, int which, void **rkey,
+                       void **rvalue) {
+  if ((t->root == NULL) || (t->size == 0))
+    return -1;
+
+  int status = subtree_remove(t, t->root, key, which, rkey, rvalue);
+
+  /* Merging the root's only two children leaves it empty. */
+  c_btree_node_t *r = t->root;
+  if ((r->num == 0) && !r->leaf) {
+    t->root = r->children[0];
+    free(r);
+  }
+
+  if (status == 0)
+    t->size--;
+  return status;
+} /* int tree_remove */
+
+/* Appends the path from `n' to the smallest or largest key in its subtree. */
+static void iter_descend(c_btree_iterator_t *iter, c_btree_node_t *n,
+                         bool smallest) {
+  while (42) {
+    c_btree_pos_t *pos = iter->path + iter->depth;
+    iter->depth++;
+
+    pos->node = n;
+    if (n->leaf) {
+      pos->index = smallest ? 0 : n->num - 1;
+      return;
+    }
+
+    pos->index = smallest ? 0 : n->num;
+    n = n->children[pos->index];
+  }
+} /* void iter_descend */
+
+/* Removes the last node from the path and moves on to the closest ancestor
+ * with a key in the direction of travel. The ancestors' child indexes equal
+ * the index of the next key, or the previous key plus one. */
+static int iter_ascend(c_btree_iterator_t *iter, bool forward) {
+  int depth = iter->depth - 1;
+
+  while (depth > 0) {
+    c_btree_pos_t *pos = iter->path + depth - 1;
+    if (forward ? (pos->index < pos->node->num) : (pos->index > 0)) {
+      if (!forward)
+        pos->index--;
+      iter->depth = depth;
+      return 0;
+    }
+    depth--;
+  }
+
+  return -1;
+} /* int iter_ascend */
+
+static int iter_step(c_btree_iterator_t *iter, bool forward) {
+  if (iter->depth == 0) {
+    c_btree_node_t *r = iter->tree->root;
+    if ((r == NULL) || (r->num == 0))
+      return -1;
+
+    iter_descend(iter, r, forward);
+    return 0;
+  }
+
+  c_btree_pos_t *pos = iter->path + iter->depth - 1;
+  if (!pos->node->leaf) {
+    /* The neighbor is the smallest key of the right subtree or the largest key
+     * of the left subtree. */
+    if (forward)
+      pos->index++;
+    iter_descend(iter, pos->node->children[pos->index], forward);
+    return 0;
+  }
+
+  if (forward ? (pos->index + 1 < pos->node->num) : (pos->index > 0)) {
+    pos->index += forward ? 1 : -1;
+    return 0;
+  }
+
+  /* Like c_avl_iterator_t, stay on the last element at the end. */
+  return iter_ascend(iter, forward);
+} /* int iter_step */
+
+/*
+ * public functions
+ */
+c_btree_t *c_btree_create(int (*compare)(const void *, const void *)) {
+  c_btree_t *t;
+
+  if (compare == NULL)
+    return NULL;
+
+  t = calloc(1, sizeof(*t));
+  if (t == NULL)
+    return NULL;
+
+  t->compare = compare;
+  return t;
+} /* c_btree_t *c_btree_create */
+
+void c_btree_destroy(c_btree_t *t) {
+  if (t == NULL)
+    return;
+
+  node_free(t->root);
+  free(t);
+} /* void c_btree_destroy */
+
+int c_btree_insert(c_btree_t *t, void *key, void *value) {
+  if (t == NULL)
+    return -1;
+
+  if (t->root == NULL) {
+    t->root = node_create(/* leaf = */ true);
+    if (t->root == NULL)
+      return -1;
+  }
+
+  /* Full nodes are split on the way down, so that there is always room for
+   * the median key of a split child. */
+  if (t->root->num == BTREE_MAX_KEYS) {
+    c_btree_node_t *r = node_create(/* leaf = */ false);
+    if (r == NULL)
+      return -1;
+
+    r->children[0] = t->root;
+    if (split_child(r, 0) != 0) {
+      free(r);
+      return -1;
+    }
+    t->root = r;
+  }
+
+  c_btree_node_t *n = t->root;
+  while (42) {
+    bool found;
+    int i = node_find(t, n, key, &found);
+    if (found)
+      return 1;
+
+    if (n->leaf) {
+      MOVE(n->keys + i + 1, n->keys + i, n->num - i);
+      MOVE(n->values + i + 1, n->values + i, n->num - i);
+      n->keys[i] = key;
+      n->values[i] = value;
+      n->num++;
+      t->size++;
+      return 0;
+    }
+
+    if (n->children[i]->num == BTREE_MAX_KEYS) {
+      if (split_child(n, i) != 0)
+        return -1;
+
+      int cmp = t->compare(n->keys[i], key);
+      if (cmp == 0)
+        return 1;
+      else if (cmp < 0)
+        i++;
+    }
+
+    n = n->children[i];
+  }
+
+  return -1;
+} /* int c_btree_insert */
+
+int c_btree_remove(c_btree_t *t, const void *key, void **rkey, void **rvalue) {
+  void *k;
+  void *v;
+
+  if ((t == NULL) || (key == NULL))
+    return -1;
+
+  int status = tree_remove(t, key, REMOVE_KEY, &k, &v);
+  if (status != 0)
+    return status;
+
+  if (rkey != NULL)
+    *rkey = k;
+  if (rvalue != NULL)
+    *rvalue = v;
+  return 0;
+} /* int c_btree_remove */
+
+int c_btree_get(c_btree_t *t, const void *key, void **value) {
+  if (t == NULL)
+    return -1;
+
+  c_btree_node_t *n = t->root;
+  while (n != NULL) {
+    bool found;
+    int i = node_find(t, n, key, &found);
+    if (found) {
+      if (value != NULL)
+        *value = n->values[i];
+      return 0;
+    }
+
+    n = n->leaf ? NULL : n->children[i];
+  }
+
+  return -1;
+} /* int c_btree_get */
+
+int c_btree_pick(c_btree_t *t, void **key, void **value) {
+  if ((t == NULL) || (key == NULL) || (value == NULL))
+    return -1;
+
+  /* The largest key is always in a leaf, so this rarely rebalances. */
+  return tree_remove(t, NULL, REMOVE_MAX, key, value);
+} /* int c_btree_pick */
+
+c_btree_iterator_t *c_btree_get_iterator(c_btree_t *t) {
+  c_btree_iterator_t *iter;
+
+  if (t == NULL)
+    return NULL;
+
+  iter = calloc(1, sizeof(*iter));
+  if (iter == NULL)
+    return NULL;
+  iter->tree = t;
+
+  return iter;
+} /* c_btree_iterator_t *c_btree_get_iterator */
+
+int c_btree_iterator_next(c_btree_iterator_t *iter, void **key, void **value) {
+  if ((iter == NULL) || (key == NULL) || (value == NULL))
+    return -1;
+
+  if (iter_step(iter, /* forward = */ true) != 0)
+    return -1;
+
+  c_btree_pos_t *pos = iter->path + iter->depth - 1;
+  *key = pos->node->keys[pos->index];
+  *value = pos->node->values[pos->index];
+  return 0;
+} /* int c_btree_iterator_next */
+
+int c_btree_iterator_prev(c_btree_iterator_t *iter, void **key, void **value) {
+  if ((iter == NULL) || (key == NULL) || (value == NULL))
+    return -1;
+
+  if (iter_step(iter, /* forward = */ false) != 0)
+    return -1;
+
+  c_btree_pos_t *pos = iter->path + iter->depth - 1;
+  *key = pos->node->keys[pos->index];
+  *value = pos->node->values[pos->index];
+  return 0;
+} /* int c_btree_iterator_prev */
+
+void c_btree_iterator_destroy(c_btree_iterator_t *iter) { free(iter); }
+
+int c_btree_iterator_seek(c_btree_iterator_t *iter, const void *key) {
+  if ((iter == NULL) || (key == NULL))
+    return -1;
+
+  /* Record the path to where `key' is or would be inserted ... */
+  iter->depth = 0;
+  c_btree_node_t *n = iter->tree->root;
+  while ((n != NULL) && (n->num > 0)) {
+    bool found;
+    c_btree_pos_t *pos = iter->path + iter->depth;
+    iter->depth++;
+
+    pos->node = n;
+    pos->index = node_find(iter->tree, n, key, &found);
+    n = n->leaf ? NULL : n->children[pos->index];
+  }
+
+  /* ... and move to the largest key less than `key'. If there is none, the
+   * iterator is reset, so that the next call to c_btree_iterator_next()
+   * returns the smallest key. */
+  while (iter->depth > 0) {
+    c_btree_pos_t *pos = iter->path + iter->depth - 1;
+    if (pos->index > 0) {
+      pos->index--;
+      return 0;
+    }
+    iter->depth--;
+  }
+
+  return 0;
+} /* int c_btree_iterator_seek */
+
+int c_btree_size(c_btree_t *t) {
+  if (t == NULL)
+    return 0;
+  return t->size;
+} /* int c_btree_size */
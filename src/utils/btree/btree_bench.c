@@ -0,0 +1,192 @@
+/**
+ * collectd - src/utils/btree/btree_bench.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Compares the AVL tree, the B-tree and the hash map on identifiers shaped
+ * like the keys of the value cache. This is not part of "make check", because
+ * timings depend on the machine; run "./bench_containers" by hand. */
+
+#include "collectd.h"
+#include "utils/common/common.h" /* STATIC_ARRAY_SIZE */
+
+#include "utils/avltree/avltree.h"
+#include "utils/btree/btree.h"
+#include "utils/hashmap/hashmap.h"
+
+/* host/plugin-plugin_instance/type-type_instance, like the cache keys. */
+#define BENCHMARK_HOSTS 200
+#define BENCHMARK_PLUGINS 10
+#define BENCHMARK_INSTANCES 50
+#define BENCHMARK_KEYS                                                         \
+  (BENCHMARK_HOSTS * BENCHMARK_PLUGINS * BENCHMARK_INSTANCES)
+#define BENCHMARK_LOOKUPS 1000000
+
+typedef struct {
+  char const *name;
+  void *(*create)(void);
+  int (*insert)(void *, void *, void *);
+  int (*get)(void *, const void *, void **);
+  int (*remove)(void *, const void *, void **, void **);
+  void (*destroy)(void *);
+} container_t;
+
+static void *avl_create(void) {
+  return c_avl_create((int (*)(const void *, const void *))strcmp);
+}
+static int avl_insert(void *t, void *k, void *v) {
+  return c_avl_insert(t, k, v);
+}
+static int avl_get(void *t, const void *k, void **v) {
+  return c_avl_get(t, k, v);
+}
+static int avl_remove(void *t, const void *k, void **rk, void **rv) {
+  return c_avl_remove(t, k, rk, rv);
+}
+static void avl_destroy(void *t) { c_avl_destroy(t); }
+
+static void *btree_create(void) {
+  return c_btree_create((int (*)(const void *, const void *))strcmp);
+}
+static int btree_insert(void *t, void *k, void *v) {
+  return c_btree_insert(t, k, v);
+}
+static int btree_get(void *t, const void *k, void **v) {
+  return c_btree_get(t, k, v);
+}
+static int btree_remove(void *t, const void *k, void **rk, void **rv) {
+  return c_btree_remove(t, k, rk, rv);
+}
+static void btree_destroy(void *t) { c_btree_destroy(t); }
+
+static void *hashmap_create(void) { return c_hashmap_create_string(); }
+static int hashmap_insert(void *t, void *k, void *v) {
+  return c_hashmap_insert(t, k, v);
+}
+static int hashmap_get(void *t, const void *k, void **v) {
+  return c_hashmap_get(t, k, v);
+}
+static int hashmap_remove(void *t, const void *k, void **rk, void **rv) {
+  return c_hashmap_remove(t, k, rk, rv);
+}
+static void hashmap_destroy(void *t) { c_hashmap_destroy(t); }
+
+static container_t containers[] = {
+    {"avl tree", avl_create, avl_insert, avl_get, avl_remove, avl_destroy},
+    {"b-tree", btree_create, btree_insert, btree_get, btree_remove,
+     btree_destroy},
+    {"hash map", hashmap_create, hashmap_insert, hashmap_get, hashmap_remove,
+     hashmap_destroy},
+};
+
+static char *keys[BENCHMARK_KEYS];
+static int order[BENCHMARK_KEYS]; /* random permutation */
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void shuffle(int *a, int num) {
+  for (int i = 0; i < num; i++)
+    a[i] = i;
+  for (int i = num - 1; i > 0; i--) {
+    int j = rand() % (i + 1);
+    int tmp = a[i];
+    a[i] = a[j];
+    a[j] = tmp;
+  }
+}
+
+static int run(container_t *ct) {
+  void *t = ct->create();
+  if (t == NULL) {
+    fprintf(stderr, "%s: create failed\n", ct->name);
+    return -1;
+  }
+
+  double t0 = now();
+  for (int i = 0; i < BENCHMARK_KEYS; i++) {
+    char *k = keys[order[i]];
+    if (ct->insert(t, k, k) != 0) {
+      fprintf(stderr, "%s: inserting \"%s\" failed\n", ct->name, k);
+      ct->destroy(t);
+      return -1;
+    }
+  }
+  double insert_time = now() - t0;
+
+  int found = 0;
+  t0 = now();
+  for (int i = 0; i < BENCHMARK_LOOKUPS; i++) {
+    char *v = NULL;
+    char *k = keys[order[i % BENCHMARK_KEYS]];
+    if ((ct->get(t, k, (void *)&v) == 0) && (v == k))
+      found++;
+  }
+  double get_time = now() - t0;
+
+  t0 = now();
+  for (int i = 0; i < BENCHMARK_KEYS; i++)
+    ct->remove(t, keys[i], NULL, NULL);
+  double remove_time = now() - t0;
+
+  ct->destroy(t);
+
+  if (found != BENCHMARK_LOOKUPS) {
+    fprintf(stderr, "%s: found %d of %d keys\n", ct->name, found,
+            BENCHMARK_LOOKUPS);
+    return -1;
+  }
+  printf("  %-8s insert %6.1f ns, get %6.1f ns, remove %6.1f ns\n", ct->name,
+         1e9 * insert_time / BENCHMARK_KEYS, 1e9 * get_time / BENCHMARK_LOOKUPS,
+         1e9 * remove_time / BENCHMARK_KEYS);
+  return 0;
+}
+
+int main(void) {
+  int status = 0;
+  int n = 0;
+
+  for (int h = 0; h < BENCHMARK_HOSTS; h++)
+    for (int p = 0; p < BENCHMARK_PLUGINS; p++)
+      for (int i = 0; i < BENCHMARK_INSTANCES; i++) {
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer),
+                 "host%03d.example.com/plugin%d-%d/derive-instance%d", h, p,
+                 p, i);
+        if ((keys[n++] = strdup(buffer)) == NULL) {
+          fprintf(stderr, "strdup failed\n");
+          return 1;
+        }
+      }
+  srand(1);
+  shuffle(order, BENCHMARK_KEYS);
+
+  printf("%d keys, %d lookups:\n", BENCHMARK_KEYS, BENCHMARK_LOOKUPS);
+  for (size_t c = 0; c < STATIC_ARRAY_SIZE(containers); c++)
+    if (run(containers + c) != 0)
+      status = 1;
+
+  for (int i = 0; i < BENCHMARK_KEYS; i++)
+    free(keys[i]);
+  return status;
+}
@@ -0,0 +1,177 @@
+/**
+ * collectd - src/utils/btree/btree_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/btree/btree.h"
+
+#define KEYS_NUM 5000
+
+static char keys_buffer[KEYS_NUM][16];
+static char *keys[KEYS_NUM]; /* sorted */
+static int order[KEYS_NUM];  /* random permutation */
+static bool present[KEYS_NUM];
+
+static void shuffle(int *a, int num) {
+  for (int i = 0; i < num; i++)
+    a[i] = i;
+  for (int i = num - 1; i > 0; i--) {
+    int j = rand() % (i + 1);
+    int tmp = a[i];
+    a[i] = a[j];
+    a[j] = tmp;
+  }
+}
+
+/* Iterates over the whole tree in both directions and compares the result to
+ * the "present" array. Returns the number of mismatches. */
+static int check_iteration(c_btree_t *t) {
+  c_btree_iterator_t *iter = c_btree_get_iterator(t);
+  int errors = 0;
+  int i = 0;
+  char *key;
+  char *value;
+
+  while (c_btree_iterator_next(iter, (void *)&key, (void *)&value) == 0) {
+    while ((i < KEYS_NUM) && !present[i])
+      i++;
+    if ((i == KEYS_NUM) || (key != keys[i]) || (value != keys[i]))
+      errors++;
+    i++;
+  }
+  c_btree_iterator_destroy(iter);
+
+  iter = c_btree_get_iterator(t);
+  i = KEYS_NUM - 1;
+  while (c_btree_iterator_prev(iter, (void *)&key, (void *)&value) == 0) {
+    while ((i >= 0) && !present[i])
+      i--;
+    if ((i < 0) || (key != keys[i]))
+      errors++;
+    i--;
+  }
+  c_btree_iterator_destroy(iter);
+
+  return errors;
+}
+
+DEF_TEST(btree) {
+  c_btree_t *t;
+  CHECK_NOT_NULL(
+      t = c_btree_create((int (*)(const void *, const void *))strcmp));
+
+  char *key = NULL;
+  char *value = NULL;
+  OK(c_btree_get(t, keys[0], NULL) != 0);
+  OK(c_btree_remove(t, keys[0], NULL, NULL) != 0);
+  OK(c_btree_pick(t, (void *)&key, (void *)&value) != 0);
+  EXPECT_EQ_INT(0, check_iteration(t));
+
+  int failed = 0;
+  for (int i = 0; i < KEYS_NUM; i++) {
+    if (c_btree_insert(t, keys[order[i]], keys[order[i]]) != 0)
+      failed++;
+    present[order[i]] = true;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(KEYS_NUM, c_btree_size(t));
+  EXPECT_EQ_INT(1, c_btree_insert(t, keys[42], NULL));
+  EXPECT_EQ_INT(0, check_iteration(t));
+
+  failed = 0;
+  for (int i = 0; i < KEYS_NUM; i++)
+    if ((c_btree_get(t, keys[i], (void *)&value) != 0) || (value != keys[i]))
+      failed++;
+  EXPECT_EQ_INT(0, failed);
+  OK(c_btree_get(t, "key", NULL) != 0);
+
+  /* Remove half of the keys in random order. */
+  shuffle(order, KEYS_NUM);
+  failed = 0;
+  for (int i = 0; i < KEYS_NUM / 2; i++) {
+    char *k = keys[order[i]];
+    if ((c_btree_remove(t, k, (void *)&key, (void *)&value) != 0) ||
+        (key != k) || (value != k))
+      failed++;
+    present[order[i]] = false;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(KEYS_NUM - KEYS_NUM / 2, c_btree_size(t));
+  OK(c_btree_remove(t, keys[order[0]], NULL, NULL) != 0);
+  EXPECT_EQ_INT(0, check_iteration(t));
+
+  /* Seeking to a key returns the key itself or the next larger one. */
+  c_btree_iterator_t *iter;
+  CHECK_NOT_NULL(iter = c_btree_get_iterator(t));
+  failed = 0;
+  for (int i = 0; i < KEYS_NUM; i++) {
+    int want = i;
+    while ((want < KEYS_NUM) && !present[want])
+      want++;
+
+    c_btree_iterator_seek(iter, keys[i]);
+    int status = c_btree_iterator_next(iter, (void *)&key, (void *)&value);
+    if (want == KEYS_NUM)
+      failed += (status == 0);
+    else
+      failed += (status != 0) || (key != keys[want]);
+  }
+  EXPECT_EQ_INT(0, failed);
+
+  /* At the end, the iterator stays on the last element. */
+  CHECK_ZERO(c_btree_iterator_seek(iter, "zzz"));
+  OK(c_btree_iterator_next(iter, (void *)&key, (void *)&value) != 0);
+  OK(c_btree_iterator_next(iter, (void *)&key, (void *)&value) != 0);
+  c_btree_iterator_destroy(iter);
+
+  int size = c_btree_size(t);
+  failed = 0;
+  while (c_btree_pick(t, (void *)&key, (void *)&value) == 0) {
+    if (key != value)
+      failed++;
+    size--;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(0, size);
+  EXPECT_EQ_INT(0, c_btree_size(t));
+
+  /* The tree is usable after it has been emptied. */
+  CHECK_ZERO(c_btree_insert(t, keys[0], keys[0]));
+  CHECK_ZERO(c_btree_get(t, keys[0], NULL));
+
+  c_btree_destroy(t);
+  return 0;
+}
+
+int main(void) {
+  srand(1);
+  for (int i = 0; i < KEYS_NUM; i++) {
+    snprintf(keys_buffer[i], sizeof(keys_buffer[i]), "key%05d", i);
+    keys[i] = keys_buffer[i];
+  }
+  shuffle(order, KEYS_NUM);
+
+  RUN_TEST(btree);
+
+  END_TEST;
+}
@@ -32,8 +32,12 @@
 #include "utils/common/common.h"
 #include "testing.h"
 #include "utils/cmds/cmds.h"
+#include "utils/cmds/getstats.h"
 // clang-format on
 
+extern plugin_stats_t const *stats_mock;
+extern size_t stats_mock_num;
+
 static void error_cb(void *ud, cmd_status_t status, const char *format,
                      va_list ap) {
   if (status == CMD_OK)
@@ -330,7 +334,119 @@ DEF_TEST(parse) {
   return test_result;
 }
 
+/* Runs "command" through handle_getstats() and returns its output, which has
+ * to be freed by the caller. */
+static char *getstats(char const *command, int *ret_status) {
+  char *output = NULL;
+  size_t output_size = 0;
+  FILE *fh = open_memstream(&output, &output_size);
+  if (fh == NULL)
+    return NULL;
+
+  char *buffer = strdup(command);
+  *ret_status = handle_getstats(fh, buffer);
+  free(buffer);
+
+  fclose(fh);
+  return output;
+}
+
+DEF_TEST(getstats) {
+  plugin_stats_t stats[] = {
+      {
+          .name = "read-cpu",
+          .type = PLUGIN_STATS_READ,
+          .calls = 3,
+          .failures = 1,
+          .values = 24,
+          .cpu_time = TIME_T_TO_CDTIME_T(2),
+          .total_time = TIME_T_TO_CDTIME_T(4),
+          .latency_max = MS_TO_CDTIME_T(1500),
+          .latency_median = MS_TO_CDTIME_T(1000),
+          .latency_p99 = MS_TO_CDTIME_T(1500),
+      },
+      {
+          .name = "write-csv",
+          .type = PLUGIN_STATS_WRITE,
+          .calls = 24,
+      },
+      {
+          .name = "thread-reader#0",
+          .type = PLUGIN_STATS_THREAD,
+          .cpu_time = MS_TO_CDTIME_T(250),
+      },
+  };
+  struct {
+    char const *command;
+    int want_status;
+    char const *want;
+  } cases[] = {
+      {
+          "GETSTATS",
+          0,
+          "3 Statistics found\n"
+          "read-cpu calls=3 failures=1 values=24 cpu=2.000000 time=4.000000 "
+          "latency-max=1.500000 latency-median=1.000000 "
+          "latency-p99=1.500000\n"
+          "write-csv calls=24 failures=0 values=0 cpu=0.000000 time=0.000000 "
+          "latency-max=0.000000 latency-median=0.000000 "
+          "latency-p99=0.000000\n"
+          "thread-reader#0 cpu=0.250000\n",
+      },
+      {
+          "GETSTATS thread-",
+          0,
+          "1 Statistic found\n"
+          "thread-reader#0 cpu=0.250000\n",
+      },
+      {
+          "GETSTATS \"no such prefix\"",
+          0,
+          "0 Statistics found\n",
+      },
+      {
+          "GETSTATS read- garbage",
+          -1,
+          "-1 Garbage after end of command: garbage\n",
+      },
+      {
+          "GETVAL read-",
+          -1,
+          "-1 Cannot parse command.\n",
+      },
+  };
+
+  stats_mock = stats;
+  stats_mock_num = STATIC_ARRAY_SIZE(stats);
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    int status = 0;
+    char *output;
+
+    CHECK_NOT_NULL(output = getstats(cases[i].command, &status));
+    EXPECT_EQ_INT(cases[i].want_status, status);
+    EXPECT_EQ_STR(cases[i].want, output);
+    free(output);
+  }
+
+  /* Statistics are not recorded unless CollectInternalStats is enabled. */
+  stats_mock = NULL;
+  stats_mock_num = 0;
+
+  int status = 0;
+  char *output;
+  CHECK_NOT_NULL(output = getstats("GETSTATS", &status));
+  EXPECT_EQ_INT(-1, status);
+  EXPECT_EQ_STR("-1 Statistics are disabled. "
+                "Enable the CollectInternalStats option.\n",
+                output);
+  free(output);
+
+  return 0;
+}
+
 int main(int argc, char **argv) {
   RUN_TEST(parse);
+  RUN_TEST(getstats);
   END_TEST;
 }
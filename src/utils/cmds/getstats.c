@@ -0,0 +1,116 @@
+/**
+ * collectd - src/utils/cmds/getstats.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+
+#include "utils/cmds/getstats.h"
+#include "utils/cmds/parse_option.h" /* for `parse_string' */
+
+#define print_to_socket(fh, ...)                                               \
+  do {                                                                         \
+    if (fprintf(fh, __VA_ARGS__) < 0) {                                        \
+      WARNING("handle_getstats: failed to write to socket #%i: %s",            \
+              fileno(fh), STRERRNO);                                           \
+      sfree(stats);                                                            \
+      return -1;                                                               \
+    }                                                                          \
+  } while (0)
+
+/* GETSTATS [<prefix>]
+ *
+ * Prints the statistics of all read and write callbacks and threads whose
+ * name starts with <prefix>, one per line. Times are in seconds. */
+int handle_getstats(FILE *fh, char *buffer) {
+  plugin_stats_t *stats = NULL;
+  size_t stats_num = 0;
+  char *command = NULL;
+  char *prefix = "";
+
+  if ((fh == NULL) || (buffer == NULL))
+    return -1;
+
+  if ((parse_string(&buffer, &command) != 0) ||
+      (strcasecmp("GETSTATS", command) != 0)) {
+    print_to_socket(fh, "-1 Cannot parse command.\n");
+    return -1;
+  }
+
+  if ((*buffer != 0) && (parse_string(&buffer, &prefix) != 0)) {
+    print_to_socket(fh, "-1 Cannot parse prefix.\n");
+    return -1;
+  }
+
+  if (*buffer != 0) {
+    print_to_socket(fh, "-1 Garbage after end of command: %s\n", buffer);
+    return -1;
+  }
+
+  int status = plugin_get_stats(&stats, &stats_num);
+  if (status == ENOTSUP) {
+    print_to_socket(fh, "-1 Statistics are disabled. "
+                        "Enable the CollectInternalStats option.\n");
+    return -1;
+  } else if (status != 0) {
+    print_to_socket(fh, "-1 Getting the statistics failed: %s\n",
+                    STRERROR(status));
+    return -1;
+  }
+
+  size_t prefix_len = strlen(prefix);
+  size_t num = 0;
+  for (size_t i = 0; i < stats_num; i++)
+    if (strncmp(prefix, stats[i].name, prefix_len) == 0)
+      num++;
+
+  print_to_socket(fh, "%" PRIsz " Statistic%s found\n", num,
+                  (num == 1) ? "" : "s");
+
+  for (size_t i = 0; i < stats_num; i++) {
+    plugin_stats_t const *st = stats + i;
+    if (strncmp(prefix, st->name, prefix_len) != 0)
+      continue;
+
+    if (st->type == PLUGIN_STATS_THREAD) {
+      print_to_socket(fh, "%s cpu=%.6f\n", st->name,
+                      CDTIME_T_TO_DOUBLE(st->cpu_time));
+      continue;
+    }
+
+    print_to_socket(fh,
+                    "%s calls=%" PRIu64 " failures=%" PRIu64
+                    " values=%" PRIu64 " cpu=%.6f time=%.6f"
+                    " latency-max=%.6f latency-median=%.6f"
+                    " latency-p99=%.6f\n",
+                    st->name, st->calls, st->failures, st->values,
+                    CDTIME_T_TO_DOUBLE(st->cpu_time),
+                    CDTIME_T_TO_DOUBLE(st->total_time),
+                    CDTIME_T_TO_DOUBLE(st->latency_max),
+                    CDTIME_T_TO_DOUBLE(st->latency_median),
+                    CDTIME_T_TO_DOUBLE(st->latency_p99));
+  }
+
+  sfree(stats);
+  return 0;
+} /* int handle_getstats */
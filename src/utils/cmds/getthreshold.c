@@ -29,9 +29,9 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 
-#include "utils/avltree/avltree.h"
 #include "utils/cmds/getthreshold.h"
 #include "utils/cmds/parse_option.h" /* for `parse_string' */
+#include "utils/hashmap/hashmap.h"
 #include "utils_threshold.h"
 
 #define print_to_socket(fh, ...)                                               \
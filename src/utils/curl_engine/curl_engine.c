@@ -0,0 +1,362 @@
+/**
+ * collectd - src/utils/curl_engine/curl_engine.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils/curl_engine/curl_engine.h"
+
+/* curl_multi_poll() and curl_multi_wakeup() were added in 7.68.0. With older
+ * versions, the thread wakes up regularly to pick up new transfers. */
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define HAVE_CURL_MULTI_WAKEUP 1
+#endif
+
+#define CURL_ENGINE_POLL_MS 1000
+#define CURL_ENGINE_WAIT_MS 100
+
+typedef enum {
+  JOB_QUEUED,   /* submitted, not yet added to the multi handle */
+  JOB_ACTIVE,   /* transfer in progress */
+  JOB_DONE,     /* transfer finished, callback not yet called */
+} job_state_t;
+
+typedef struct curl_engine_job_s curl_engine_job_t;
+struct curl_engine_job_s {
+  CURL *curl;
+  curl_engine_callback_t callback;
+  void *user_data;
+  plugin_ctx_t ctx;
+
+  job_state_t state;
+  CURLcode result;
+  bool cancel;
+
+  curl_engine_job_t *next;
+};
+
+static pthread_mutex_t engine_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signalled whenever a job has been removed or a callback has returned. */
+static pthread_cond_t engine_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t engine_thread;
+static bool engine_running;
+static bool engine_stop;
+static CURLM *engine_multi;
+static curl_engine_job_t *engine_jobs;
+/* Handle whose callback is currently running. Its job has already been
+ * removed, so that the callback may submit the handle again. */
+static CURL *engine_callback_curl;
+/* The highest number of transfers submitted at the same time. By default,
+ * the connection cache shrinks with the number of transfers in progress, so
+ * connections would be closed at the end of each round of reads. */
+static size_t engine_jobs_max;
+static size_t engine_max_connects;
+
+/* NOTE: You must hold engine_lock when calling this function! */
+static curl_engine_job_t *engine_job_find(CURL *curl) /* {{{ */
+{
+  for (curl_engine_job_t *job = engine_jobs; job != NULL; job = job->next)
+    if (job->curl == curl)
+      return job;
+  return NULL;
+} /* }}} curl_engine_job_t *engine_job_find */
+
+/* NOTE: You must hold engine_lock when calling this function! */
+static void engine_job_remove(curl_engine_job_t *job) /* {{{ */
+{
+  curl_engine_job_t **prev = &engine_jobs;
+  while ((*prev != NULL) && (*prev != job))
+    prev = &(*prev)->next;
+  if (*prev != NULL)
+    *prev = job->next;
+
+  if (job->state == JOB_ACTIVE)
+    curl_multi_remove_handle(engine_multi, job->curl);
+  sfree(job);
+
+  pthread_cond_broadcast(&engine_cond);
+} /* }}} void engine_job_remove */
+
+static void engine_wakeup(void) /* {{{ */
+{
+#if HAVE_CURL_MULTI_WAKEUP
+  if (engine_multi != NULL)
+    curl_multi_wakeup(engine_multi);
+#endif
+} /* }}} void engine_wakeup */
+
+/* Adds submitted handles to the multi handle and removes cancelled ones.
+ * NOTE: You must hold engine_lock when calling this function! */
+static void engine_update(void) /* {{{ */
+{
+  curl_engine_job_t *job = engine_jobs;
+
+  if (engine_max_connects < engine_jobs_max) {
+    engine_max_connects = engine_jobs_max;
+    curl_multi_setopt(engine_multi, CURLMOPT_MAXCONNECTS,
+                      (long)engine_max_connects);
+  }
+
+  while (job != NULL) {
+    curl_engine_job_t *next = job->next;
+
+    if (job->cancel) {
+      engine_job_remove(job);
+    } else if (job->state == JOB_QUEUED) {
+      CURLMcode status = curl_multi_add_handle(engine_multi, job->curl);
+      if (status == CURLM_OK) {
+        job->state = JOB_ACTIVE;
+      } else {
+        ERROR("curl_engine: curl_multi_add_handle failed: %s",
+              curl_multi_strerror(status));
+        job->state = JOB_DONE;
+        job->result = CURLE_FAILED_INIT;
+      }
+    }
+
+    job = next;
+  }
+} /* }}} void engine_update */
+
+/* Collects finished transfers from the multi handle.
+ * NOTE: You must hold engine_lock when calling this function! */
+static void engine_collect(void) /* {{{ */
+{
+  CURLMsg *msg;
+  int msgs_left;
+
+  while ((msg = curl_multi_info_read(engine_multi, &msgs_left)) != NULL) {
+    if (msg->msg != CURLMSG_DONE)
+      continue;
+
+    CURL *curl = msg->easy_handle;
+    CURLcode result = msg->data.result;
+    curl_engine_job_t *job = NULL;
+
+    curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&job);
+    curl_multi_remove_handle(engine_multi, curl);
+    if (job == NULL)
+      continue;
+
+    job->state = JOB_DONE;
+    job->result = result;
+  }
+} /* }}} void engine_collect */
+
+/* Calls the callbacks of all finished transfers. engine_lock is released
+ * while a callback is running.
+ * NOTE: You must hold engine_lock when calling this function! */
+static void engine_dispatch(void) /* {{{ */
+{
+  while (!engine_stop) {
+    curl_engine_job_t *job = engine_jobs;
+    while ((job != NULL) && (job->state != JOB_DONE))
+      job = job->next;
+    if (job == NULL)
+      return;
+
+    if (job->cancel) {
+      engine_job_remove(job);
+      continue;
+    }
+
+    curl_engine_job_t done = *job;
+    engine_job_remove(job);
+    engine_callback_curl = done.curl;
+    pthread_mutex_unlock(&engine_lock);
+
+    plugin_ctx_t old_ctx = plugin_set_ctx(done.ctx);
+    done.callback(done.curl, done.result, done.user_data);
+    plugin_set_ctx(old_ctx);
+
+    pthread_mutex_lock(&engine_lock);
+    engine_callback_curl = NULL;
+    pthread_cond_broadcast(&engine_cond);
+  }
+} /* }}} void engine_dispatch */
+
+static void *engine_main(void __attribute__((unused)) * arg) /* {{{ */
+{
+  pthread_mutex_lock(&engine_lock);
+  while (!engine_stop) {
+    engine_update();
+    pthread_mutex_unlock(&engine_lock);
+
+    int running = 0;
+    curl_multi_perform(engine_multi, &running);
+
+    pthread_mutex_lock(&engine_lock);
+    engine_collect();
+    engine_dispatch();
+    if (engine_stop)
+      break;
+    pthread_mutex_unlock(&engine_lock);
+
+#if HAVE_CURL_MULTI_WAKEUP
+    curl_multi_poll(engine_multi, NULL, 0, CURL_ENGINE_POLL_MS, NULL);
+#else
+    curl_multi_wait(engine_multi, NULL, 0, CURL_ENGINE_WAIT_MS, NULL);
+#endif
+
+    pthread_mutex_lock(&engine_lock);
+  }
+  pthread_mutex_unlock(&engine_lock);
+
+  return NULL;
+} /* }}} void *engine_main */
+
+/* NOTE: You must hold engine_lock when calling this function! */
+static int engine_start(void) /* {{{ */
+{
+  if (engine_running)
+    return 0;
+
+  if (engine_multi == NULL) {
+    engine_multi = curl_multi_init();
+    if (engine_multi == NULL) {
+      ERROR("curl_engine: curl_multi_init failed.");
+      return ENOMEM;
+    }
+#ifdef CURLPIPE_MULTIPLEX
+    curl_multi_setopt(engine_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+  }
+
+  engine_stop = false;
+  int status =
+      plugin_thread_create(&engine_thread, engine_main, NULL, "curl engine");
+  if (status != 0) {
+    ERROR("curl_engine: Starting thread failed: %s", STRERROR(status));
+    return status;
+  }
+
+  engine_running = true;
+  return 0;
+} /* }}} int engine_start */
+
+int curl_engine_submit(CURL *curl, curl_engine_callback_t callback, /* {{{ */
+                       void *user_data) {
+  if ((curl == NULL) || (callback == NULL))
+    return EINVAL;
+
+  pthread_mutex_lock(&engine_lock);
+  if (engine_job_find(curl) != NULL) {
+    pthread_mutex_unlock(&engine_lock);
+    return EBUSY;
+  }
+
+  int status = engine_start();
+  if (status != 0) {
+    pthread_mutex_unlock(&engine_lock);
+    return status;
+  }
+
+  curl_engine_job_t *job = calloc(1, sizeof(*job));
+  if (job == NULL) {
+    pthread_mutex_unlock(&engine_lock);
+    return ENOMEM;
+  }
+  job->curl = curl;
+  job->callback = callback;
+  job->user_data = user_data;
+  job->ctx = plugin_get_ctx();
+  job->state = JOB_QUEUED;
+
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, job);
+#ifdef CURLPIPE_MULTIPLEX
+  /* Prefer waiting for a connection that can be multiplexed over opening a
+   * new one. */
+  curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+#endif
+
+  job->next = engine_jobs;
+  engine_jobs = job;
+
+  size_t jobs_num = 0;
+  for (job = engine_jobs; job != NULL; job = job->next)
+    jobs_num++;
+  if (engine_jobs_max < jobs_num)
+    engine_jobs_max = jobs_num;
+
+  engine_wakeup();
+  pthread_mutex_unlock(&engine_lock);
+  return 0;
+} /* }}} int curl_engine_submit */
+
+bool curl_engine_busy(CURL *curl) /* {{{ */
+{
+  pthread_mutex_lock(&engine_lock);
+  bool busy = (engine_job_find(curl) != NULL) || (engine_callback_curl == curl);
+  pthread_mutex_unlock(&engine_lock);
+
+  return busy;
+} /* }}} bool curl_engine_busy */
+
+void curl_engine_cancel(CURL *curl) /* {{{ */
+{
+  pthread_mutex_lock(&engine_lock);
+
+  while (1) {
+    curl_engine_job_t *job = engine_job_find(curl);
+
+    if ((job != NULL) && (job->state == JOB_QUEUED)) {
+      engine_job_remove(job);
+      continue;
+    }
+    if ((job == NULL) && (engine_callback_curl != curl))
+      break;
+
+    /* The multi handle may only be used by the engine thread. */
+    if (job != NULL) {
+      job->cancel = true;
+      engine_wakeup();
+    }
+    pthread_cond_wait(&engine_cond, &engine_lock);
+  }
+
+  pthread_mutex_unlock(&engine_lock);
+} /* }}} void curl_engine_cancel */
+
+void curl_engine_shutdown(void) /* {{{ */
+{
+  pthread_mutex_lock(&engine_lock);
+  if (!engine_running) {
+    pthread_mutex_unlock(&engine_lock);
+    return;
+  }
+  engine_stop = true;
+  engine_wakeup();
+  pthread_mutex_unlock(&engine_lock);
+
+  pthread_join(engine_thread, NULL);
+
+  pthread_mutex_lock(&engine_lock);
+  while (engine_jobs != NULL)
+    engine_job_remove(engine_jobs);
+
+  curl_multi_cleanup(engine_multi);
+  engine_multi = NULL;
+  engine_max_connects = 0;
+  engine_running = false;
+  engine_stop = false;
+  pthread_mutex_unlock(&engine_lock);
+} /* }}} void curl_engine_shutdown */
@@ -0,0 +1,76 @@
+/**
+ * collectd - src/utils/curl_engine/curl_engine.h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_CURL_ENGINE_H
+#define UTILS_CURL_ENGINE_H 1
+
+#include "plugin.h"
+
+#include <curl/curl.h>
+
+/*
+ * The curl engine performs transfers of many cURL easy handles concurrently
+ * from a single thread, using the cURL multi interface. Connections are
+ * cached by the engine and reused by all handles, and requests to the same
+ * HTTP/2 server are multiplexed over one connection.
+ *
+ * The thread is started when the first transfer is submitted. Completion
+ * callbacks are called from this thread, with the plugin context of the
+ * thread that submitted the transfer, so they must not block.
+ */
+
+/*
+ * curl_engine_callback_t is called when a transfer has finished. "status" is
+ * the result of the transfer, as curl_easy_perform() would have returned it.
+ */
+typedef void (*curl_engine_callback_t)(CURL *curl, CURLcode status,
+                                       void *user_data);
+
+/*
+ * curl_engine_submit starts a transfer of the easy handle "curl". The handle
+ * must not be used by the caller until "callback" has been called. Returns
+ * EBUSY if a transfer of this handle is still in progress.
+ */
+int curl_engine_submit(CURL *curl, curl_engine_callback_t callback,
+                       void *user_data);
+
+/*
+ * curl_engine_busy returns true if a transfer of "curl" is in progress or its
+ * completion callback is running. If it returns false, data written by the
+ * last completion callback may be read without further locking.
+ */
+bool curl_engine_busy(CURL *curl);
+
+/*
+ * curl_engine_cancel aborts the transfer of "curl", if any. When this
+ * function returns, the engine no longer uses the handle and the completion
+ * callback is not running. The callback is not called for aborted transfers.
+ * Call this before freeing data used by the callback.
+ */
+void curl_engine_cancel(CURL *curl);
+
+/*
+ * curl_engine_shutdown aborts all transfers and stops the engine thread.
+ */
+void curl_engine_shutdown(void);
+
+#endif /* UTILS_CURL_ENGINE_H */
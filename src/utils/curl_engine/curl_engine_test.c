@@ -0,0 +1,311 @@
+/**
+ * collectd - src/utils/curl_engine/curl_engine_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "utils/curl_engine/curl_engine.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define REQUESTS 20
+#define DELAY_MS 200
+
+/* A stand-in for an HTTP server: every connection is served by its own
+ * thread, which answers each request after DELAY_MS milliseconds with a body
+ * containing the request path. Connections are kept alive. The server keeps
+ * track of the largest number of requests it was handling at the same
+ * time. */
+typedef struct {
+  int listen_fd;
+  int port;
+  pthread_mutex_t lock;
+  int connections;
+  int active;
+  int max_active;
+} server_t;
+
+static server_t srv;
+
+static void *server_connection(void *arg) {
+  int fd = (int)(intptr_t)arg;
+  char buffer[4096] = "";
+  size_t len = 0;
+
+  while (1) {
+    char *end;
+    while ((end = strstr(buffer, "\r\n\r\n")) == NULL) {
+      ssize_t n = read(fd, buffer + len, sizeof(buffer) - len - 1);
+      if (n <= 0) {
+        close(fd);
+        return NULL;
+      }
+      len += (size_t)n;
+      buffer[len] = 0;
+    }
+
+    char path[256] = "";
+    sscanf(buffer, "GET %255s ", path);
+
+    size_t request_len = (size_t)(end - buffer) + 4;
+    memmove(buffer, buffer + request_len, len - request_len + 1);
+    len -= request_len;
+
+    pthread_mutex_lock(&srv.lock);
+    srv.active++;
+    if (srv.max_active < srv.active)
+      srv.max_active = srv.active;
+    pthread_mutex_unlock(&srv.lock);
+
+    usleep(DELAY_MS * 1000);
+
+    pthread_mutex_lock(&srv.lock);
+    srv.active--;
+    pthread_mutex_unlock(&srv.lock);
+
+    char response[512];
+    int response_len = snprintf(response, sizeof(response),
+                                "HTTP/1.1 200 OK\r\n"
+                                "Content-Length: %zu\r\n"
+                                "\r\n"
+                                "%s",
+                                strlen(path), path);
+    if (write(fd, response, response_len) != response_len) {
+      close(fd);
+      return NULL;
+    }
+  }
+}
+
+static void *server_thread(void __attribute__((unused)) * arg) {
+  while (1) {
+    int fd = accept(srv.listen_fd, NULL, NULL);
+    if (fd < 0)
+      return NULL;
+
+    pthread_mutex_lock(&srv.lock);
+    srv.connections++;
+    pthread_mutex_unlock(&srv.lock);
+
+    pthread_t t;
+    pthread_create(&t, NULL, server_connection, (void *)(intptr_t)fd);
+    pthread_detach(t);
+  }
+}
+
+static int server_start(void) {
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t sa_len = sizeof(sa);
+
+  srv.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if ((srv.listen_fd < 0) ||
+      (bind(srv.listen_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (listen(srv.listen_fd, REQUESTS) != 0) ||
+      (getsockname(srv.listen_fd, (struct sockaddr *)&sa, &sa_len) != 0))
+    return -1;
+  srv.port = ntohs(sa.sin_port);
+
+  pthread_mutex_init(&srv.lock, NULL);
+  pthread_t t;
+  return pthread_create(&t, NULL, server_thread, NULL);
+}
+
+static int server_connections(void) {
+  pthread_mutex_lock(&srv.lock);
+  int connections = srv.connections;
+  srv.connections = 0;
+  pthread_mutex_unlock(&srv.lock);
+  return connections;
+}
+
+static int server_max_active(void) {
+  pthread_mutex_lock(&srv.lock);
+  int max_active = srv.max_active;
+  srv.max_active = 0;
+  pthread_mutex_unlock(&srv.lock);
+  return max_active;
+}
+
+typedef struct {
+  CURL *curl;
+  char body[256];
+  size_t body_len;
+  CURLcode status;
+  int done;
+} request_t;
+
+static request_t requests[REQUESTS];
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static int done_num;
+
+static size_t write_callback(void *buf, size_t size, size_t nmemb,
+                             void *user_data) {
+  request_t *r = user_data;
+  size_t len = size * nmemb;
+  if (r->body_len + len >= sizeof(r->body))
+    return 0;
+  memcpy(r->body + r->body_len, buf, len);
+  r->body_len += len;
+  r->body[r->body_len] = 0;
+  return len;
+}
+
+static void done_callback(CURL __attribute__((unused)) * curl,
+                          CURLcode status, void *user_data) {
+  request_t *r = user_data;
+
+  pthread_mutex_lock(&done_lock);
+  r->status = status;
+  r->done++;
+  done_num++;
+  pthread_cond_broadcast(&done_cond);
+  pthread_mutex_unlock(&done_lock);
+}
+
+static void request_init(request_t *r, char const *path) {
+  char url[256];
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", srv.port, path);
+
+  r->curl = curl_easy_init();
+  curl_easy_setopt(r->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(r->curl, CURLOPT_URL, url);
+  curl_easy_setopt(r->curl, CURLOPT_WRITEFUNCTION, write_callback);
+  curl_easy_setopt(r->curl, CURLOPT_WRITEDATA, r);
+}
+
+/* Waits until "num" callbacks have been called, at most "timeout_ms". */
+static int wait_done(int num, int timeout_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  pthread_mutex_lock(&done_lock);
+  while (done_num < num)
+    if (pthread_cond_timedwait(&done_cond, &done_lock, &deadline) != 0)
+      break;
+  int ret = done_num;
+  done_num = 0;
+  pthread_mutex_unlock(&done_lock);
+  return ret;
+}
+
+static int fetch_all(void) {
+  for (int i = 0; i < REQUESTS; i++) {
+    requests[i].body_len = 0;
+    if (curl_engine_submit(requests[i].curl, done_callback, requests + i) != 0)
+      return -1;
+  }
+  return wait_done(REQUESTS, 10000);
+}
+
+DEF_TEST(concurrent) {
+  for (int i = 0; i < REQUESTS; i++) {
+    char path[32];
+    snprintf(path, sizeof(path), "/page%d", i);
+    request_init(requests + i, path);
+  }
+
+  /* Sequential transfers would never have more than one request in
+   * flight. */
+  EXPECT_EQ_INT(REQUESTS, fetch_all());
+  OK(server_max_active() > 1);
+  for (int i = 0; i < REQUESTS; i++) {
+    char want[32];
+    snprintf(want, sizeof(want), "/page%d", i);
+    EXPECT_EQ_INT(CURLE_OK, requests[i].status);
+    EXPECT_EQ_STR(want, requests[i].body);
+  }
+  /* HTTP/1.1 needs one connection per concurrent request, but a request may
+   * have waited for a connection to become available. */
+  int connections = server_connections();
+  EXPECT_EQ_INT(1, (connections > 0) && (connections <= REQUESTS));
+
+  /* The second round reuses the cached connections, so no more than one
+   * connection per concurrent request is opened in total. */
+  EXPECT_EQ_INT(REQUESTS, fetch_all());
+  OK(server_max_active() > 1);
+  connections += server_connections();
+  EXPECT_EQ_INT(1, connections <= REQUESTS);
+
+  return 0;
+}
+
+DEF_TEST(busy_and_cancel) {
+  request_t *r = requests;
+  r->done = 0;
+
+  CHECK_ZERO(curl_engine_submit(r->curl, done_callback, r));
+  OK(curl_engine_busy(r->curl));
+  EXPECT_EQ_INT(EBUSY, curl_engine_submit(r->curl, done_callback, r));
+
+  /* Give the engine time to start the transfer, then abort it. */
+  usleep(DELAY_MS * 1000 / 4);
+  curl_engine_cancel(r->curl);
+  EXPECT_EQ_INT(0, wait_done(1, 2 * DELAY_MS));
+  EXPECT_EQ_INT(0, r->done);
+
+  /* The handle can be submitted again. */
+  r->body_len = 0;
+  CHECK_ZERO(curl_engine_submit(r->curl, done_callback, r));
+  EXPECT_EQ_INT(1, wait_done(1, 10000));
+  EXPECT_EQ_STR("/page0", r->body);
+
+  /* Cancelling an idle handle is a no-op. Once it returns, the callback is
+   * no longer running either. */
+  curl_engine_cancel(r->curl);
+  OK(!curl_engine_busy(r->curl));
+  return 0;
+}
+
+DEF_TEST(shutdown) {
+  CHECK_ZERO(curl_engine_submit(requests[0].curl, done_callback, requests));
+  curl_engine_shutdown();
+  EXPECT_EQ_INT(0, wait_done(1, 2 * DELAY_MS));
+
+  /* The engine is restarted by the next transfer. */
+  CHECK_ZERO(curl_engine_submit(requests[0].curl, done_callback, requests));
+  EXPECT_EQ_INT(1, wait_done(1, 10000));
+  curl_engine_shutdown();
+
+  for (int i = 0; i < REQUESTS; i++)
+    curl_easy_cleanup(requests[i].curl);
+  return 0;
+}
+
+int main(void) {
+  curl_global_init(CURL_GLOBAL_ALL);
+  CHECK_ZERO(server_start());
+
+  RUN_TEST(concurrent);
+  RUN_TEST(busy_and_cancel);
+  RUN_TEST(shutdown);
+
+  END_TEST;
+}
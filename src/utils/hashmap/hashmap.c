@@ -0,0 +1,301 @@
+/**
+ * collectd - src/utils/hashmap/hashmap.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/hashmap/hashmap.h"
+
+/* Linear probing with backward shift deletion, i.e. without tombstones: when
+ * an entry is removed, the following entries of the cluster are moved up if
+ * that brings them closer to their home slot. */
+#define HASHMAP_MIN_SLOTS 16
+
+/*
+ * private data types
+ */
+typedef struct {
+  uint64_t hash;
+  void *key; /* NULL if the slot is empty */
+  void *value;
+} c_hashmap_slot_t;
+
+struct c_hashmap_s {
+  uint64_t (*hash)(const void *);
+  int (*compare)(const void *, const void *);
+
+  c_hashmap_slot_t *slots;
+  size_t slots_num; /* power of two, or zero */
+  size_t size;
+
+  /* All slots before this one are empty. */
+  size_t pick_hint;
+};
+
+struct c_hashmap_iterator_s {
+  c_hashmap_t *h;
+  size_t next;
+};
+
+/*
+ * private functions
+ */
+/* Returns the slot holding `key' or, if `key' is not in the map, the empty
+ * slot to insert it into. */
+static size_t find_slot(c_hashmap_t const *h, const void *key, uint64_t hash,
+                        bool *found) {
+  size_t mask = h->slots_num - 1;
+
+  for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {
+    c_hashmap_slot_t const *s = h->slots + i;
+
+    if (s->key == NULL) {
+      *found = false;
+      return i;
+    }
+    if ((s->hash == hash) && (h->compare(s->key, key) == 0)) {
+      *found = true;
+      return i;
+    }
+  }
+} /* size_t find_slot */
+
+static int grow(c_hashmap_t *h) {
+  size_t slots_num = (h->slots_num == 0) ? HASHMAP_MIN_SLOTS : 2 * h->slots_num;
+  c_hashmap_slot_t *slots = calloc(slots_num, sizeof(*slots));
+  if (slots == NULL)
+    return -1;
+
+  size_t mask = slots_num - 1;
+  for (size_t i = 0; i < h->slots_num; i++) {
+    if (h->slots[i].key == NULL)
+      continue;
+
+    size_t j = (size_t)h->slots[i].hash & mask;
+    while (slots[j].key != NULL)
+      j = (j + 1) & mask;
+    slots[j] = h->slots[i];
+  }
+
+  free(h->slots);
+  h->slots = slots;
+  h->slots_num = slots_num;
+  h->pick_hint = 0;
+  return 0;
+} /* int grow */
+
+static void remove_slot(c_hashmap_t *h, size_t i) {
+  size_t mask = h->slots_num - 1;
+
+  for (size_t j = (i + 1) & mask; h->slots[j].key != NULL; j = (j + 1) & mask) {
+    size_t home = (size_t)h->slots[j].hash & mask;
+
+    /* The entry may fill the hole if the hole is between its home slot and
+     * its current slot. */
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      h->slots[i] = h->slots[j];
+      i = j;
+    }
+  }
+
+  h->slots[i] = (c_hashmap_slot_t){0};
+  h->size--;
+} /* void remove_slot */
+
+/*
+ * public functions
+ */
+c_hashmap_t *c_hashmap_create(uint64_t (*hash)(const void *),
+                              int (*compare)(const void *, const void *)) {
+  c_hashmap_t *h;
+
+  if ((hash == NULL) || (compare == NULL))
+    return NULL;
+
+  h = calloc(1, sizeof(*h));
+  if (h == NULL)
+    return NULL;
+
+  h->hash = hash;
+  h->compare = compare;
+  return h;
+} /* c_hashmap_t *c_hashmap_create */
+
+c_hashmap_t *c_hashmap_create_string(void) {
+  return c_hashmap_create(c_hashmap_hash_string,
+                          (int (*)(const void *, const void *))strcmp);
+} /* c_hashmap_t *c_hashmap_create_string */
+
+uint64_t c_hashmap_hash_string(const void *key) {
+  char const *str = key;
+  size_t len = strlen(str);
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ (uint64_t)len;
+  uint64_t w;
+
+  /* Identifiers are long; hash them a word at a time. */
+  for (; len >= sizeof(w); str += sizeof(w), len -= sizeof(w)) {
+    memcpy(&w, str, sizeof(w));
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+  w = 0;
+  memcpy(&w, str, len);
+  h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+
+  /* The finalizer of MurmurHash3 */
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+} /* uint64_t c_hashmap_hash_string */
+
+void c_hashmap_destroy(c_hashmap_t *h) {
+  if (h == NULL)
+    return;
+
+  free(h->slots);
+  free(h);
+} /* void c_hashmap_destroy */
+
+int c_hashmap_insert(c_hashmap_t *h, void *key, void *value) {
+  if ((h == NULL) || (key == NULL))
+    return -1;
+
+  /* Keep the load factor at or below 3/4. */
+  if (4 * (h->size + 1) > 3 * h->slots_num)
+    if (grow(h) != 0)
+      return -1;
+
+  uint64_t hash = h->hash(key);
+  bool found;
+  size_t i = find_slot(h, key, hash, &found);
+  if (found)
+    return 1;
+
+  h->slots[i] = (c_hashmap_slot_t){
+      .hash = hash,
+      .key = key,
+      .value = value,
+  };
+  h->size++;
+  if (i < h->pick_hint)
+    h->pick_hint = i;
+
+  return 0;
+} /* int c_hashmap_insert */
+
+int c_hashmap_remove(c_hashmap_t *h, const void *key, void **rkey,
+                     void **rvalue) {
+  if ((h == NULL) || (key == NULL) || (h->size == 0))
+    return -1;
+
+  bool found;
+  size_t i = find_slot(h, key, h->hash(key), &found);
+  if (!found)
+    return -1;
+
+  if (rkey != NULL)
+    *rkey = h->slots[i].key;
+  if (rvalue != NULL)
+    *rvalue = h->slots[i].value;
+
+  remove_slot(h, i);
+  return 0;
+} /* int c_hashmap_remove */
+
+int c_hashmap_get(c_hashmap_t *h, const void *key, void **value) {
+  if ((h == NULL) || (key == NULL) || (h->size == 0))
+    return -1;
+
+  bool found;
+  size_t i = find_slot(h, key, h->hash(key), &found);
+  if (!found)
+    return -1;
+
+  if (value != NULL)
+    *value = h->slots[i].value;
+  return 0;
+} /* int c_hashmap_get */
+
+int c_hashmap_pick(c_hashmap_t *h, void **key, void **value) {
+  if ((h == NULL) || (key == NULL) || (value == NULL) || (h->size == 0))
+    return -1;
+
+  /* Removing the first entry never moves another entry before it, so the
+   * next call can continue where this one left off. */
+  for (size_t i = h->pick_hint; i < h->slots_num; i++) {
+    if (h->slots[i].key == NULL)
+      continue;
+
+    *key = h->slots[i].key;
+    *value = h->slots[i].value;
+    remove_slot(h, i);
+    h->pick_hint = i;
+    return 0;
+  }
+
+  return -1;
+} /* int c_hashmap_pick */
+
+c_hashmap_iterator_t *c_hashmap_get_iterator(c_hashmap_t *h) {
+  c_hashmap_iterator_t *iter;
+
+  if (h == NULL)
+    return NULL;
+
+  iter = calloc(1, sizeof(*iter));
+  if (iter == NULL)
+    return NULL;
+  iter->h = h;
+
+  return iter;
+} /* c_hashmap_iterator_t *c_hashmap_get_iterator */
+
+int c_hashmap_iterator_next(c_hashmap_iterator_t *iter, void **key,
+                            void **value) {
+  if ((iter == NULL) || (key == NULL) || (value == NULL))
+    return -1;
+
+  c_hashmap_t *h = iter->h;
+  for (; iter->next < h->slots_num; iter->next++) {
+    if (h->slots[iter->next].key == NULL)
+      continue;
+
+    *key = h->slots[iter->next].key;
+    *value = h->slots[iter->next].value;
+    iter->next++;
+    return 0;
+  }
+
+  return -1;
+} /* int c_hashmap_iterator_next */
+
+void c_hashmap_iterator_destroy(c_hashmap_iterator_t *iter) { free(iter); }
+
+int c_hashmap_size(c_hashmap_t *h) {
+  if (h == NULL)
+    return 0;
+  return (int)h->size;
+} /* int c_hashmap_size */
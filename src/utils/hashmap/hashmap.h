@@ -0,0 +1,145 @@
+/**
+ * collectd - src/utils/hashmap/hashmap.h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_HASHMAP_H
+#define UTILS_HASHMAP_H 1
+
+#include <stdint.h>
+
+/*
+ * An unordered map with the same interface as c_avl_tree_t, for users which
+ * don't need the keys in order. Entries are stored in a single array using
+ * open addressing, so lookups usually touch a single cache line plus the key.
+ * Iterators return the entries in no particular order and are invalidated by
+ * inserting or removing entries.
+ */
+struct c_hashmap_s;
+typedef struct c_hashmap_s c_hashmap_t;
+
+struct c_hashmap_iterator_s;
+typedef struct c_hashmap_iterator_s c_hashmap_iterator_t;
+
+/*
+ * NAME
+ *   c_hashmap_create
+ *
+ * DESCRIPTION
+ *   Allocates a new hash map.
+ *
+ * PARAMETERS
+ *   `hash'     Hash function for keys. Equal keys must have equal hashes.
+ *              For char-pointers, use `c_hashmap_hash_string'.
+ *   `compare'  Compares two keys. It has to return zero if both are equal.
+ *              If your keys are char-pointers, you can use the `strcmp'
+ *              function from the libc here.
+ *
+ * RETURN VALUE
+ *   A c_hashmap_t-pointer upon success or NULL upon failure.
+ */
+c_hashmap_t *c_hashmap_create(uint64_t (*hash)(const void *),
+                              int (*compare)(const void *, const void *));
+
+/* Shorthand for c_hashmap_create(c_hashmap_hash_string, strcmp). */
+c_hashmap_t *c_hashmap_create_string(void);
+
+/* Hashes a null-terminated string. */
+uint64_t c_hashmap_hash_string(const void *key);
+
+/*
+ * NAME
+ *   c_hashmap_destroy
+ *
+ * DESCRIPTION
+ *   Deallocates a hash map. Stored value- and key-pointer are lost, but of
+ *   course not freed.
+ */
+void c_hashmap_destroy(c_hashmap_t *h);
+
+/*
+ * NAME
+ *   c_hashmap_insert
+ *
+ * DESCRIPTION
+ *   Stores the key-value-pair in the map. The key is not copied, see
+ *   c_avl_insert(), and must not be NULL.
+ *
+ * RETURN VALUE
+ *   Zero upon success, non-zero otherwise. It's less than zero if an error
+ *   occurred or greater than zero if the key is already stored in the map.
+ */
+int c_hashmap_insert(c_hashmap_t *h, void *key, void *value);
+
+/*
+ * NAME
+ *   c_hashmap_remove
+ *
+ * DESCRIPTION
+ *   Removes a key-value-pair from the map. The stored key and value are
+ *   returned in `rkey' and `rvalue', if not NULL.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the key isn't found in the map.
+ */
+int c_hashmap_remove(c_hashmap_t *h, const void *key, void **rkey,
+                     void **rvalue);
+
+/*
+ * NAME
+ *   c_hashmap_get
+ *
+ * DESCRIPTION
+ *   Retrieves the `value' belonging to `key'. `value' may be NULL.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the key isn't found in the map.
+ */
+int c_hashmap_get(c_hashmap_t *h, const void *key, void **value);
+
+/*
+ * NAME
+ *   c_hashmap_pick
+ *
+ * DESCRIPTION
+ *   Removes an element from the map and returns its `key' and `value'. This
+ *   function is intended for removing all elements, one at a time.
+ *
+ * RETURN VALUE
+ *   Zero upon success or non-zero if the map is empty or key or value is
+ *   NULL.
+ */
+int c_hashmap_pick(c_hashmap_t *h, void **key, void **value);
+
+c_hashmap_iterator_t *c_hashmap_get_iterator(c_hashmap_t *h);
+int c_hashmap_iterator_next(c_hashmap_iterator_t *iter, void **key,
+                            void **value);
+void c_hashmap_iterator_destroy(c_hashmap_iterator_t *iter);
+
+/*
+ * NAME
+ *   c_hashmap_size
+ *
+ * DESCRIPTION
+ *   Returns the number of elements in the map, 0 if the map is NULL.
+ */
+int c_hashmap_size(c_hashmap_t *h);
+
+#endif /* UTILS_HASHMAP_H */
@@ -0,0 +1,174 @@
+/**
+ * collectd - src/utils/hashmap/hashmap_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/hashmap/hashmap.h"
+
+#define KEYS_NUM 5000
+
+static char keys_buffer[KEYS_NUM][16];
+static char *keys[KEYS_NUM];
+static int order[KEYS_NUM];
+static bool present[KEYS_NUM];
+
+static void shuffle(int *a, int num) {
+  for (int i = 0; i < num; i++)
+    a[i] = i;
+  for (int i = num - 1; i > 0; i--) {
+    int j = rand() % (i + 1);
+    int tmp = a[i];
+    a[i] = a[j];
+    a[j] = tmp;
+  }
+}
+
+/* Puts many keys into the same home slots, to exercise probing and moving
+ * entries when others are removed. */
+static uint64_t bad_hash(const void *key) {
+  return c_hashmap_hash_string(key) % 7;
+}
+
+/* Returns the number of keys which are missing, shouldn't be there or have
+ * the wrong value. */
+static int check_contents(c_hashmap_t *h) {
+  int errors = 0;
+  int num = 0;
+
+  for (int i = 0; i < KEYS_NUM; i++) {
+    char *value = NULL;
+    int status = c_hashmap_get(h, keys[i], (void *)&value);
+    if (present[i])
+      errors += (status != 0) || (value != keys[i]);
+    else
+      errors += (status == 0);
+    num += present[i];
+  }
+
+  /* Every key is returned exactly once by the iterator. */
+  static int seen[KEYS_NUM];
+  memset(seen, 0, sizeof(seen));
+  c_hashmap_iterator_t *iter = c_hashmap_get_iterator(h);
+  char *key;
+  char *value;
+  while (c_hashmap_iterator_next(iter, (void *)&key, (void *)&value) == 0) {
+    int i = atoi(key + strlen("key"));
+    seen[i]++;
+    errors += (key != keys[i]) || (value != keys[i]) || !present[i];
+  }
+  c_hashmap_iterator_destroy(iter);
+  for (int i = 0; i < KEYS_NUM; i++)
+    errors += present[i] ? (seen[i] != 1) : 0;
+
+  errors += (num != c_hashmap_size(h));
+  return errors;
+}
+
+static int test_map(c_hashmap_t *h) {
+  memset(present, 0, sizeof(present));
+  EXPECT_EQ_INT(0, check_contents(h));
+  OK(c_hashmap_remove(h, keys[0], NULL, NULL) != 0);
+  OK(c_hashmap_insert(h, NULL, NULL) < 0);
+
+  shuffle(order, KEYS_NUM);
+  int failed = 0;
+  for (int i = 0; i < KEYS_NUM; i++) {
+    if (c_hashmap_insert(h, keys[order[i]], keys[order[i]]) != 0)
+      failed++;
+    present[order[i]] = true;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(1, c_hashmap_insert(h, keys[42], NULL));
+  EXPECT_EQ_INT(0, check_contents(h));
+
+  /* Remove half of the keys in random order, then re-insert some. */
+  shuffle(order, KEYS_NUM);
+  failed = 0;
+  for (int i = 0; i < KEYS_NUM / 2; i++) {
+    char *k = keys[order[i]];
+    char *key = NULL;
+    char *value = NULL;
+    if ((c_hashmap_remove(h, k, (void *)&key, (void *)&value) != 0) ||
+        (key != k) || (value != k))
+      failed++;
+    present[order[i]] = false;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(0, check_contents(h));
+
+  for (int i = 0; i < KEYS_NUM / 4; i++) {
+    CHECK_ZERO(c_hashmap_insert(h, keys[order[i]], keys[order[i]]));
+    present[order[i]] = true;
+  }
+  EXPECT_EQ_INT(0, check_contents(h));
+
+  /* Pick everything. */
+  int size = c_hashmap_size(h);
+  failed = 0;
+  char *key;
+  char *value;
+  while (c_hashmap_pick(h, (void *)&key, (void *)&value) == 0) {
+    int i = atoi(key + strlen("key"));
+    failed += (key != value) || !present[i];
+    present[i] = false;
+    size--;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(0, size);
+  EXPECT_EQ_INT(0, check_contents(h));
+
+  /* The map is usable after it has been emptied. */
+  CHECK_ZERO(c_hashmap_insert(h, keys[0], keys[0]));
+  CHECK_ZERO(c_hashmap_get(h, keys[0], NULL));
+  return 0;
+}
+
+DEF_TEST(hashmap) {
+  c_hashmap_t *h;
+  CHECK_NOT_NULL(h = c_hashmap_create_string());
+  int status = test_map(h);
+  c_hashmap_destroy(h);
+  return status;
+}
+
+DEF_TEST(collisions) {
+  c_hashmap_t *h;
+  CHECK_NOT_NULL(h = c_hashmap_create(
+                     bad_hash, (int (*)(const void *, const void *))strcmp));
+  int status = test_map(h);
+  c_hashmap_destroy(h);
+  return status;
+}
+
+int main(void) {
+  srand(1);
+  for (int i = 0; i < KEYS_NUM; i++) {
+    snprintf(keys_buffer[i], sizeof(keys_buffer[i]), "key%d", i);
+    keys[i] = keys_buffer[i];
+  }
+
+  RUN_TEST(hashmap);
+  RUN_TEST(collisions);
+
+  END_TEST;
+}
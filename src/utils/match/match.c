@@ -41,6 +41,12 @@ struct cu_match_s {
   regex_t excluderegex;
   int flags;
 
+  /* Literal strings every matching line must contain, if any. Lines without
+   * them are rejected with strstr(3) before running the regular expressions.
+   */
+  char *regex_literal;
+  char *excluderegex_literal;
+
   int (*callback)(const char *str, char *const *matches, size_t matches_num,
                   void *user_data);
   void *user_data;
@@ -72,6 +78,132 @@ static char *match_substr(const char *str, int begin, int end) {
   return ret;
 } /* char *match_substr */
 
+/* Returns the longest string which occurs literally in every string matched
+ * by the extended regular expression `regex', or NULL if there is none (or
+ * the expression is too complex to tell). Only characters outside of groups
+ * are considered, and expressions with top-level alternations are skipped. */
+static char *match_required_literal(const char *regex) {
+  size_t regex_len = strlen(regex);
+  char *run = malloc(regex_len + 1);
+  char *best = malloc(regex_len + 1);
+  size_t run_len = 0;
+  size_t best_len = 0;
+  int depth = 0;
+
+  if ((run == NULL) || (best == NULL)) {
+    sfree(run);
+    sfree(best);
+    return NULL;
+  }
+
+#define END_RUN()                                                              \
+  do {                                                                         \
+    if (run_len > best_len) {                                                  \
+      memcpy(best, run, run_len);                                              \
+      best_len = run_len;                                                      \
+    }                                                                          \
+    run_len = 0;                                                               \
+  } while (0)
+
+  for (size_t i = 0; i < regex_len; i++) {
+    char c = regex[i];
+
+    if (c == '\\') {
+      i++;
+      if ((i >= regex_len) || isalnum((unsigned char)regex[i])) {
+        /* Character class escapes and back-references */
+        END_RUN();
+        continue;
+      }
+      if (depth == 0)
+        run[run_len++] = regex[i];
+      continue;
+    }
+
+    if (c == '[') {
+      /* Skip bracket expressions, including `[]...]' and `[:class:]'. */
+      END_RUN();
+      i++;
+      if ((i < regex_len) && (regex[i] == '^'))
+        i++;
+      if ((i < regex_len) && (regex[i] == ']'))
+        i++;
+      while ((i < regex_len) && (regex[i] != ']')) {
+        if ((regex[i] == '[') && (i + 1 < regex_len) &&
+            ((regex[i + 1] == ':') || (regex[i + 1] == '.') ||
+             (regex[i + 1] == '='))) {
+          char delim = regex[i + 1];
+          i += 2;
+          while ((i + 1 < regex_len) &&
+                 !((regex[i] == delim) && (regex[i + 1] == ']')))
+            i++;
+          i++;
+        }
+        i++;
+      }
+      if (i >= regex_len)
+        goto fail;
+      continue;
+    }
+
+    switch (c) {
+    case '|':
+      if (depth == 0)
+        goto fail;
+      break;
+    case '(':
+      END_RUN();
+      depth++;
+      break;
+    case ')':
+      END_RUN();
+      if (depth > 0)
+        depth--;
+      break;
+    case '*':
+    case '?':
+    case '{':
+      /* The preceding character is optional or repeated. */
+      if (run_len > 0)
+        run_len--;
+      END_RUN();
+      if (c == '{') {
+        while ((i < regex_len) && (regex[i] != '}'))
+          i++;
+        if (i >= regex_len)
+          goto fail;
+      }
+      break;
+    case '+':
+    case '.':
+    case '^':
+    case '$':
+      END_RUN();
+      break;
+    default:
+      if (depth == 0)
+        run[run_len++] = c;
+      else
+        END_RUN();
+    }
+  }
+  END_RUN();
+#undef END_RUN
+
+  sfree(run);
+  if (best_len == 0) {
+    sfree(best);
+    return NULL;
+  }
+  best[best_len] = 0;
+  return best;
+
+fail:
+  sfree(run);
+  sfree(best);
+  return NULL;
+} /* char *match_required_literal */
+
 static int default_callback(const char __attribute__((unused)) * str,
                             char *const *matches, size_t matches_num,
                             void *user_data) {
@@ -236,16 +368,20 @@ match_create_callback(const char *regex, const char *excluderegex,
     return NULL;
   }
   obj->flags |= UTILS_MATCH_FLAGS_REGEX;
+  obj->regex_literal = match_required_literal(regex);
 
   if (excluderegex && strcmp(excluderegex, "") != 0) {
     status = regcomp(&obj->excluderegex, excluderegex, REG_EXTENDED);
     if (status != 0) {
       ERROR("Compiling the excluding regular expression \"%s\" failed.",
             excluderegex);
+      regfree(&obj->regex);
+      sfree(obj->regex_literal);
       sfree(obj);
       return NULL;
     }
     obj->flags |= UTILS_MATCH_FLAGS_EXCLUDE_REGEX;
+    obj->excluderegex_literal = match_required_literal(excluderegex);
   }
 
   obj->callback = callback;
@@ -310,6 +446,8 @@ void match_destroy(cu_match_t *obj) {
   if ((obj->user_data != NULL) && (obj->free != NULL))
     (*obj->free)(obj->user_data);
 
+  sfree(obj->regex_literal);
+  sfree(obj->excluderegex_literal);
   sfree(obj);
 } /* void match_destroy */
 
@@ -322,7 +460,13 @@ int match_apply(cu_match_t *obj, const char *str) {
   if ((obj == NULL) || (str == NULL))
     return -1;
 
-  if (obj->flags & UTILS_MATCH_FLAGS_EXCLUDE_REGEX) {
+  /* Line can't match */
+  if ((obj->regex_literal != NULL) && (strstr(str, obj->regex_literal) == NULL))
+    return 0;
+
+  if ((obj->flags & UTILS_MATCH_FLAGS_EXCLUDE_REGEX) &&
+      ((obj->excluderegex_literal == NULL) ||
+       (strstr(str, obj->excluderegex_literal) != NULL))) {
     status =
         regexec(&obj->excluderegex, str, STATIC_ARRAY_SIZE(re_match), re_match,
                 /* eflags = */ 0);
@@ -0,0 +1,91 @@
+/**
+ * collectd - src/utils/match/match_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "match.c" /* sic */
+#include "testing.h"
+
+DEF_TEST(required_literal) {
+  struct {
+    const char *regex;
+    const char *want;
+  } cases[] = {
+      {"GET /index.html", "GET /index"},
+      {"^Sep .* sshd\\[[0-9]+\\]: Accepted", "]: Accepted"},
+      {"status=([0-9]+) bytes", "status="},
+      {"colou?r", "colo"},
+      {"ab+c", "ab"},
+      {"a{2,3}bcd", "bcd"},
+      {"foo\\.bar", "foo.bar"},
+      {"\\w+ failed", " failed"},
+      {"[]x]yz", "yz"},
+      {"[[:digit:]]+ ms", " ms"},
+      {"error|warning", NULL},
+      {"(error|warning): disk", ": disk"},
+      {"^[0-9]+$", NULL},
+      {"(abc)", NULL},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    printf("# case %" PRIsz ": %s\n", i, cases[i].regex);
+    char *got = match_required_literal(cases[i].regex);
+    EXPECT_EQ_STR(cases[i].want ? cases[i].want : "(null)",
+                  got ? got : "(null)");
+    sfree(got);
+  }
+
+  return 0;
+}
+
+static int count_cb(const char __attribute__((unused)) * str,
+                    char *const __attribute__((unused)) * matches,
+                    size_t __attribute__((unused)) matches_num,
+                    void *user_data) {
+  (*(int *)user_data)++;
+  return 0;
+}
+
+DEF_TEST(apply) {
+  int count = 0;
+  cu_match_t *m;
+
+  CHECK_NOT_NULL(m = match_create_callback("(GET|POST) /api", "health",
+                                           count_cb, &count, NULL));
+  EXPECT_EQ_STR(" /api", m->regex_literal);
+  EXPECT_EQ_STR("health", m->excluderegex_literal);
+
+  CHECK_ZERO(match_apply(m, "GET /api/v1"));
+  CHECK_ZERO(match_apply(m, "POST /api/v1"));
+  CHECK_ZERO(match_apply(m, "PUT /api/v1"));
+  CHECK_ZERO(match_apply(m, "GET /apihealth"));
+  CHECK_ZERO(match_apply(m, "GET /static"));
+  EXPECT_EQ_INT(2, count);
+
+  match_destroy(m);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(required_literal);
+  RUN_TEST(apply);
+
+  END_TEST;
+}
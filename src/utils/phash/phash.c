@@ -0,0 +1,220 @@
+/**
+ * collectd - src/utils/phash/phash.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/phash/phash.h"
+
+/* The keys are distributed over buckets of about PHASH_BUCKET_SIZE keys each.
+ * Starting with the largest bucket, a seed is then searched for every bucket
+ * which maps all of its keys to slots that are still free ("hash and
+ * displace"). A lookup hashes the key once, and uses the hash to find the
+ * bucket's seed and then, mixed with the seed, the key's slot. */
+#define PHASH_BUCKET_SIZE 4
+#define PHASH_MAX_SEED 65536
+#define PHASH_MAX_TRIES 4
+
+struct phash_s {
+  uint32_t *seeds;
+  size_t buckets_num;
+
+  char const **keys;
+  void **values;
+  size_t slots_num; /* power of two */
+};
+
+typedef struct {
+  uint64_t hash;
+  size_t index;
+  size_t bucket;
+  size_t bucket_size;
+} phash_entry_t;
+
+/* 64 bit FNV-1a */
+static uint64_t phash_hash(char const *key) {
+  uint64_t h = 14695981039346656037ULL;
+
+  for (; *key != 0; key++) {
+    h ^= (unsigned char)*key;
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+} /* uint64_t phash_hash */
+
+/* The finalizer of MurmurHash3, which spreads the seed over all bits. */
+static uint64_t phash_mix(uint64_t h, uint32_t seed) {
+  h ^= (uint64_t)seed * 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+} /* uint64_t phash_mix */
+
+static size_t phash_slot(phash_t const *h, uint64_t hash, uint32_t seed) {
+  return (size_t)(phash_mix(hash, seed) & (h->slots_num - 1));
+}
+
+/* Orders entries by decreasing bucket size, then by bucket and hash. */
+static int phash_compare_entries(void const *a, void const *b) {
+  phash_entry_t const *e0 = a;
+  phash_entry_t const *e1 = b;
+
+  if (e0->bucket_size != e1->bucket_size)
+    return (e0->bucket_size > e1->bucket_size) ? -1 : 1;
+  if (e0->bucket != e1->bucket)
+    return (e0->bucket < e1->bucket) ? -1 : 1;
+  if (e0->hash != e1->hash)
+    return (e0->hash < e1->hash) ? -1 : 1;
+  return 0;
+} /* int phash_compare_entries */
+
+static int phash_place(phash_t *h, phash_entry_t const *entries, size_t num,
+                       char const *const *keys, void *const *values) {
+  memset(h->keys, 0, h->slots_num * sizeof(*h->keys));
+  memset(h->values, 0, h->slots_num * sizeof(*h->values));
+
+  size_t begin = 0;
+  while (begin < num) {
+    size_t end = begin + 1;
+    while ((end < num) && (entries[end].bucket == entries[begin].bucket))
+      end++;
+
+    uint32_t seed;
+    for (seed = 1; seed <= PHASH_MAX_SEED; seed++) {
+      size_t i;
+      /* Occupy the slots right away to detect collisions within the bucket,
+       * too. */
+      for (i = begin; i < end; i++) {
+        size_t slot = phash_slot(h, entries[i].hash, seed);
+        if (h->keys[slot] != NULL)
+          break;
+        h->keys[slot] = keys[entries[i].index];
+      }
+      if (i == end)
+        break;
+
+      for (size_t j = begin; j < i; j++)
+        h->keys[phash_slot(h, entries[j].hash, seed)] = NULL;
+    }
+    if (seed > PHASH_MAX_SEED)
+      return -1;
+
+    h->seeds[entries[begin].bucket] = seed;
+    for (size_t i = begin; i < end; i++)
+      h->values[phash_slot(h, entries[i].hash, seed)] =
+          values[entries[i].index];
+
+    begin = end;
+  }
+
+  return 0;
+} /* int phash_place */
+
+phash_t *phash_create(char const *const *keys, void *const *values,
+                      size_t num) {
+  phash_t *h = calloc(1, sizeof(*h));
+  phash_entry_t *entries = calloc(num + 1, sizeof(*entries));
+  if ((h == NULL) || (entries == NULL)) {
+    free(h);
+    free(entries);
+    return NULL;
+  }
+
+  h->buckets_num = num / PHASH_BUCKET_SIZE + 1;
+  h->seeds = calloc(h->buckets_num, sizeof(*h->seeds));
+  if (h->seeds == NULL) {
+    free(entries);
+    phash_destroy(h);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < num; i++) {
+    entries[i].hash = phash_hash(keys[i]);
+    entries[i].index = i;
+    entries[i].bucket = phash_mix(entries[i].hash, 0) % h->buckets_num;
+    h->seeds[entries[i].bucket]++;
+  }
+  for (size_t i = 0; i < num; i++)
+    entries[i].bucket_size = h->seeds[entries[i].bucket];
+  qsort(entries, num, sizeof(*entries), phash_compare_entries);
+
+  /* Keys with the same hash, in particular duplicate keys, can never be
+   * placed. */
+  for (size_t i = 1; i < num; i++) {
+    if (entries[i].hash == entries[i - 1].hash) {
+      free(entries);
+      phash_destroy(h);
+      return NULL;
+    }
+  }
+
+  h->slots_num = 8;
+  while (h->slots_num < 2 * num)
+    h->slots_num *= 2;
+
+  int status = -1;
+  for (int tries = 0; (status != 0) && (tries < PHASH_MAX_TRIES); tries++) {
+    if (tries > 0)
+      h->slots_num *= 2;
+
+    free(h->keys);
+    free(h->values);
+    h->keys = calloc(h->slots_num, sizeof(*h->keys));
+    h->values = calloc(h->slots_num, sizeof(*h->values));
+    if ((h->keys == NULL) || (h->values == NULL))
+      break;
+
+    status = phash_place(h, entries, num, keys, values);
+  }
+
+  free(entries);
+  if (status != 0) {
+    phash_destroy(h);
+    return NULL;
+  }
+
+  return h;
+} /* phash_t *phash_create */
+
+void phash_destroy(phash_t *h) {
+  if (h == NULL)
+    return;
+
+  free(h->seeds);
+  free(h->keys);
+  free(h->values);
+  free(h);
+} /* void phash_destroy */
+
+void *phash_get(phash_t const *h, char const *key) {
+  uint64_t hash = phash_hash(key);
+  uint32_t seed = h->seeds[phash_mix(hash, 0) % h->buckets_num];
+  size_t slot = phash_slot(h, hash, seed);
+
+  if ((h->keys[slot] == NULL) || (strcmp(h->keys[slot], key) != 0))
+    return NULL;
+
+  return h->values[slot];
+} /* void *phash_get */
@@ -0,0 +1,73 @@
+/**
+ * collectd - src/utils/phash/phash.h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_PHASH_H
+#define UTILS_PHASH_H 1
+
+#include <stddef.h>
+
+struct phash_s;
+typedef struct phash_s phash_t;
+
+/*
+ * NAME
+ *   phash_create
+ *
+ * DESCRIPTION
+ *   Builds a perfect hash table for a fixed set of string keys: every key is
+ *   assigned a slot of its own, so that looking up a key takes one pass over
+ *   the key and a single string comparison, regardless of the number of keys.
+ *   Adding or removing keys requires building a new table.
+ *
+ * PARAMETERS
+ *   `keys'     Array of `num' distinct keys. The strings are not copied and
+ *              have to stay valid for as long as the table is used.
+ *   `values'   Array of `num' values, `values[i]' being returned for
+ *              `keys[i]'.
+ *   `num'      Number of keys, may be zero.
+ *
+ * RETURN VALUE
+ *   A phash_t-pointer upon success or NULL if memory could not be allocated
+ *   or the keys are not distinct.
+ */
+phash_t *phash_create(char const *const *keys, void *const *values,
+                      size_t num);
+
+/*
+ * NAME
+ *   phash_destroy
+ *
+ * DESCRIPTION
+ *   Deallocates a table. Keys and values are not freed.
+ */
+void phash_destroy(phash_t *h);
+
+/*
+ * NAME
+ *   phash_get
+ *
+ * DESCRIPTION
+ *   Returns the value of `key' or NULL if `key' is not in the table.
+ */
+void *phash_get(phash_t const *h, char const *key);
+
+#endif /* UTILS_PHASH_H */
@@ -0,0 +1,87 @@
+/**
+ * collectd - src/utils/phash/phash_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/phash/phash.h"
+
+#define KEYS_NUM 5000
+
+static char keys_buffer[KEYS_NUM][16];
+static char const *keys[KEYS_NUM];
+static int values[KEYS_NUM];
+static void *value_ptrs[KEYS_NUM];
+
+static void fill_keys(void) {
+  for (int i = 0; i < KEYS_NUM; i++) {
+    snprintf(keys_buffer[i], sizeof(keys_buffer[i]), "type%d", i);
+    keys[i] = keys_buffer[i];
+    values[i] = i;
+    value_ptrs[i] = values + i;
+  }
+}
+
+DEF_TEST(lookup) {
+  size_t sizes[] = {0, 1, 2, 3, 17, 300, KEYS_NUM};
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    size_t num = sizes[i];
+    phash_t *h;
+    CHECK_NOT_NULL(h = phash_create(keys, value_ptrs, num));
+
+    int found = 0;
+    for (size_t j = 0; j < num; j++) {
+      int *v = phash_get(h, keys[j]);
+      if ((v != NULL) && (*v == (int)j))
+        found++;
+    }
+    EXPECT_EQ_INT((int)num, found);
+
+    /* Keys not in the table. */
+    if (num < KEYS_NUM)
+      OK(phash_get(h, keys[num]) == NULL);
+    OK(phash_get(h, "") == NULL);
+    OK(phash_get(h, "type") == NULL);
+
+    phash_destroy(h);
+  }
+
+  return 0;
+}
+
+DEF_TEST(duplicates) {
+  char const *dup_keys[] = {"gauge", "derive", "gauge"};
+  void *dup_values[] = {NULL, NULL, NULL};
+
+  OK(phash_create(dup_keys, dup_values, 3) == NULL);
+  return 0;
+}
+
+int main(void) {
+  fill_keys();
+
+  RUN_TEST(lookup);
+  RUN_TEST(duplicates);
+
+  END_TEST;
+}
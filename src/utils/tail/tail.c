@@ -35,12 +35,98 @@
 #include "utils/common/common.h"
 #include "utils/tail/tail.h"
 
+#if KERNEL_LINUX
+#include <sys/inotify.h>
+#endif
+
+/* Size of the read buffer. Lines are split in this buffer, so it also limits
+ * the length of the lines handed out by cu_tail_read_batch. */
+#define CU_TAIL_BUFFER_SIZE 65536
+
 struct cu_tail_s {
   char *file;
-  FILE *fh;
+  int fd;
   struct stat stat;
+
+  /* Data read from the file. Bytes before `buf_pos' have been handed out
+   * already, bytes up to `buf_len' are still pending. One byte is always kept
+   * spare so lines can be null-terminated in place. */
+  char *buf;
+  size_t buf_size;
+  size_t buf_pos;
+  size_t buf_len;
+
+  char **lines;
+  size_t lines_size;
+
+#if KERNEL_LINUX
+  /* Reports modifications, renames and removals of the file, so that it
+   * doesn't have to be stat'ed every time the end of the file is reached. */
+  int inotify_fd;
+  int inotify_wd;
+  /* Set when events have been received, until the file has been re-checked. */
+  bool changed;
+#endif
 };
 
+#if KERNEL_LINUX
+static void cu_tail_watch(cu_tail_t *obj) {
+  if (obj->inotify_fd < 0)
+    return;
+
+  int wd = inotify_add_watch(obj->inotify_fd, obj->file,
+                             IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF |
+                                 IN_DELETE_SELF);
+  if (wd < 0) {
+    P_WARNING("utils_tail: inotify_add_watch (%s) failed: %s", obj->file,
+              STRERRNO);
+    close(obj->inotify_fd);
+    obj->inotify_fd = -1;
+    return;
+  }
+
+  if ((obj->inotify_wd >= 0) && (obj->inotify_wd != wd))
+    inotify_rm_watch(obj->inotify_fd, obj->inotify_wd);
+  obj->inotify_wd = wd;
+
+  /* The file may have been replaced before the watch was set up. */
+  struct stat stat_buf = {0};
+  if ((stat(obj->file, &stat_buf) != 0) ||
+      (stat_buf.st_ino != obj->stat.st_ino))
+    obj->changed = true;
+} /* void cu_tail_watch */
+#endif
+
+/* Returns true if the file may have been changed, truncated or replaced since
+ * the last call. Without inotify this is always the case. */
+static bool cu_tail_changed(cu_tail_t *obj) {
+#if KERNEL_LINUX
+  if ((obj->inotify_fd < 0) || (obj->inotify_wd < 0))
+    return true;
+
+  char buf[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (42) {
+    ssize_t status = read(obj->inotify_fd, buf, sizeof(buf));
+    if (status > 0) {
+      obj->changed = true;
+      continue;
+    }
+
+    if ((status < 0) && (errno == EINTR))
+      continue;
+    if ((status < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+      obj->changed = true;
+    break;
+  }
+
+  return obj->changed;
+#else
+  return true;
+#endif
+} /* bool cu_tail_changed */
+
 static int cu_tail_reopen(cu_tail_t *obj, bool force_rewind) {
   int seek_end = 0;
   struct stat stat_buf = {0};
@@ -52,19 +138,21 @@ static int cu_tail_reopen(cu_tail_t *obj, bool force_rewind) {
   }
 
   /* The file is already open.. */
-  if ((obj->fh != NULL) && (stat_buf.st_ino == obj->stat.st_ino)) {
+  if ((obj->fd >= 0) && (stat_buf.st_ino == obj->stat.st_ino)) {
     /* Seek to the beginning if file was truncated */
     if (stat_buf.st_size < obj->stat.st_size) {
       P_INFO("utils_tail: File `%s' was truncated.", obj->file);
-      status = fseek(obj->fh, 0, SEEK_SET);
-      if (status != 0) {
-        P_ERROR("utils_tail: fseek (%s) failed: %s", obj->file, STRERRNO);
-        fclose(obj->fh);
-        obj->fh = NULL;
+      if (lseek(obj->fd, 0, SEEK_SET) == (off_t)-1) {
+        P_ERROR("utils_tail: lseek (%s) failed: %s", obj->file, STRERRNO);
+        close(obj->fd);
+        obj->fd = -1;
         return -1;
       }
     }
     memcpy(&obj->stat, &stat_buf, sizeof(struct stat));
+#if KERNEL_LINUX
+    obj->changed = false;
+#endif
     return 1;
   }
 
@@ -74,29 +162,148 @@ static int cu_tail_reopen(cu_tail_t *obj, bool force_rewind) {
   if ((obj->stat.st_ino == 0) || (obj->stat.st_ino == stat_buf.st_ino))
     seek_end = !force_rewind;
 
-  FILE *fh = fopen(obj->file, "r");
-  if (fh == NULL) {
-    P_ERROR("utils_tail: fopen (%s) failed: %s", obj->file, STRERRNO);
+  int fd = open(obj->file, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    P_ERROR("utils_tail: open (%s) failed: %s", obj->file, STRERRNO);
     return -1;
   }
 
   if (seek_end != 0) {
-    status = fseek(fh, 0, SEEK_END);
-    if (status != 0) {
-      P_ERROR("utils_tail: fseek (%s) failed: %s", obj->file, STRERRNO);
-      fclose(fh);
+    if (lseek(fd, 0, SEEK_END) == (off_t)-1) {
+      P_ERROR("utils_tail: lseek (%s) failed: %s", obj->file, STRERRNO);
+      close(fd);
       return -1;
     }
   }
 
-  if (obj->fh != NULL)
-    fclose(obj->fh);
-  obj->fh = fh;
+  if (obj->fd >= 0)
+    close(obj->fd);
+  obj->fd = fd;
   memcpy(&obj->stat, &stat_buf, sizeof(struct stat));
 
+  /* An incomplete last line of the previous file won't be continued. */
+  if (obj->buf_len > obj->buf_pos)
+    obj->buf[obj->buf_len++] = '\n';
+
+#if KERNEL_LINUX
+  obj->changed = false;
+  cu_tail_watch(obj);
+#endif
+
   return 0;
 } /* int cu_tail_reopen */
 
+/* Makes sure the buffer can hold `size' bytes (including the spare byte). */
+static int cu_tail_buffer_reserve(cu_tail_t *obj, size_t size) {
+  if (size < CU_TAIL_BUFFER_SIZE)
+    size = CU_TAIL_BUFFER_SIZE;
+  if (obj->buf_size >= size)
+    return 0;
+
+  char *tmp = realloc(obj->buf, size);
+  if (tmp == NULL) {
+    ERROR("utils_tail: realloc failed.");
+    return -1;
+  }
+
+  obj->buf = tmp;
+  obj->buf_size = size;
+  return 0;
+} /* int cu_tail_buffer_reserve */
+
+/* Appends data from the file to the buffer. Returns the number of bytes read,
+ * zero when the end of the file has been reached and less than zero on
+ * error. */
+static ssize_t cu_tail_fill(cu_tail_t *obj, bool force_rewind) {
+  if (cu_tail_buffer_reserve(obj, 0) != 0)
+    return -1;
+
+  if (obj->buf_pos > 0) {
+    memmove(obj->buf, obj->buf + obj->buf_pos, obj->buf_len - obj->buf_pos);
+    obj->buf_len -= obj->buf_pos;
+    obj->buf_pos = 0;
+  }
+
+  if (obj->fd < 0) {
+    int status = cu_tail_reopen(obj, force_rewind);
+    if (status < 0)
+      return status;
+  }
+  assert(obj->fd >= 0);
+
+  bool reopened = false;
+  while (42) {
+    if (obj->buf_len + 1 >= obj->buf_size)
+      return 0;
+
+    ssize_t status = read(obj->fd, obj->buf + obj->buf_len,
+                          obj->buf_size - obj->buf_len - 1);
+    if (status > 0) {
+      obj->buf_len += (size_t)status;
+      return status;
+    }
+
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+
+      /* Error. Force `cu_tail_reopen' to reopen the file.. */
+      WARNING("utils_tail: read (%s) failed: %s", obj->file, STRERRNO);
+      close(obj->fd);
+      obj->fd = -1;
+      if (reopened)
+        return -1;
+    } else if (reopened || !cu_tail_changed(obj)) {
+      /* eof and nothing happened to the file */
+      return 0;
+    }
+    /* else: eof -> check if the file was moved away and reopen the new file
+     * if so.. */
+
+    int reopen_status = cu_tail_reopen(obj, force_rewind);
+    /* error -> return with error */
+    if (reopen_status < 0)
+      return reopen_status;
+
+    /* If we get here: the file was re-opened, or may have been appended to or
+     * truncated. Let's try again. */
+    reopened = true;
+    if (obj->buf_len > obj->buf_pos)
+      return 1;
+  }
+} /* ssize_t cu_tail_fill */
+
+/* Hands out the next line, including its newline character, or a chunk of
+ * `max_len' bytes if the line is longer than that. `*ret_line' is set to NULL
+ * if no complete line is available. The returned pointer is valid until the
+ * next call. */
+static int cu_tail_next(cu_tail_t *obj, size_t max_len, bool force_rewind,
+                        char **ret_line, size_t *ret_len) {
+  if (cu_tail_buffer_reserve(obj, max_len + 1) != 0)
+    return -1;
+
+  while (42) {
+    char *line = obj->buf + obj->buf_pos;
+    size_t avail = obj->buf_len - obj->buf_pos;
+
+    char *newline = memchr(line, '\n', (avail < max_len) ? avail : max_len);
+    if ((newline != NULL) || (avail >= max_len)) {
+      size_t len = (newline != NULL) ? (size_t)(newline - line) + 1 : max_len;
+      obj->buf_pos += len;
+      *ret_line = line;
+      *ret_len = len;
+      return 0;
+    }
+
+    ssize_t status = cu_tail_fill(obj, force_rewind);
+    if (status <= 0) {
+      *ret_line = NULL;
+      *ret_len = 0;
+      return (int)status;
+    }
+  }
+} /* int cu_tail_next */
+
 cu_tail_t *cu_tail_create(const char *file) {
   cu_tail_t *obj;
 
@@ -110,14 +317,27 @@ cu_tail_t *cu_tail_create(const char *file) {
     return NULL;
   }
 
-  obj->fh = NULL;
+  obj->fd = -1;
+
+#if KERNEL_LINUX
+  obj->inotify_wd = -1;
+  obj->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (obj->inotify_fd < 0)
+    P_WARNING("utils_tail: inotify_init1 failed: %s", STRERRNO);
+#endif
 
   return obj;
 } /* cu_tail_t *cu_tail_create */
 
 int cu_tail_destroy(cu_tail_t *obj) {
-  if (obj->fh != NULL)
-    fclose(obj->fh);
+  if (obj->fd >= 0)
+    close(obj->fd);
+#if KERNEL_LINUX
+  if (obj->inotify_fd >= 0)
+    close(obj->inotify_fd);
+#endif
+  free(obj->lines);
+  free(obj->buf);
   free(obj->file);
   free(obj);
 
@@ -125,64 +345,26 @@ int cu_tail_destroy(cu_tail_t *obj) {
 } /* int cu_tail_destroy */
 
 int cu_tail_readline(cu_tail_t *obj, char *buf, int buflen, bool force_rewind) {
-  int status;
+  char *line;
+  size_t len;
 
-  if (buflen < 1) {
+  if (buflen < 2) {
     ERROR("utils_tail: cu_tail_readline: buflen too small: %i bytes.", buflen);
     return -1;
   }
 
-  if (obj->fh == NULL) {
-    status = cu_tail_reopen(obj, force_rewind);
-    if (status < 0)
-      return status;
-  }
-  assert(obj->fh != NULL);
-
-  /* Try to read from the filehandle. If that succeeds, everything appears to
-   * be fine and we can return. */
-  clearerr(obj->fh);
-  if (fgets(buf, buflen, obj->fh) != NULL) {
-    buf[buflen - 1] = '\0';
-    return 0;
-  }
-
-  /* Check if we encountered an error */
-  if (ferror(obj->fh) != 0) {
-    /* Jupp, error. Force `cu_tail_reopen' to reopen the file.. */
-    fclose(obj->fh);
-    obj->fh = NULL;
-  }
-  /* else: eof -> check if the file was moved away and reopen the new file if
-   * so.. */
-
-  status = cu_tail_reopen(obj, force_rewind);
-  /* error -> return with error */
-  if (status < 0)
+  int status = cu_tail_next(obj, (size_t)buflen - 1, force_rewind, &line, &len);
+  if (status != 0)
     return status;
-  /* file end reached and file not reopened -> nothing more to read */
-  else if (status > 0) {
-    buf[0] = 0;
-    return 0;
-  }
 
-  /* If we get here: file was re-opened and there may be more to read.. Let's
-   * try again. */
-  if (fgets(buf, buflen, obj->fh) != NULL) {
-    buf[buflen - 1] = '\0';
+  /* EOF */
+  if (line == NULL) {
+    buf[0] = 0;
     return 0;
   }
 
-  if (ferror(obj->fh) != 0) {
-    WARNING("utils_tail: fgets (%s) returned an error: %s", obj->file,
-            STRERRNO);
-    fclose(obj->fh);
-    obj->fh = NULL;
-    return -1;
-  }
-
-  /* EOf, well, apparently the new file is empty.. */
-  buf[0] = 0;
+  memcpy(buf, line, len);
+  buf[len] = 0;
   return 0;
 } /* int cu_tail_readline */
 
@@ -190,29 +372,36 @@ int cu_tail_read(cu_tail_t *obj, char *buf, int buflen, tailfunc_t *callback,
                  void *data, bool force_rewind) {
   int status;
 
+  if (buflen < 2) {
+    ERROR("utils_tail: cu_tail_read: buflen too small: %i bytes.", buflen);
+    return -1;
+  }
+
   while (42) {
+    char *line;
     size_t len;
 
-    status = cu_tail_readline(obj, buf, buflen, force_rewind);
+    status = cu_tail_next(obj, (size_t)buflen - 1, force_rewind, &line, &len);
     if (status != 0) {
-      ERROR("utils_tail: cu_tail_read: cu_tail_readline "
-            "failed.");
+      ERROR("utils_tail: cu_tail_read: cu_tail_next failed.");
       break;
     }
 
     /* check for EOF */
-    if (buf[0] == 0)
+    if (line == NULL)
       break;
 
-    len = strlen(buf);
-    while (len > 0) {
-      if (buf[len - 1] != '\n')
-        break;
-      buf[len - 1] = '\0';
-      len--;
+    if (line[len - 1] == '\n') {
+      /* Complete lines are terminated in place of the newline. */
+      line[len - 1] = '\0';
+      status = callback(data, line, (int)len);
+    } else {
+      /* Chunk of an overlong line */
+      memcpy(buf, line, len);
+      buf[len] = '\0';
+      status = callback(data, buf, buflen);
     }
 
-    status = callback(data, buf, buflen);
     if (status != 0) {
       ERROR("utils_tail: cu_tail_read: callback returned "
             "status %i.",
@@ -223,3 +412,63 @@ int cu_tail_read(cu_tail_t *obj, char *buf, int buflen, tailfunc_t *callback,
 
   return status;
 } /* int cu_tail_read */
+
+int cu_tail_read_batch(cu_tail_t *obj, tailbatchfunc_t *callback, void *data,
+                       bool force_rewind) {
+  int status = 0;
+
+  while (42) {
+    ssize_t read_status = cu_tail_fill(obj, force_rewind);
+    if (read_status < 0) {
+      ERROR("utils_tail: cu_tail_read_batch: reading \"%s\" failed.",
+            obj->file);
+      return (int)read_status;
+    }
+
+    size_t lines_num = 0;
+    while (obj->buf_pos < obj->buf_len) {
+      char *line = obj->buf + obj->buf_pos;
+      size_t avail = obj->buf_len - obj->buf_pos;
+      char *newline = memchr(line, '\n', avail);
+
+      if (newline != NULL) {
+        *newline = '\0';
+        obj->buf_pos += (size_t)(newline - line) + 1;
+      } else if (avail + 1 >= obj->buf_size) {
+        /* The line fills the entire buffer; hand it out in pieces. The spare
+         * byte at the end of the buffer takes the terminating null byte. */
+        line[avail] = '\0';
+        obj->buf_pos = obj->buf_len;
+      } else {
+        /* Incomplete line; wait for the rest of it. */
+        break;
+      }
+
+      if (lines_num >= obj->lines_size) {
+        size_t new_size = (obj->lines_size == 0) ? 256 : 2 * obj->lines_size;
+        char **tmp = realloc(obj->lines, new_size * sizeof(*obj->lines));
+        if (tmp == NULL) {
+          ERROR("utils_tail: cu_tail_read_batch: realloc failed.");
+          return -1;
+        }
+        obj->lines = tmp;
+        obj->lines_size = new_size;
+      }
+      obj->lines[lines_num++] = line;
+    }
+
+    if (lines_num > 0) {
+      status = callback(data, obj->lines, lines_num);
+      if (status != 0) {
+        ERROR("utils_tail: cu_tail_read_batch: callback returned "
+              "status %i.",
+              status);
+        return status;
+      }
+    }
+
+    /* EOF */
+    if (read_status == 0)
+      return 0;
+  }
+} /* int cu_tail_read_batch */
@@ -36,6 +36,7 @@ struct cu_tail_s;
 typedef struct cu_tail_s cu_tail_t;
 
 typedef int tailfunc_t(void *data, char *buf, int buflen);
+typedef int tailbatchfunc_t(void *data, char **lines, size_t lines_num);
 
 /*
  * NAME
@@ -70,6 +71,8 @@ int cu_tail_destroy(cu_tail_t *obj);
  * You can check if the EOF condition is reached by looking at the buffer: If
  * the length of the string stored in the buffer is zero, EOF occurred.
  * Otherwise at least the newline character will be in the buffer.
+ * An incomplete last line is held back until its newline has been written or
+ * the file has been replaced.
  *
  * Returns 0 when successful and non-zero otherwise.
  */
@@ -85,4 +88,19 @@ int cu_tail_readline(cu_tail_t *obj, char *buf, int buflen, bool force_rewind);
 int cu_tail_read(cu_tail_t *obj, char *buf, int buflen, tailfunc_t *callback,
                  void *data, bool force_rewind);
 
+/*
+ * cu_tail_read_batch
+ *
+ * Reads from the file until eof condition or an error is encountered, like
+ * `cu_tail_read', but hands the lines to `callback' in batches of everything
+ * read with one read(2) call. The lines are null-terminated without their
+ * newline character and point into the internal buffer, so they are only
+ * valid during the callback. Lines longer than the internal buffer (64 KiB)
+ * are split.
+ *
+ * Returns 0 when successful and non-zero otherwise.
+ */
+int cu_tail_read_batch(cu_tail_t *obj, tailbatchfunc_t *callback, void *data,
+                       bool force_rewind);
+
 #endif /* UTILS_TAIL_H */
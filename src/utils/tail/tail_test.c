@@ -0,0 +1,216 @@
+/**
+ * collectd - src/utils/tail/tail_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+#include "utils/common/common.h"
+
+#include "testing.h"
+#include "utils/tail/tail.h"
+
+#define LARGE_LINES 10000
+
+static char tmp_dir[] = "/tmp/collectd-tail-test-XXXXXX";
+static char file[PATH_MAX];
+
+static void append(const char *data) {
+  FILE *fh = fopen(file, "a");
+  assert(fh != NULL);
+  fputs(data, fh);
+  fclose(fh);
+}
+
+typedef struct {
+  char lines[16][128];
+  size_t lines_num;
+  size_t bytes;
+} collect_t;
+
+static int collect_cb(void *data, char **lines, size_t lines_num) {
+  collect_t *c = data;
+
+  for (size_t i = 0; i < lines_num; i++) {
+    if (c->lines_num < STATIC_ARRAY_SIZE(c->lines))
+      sstrncpy(c->lines[c->lines_num], lines[i], sizeof(c->lines[0]));
+    c->lines_num++;
+    c->bytes += strlen(lines[i]) + 1;
+  }
+  return 0;
+}
+
+static int count_cb(void *data, char *buf, int __attribute__((unused)) len) {
+  collect_t *c = data;
+  c->lines_num++;
+  c->bytes += strlen(buf) + 1;
+  return 0;
+}
+
+DEF_TEST(read_batch) {
+  collect_t c = {0};
+
+  unlink(file);
+  append("one\ntwo\n");
+
+  cu_tail_t *t;
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+
+  /* Rewinding reads the existing content. */
+  CHECK_ZERO(cu_tail_read_batch(t, collect_cb, &c, true));
+  EXPECT_EQ_INT(2, (int)c.lines_num);
+  EXPECT_EQ_STR("one", c.lines[0]);
+  EXPECT_EQ_STR("two", c.lines[1]);
+
+  /* Incomplete lines are held back until the newline arrives. */
+  append("\nthr");
+  CHECK_ZERO(cu_tail_read_batch(t, collect_cb, &c, true));
+  EXPECT_EQ_INT(3, (int)c.lines_num);
+  EXPECT_EQ_STR("", c.lines[2]);
+
+  append("ee\n");
+  CHECK_ZERO(cu_tail_read_batch(t, collect_cb, &c, true));
+  EXPECT_EQ_INT(4, (int)c.lines_num);
+  EXPECT_EQ_STR("three", c.lines[3]);
+
+  /* Nothing new */
+  CHECK_ZERO(cu_tail_read_batch(t, collect_cb, &c, true));
+  EXPECT_EQ_INT(4, (int)c.lines_num);
+
+  cu_tail_destroy(t);
+  return 0;
+}
+
+DEF_TEST(readline) {
+  char buf[8];
+
+  unlink(file);
+  append("existing\n");
+
+  cu_tail_t *t;
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+
+  /* Without rewinding, reading starts at the end of the file. */
+  CHECK_ZERO(cu_tail_readline(t, buf, sizeof(buf), false));
+  EXPECT_EQ_STR("", buf);
+
+  /* Long lines are split like fgets(3) does. */
+  append("0123456789\nab\n");
+  CHECK_ZERO(cu_tail_readline(t, buf, sizeof(buf), false));
+  EXPECT_EQ_STR("0123456", buf);
+  CHECK_ZERO(cu_tail_readline(t, buf, sizeof(buf), false));
+  EXPECT_EQ_STR("789\n", buf);
+  CHECK_ZERO(cu_tail_readline(t, buf, sizeof(buf), false));
+  EXPECT_EQ_STR("ab\n", buf);
+  CHECK_ZERO(cu_tail_readline(t, buf, sizeof(buf), false));
+  EXPECT_EQ_STR("", buf);
+
+  cu_tail_destroy(t);
+  return 0;
+}
+
+DEF_TEST(rotate_and_truncate) {
+  char rotated[PATH_MAX];
+  collect_t c = {0};
+
+  ssnprintf(rotated, sizeof(rotated), "%s.1", file);
+  unlink(file);
+  append("old\n");
+
+  cu_tail_t *t;
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+  CHECK_ZERO(cu_tail_read_batch(t, collect_cb, &c, false));
+  EXPECT_EQ_INT(0, (int)c.lines_num);
+
+  /* The incomplete last line of the old file is flushed on rotation and the
+   * new file is read from the start. */
+  append("last");
+  CHECK_ZERO(cu_tail_read_batch(t, collect_cb, &c, false));
+  EXPECT_EQ_INT(0, (int)c.lines_num);
+  CHECK_ZERO(rename(file, rotated));
+  append("new\n");
+  CHECK_ZERO(cu_tail_read_batch(t, collect_cb, &c, false));
+  EXPECT_EQ_INT(2, (int)c.lines_num);
+  EXPECT_EQ_STR("last", c.lines[0]);
+  EXPECT_EQ_STR("new", c.lines[1]);
+
+  /* Truncation restarts at the beginning of the file. */
+  CHECK_ZERO(truncate(file, 0));
+  append("x\n");
+  CHECK_ZERO(cu_tail_read_batch(t, collect_cb, &c, false));
+  EXPECT_EQ_INT(3, (int)c.lines_num);
+  EXPECT_EQ_STR("x", c.lines[2]);
+
+  cu_tail_destroy(t);
+  unlink(rotated);
+  return 0;
+}
+
+/* A file much larger than the read buffers is read completely, and both
+ * interfaces see the same lines. */
+DEF_TEST(large_file) {
+  unlink(file);
+
+  FILE *fh = fopen(file, "w");
+  CHECK_NOT_NULL(fh);
+  size_t want_bytes = 0;
+  for (int i = 0; i < LARGE_LINES; i++)
+    want_bytes += (size_t)fprintf(
+        fh,
+        "192.0.2.%d - - [10/Oct/2000:13:55:36 -0700] \"GET /index/%d.html "
+        "HTTP/1.0\" 200 %d \"-\" \"Mozilla/5.0\"\n",
+        i % 256, i, i % 4096);
+  fclose(fh);
+
+  char buf[4096];
+  collect_t c = {0};
+  cu_tail_t *t;
+
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+  CHECK_ZERO(cu_tail_read(t, buf, sizeof(buf), count_cb, &c, true));
+  EXPECT_EQ_INT(LARGE_LINES, (int)c.lines_num);
+  EXPECT_EQ_UINT64(want_bytes, c.bytes);
+  cu_tail_destroy(t);
+
+  memset(&c, 0, sizeof(c));
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+  CHECK_ZERO(cu_tail_read_batch(t, collect_cb, &c, true));
+  EXPECT_EQ_INT(LARGE_LINES, (int)c.lines_num);
+  EXPECT_EQ_UINT64(want_bytes, c.bytes);
+  cu_tail_destroy(t);
+
+  return 0;
+}
+
+int main(void) {
+  if (mkdtemp(tmp_dir) == NULL) {
+    fprintf(stderr, "mkdtemp failed: %s\n", STRERRNO);
+    return 1;
+  }
+  ssnprintf(file, sizeof(file), "%s/test.log", tmp_dir);
+
+  RUN_TEST(read_batch);
+  RUN_TEST(readline);
+  RUN_TEST(rotate_and_truncate);
+  RUN_TEST(large_file);
+
+  unlink(file);
+  rmdir(tmp_dir);
+  END_TEST;
+}
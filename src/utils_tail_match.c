@@ -167,12 +167,14 @@ static int latency_submit_match(cu_match_t *match, void *user_data) {
   return 0;
 } /* int latency_submit_match */
 
-static int tail_callback(void *data, char *buf,
-                         int __attribute__((unused)) buflen) {
+static int tail_callback(void *data, char **lines, size_t lines_num) {
   cu_tail_match_t *obj = (cu_tail_match_t *)data;
 
-  for (size_t i = 0; i < obj->matches_num; i++)
-    match_apply(obj->matches[i].match, buf);
+  /* Lines are matched in order, all matches against one line before the next
+   * line, because callbacks such as the message parser depend on that. */
+  for (size_t i = 0; i < lines_num; i++)
+    for (size_t j = 0; j < obj->matches_num; j++)
+      match_apply(obj->matches[j].match, lines[i]);
 
   return 0;
 } /* int tail_callback */
@@ -307,13 +309,12 @@ out:
 } /* int tail_match_add_match_simple */
 
 int tail_match_read(cu_tail_match_t *obj, bool force_rewind) {
-  char buffer[4096];
   int status;
 
-  status = cu_tail_read(obj->tail, buffer, sizeof(buffer), tail_callback,
-                        (void *)obj, force_rewind);
+  status = cu_tail_read_batch(obj->tail, tail_callback, (void *)obj,
+                              force_rewind);
   if (status != 0) {
-    ERROR("tail_match: cu_tail_read failed.");
+    ERROR("tail_match: cu_tail_read_batch failed.");
     return status;
   }
 
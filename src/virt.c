@@ -23,6 +23,7 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/ignorelist/ignorelist.h"
 #include "utils_complain.h"
@@ -87,6 +88,10 @@
 #define HAVE_DOM_REASON_PAUSED_CRASHED 1
 #endif
 
+#if LIBVIR_CHECK_VERSION(1, 2, 8)
+#define HAVE_ALL_DOMAIN_STATS 1
+#endif
+
 #if LIBVIR_CHECK_VERSION(1, 2, 9)
 #define HAVE_JOB_STATS 1
 #endif
@@ -126,6 +131,7 @@ static bool persistent_notification = false;
 
 static bool report_block_devices = true;
 static bool report_network_interfaces = true;
+static bool bulk_stats;
 
 /* Thread used for handling libvirt notifications events */
 static virt_notif_thread_t notif_thread;
@@ -478,6 +484,10 @@ static ignorelist_t *il_interface_devices;
 
 static int ignore_device_match(ignorelist_t *, const char *domname,
                                const char *devpath);
+static bool is_domain_ignored(virDomainPtr dom);
+#ifdef HAVE_ALL_DOMAIN_STATS
+static void lv_bulk_clear(void);
+#endif
 
 /* Actual list of block devices found on last refresh. */
 struct block_device {
@@ -536,6 +546,8 @@ struct lv_read_instance {
   struct lv_read_state read_state;
   char tag[PARTITION_TAG_MAX_LEN];
   size_t id;
+  /* read cycle of the bulk statistics last dispatched by this instance */
+  unsigned int bulk_generation;
 };
 
 struct lv_user_data {
@@ -1451,6 +1463,18 @@ static int lv_config(oconfig_item_t *ci) {
       if (cf_util_get_boolean(c, &report_network_interfaces) != 0)
         return -1;
 
+      continue;
+    } else if (strcasecmp(c->key, "BulkStats") == 0) {
+      if (cf_util_get_boolean(c, &bulk_stats) != 0)
+        return -1;
+#ifndef HAVE_ALL_DOMAIN_STATS
+      if (bulk_stats) {
+        WARNING(PLUGIN_NAME " plugin: BulkStats requires libvirt 1.2.8 or "
+                            "newer and has been disabled.");
+        bulk_stats = false;
+      }
+#endif
+
       continue;
     } else {
       /* Unrecognised option. */
@@ -1504,6 +1528,10 @@ static int lv_connect(void) {
 }
 
 static void lv_disconnect(void) {
+#ifdef HAVE_ALL_DOMAIN_STATS
+  /* The bulk records hold references to the connection. */
+  lv_bulk_clear();
+#endif
   if (conn != NULL)
     virConnectClose(conn);
   conn = NULL;
@@ -2400,6 +2428,619 @@ static int persistent_domains_state_notification(void) {
   return status;
 }
 
+#ifdef HAVE_ALL_DOMAIN_STATS
+/*
+ * Bulk statistics {{{
+ *
+ * With "BulkStats" enabled, the statistics of all domains are fetched with a
+ * single virConnectGetAllDomainStats call per interval instead of several
+ * calls per domain and device. The first read instance to run in an
+ * interval fetches the records, parses the typed parameters into the flat
+ * arrays below and starts a new read cycle by incrementing "generation";
+ * every instance then dispatches its share of the domains once per cycle.
+ * The arrays are only ever grown, so they are reused between intervals.
+ */
+struct lv_bulk_block {
+  const char *name; /* target, e.g. "vda" */
+  const char *path; /* source */
+  long long rd_reqs, rd_bytes, rd_times;
+  long long wr_reqs, wr_bytes, wr_times;
+  long long fl_reqs, fl_times;
+  long long allocation, capacity, physical;
+};
+
+struct lv_bulk_net {
+  const char *name;
+  long long rx_bytes, rx_pkts, rx_errs, rx_drop;
+  long long tx_bytes, tx_pkts, tx_errs, tx_drop;
+};
+
+#define LV_BULK_BALLOON_NR 11
+
+struct lv_bulk_domain {
+  virDomainStatsRecordPtr record;
+  bool ignored;
+
+  int state;
+  int reason;
+
+  unsigned long long cpu_time;
+  unsigned long long cpu_time_prev;
+  unsigned long long cpu_user;
+  unsigned long long cpu_system;
+
+  long long balloon_current;
+  /* indexed like the tags in memory_stats_submit */
+  long long balloon[LV_BULK_BALLOON_NR];
+
+  size_t vcpu_idx, nr_vcpus;
+  size_t block_idx, nr_blocks;
+  size_t net_idx, nr_nets;
+};
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int readers;
+  /* set while an instance waits for the readers to fetch new statistics */
+  bool fetching;
+  /* incremented whenever new statistics have been fetched */
+  unsigned int generation;
+  cdtime_t fetch_time;
+
+  virDomainStatsRecordPtr *records;
+
+  struct lv_bulk_domain *domains;
+  size_t nr_domains, domains_size;
+  long long *vcpus;
+  size_t nr_vcpus, vcpus_size;
+  struct lv_bulk_block *blocks;
+  size_t nr_blocks, blocks_size;
+  struct lv_bulk_net *nets;
+  size_t nr_nets, nets_size;
+
+  /* domain name -> cpu time of the previous interval, for cpu_util */
+  c_avl_tree_t *cpu_time_prev;
+} lv_bulk = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* Makes sure "*array" can hold "num" elements of "size" bytes. */
+static int lv_bulk_reserve(void **array, size_t *array_size, size_t num,
+                           size_t size) {
+  if (num <= *array_size)
+    return 0;
+
+  size_t new_size = (*array_size == 0) ? 16 : *array_size;
+  while (new_size < num)
+    new_size *= 2;
+
+  void *tmp = realloc(*array, new_size * size);
+  if (tmp == NULL) {
+    ERROR(PLUGIN_NAME " plugin: realloc failed.");
+    return -1;
+  }
+
+  *array = tmp;
+  *array_size = new_size;
+  return 0;
+}
+
+static void lv_bulk_cpu_time_prev_free(c_avl_tree_t *tree) {
+  void *key;
+  void *value;
+
+  if (tree == NULL)
+    return;
+
+  while (c_avl_pick(tree, &key, &value) == 0) {
+    sfree(key);
+    sfree(value);
+  }
+  c_avl_destroy(tree);
+}
+
+/* Frees the records of the last fetch. Must be called with lv_bulk.lock held
+ * and no readers left. */
+static void lv_bulk_clear_locked(void) {
+  if (lv_bulk.records != NULL)
+    virDomainStatsRecordListFree(lv_bulk.records);
+  lv_bulk.records = NULL;
+  lv_bulk.nr_domains = 0;
+  lv_bulk.nr_vcpus = 0;
+  lv_bulk.nr_blocks = 0;
+  lv_bulk.nr_nets = 0;
+}
+
+static void lv_bulk_clear(void) {
+  pthread_mutex_lock(&lv_bulk.lock);
+  while ((lv_bulk.readers > 0) || lv_bulk.fetching)
+    pthread_cond_wait(&lv_bulk.cond, &lv_bulk.lock);
+  lv_bulk_clear_locked();
+  pthread_mutex_unlock(&lv_bulk.lock);
+}
+
+/* Splits a field such as "block.3.rd.reqs" into the index (3) and the
+ * remainder ("rd.reqs"). Returns NULL if the field doesn't start with
+ * "prefix" followed by an index. */
+static const char *lv_bulk_indexed_field(const char *field,
+                                         const char *prefix, size_t *index) {
+  size_t prefix_len = strlen(prefix);
+
+  if (strncmp(field, prefix, prefix_len) != 0)
+    return NULL;
+
+  char *endptr = NULL;
+  errno = 0;
+  unsigned long idx = strtoul(field + prefix_len, &endptr, 10);
+  if ((errno != 0) || (endptr == field + prefix_len) || (*endptr != '.'))
+    return NULL;
+
+  *index = (size_t)idx;
+  return endptr + 1;
+}
+
+static long long lv_bulk_param_ll(const virTypedParameter *param) {
+  switch (param->type) {
+  case VIR_TYPED_PARAM_INT:
+    return param->value.i;
+  case VIR_TYPED_PARAM_UINT:
+    return param->value.ui;
+  case VIR_TYPED_PARAM_LLONG:
+    return param->value.l;
+  case VIR_TYPED_PARAM_ULLONG:
+    return (long long)param->value.ul;
+  default:
+    return -1;
+  }
+}
+
+static void lv_bulk_parse_block(struct lv_bulk_block *b, const char *field,
+                                const virTypedParameter *param) {
+  if (strcmp(field, "name") == 0 && param->type == VIR_TYPED_PARAM_STRING)
+    b->name = param->value.s;
+  else if (strcmp(field, "path") == 0 && param->type == VIR_TYPED_PARAM_STRING)
+    b->path = param->value.s;
+  else if (strcmp(field, "rd.reqs") == 0)
+    b->rd_reqs = lv_bulk_param_ll(param);
+  else if (strcmp(field, "rd.bytes") == 0)
+    b->rd_bytes = lv_bulk_param_ll(param);
+  else if (strcmp(field, "rd.times") == 0)
+    b->rd_times = lv_bulk_param_ll(param);
+  else if (strcmp(field, "wr.reqs") == 0)
+    b->wr_reqs = lv_bulk_param_ll(param);
+  else if (strcmp(field, "wr.bytes") == 0)
+    b->wr_bytes = lv_bulk_param_ll(param);
+  else if (strcmp(field, "wr.times") == 0)
+    b->wr_times = lv_bulk_param_ll(param);
+  else if (strcmp(field, "fl.reqs") == 0)
+    b->fl_reqs = lv_bulk_param_ll(param);
+  else if (strcmp(field, "fl.times") == 0)
+    b->fl_times = lv_bulk_param_ll(param);
+  else if (strcmp(field, "allocation") == 0)
+    b->allocation = lv_bulk_param_ll(param);
+  else if (strcmp(field, "capacity") == 0)
+    b->capacity = lv_bulk_param_ll(param);
+  else if (strcmp(field, "physical") == 0)
+    b->physical = lv_bulk_param_ll(param);
+}
+
+static void lv_bulk_parse_net(struct lv_bulk_net *n, const char *field,
+                              const virTypedParameter *param) {
+  if (strcmp(field, "name") == 0 && param->type == VIR_TYPED_PARAM_STRING)
+    n->name = param->value.s;
+  else if (strcmp(field, "rx.bytes") == 0)
+    n->rx_bytes = lv_bulk_param_ll(param);
+  else if (strcmp(field, "rx.pkts") == 0)
+    n->rx_pkts = lv_bulk_param_ll(param);
+  else if (strcmp(field, "rx.errs") == 0)
+    n->rx_errs = lv_bulk_param_ll(param);
+  else if (strcmp(field, "rx.drop") == 0)
+    n->rx_drop = lv_bulk_param_ll(param);
+  else if (strcmp(field, "tx.bytes") == 0)
+    n->tx_bytes = lv_bulk_param_ll(param);
+  else if (strcmp(field, "tx.pkts") == 0)
+    n->tx_pkts = lv_bulk_param_ll(param);
+  else if (strcmp(field, "tx.errs") == 0)
+    n->tx_errs = lv_bulk_param_ll(param);
+  else if (strcmp(field, "tx.drop") == 0)
+    n->tx_drop = lv_bulk_param_ll(param);
+}
+
+static void lv_bulk_parse_balloon(struct lv_bulk_domain *d, const char *field,
+                                  const virTypedParameter *param) {
+  static const char *tags[LV_BULK_BALLOON_NR] = {
+      "swap_in", "swap_out", "major_fault", "minor_fault",
+      "unused",  "available", "current",    "rss",
+      "usable",  "last-update", "disk_caches"};
+
+  for (size_t i = 0; i < LV_BULK_BALLOON_NR; i++) {
+    if (strcmp(field, tags[i]) == 0) {
+      d->balloon[i] = lv_bulk_param_ll(param);
+      break;
+    }
+  }
+
+  if (strcmp(field, "current") == 0)
+    d->balloon_current = lv_bulk_param_ll(param);
+}
+
+/* Parses one record into lv_bulk.domains[lv_bulk.nr_domains]. */
+static int lv_bulk_parse_record(virDomainStatsRecordPtr record) {
+  size_t nr_vcpus = 0, nr_blocks = 0, nr_nets = 0;
+
+  /* First pass: sizes of the indexed groups. */
+  for (int i = 0; i < record->nparams; i++) {
+    const virTypedParameter *param = record->params + i;
+
+    if (strcmp(param->field, "vcpu.current") == 0)
+      nr_vcpus = (size_t)lv_bulk_param_ll(param);
+    else if (strcmp(param->field, "block.count") == 0)
+      nr_blocks = (size_t)lv_bulk_param_ll(param);
+    else if (strcmp(param->field, "net.count") == 0)
+      nr_nets = (size_t)lv_bulk_param_ll(param);
+  }
+
+  if ((lv_bulk_reserve((void **)&lv_bulk.domains, &lv_bulk.domains_size,
+                       lv_bulk.nr_domains + 1,
+                       sizeof(*lv_bulk.domains)) != 0) ||
+      (lv_bulk_reserve((void **)&lv_bulk.vcpus, &lv_bulk.vcpus_size,
+                       lv_bulk.nr_vcpus + nr_vcpus,
+                       sizeof(*lv_bulk.vcpus)) != 0) ||
+      (lv_bulk_reserve((void **)&lv_bulk.blocks, &lv_bulk.blocks_size,
+                       lv_bulk.nr_blocks + nr_blocks,
+                       sizeof(*lv_bulk.blocks)) != 0) ||
+      (lv_bulk_reserve((void **)&lv_bulk.nets, &lv_bulk.nets_size,
+                       lv_bulk.nr_nets + nr_nets, sizeof(*lv_bulk.nets)) != 0))
+    return -1;
+
+  struct lv_bulk_domain *d = lv_bulk.domains + lv_bulk.nr_domains;
+  memset(d, 0, sizeof(*d));
+  d->record = record;
+  d->ignored = is_domain_ignored(record->dom);
+  d->balloon_current = -1;
+  for (size_t i = 0; i < LV_BULK_BALLOON_NR; i++)
+    d->balloon[i] = -1;
+
+  d->vcpu_idx = lv_bulk.nr_vcpus;
+  d->nr_vcpus = nr_vcpus;
+  for (size_t i = 0; i < nr_vcpus; i++)
+    lv_bulk.vcpus[d->vcpu_idx + i] = -1;
+
+  d->block_idx = lv_bulk.nr_blocks;
+  d->nr_blocks = nr_blocks;
+  for (size_t i = 0; i < nr_blocks; i++) {
+    struct lv_bulk_block *b = lv_bulk.blocks + d->block_idx + i;
+    *b = (struct lv_bulk_block){
+        .rd_reqs = -1,
+        .rd_bytes = -1,
+        .rd_times = -1,
+        .wr_reqs = -1,
+        .wr_bytes = -1,
+        .wr_times = -1,
+        .fl_reqs = -1,
+        .fl_times = -1,
+        .allocation = -1,
+        .capacity = -1,
+        .physical = -1,
+    };
+  }
+
+  d->net_idx = lv_bulk.nr_nets;
+  d->nr_nets = nr_nets;
+  for (size_t i = 0; i < nr_nets; i++) {
+    struct lv_bulk_net *n = lv_bulk.nets + d->net_idx + i;
+    *n = (struct lv_bulk_net){
+        .rx_bytes = -1,
+        .rx_pkts = -1,
+        .rx_errs = -1,
+        .rx_drop = -1,
+        .tx_bytes = -1,
+        .tx_pkts = -1,
+        .tx_errs = -1,
+        .tx_drop = -1,
+    };
+  }
+
+  /* Second pass: values. */
+  for (int i = 0; i < record->nparams; i++) {
+    const virTypedParameter *param = record->params + i;
+    const char *field = param->field;
+    const char *sub;
+    size_t idx;
+
+    if (strcmp(field, "state.state") == 0)
+      d->state = (int)lv_bulk_param_ll(param);
+    else if (strcmp(field, "state.reason") == 0)
+      d->reason = (int)lv_bulk_param_ll(param);
+    else if (strcmp(field, "cpu.time") == 0)
+      d->cpu_time = param->value.ul;
+    else if (strcmp(field, "cpu.user") == 0)
+      d->cpu_user = param->value.ul;
+    else if (strcmp(field, "cpu.system") == 0)
+      d->cpu_system = param->value.ul;
+    else if (strncmp(field, "balloon.", strlen("balloon.")) == 0)
+      lv_bulk_parse_balloon(d, field + strlen("balloon."), param);
+    else if ((sub = lv_bulk_indexed_field(field, "vcpu.", &idx)) != NULL) {
+      if ((idx < nr_vcpus) && (strcmp(sub, "time") == 0))
+        lv_bulk.vcpus[d->vcpu_idx + idx] = lv_bulk_param_ll(param);
+    } else if ((sub = lv_bulk_indexed_field(field, "block.", &idx)) != NULL) {
+      if (idx < nr_blocks)
+        lv_bulk_parse_block(lv_bulk.blocks + d->block_idx + idx, sub, param);
+    } else if ((sub = lv_bulk_indexed_field(field, "net.", &idx)) != NULL) {
+      if (idx < nr_nets)
+        lv_bulk_parse_net(lv_bulk.nets + d->net_idx + idx, sub, param);
+    }
+  }
+
+  lv_bulk.nr_domains++;
+  lv_bulk.nr_vcpus += nr_vcpus;
+  lv_bulk.nr_blocks += nr_blocks;
+  lv_bulk.nr_nets += nr_nets;
+  return 0;
+}
+
+/* Remembers the cpu time of each domain for the next interval's cpu_util. */
+static void lv_bulk_update_cpu_time_prev(void) {
+  c_avl_tree_t *prev = lv_bulk.cpu_time_prev;
+  c_avl_tree_t *next =
+      c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (next == NULL)
+    return;
+
+  for (size_t i = 0; i < lv_bulk.nr_domains; i++) {
+    struct lv_bulk_domain *d = lv_bulk.domains + i;
+    const char *name = virDomainGetName(d->record->dom);
+    unsigned long long *value = NULL;
+
+    if (name == NULL)
+      continue;
+
+    if ((prev != NULL) && (c_avl_get(prev, name, (void *)&value) == 0))
+      d->cpu_time_prev = *value;
+
+    char *key = strdup(name);
+    value = malloc(sizeof(*value));
+    if ((key == NULL) || (value == NULL)) {
+      sfree(key);
+      sfree(value);
+      continue;
+    }
+    *value = d->cpu_time;
+    if (c_avl_insert(next, key, value) != 0) {
+      sfree(key);
+      sfree(value);
+    }
+  }
+
+  lv_bulk_cpu_time_prev_free(prev);
+  lv_bulk.cpu_time_prev = next;
+}
+
+/* Fetches and parses the statistics of all domains. Must be called with
+ * lv_bulk.lock held and no readers left. */
+static int lv_bulk_fetch_locked(void) {
+  unsigned int stats = VIR_DOMAIN_STATS_STATE | VIR_DOMAIN_STATS_CPU_TOTAL |
+                       VIR_DOMAIN_STATS_BALLOON | VIR_DOMAIN_STATS_VCPU;
+
+  if (report_block_devices)
+    stats |= VIR_DOMAIN_STATS_BLOCK;
+  if (report_network_interfaces)
+    stats |= VIR_DOMAIN_STATS_INTERFACE;
+#ifdef HAVE_PERF_STATS
+  if (extra_stats & ex_stats_perf)
+    stats |= VIR_DOMAIN_STATS_PERF;
+#endif
+
+  lv_bulk_clear_locked();
+
+  int n = virConnectGetAllDomainStats(conn, stats, &lv_bulk.records, 0);
+  if (n < 0) {
+    VIRT_ERROR(conn, "getting the statistics of all domains");
+    lv_bulk.records = NULL;
+    return -1;
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (lv_bulk_parse_record(lv_bulk.records[i]) != 0) {
+      lv_bulk_clear_locked();
+      return -1;
+    }
+  }
+
+  if (extra_stats & ex_stats_cpu_util)
+    lv_bulk_update_cpu_time_prev();
+
+  lv_bulk.generation++;
+  lv_bulk.fetch_time = cdtime();
+  return 0;
+}
+
+static void lv_bulk_submit_domain(struct lv_bulk_domain *d) {
+  virDomainPtr dom = d->record->dom;
+  const char *domname = virDomainGetName(dom);
+  int status;
+
+  if (extra_stats & ex_stats_domain_state) {
+    value_t values[] = {
+        {.gauge = (gauge_t)d->state},
+        {.gauge = (gauge_t)d->reason},
+    };
+    submit(dom, "domain_state", NULL, values, STATIC_ARRAY_SIZE(values));
+  }
+
+  /* Gather remaining stats only for running domains */
+  if (d->state != VIR_DOMAIN_RUNNING)
+    return;
+
+  if ((extra_stats & ex_stats_pcpu) && (d->cpu_user > 0 || d->cpu_system > 0))
+    submit_derive2("ps_cputime", d->cpu_user, d->cpu_system, dom, NULL);
+
+  domain_t domain = {.ptr = dom, .info.cpuTime = d->cpu_time_prev};
+  cpu_submit(&domain, d->cpu_time);
+
+  if (d->balloon_current >= 0)
+    memory_submit(dom, (gauge_t)d->balloon_current * 1024);
+
+  /* The vcpu pinning is not part of the bulk statistics. */
+  if (extra_stats & ex_stats_vcpupin)
+    GET_STATS(get_vcpu_stats, "vcpu stats", dom, d->nr_vcpus);
+  else if (extra_stats & ex_stats_vcpu)
+    for (size_t i = 0; i < d->nr_vcpus; i++)
+      if (lv_bulk.vcpus[d->vcpu_idx + i] >= 0)
+        vcpu_submit(lv_bulk.vcpus[d->vcpu_idx + i], dom, (int)i, "virt_vcpu");
+
+  if (extra_stats & ex_stats_memory) {
+    /* swap_in, swap_out, major_fault, minor_fault */
+    long long *b = d->balloon;
+    if (b[0] > 0 || b[1] > 0) {
+      submit(dom, "swap_io", "in", &(value_t){.gauge = b[0]}, 1);
+      submit(dom, "swap_io", "out", &(value_t){.gauge = b[1]}, 1);
+    }
+    if (b[3] > 0 || b[2] > 0) {
+      value_t values[] = {
+          {.gauge = (gauge_t)b[3]},
+          {.gauge = (gauge_t)b[2]},
+      };
+      submit(dom, "ps_pagefaults", NULL, values, STATIC_ARRAY_SIZE(values));
+    }
+    /* 'last_update' is a timestamp and not reported */
+    for (int i = 4; i < LV_BULK_BALLOON_NR; i++)
+      if ((i != 9) && (b[i] >= 0))
+        memory_stats_submit((gauge_t)b[i] * 1024, dom, i);
+  }
+
+#ifdef HAVE_PERF_STATS
+  if (extra_stats & ex_stats_perf) {
+    for (int i = 0; i < d->record->nparams; i++) {
+      virTypedParameterPtr param = d->record->params + i;
+      if (strncmp(param->field, "perf.", strlen("perf.")) != 0)
+        continue;
+      /* Same naming as perf_submit(), without modifying the shared record */
+      char type_instance[DATA_MAX_NAME_LEN];
+      ssnprintf(type_instance, sizeof(type_instance), "perf_%s",
+                param->field + strlen("perf."));
+      submit(dom, "perf", type_instance,
+             &(value_t){.derive = param->value.ul}, 1);
+    }
+  }
+#endif
+
+#ifdef HAVE_FS_INFO
+  if (extra_stats & ex_stats_fs_info)
+    GET_STATS(get_fs_info, "file system info", dom);
+#endif
+
+#ifdef HAVE_DISK_ERR
+  if (extra_stats & ex_stats_disk_err)
+    GET_STATS(get_disk_err, "disk errors", dom);
+#endif
+
+#ifdef HAVE_JOB_STATS
+  if (extra_stats &
+      (ex_stats_job_stats_completed | ex_stats_job_stats_background))
+    GET_STATS(get_job_stats, "job stats", dom);
+#endif
+
+  for (size_t i = 0; i < d->nr_blocks; i++) {
+    struct lv_bulk_block *b = lv_bulk.blocks + d->block_idx + i;
+    const char *dev = (blockdevice_format == source) ? b->path : b->name;
+
+    if ((dev == NULL) || ignore_device_match(il_block_devices, domname, dev))
+      continue;
+
+    struct lv_block_stats bstats;
+    init_block_stats(&bstats);
+    bstats.bi.rd_req = b->rd_reqs;
+    bstats.bi.rd_bytes = b->rd_bytes;
+    bstats.bi.wr_req = b->wr_reqs;
+    bstats.bi.wr_bytes = b->wr_bytes;
+    bstats.rd_total_times = b->rd_times;
+    bstats.wr_total_times = b->wr_times;
+    bstats.fl_req = b->fl_reqs;
+    bstats.fl_total_times = b->fl_times;
+
+    virDomainBlockInfo binfo;
+    init_block_info(&binfo);
+    binfo.allocation = b->allocation;
+    binfo.capacity = b->capacity;
+    binfo.physical = b->physical;
+
+    disk_block_stats_submit(&bstats, dom, dev, &binfo);
+  }
+
+  for (size_t i = 0; i < d->nr_nets; i++) {
+    struct lv_bulk_net *n = lv_bulk.nets + d->net_idx + i;
+
+    /* Only the interface name is part of the bulk statistics. */
+    if ((n->name == NULL) ||
+        ignore_device_match(il_interface_devices, domname, n->name))
+      continue;
+
+    if ((n->rx_bytes != -1) && (n->tx_bytes != -1))
+      submit_derive2("if_octets", (derive_t)n->rx_bytes,
+                     (derive_t)n->tx_bytes, dom, n->name);
+    if ((n->rx_pkts != -1) && (n->tx_pkts != -1))
+      submit_derive2("if_packets", (derive_t)n->rx_pkts, (derive_t)n->tx_pkts,
+                     dom, n->name);
+    if ((n->rx_errs != -1) && (n->tx_errs != -1))
+      submit_derive2("if_errors", (derive_t)n->rx_errs, (derive_t)n->tx_errs,
+                     dom, n->name);
+    if ((n->rx_drop != -1) && (n->tx_drop != -1))
+      submit_derive2("if_dropped", (derive_t)n->rx_drop, (derive_t)n->tx_drop,
+                     dom, n->name);
+  }
+}
+
+/* Returns true if the statistics have already been submitted by "inst" or
+ * were fetched in a previous interval. Must be called with lv_bulk.lock
+ * held. */
+static bool lv_bulk_stale_locked(struct lv_read_instance *inst) {
+  if ((lv_bulk.records == NULL) ||
+      (inst->bulk_generation == lv_bulk.generation))
+    return true;
+  return (cdtime() - lv_bulk.fetch_time) >= (plugin_get_interval() / 2);
+}
+
+static int lv_read_bulk(struct lv_read_instance *inst) {
+  pthread_mutex_lock(&lv_bulk.lock);
+  while (lv_bulk.fetching)
+    pthread_cond_wait(&lv_bulk.cond, &lv_bulk.lock);
+
+  /* Whichever instance runs first in an interval fetches for everybody, so
+   * that a failing or suspended instance doesn't hold up the others. */
+  if (lv_bulk_stale_locked(inst)) {
+    lv_bulk.fetching = true;
+    while (lv_bulk.readers > 0)
+      pthread_cond_wait(&lv_bulk.cond, &lv_bulk.lock);
+
+    int status = lv_bulk_fetch_locked();
+    lv_bulk.fetching = false;
+    pthread_cond_broadcast(&lv_bulk.cond);
+    if (status != 0) {
+      pthread_mutex_unlock(&lv_bulk.lock);
+      return -1;
+    }
+  }
+  inst->bulk_generation = lv_bulk.generation;
+  lv_bulk.readers++;
+  pthread_mutex_unlock(&lv_bulk.lock);
+
+  for (size_t i = inst->id; i < lv_bulk.nr_domains; i += (size_t)nr_instances)
+    if (!lv_bulk.domains[i].ignored)
+      lv_bulk_submit_domain(lv_bulk.domains + i);
+
+  pthread_mutex_lock(&lv_bulk.lock);
+  lv_bulk.readers--;
+  pthread_cond_broadcast(&lv_bulk.cond);
+  pthread_mutex_unlock(&lv_bulk.lock);
+
+  return 0;
+}
+/* }}} */
+#endif /* HAVE_ALL_DOMAIN_STATS */
+
 static int lv_read(user_data_t *ud) {
   if (ud->data == NULL) {
     ERROR(PLUGIN_NAME " plugin: NULL userdata");
@@ -2438,9 +3079,11 @@ static int lv_read(user_data_t *ud) {
   time_t t;
   time(&t);
 
-  /* Need to refresh domain or device lists? */
-  if ((last_refresh == (time_t)0) ||
-      ((interval > 0) && ((last_refresh + interval) <= t))) {
+  /* Need to refresh domain or device lists? With "BulkStats" the domains are
+   * enumerated by virConnectGetAllDomainStats instead. */
+  if (!bulk_stats &&
+      ((last_refresh == (time_t)0) ||
+       ((interval > 0) && ((last_refresh + interval) <= t)))) {
     if (refresh_lists(inst) != 0) {
       if (inst->id == 0) {
         if (!persistent_notification)
@@ -2461,6 +3104,11 @@ static int lv_read(user_data_t *ud) {
             status);
   }
 
+#ifdef HAVE_ALL_DOMAIN_STATS
+  if (bulk_stats)
+    return lv_read_bulk(inst);
+#endif
+
 #if COLLECT_DEBUG
   for (int i = 0; i < state->nr_domains; ++i)
     DEBUG(PLUGIN_NAME " plugin: domain %s",
@@ -3150,6 +3798,17 @@ static int lv_shutdown(void) {
 
   lv_disconnect();
 
+#ifdef HAVE_ALL_DOMAIN_STATS
+  sfree(lv_bulk.domains);
+  sfree(lv_bulk.vcpus);
+  sfree(lv_bulk.blocks);
+  sfree(lv_bulk.nets);
+  lv_bulk.domains_size = lv_bulk.vcpus_size = 0;
+  lv_bulk.blocks_size = lv_bulk.nets_size = 0;
+  lv_bulk_cpu_time_prev_free(lv_bulk.cpu_time_prev);
+  lv_bulk.cpu_time_prev = NULL;
+#endif
+
   ignorelist_free(il_domains);
   il_domains = NULL;
   ignorelist_free(il_block_devices);
@@ -3162,6 +3821,6 @@ static int lv_shutdown(void) {
 
 void module_register(void) {
   plugin_register_complex_config("virt", lv_config);
-  plugin_register_init(PLUGIN_NAME, lv_init);
+  plugin_register_independent_init(PLUGIN_NAME, lv_init);
   plugin_register_shutdown(PLUGIN_NAME, lv_shutdown);
 }
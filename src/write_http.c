@@ -27,12 +27,17 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/curl_engine/curl_engine.h"
 #include "utils/curl_stats/curl_stats.h"
 #include "utils/format_json/format_json.h"
 #include "utils/format_kairosdb/format_kairosdb.h"
 
 #include <curl/curl.h>
 
+#if HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
 #ifndef WRITE_HTTP_DEFAULT_BUFFER_SIZE
 #define WRITE_HTTP_DEFAULT_BUFFER_SIZE 4096
 #endif
@@ -41,9 +46,46 @@
 #define WRITE_HTTP_DEFAULT_PREFIX "collectd"
 #endif
 
+/* Delay before the first retry of a failed request. Doubled for every
+ * further retry. */
+#ifndef WRITE_HTTP_RETRY_DELAY
+#define WRITE_HTTP_RETRY_DELAY TIME_T_TO_CDTIME_T(1)
+#endif
+
 /*
  * Private variables
  */
+struct wh_callback_s;
+
+/* A request slot. Each node has MaxConcurrentRequests of these, each with its
+ * own cURL handle and body, so that that many POST requests can be in flight
+ * while the writers keep filling send_buffer. */
+struct wh_request_s {
+  struct wh_callback_s *cb;
+
+  CURL *curl;
+  char curl_errbuf[CURL_ERROR_SIZE];
+
+#define WH_REQUEST_IDLE 0
+#define WH_REQUEST_BUSY 1
+#define WH_REQUEST_RETRY 2
+  int state;
+  int retries;
+  cdtime_t retry_time;
+
+  char *data;
+  size_t data_size;
+  size_t data_len;
+
+#if HAVE_ZLIB_H
+  z_stream zstream;
+  bool zstream_init;
+  char *gzip;
+  size_t gzip_size;
+#endif
+};
+typedef struct wh_request_s wh_request_t;
+
 struct wh_callback_s {
   char *name;
 
@@ -65,6 +107,11 @@ struct wh_callback_s {
   time_t low_speed_time;
   int timeout;
 
+#define WH_COMPRESSION_NONE 0
+#define WH_COMPRESSION_GZIP 1
+  int compression;
+  int retry_count;
+
 #define WH_FORMAT_COMMAND 0
 #define WH_FORMAT_JSON 1
 #define WH_FORMAT_KAIROSDB 2
@@ -72,10 +119,10 @@ struct wh_callback_s {
   bool send_metrics;
   bool send_notifications;
 
-  CURL *curl;
+  wh_request_t *requests;
+  size_t requests_num;
   curl_stats_t *curl_stats;
   struct curl_slist *headers;
-  char curl_errbuf[CURL_ERROR_SIZE];
 
   char *send_buffer;
   size_t send_buffer_size;
@@ -84,6 +131,8 @@ struct wh_callback_s {
   cdtime_t send_buffer_init_time;
 
   pthread_mutex_t send_lock;
+  /* Signaled whenever a request slot becomes available. */
+  pthread_cond_t send_cond;
 
   int data_ttl;
   char *metrics_prefix;
@@ -93,14 +142,10 @@ typedef struct wh_callback_s wh_callback_t;
 static char **http_attrs;
 static size_t http_attrs_num;
 
-static void wh_log_http_error(wh_callback_t *cb) {
+static void wh_log_http_error(wh_callback_t *cb, long http_code) {
   if (!cb->log_http_error)
     return;
 
-  long http_code = 0;
-
-  curl_easy_getinfo(cb->curl, CURLINFO_RESPONSE_CODE, &http_code);
-
   if (http_code != 200)
     INFO("write_http plugin: HTTP Error code: %lu", http_code);
 }
@@ -121,19 +166,107 @@ static void wh_reset_buffer(wh_callback_t *cb) /* {{{ */
   }
 } /* }}} wh_reset_buffer */
 
+#if HAVE_ZLIB_H
+/* Compresses the request body into r->gzip. */
+static int wh_request_compress(wh_request_t *r) /* {{{ */
+{
+  int status;
+
+  if (!r->zstream_init) {
+    /* windowBits 15 + 16 selects the gzip format. */
+    status = deflateInit2(&r->zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                          15 + 16, /* memLevel = */ 8, Z_DEFAULT_STRATEGY);
+    if (status != Z_OK) {
+      ERROR("write_http plugin: deflateInit2 failed with status %i.", status);
+      return -1;
+    }
+    r->zstream_init = true;
+  } else {
+    deflateReset(&r->zstream);
+  }
+
+  size_t bound = (size_t)deflateBound(&r->zstream, (uLong)r->data_len);
+  if (r->gzip_size < bound) {
+    char *tmp = realloc(r->gzip, bound);
+    if (tmp == NULL) {
+      ERROR("write_http plugin: realloc(%" PRIsz ") failed.", bound);
+      return -1;
+    }
+    r->gzip = tmp;
+    r->gzip_size = bound;
+  }
+
+  r->zstream.next_in = (Bytef *)r->data;
+  r->zstream.avail_in = (uInt)r->data_len;
+  r->zstream.next_out = (Bytef *)r->gzip;
+  r->zstream.avail_out = (uInt)r->gzip_size;
+
+  status = deflate(&r->zstream, Z_FINISH);
+  if (status != Z_STREAM_END) {
+    ERROR("write_http plugin: deflate failed with status %i.", status);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int wh_request_compress */
+#endif
+
+/* Sets the request body from r->data, compressing it if configured. */
+static int wh_request_prepare(wh_request_t *r) /* {{{ */
+{
+  char const *body = r->data;
+  size_t body_len = r->data_len;
+
+#if HAVE_ZLIB_H
+  if (r->cb->compression == WH_COMPRESSION_GZIP) {
+    if (wh_request_compress(r) != 0)
+      return -1;
+    body = r->gzip;
+    body_len = (size_t)r->zstream.total_out;
+  }
+#endif
+
+  curl_easy_setopt(r->curl, CURLOPT_POSTFIELDSIZE, (long)body_len);
+  curl_easy_setopt(r->curl, CURLOPT_POSTFIELDS, body);
+  r->retries = 0;
+  return 0;
+} /* }}} int wh_request_prepare */
+
+static void wh_request_done(CURL *curl, CURLcode status, void *user_data);
+
 /* must hold cb->send_lock when calling */
-static int wh_post_nolock(wh_callback_t *cb, char const *data) /* {{{ */
+static int wh_request_submit_nolock(wh_request_t *r) /* {{{ */
 {
-  int status = 0;
+  r->state = WH_REQUEST_BUSY;
 
-  curl_easy_setopt(cb->curl, CURLOPT_URL, cb->location);
-  curl_easy_setopt(cb->curl, CURLOPT_POSTFIELDS, data);
-  status = curl_easy_perform(cb->curl);
+  int status = curl_engine_submit(r->curl, wh_request_done, r);
+  if (status != 0) {
+    ERROR("write_http plugin: Submitting the request failed: %s",
+          STRERROR(status));
+    r->state = WH_REQUEST_IDLE;
+    pthread_cond_broadcast(&r->cb->send_cond);
+    return -1;
+  }
 
-  wh_log_http_error(cb);
+  return 0;
+} /* }}} int wh_request_submit_nolock */
+
+/* Called by the curl engine when a POST request has finished. Failed
+ * requests are retried up to RetryCount times; until then the slot, and with
+ * it the data, is kept. */
+static void wh_request_done(CURL *curl, CURLcode status, /* {{{ */
+                            void *user_data) {
+  wh_request_t *r = user_data;
+  wh_callback_t *cb = r->cb;
+  long http_code = 0;
+
+  pthread_mutex_lock(&cb->send_lock);
+
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+  wh_log_http_error(cb, http_code);
 
   if (cb->curl_stats != NULL) {
-    int rc = curl_stats_dispatch(cb->curl_stats, cb->curl, NULL, "write_http",
+    int rc = curl_stats_dispatch(cb->curl_stats, curl, NULL, "write_http",
                                  cb->name);
     if (rc != 0) {
       ERROR("write_http plugin: curl_stats_dispatch failed with "
@@ -145,36 +278,211 @@ static int wh_post_nolock(wh_callback_t *cb, char const *data) /* {{{ */
   if (status != CURLE_OK) {
     ERROR("write_http plugin: curl_easy_perform failed with "
           "status %i: %s",
-          status, cb->curl_errbuf);
+          status, r->curl_errbuf);
   }
-  return status;
-} /* }}} wh_post_nolock */
 
-static int wh_callback_init(wh_callback_t *cb) /* {{{ */
+  /* Server errors are assumed to be temporary, client errors are not. */
+  bool failed = (status != CURLE_OK) || (http_code >= 500) ||
+                (http_code == 429);
+  if (failed && (r->retries < cb->retry_count)) {
+    r->state = WH_REQUEST_RETRY;
+    int shift = (r->retries < 10) ? r->retries : 10;
+    r->retry_time = cdtime() + (WRITE_HTTP_RETRY_DELAY << shift);
+    r->retries++;
+  } else {
+    if (failed && (cb->retry_count > 0))
+      ERROR("write_http plugin: Giving up on a request to \"%s\" after %d "
+            "retries. %" PRIsz " bytes of data have been lost.",
+            cb->location, r->retries, r->data_len);
+    r->state = WH_REQUEST_IDLE;
+  }
+
+  pthread_cond_broadcast(&cb->send_cond);
+  pthread_mutex_unlock(&cb->send_lock);
+} /* }}} void wh_request_done */
+
+/* Resubmits failed requests which are due for a retry, or all of them if
+ * "force" is true.
+ * must hold cb->send_lock when calling */
+static void wh_retry_nolock(wh_callback_t *cb, bool force) /* {{{ */
 {
-  if (cb->curl != NULL)
-    return 0;
+  cdtime_t now = 0;
+
+  for (size_t i = 0; i < cb->requests_num; i++) {
+    wh_request_t *r = cb->requests + i;
+    if (r->state != WH_REQUEST_RETRY)
+      continue;
+
+    if (!force) {
+      if (now == 0)
+        now = cdtime();
+      if (r->retry_time > now)
+        continue;
+    }
+
+    wh_request_submit_nolock(r);
+  }
+} /* }}} void wh_retry_nolock */
+
+/* Returns an idle request slot. Blocks while all requests are in flight. If
+ * all slots hold data waiting to be retried, the oldest data is dropped so
+ * that memory usage stays bounded.
+ * must hold cb->send_lock when calling */
+static wh_request_t *wh_request_get_nolock(wh_callback_t *cb) /* {{{ */
+{
+  while (1) {
+    wh_request_t *retry = NULL;
+
+    wh_retry_nolock(cb, /* force = */ false);
+
+    for (size_t i = 0; i < cb->requests_num; i++) {
+      wh_request_t *r = cb->requests + i;
+      if (r->state == WH_REQUEST_IDLE)
+        return r;
+      if ((r->state == WH_REQUEST_RETRY) &&
+          ((retry == NULL) || (r->retry_time < retry->retry_time)))
+        retry = r;
+    }
+
+    if (retry != NULL) {
+      WARNING("write_http plugin: All requests to \"%s\" are waiting to be "
+              "retried. Dropping %" PRIsz " bytes of data.",
+              cb->location, retry->data_len);
+      retry->state = WH_REQUEST_IDLE;
+      return retry;
+    }
+
+    pthread_cond_wait(&cb->send_cond, &cb->send_lock);
+  }
+} /* }}} wh_request_t *wh_request_get_nolock */
+
+/* Waits until all requests have finished, retrying failed requests
+ * immediately.
+ * must hold cb->send_lock when calling */
+static void wh_wait_nolock(wh_callback_t *cb) /* {{{ */
+{
+  while (1) {
+    bool busy = false;
+
+    wh_retry_nolock(cb, /* force = */ true);
+    for (size_t i = 0; i < cb->requests_num; i++)
+      if (cb->requests[i].state != WH_REQUEST_IDLE)
+        busy = true;
+
+    if (!busy)
+      return;
+    pthread_cond_wait(&cb->send_cond, &cb->send_lock);
+  }
+} /* }}} void wh_wait_nolock */
+
+/* Posts the data in send_buffer. The buffer is exchanged with the idle
+ * request's buffer, so the data is not copied. The caller has to reset the
+ * send buffer afterwards.
+ * must hold cb->send_lock when calling */
+static int wh_send_buffer_nolock(wh_callback_t *cb) /* {{{ */
+{
+  wh_request_t *r = wh_request_get_nolock(cb);
+
+  char *tmp = r->data;
+  r->data = cb->send_buffer;
+  r->data_size = cb->send_buffer_size;
+  r->data_len = cb->send_buffer_fill;
+  cb->send_buffer = tmp;
+
+  if (wh_request_prepare(r) != 0)
+    return -1;
 
-  cb->curl = curl_easy_init();
-  if (cb->curl == NULL) {
+  return wh_request_submit_nolock(r);
+} /* }}} int wh_send_buffer_nolock */
+
+/* must hold cb->send_lock when calling */
+static int wh_post_nolock(wh_callback_t *cb, char const *data) /* {{{ */
+{
+  wh_request_t *r = wh_request_get_nolock(cb);
+  size_t data_len = strlen(data);
+
+  if (r->data_size < data_len + 1) {
+    char *tmp = realloc(r->data, data_len + 1);
+    if (tmp == NULL) {
+      ERROR("write_http plugin: realloc(%" PRIsz ") failed.", data_len + 1);
+      return -1;
+    }
+    r->data = tmp;
+    r->data_size = data_len + 1;
+  }
+  memcpy(r->data, data, data_len + 1);
+  r->data_len = data_len;
+
+  if (wh_request_prepare(r) != 0)
+    return -1;
+
+  return wh_request_submit_nolock(r);
+} /* }}} wh_post_nolock */
+
+static int wh_curl_init(wh_callback_t *cb, wh_request_t *r) /* {{{ */
+{
+  r->curl = curl_easy_init();
+  if (r->curl == NULL) {
     ERROR("curl plugin: curl_easy_init failed.");
     return -1;
   }
 
   if (cb->low_speed_limit > 0 && cb->low_speed_time > 0) {
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_LIMIT,
+    curl_easy_setopt(r->curl, CURLOPT_LOW_SPEED_LIMIT,
                      (long)(cb->low_speed_limit * cb->low_speed_time));
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_TIME,
+    curl_easy_setopt(r->curl, CURLOPT_LOW_SPEED_TIME,
                      (long)cb->low_speed_time);
   }
 
 #ifdef HAVE_CURLOPT_TIMEOUT_MS
   if (cb->timeout > 0)
-    curl_easy_setopt(cb->curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
+    curl_easy_setopt(r->curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
+#endif
+
+  curl_easy_setopt(r->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(r->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
+  curl_easy_setopt(r->curl, CURLOPT_URL, cb->location);
+  curl_easy_setopt(r->curl, CURLOPT_POST, 1L);
+  curl_easy_setopt(r->curl, CURLOPT_HTTPHEADER, cb->headers);
+
+  curl_easy_setopt(r->curl, CURLOPT_ERRORBUFFER, r->curl_errbuf);
+  curl_easy_setopt(r->curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(r->curl, CURLOPT_MAXREDIRS, 50L);
+
+  if (cb->user != NULL) {
+#ifdef HAVE_CURLOPT_USERNAME
+    curl_easy_setopt(r->curl, CURLOPT_USERNAME, cb->user);
+    curl_easy_setopt(r->curl, CURLOPT_PASSWORD,
+                     (cb->pass == NULL) ? "" : cb->pass);
+#else
+    curl_easy_setopt(r->curl, CURLOPT_USERPWD, cb->credentials);
 #endif
+    curl_easy_setopt(r->curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
+  }
+
+  curl_easy_setopt(r->curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
+  curl_easy_setopt(r->curl, CURLOPT_SSL_VERIFYHOST, cb->verify_host ? 2L : 0L);
+  curl_easy_setopt(r->curl, CURLOPT_SSLVERSION, cb->sslversion);
+  if (cb->cacert != NULL)
+    curl_easy_setopt(r->curl, CURLOPT_CAINFO, cb->cacert);
+  if (cb->capath != NULL)
+    curl_easy_setopt(r->curl, CURLOPT_CAPATH, cb->capath);
 
-  curl_easy_setopt(cb->curl, CURLOPT_NOSIGNAL, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
+  if (cb->clientkey != NULL && cb->clientcert != NULL) {
+    curl_easy_setopt(r->curl, CURLOPT_SSLKEY, cb->clientkey);
+    curl_easy_setopt(r->curl, CURLOPT_SSLCERT, cb->clientcert);
+
+    if (cb->clientkeypass != NULL)
+      curl_easy_setopt(r->curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+  }
+
+  return 0;
+} /* }}} int wh_curl_init */
+
+static int wh_callback_init(wh_callback_t *cb) /* {{{ */
+{
+  if (cb->requests != NULL)
+    return 0;
 
   cb->headers = curl_slist_append(cb->headers, "Accept:  */*");
   if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB)
@@ -182,19 +490,12 @@ static int wh_callback_init(wh_callback_t *cb) /* {{{ */
         curl_slist_append(cb->headers, "Content-Type: application/json");
   else
     cb->headers = curl_slist_append(cb->headers, "Content-Type: text/plain");
+  if (cb->compression == WH_COMPRESSION_GZIP)
+    cb->headers = curl_slist_append(cb->headers, "Content-Encoding: gzip");
   cb->headers = curl_slist_append(cb->headers, "Expect:");
-  curl_easy_setopt(cb->curl, CURLOPT_HTTPHEADER, cb->headers);
-
-  curl_easy_setopt(cb->curl, CURLOPT_ERRORBUFFER, cb->curl_errbuf);
-  curl_easy_setopt(cb->curl, CURLOPT_FOLLOWLOCATION, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_MAXREDIRS, 50L);
 
-  if (cb->user != NULL) {
-#ifdef HAVE_CURLOPT_USERNAME
-    curl_easy_setopt(cb->curl, CURLOPT_USERNAME, cb->user);
-    curl_easy_setopt(cb->curl, CURLOPT_PASSWORD,
-                     (cb->pass == NULL) ? "" : cb->pass);
-#else
+#ifndef HAVE_CURLOPT_USERNAME
+  if ((cb->user != NULL) && (cb->credentials == NULL)) {
     size_t credentials_size;
 
     credentials_size = strlen(cb->user) + 2;
@@ -209,26 +510,33 @@ static int wh_callback_init(wh_callback_t *cb) /* {{{ */
 
     snprintf(cb->credentials, credentials_size, "%s:%s", cb->user,
              (cb->pass == NULL) ? "" : cb->pass);
-    curl_easy_setopt(cb->curl, CURLOPT_USERPWD, cb->credentials);
-#endif
-    curl_easy_setopt(cb->curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
   }
+#endif
 
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYHOST, cb->verify_host ? 2L : 0L);
-  curl_easy_setopt(cb->curl, CURLOPT_SSLVERSION, cb->sslversion);
-  if (cb->cacert != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAINFO, cb->cacert);
-  if (cb->capath != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAPATH, cb->capath);
-
-  if (cb->clientkey != NULL && cb->clientcert != NULL) {
-    curl_easy_setopt(cb->curl, CURLOPT_SSLKEY, cb->clientkey);
-    curl_easy_setopt(cb->curl, CURLOPT_SSLCERT, cb->clientcert);
+  wh_request_t *requests = calloc(cb->requests_num, sizeof(*requests));
+  if (requests == NULL) {
+    ERROR("write_http plugin: calloc failed.");
+    return -1;
+  }
 
-    if (cb->clientkeypass != NULL)
-      curl_easy_setopt(cb->curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+  for (size_t i = 0; i < cb->requests_num; i++) {
+    wh_request_t *r = requests + i;
+
+    r->cb = cb;
+    r->data = malloc(cb->send_buffer_size);
+    r->data_size = cb->send_buffer_size;
+    if ((r->data == NULL) || (wh_curl_init(cb, r) != 0)) {
+      ERROR("write_http plugin: Initializing request %" PRIsz " failed.", i);
+      for (size_t j = 0; j <= i; j++) {
+        if (requests[j].curl != NULL)
+          curl_easy_cleanup(requests[j].curl);
+        sfree(requests[j].data);
+      }
+      sfree(requests);
+      return -1;
+    }
   }
+  cb->requests = requests;
 
   wh_reset_buffer(cb);
 
@@ -243,6 +551,8 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
         "send_buffer_fill = %" PRIsz ";",
         CDTIME_T_TO_DOUBLE(timeout), cb->send_buffer_fill);
 
+  wh_retry_nolock(cb, /* force = */ false);
+
   /* timeout == 0  => flush unconditionally */
   if (timeout > 0) {
     cdtime_t now;
@@ -258,7 +568,7 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
       return 0;
     }
 
-    status = wh_post_nolock(cb, cb->send_buffer);
+    status = wh_send_buffer_nolock(cb);
     wh_reset_buffer(cb);
   } else if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB) {
     if (cb->send_buffer_fill <= 2) {
@@ -275,7 +585,7 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
       return status;
     }
 
-    status = wh_post_nolock(cb, cb->send_buffer);
+    status = wh_send_buffer_nolock(cb);
     wh_reset_buffer(cb);
   } else {
     ERROR("write_http: wh_flush_nolock: "
@@ -307,6 +617,11 @@ static int wh_flush(cdtime_t timeout, /* {{{ */
   }
 
   status = wh_flush_nolock(timeout, cb);
+
+  /* An unconditional flush returns once the data has been posted, e.g. so
+   * that no data is lost on shutdown. */
+  if (timeout == 0)
+    wh_wait_nolock(cb);
   pthread_mutex_unlock(&cb->send_lock);
 
   return status;
@@ -321,12 +636,26 @@ static void wh_callback_free(void *data) /* {{{ */
 
   cb = data;
 
-  if (cb->send_buffer != NULL)
-    wh_flush_nolock(/* timeout = */ 0, cb);
+  if (cb->requests != NULL) {
+    pthread_mutex_lock(&cb->send_lock);
+    if (cb->send_buffer != NULL)
+      wh_flush_nolock(/* timeout = */ 0, cb);
+    wh_wait_nolock(cb);
+    pthread_mutex_unlock(&cb->send_lock);
+
+    for (size_t i = 0; i < cb->requests_num; i++) {
+      wh_request_t *r = cb->requests + i;
 
-  if (cb->curl != NULL) {
-    curl_easy_cleanup(cb->curl);
-    cb->curl = NULL;
+      curl_engine_cancel(r->curl);
+      curl_easy_cleanup(r->curl);
+      sfree(r->data);
+#if HAVE_ZLIB_H
+      if (r->zstream_init)
+        deflateEnd(&r->zstream);
+      sfree(r->gzip);
+#endif
+    }
+    sfree(cb->requests);
   }
 
   curl_stats_destroy(cb->curl_stats);
@@ -485,7 +814,7 @@ static int wh_write_kairosdb(const data_set_t *ds,
 
   pthread_mutex_lock(&cb->send_lock);
 
-  if (cb->curl == NULL) {
+  if (cb->requests == NULL) {
     status = wh_callback_init(cb);
     if (status != 0) {
       ERROR("write_http plugin: wh_callback_init failed.");
@@ -609,6 +938,32 @@ static int config_set_format(wh_callback_t *cb, /* {{{ */
   return 0;
 } /* }}} int config_set_format */
 
+static int config_set_compression(wh_callback_t *cb, /* {{{ */
+                                  oconfig_item_t *ci) {
+  char *string;
+
+  if ((ci->values_num != 1) || (ci->values[0].type != OCONFIG_TYPE_STRING)) {
+    WARNING("write_http plugin: The `%s' config option "
+            "needs exactly one string argument.",
+            ci->key);
+    return -1;
+  }
+
+  string = ci->values[0].value.string;
+  if (strcasecmp("None", string) == 0)
+    cb->compression = WH_COMPRESSION_NONE;
+#if HAVE_ZLIB_H
+  else if (strcasecmp("Gzip", string) == 0)
+    cb->compression = WH_COMPRESSION_GZIP;
+#endif
+  else {
+    ERROR("write_http plugin: Invalid or unsupported compression: %s", string);
+    return -1;
+  }
+
+  return 0;
+} /* }}} int config_set_compression */
+
 static int wh_config_append_string(const char *name,
                                    struct curl_slist **dest, /* {{{ */
                                    oconfig_item_t *ci) {
@@ -631,6 +986,7 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
 {
   wh_callback_t *cb;
   int buffer_size = 0;
+  int max_requests = 1;
   char callback_name[DATA_MAX_NAME_LEN];
   int status = 0;
 
@@ -660,6 +1016,7 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   }
 
   pthread_mutex_init(&cb->send_lock, /* attr = */ NULL);
+  pthread_cond_init(&cb->send_cond, /* attr = */ NULL);
 
   cf_util_get_string(ci, &cb->name);
 
@@ -736,6 +1093,12 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_boolean(child, &cb->store_rates);
     else if (strcasecmp("BufferSize", child->key) == 0)
       status = cf_util_get_int(child, &buffer_size);
+    else if (strcasecmp("MaxConcurrentRequests", child->key) == 0)
+      status = cf_util_get_int(child, &max_requests);
+    else if (strcasecmp("Compression", child->key) == 0)
+      status = config_set_compression(cb, child);
+    else if (strcasecmp("RetryCount", child->key) == 0)
+      status = cf_util_get_int(child, &cb->retry_count);
     else if (strcasecmp("LowSpeedLimit", child->key) == 0)
       status = cf_util_get_int(child, &cb->low_speed_limit);
     else if (strcasecmp("Timeout", child->key) == 0)
@@ -819,6 +1182,20 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
     ERROR("write_http plugin: Ignoring invalid BufferSize setting (%d).",
           buffer_size);
 
+  if (max_requests < 1) {
+    ERROR("write_http plugin: Ignoring invalid MaxConcurrentRequests "
+          "setting (%d).",
+          max_requests);
+    max_requests = 1;
+  }
+  cb->requests_num = (size_t)max_requests;
+
+  if (cb->retry_count < 0) {
+    ERROR("write_http plugin: Ignoring invalid RetryCount setting (%d).",
+          cb->retry_count);
+    cb->retry_count = 0;
+  }
+
   /* Allocate the buffer. */
   cb->send_buffer = malloc(cb->send_buffer_size);
   if (cb->send_buffer == NULL) {
@@ -884,8 +1261,15 @@ static int wh_init(void) /* {{{ */
   return 0;
 } /* }}} int wh_init */
 
+static int wh_shutdown(void) /* {{{ */
+{
+  curl_engine_shutdown();
+  return 0;
+} /* }}} int wh_shutdown */
+
 void module_register(void) /* {{{ */
 {
   plugin_register_complex_config("write_http", wh_config);
   plugin_register_init("write_http", wh_init);
+  plugin_register_shutdown("write_http", wh_shutdown);
 } /* }}} void module_register */
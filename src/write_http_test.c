@@ -0,0 +1,402 @@
+/**
+ * collectd - src/write_http_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "write_http.c" /* sic */
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define DELAY_MS 100
+
+/* A stand-in for an HTTP server: every connection is served by its own
+ * thread. While "hold" is set, POST requests are received but not answered;
+ * "waiting" is the number of such requests. Each request is answered with
+ * "503 Service Unavailable" while "failures" is positive and with
+ * "204 No Content" otherwise. The bytes received, after decompression, are
+ * counted. */
+typedef struct {
+  int listen_fd;
+  int port;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool hold;
+  int waiting;
+  int failures;
+  int requests;
+  int gzip_requests;
+  size_t bytes;
+} server_t;
+
+static server_t srv;
+
+static size_t server_body_len(char const *body, size_t len, bool gzip) {
+  if (!gzip)
+    return len;
+
+#if HAVE_ZLIB_H
+  char buffer[65536];
+  z_stream zs = {
+      .next_in = (Bytef *)body,
+      .avail_in = (uInt)len,
+      .next_out = (Bytef *)buffer,
+      .avail_out = sizeof(buffer),
+  };
+  inflateInit2(&zs, 15 + 16);
+  int status = inflate(&zs, Z_FINISH);
+  inflateEnd(&zs);
+  return (status == Z_STREAM_END) ? (size_t)zs.total_out : 0;
+#else
+  return 0;
+#endif
+}
+
+static void *server_connection(void *arg) {
+  int fd = (int)(intptr_t)arg;
+  char buffer[65536];
+  size_t len = 0;
+
+  while (1) {
+    char *end;
+    buffer[len] = 0;
+    while ((end = strstr(buffer, "\r\n\r\n")) == NULL) {
+      ssize_t n = read(fd, buffer + len, sizeof(buffer) - len - 1);
+      if (n <= 0) {
+        close(fd);
+        return NULL;
+      }
+      len += (size_t)n;
+      buffer[len] = 0;
+    }
+
+    size_t header_len = (size_t)(end - buffer) + 4;
+    size_t content_len = 0;
+    char *cl = strstr(buffer, "Content-Length:");
+    if ((cl != NULL) && (cl < end))
+      content_len = (size_t)strtoul(cl + strlen("Content-Length:"), NULL, 10);
+    char *ce = strstr(buffer, "Content-Encoding: gzip");
+    bool gzip = (ce != NULL) && (ce < end);
+
+    while (len < header_len + content_len) {
+      ssize_t n = read(fd, buffer + len, sizeof(buffer) - len - 1);
+      if (n <= 0) {
+        close(fd);
+        return NULL;
+      }
+      len += (size_t)n;
+    }
+
+    pthread_mutex_lock(&srv.lock);
+    srv.waiting++;
+    pthread_cond_broadcast(&srv.cond);
+    while (srv.hold)
+      pthread_cond_wait(&srv.cond, &srv.lock);
+    srv.waiting--;
+
+    bool fail = (srv.failures > 0);
+    if (fail)
+      srv.failures--;
+    srv.requests++;
+    if (!fail) {
+      srv.bytes += server_body_len(buffer + header_len, content_len, gzip);
+      if (gzip)
+        srv.gzip_requests++;
+    }
+    pthread_mutex_unlock(&srv.lock);
+
+    char const *response =
+        fail ? "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n"
+             : "HTTP/1.1 204 No Content\r\n\r\n";
+    if (write(fd, response, strlen(response)) != (ssize_t)strlen(response)) {
+      close(fd);
+      return NULL;
+    }
+
+    memmove(buffer, buffer + header_len + content_len,
+            len - header_len - content_len);
+    len -= header_len + content_len;
+  }
+}
+
+static void *server_thread(void __attribute__((unused)) * arg) {
+  while (1) {
+    int fd = accept(srv.listen_fd, NULL, NULL);
+    if (fd < 0)
+      return NULL;
+
+    pthread_t t;
+    pthread_create(&t, NULL, server_connection, (void *)(intptr_t)fd);
+    pthread_detach(t);
+  }
+}
+
+static int server_start(void) {
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t sa_len = sizeof(sa);
+
+  srv.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if ((srv.listen_fd < 0) ||
+      (bind(srv.listen_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (listen(srv.listen_fd, 16) != 0) ||
+      (getsockname(srv.listen_fd, (struct sockaddr *)&sa, &sa_len) != 0))
+    return -1;
+  srv.port = ntohs(sa.sin_port);
+
+  pthread_mutex_init(&srv.lock, NULL);
+  pthread_cond_init(&srv.cond, NULL);
+  pthread_t t;
+  return pthread_create(&t, NULL, server_thread, NULL);
+}
+
+static void server_hold(bool hold) {
+  pthread_mutex_lock(&srv.lock);
+  srv.hold = hold;
+  pthread_cond_broadcast(&srv.cond);
+  pthread_mutex_unlock(&srv.lock);
+}
+
+/* Waits until "num" requests are held by the server. */
+static void server_wait(int num) {
+  pthread_mutex_lock(&srv.lock);
+  while (srv.waiting < num)
+    pthread_cond_wait(&srv.cond, &srv.lock);
+  pthread_mutex_unlock(&srv.lock);
+}
+
+/* Resets the server's counters and returns the number of requests. */
+static int server_reset(size_t *bytes, int *gzip_requests) {
+  pthread_mutex_lock(&srv.lock);
+  int requests = srv.requests;
+  if (bytes != NULL)
+    *bytes = srv.bytes;
+  if (gzip_requests != NULL)
+    *gzip_requests = srv.gzip_requests;
+  srv.requests = 0;
+  srv.gzip_requests = 0;
+  srv.bytes = 0;
+  srv.failures = 0;
+  pthread_mutex_unlock(&srv.lock);
+  return requests;
+}
+
+static wh_callback_t *node_create(int max_requests, int compression,
+                                  int retry_count) {
+  wh_callback_t *cb = calloc(1, sizeof(*cb));
+  if (cb == NULL)
+    return NULL;
+
+  char url[256];
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d/", srv.port);
+
+  cb->name = strdup("test");
+  cb->location = strdup(url);
+  cb->format = WH_FORMAT_COMMAND;
+  cb->sslversion = CURL_SSLVERSION_DEFAULT;
+  cb->send_metrics = true;
+  cb->compression = compression;
+  cb->retry_count = retry_count;
+  cb->requests_num = (size_t)max_requests;
+  pthread_mutex_init(&cb->send_lock, NULL);
+  pthread_cond_init(&cb->send_cond, NULL);
+
+  cb->send_buffer_size = 1024;
+  cb->send_buffer = malloc(cb->send_buffer_size);
+  wh_reset_buffer(cb);
+  return cb;
+}
+
+/* Writes value lists until "num" requests have been started, and returns the
+ * number of bytes written. */
+static size_t write_requests(wh_callback_t *cb, int num) {
+  data_source_t dsrc = {"value", DS_TYPE_GAUGE, 0, NAN};
+  data_set_t ds = {"gauge", 1, &dsrc};
+  value_t v = {.gauge = 42.0};
+  value_list_t vl = {
+      .values = &v,
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(1),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "gauge",
+  };
+  size_t bytes = 0;
+
+  for (int i = 0; i < num; i++) {
+    /* Ten value lists of about 55 bytes each fit into the buffer. */
+    for (int j = 0; j < 10; j++) {
+      ssnprintf(vl.type_instance, sizeof(vl.type_instance), "%d", j);
+      if (wh_write_command(&ds, &vl, cb) != 0)
+        return 0;
+    }
+    bytes += cb->send_buffer_fill;
+    pthread_mutex_lock(&cb->send_lock);
+    int status = wh_flush_nolock(/* timeout = */ 0, cb);
+    pthread_mutex_unlock(&cb->send_lock);
+    if (status != 0)
+      return 0;
+  }
+
+  return bytes;
+}
+
+static int busy_requests(wh_callback_t *cb) {
+  int busy = 0;
+  pthread_mutex_lock(&cb->send_lock);
+  for (size_t i = 0; i < cb->requests_num; i++)
+    busy += (cb->requests[i].state == WH_REQUEST_BUSY);
+  pthread_mutex_unlock(&cb->send_lock);
+  return busy;
+}
+
+typedef struct {
+  wh_callback_t *cb;
+  size_t bytes;
+  bool done;
+} writer_t;
+
+static void *writer_thread(void *arg) {
+  writer_t *w = arg;
+  size_t bytes = write_requests(w->cb, 1);
+
+  pthread_mutex_lock(&w->cb->send_lock);
+  w->bytes = bytes;
+  w->done = true;
+  pthread_mutex_unlock(&w->cb->send_lock);
+  return NULL;
+}
+
+DEF_TEST(concurrent) {
+  wh_callback_t *cb = node_create(4, WH_COMPRESSION_NONE, 0);
+  CHECK_NOT_NULL(cb);
+  user_data_t ud = {.data = cb};
+
+  /* Until the first response, the engine waits to find out whether the
+   * connection supports multiplexing before opening more. */
+  size_t bytes = write_requests(cb, 1);
+  CHECK_ZERO(wh_flush(0, NULL, &ud));
+
+  /* Four requests are in flight at once; writing does not wait for the
+   * server to answer them. */
+  server_hold(true);
+  bytes += write_requests(cb, 4);
+  server_wait(4);
+  EXPECT_EQ_INT(4, busy_requests(cb));
+
+  /* The fifth request waits for a free slot. */
+  writer_t w = {.cb = cb};
+  pthread_t t;
+  CHECK_ZERO(pthread_create(&t, NULL, writer_thread, &w));
+  usleep(DELAY_MS * 1000);
+  pthread_mutex_lock(&cb->send_lock);
+  OK(!w.done);
+  pthread_mutex_unlock(&cb->send_lock);
+
+  server_hold(false);
+  CHECK_ZERO(pthread_join(t, NULL));
+  OK(w.done);
+  bytes += w.bytes;
+
+  /* An unconditional flush waits for all requests to finish. */
+  CHECK_ZERO(wh_flush(0, NULL, &ud));
+  EXPECT_EQ_INT(0, busy_requests(cb));
+
+  size_t received = 0;
+  EXPECT_EQ_INT(6, server_reset(&received, NULL));
+  EXPECT_EQ_UINT64(bytes, received);
+
+  wh_callback_free(cb);
+  return 0;
+}
+
+DEF_TEST(retry) {
+  wh_callback_t *cb = node_create(2, WH_COMPRESSION_NONE, 2);
+  CHECK_NOT_NULL(cb);
+  user_data_t ud = {.data = cb};
+
+  /* Two failures are retried. */
+  srv.failures = 2;
+  size_t bytes = write_requests(cb, 1);
+  CHECK_ZERO(wh_flush(0, NULL, &ud));
+  size_t received = 0;
+  EXPECT_EQ_INT(3, server_reset(&received, NULL));
+  EXPECT_EQ_UINT64(bytes, received);
+
+  /* After RetryCount retries, the data is dropped. */
+  srv.failures = 3;
+  write_requests(cb, 1);
+  CHECK_ZERO(wh_flush(0, NULL, &ud));
+  EXPECT_EQ_INT(3, server_reset(&received, NULL));
+  EXPECT_EQ_UINT64(0, received);
+
+  /* Failed requests wait for their retry without blocking writers. If all
+   * slots are waiting, the oldest data is dropped. */
+  srv.failures = 2;
+  write_requests(cb, 2);
+  pthread_mutex_lock(&cb->send_lock);
+  while ((cb->requests[0].state == WH_REQUEST_BUSY) ||
+         (cb->requests[1].state == WH_REQUEST_BUSY))
+    pthread_cond_wait(&cb->send_cond, &cb->send_lock);
+  pthread_mutex_unlock(&cb->send_lock);
+  bytes = write_requests(cb, 1);
+  CHECK_ZERO(wh_flush(0, NULL, &ud));
+  EXPECT_EQ_INT(4, server_reset(&received, NULL));
+  EXPECT_EQ_UINT64(2 * bytes, received);
+
+  wh_callback_free(cb);
+  return 0;
+}
+
+#if HAVE_ZLIB_H
+DEF_TEST(gzip) {
+  wh_callback_t *cb = node_create(1, WH_COMPRESSION_GZIP, 0);
+  CHECK_NOT_NULL(cb);
+
+  size_t bytes = write_requests(cb, 3);
+  wh_callback_free(cb);
+
+  size_t received = 0;
+  int gzip_requests = 0;
+  EXPECT_EQ_INT(3, server_reset(&received, &gzip_requests));
+  EXPECT_EQ_INT(3, gzip_requests);
+  EXPECT_EQ_UINT64(bytes, received);
+
+  return 0;
+}
+#endif
+
+int main(void) {
+  CHECK_ZERO(server_start());
+  curl_global_init(CURL_GLOBAL_SSL);
+
+  RUN_TEST(concurrent);
+  RUN_TEST(retry);
+#if HAVE_ZLIB_H
+  RUN_TEST(gzip);
+#endif
+
+  wh_shutdown();
+  END_TEST;
+}
@@ -37,6 +37,12 @@
 #include <librdkafka/rdkafka.h>
 #include <stdint.h>
 
+/* 31 bit -> 4 byte -> 8 byte hex string + null byte */
+#define KAFKA_RANDOM_KEY_SIZE 9
+
+/* Space reserved for formatting one value list. */
+#define KAFKA_VALUE_LIST_SIZE 8192
+
 struct kafka_topic_context {
 #define KAFKA_FORMAT_JSON 0
 #define KAFKA_FORMAT_COMMAND 1
@@ -54,6 +60,26 @@ struct kafka_topic_context {
   char escape_char;
   char *topic_name;
   pthread_mutex_t lock;
+
+  /* Batching: up to "batch_size" value lists are formatted directly into
+   * "batch_buf", which is handed over to librdkafka with RD_KAFKA_MSG_F_FREE
+   * once complete. Complete messages are collected in "msgs" and produced
+   * with a single call to rd_kafka_produce_batch(). */
+  size_t batch_size;
+  cdtime_t batch_timeout;
+  char *batch_buf;
+  size_t batch_fill;
+  size_t batch_free;
+  size_t batch_num;
+  size_t batch_hint;
+  cdtime_t batch_first;
+#define KAFKA_BATCH_MESSAGES 16
+  rd_kafka_message_t msgs[KAFKA_BATCH_MESSAGES];
+  char msg_keys[KAFKA_BATCH_MESSAGES][KAFKA_RANDOM_KEY_SIZE];
+  int msgs_num;
+
+  bool report_stats;
+  uint64_t dropped;
 };
 
 static int kafka_handle(struct kafka_topic_context *);
@@ -92,8 +118,6 @@ static uint32_t kafka_hash(const char *keydata, size_t keylen) {
   return hash;
 }
 
-/* 31 bit -> 4 byte -> 8 byte hex string + null byte */
-#define KAFKA_RANDOM_KEY_SIZE 9
 #define KAFKA_RANDOM_KEY_BUFFER                                                \
   (char[KAFKA_RANDOM_KEY_SIZE]) { "" }
 static char *kafka_random_key(char buffer[static KAFKA_RANDOM_KEY_SIZE]) {
@@ -170,6 +194,225 @@ static int kafka_handle(struct kafka_topic_context *ctx) /* {{{ */
 
 } /* }}} int kafka_handle */
 
+/* Produces all complete messages.
+ * NOTE: You must hold ctx->lock when calling this function! */
+static void kafka_produce_msgs(struct kafka_topic_context *ctx) /* {{{ */
+{
+  int produced;
+
+  if (ctx->msgs_num == 0)
+    return;
+
+  produced = rd_kafka_produce_batch(ctx->topic, RD_KAFKA_PARTITION_UA,
+                                    RD_KAFKA_MSG_F_FREE, ctx->msgs,
+                                    ctx->msgs_num);
+
+  if (produced != ctx->msgs_num) {
+    /* librdkafka only takes ownership of the payloads it accepted. */
+    for (int i = 0; i < ctx->msgs_num; i++) {
+      if (ctx->msgs[i].err == RD_KAFKA_RESP_ERR_NO_ERROR)
+        continue;
+      ERROR("write_kafka plugin: Producing message to topic \"%s\" failed: "
+            "%s",
+            ctx->topic_name, rd_kafka_err2str(ctx->msgs[i].err));
+      sfree(ctx->msgs[i].payload);
+      ctx->dropped++;
+    }
+  }
+
+  ctx->msgs_num = 0;
+} /* }}} void kafka_produce_msgs */
+
+/* Completes the message in batch_buf and queues it for production.
+ * NOTE: You must hold ctx->lock when calling this function! */
+static void kafka_batch_finish(struct kafka_topic_context *ctx) /* {{{ */
+{
+  rd_kafka_message_t *msg;
+  char *key;
+
+  if (ctx->batch_num == 0)
+    return;
+
+  if (ctx->format == KAFKA_FORMAT_JSON)
+    format_json_finalize(ctx->batch_buf, &ctx->batch_fill, &ctx->batch_free);
+
+  if (ctx->msgs_num >= KAFKA_BATCH_MESSAGES)
+    kafka_produce_msgs(ctx);
+
+  key = (ctx->key != NULL) ? ctx->key
+                           : kafka_random_key(ctx->msg_keys[ctx->msgs_num]);
+
+  msg = ctx->msgs + ctx->msgs_num;
+  *msg = (rd_kafka_message_t){
+      .partition = RD_KAFKA_PARTITION_UA,
+      .payload = ctx->batch_buf,
+      .len = ctx->batch_fill,
+      .key = key,
+      .key_len = strlen(key),
+  };
+  ctx->msgs_num++;
+
+  /* The next message most likely has a similar size. */
+  ctx->batch_hint = ctx->batch_fill;
+  ctx->batch_buf = NULL;
+  ctx->batch_fill = 0;
+  ctx->batch_free = 0;
+  ctx->batch_num = 0;
+} /* }}} void kafka_batch_finish */
+
+/* Makes sure batch_buf has room for another value list.
+ * NOTE: You must hold ctx->lock when calling this function! */
+static int kafka_batch_reserve(struct kafka_topic_context *ctx) /* {{{ */
+{
+  if (ctx->batch_free >= KAFKA_VALUE_LIST_SIZE)
+    return 0;
+
+  size_t size = ctx->batch_fill + ctx->batch_free;
+  if (size < ctx->batch_hint + KAFKA_VALUE_LIST_SIZE)
+    size = ctx->batch_hint + KAFKA_VALUE_LIST_SIZE;
+  else
+    size *= 2;
+
+  /* librdkafka releases the payload using free(3). */
+  char *tmp = realloc(ctx->batch_buf, size);
+  if (tmp == NULL) {
+    ERROR("write_kafka plugin: realloc failed.");
+    return ENOMEM;
+  }
+
+  if (ctx->batch_buf == NULL) {
+    ctx->batch_buf = tmp;
+    ctx->batch_fill = 0;
+    ctx->batch_free = size;
+    if (ctx->format == KAFKA_FORMAT_JSON)
+      format_json_initialize(ctx->batch_buf, &ctx->batch_fill,
+                             &ctx->batch_free);
+  } else {
+    ctx->batch_buf = tmp;
+    ctx->batch_free = size - ctx->batch_fill;
+  }
+
+  return 0;
+} /* }}} int kafka_batch_reserve */
+
+static int kafka_write_batch(struct kafka_topic_context *ctx, /* {{{ */
+                             const data_set_t *ds, const value_list_t *vl) {
+  int status;
+
+  pthread_mutex_lock(&ctx->lock);
+
+  status = kafka_batch_reserve(ctx);
+  if (status != 0) {
+    pthread_mutex_unlock(&ctx->lock);
+    return status;
+  }
+
+  char *buffer = ctx->batch_buf + ctx->batch_fill;
+  size_t len = 0;
+
+  switch (ctx->format) {
+  case KAFKA_FORMAT_COMMAND:
+    status = cmd_create_putval(buffer, KAFKA_VALUE_LIST_SIZE - 1, ds, vl);
+    if (status == 0) {
+      len = strlen(buffer);
+      buffer[len++] = '\n';
+    }
+    break;
+  case KAFKA_FORMAT_JSON:
+    status = format_json_value_list(ctx->batch_buf, &ctx->batch_fill,
+                                    &ctx->batch_free, ds, vl, ctx->store_rates);
+    break;
+  case KAFKA_FORMAT_GRAPHITE:
+    status = format_graphite(buffer, KAFKA_VALUE_LIST_SIZE, ds, vl,
+                             ctx->prefix, ctx->postfix, ctx->escape_char,
+                             ctx->graphite_flags);
+    if (status == 0)
+      len = strlen(buffer);
+    break;
+  default:
+    status = -1;
+  }
+
+  if (status != 0) {
+    ERROR("write_kafka plugin: Formatting value list failed with status %i.",
+          status);
+    pthread_mutex_unlock(&ctx->lock);
+    return status;
+  }
+
+  ctx->batch_fill += len;
+  ctx->batch_free -= len;
+  if (ctx->batch_num++ == 0)
+    ctx->batch_first = cdtime();
+
+  if ((ctx->batch_num >= ctx->batch_size) ||
+      ((cdtime() - ctx->batch_first) >= ctx->batch_timeout)) {
+    kafka_batch_finish(ctx);
+    kafka_produce_msgs(ctx);
+  } else if (ctx->msgs_num >= KAFKA_BATCH_MESSAGES) {
+    kafka_produce_msgs(ctx);
+  }
+
+  pthread_mutex_unlock(&ctx->lock);
+  return 0;
+} /* }}} int kafka_write_batch */
+
+static int kafka_flush(cdtime_t timeout, /* {{{ */
+                       const char __attribute__((unused)) * identifier,
+                       user_data_t *ud) {
+  struct kafka_topic_context *ctx = ud->data;
+
+  pthread_mutex_lock(&ctx->lock);
+  /* timeout == 0  => flush unconditionally */
+  if ((ctx->batch_num > 0) &&
+      ((timeout == 0) || ((ctx->batch_first + timeout) <= cdtime())))
+    kafka_batch_finish(ctx);
+  if (ctx->topic != NULL)
+    kafka_produce_msgs(ctx);
+  pthread_mutex_unlock(&ctx->lock);
+
+  return 0;
+} /* }}} int kafka_flush */
+
+static void kafka_submit(struct kafka_topic_context *ctx, /* {{{ */
+                         char const *type, char const *type_instance,
+                         value_t value) {
+  value_list_t vl = VALUE_LIST_INIT;
+
+  vl.values = &value;
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, "write_kafka", sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, ctx->topic_name, sizeof(vl.plugin_instance));
+  sstrncpy(vl.type, type, sizeof(vl.type));
+  if (type_instance != NULL)
+    sstrncpy(vl.type_instance, type_instance, sizeof(vl.type_instance));
+
+  plugin_dispatch_values(&vl);
+} /* }}} void kafka_submit */
+
+static int kafka_read(user_data_t *ud) /* {{{ */
+{
+  struct kafka_topic_context *ctx = ud->data;
+  int queue_length;
+  uint64_t dropped;
+
+  pthread_mutex_lock(&ctx->lock);
+  if (ctx->kafka == NULL) {
+    pthread_mutex_unlock(&ctx->lock);
+    return 0;
+  }
+  queue_length = rd_kafka_outq_len(ctx->kafka);
+  dropped = ctx->dropped;
+  pthread_mutex_unlock(&ctx->lock);
+
+  kafka_submit(ctx, "queue_length", NULL,
+               (value_t){.gauge = (gauge_t)queue_length});
+  kafka_submit(ctx, "total_values", "dropped",
+               (value_t){.derive = (derive_t)dropped});
+
+  return 0;
+} /* }}} int kafka_read */
+
 static int kafka_write(const data_set_t *ds, /* {{{ */
                        const value_list_t *vl, user_data_t *ud) {
   int status = 0;
@@ -190,6 +433,9 @@ static int kafka_write(const data_set_t *ds, /* {{{ */
   if (status != 0)
     return status;
 
+  if (ctx->batch_size > 0)
+    return kafka_write_batch(ctx, ds, vl);
+
   bzero(buffer, sizeof(buffer));
 
   switch (ctx->format) {
@@ -228,8 +474,12 @@ static int kafka_write(const data_set_t *ds, /* {{{ */
       (ctx->key != NULL) ? ctx->key : kafka_random_key(KAFKA_RANDOM_KEY_BUFFER);
   keylen = strlen(key);
 
-  rd_kafka_produce(ctx->topic, RD_KAFKA_PARTITION_UA, RD_KAFKA_MSG_F_COPY,
-                   buffer, blen, key, keylen, NULL);
+  if (rd_kafka_produce(ctx->topic, RD_KAFKA_PARTITION_UA, RD_KAFKA_MSG_F_COPY,
+                       buffer, blen, key, keylen, NULL) != 0) {
+    pthread_mutex_lock(&ctx->lock);
+    ctx->dropped++;
+    pthread_mutex_unlock(&ctx->lock);
+  }
 
   return status;
 } /* }}} int kafka_write */
@@ -241,6 +491,16 @@ static void kafka_topic_context_free(void *p) /* {{{ */
   if (ctx == NULL)
     return;
 
+  if (ctx->topic != NULL) {
+    kafka_batch_finish(ctx);
+    kafka_produce_msgs(ctx);
+#if RD_KAFKA_VERSION >= 0x000902ff
+    /* Give queued messages a chance to be delivered. */
+    rd_kafka_flush(ctx->kafka, CDTIME_T_TO_MS(ctx->batch_timeout));
+#endif
+  }
+  sfree(ctx->batch_buf);
+
   if (ctx->topic_name != NULL)
     sfree(ctx->topic_name);
   if (ctx->topic != NULL)
@@ -276,6 +536,9 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
   tctx->store_rates = true;
   tctx->format = KAFKA_FORMAT_JSON;
   tctx->key = NULL;
+  tctx->batch_size = 0;
+  tctx->batch_timeout = plugin_get_interval();
+  tctx->report_stats = false;
 
   if ((tctx->kafka_conf = rd_kafka_conf_dup(conf)) == NULL) {
     sfree(tctx);
@@ -399,6 +662,18 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
                 "only one character. Others will be ignored.");
       tctx->escape_char = tmp_buff[0];
       sfree(tmp_buff);
+    } else if (strcasecmp("BatchSize", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp < 0)) {
+        WARNING("write_kafka plugin: BatchSize must not be negative.");
+        status = -1;
+      }
+      tctx->batch_size = (size_t)tmp;
+    } else if (strcasecmp("BatchTimeout", child->key) == 0) {
+      status = cf_util_get_cdtime(child, &tctx->batch_timeout);
+    } else if (strcasecmp("ReportStats", child->key) == 0) {
+      status = cf_util_get_boolean(child, &tctx->report_stats);
     } else {
       WARNING("write_kafka plugin: Invalid directive: %s.", child->key);
     }
@@ -427,6 +702,14 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
 
   pthread_mutex_init(&tctx->lock, /* attr = */ NULL);
 
+  if (tctx->batch_size > 0)
+    plugin_register_flush(callback_name, kafka_flush,
+                          &(user_data_t){.data = tctx});
+  if (tctx->report_stats)
+    plugin_register_complex_read(/* group = */ NULL, callback_name, kafka_read,
+                                 /* interval = */ 0,
+                                 &(user_data_t){.data = tctx});
+
   return;
 errout:
   if (tctx->topic_name != NULL)
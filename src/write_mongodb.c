@@ -33,6 +33,7 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils_cache.h"
 
@@ -56,30 +57,41 @@ struct wm_node_s {
   mongoc_client_t *client;
   mongoc_database_t *database;
   pthread_mutex_t lock;
+
+  /* Batching: documents are collected in one bulk operation per collection,
+   * i.e. per plugin, and inserted once "BatchSize" documents are queued, the
+   * oldest document is older than "BatchTimeout" or the plugin is flushed. */
+  int batch_size;
+  cdtime_t batch_timeout;
+  c_avl_tree_t *batches;
+
+  /* Reused for every document to avoid allocating a buffer per value list. */
+  bson_t doc;
 };
 typedef struct wm_node_s wm_node_t;
 
+struct wm_batch_s {
+  mongoc_collection_t *collection;
+  mongoc_bulk_operation_t *bulk;
+  int num;
+  cdtime_t first;
+};
+typedef struct wm_batch_s wm_batch_t;
+
 /*
  * Functions
  */
-static bson_t *wm_create_bson(const data_set_t *ds, /* {{{ */
-                              const value_list_t *vl, bool store_rates) {
-  bson_t *ret;
+/* Appends the fields describing "vl" to "ret", which must be empty. */
+static int wm_append_bson(bson_t *ret, const data_set_t *ds, /* {{{ */
+                          const value_list_t *vl, bool store_rates) {
   bson_t subarray;
   gauge_t *rates;
 
-  ret = bson_new();
-  if (!ret) {
-    ERROR("write_mongodb plugin: bson_new failed.");
-    return NULL;
-  }
-
   if (store_rates) {
     rates = uc_get_rate(ds, vl);
     if (rates == NULL) {
       ERROR("write_mongodb plugin: uc_get_rate() failed.");
-      bson_destroy(ret);
-      return NULL;
+      return -1;
     }
   } else {
     rates = NULL;
@@ -94,9 +106,10 @@ static bson_t *wm_create_bson(const data_set_t *ds, /* {{{ */
 
   BSON_APPEND_ARRAY_BEGIN(ret, "values", &subarray); /* {{{ */
   for (size_t i = 0; i < ds->ds_num; i++) {
-    char key[16];
+    char buffer[16];
+    const char *key;
 
-    snprintf(key, sizeof(key), "%" PRIsz, i);
+    bson_uint32_to_string((uint32_t)i, &key, buffer, sizeof(buffer));
 
     if (ds->ds[i].type == DS_TYPE_GAUGE)
       BSON_APPEND_DOUBLE(&subarray, key, vl->values[i].gauge);
@@ -111,17 +124,18 @@ static bson_t *wm_create_bson(const data_set_t *ds, /* {{{ */
     else {
       ERROR("write_mongodb plugin: Unknown ds_type %d for index %" PRIsz,
             ds->ds[i].type, i);
-      bson_destroy(ret);
-      return NULL;
+      sfree(rates);
+      return -1;
     }
   }
   bson_append_array_end(ret, &subarray); /* }}} values */
 
   BSON_APPEND_ARRAY_BEGIN(ret, "dstypes", &subarray); /* {{{ */
   for (size_t i = 0; i < ds->ds_num; i++) {
-    char key[16];
+    char buffer[16];
+    const char *key;
 
-    snprintf(key, sizeof(key), "%" PRIsz, i);
+    bson_uint32_to_string((uint32_t)i, &key, buffer, sizeof(buffer));
 
     if (store_rates)
       BSON_APPEND_UTF8(&subarray, key, "gauge");
@@ -132,9 +146,10 @@ static bson_t *wm_create_bson(const data_set_t *ds, /* {{{ */
 
   BSON_APPEND_ARRAY_BEGIN(ret, "dsnames", &subarray); /* {{{ */
   for (size_t i = 0; i < ds->ds_num; i++) {
-    char key[16];
+    char buffer[16];
+    const char *key;
 
-    snprintf(key, sizeof(key), "%" PRIsz, i);
+    bson_uint32_to_string((uint32_t)i, &key, buffer, sizeof(buffer));
     BSON_APPEND_UTF8(&subarray, key, ds->ds[i].name);
   }
   bson_append_array_end(ret, &subarray); /* }}} dsnames */
@@ -146,12 +161,11 @@ static bson_t *wm_create_bson(const data_set_t *ds, /* {{{ */
     ERROR("write_mongodb plugin: Error in generated BSON document "
           "at byte %" PRIsz,
           error_location);
-    bson_destroy(ret);
-    return NULL;
+    return -1;
   }
 
-  return ret;
-} /* }}} bson *wm_create_bson */
+  return 0;
+} /* }}} int wm_append_bson */
 
 static int wm_initialize(wm_node_t *node) /* {{{ */
 {
@@ -218,68 +232,205 @@ static int wm_initialize(wm_node_t *node) /* {{{ */
   return 0;
 } /* }}} int wm_initialize */
 
-static int wm_write(const data_set_t *ds, /* {{{ */
-                    const value_list_t *vl, user_data_t *ud) {
-  wm_node_t *node = ud->data;
-  mongoc_collection_t *collection = NULL;
-  bson_t *bson_record;
+/* Drops all batches and the connection to the server.
+ * NOTE: You must hold node->lock when calling this function! */
+static void wm_reset(wm_node_t *node) /* {{{ */
+{
+  char *plugin;
+  wm_batch_t *batch;
+
+  while ((node->batches != NULL) &&
+         (c_avl_pick(node->batches, (void *)&plugin, (void *)&batch) == 0)) {
+    if (batch->num > 0)
+      WARNING("write_mongodb plugin: Dropping %d documents for collection "
+              "\"%s\".",
+              batch->num, plugin);
+    if (batch->bulk != NULL)
+      mongoc_bulk_operation_destroy(batch->bulk);
+    mongoc_collection_destroy(batch->collection);
+    sfree(batch);
+    sfree(plugin);
+  }
+
+  mongoc_database_destroy(node->database);
+  mongoc_client_destroy(node->client);
+  node->database = NULL;
+  node->client = NULL;
+  node->connected = false;
+} /* }}} void wm_reset */
+
+/* NOTE: You must hold node->lock when calling this function! */
+static int wm_batch_execute(wm_batch_t *batch) /* {{{ */
+{
+  bson_t reply;
   bson_error_t error;
-  int status;
+  int status = 0;
 
-  bson_record = wm_create_bson(ds, vl, node->store_rates);
-  if (!bson_record) {
-    ERROR("write_mongodb plugin: error making insert bson");
-    return -1;
+  if (batch->bulk == NULL)
+    return 0;
+
+  if (!mongoc_bulk_operation_execute(batch->bulk, &reply, &error)) {
+    ERROR("write_mongodb plugin: error inserting %d records: %s", batch->num,
+          error.message);
+    status = -1;
   }
+  bson_destroy(&reply);
 
-  pthread_mutex_lock(&node->lock);
-  if (wm_initialize(node) < 0) {
-    ERROR("write_mongodb plugin: error making connection to server");
-    pthread_mutex_unlock(&node->lock);
-    bson_destroy(bson_record);
-    return -1;
+  mongoc_bulk_operation_destroy(batch->bulk);
+  batch->bulk = NULL;
+  batch->num = 0;
+  return status;
+} /* }}} int wm_batch_execute */
+
+/* NOTE: You must hold node->lock when calling this function! */
+static int wm_batch_insert(wm_node_t *node, char const *plugin, /* {{{ */
+                           bson_t const *doc) {
+  wm_batch_t *batch = NULL;
+
+  if (c_avl_get(node->batches, plugin, (void *)&batch) != 0) {
+    char *key = strdup(plugin);
+    batch = calloc(1, sizeof(*batch));
+    if ((key == NULL) || (batch == NULL)) {
+      ERROR("write_mongodb plugin: calloc failed.");
+      sfree(key);
+      sfree(batch);
+      return -1;
+    }
+
+    batch->collection =
+        mongoc_client_get_collection(node->client, "collectd", plugin);
+    if (!batch->collection) {
+      ERROR("write_mongodb plugin: error creating/getting collection");
+      sfree(key);
+      sfree(batch);
+      return -1;
+    }
+
+    c_avl_insert(node->batches, key, batch);
+  }
+
+  if (batch->bulk == NULL) {
+    /* Documents are independent of each other, so the order in which they
+     * are inserted does not matter. */
+    batch->bulk = mongoc_collection_create_bulk_operation(
+        batch->collection, /* ordered = */ false, /* write_concern = */ NULL);
+    if (batch->bulk == NULL) {
+      ERROR("write_mongodb plugin: error creating bulk operation");
+      return -1;
+    }
+    batch->first = cdtime();
   }
 
-  collection =
-      mongoc_client_get_collection(node->client, "collectd", vl->plugin);
+  /* The document is copied into the bulk operation's buffer. */
+  mongoc_bulk_operation_insert(batch->bulk, doc);
+  batch->num++;
+
+  if ((batch->num >= node->batch_size) ||
+      ((cdtime() - batch->first) >= node->batch_timeout))
+    return wm_batch_execute(batch);
+
+  return 0;
+} /* }}} int wm_batch_insert */
+
+/* NOTE: You must hold node->lock when calling this function! */
+static int wm_insert(wm_node_t *node, char const *plugin, /* {{{ */
+                     bson_t const *doc) {
+  mongoc_collection_t *collection;
+  bson_error_t error;
+
+  collection = mongoc_client_get_collection(node->client, "collectd", plugin);
   if (!collection) {
     ERROR("write_mongodb plugin: error creating/getting collection");
-    mongoc_database_destroy(node->database);
-    mongoc_client_destroy(node->client);
-    node->database = NULL;
-    node->client = NULL;
-    node->connected = false;
-    pthread_mutex_unlock(&node->lock);
-    bson_destroy(bson_record);
     return -1;
   }
 
-  status = mongoc_collection_insert(collection, MONGOC_INSERT_NONE, bson_record,
-                                    NULL, &error);
+  int status = mongoc_collection_insert(collection, MONGOC_INSERT_NONE, doc,
+                                        NULL, &error);
+  /* free our resource as not to leak memory */
+  mongoc_collection_destroy(collection);
 
   if (!status) {
     ERROR("write_mongodb plugin: error inserting record: %s", error.message);
-    mongoc_database_destroy(node->database);
-    mongoc_client_destroy(node->client);
-    node->database = NULL;
-    node->client = NULL;
-    node->connected = false;
+    return -1;
+  }
+
+  return 0;
+} /* }}} int wm_insert */
+
+static int wm_write(const data_set_t *ds, /* {{{ */
+                    const value_list_t *vl, user_data_t *ud) {
+  wm_node_t *node = ud->data;
+  int status;
+
+  pthread_mutex_lock(&node->lock);
+  if (wm_initialize(node) < 0) {
+    ERROR("write_mongodb plugin: error making connection to server");
     pthread_mutex_unlock(&node->lock);
-    bson_destroy(bson_record);
-    mongoc_collection_destroy(collection);
     return -1;
   }
 
-  /* free our resource as not to leak memory */
-  mongoc_collection_destroy(collection);
+  bson_reinit(&node->doc);
+  if (wm_append_bson(&node->doc, ds, vl, node->store_rates) != 0) {
+    ERROR("write_mongodb plugin: error making insert bson");
+    pthread_mutex_unlock(&node->lock);
+    return -1;
+  }
 
-  pthread_mutex_unlock(&node->lock);
+  if (node->batch_size > 0)
+    status = wm_batch_insert(node, vl->plugin, &node->doc);
+  else
+    status = wm_insert(node, vl->plugin, &node->doc);
 
-  bson_destroy(bson_record);
+  if (status != 0)
+    wm_reset(node);
 
-  return 0;
+  pthread_mutex_unlock(&node->lock);
+
+  return status;
 } /* }}} int wm_write */
 
+/* NOTE: You must hold node->lock when calling this function! */
+static int wm_flush_nolock(cdtime_t timeout, wm_node_t *node) /* {{{ */
+{
+  c_avl_iterator_t *iter;
+  wm_batch_t *batch;
+  char *plugin;
+  cdtime_t now = cdtime();
+  int status = 0;
+
+  if (!node->connected)
+    return 0;
+
+  iter = c_avl_get_iterator(node->batches);
+  while (c_avl_iterator_next(iter, (void *)&plugin, (void *)&batch) == 0) {
+    /* timeout == 0  => flush unconditionally */
+    if ((batch->bulk == NULL) ||
+        ((timeout > 0) && ((batch->first + timeout) > now)))
+      continue;
+
+    if (wm_batch_execute(batch) != 0)
+      status = -1;
+  }
+  c_avl_iterator_destroy(iter);
+
+  if (status != 0)
+    wm_reset(node);
+
+  return status;
+} /* }}} int wm_flush_nolock */
+
+static int wm_flush(cdtime_t timeout, /* {{{ */
+                    const char __attribute__((unused)) * identifier,
+                    user_data_t *ud) {
+  wm_node_t *node = ud->data;
+
+  pthread_mutex_lock(&node->lock);
+  int status = wm_flush_nolock(timeout, node);
+  pthread_mutex_unlock(&node->lock);
+
+  return status;
+} /* }}} int wm_flush */
+
 static void wm_config_free(void *ptr) /* {{{ */
 {
   wm_node_t *node = ptr;
@@ -287,11 +438,14 @@ static void wm_config_free(void *ptr) /* {{{ */
   if (node == NULL)
     return;
 
-  mongoc_database_destroy(node->database);
-  mongoc_client_destroy(node->client);
-  node->database = NULL;
-  node->client = NULL;
-  node->connected = false;
+  if (node->batches != NULL) {
+    wm_flush_nolock(/* timeout = */ 0, node);
+    wm_reset(node);
+    c_avl_destroy(node->batches);
+  } else {
+    wm_reset(node);
+  }
+  bson_destroy(&node->doc);
 
   sfree(node->host);
   sfree(node);
@@ -313,11 +467,15 @@ static int wm_config_node(oconfig_item_t *ci) /* {{{ */
   }
   node->port = MONGOC_DEFAULT_PORT;
   node->store_rates = true;
+  node->batch_size = 0;
+  node->batch_timeout = plugin_get_interval();
+  bson_init(&node->doc);
   pthread_mutex_init(&node->lock, /* attr = */ NULL);
 
   status = cf_util_get_string_buffer(ci, node->name, sizeof(node->name));
 
   if (status != 0) {
+    bson_destroy(&node->doc);
     sfree(node->host);
     sfree(node);
     return status;
@@ -344,6 +502,10 @@ static int wm_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_string(child, &node->user);
     else if (strcasecmp("Password", child->key) == 0)
       status = cf_util_get_string(child, &node->passwd);
+    else if (strcasecmp("BatchSize", child->key) == 0)
+      status = cf_util_get_int(child, &node->batch_size);
+    else if (strcasecmp("BatchTimeout", child->key) == 0)
+      status = cf_util_get_cdtime(child, &node->batch_timeout);
     else
       WARNING("write_mongodb plugin: Ignoring unknown config option \"%s\".",
               child->key);
@@ -365,6 +527,14 @@ static int wm_config_node(oconfig_item_t *ci) /* {{{ */
     }
   }
 
+  if ((status == 0) && (node->batch_size > 0)) {
+    node->batches = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (node->batches == NULL) {
+      ERROR("write_mongodb plugin: c_avl_create failed.");
+      status = -1;
+    }
+  }
+
   if (status == 0) {
     char cb_name[sizeof("write_mongodb/") + DATA_MAX_NAME_LEN];
 
@@ -377,6 +547,8 @@ static int wm_config_node(oconfig_item_t *ci) /* {{{ */
                                    });
     INFO("write_mongodb plugin: registered write plugin %s %d", cb_name,
          status);
+    if ((status == 0) && (node->batch_size > 0))
+      plugin_register_flush(cb_name, wm_flush, &(user_data_t){.data = node});
   }
 
   if (status != 0)
@@ -47,15 +47,120 @@ struct wr_node_s {
   int max_set_size;
   int max_set_duration;
   bool store_rates;
+  int pipeline_depth;
 
   redisContext *conn;
   pthread_mutex_t lock;
+
+  /* Number of commands queued with redisAppendCommand whose replies have not
+   * been read yet, and the time the first of them was queued. Queued commands
+   * are only sent by wr_drain(). */
+  int pending;
+  cdtime_t pending_since;
 };
 typedef struct wr_node_s wr_node_t;
 
 /*
  * Functions
  */
+/* NOTE: You must hold node->lock when calling this function! */
+static int wr_connect(wr_node_t *node) /* {{{ */
+{
+  redisReply *rr;
+
+  if (node->conn != NULL)
+    return 0;
+
+  node->conn =
+      redisConnectWithTimeout((char *)node->host, node->port, node->timeout);
+  if (node->conn == NULL) {
+    ERROR("write_redis plugin: Connecting to host \"%s\" (port %i) failed: "
+          "Unknown reason",
+          (node->host != NULL) ? node->host : "localhost",
+          (node->port != 0) ? node->port : 6379);
+    return -1;
+  } else if (node->conn->err) {
+    ERROR("write_redis plugin: Connecting to host \"%s\" (port %i) failed: %s",
+          (node->host != NULL) ? node->host : "localhost",
+          (node->port != 0) ? node->port : 6379, node->conn->errstr);
+    redisFree(node->conn);
+    node->conn = NULL;
+    return -1;
+  }
+  node->pending = 0;
+
+  rr = redisCommand(node->conn, "SELECT %d", node->database);
+  if (rr == NULL)
+    WARNING("SELECT command error. database:%d message:%s", node->database,
+            node->conn->errstr);
+  else
+    freeReplyObject(rr);
+
+  return 0;
+} /* }}} int wr_connect */
+
+/* Reads the replies to all pipelined commands. This sends the commands, too:
+ * hiredis only writes its output buffer when a reply is requested.
+ * NOTE: You must hold node->lock when calling this function! */
+static int wr_drain(wr_node_t *node) /* {{{ */
+{
+  int status = 0;
+
+  if ((node->conn == NULL) || (node->pending == 0))
+    return 0;
+
+  while (node->pending > 0) {
+    redisReply *rr = NULL;
+
+    if (redisGetReply(node->conn, (void **)&rr) != REDIS_OK) {
+      ERROR("write_redis plugin: Sending %d commands to node \"%s\" failed: "
+            "%s",
+            node->pending, node->name, node->conn->errstr);
+      /* The state of the pipeline is unknown, start over. */
+      redisFree(node->conn);
+      node->conn = NULL;
+      node->pending = 0;
+      return -1;
+    }
+    node->pending--;
+
+    if (rr->type == REDIS_REPLY_ERROR) {
+      WARNING("write_redis plugin: Command failed on node \"%s\": %s",
+              node->name, rr->str);
+      status = -1;
+    }
+    freeReplyObject(rr);
+  }
+
+  return status;
+} /* }}} int wr_drain */
+
+/* Runs a command, or appends it to the pipeline if "PipelineDepth" is set.
+ * NOTE: You must hold node->lock when calling this function! */
+__attribute__((format(printf, 4, 5))) static void
+wr_command(wr_node_t *node, char const *name, char const *key,
+           char const *format, ...) /* {{{ */
+{
+  va_list ap;
+
+  va_start(ap, format);
+  if (node->pipeline_depth > 0) {
+    if (redisvAppendCommand(node->conn, format, ap) != REDIS_OK)
+      WARNING("%s command error. key:%s message:%s", name, key,
+              node->conn->errstr);
+    else if (node->pending++ == 0)
+      node->pending_since = cdtime();
+  } else {
+    redisReply *rr = redisvCommand(node->conn, format, ap);
+    if (rr == NULL)
+      WARNING("%s command error. key:%s message:%s", name, key,
+              node->conn->errstr);
+    else
+      freeReplyObject(rr);
+  }
+  va_end(ap);
+} /* }}} void wr_command */
+
 static int wr_write(const data_set_t *ds, /* {{{ */
                     const value_list_t *vl, user_data_t *ud) {
   wr_node_t *node = ud->data;
@@ -66,7 +171,6 @@ static int wr_write(const data_set_t *ds, /* {{{ */
   size_t value_size;
   char *value_ptr;
   int status;
-  redisReply *rr;
 
   status = FORMAT_VL(ident, sizeof(ident), vl);
   if (status != 0)
@@ -84,80 +188,61 @@ static int wr_write(const data_set_t *ds, /* {{{ */
 
   pthread_mutex_lock(&node->lock);
 
-  if (node->conn == NULL) {
-    node->conn =
-        redisConnectWithTimeout((char *)node->host, node->port, node->timeout);
-    if (node->conn == NULL) {
-      ERROR("write_redis plugin: Connecting to host \"%s\" (port %i) failed: "
-            "Unknown reason",
-            (node->host != NULL) ? node->host : "localhost",
-            (node->port != 0) ? node->port : 6379);
-      pthread_mutex_unlock(&node->lock);
-      return -1;
-    } else if (node->conn->err) {
-      ERROR(
-          "write_redis plugin: Connecting to host \"%s\" (port %i) failed: %s",
-          (node->host != NULL) ? node->host : "localhost",
-          (node->port != 0) ? node->port : 6379, node->conn->errstr);
-      pthread_mutex_unlock(&node->lock);
-      return -1;
-    }
-
-    rr = redisCommand(node->conn, "SELECT %d", node->database);
-    if (rr == NULL)
-      WARNING("SELECT command error. database:%d message:%s", node->database,
-              node->conn->errstr);
-    else
-      freeReplyObject(rr);
+  if (wr_connect(node) != 0) {
+    pthread_mutex_unlock(&node->lock);
+    return -1;
   }
 
-  rr = redisCommand(node->conn, "ZADD %s %s %s", key, time, value);
-  if (rr == NULL)
-    WARNING("ZADD command error. key:%s message:%s", key, node->conn->errstr);
-  else
-    freeReplyObject(rr);
+  wr_command(node, "ZADD", key, "ZADD %s %s %s", key, time, value);
 
-  if (node->max_set_size >= 0) {
-    rr = redisCommand(node->conn, "ZREMRANGEBYRANK %s %d %d", key, 0,
-                      (-1 * node->max_set_size) - 1);
-    if (rr == NULL)
-      WARNING("ZREMRANGEBYRANK command error. key:%s message:%s", key,
-              node->conn->errstr);
-    else
-      freeReplyObject(rr);
-  }
+  if (node->max_set_size >= 0)
+    wr_command(node, "ZREMRANGEBYRANK", key, "ZREMRANGEBYRANK %s %d %d",
+               key, 0, (-1 * node->max_set_size) - 1);
 
   if (node->max_set_duration > 0) {
     /*
      * remove element, scored less than 'current-max_set_duration'
      * '(...' indicates 'less than' in redis CLI.
      */
-    rr = redisCommand(node->conn, "ZREMRANGEBYSCORE %s -1 (%.9f", key,
-                      (CDTIME_T_TO_DOUBLE(vl->time) - node->max_set_duration));
-    if (rr == NULL)
-      WARNING("ZREMRANGEBYSCORE command error. key:%s message:%s", key,
-              node->conn->errstr);
-    else
-      freeReplyObject(rr);
+    wr_command(node, "ZREMRANGEBYSCORE", key, "ZREMRANGEBYSCORE %s -1 (%.9f",
+               key, (CDTIME_T_TO_DOUBLE(vl->time) - node->max_set_duration));
   }
 
   /* TODO(octo): This is more overhead than necessary. Use the cache and
    * metadata to determine if it is a new metric and call SADD only once for
    * each metric. */
-  rr = redisCommand(
-      node->conn, "SADD %svalues %s",
-      (node->prefix != NULL) ? node->prefix : REDIS_DEFAULT_PREFIX, ident);
-  if (rr == NULL)
-    WARNING("SADD command error. ident:%s message:%s", ident,
-            node->conn->errstr);
-  else
-    freeReplyObject(rr);
+  wr_command(node, "SADD", ident, "SADD %svalues %s",
+             (node->prefix != NULL) ? node->prefix : REDIS_DEFAULT_PREFIX,
+             ident);
+
+  /* Send the pipeline once it is full or has been held back for an interval,
+   * so that values are not delayed indefinitely without a flush. */
+  if ((node->pipeline_depth > 0) && (node->pending > 0) &&
+      ((node->pending >= node->pipeline_depth) ||
+       ((node->pending_since + vl->interval) <= cdtime())))
+    wr_drain(node);
 
   pthread_mutex_unlock(&node->lock);
 
   return 0;
 } /* }}} int wr_write */
 
+static int wr_flush(cdtime_t timeout, /* {{{ */
+                    const char __attribute__((unused)) * identifier,
+                    user_data_t *ud) {
+  wr_node_t *node = ud->data;
+  int status = 0;
+
+  pthread_mutex_lock(&node->lock);
+  /* timeout == 0  => flush unconditionally */
+  if ((node->pending > 0) &&
+      ((timeout == 0) || ((node->pending_since + timeout) <= cdtime())))
+    status = wr_drain(node);
+  pthread_mutex_unlock(&node->lock);
+
+  return status;
+} /* }}} int wr_flush */
+
 static void wr_config_free(void *ptr) /* {{{ */
 {
   wr_node_t *node = ptr;
@@ -166,6 +251,7 @@ static void wr_config_free(void *ptr) /* {{{ */
     return;
 
   if (node->conn != NULL) {
+    wr_drain(node);
     redisFree(node->conn);
     node->conn = NULL;
   }
@@ -193,6 +279,7 @@ static int wr_config_node(oconfig_item_t *ci) /* {{{ */
   node->max_set_size = -1;
   node->max_set_duration = -1;
   node->store_rates = true;
+  node->pipeline_depth = 0;
   pthread_mutex_init(&node->lock, /* attr = */ NULL);
 
   status = cf_util_get_string_buffer(ci, node->name, sizeof(node->name));
@@ -229,6 +316,8 @@ static int wr_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_int(child, &node->max_set_duration);
     } else if (strcasecmp("StoreRates", child->key) == 0) {
       status = cf_util_get_boolean(child, &node->store_rates);
+    } else if (strcasecmp("PipelineDepth", child->key) == 0) {
+      status = cf_util_get_int(child, &node->pipeline_depth);
     } else
       WARNING("write_redis plugin: Ignoring unknown config option \"%s\".",
               child->key);
@@ -247,6 +336,8 @@ static int wr_config_node(oconfig_item_t *ci) /* {{{ */
                                        .data = node,
                                        .free_func = wr_config_free,
                                    });
+    if ((status == 0) && (node->pipeline_depth > 0))
+      plugin_register_flush(cb_name, wr_flush, &(user_data_t){.data = node});
   }
 
   if (status != 0)
@@ -0,0 +1,221 @@
+/**
+ * collectd - src/write_redis_test.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "write_redis.c" /* sic */
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+/* A stand-in for redis-server: accepts connections one after another and
+ * answers every command, encoded as an array of bulk strings, with ":1". */
+typedef struct {
+  int listen_fd;
+  int port;
+  pthread_mutex_t lock;
+  int commands;
+  pthread_t thread;
+} server_t;
+
+static int server_handle(server_t *srv, int fd) {
+  char buffer[65536];
+  size_t len = 0;
+
+  while (1) {
+    ssize_t n = read(fd, buffer + len, sizeof(buffer) - len);
+    if (n <= 0)
+      return 0;
+    len += (size_t)n;
+
+    size_t pos = 0;
+    int complete = 0;
+    while (pos < len) {
+      /* "*<argc>\r\n" followed by argc times "$<len>\r\n<data>\r\n" */
+      char *end;
+      char *eol = memchr(buffer + pos, '\n', len - pos);
+      if ((eol == NULL) || (buffer[pos] != '*'))
+        break;
+      long argc = strtol(buffer + pos + 1, &end, 10);
+
+      size_t p = (size_t)(eol - buffer) + 1;
+      long i;
+      for (i = 0; i < argc; i++) {
+        eol = memchr(buffer + p, '\n', len - p);
+        if (eol == NULL)
+          break;
+        long arg_len = strtol(buffer + p + 1, &end, 10);
+        p = (size_t)(eol - buffer) + 1 + (size_t)arg_len + 2;
+        if (p > len)
+          break;
+      }
+      if (i < argc)
+        break;
+
+      pos = p;
+      complete++;
+    }
+
+    memmove(buffer, buffer + pos, len - pos);
+    len -= pos;
+
+    pthread_mutex_lock(&srv->lock);
+    srv->commands += complete;
+    pthread_mutex_unlock(&srv->lock);
+
+    /* Answer all commands read at once with a single write. */
+    char reply[sizeof(buffer) / 4 * 4];
+    for (int i = 0; i < complete; i++)
+      memcpy(reply + 4 * i, ":1\r\n", 4);
+    if (write(fd, reply, 4 * complete) != 4 * complete)
+      return -1;
+  }
+}
+
+static void *server_thread(void *arg) {
+  server_t *srv = arg;
+
+  while (1) {
+    int fd = accept(srv->listen_fd, NULL, NULL);
+    if (fd < 0)
+      return NULL;
+    /* Like redis-server, disable Nagle's algorithm. */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &(int){1}, sizeof(int));
+    server_handle(srv, fd);
+    close(fd);
+  }
+}
+
+static int server_start(server_t *srv) {
+  struct sockaddr_in sa = {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t sa_len = sizeof(sa);
+
+  srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if ((srv->listen_fd < 0) ||
+      (bind(srv->listen_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (listen(srv->listen_fd, 4) != 0) ||
+      (getsockname(srv->listen_fd, (struct sockaddr *)&sa, &sa_len) != 0))
+    return -1;
+  srv->port = ntohs(sa.sin_port);
+
+  pthread_mutex_init(&srv->lock, NULL);
+  return pthread_create(&srv->thread, NULL, server_thread, srv);
+}
+
+static int server_commands(server_t *srv) {
+  pthread_mutex_lock(&srv->lock);
+  int commands = srv->commands;
+  srv->commands = 0;
+  pthread_mutex_unlock(&srv->lock);
+  return commands;
+}
+
+static server_t srv;
+
+static wr_node_t *node_create(int pipeline_depth) {
+  wr_node_t *node = calloc(1, sizeof(*node));
+  if (node == NULL)
+    return NULL;
+
+  sstrncpy(node->name, "test", sizeof(node->name));
+  node->host = strdup("127.0.0.1");
+  node->port = srv.port;
+  node->timeout.tv_sec = 1;
+  node->max_set_size = 100;
+  node->max_set_duration = -1;
+  node->pipeline_depth = pipeline_depth;
+  pthread_mutex_init(&node->lock, NULL);
+  return node;
+}
+
+/* Writes "num" value lists. */
+static void write_values(wr_node_t *node, int num) {
+  data_source_t dsrc = {"value", DS_TYPE_GAUGE, 0, NAN};
+  data_set_t ds = {"gauge", 1, &dsrc};
+  value_t v = {.gauge = 42.0};
+  value_list_t vl = {
+      .values = &v,
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(1),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "gauge",
+  };
+  user_data_t ud = {.data = node};
+
+  for (int i = 0; i < num; i++) {
+    ssnprintf(vl.type_instance, sizeof(vl.type_instance), "%d", i % 100);
+    wr_write(&ds, &vl, &ud);
+  }
+}
+
+DEF_TEST(pipeline) {
+  wr_node_t *node = node_create(30);
+  CHECK_NOT_NULL(node);
+  user_data_t ud = {.data = node};
+
+  /* SELECT, then ZADD, ZREMRANGEBYRANK and SADD for each value list. The
+   * pipeline is drained after the tenth value list. */
+  write_values(node, 11);
+  EXPECT_EQ_INT(3, node->pending);
+  EXPECT_EQ_INT(1 + 10 * 3, server_commands(&srv));
+
+  CHECK_ZERO(wr_flush(TIME_T_TO_CDTIME_T(3600), NULL, &ud));
+  EXPECT_EQ_INT(3, node->pending);
+  CHECK_ZERO(wr_flush(0, NULL, &ud));
+  EXPECT_EQ_INT(0, node->pending);
+  EXPECT_EQ_INT(3, server_commands(&srv));
+
+  /* Commands pending when the node is destroyed are sent, too. */
+  write_values(node, 1);
+  EXPECT_EQ_INT(3, node->pending);
+  wr_config_free(node);
+  EXPECT_EQ_INT(3, server_commands(&srv));
+
+  return 0;
+}
+
+DEF_TEST(synchronous) {
+  wr_node_t *node = node_create(0);
+  CHECK_NOT_NULL(node);
+
+  /* Without a pipeline, every command is sent right away. */
+  write_values(node, 100);
+  EXPECT_EQ_INT(0, node->pending);
+  wr_config_free(node);
+  EXPECT_EQ_INT(1 + 100 * 3, server_commands(&srv));
+
+  return 0;
+}
+
+int main(void) {
+  CHECK_ZERO(server_start(&srv));
+
+  RUN_TEST(pipeline);
+  RUN_TEST(synchronous);
+
+  END_TEST;
+}